@@ -18,3 +18,56 @@ set( MQTT_SERIALIZER_SOURCES
 set( MQTT_INCLUDE_PUBLIC_DIRS
      "${CMAKE_CURRENT_LIST_DIR}/source/include"
      "${CMAKE_CURRENT_LIST_DIR}/source/interface" )
+
+# Striped client spreading one logical client over several connections. It is
+# optional and not part of the MQTT library.
+set( MQTT_STRIPED_SOURCES
+     "${CMAKE_CURRENT_LIST_DIR}/source/core_mqtt_striped.c" )
+
+# Multi-producer publish queue in front of MQTT_Publish. It is optional and not
+# part of the MQTT library.
+set( MQTT_PUBLISH_QUEUE_SOURCES
+     "${CMAKE_CURRENT_LIST_DIR}/source/core_mqtt_publish_queue.c" )
+
+# Timing wheel sending the keep-alive PINGREQs of many MQTT contexts. It is
+# optional and not part of the MQTT library.
+set( MQTT_KEEP_ALIVE_WHEEL_SOURCES
+     "${CMAKE_CURRENT_LIST_DIR}/source/core_mqtt_keep_alive_wheel.c" )
+
+# Reactor driving many MQTT contexts with a pool of worker threads on Linux
+# epoll. It is optional and not part of the MQTT library.
+set( MQTT_REACTOR_SOURCES
+     "${CMAKE_CURRENT_LIST_DIR}/source/reactor/core_mqtt_reactor.c" )
+
+# Include directories of the reactor.
+set( MQTT_REACTOR_INCLUDE_DIRS
+     "${CMAKE_CURRENT_LIST_DIR}/source/reactor" )
+
+# Include directories of the header-only C++20 coroutine layer. It is optional
+# and not part of the MQTT library.
+set( MQTT_CPP_INCLUDE_DIRS
+     "${CMAKE_CURRENT_LIST_DIR}/source/cpp" )
+
+# Reference transport over non-blocking POSIX TCP sockets. It is optional and
+# not part of the MQTT library.
+set( MQTT_TCP_POSIX_TRANSPORT_SOURCES
+     "${CMAKE_CURRENT_LIST_DIR}/source/transport/tcp_posix_transport.c" )
+
+# Reference transport over Linux io_uring. It is optional and not part of the
+# MQTT library.
+set( MQTT_URING_TRANSPORT_SOURCES
+     "${CMAKE_CURRENT_LIST_DIR}/source/transport/uring_transport.c" )
+
+# Reference transport over ring buffers in Linux shared memory, for clients on
+# the same host as the broker. It is optional and not part of the MQTT library.
+set( MQTT_SHM_RING_TRANSPORT_SOURCES
+     "${CMAKE_CURRENT_LIST_DIR}/source/transport/shm_ring_transport.c" )
+
+# WebSocket framing over another transport, for MQTT over WebSockets. It is
+# optional and not part of the MQTT library.
+set( MQTT_WEBSOCKET_TRANSPORT_SOURCES
+     "${CMAKE_CURRENT_LIST_DIR}/source/transport/websocket_transport.c" )
+
+# Include directories of the reference transports.
+set( MQTT_TRANSPORT_INCLUDE_DIRS
+     "${CMAKE_CURRENT_LIST_DIR}/source/transport" )
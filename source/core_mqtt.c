@@ -38,7 +38,11 @@
 #ifndef MQTT_PRE_SEND_HOOK
 
 /**
- * @brief Hook called before a 'send' operation is executed.
+ * @brief Hook called before a packet is written to the transport.
+ *
+ * It is held until the whole packet is written, so that packets sent from
+ * different threads are not interleaved. #MQTT_PRE_STATE_UPDATE_HOOK may be
+ * called while it is held.
  */
     #define MQTT_PRE_SEND_HOOK( pContext )
 #endif /* !MQTT_PRE_SEND_HOOK */
@@ -46,7 +50,7 @@
 #ifndef MQTT_POST_SEND_HOOK
 
 /**
- * @brief Hook called after the 'send' operation is complete.
+ * @brief Hook called after the packet is written to the transport.
  */
     #define MQTT_POST_SEND_HOOK( pContext )
 #endif /* !MQTT_POST_SEND_HOOK */
@@ -55,6 +59,9 @@
 
 /**
  * @brief Hook called just before an update to the MQTT state is made.
+ *
+ * It is not held while the transport is written, and #MQTT_PRE_SEND_HOOK is
+ * never called while it is held.
  */
     #define MQTT_PRE_STATE_UPDATE_HOOK( pContext )
 #endif /* !MQTT_PRE_STATE_UPDATE_HOOK */
@@ -68,6 +75,42 @@
     #define MQTT_POST_STATE_UPDATE_HOOK( pContext )
 #endif /* !MQTT_POST_STATE_UPDATE_HOOK */
 
+#ifndef MQTT_PRE_BUFFER_POOL_HOOK
+
+/**
+ * @brief Hook called just before a buffer is taken from or returned to a
+ * shared buffer pool.
+ */
+    #define MQTT_PRE_BUFFER_POOL_HOOK( pBufferPool )
+#endif /* !MQTT_PRE_BUFFER_POOL_HOOK */
+
+#ifndef MQTT_POST_BUFFER_POOL_HOOK
+
+/**
+ * @brief Hook called just after a buffer has been taken from or returned to a
+ * shared buffer pool.
+ */
+    #define MQTT_POST_BUFFER_POOL_HOOK( pBufferPool )
+#endif /* !MQTT_POST_BUFFER_POOL_HOOK */
+
+#ifndef MQTT_PRE_RECORD_SLAB_HOOK
+
+/**
+ * @brief Hook called just before the free chunk bitmap of a state record slab
+ * is updated, unless #MQTT_RECORD_SLAB_USE_ATOMICS is enabled.
+ */
+    #define MQTT_PRE_RECORD_SLAB_HOOK( pRecordSlab )
+#endif /* !MQTT_PRE_RECORD_SLAB_HOOK */
+
+#ifndef MQTT_POST_RECORD_SLAB_HOOK
+
+/**
+ * @brief Hook called just after the free chunk bitmap of a state record slab
+ * has been updated, unless #MQTT_RECORD_SLAB_USE_ATOMICS is enabled.
+ */
+    #define MQTT_POST_RECORD_SLAB_HOOK( pRecordSlab )
+#endif /* !MQTT_POST_RECORD_SLAB_HOOK */
+
 /**
  * @brief Bytes required to encode any string length in an MQTT packet header.
  * Length is always encoded in two bytes according to the MQTT specification.
@@ -90,6 +133,48 @@
  */
 #define CORE_MQTT_UNSUBSCRIBE_PER_TOPIC_VECTOR_LENGTH    ( 2U )
 
+/**
+ * @brief Bytes reserved in the staging buffer of #MQTT_SubscribeBulk and
+ * #MQTT_UnsubscribeBulk for the header of each packet: the control byte, the
+ * longest Remaining Length, the packet ID and the MQTT 5 property length.
+ */
+#define CORE_MQTT_BULK_HEADER_MAX_SIZE                   ( 8U )
+
+/**
+ * @brief Offset basis of the 32-bit FNV-1a hash used for the exact-match
+ * topic handler table.
+ */
+#define CORE_MQTT_FNV_OFFSET_BASIS                       ( 2166136261UL )
+
+/**
+ * @brief Prime of the 32-bit FNV-1a hash used for the exact-match topic
+ * handler table.
+ */
+#define CORE_MQTT_FNV_PRIME                              ( 16777619UL )
+
+/**
+ * @brief Number of topic characters examined at once by the word-at-a-time
+ * topic scanning and matching kernels.
+ */
+#define CORE_MQTT_TOPIC_WORD_SIZE                        ( sizeof( uint32_t ) )
+
+/**
+ * @brief A topic word with the value 0x01 in every byte.
+ */
+#define CORE_MQTT_TOPIC_WORD_LOW_BITS                    ( 0x01010101UL )
+
+/**
+ * @brief A topic word with the most significant bit set in every byte.
+ */
+#define CORE_MQTT_TOPIC_WORD_HIGH_BITS                   ( 0x80808080UL )
+
+/**
+ * @brief Number of level separator offsets of an incoming topic name recorded
+ * for matching it against wildcard topic filters. Topic names with more levels
+ * are matched without the offsets.
+ */
+#define CORE_MQTT_DISPATCH_MAX_TOPIC_LEVELS              ( 16U )
+
 struct MQTTVec
 {
     TransportOutVector_t * pVector; /**< Pointer to transport vector. USER SHOULD NOT ACCESS THIS DIRECTLY - IT IS AN INTERNAL DETAIL AND CAN CHANGE. */
@@ -114,12 +199,63 @@ struct MQTTVec
  *                    OR
  * 3. There is an error in sending data over the network.
  *
+ * Between calls which send nothing, it waits with #waitForTransport.
+ *
+ * @note The caller holds #MQTT_PRE_SEND_HOOK.
+ *
  * @return Total number of bytes sent, or negative value on network error.
  */
 static int32_t sendBuffer( MQTTContext_t * pContext,
                            const uint8_t * pBufferToSend,
                            size_t bytesToSend );
 
+/**
+ * @brief Takes a buffer of the transport to write a packet into.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] bytesToWrite Number of bytes of the packet.
+ *
+ * @note The caller holds #MQTT_PRE_SEND_HOOK, and commits the buffer with
+ * #commitTxBuffer before releasing the hook.
+ *
+ * @return A buffer of the transport, or NULL if the transport does not lend
+ * buffers or has none available.
+ */
+static uint8_t * getTxBuffer( MQTTContext_t * pContext,
+                              size_t bytesToWrite );
+
+/**
+ * @brief Sends a packet written into a buffer taken with #getTxBuffer, and
+ * gives the buffer back to the transport.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] pTxBuffer The buffer of the transport.
+ * @param[in] bytesToSend Number of bytes to send. Zero gives the buffer back
+ * without sending anything.
+ *
+ * @return @p bytesToSend, or a negative value on network error.
+ */
+static int32_t commitTxBuffer( MQTTContext_t * pContext,
+                               uint8_t * pTxBuffer,
+                               size_t bytesToSend );
+
+/**
+ * @brief Waits until the transport can receive or send, for at most the rest
+ * of a timeout, if the transport implements the wait function.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] event Whether to wait for data to receive or space to send.
+ * @param[in] startTimeMs Time at which the timeout started.
+ * @param[in] timeoutMs The timeout.
+ *
+ * @note A failure of the wait is only logged, as the receive or send which
+ * follows reports it.
+ */
+static void waitForTransport( MQTTContext_t * pContext,
+                              TransportWaitEvent_t event,
+                              uint32_t startTimeMs,
+                              uint32_t timeoutMs );
+
 /**
  * @brief Sends MQTT connect without copying the users data into any buffer.
  *
@@ -165,6 +301,10 @@ static MQTTStatus_t sendConnectWithoutCopy( MQTTContext_t * pContext,
  *                    OR
  * 3. There is an error in sending data over the network.
  *
+ * Between calls which send nothing, it waits with #waitForTransport.
+ *
+ * @note The caller holds #MQTT_PRE_SEND_HOOK.
+ *
  * @return The total number of bytes sent or the error code as received from the
  * transport interface.
  */
@@ -202,6 +342,7 @@ static size_t addEncodedStringToVector( uint8_t serializedLength[ CORE_MQTT_SERI
  * @param[in] subscriptionCount The count of elements in the list.
  * @param[in] packetId The packet ID of the subscribe packet
  * @param[in] remainingLength The remaining length of the subscribe packet.
+ * @param[in] subscriptionId The MQTT 5 Subscription Identifier, or 0 for none.
  *
  * @return #MQTTSuccess or #MQTTSendFailed.
  */
@@ -209,7 +350,8 @@ static MQTTStatus_t sendSubscribeWithoutCopy( MQTTContext_t * pContext,
                                               const MQTTSubscribeInfo_t * pSubscriptionList,
                                               size_t subscriptionCount,
                                               uint16_t packetId,
-                                              size_t remainingLength );
+                                              size_t remainingLength,
+                                              uint32_t subscriptionId );
 
 /**
  * @brief Send MQTT UNSUBSCRIBE message without copying the user data into a buffer and
@@ -229,6 +371,238 @@ static MQTTStatus_t sendUnsubscribeWithoutCopy( MQTTContext_t * pContext,
                                                 uint16_t packetId,
                                                 size_t remainingLength );
 
+/**
+ * @brief Get the number of topic filters from the start of a list which fit
+ * in the payload of one bulk SUBSCRIBE or UNSUBSCRIBE packet.
+ *
+ * @param[in] pSubscriptionList List of MQTT subscription info.
+ * @param[in] subscriptionCount The count of elements in the list.
+ * @param[in] payloadLimit The largest payload of a packet.
+ * @param[in] isSubscribe Whether the packet is a SUBSCRIBE.
+ *
+ * @return The number of topic filters, 0 if the first one does not fit.
+ */
+static size_t getBulkPacketFilterCount( const MQTTSubscribeInfo_t * pSubscriptionList,
+                                        size_t subscriptionCount,
+                                        size_t payloadLimit,
+                                        bool isSubscribe );
+
+/**
+ * @brief Serialize a SUBSCRIBE or UNSUBSCRIBE packet into a staging buffer
+ * and send it with a single call to the transport.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] pSubscriptionList List of MQTT subscription info.
+ * @param[in] subscriptionCount The count of elements in the list.
+ * @param[in] pStagingBuffer The buffer the packet is serialized into.
+ * @param[in] isSubscribe Whether the packet is a SUBSCRIBE.
+ * @param[out] pPacketId The packet ID of the packet sent.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTStatusNotConnected or #MQTTStatusDisconnectPending if the connection
+ * is not usable; #MQTTSendFailed if the transport write failed;
+ * #MQTTSuccess otherwise.
+ */
+static MQTTStatus_t sendBulkPacket( MQTTContext_t * pContext,
+                                    const MQTTSubscribeInfo_t * pSubscriptionList,
+                                    size_t subscriptionCount,
+                                    const MQTTFixedBuffer_t * pStagingBuffer,
+                                    bool isSubscribe,
+                                    uint16_t * pPacketId );
+
+/**
+ * @brief Send a list of topic filters as SUBSCRIBE or UNSUBSCRIBE packets
+ * which fill a staging buffer, one after the other.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] pSubscriptionList List of MQTT subscription info.
+ * @param[in] subscriptionCount The count of elements in the list.
+ * @param[in] pStagingBuffer The buffer the packets are serialized into.
+ * @param[out] pPacketIds The packet IDs of the packets sent.
+ * @param[in,out] pPacketIdCount The capacity of @p pPacketIds on input, the
+ * number of packets sent on output.
+ * @param[in] isSubscribe Whether the packets are SUBSCRIBEs.
+ *
+ * @return The status of #MQTT_SubscribeBulk or #MQTT_UnsubscribeBulk.
+ */
+static MQTTStatus_t sendBulkSubscribeUnsubscribe( MQTTContext_t * pContext,
+                                                  const MQTTSubscribeInfo_t * pSubscriptionList,
+                                                  size_t subscriptionCount,
+                                                  const MQTTFixedBuffer_t * pStagingBuffer,
+                                                  uint16_t * pPacketIds,
+                                                  size_t * pPacketIdCount,
+                                                  bool isSubscribe );
+
+/**
+ * @brief Find the record of a topic filter in the subscription registry.
+ *
+ * @param[in] pContext Initialized MQTT context with a subscription registry.
+ * @param[in] pTopicFilter The topic filter.
+ * @param[in] topicFilterLength Length of the topic filter.
+ * @param[in] filterHash Hash of the topic filter as calculated by #hashTopic.
+ * @param[out] ppFreeRecord The first empty record, or NULL if the registry
+ * is full. May be NULL.
+ *
+ * @return The record of the topic filter, or NULL if it is not recorded.
+ */
+static MQTTSubscriptionRecord_t * findSubscriptionRecord( const MQTTContext_t * pContext,
+                                                          const char * pTopicFilter,
+                                                          uint16_t topicFilterLength,
+                                                          uint32_t filterHash,
+                                                          MQTTSubscriptionRecord_t ** ppFreeRecord );
+
+/**
+ * @brief Record the topic filters of a SUBSCRIBE in the subscription registry,
+ * as awaiting the SUBACK of the packet.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] pSubscriptionList List of MQTT subscription info.
+ * @param[in] subscriptionCount The count of elements in the list.
+ * @param[in] packetId The packet ID of the SUBSCRIBE.
+ * @param[in] subscriptionId The MQTT 5 Subscription Identifier of the
+ * SUBSCRIBE, or 0 if it has none.
+ */
+static void recordSubscriptions( MQTTContext_t * pContext,
+                                 const MQTTSubscribeInfo_t * pSubscriptionList,
+                                 size_t subscriptionCount,
+                                 uint16_t packetId,
+                                 uint32_t subscriptionId );
+
+/**
+ * @brief Remove the topic filters of an UNSUBSCRIBE from the subscription
+ * registry.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] pSubscriptionList List of MQTT subscription info.
+ * @param[in] subscriptionCount The count of elements in the list.
+ */
+static void removeSubscriptions( MQTTContext_t * pContext,
+                                 const MQTTSubscribeInfo_t * pSubscriptionList,
+                                 size_t subscriptionCount );
+
+/**
+ * @brief Update the records of the subscription registry awaiting a SUBACK
+ * with its return codes.
+ *
+ * A topic filter with a failure code, or without a code, is removed from the
+ * registry unless a previous SUBACK granted it.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] packetId The packet ID of the SUBACK.
+ * @param[in] pSubAckCodes The return codes of the SUBACK.
+ * @param[in] subAckCodeCount The number of return codes.
+ */
+static void completeSubscriptions( MQTTContext_t * pContext,
+                                   uint16_t packetId,
+                                   const uint8_t * pSubAckCodes,
+                                   size_t subAckCodeCount );
+
+/**
+ * @brief Update the subscription registry with a SUBACK received from the
+ * broker.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] pIncomingPacket The SUBACK.
+ * @param[in] packetId The packet ID of the SUBACK.
+ */
+static void handleRegistrySubAck( MQTTContext_t * pContext,
+                                  const MQTTPacketInfo_t * pIncomingPacket,
+                                  uint16_t packetId );
+
+/**
+ * @brief Send the SUBSCRIBE packets subscribing again to the topic filters of
+ * the subscription registry with a given Subscription Identifier, starting
+ * from the first record with it.
+ *
+ * @param[in] pContext Initialized and connected MQTT context.
+ * @param[in] firstIndex Index of the first record with @p subscriptionId.
+ * @param[in] subscriptionId The Subscription Identifier of the SUBSCRIBE
+ * packets, or 0 for none.
+ * @param[in,out] pFilterCount Incremented by the number of topic filters sent.
+ * @param[in,out] pPacketCount Incremented by the number of packets sent.
+ *
+ * @return #MQTTSendFailed if a transport write failed; #MQTTSuccess otherwise.
+ */
+static MQTTStatus_t sendRegistrySubscribes( MQTTContext_t * pContext,
+                                            size_t firstIndex,
+                                            uint32_t subscriptionId,
+                                            size_t * pFilterCount,
+                                            size_t * pPacketCount );
+
+/**
+ * @brief Subscribe again to the topic filters of the subscription registry
+ * after the broker started a new session, with SUBSCRIBE packets which fill
+ * the staging buffer of the registry.
+ *
+ * @param[in] pContext Initialized and connected MQTT context.
+ *
+ * @return #MQTTSendFailed if a transport write failed; #MQTTSuccess otherwise.
+ */
+static MQTTStatus_t resubscribeFromRegistry( MQTTContext_t * pContext );
+
+/**
+ * @brief Take a free completion token for an operation before its packet is
+ * sent.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] packetId The packet ID of the operation.
+ * @param[in] ackType The type of the packet completing the operation.
+ * @param[in] callback The completion callback.
+ * @param[in] pUserData The user data given to the callback.
+ *
+ * @return #MQTTBadParameter if the context has no completion token table;
+ * #MQTTStateCollision if a token is held for the same packet ID and ack type;
+ * #MQTTNoMemory if no token is free; #MQTTSuccess otherwise.
+ */
+static MQTTStatus_t reserveCompletionToken( MQTTContext_t * pContext,
+                                            uint16_t packetId,
+                                            uint8_t ackType,
+                                            MQTTCompletionCallback_t callback,
+                                            void * pUserData );
+
+/**
+ * @brief Free the completion token of an operation.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] packetId The packet ID of the operation.
+ * @param[in] ackType The type of the packet completing the operation.
+ * @param[out] pToken A copy of the token.
+ *
+ * @return Whether a token was held for the operation.
+ */
+static bool releaseCompletionToken( MQTTContext_t * pContext,
+                                    uint16_t packetId,
+                                    uint8_t ackType,
+                                    MQTTCompletionToken_t * pToken );
+
+/**
+ * @brief Invoke the completion callback of an operation acknowledged by the
+ * broker, if it holds a completion token.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] pAckPacket The acknowledgement.
+ * @param[in] packetId The packet ID of the acknowledgement.
+ * @param[in] ackType The type of the packet awaited by the operation, which
+ * differs from that of @p pAckPacket for a PUBREC refusing a QoS2 publish.
+ * @param[in] status The status given to the callback.
+ */
+static void completeOperation( MQTTContext_t * pContext,
+                               MQTTPacketInfo_t * pAckPacket,
+                               uint16_t packetId,
+                               uint8_t ackType,
+                               MQTTStatus_t status );
+
+/**
+ * @brief Invoke the completion callbacks of the operations abandoned by a new
+ * connection with #MQTTStatusNotConnected, and free their tokens.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] sessionPresent Whether the broker kept the session, in which
+ * case outgoing publishes are still completed.
+ */
+static void abandonOperations( MQTTContext_t * pContext,
+                               bool sessionPresent );
+
 /**
  * @brief Calculate the interval between two millisecond timestamps, including
  * when the later value has overflowed.
@@ -245,14 +619,17 @@ static MQTTStatus_t sendUnsubscribeWithoutCopy( MQTTContext_t * pContext,
 static uint32_t calculateElapsedTime( uint32_t later,
                                       uint32_t start );
 
-/**
- * @brief Convert a byte indicating a publish ack type to an #MQTTPubAckType_t.
- *
- * @param[in] packetType First byte of fixed header.
- *
- * @return Type of ack.
- */
-static MQTTPubAckType_t getAckFromPacketType( uint8_t packetType );
+#if ( MQTT_QOS0_ONLY == 0 )
+
+    /**
+     * @brief Convert a byte indicating a publish ack type to an #MQTTPubAckType_t.
+     *
+     * @param[in] packetType First byte of fixed header.
+     *
+     * @return Type of ack.
+     */
+    static MQTTPubAckType_t getAckFromPacketType( uint8_t packetType );
+#endif /* if ( MQTT_QOS0_ONLY == 0 ) */
 
 /**
  * @brief Receive bytes into the network buffer.
@@ -269,6 +646,7 @@ static MQTTPubAckType_t getAckFromPacketType( uint8_t packetType );
  *                    OR
  * 3. There is an error in reading from the network.
  *
+ * Between calls which receive nothing, it waits with #waitForTransport.
  *
  * @return Number of bytes received, or negative number on network error.
  */
@@ -312,28 +690,34 @@ static MQTTStatus_t receivePacket( MQTTContext_t * pContext,
                                    MQTTPacketInfo_t incomingPacket,
                                    uint32_t remainingTimeMs );
 
-/**
- * @brief Get the correct ack type to send.
- *
- * @param[in] state Current state of publish.
- *
- * @return Packet Type byte of PUBACK, PUBREC, PUBREL, or PUBCOMP if one of
- * those should be sent, else 0.
- */
-static uint8_t getAckTypeToSend( MQTTPublishState_t state );
+#if ( MQTT_QOS0_ONLY == 0 )
 
-/**
- * @brief Send acks for received QoS 1/2 publishes.
- *
- * @param[in] pContext MQTT Connection context.
- * @param[in] packetId packet ID of original PUBLISH.
- * @param[in] publishState Current publish state in record.
- *
- * @return #MQTTSuccess, #MQTTIllegalState or #MQTTSendFailed.
- */
-static MQTTStatus_t sendPublishAcks( MQTTContext_t * pContext,
-                                     uint16_t packetId,
-                                     MQTTPublishState_t publishState );
+    /**
+     * @brief Get the correct ack type to send.
+     *
+     * @param[in] state Current state of publish.
+     *
+     * @return Packet Type byte of PUBACK, PUBREC, PUBREL, or PUBCOMP if one of
+     * those should be sent, else 0.
+     */
+    static uint8_t getAckTypeToSend( MQTTPublishState_t state );
+#endif /* if ( MQTT_QOS0_ONLY == 0 ) */
+
+#if ( MQTT_QOS0_ONLY == 0 )
+
+    /**
+     * @brief Send acks for received QoS 1/2 publishes.
+     *
+     * @param[in] pContext MQTT Connection context.
+     * @param[in] packetId packet ID of original PUBLISH.
+     * @param[in] publishState Current publish state in record.
+     *
+     * @return #MQTTSuccess, #MQTTIllegalState or #MQTTSendFailed.
+     */
+    static MQTTStatus_t sendPublishAcks( MQTTContext_t * pContext,
+                                         uint16_t packetId,
+                                         MQTTPublishState_t publishState );
+#endif /* if ( MQTT_QOS0_ONLY == 0 ) */
 
 /**
  * @brief Send a keep alive PINGREQ if the keep alive interval has elapsed.
@@ -356,16 +740,19 @@ static MQTTStatus_t handleKeepAlive( MQTTContext_t * pContext );
 static MQTTStatus_t handleIncomingPublish( MQTTContext_t * pContext,
                                            MQTTPacketInfo_t * pIncomingPacket );
 
-/**
- * @brief Handle received MQTT publish acks.
- *
- * @param[in] pContext MQTT Connection context.
- * @param[in] pIncomingPacket Incoming packet.
- *
- * @return MQTTSuccess, MQTTIllegalState, or deserialization error.
- */
-static MQTTStatus_t handlePublishAcks( MQTTContext_t * pContext,
-                                       MQTTPacketInfo_t * pIncomingPacket );
+#if ( MQTT_QOS0_ONLY == 0 )
+
+    /**
+     * @brief Handle received MQTT publish acks.
+     *
+     * @param[in] pContext MQTT Connection context.
+     * @param[in] pIncomingPacket Incoming packet.
+     *
+     * @return MQTTSuccess, MQTTIllegalState, or deserialization error.
+     */
+    static MQTTStatus_t handlePublishAcks( MQTTContext_t * pContext,
+                                           MQTTPacketInfo_t * pIncomingPacket );
+#endif /* if ( MQTT_QOS0_ONLY == 0 ) */
 
 /**
  * @brief Handle received MQTT ack.
@@ -381,6 +768,21 @@ static MQTTStatus_t handleIncomingAck( MQTTContext_t * pContext,
                                        MQTTPacketInfo_t * pIncomingPacket,
                                        bool manageKeepAlive );
 
+/**
+ * @brief Handle a DISCONNECT or AUTH received from an MQTT 5 server.
+ *
+ * The packet is given to the application callback with its reason code. A
+ * DISCONNECT then ends the connection, which the application closes.
+ *
+ * @param[in] pContext MQTT Connection context.
+ * @param[in] pIncomingPacket Incoming packet.
+ *
+ * @return #MQTTStatusNotConnected after a DISCONNECT; #MQTTBadResponse for an
+ * AUTH, a packet of an MQTT 3.1.1 server or an invalid packet.
+ */
+static MQTTStatus_t handleIncomingDisconnect( MQTTContext_t * pContext,
+                                              MQTTPacketInfo_t * pIncomingPacket );
+
 /**
  * @brief Run a single iteration of the receive loop.
  *
@@ -424,6 +826,7 @@ static MQTTStatus_t validateSubscribeUnsubscribeParams( const MQTTContext_t * pC
  * @param[out] pIncomingPacket List of MQTT subscription info.
  * @param[out] pSessionPresent Whether a previous session was present.
  * Only relevant if not establishing a clean session.
+ * @param[out] pConnackProperties Properties of an MQTT 5 CONNACK.
  *
  * @return #MQTTBadResponse if a bad response is received;
  * #MQTTNoDataAvailable if no data available for transport recv;
@@ -434,17 +837,21 @@ static MQTTStatus_t receiveConnack( MQTTContext_t * pContext,
                                     uint32_t timeoutMs,
                                     bool cleanSession,
                                     MQTTPacketInfo_t * pIncomingPacket,
-                                    bool * pSessionPresent );
+                                    bool * pSessionPresent,
+                                    MQTTConnackProperties_t * pConnackProperties );
 
-/**
- * @brief Resends pending acks for a re-established MQTT session
- *
- * @param[in] pContext Initialized MQTT context.
- *
- * @return #MQTTSendFailed if transport send during resend failed;
- * #MQTTSuccess otherwise.
- */
-static MQTTStatus_t handleUncleanSessionResumption( MQTTContext_t * pContext );
+#if ( MQTT_QOS0_ONLY == 0 )
+
+    /**
+     * @brief Resends pending acks for a re-established MQTT session
+     *
+     * @param[in] pContext Initialized MQTT context.
+     *
+     * @return #MQTTSendFailed if transport send during resend failed;
+     * #MQTTSuccess otherwise.
+     */
+    static MQTTStatus_t handleUncleanSessionResumption( MQTTContext_t * pContext );
+#endif /* if ( MQTT_QOS0_ONLY == 0 ) */
 
 /**
  * @brief Clears existing state records for a clean session.
@@ -465,6 +872,9 @@ static MQTTStatus_t handleCleanSession( MQTTContext_t * pContext );
  * the encoded length of the packet; and the encoded length of the topic string.
  * @brief param[in] headerSize Size of the serialized PUBLISH header.
  * @brief param[in] packetId Packet Id of the publish packet.
+ * @brief param[in] pProperties The serialized properties of an MQTT 5 PUBLISH.
+ * NULL for MQTT 3.1.1.
+ * @brief param[in] propertiesSize Size of the serialized properties.
  *
  * @return #MQTTSendFailed if transport send during resend failed;
  * #MQTTSuccess otherwise.
@@ -473,7 +883,25 @@ static MQTTStatus_t sendPublishWithoutCopy( MQTTContext_t * pContext,
                                             const MQTTPublishInfo_t * pPublishInfo,
                                             uint8_t * pMqttHeader,
                                             size_t headerSize,
-                                            uint16_t packetId );
+                                            uint16_t packetId,
+                                            uint8_t * pProperties,
+                                            size_t propertiesSize );
+
+/**
+ * @brief Serialize and send an MQTT 5 PUBLISH, with a topic alias if one can be
+ * used for its topic.
+ *
+ * @param[in] pContext Initialized MQTT context using #MQTT_VERSION_5.
+ * @param[in] pPublishInfo MQTT PUBLISH packet parameters.
+ * @param[in] packetId Packet Id of the publish packet.
+ *
+ * @return #MQTTBadParameter if the packet cannot be serialized;
+ * #MQTTSendFailed if transport send failed;
+ * #MQTTSuccess otherwise.
+ */
+static MQTTStatus_t sendPublishV5( MQTTContext_t * pContext,
+                                   const MQTTPublishInfo_t * pPublishInfo,
+                                   uint16_t packetId );
 
 /**
  * @brief Function to validate #MQTT_Publish parameters.
@@ -489,6 +917,112 @@ static MQTTStatus_t validatePublishParams( const MQTTContext_t * pContext,
                                            const MQTTPublishInfo_t * pPublishInfo,
                                            uint16_t packetId );
 
+/**
+ * @brief Load a word of topic characters without any alignment requirement.
+ *
+ * @param[in] pCharacters The first of #CORE_MQTT_TOPIC_WORD_SIZE characters to
+ * load.
+ *
+ * @return The characters packed in a word in native byte order.
+ */
+static uint32_t loadTopicWord( const char * pCharacters );
+
+/**
+ * @brief Determine whether any byte of a topic word is equal to a value.
+ *
+ * @param[in] word The topic word to examine.
+ * @param[in] value The byte value to look for.
+ *
+ * @return `true` if at least one byte of @p word is equal to @p value;
+ * `false` otherwise.
+ */
+static bool topicWordHasByte( uint32_t word,
+                              uint8_t value );
+
+/**
+ * @brief Determine whether a topic word contains only ASCII characters
+ * which need no further validation.
+ *
+ * Such a word has no NUL character, no multi-byte UTF-8 sequence, no level
+ * separator and no wildcard.
+ *
+ * @param[in] word The topic word to examine.
+ *
+ * @return `true` if the whole word may be skipped during validation; `false`
+ * if it must be examined a character at a time.
+ */
+static bool isPlainTopicWord( uint32_t word );
+
+/**
+ * @brief Find the next '/' level separator in a topic name or topic filter.
+ *
+ * @param[in] pTopic The topic string.
+ * @param[in] startIndex Index of the first character to examine.
+ * @param[in] topicLength Length of the topic string.
+ *
+ * @return Index of the next level separator, or @p topicLength if there is no
+ * level separator after @p startIndex.
+ */
+static uint16_t findLevelSeparator( const char * pTopic,
+                                    uint16_t startIndex,
+                                    uint16_t topicLength );
+
+/**
+ * @brief Get the length of a well-formed UTF-8 sequence.
+ *
+ * Overlong encodings, encodings of the surrogate code points U+D800 to U+DFFF
+ * and code points beyond U+10FFFF are not well-formed.
+ *
+ * @param[in] pBytes The sequence, starting with its lead byte.
+ * @param[in] remainingLength Number of bytes available at @p pBytes.
+ *
+ * @return Length of the sequence in bytes, or 0 if it is not well-formed.
+ */
+static size_t getUtf8SequenceLength( const uint8_t * pBytes,
+                                     size_t remainingLength );
+
+/**
+ * @brief Check that a wildcard character of a topic filter occupies an entire
+ * level, and that a multi-level wildcard is the last character of the filter.
+ *
+ * @param[in] pTopicFilter The topic filter.
+ * @param[in] topicFilterLength Length of the topic filter.
+ * @param[in] wildcardIndex Index of the '+' or '#' character.
+ *
+ * @return `true` if the wildcard is placed correctly; `false` otherwise.
+ */
+static bool isWildcardPlacementValid( const char * pTopicFilter,
+                                      uint16_t topicFilterLength,
+                                      uint16_t wildcardIndex );
+
+/**
+ * @brief Validate a topic and find its level separators without logging.
+ *
+ * This is the scan of #MQTT_ValidateTopic, which logs the reason a topic is
+ * rejected. It is also used on received topic names, which may be invalid or
+ * have many levels without the application being at fault.
+ *
+ * @param[in] pTopic The topic name or topic filter.
+ * @param[in] topicLength Length of the topic.
+ * @param[in] isTopicFilter Whether @p pTopic may contain wildcards.
+ * @param[out] pLevelOffsets Array to store the level separator offsets in, or
+ * NULL.
+ * @param[in] maxLevelCount Number of entries in @p pLevelOffsets.
+ * @param[out] pLevelCount Number of level separators in the topic.
+ * @param[out] pInvalidIndex Index of the character which makes the topic
+ * invalid.
+ *
+ * @return #MQTTBadParameter if the topic is not valid; #MQTTNoMemory if it has
+ * more than @p maxLevelCount level separators; #MQTTSuccess otherwise.
+ */
+static MQTTStatus_t scanTopic( const char * pTopic,
+                               uint16_t topicLength,
+                               bool isTopicFilter,
+                               uint16_t * pLevelOffsets,
+                               size_t maxLevelCount,
+                               size_t * pLevelCount,
+                               uint16_t * pInvalidIndex );
+
 /**
  * @brief Performs matching for special cases when a topic filter ends
  * with a wildcard character.
@@ -526,6 +1060,12 @@ static bool matchEndWildcardsSpecialCases( const char * pTopicFilter,
  * @param[in] topicNameLength Length of the topic name.
  * @param[in] pTopicFilter The topic filter to match.
  * @param[in] topicFilterLength Length of the topic filter.
+ * @param[in] pNameLevelOffsets Offsets of all the level separators of the
+ * topic name, as given by #MQTT_ValidateTopic, or NULL to search the topic
+ * name for them.
+ * @param[in] nameLevelCount Number of entries in @p pNameLevelOffsets.
+ * @param[in,out] pNameLevel Index of the first entry of @p pNameLevelOffsets
+ * which may be at or after the current index in the topic name.
  * @param[in,out] pNameIndex Current index in the topic name being examined. It is
  * advanced by one level for `+` wildcards.
  * @param[in, out] pFilterIndex Current index in the topic filter being examined.
@@ -539,6 +1079,9 @@ static bool matchWildcards( const char * pTopicName,
                             uint16_t topicNameLength,
                             const char * pTopicFilter,
                             uint16_t topicFilterLength,
+                            const uint16_t * pNameLevelOffsets,
+                            size_t nameLevelCount,
+                            size_t * pNameLevel,
                             uint16_t * pNameIndex,
                             uint16_t * pFilterIndex,
                             bool * pMatch );
@@ -550,19 +1093,558 @@ static bool matchWildcards( const char * pTopicName,
  * @param[in] topicNameLength Length of the topic name.
  * @param[in] pTopicFilter The topic filter to check.
  * @param[in] topicFilterLength Length of topic filter.
+ * @param[in] pNameLevelOffsets Offsets of all the level separators of the
+ * topic name, or NULL.
+ * @param[in] nameLevelCount Number of entries in @p pNameLevelOffsets.
  *
  * @return `true` if the topic name and topic filter match; `false` otherwise.
  */
 static bool matchTopicFilter( const char * pTopicName,
                               uint16_t topicNameLength,
                               const char * pTopicFilter,
-                              uint16_t topicFilterLength );
-
-/*-----------------------------------------------------------*/
+                              uint16_t topicFilterLength,
+                              const uint16_t * pNameLevelOffsets,
+                              size_t nameLevelCount );
 
-static bool matchEndWildcardsSpecialCases( const char * pTopicFilter,
-                                           uint16_t topicFilterLength,
-                                           uint16_t filterIndex )
+/**
+ * @brief Match a valid topic name and topic filter, as #MQTT_MatchTopic does.
+ *
+ * @param[in] pTopicName The topic name to check.
+ * @param[in] topicNameLength Length of the topic name.
+ * @param[in] pTopicFilter The topic filter to check.
+ * @param[in] topicFilterLength Length of topic filter.
+ * @param[in] pNameLevelOffsets Offsets of all the level separators of the
+ * topic name, as given by #MQTT_ValidateTopic, or NULL.
+ * @param[in] nameLevelCount Number of entries in @p pNameLevelOffsets.
+ *
+ * @return `true` if the topic name and topic filter match; `false` otherwise.
+ */
+static bool matchTopic( const char * pTopicName,
+                        uint16_t topicNameLength,
+                        const char * pTopicFilter,
+                        uint16_t topicFilterLength,
+                        const uint16_t * pNameLevelOffsets,
+                        size_t nameLevelCount );
+
+/**
+ * @brief Calculate the hash of a topic name or topic filter for the exact-match
+ * topic handler table.
+ *
+ * @param[in] pTopic The topic string.
+ * @param[in] topicLength Length of the topic string.
+ *
+ * @return 32-bit FNV-1a hash of the topic string.
+ */
+static uint32_t hashTopic( const char * pTopic,
+                           uint16_t topicLength );
+
+/**
+ * @brief Get the length of the literal levels of a topic filter which precede
+ * its first wildcard.
+ *
+ * The returned prefix excludes the level separator before the wildcard, so
+ * that the prefix of "sport/#" is "sport", which is also matched by the
+ * topic name "sport".
+ *
+ * @param[in] pTopicFilter The topic filter.
+ * @param[in] topicFilterLength Length of the topic filter.
+ * @param[out] pHasWildcard Whether the topic filter contains a wildcard.
+ *
+ * @return Length of the literal prefix of the topic filter.
+ */
+static uint16_t getTopicFilterPrefixLength( const char * pTopicFilter,
+                                            uint16_t topicFilterLength,
+                                            bool * pHasWildcard );
+
+/**
+ * @brief Look up a topic in the exact-match topic handler table.
+ *
+ * @param[in] pContext Context with an initialized exact-match table.
+ * @param[in] pTopic The topic name or topic filter to look up.
+ * @param[in] topicLength Length of the topic.
+ * @param[in] topicHash Hash of the topic as calculated by #hashTopic.
+ * @param[out] pFound Whether a record for the topic was found.
+ *
+ * @return Index of the record of the topic if found; otherwise the index of the
+ * empty record where it would be inserted, or the table size if the table is full.
+ */
+static size_t findExactTopicHandler( const MQTTContext_t * pContext,
+                                     const char * pTopic,
+                                     uint16_t topicLength,
+                                     uint32_t topicHash,
+                                     bool * pFound );
+
+/**
+ * @brief Remove a record from the exact-match topic handler table.
+ *
+ * Records following the removed one in its probe sequence are shifted back
+ * so that lookups never need to skip deleted records.
+ *
+ * @param[in] pContext Context with an initialized exact-match table.
+ * @param[in] index Index of the record to remove.
+ */
+static void removeExactTopicHandler( MQTTContext_t * pContext,
+                                     size_t index );
+
+/**
+ * @brief Find the record of a topic filter in the wildcard topic handler list.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] pTopicFilter The topic filter to find.
+ * @param[in] topicFilterLength Length of the topic filter.
+ *
+ * @return Index of the record if found; the number of registered wildcard
+ * handlers otherwise.
+ */
+static size_t findWildcardTopicHandler( const MQTTContext_t * pContext,
+                                        const char * pTopicFilter,
+                                        uint16_t topicFilterLength );
+
+/**
+ * @brief Give an incoming publish to the handlers registered for its MQTT 5
+ * Subscription Identifiers, or else to the registered topic handler matching
+ * its topic, or to the application callback if there is none.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] pIncomingPacket The incoming PUBLISH packet.
+ * @param[in] pDeserializedInfo Deserialized information of the PUBLISH.
+ */
+static void dispatchIncomingPublish( MQTTContext_t * pContext,
+                                     MQTTPacketInfo_t * pIncomingPacket,
+                                     MQTTDeserializedInfo_t * pDeserializedInfo );
+
+/**
+ * @brief Borrow a network buffer from the buffer pool of a context, if it has
+ * one and is not already receiving a packet.
+ *
+ * If the pool is exhausted, the context keeps using the network buffer given
+ * to #MQTT_Init.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ *
+ * @return #MQTTNoMemory if the pool is exhausted and the context has no network
+ * buffer of its own; #MQTTSuccess otherwise.
+ */
+static MQTTStatus_t borrowNetworkBuffer( MQTTContext_t * pContext );
+
+/**
+ * @brief Return the network buffer of a context to its buffer pool, if it was
+ * borrowed and holds no received data.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ */
+static void releaseNetworkBuffer( MQTTContext_t * pContext );
+
+/**
+ * @brief Take a buffer from the free list of a buffer pool.
+ *
+ * @param[in] pBufferPool Initialized buffer pool.
+ *
+ * @return The buffer, or NULL if the pool is exhausted.
+ */
+static uint8_t * takePoolBuffer( MQTTBufferPool_t * pBufferPool );
+
+/**
+ * @brief Put a buffer back on the free list of its buffer pool.
+ *
+ * @param[in] pBufferPool Initialized buffer pool.
+ * @param[in] pBuffer A buffer taken from @p pBufferPool.
+ */
+static void givePoolBuffer( MQTTBufferPool_t * pBufferPool,
+                            uint8_t * pBuffer );
+
+/**
+ * @brief Move the data received after a packet from the network buffer to
+ * the front of the buffer, or to the replacement buffer if the application
+ * claimed the network buffer while the packet was processed.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] packetLength Length of the processed packet at the front of the
+ * network buffer.
+ */
+static void consumeNetworkBuffer( MQTTContext_t * pContext,
+                                  size_t packetLength );
+
+#if ( MQTT_QOS0_ONLY == 0 )
+
+    /**
+     * @brief Claim a free chunk of a state record slab.
+     *
+     * @param[in] pRecordSlab Initialized state record slab.
+     *
+     * @return The first record of the claimed chunk, or NULL if no chunk is free.
+     */
+    static MQTTPubAckInfo_t * claimSlabChunk( MQTTRecordSlab_t * pRecordSlab );
+#endif /* if ( MQTT_QOS0_ONLY == 0 ) */
+
+#if ( MQTT_QOS0_ONLY == 0 )
+
+    /**
+     * @brief Give a chunk back to the state record slab it was claimed from.
+     *
+     * @param[in] pRecordSlab Initialized state record slab.
+     * @param[in] pChunk The first record of the chunk.
+     */
+    static void releaseSlabChunk( MQTTRecordSlab_t * pRecordSlab,
+                                  MQTTPubAckInfo_t * pChunk );
+#endif /* if ( MQTT_QOS0_ONLY == 0 ) */
+
+#if ( MQTT_QOS0_ONLY == 0 )
+
+    /**
+     * @brief Claim a chunk of state records for the outgoing or incoming publishes
+     * of a context using a state record slab, if it does not already hold one.
+     *
+     * @param[in] pContext Initialized MQTT context.
+     * @param[in] isOutgoing Whether the records are for outgoing publishes.
+     *
+     * @return #MQTTNoMemory if a chunk is needed but none is free;
+     * #MQTTSuccess otherwise.
+     */
+    static MQTTStatus_t claimStateRecords( MQTTContext_t * pContext,
+                                           bool isOutgoing );
+#endif /* if ( MQTT_QOS0_ONLY == 0 ) */
+
+#if ( MQTT_QOS0_ONLY == 0 )
+
+    /**
+     * @brief Give back the chunks of state records of a context using a state
+     * record slab which no longer hold any publish.
+     *
+     * @param[in] pContext Initialized MQTT context.
+     */
+    static void releaseStateRecords( MQTTContext_t * pContext );
+#endif /* if ( MQTT_QOS0_ONLY == 0 ) */
+
+/**
+ * @brief Deserialize an incoming PUBLISH with the protocol version of a context.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] pIncomingPacket The incoming PUBLISH.
+ * @param[out] pPacketId The packet ID of the PUBLISH.
+ * @param[out] pPublishInfo The deserialized PUBLISH.
+ * @param[out] pSubscriptionIds Array of #MQTT_MAX_SUBSCRIPTION_IDS entries
+ * receiving the MQTT 5 Subscription Identifiers of the PUBLISH.
+ * @param[out] pSubscriptionIdCount The number of Subscription Identifiers.
+ *
+ * @return The status of #MQTT_DeserializePublish or #MQTT_DeserializePublishV5.
+ */
+static MQTTStatus_t deserializeIncomingPublish( const MQTTContext_t * pContext,
+                                                const MQTTPacketInfo_t * pIncomingPacket,
+                                                uint16_t * pPacketId,
+                                                MQTTPublishInfo_t * pPublishInfo,
+                                                uint32_t * pSubscriptionIds,
+                                                size_t * pSubscriptionIdCount );
+
+/**
+ * @brief Deserialize an incoming ack other than CONNACK with the protocol
+ * version of a context.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] pIncomingPacket The incoming ack.
+ * @param[out] pPacketId The packet ID of the ack.
+ *
+ * @return The status of #MQTT_DeserializeAck or #MQTT_DeserializeAckV5.
+ */
+static MQTTStatus_t deserializeIncomingAck( const MQTTContext_t * pContext,
+                                            const MQTTPacketInfo_t * pIncomingPacket,
+                                            uint16_t * pPacketId );
+
+/**
+ * @brief Forget the topic aliases of a context for a new connection.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] topicAliasMaximum The Topic Alias Maximum of the broker.
+ */
+static void resetTopicAliases( MQTTContext_t * pContext,
+                               uint16_t topicAliasMaximum );
+
+/**
+ * @brief Find the topic alias of a topic, or assign it a free or the least
+ * recently used alias.
+ *
+ * @param[in] pContext Initialized MQTT context with topic aliases.
+ * @param[in] pTopicName The topic name.
+ * @param[in] topicNameLength Length of the topic name.
+ * @param[out] pAssigned Whether the alias was assigned to the topic by this call,
+ * in which case the topic name must be sent along with it.
+ *
+ * @return The topic alias, or 0 if the topic is too long for an alias.
+ */
+static uint16_t getTopicAlias( MQTTContext_t * pContext,
+                               const char * pTopicName,
+                               uint16_t topicNameLength,
+                               bool * pAssigned );
+
+/*-----------------------------------------------------------*/
+
+static uint32_t loadTopicWord( const char * pCharacters )
+{
+    uint32_t word;
+
+    assert( pCharacters != NULL );
+
+    ( void ) memcpy( &word, pCharacters, CORE_MQTT_TOPIC_WORD_SIZE );
+
+    return word;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool topicWordHasByte( uint32_t word,
+                              uint8_t value )
+{
+    uint32_t difference = word ^ ( ( uint32_t ) value * CORE_MQTT_TOPIC_WORD_LOW_BITS );
+
+    /* A byte of the difference is zero only where the word holds the value.
+     * Subtracting one from each byte sets the high bit of a zero byte, and
+     * masking with the complement discards bytes which already had it set. */
+    return ( ( difference - CORE_MQTT_TOPIC_WORD_LOW_BITS ) &
+             ~difference & CORE_MQTT_TOPIC_WORD_HIGH_BITS ) != 0UL;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool isPlainTopicWord( uint32_t word )
+{
+    return ( ( word & CORE_MQTT_TOPIC_WORD_HIGH_BITS ) == 0UL ) &&
+           ( topicWordHasByte( word, ( uint8_t ) '\0' ) == false ) &&
+           ( topicWordHasByte( word, ( uint8_t ) '/' ) == false ) &&
+           ( topicWordHasByte( word, ( uint8_t ) '+' ) == false ) &&
+           ( topicWordHasByte( word, ( uint8_t ) '#' ) == false );
+}
+
+/*-----------------------------------------------------------*/
+
+static uint16_t findLevelSeparator( const char * pTopic,
+                                    uint16_t startIndex,
+                                    uint16_t topicLength )
+{
+    uint16_t index = startIndex;
+
+    assert( pTopic != NULL );
+
+    /* Skip whole words which do not contain a level separator. */
+    while( ( ( ( size_t ) index + CORE_MQTT_TOPIC_WORD_SIZE ) <= topicLength ) &&
+           ( topicWordHasByte( loadTopicWord( &pTopic[ index ] ), ( uint8_t ) '/' ) == false ) )
+    {
+        index += ( uint16_t ) CORE_MQTT_TOPIC_WORD_SIZE;
+    }
+
+    while( ( index < topicLength ) && ( pTopic[ index ] != '/' ) )
+    {
+        index++;
+    }
+
+    return index;
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t getUtf8SequenceLength( const uint8_t * pBytes,
+                                     size_t remainingLength )
+{
+    size_t sequenceLength = 0U, index;
+    uint8_t lowerBound = 0x80U, upperBound = 0xBFU;
+
+    assert( pBytes != NULL );
+    assert( remainingLength != 0U );
+
+    /* The ranges of well-formed sequences follow table 3-7 of the Unicode
+     * standard. Only the second byte of a sequence has lead-dependent bounds. */
+    if( ( pBytes[ 0 ] >= 0xC2U ) && ( pBytes[ 0 ] <= 0xDFU ) )
+    {
+        sequenceLength = 2U;
+    }
+    else if( ( pBytes[ 0 ] >= 0xE0U ) && ( pBytes[ 0 ] <= 0xEFU ) )
+    {
+        sequenceLength = 3U;
+
+        if( pBytes[ 0 ] == 0xE0U )
+        {
+            lowerBound = 0xA0U;
+        }
+        else if( pBytes[ 0 ] == 0xEDU )
+        {
+            upperBound = 0x9FU;
+        }
+        else
+        {
+            /* MISRA else */
+        }
+    }
+    else if( ( pBytes[ 0 ] >= 0xF0U ) && ( pBytes[ 0 ] <= 0xF4U ) )
+    {
+        sequenceLength = 4U;
+
+        if( pBytes[ 0 ] == 0xF0U )
+        {
+            lowerBound = 0x90U;
+        }
+        else if( pBytes[ 0 ] == 0xF4U )
+        {
+            upperBound = 0x8FU;
+        }
+        else
+        {
+            /* MISRA else */
+        }
+    }
+    else
+    {
+        /* Continuation bytes, overlong lead bytes 0xC0 and 0xC1, and lead
+         * bytes beyond U+10FFFF are never valid at the start of a sequence. */
+    }
+
+    if( sequenceLength > remainingLength )
+    {
+        sequenceLength = 0U;
+    }
+
+    for( index = 1U; index < sequenceLength; index++ )
+    {
+        if( ( pBytes[ index ] < lowerBound ) || ( pBytes[ index ] > upperBound ) )
+        {
+            sequenceLength = 0U;
+            break;
+        }
+
+        lowerBound = 0x80U;
+        upperBound = 0xBFU;
+    }
+
+    return sequenceLength;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool isWildcardPlacementValid( const char * pTopicFilter,
+                                      uint16_t topicFilterLength,
+                                      uint16_t wildcardIndex )
+{
+    bool isValid;
+
+    assert( pTopicFilter != NULL );
+    assert( wildcardIndex < topicFilterLength );
+
+    /* Both wildcards must be at the start of a level. */
+    isValid = ( wildcardIndex == 0U ) ||
+              ( pTopicFilter[ wildcardIndex - 1U ] == '/' );
+
+    if( isValid == true )
+    {
+        if( pTopicFilter[ wildcardIndex ] == '#' )
+        {
+            /* The multi-level wildcard must be the last character. */
+            isValid = ( wildcardIndex == ( topicFilterLength - 1U ) );
+        }
+        else
+        {
+            /* The single-level wildcard must also end its level. */
+            isValid = ( wildcardIndex == ( topicFilterLength - 1U ) ) ||
+                      ( pTopicFilter[ wildcardIndex + 1U ] == '/' );
+        }
+    }
+
+    return isValid;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t scanTopic( const char * pTopic,
+                               uint16_t topicLength,
+                               bool isTopicFilter,
+                               uint16_t * pLevelOffsets,
+                               size_t maxLevelCount,
+                               size_t * pLevelCount,
+                               uint16_t * pInvalidIndex )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    size_t levelCount = 0U, sequenceLength;
+    uint16_t index = 0U;
+
+    assert( ( pLevelOffsets != NULL ) || ( maxLevelCount == 0U ) );
+    assert( pLevelCount != NULL );
+    assert( pInvalidIndex != NULL );
+
+    while( ( index < topicLength ) && ( status == MQTTSuccess ) )
+    {
+        /* Most topics are runs of plain ASCII characters, so skip them a
+         * word at a time and only examine the remaining characters one
+         * at a time. */
+        if( ( ( ( size_t ) index + CORE_MQTT_TOPIC_WORD_SIZE ) <= topicLength ) &&
+            ( isPlainTopicWord( loadTopicWord( &pTopic[ index ] ) ) == true ) )
+        {
+            index += ( uint16_t ) CORE_MQTT_TOPIC_WORD_SIZE;
+        }
+        else if( ( ( uint8_t ) pTopic[ index ] ) >= 0x80U )
+        {
+            sequenceLength = getUtf8SequenceLength( ( const uint8_t * ) &pTopic[ index ],
+                                                    ( size_t ) topicLength - index );
+
+            if( sequenceLength == 0U )
+            {
+                status = MQTTBadParameter;
+            }
+            else
+            {
+                index += ( uint16_t ) sequenceLength;
+            }
+        }
+        else if( pTopic[ index ] == '\0' )
+        {
+            status = MQTTBadParameter;
+        }
+        else if( pTopic[ index ] == '/' )
+        {
+            if( levelCount < maxLevelCount )
+            {
+                pLevelOffsets[ levelCount ] = index;
+            }
+
+            levelCount++;
+            index++;
+        }
+        else if( ( pTopic[ index ] == '+' ) || ( pTopic[ index ] == '#' ) )
+        {
+            if( ( isTopicFilter == false ) ||
+                ( isWildcardPlacementValid( pTopic, topicLength, index ) == false ) )
+            {
+                status = MQTTBadParameter;
+            }
+            else
+            {
+                index++;
+            }
+        }
+        else
+        {
+            index++;
+        }
+    }
+
+    if( status == MQTTBadParameter )
+    {
+        *pInvalidIndex = index;
+    }
+    else
+    {
+        *pLevelCount = levelCount;
+
+        if( levelCount > maxLevelCount )
+        {
+            status = MQTTNoMemory;
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool matchEndWildcardsSpecialCases( const char * pTopicFilter,
+                                           uint16_t topicFilterLength,
+                                           uint16_t filterIndex )
 {
     bool matchFound = false;
 
@@ -605,6 +1687,9 @@ static bool matchWildcards( const char * pTopicName,
                             uint16_t topicNameLength,
                             const char * pTopicFilter,
                             uint16_t topicFilterLength,
+                            const uint16_t * pNameLevelOffsets,
+                            size_t nameLevelCount,
+                            size_t * pNameLevel,
                             uint16_t * pNameIndex,
                             uint16_t * pFilterIndex,
                             bool * pMatch )
@@ -617,6 +1702,7 @@ static bool matchWildcards( const char * pTopicName,
     assert( topicNameLength != 0U );
     assert( pTopicFilter != NULL );
     assert( topicFilterLength != 0U );
+    assert( pNameLevel != NULL );
     assert( pNameIndex != NULL );
     assert( pFilterIndex != NULL );
     assert( pMatch != NULL );
@@ -635,18 +1721,24 @@ static bool matchWildcards( const char * pTopicName,
 
         /* Move topic name index to the end of the current level. The end of the
          * current level is identified by the last character before the next level
-         * separator '/'. */
-        while( nameIndex < topicNameLength )
+         * separator '/'. The separators found when the topic name was validated
+         * are used when they are given, instead of searching for the next one. */
+        if( pNameLevelOffsets != NULL )
         {
-            /* Exit the loop if we hit the level separator. */
-            if( pTopicName[ nameIndex ] == '/' )
+            while( ( *pNameLevel < nameLevelCount ) &&
+                   ( pNameLevelOffsets[ *pNameLevel ] < nameIndex ) )
             {
-                nextLevelExistsInTopicName = true;
-                break;
+                ( *pNameLevel )++;
             }
 
-            nameIndex += 1;
+            nameIndex = ( *pNameLevel < nameLevelCount ) ?
+                        pNameLevelOffsets[ *pNameLevel ] : topicNameLength;
+        }
+        else
+        {
+            nameIndex = findLevelSeparator( pTopicName, nameIndex, topicNameLength );
         }
+        nextLevelExistsInTopicName = ( nameIndex < topicNameLength );
 
         /* Determine if the topic filter contains a child level after the current level
          * represented by the '+' wildcard. */
@@ -714,10 +1806,13 @@ static bool matchWildcards( const char * pTopicName,
 static bool matchTopicFilter( const char * pTopicName,
                               uint16_t topicNameLength,
                               const char * pTopicFilter,
-                              uint16_t topicFilterLength )
+                              uint16_t topicFilterLength,
+                              const uint16_t * pNameLevelOffsets,
+                              size_t nameLevelCount )
 {
     bool matchFound = false, shouldStopMatching = false;
     uint16_t nameIndex = 0, filterIndex = 0;
+    size_t nameLevel = 0U;
 
     assert( pTopicName != NULL );
     assert( topicNameLength != 0 );
@@ -726,6 +1821,17 @@ static bool matchTopicFilter( const char * pTopicName,
 
     while( ( nameIndex < topicNameLength ) && ( filterIndex < topicFilterLength ) )
     {
+        /* Skip identical runs of characters a word at a time. A run never
+         * includes the last character of either string, so that the end of
+         * topic name checks below are still performed. */
+        while( ( ( ( size_t ) nameIndex + CORE_MQTT_TOPIC_WORD_SIZE ) < topicNameLength ) &&
+               ( ( ( size_t ) filterIndex + CORE_MQTT_TOPIC_WORD_SIZE ) < topicFilterLength ) &&
+               ( loadTopicWord( &pTopicName[ nameIndex ] ) == loadTopicWord( &pTopicFilter[ filterIndex ] ) ) )
+        {
+            nameIndex += ( uint16_t ) CORE_MQTT_TOPIC_WORD_SIZE;
+            filterIndex += ( uint16_t ) CORE_MQTT_TOPIC_WORD_SIZE;
+        }
+
         /* Check if the character in the topic name matches the corresponding
          * character in the topic filter string. */
         if( pTopicName[ nameIndex ] == pTopicFilter[ filterIndex ] )
@@ -747,6 +1853,9 @@ static bool matchTopicFilter( const char * pTopicName,
                                                  topicNameLength,
                                                  pTopicFilter,
                                                  topicFilterLength,
+                                                 pNameLevelOffsets,
+                                                 nameLevelCount,
+                                                 &nameLevel,
                                                  &nameIndex,
                                                  &filterIndex,
                                                  &matchFound );
@@ -777,6 +1886,380 @@ static bool matchTopicFilter( const char * pTopicName,
 
 /*-----------------------------------------------------------*/
 
+static bool matchTopic( const char * pTopicName,
+                        uint16_t topicNameLength,
+                        const char * pTopicFilter,
+                        uint16_t topicFilterLength,
+                        const uint16_t * pNameLevelOffsets,
+                        size_t nameLevelCount )
+{
+    bool topicFilterStartsWithWildcard = false;
+    bool matchStatus = false;
+
+    assert( pTopicName != NULL );
+    assert( topicNameLength != 0U );
+    assert( pTopicFilter != NULL );
+    assert( topicFilterLength != 0U );
+
+    /* Check for an exact match if the incoming topic name and the registered
+     * topic filter length match. */
+    if( topicNameLength == topicFilterLength )
+    {
+        matchStatus = memcmp( pTopicName, pTopicFilter, topicNameLength ) == 0;
+    }
+
+    if( matchStatus == false )
+    {
+        /* If an exact match was not found, match against wildcard characters in
+         * topic filter.*/
+
+        /* Determine if topic filter starts with a wildcard. */
+        topicFilterStartsWithWildcard = ( pTopicFilter[ 0 ] == '+' ) ||
+                                        ( pTopicFilter[ 0 ] == '#' );
+
+        /* Note: According to the MQTT 3.1.1 specification, incoming PUBLISH topic names
+         * starting with "$" character cannot be matched against topic filter starting with
+         * a wildcard, i.e. for example, "$SYS/sport" cannot be matched with "#" or
+         * "+/sport" topic filters. */
+        if( !( ( pTopicName[ 0 ] == '$' ) && ( topicFilterStartsWithWildcard == true ) ) )
+        {
+            matchStatus = matchTopicFilter( pTopicName,
+                                            topicNameLength,
+                                            pTopicFilter,
+                                            topicFilterLength,
+                                            pNameLevelOffsets,
+                                            nameLevelCount );
+        }
+    }
+
+    return matchStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint32_t hashTopic( const char * pTopic,
+                           uint16_t topicLength )
+{
+    uint32_t hash = CORE_MQTT_FNV_OFFSET_BASIS;
+    uint16_t index;
+
+    assert( ( pTopic != NULL ) || ( topicLength == 0U ) );
+
+    for( index = 0U; index < topicLength; index++ )
+    {
+        hash ^= ( uint32_t ) ( ( uint8_t ) pTopic[ index ] );
+        hash *= CORE_MQTT_FNV_PRIME;
+    }
+
+    return hash;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint16_t getTopicFilterPrefixLength( const char * pTopicFilter,
+                                            uint16_t topicFilterLength,
+                                            bool * pHasWildcard )
+{
+    uint16_t index = 0U;
+    uint16_t prefixLength = 0U;
+
+    assert( pTopicFilter != NULL );
+    assert( pHasWildcard != NULL );
+
+    *pHasWildcard = false;
+
+    while( ( index < topicFilterLength ) && ( *pHasWildcard == false ) )
+    {
+        if( ( pTopicFilter[ index ] == '+' ) || ( pTopicFilter[ index ] == '#' ) )
+        {
+            *pHasWildcard = true;
+        }
+        else
+        {
+            /* Remember the end of the last complete literal level. */
+            if( pTopicFilter[ index ] == '/' )
+            {
+                prefixLength = index;
+            }
+
+            index++;
+        }
+    }
+
+    if( *pHasWildcard == false )
+    {
+        prefixLength = topicFilterLength;
+    }
+
+    return prefixLength;
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t findExactTopicHandler( const MQTTContext_t * pContext,
+                                     const char * pTopic,
+                                     uint16_t topicLength,
+                                     uint32_t topicHash,
+                                     bool * pFound )
+{
+    const MQTTTopicHandlerRecord_t * pRecords;
+    size_t maxCount, index, probes = 0U;
+    bool done = false;
+
+    assert( pContext != NULL );
+    assert( pContext->pExactTopicHandlers != NULL );
+    assert( pContext->exactTopicHandlerMaxCount > 0U );
+    assert( pFound != NULL );
+
+    pRecords = pContext->pExactTopicHandlers;
+    maxCount = pContext->exactTopicHandlerMaxCount;
+    index = ( size_t ) topicHash % maxCount;
+    *pFound = false;
+
+    /* Records are never left as tombstones, so an empty record terminates
+     * the probe sequence. */
+    while( ( probes < maxCount ) && ( done == false ) )
+    {
+        if( pRecords[ index ].pTopicFilter == NULL )
+        {
+            done = true;
+        }
+        else if( ( pRecords[ index ].filterHash == topicHash ) &&
+                 ( pRecords[ index ].topicFilterLength == topicLength ) &&
+                 ( memcmp( pRecords[ index ].pTopicFilter, pTopic, topicLength ) == 0 ) )
+        {
+            *pFound = true;
+            done = true;
+        }
+        else
+        {
+            index = ( index + 1U ) % maxCount;
+            probes++;
+        }
+    }
+
+    if( done == false )
+    {
+        /* The table is full and does not contain the topic. */
+        index = maxCount;
+    }
+
+    return index;
+}
+
+/*-----------------------------------------------------------*/
+
+static void removeExactTopicHandler( MQTTContext_t * pContext,
+                                     size_t index )
+{
+    MQTTTopicHandlerRecord_t * pRecords;
+    size_t maxCount, hole, next, home;
+    bool homeInRange;
+
+    assert( pContext != NULL );
+    assert( pContext->pExactTopicHandlers != NULL );
+    assert( index < pContext->exactTopicHandlerMaxCount );
+
+    pRecords = pContext->pExactTopicHandlers;
+    maxCount = pContext->exactTopicHandlerMaxCount;
+    hole = index;
+    ( void ) memset( &pRecords[ hole ], 0x00, sizeof( MQTTTopicHandlerRecord_t ) );
+    next = ( hole + 1U ) % maxCount;
+
+    /* The cleared record guarantees that this loop ends. */
+    while( pRecords[ next ].pTopicFilter != NULL )
+    {
+        home = ( size_t ) pRecords[ next ].filterHash % maxCount;
+
+        /* A record may only be moved to the hole if its home slot does not
+         * lie cyclically in (hole, next]. */
+        if( hole <= next )
+        {
+            homeInRange = ( hole < home ) && ( home <= next );
+        }
+        else
+        {
+            homeInRange = ( hole < home ) || ( home <= next );
+        }
+
+        if( homeInRange == false )
+        {
+            pRecords[ hole ] = pRecords[ next ];
+            ( void ) memset( &pRecords[ next ], 0x00, sizeof( MQTTTopicHandlerRecord_t ) );
+            hole = next;
+        }
+
+        next = ( next + 1U ) % maxCount;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t findWildcardTopicHandler( const MQTTContext_t * pContext,
+                                        const char * pTopicFilter,
+                                        uint16_t topicFilterLength )
+{
+    const MQTTTopicHandlerRecord_t * pRecord;
+    size_t index = 0U;
+    bool found = false;
+
+    assert( pContext != NULL );
+    assert( pTopicFilter != NULL );
+
+    while( ( index < pContext->wildcardTopicHandlerCount ) && ( found == false ) )
+    {
+        pRecord = &pContext->pWildcardTopicHandlers[ index ];
+
+        if( ( pRecord->topicFilterLength == topicFilterLength ) &&
+            ( memcmp( pRecord->pTopicFilter, pTopicFilter, topicFilterLength ) == 0 ) )
+        {
+            found = true;
+        }
+        else
+        {
+            index++;
+        }
+    }
+
+    return index;
+}
+
+/*-----------------------------------------------------------*/
+
+static void dispatchIncomingPublish( MQTTContext_t * pContext,
+                                     MQTTPacketInfo_t * pIncomingPacket,
+                                     MQTTDeserializedInfo_t * pDeserializedInfo )
+{
+    const MQTTPublishInfo_t * pPublishInfo;
+    const MQTTTopicHandlerRecord_t * pRecord = NULL;
+    const MQTTTopicHandlerRecord_t * pCandidate;
+    const MQTTSubscriptionHandlerRecord_t * pSubscriptionRecord;
+    const uint16_t * pNameLevelOffsets = NULL;
+    uint16_t nameLevelOffsets[ CORE_MQTT_DISPATCH_MAX_TOPIC_LEVELS ];
+    uint16_t invalidIndex = 0U;
+    uint32_t subscriptionId;
+    size_t index, nameLevelCount = 0U;
+    bool found = false;
+    bool handled = false;
+    bool nameScanned = false;
+
+    assert( pContext != NULL );
+    assert( pDeserializedInfo != NULL );
+    assert( pDeserializedInfo->pPublishInfo != NULL );
+
+    pPublishInfo = pDeserializedInfo->pPublishInfo;
+
+    /* The Subscription Identifiers of an MQTT 5 publish index the subscription
+     * handler table directly. A publish matching several subscriptions is given
+     * to the handler of each of them. */
+    for( index = 0U; index < pDeserializedInfo->subscriptionIdCount; index++ )
+    {
+        subscriptionId = pDeserializedInfo->pSubscriptionIds[ index ];
+
+        if( subscriptionId <= pContext->subscriptionHandlerMaxCount )
+        {
+            pSubscriptionRecord = &pContext->pSubscriptionHandlers[ subscriptionId - 1U ];
+
+            if( pSubscriptionRecord->handler != NULL )
+            {
+                pSubscriptionRecord->handler( pContext,
+                                              pIncomingPacket,
+                                              pDeserializedInfo,
+                                              pSubscriptionRecord->pHandlerContext );
+                handled = true;
+            }
+        }
+    }
+
+    /* Only topic names which are non-empty can be matched with a handler. */
+    if( ( handled == false ) &&
+        ( pPublishInfo->pTopicName != NULL ) &&
+        ( pPublishInfo->topicNameLength > 0U ) )
+    {
+        /* Fast path: a single hash lookup for topic filters without wildcards. */
+        if( pContext->pExactTopicHandlers != NULL )
+        {
+            index = findExactTopicHandler( pContext,
+                                           pPublishInfo->pTopicName,
+                                           pPublishInfo->topicNameLength,
+                                           hashTopic( pPublishInfo->pTopicName,
+                                                      pPublishInfo->topicNameLength ),
+                                           &found );
+
+            if( found == true )
+            {
+                pRecord = &pContext->pExactTopicHandlers[ index ];
+            }
+        }
+
+        /* Wildcard topic filters are tried in registration order. The literal
+         * prefix of a filter is compared first to skip unrelated filters without
+         * running the full matching algorithm. */
+        for( index = 0U; ( pRecord == NULL ) && ( index < pContext->wildcardTopicHandlerCount ); index++ )
+        {
+            pCandidate = &pContext->pWildcardTopicHandlers[ index ];
+
+            if( ( pCandidate->prefixLength <= pPublishInfo->topicNameLength ) &&
+                ( memcmp( pCandidate->pTopicFilter,
+                          pPublishInfo->pTopicName,
+                          pCandidate->prefixLength ) == 0 ) )
+            {
+                /* The level separators of the topic name are found once, and
+                 * reused for every wildcard topic filter it is matched with.
+                 * Topic names which are not valid or have too many levels are
+                 * matched without them. */
+                if( nameScanned == false )
+                {
+                    if( scanTopic( pPublishInfo->pTopicName,
+                                   pPublishInfo->topicNameLength,
+                                   false,
+                                   nameLevelOffsets,
+                                   CORE_MQTT_DISPATCH_MAX_TOPIC_LEVELS,
+                                   &nameLevelCount,
+                                   &invalidIndex ) == MQTTSuccess )
+                    {
+                        pNameLevelOffsets = nameLevelOffsets;
+                    }
+
+                    nameScanned = true;
+                }
+
+                found = matchTopic( pPublishInfo->pTopicName,
+                                    pPublishInfo->topicNameLength,
+                                    pCandidate->pTopicFilter,
+                                    pCandidate->topicFilterLength,
+                                    pNameLevelOffsets,
+                                    ( pNameLevelOffsets != NULL ) ? nameLevelCount : 0U );
+
+                if( found == true )
+                {
+                    pRecord = pCandidate;
+                }
+            }
+        }
+    }
+
+    if( pRecord != NULL )
+    {
+        pRecord->handler( pContext,
+                          pIncomingPacket,
+                          pDeserializedInfo,
+                          pRecord->pHandlerContext );
+    }
+    else if( handled == false )
+    {
+        pContext->appCallback( pContext,
+                               pIncomingPacket,
+                               pDeserializedInfo );
+    }
+    else
+    {
+        /* Empty else MISRA 15.7 */
+    }
+}
+
+/*-----------------------------------------------------------*/
+
 static int32_t sendMessageVector( MQTTContext_t * pContext,
                                   TransportOutVector_t * pIoVec,
                                   size_t ioVecCount )
@@ -787,6 +2270,8 @@ static int32_t sendMessageVector( MQTTContext_t * pContext,
     size_t vectorsToBeSent = ioVecCount;
     size_t bytesToSend = 0U;
     int32_t bytesSentOrError = 0;
+    uint8_t * pTxBuffer;
+    size_t bytesWritten = 0U;
 
     assert( pContext != NULL );
     assert( pIoVec != NULL );
@@ -800,6 +2285,26 @@ static int32_t sendMessageVector( MQTTContext_t * pContext,
         bytesToSend += pIoVectIterator->iov_len;
     }
 
+    pTxBuffer = getTxBuffer( pContext, bytesToSend );
+
+    if( pTxBuffer != NULL )
+    {
+        /* Gather the packet into the buffer of the transport, which sends it
+         * whole. The loop below then has nothing left to send. */
+        for( pIoVectIterator = pIoVec; pIoVectIterator <= &( pIoVec[ ioVecCount - 1U ] ); pIoVectIterator++ )
+        {
+            if( pIoVectIterator->iov_len > 0U )
+            {
+                ( void ) memcpy( &pTxBuffer[ bytesWritten ],
+                                 pIoVectIterator->iov_base,
+                                 pIoVectIterator->iov_len );
+                bytesWritten += pIoVectIterator->iov_len;
+            }
+        }
+
+        bytesSentOrError = commitTxBuffer( pContext, pTxBuffer, bytesToSend );
+    }
+
     /* Reset the iterator to point to the first entry in the array. */
     pIoVectIterator = pIoVec;
 
@@ -830,7 +2335,9 @@ static int32_t sendMessageVector( MQTTContext_t * pContext,
             bytesSentOrError += sendResult;
 
             /* Set last transmission time. */
+            MQTT_PRE_STATE_UPDATE_HOOK( pContext );
             pContext->lastPacketTxTime = pContext->getTime();
+            MQTT_POST_STATE_UPDATE_HOOK( pContext );
 
             LogDebug( ( "sendMessageVector: Bytes Sent=%ld, Bytes Remaining=%lu",
                         ( long int ) sendResult,
@@ -841,14 +2348,20 @@ static int32_t sendMessageVector( MQTTContext_t * pContext,
             bytesSentOrError = sendResult;
             LogError( ( "sendMessageVector: Unable to send packet: Network Error." ) );
 
+            MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+
             if( pContext->connectStatus == MQTTConnected )
             {
                 pContext->connectStatus = MQTTDisconnectPending;
             }
+
+            MQTT_POST_STATE_UPDATE_HOOK( pContext );
         }
         else
         {
-            /* MISRA Empty body */
+            /* Nothing could be sent, so wait for the transport to drain
+             * rather than retry at once. */
+            waitForTransport( pContext, TRANSPORT_WAIT_WRITABLE, startTime, MQTT_SEND_TIMEOUT_MS );
         }
 
         /* Check for timeout. */
@@ -894,12 +2407,23 @@ static int32_t sendBuffer( MQTTContext_t * pContext,
     uint32_t startTime;
     int32_t bytesSentOrError = 0;
     const uint8_t * pIndex = pBufferToSend;
+    uint8_t * pTxBuffer;
 
     assert( pContext != NULL );
     assert( pContext->getTime != NULL );
     assert( pContext->transportInterface.send != NULL );
     assert( pIndex != NULL );
 
+    pTxBuffer = getTxBuffer( pContext, bytesToSend );
+
+    if( pTxBuffer != NULL )
+    {
+        /* The transport sends the copy whole, so the loop below has nothing
+         * left to send. */
+        ( void ) memcpy( pTxBuffer, pIndex, bytesToSend );
+        bytesSentOrError = commitTxBuffer( pContext, pTxBuffer, bytesToSend );
+    }
+
     /* Set the timeout. */
     startTime = pContext->getTime();
 
@@ -919,7 +2443,9 @@ static int32_t sendBuffer( MQTTContext_t * pContext,
             pIndex = &pIndex[ sendResult ];
 
             /* Set last transmission time. */
+            MQTT_PRE_STATE_UPDATE_HOOK( pContext );
             pContext->lastPacketTxTime = pContext->getTime();
+            MQTT_POST_STATE_UPDATE_HOOK( pContext );
 
             LogDebug( ( "sendBuffer: Bytes Sent=%ld, Bytes Remaining=%lu",
                         ( long int ) sendResult,
@@ -930,14 +2456,20 @@ static int32_t sendBuffer( MQTTContext_t * pContext,
             bytesSentOrError = sendResult;
             LogError( ( "sendBuffer: Unable to send packet: Network Error." ) );
 
+            MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+
             if( pContext->connectStatus == MQTTConnected )
             {
                 pContext->connectStatus = MQTTDisconnectPending;
             }
+
+            MQTT_POST_STATE_UPDATE_HOOK( pContext );
         }
         else
         {
-            /* MISRA Empty body */
+            /* Nothing could be sent, so wait for the transport to drain
+             * rather than retry at once. */
+            waitForTransport( pContext, TRANSPORT_WAIT_WRITABLE, startTime, MQTT_SEND_TIMEOUT_MS );
         }
 
         /* Check for timeout. */
@@ -953,80 +2485,193 @@ static int32_t sendBuffer( MQTTContext_t * pContext,
 
 /*-----------------------------------------------------------*/
 
-static uint32_t calculateElapsedTime( uint32_t later,
-                                      uint32_t start )
+static uint8_t * getTxBuffer( MQTTContext_t * pContext,
+                              size_t bytesToWrite )
 {
-    return later - start;
+    uint8_t * pTxBuffer = NULL;
+
+    assert( pContext != NULL );
+
+    /* MQTT_Init ensures the commit function is set along with this one. */
+    if( pContext->transportInterface.getTxBuffer != NULL )
+    {
+        pTxBuffer = ( uint8_t * ) pContext->transportInterface.getTxBuffer( pContext->transportInterface.pNetworkContext,
+                                                                            bytesToWrite );
+    }
+
+    return pTxBuffer;
 }
 
 /*-----------------------------------------------------------*/
 
-static MQTTPubAckType_t getAckFromPacketType( uint8_t packetType )
+static int32_t commitTxBuffer( MQTTContext_t * pContext,
+                               uint8_t * pTxBuffer,
+                               size_t bytesToSend )
 {
-    MQTTPubAckType_t ackType = MQTTPuback;
+    int32_t sendResult;
+
+    assert( pContext != NULL );
+    assert( pContext->getTime != NULL );
+    assert( pContext->transportInterface.commitTxBuffer != NULL );
+    assert( pTxBuffer != NULL );
 
-    switch( packetType )
+    sendResult = pContext->transportInterface.commitTxBuffer( pContext->transportInterface.pNetworkContext,
+                                                              pTxBuffer,
+                                                              bytesToSend );
+
+    if( sendResult == ( int32_t ) bytesToSend )
     {
-        case MQTT_PACKET_TYPE_PUBACK:
-            ackType = MQTTPuback;
-            break;
+        if( bytesToSend > 0U )
+        {
+            /* Set last transmission time. */
+            MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+            pContext->lastPacketTxTime = pContext->getTime();
+            MQTT_POST_STATE_UPDATE_HOOK( pContext );
 
-        case MQTT_PACKET_TYPE_PUBREC:
-            ackType = MQTTPubrec;
-            break;
+            LogDebug( ( "commitTxBuffer: Bytes Sent=%ld",
+                        ( long int ) sendResult ) );
+        }
+    }
+    else
+    {
+        /* A commit cannot send part of the buffer, so anything but the whole
+         * packet is a network error. */
+        LogError( ( "commitTxBuffer: Unable to send packet: Network Error. "
+                    "Result=%ld, PacketSize=%lu",
+                    ( long int ) sendResult,
+                    ( unsigned long ) bytesToSend ) );
 
-        case MQTT_PACKET_TYPE_PUBREL:
-            ackType = MQTTPubrel;
-            break;
+        if( sendResult >= 0 )
+        {
+            sendResult = -1;
+        }
 
-        default:
+        MQTT_PRE_STATE_UPDATE_HOOK( pContext );
 
-            /* This function is only called after checking the type is one of
-             * the above four values, so packet type must be PUBCOMP here. */
-            assert( packetType == MQTT_PACKET_TYPE_PUBCOMP );
-            ackType = MQTTPubcomp;
-            break;
+        if( pContext->connectStatus == MQTTConnected )
+        {
+            pContext->connectStatus = MQTTDisconnectPending;
+        }
+
+        MQTT_POST_STATE_UPDATE_HOOK( pContext );
     }
 
-    return ackType;
+    return sendResult;
 }
 
 /*-----------------------------------------------------------*/
 
-static int32_t recvExact( MQTTContext_t * pContext,
-                          size_t bytesToRecv )
+static void waitForTransport( MQTTContext_t * pContext,
+                              TransportWaitEvent_t event,
+                              uint32_t startTimeMs,
+                              uint32_t timeoutMs )
 {
-    uint8_t * pIndex = NULL;
-    size_t bytesRemaining = bytesToRecv;
-    int32_t totalBytesRecvd = 0, bytesRecvd;
-    uint32_t lastDataRecvTimeMs = 0U, timeSinceLastRecvMs = 0U;
-    TransportRecv_t recvFunc = NULL;
-    MQTTGetCurrentTimeFunc_t getTimeStampMs = NULL;
-    bool receiveError = false;
+    uint32_t elapsedTimeMs;
+    int32_t waitResult;
 
     assert( pContext != NULL );
-    assert( bytesToRecv <= pContext->networkBuffer.size );
     assert( pContext->getTime != NULL );
-    assert( pContext->transportInterface.recv != NULL );
-    assert( pContext->networkBuffer.pBuffer != NULL );
-
-    pIndex = pContext->networkBuffer.pBuffer;
-    recvFunc = pContext->transportInterface.recv;
-    getTimeStampMs = pContext->getTime;
-
-    /* Part of the MQTT packet has been read before calling this function. */
-    lastDataRecvTimeMs = getTimeStampMs();
 
-    while( ( bytesRemaining > 0U ) && ( receiveError == false ) )
+    /* Without a wait function, the caller retries at once. */
+    if( pContext->transportInterface.wait != NULL )
     {
-        bytesRecvd = recvFunc( pContext->transportInterface.pNetworkContext,
-                               pIndex,
-                               bytesRemaining );
+        elapsedTimeMs = calculateElapsedTime( pContext->getTime(), startTimeMs );
 
-        if( bytesRecvd < 0 )
+        if( elapsedTimeMs < timeoutMs )
         {
-            LogError( ( "Network error while receiving packet: ReturnCode=%ld.",
-                        ( long int ) bytesRecvd ) );
+            waitResult = pContext->transportInterface.wait( pContext->transportInterface.pNetworkContext,
+                                                            event,
+                                                            timeoutMs - elapsedTimeMs );
+
+            if( waitResult < 0 )
+            {
+                LogError( ( "Transport wait failed: ReturnCode=%ld.",
+                            ( long int ) waitResult ) );
+            }
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static uint32_t calculateElapsedTime( uint32_t later,
+                                      uint32_t start )
+{
+    return later - start;
+}
+
+/*-----------------------------------------------------------*/
+
+#if ( MQTT_QOS0_ONLY == 0 )
+
+    static MQTTPubAckType_t getAckFromPacketType( uint8_t packetType )
+    {
+        MQTTPubAckType_t ackType = MQTTPuback;
+
+        switch( packetType )
+        {
+            case MQTT_PACKET_TYPE_PUBACK:
+                ackType = MQTTPuback;
+                break;
+
+            case MQTT_PACKET_TYPE_PUBREC:
+                ackType = MQTTPubrec;
+                break;
+
+            case MQTT_PACKET_TYPE_PUBREL:
+                ackType = MQTTPubrel;
+                break;
+
+            default:
+
+                /* This function is only called after checking the type is one of
+                 * the above four values, so packet type must be PUBCOMP here. */
+                assert( packetType == MQTT_PACKET_TYPE_PUBCOMP );
+                ackType = MQTTPubcomp;
+                break;
+        }
+
+        return ackType;
+    }
+
+#endif /* if ( MQTT_QOS0_ONLY == 0 ) */
+
+/*-----------------------------------------------------------*/
+
+static int32_t recvExact( MQTTContext_t * pContext,
+                          size_t bytesToRecv )
+{
+    uint8_t * pIndex = NULL;
+    size_t bytesRemaining = bytesToRecv;
+    int32_t totalBytesRecvd = 0, bytesRecvd;
+    uint32_t lastDataRecvTimeMs = 0U, timeSinceLastRecvMs = 0U;
+    TransportRecv_t recvFunc = NULL;
+    MQTTGetCurrentTimeFunc_t getTimeStampMs = NULL;
+    bool receiveError = false;
+
+    assert( pContext != NULL );
+    assert( bytesToRecv <= pContext->networkBuffer.size );
+    assert( pContext->getTime != NULL );
+    assert( pContext->transportInterface.recv != NULL );
+    assert( pContext->networkBuffer.pBuffer != NULL );
+
+    pIndex = pContext->networkBuffer.pBuffer;
+    recvFunc = pContext->transportInterface.recv;
+    getTimeStampMs = pContext->getTime;
+
+    /* Part of the MQTT packet has been read before calling this function. */
+    lastDataRecvTimeMs = getTimeStampMs();
+
+    while( ( bytesRemaining > 0U ) && ( receiveError == false ) )
+    {
+        bytesRecvd = recvFunc( pContext->transportInterface.pNetworkContext,
+                               pIndex,
+                               bytesRemaining );
+
+        if( bytesRecvd < 0 )
+        {
+            LogError( ( "Network error while receiving packet: ReturnCode=%ld.",
+                        ( long int ) bytesRecvd ) );
             totalBytesRecvd = bytesRecvd;
             receiveError = true;
 
@@ -1071,6 +2716,10 @@ static int32_t recvExact( MQTTContext_t * pContext,
                 LogError( ( "Unable to receive packet: Timed out in transport recv." ) );
                 receiveError = true;
             }
+            else
+            {
+                waitForTransport( pContext, TRANSPORT_WAIT_READABLE, lastDataRecvTimeMs, MQTT_RECV_POLLING_TIMEOUT_MS );
+            }
         }
     }
 
@@ -1263,125 +2912,152 @@ static MQTTStatus_t receivePacket( MQTTContext_t * pContext,
 
 /*-----------------------------------------------------------*/
 
-static uint8_t getAckTypeToSend( MQTTPublishState_t state )
-{
-    uint8_t packetTypeByte = 0U;
+#if ( MQTT_QOS0_ONLY == 0 )
 
-    switch( state )
+    static uint8_t getAckTypeToSend( MQTTPublishState_t state )
     {
-        case MQTTPubAckSend:
-            packetTypeByte = MQTT_PACKET_TYPE_PUBACK;
-            break;
+        uint8_t packetTypeByte = 0U;
 
-        case MQTTPubRecSend:
-            packetTypeByte = MQTT_PACKET_TYPE_PUBREC;
-            break;
+        switch( state )
+        {
+            case MQTTPubAckSend:
+                packetTypeByte = MQTT_PACKET_TYPE_PUBACK;
+                break;
 
-        case MQTTPubRelSend:
-            packetTypeByte = MQTT_PACKET_TYPE_PUBREL;
-            break;
+            case MQTTPubRecSend:
+                packetTypeByte = MQTT_PACKET_TYPE_PUBREC;
+                break;
 
-        case MQTTPubCompSend:
-            packetTypeByte = MQTT_PACKET_TYPE_PUBCOMP;
-            break;
+            case MQTTPubRelSend:
+                packetTypeByte = MQTT_PACKET_TYPE_PUBREL;
+                break;
 
-        default:
-            /* Take no action for states that do not require sending an ack. */
-            break;
+            case MQTTPubCompSend:
+                packetTypeByte = MQTT_PACKET_TYPE_PUBCOMP;
+                break;
+
+            default:
+                /* Take no action for states that do not require sending an ack. */
+                break;
+        }
+
+        return packetTypeByte;
     }
 
-    return packetTypeByte;
-}
+#endif /* if ( MQTT_QOS0_ONLY == 0 ) */
 
 /*-----------------------------------------------------------*/
 
-static MQTTStatus_t sendPublishAcks( MQTTContext_t * pContext,
-                                     uint16_t packetId,
-                                     MQTTPublishState_t publishState )
-{
-    MQTTStatus_t status = MQTTSuccess;
-    MQTTPublishState_t newState = MQTTStateNull;
-    int32_t sendResult = 0;
-    uint8_t packetTypeByte = 0U;
-    MQTTPubAckType_t packetType;
-    MQTTFixedBuffer_t localBuffer;
-    MQTTConnectionStatus_t connectStatus;
-    uint8_t pubAckPacket[ MQTT_PUBLISH_ACK_PACKET_SIZE ];
-
-    localBuffer.pBuffer = pubAckPacket;
-    localBuffer.size = MQTT_PUBLISH_ACK_PACKET_SIZE;
+#if ( MQTT_QOS0_ONLY == 0 )
 
-    assert( pContext != NULL );
+    static MQTTStatus_t sendPublishAcks( MQTTContext_t * pContext,
+                                         uint16_t packetId,
+                                         MQTTPublishState_t publishState )
+    {
+        MQTTStatus_t status = MQTTSuccess;
+        MQTTPublishState_t newState = MQTTStateNull;
+        int32_t sendResult = 0;
+        uint8_t packetTypeByte = 0U;
+        MQTTPubAckType_t packetType;
+        MQTTFixedBuffer_t localBuffer;
+        MQTTConnectionStatus_t connectStatus;
+        uint8_t pubAckPacket[ MQTT_PUBLISH_ACK_PACKET_SIZE ];
+        uint8_t * pTxBuffer;
 
-    packetTypeByte = getAckTypeToSend( publishState );
+        localBuffer.size = MQTT_PUBLISH_ACK_PACKET_SIZE;
 
-    if( packetTypeByte != 0U )
-    {
-        packetType = getAckFromPacketType( packetTypeByte );
+        assert( pContext != NULL );
 
-        status = MQTT_SerializeAck( &localBuffer,
-                                    packetTypeByte,
-                                    packetId );
+        packetTypeByte = getAckTypeToSend( publishState );
 
-        if( status == MQTTSuccess )
+        if( packetTypeByte != 0U )
         {
-            MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+            packetType = getAckFromPacketType( packetTypeByte );
+
+            /* The send hook is taken before serializing, so that the ack can
+             * be written straight into a buffer of the transport. */
+            MQTT_PRE_SEND_HOOK( pContext );
 
-            connectStatus = pContext->connectStatus;
+            pTxBuffer = getTxBuffer( pContext, MQTT_PUBLISH_ACK_PACKET_SIZE );
+            localBuffer.pBuffer = ( pTxBuffer != NULL ) ? pTxBuffer : pubAckPacket;
 
-            if( connectStatus != MQTTConnected )
+            status = MQTT_SerializeAck( &localBuffer,
+                                        packetTypeByte,
+                                        packetId );
+
+            if( status == MQTTSuccess )
             {
-                status = ( connectStatus == MQTTNotConnected ) ? MQTTStatusNotConnected : MQTTStatusDisconnectPending;
+                MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+                connectStatus = pContext->connectStatus;
+                MQTT_POST_STATE_UPDATE_HOOK( pContext );
+
+                if( connectStatus != MQTTConnected )
+                {
+                    status = ( connectStatus == MQTTNotConnected ) ? MQTTStatusNotConnected : MQTTStatusDisconnectPending;
+                }
             }
 
-            if( status == MQTTSuccess )
+            if( pTxBuffer != NULL )
+            {
+                /* Give the buffer back unsent if the ack is not to be sent. */
+                sendResult = commitTxBuffer( pContext,
+                                             pTxBuffer,
+                                             ( status == MQTTSuccess ) ? MQTT_PUBLISH_ACK_PACKET_SIZE : 0U );
+            }
+            else if( status == MQTTSuccess )
             {
                 /* Here, we are not using the vector approach for efficiency. There is just one buffer
                  * to be sent which can be achieved with a normal send call. */
                 sendResult = sendBuffer( pContext,
                                          localBuffer.pBuffer,
                                          MQTT_PUBLISH_ACK_PACKET_SIZE );
+            }
+            else
+            {
+                /* Empty else MISRA 15.7 */
+            }
 
-                if( sendResult < ( int32_t ) MQTT_PUBLISH_ACK_PACKET_SIZE )
-                {
-                    status = MQTTSendFailed;
-                }
+            if( ( status == MQTTSuccess ) &&
+                ( sendResult < ( int32_t ) MQTT_PUBLISH_ACK_PACKET_SIZE ) )
+            {
+                status = MQTTSendFailed;
             }
 
-            MQTT_POST_STATE_UPDATE_HOOK( pContext );
-        }
+            MQTT_POST_SEND_HOOK( pContext );
 
-        if( status == MQTTSuccess )
-        {
-            pContext->controlPacketSent = true;
+            if( status == MQTTSuccess )
+            {
+                pContext->controlPacketSent = true;
 
-            MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+                MQTT_PRE_STATE_UPDATE_HOOK( pContext );
 
-            status = MQTT_UpdateStateAck( pContext,
-                                          packetId,
-                                          packetType,
-                                          MQTT_SEND,
-                                          &newState );
+                status = MQTT_UpdateStateAck( pContext,
+                                              packetId,
+                                              packetType,
+                                              MQTT_SEND,
+                                              &newState );
 
-            MQTT_POST_STATE_UPDATE_HOOK( pContext );
+                MQTT_POST_STATE_UPDATE_HOOK( pContext );
 
-            if( status != MQTTSuccess )
+                if( status != MQTTSuccess )
+                {
+                    LogError( ( "Failed to update state of publish %hu.",
+                                ( unsigned short ) packetId ) );
+                }
+            }
+            else
             {
-                LogError( ( "Failed to update state of publish %hu.",
-                            ( unsigned short ) packetId ) );
+                LogError( ( "Failed to send ACK packet: PacketType=%02x, SentBytes=%ld, "
+                            "PacketSize=%lu.",
+                            ( unsigned int ) packetTypeByte, ( long int ) sendResult,
+                            MQTT_PUBLISH_ACK_PACKET_SIZE ) );
             }
         }
-        else
-        {
-            LogError( ( "Failed to send ACK packet: PacketType=%02x, SentBytes=%ld, "
-                        "PacketSize=%lu.",
-                        ( unsigned int ) packetTypeByte, ( long int ) sendResult,
-                        MQTT_PUBLISH_ACK_PACKET_SIZE ) );
-        }
+
+        return status;
     }
 
-    return status;
-}
+#endif /* if ( MQTT_QOS0_ONLY == 0 ) */
 
 /*-----------------------------------------------------------*/
 
@@ -1440,210 +3116,337 @@ static MQTTStatus_t handleKeepAlive( MQTTContext_t * pContext )
 
 /*-----------------------------------------------------------*/
 
-static MQTTStatus_t handleIncomingPublish( MQTTContext_t * pContext,
-                                           MQTTPacketInfo_t * pIncomingPacket )
-{
-    MQTTStatus_t status;
-    MQTTPublishState_t publishRecordState = MQTTStateNull;
-    uint16_t packetIdentifier = 0U;
-    MQTTPublishInfo_t publishInfo;
-    MQTTDeserializedInfo_t deserializedInfo;
-    bool duplicatePublish = false;
+#if ( MQTT_QOS0_ONLY == 0 )
+
+    static MQTTStatus_t handleIncomingPublish( MQTTContext_t * pContext,
+                                               MQTTPacketInfo_t * pIncomingPacket )
+    {
+        MQTTStatus_t status;
+        MQTTPublishState_t publishRecordState = MQTTStateNull;
+        uint16_t packetIdentifier = 0U;
+        MQTTPublishInfo_t publishInfo;
+        MQTTDeserializedInfo_t deserializedInfo;
+        uint32_t subscriptionIds[ MQTT_MAX_SUBSCRIPTION_IDS ];
+        size_t subscriptionIdCount = 0U;
+        bool duplicatePublish = false;
+
+        assert( pContext != NULL );
+        assert( pIncomingPacket != NULL );
+        assert( pContext->appCallback != NULL );
+
+        status = deserializeIncomingPublish( pContext,
+                                             pIncomingPacket,
+                                             &packetIdentifier,
+                                             &publishInfo,
+                                             subscriptionIds,
+                                             &subscriptionIdCount );
+        LogInfo( ( "De-serialized incoming PUBLISH packet: DeserializerResult=%s.",
+                   MQTT_Status_strerror( status ) ) );
 
-    assert( pContext != NULL );
-    assert( pIncomingPacket != NULL );
-    assert( pContext->appCallback != NULL );
+        if( ( status == MQTTSuccess ) &&
+            ( pContext->incomingPublishRecords == NULL ) &&
+            ( pContext->pRecordSlab == NULL ) &&
+            ( publishInfo.qos > MQTTQoS0 ) )
+        {
+            LogError( ( "Incoming publish has QoS > MQTTQoS0 but incoming "
+                        "publish records have not been initialized. Dropping the "
+                        "incoming publish. Please call MQTT_InitStatefulQoS to enable "
+                        "use of QoS1 and QoS2 publishes." ) );
+            status = MQTTRecvFailed;
+        }
 
-    status = MQTT_DeserializePublish( pIncomingPacket, &packetIdentifier, &publishInfo );
-    LogInfo( ( "De-serialized incoming PUBLISH packet: DeserializerResult=%s.",
-               MQTT_Status_strerror( status ) ) );
+        if( status == MQTTSuccess )
+        {
+            MQTT_PRE_STATE_UPDATE_HOOK( pContext );
 
-    if( ( status == MQTTSuccess ) &&
-        ( pContext->incomingPublishRecords == NULL ) &&
-        ( publishInfo.qos > MQTTQoS0 ) )
-    {
-        LogError( ( "Incoming publish has QoS > MQTTQoS0 but incoming "
-                    "publish records have not been initialized. Dropping the "
-                    "incoming publish. Please call MQTT_InitStatefulQoS to enable "
-                    "use of QoS1 and QoS2 publishes." ) );
-        status = MQTTRecvFailed;
-    }
+            if( publishInfo.qos > MQTTQoS0 )
+            {
+                status = claimStateRecords( pContext, false );
+            }
 
-    if( status == MQTTSuccess )
-    {
-        MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+            if( status == MQTTSuccess )
+            {
+                status = MQTT_UpdateStatePublish( pContext,
+                                                  packetIdentifier,
+                                                  MQTT_RECEIVE,
+                                                  publishInfo.qos,
+                                                  &publishRecordState );
+            }
 
-        status = MQTT_UpdateStatePublish( pContext,
-                                          packetIdentifier,
-                                          MQTT_RECEIVE,
-                                          publishInfo.qos,
-                                          &publishRecordState );
+            MQTT_POST_STATE_UPDATE_HOOK( pContext );
 
-        MQTT_POST_STATE_UPDATE_HOOK( pContext );
+            if( status == MQTTSuccess )
+            {
+                LogInfo( ( "State record updated. New state=%s.",
+                           MQTT_State_strerror( publishRecordState ) ) );
+            }
 
-        if( status == MQTTSuccess )
-        {
-            LogInfo( ( "State record updated. New state=%s.",
-                       MQTT_State_strerror( publishRecordState ) ) );
-        }
-
-        /* Different cases in which an incoming publish with duplicate flag is
-         * handled are as listed below.
-         * 1. No collision - This is the first instance of the incoming publish
-         *    packet received or an earlier received packet state is lost. This
-         *    will be handled as a new incoming publish for both QoS1 and QoS2
-         *    publishes.
-         * 2. Collision - The incoming packet was received before and a state
-         *    record is present in the state engine. For QoS1 and QoS2 publishes
-         *    this case can happen at 2 different cases and handling is
-         *    different.
-         *    a. QoS1 - If a PUBACK is not successfully sent for the incoming
-         *       publish due to a connection issue, it can result in broker
-         *       sending out a duplicate publish with dup flag set, when a
-         *       session is reestablished. It can result in a collision in
-         *       state engine. This will be handled by processing the incoming
-         *       publish as a new publish ignoring the
-         *       #MQTTStateCollision status from the state engine. The publish
-         *       data is not passed to the application.
-         *    b. QoS2 - If a PUBREC is not successfully sent for the incoming
-         *       publish or the PUBREC sent is not successfully received by the
-         *       broker due to a connection issue, it can result in broker
-         *       sending out a duplicate publish with dup flag set, when a
-         *       session is reestablished. It can result in a collision in
-         *       state engine. This will be handled by ignoring the
-         *       #MQTTStateCollision status from the state engine. The publish
-         *       data is not passed to the application. */
-        else if( status == MQTTStateCollision )
-        {
-            status = MQTTSuccess;
-            duplicatePublish = true;
+            /* Different cases in which an incoming publish with duplicate flag is
+             * handled are as listed below.
+             * 1. No collision - This is the first instance of the incoming publish
+             *    packet received or an earlier received packet state is lost. This
+             *    will be handled as a new incoming publish for both QoS1 and QoS2
+             *    publishes.
+             * 2. Collision - The incoming packet was received before and a state
+             *    record is present in the state engine. For QoS1 and QoS2 publishes
+             *    this case can happen at 2 different cases and handling is
+             *    different.
+             *    a. QoS1 - If a PUBACK is not successfully sent for the incoming
+             *       publish due to a connection issue, it can result in broker
+             *       sending out a duplicate publish with dup flag set, when a
+             *       session is reestablished. It can result in a collision in
+             *       state engine. This will be handled by processing the incoming
+             *       publish as a new publish ignoring the
+             *       #MQTTStateCollision status from the state engine. The publish
+             *       data is not passed to the application.
+             *    b. QoS2 - If a PUBREC is not successfully sent for the incoming
+             *       publish or the PUBREC sent is not successfully received by the
+             *       broker due to a connection issue, it can result in broker
+             *       sending out a duplicate publish with dup flag set, when a
+             *       session is reestablished. It can result in a collision in
+             *       state engine. This will be handled by ignoring the
+             *       #MQTTStateCollision status from the state engine. The publish
+             *       data is not passed to the application. */
+            else if( status == MQTTStateCollision )
+            {
+                status = MQTTSuccess;
+                duplicatePublish = true;
 
-            /* Calculate the state for the ack packet that needs to be sent out
-             * for the duplicate incoming publish. */
-            publishRecordState = MQTT_CalculateStatePublish( MQTT_RECEIVE,
-                                                             publishInfo.qos );
+                /* Calculate the state for the ack packet that needs to be sent out
+                 * for the duplicate incoming publish. */
+                publishRecordState = MQTT_CalculateStatePublish( MQTT_RECEIVE,
+                                                                 publishInfo.qos );
 
-            LogDebug( ( "Incoming publish packet with packet id %hu already exists.",
-                        ( unsigned short ) packetIdentifier ) );
+                LogDebug( ( "Incoming publish packet with packet id %hu already exists.",
+                            ( unsigned short ) packetIdentifier ) );
 
-            if( publishInfo.dup == false )
+                if( publishInfo.dup == false )
+                {
+                    LogError( ( "DUP flag is 0 for duplicate packet (MQTT-3.3.1.-1)." ) );
+                }
+            }
+            else
             {
-                LogError( ( "DUP flag is 0 for duplicate packet (MQTT-3.3.1.-1)." ) );
+                LogError( ( "Error in updating publish state for incoming publish with packet id %hu."
+                            " Error is %s",
+                            ( unsigned short ) packetIdentifier,
+                            MQTT_Status_strerror( status ) ) );
             }
         }
-        else
+
+        if( status == MQTTSuccess )
         {
-            LogError( ( "Error in updating publish state for incoming publish with packet id %hu."
-                        " Error is %s",
-                        ( unsigned short ) packetIdentifier,
-                        MQTT_Status_strerror( status ) ) );
+            /* Set fields of deserialized struct. */
+            deserializedInfo.packetIdentifier = packetIdentifier;
+            deserializedInfo.pPublishInfo = &publishInfo;
+            deserializedInfo.deserializationResult = status;
+            deserializedInfo.pSubscriptionIds = ( subscriptionIdCount != 0U ) ? subscriptionIds : NULL;
+            deserializedInfo.subscriptionIdCount = subscriptionIdCount;
+            deserializedInfo.reasonCode = 0U;
+
+            /* Invoke the topic handler or application callback to hand the buffer
+             * over to application before sending acks.
+             * The callback will be invoked for all publishes, except for
+             * duplicate incoming publishes. */
+            if( duplicatePublish == false )
+            {
+                dispatchIncomingPublish( pContext,
+                                         pIncomingPacket,
+                                         &deserializedInfo );
+            }
+
+            /* Send PUBACK or PUBREC if necessary. */
+            status = sendPublishAcks( pContext,
+                                      packetIdentifier,
+                                      publishRecordState );
         }
+
+        return status;
     }
 
-    if( status == MQTTSuccess )
+#else /* if ( MQTT_QOS0_ONLY == 0 ) */
+
+    static MQTTStatus_t handleIncomingPublish( MQTTContext_t * pContext,
+                                               MQTTPacketInfo_t * pIncomingPacket )
     {
-        /* Set fields of deserialized struct. */
-        deserializedInfo.packetIdentifier = packetIdentifier;
-        deserializedInfo.pPublishInfo = &publishInfo;
-        deserializedInfo.deserializationResult = status;
+        MQTTStatus_t status;
+        uint16_t packetIdentifier = 0U;
+        MQTTPublishInfo_t publishInfo;
+        MQTTDeserializedInfo_t deserializedInfo;
+        uint32_t subscriptionIds[ MQTT_MAX_SUBSCRIPTION_IDS ];
+        size_t subscriptionIdCount = 0U;
 
-        /* Invoke application callback to hand the buffer over to application
-         * before sending acks.
-         * Application callback will be invoked for all publishes, except for
-         * duplicate incoming publishes. */
-        if( duplicatePublish == false )
+        assert( pContext != NULL );
+        assert( pIncomingPacket != NULL );
+        assert( pContext->appCallback != NULL );
+
+        status = deserializeIncomingPublish( pContext,
+                                             pIncomingPacket,
+                                             &packetIdentifier,
+                                             &publishInfo,
+                                             subscriptionIds,
+                                             &subscriptionIdCount );
+        LogInfo( ( "De-serialized incoming PUBLISH packet: DeserializerResult=%s.",
+                   MQTT_Status_strerror( status ) ) );
+
+        if( ( status == MQTTSuccess ) && ( publishInfo.qos > MQTTQoS0 ) )
+        {
+            /* The subscriptions were all made with QoS0, so the broker broke
+             * the protocol. The transport itself is fine. */
+            LogError( ( "Incoming publish has QoS > MQTTQoS0, which is not "
+                        "supported when MQTT_QOS0_ONLY is enabled. Dropping the "
+                        "incoming publish." ) );
+            status = MQTTBadResponse;
+        }
+
+        if( status == MQTTSuccess )
         {
-            pContext->appCallback( pContext,
-                                   pIncomingPacket,
-                                   &deserializedInfo );
+            /* Set fields of deserialized struct. */
+            deserializedInfo.packetIdentifier = packetIdentifier;
+            deserializedInfo.pPublishInfo = &publishInfo;
+            deserializedInfo.deserializationResult = status;
+            deserializedInfo.pSubscriptionIds = ( subscriptionIdCount != 0U ) ? subscriptionIds : NULL;
+            deserializedInfo.subscriptionIdCount = subscriptionIdCount;
+            deserializedInfo.reasonCode = 0U;
+
+            /* Invoke the topic handler or application callback. A QoS0 publish
+             * is not acknowledged. */
+            dispatchIncomingPublish( pContext,
+                                     pIncomingPacket,
+                                     &deserializedInfo );
         }
 
-        /* Send PUBACK or PUBREC if necessary. */
-        status = sendPublishAcks( pContext,
-                                  packetIdentifier,
-                                  publishRecordState );
+        return status;
     }
 
-    return status;
-}
+#endif /* if ( MQTT_QOS0_ONLY == 0 ) */
 
 /*-----------------------------------------------------------*/
 
-static MQTTStatus_t handlePublishAcks( MQTTContext_t * pContext,
-                                       MQTTPacketInfo_t * pIncomingPacket )
-{
-    MQTTStatus_t status;
-    MQTTPublishState_t publishRecordState = MQTTStateNull;
-    uint16_t packetIdentifier;
-    MQTTPubAckType_t ackType;
-    MQTTEventCallback_t appCallback;
-    MQTTDeserializedInfo_t deserializedInfo;
-
-    assert( pContext != NULL );
-    assert( pIncomingPacket != NULL );
-    assert( pContext->appCallback != NULL );
-
-    appCallback = pContext->appCallback;
-
-    ackType = getAckFromPacketType( pIncomingPacket->type );
-    status = MQTT_DeserializeAck( pIncomingPacket, &packetIdentifier, NULL );
-    LogInfo( ( "Ack packet deserialized with result: %s.",
-               MQTT_Status_strerror( status ) ) );
+#if ( MQTT_QOS0_ONLY == 0 )
 
-    if( status == MQTTSuccess )
+    static MQTTStatus_t handlePublishAcks( MQTTContext_t * pContext,
+                                           MQTTPacketInfo_t * pIncomingPacket )
     {
-        MQTT_PRE_STATE_UPDATE_HOOK( pContext );
-
-        status = MQTT_UpdateStateAck( pContext,
-                                      packetIdentifier,
-                                      ackType,
-                                      MQTT_RECEIVE,
-                                      &publishRecordState );
+        MQTTStatus_t status;
+        MQTTStatus_t ackResult;
+        MQTTPublishState_t publishRecordState = MQTTStateNull;
+        uint8_t completedAckType;
+        uint16_t packetIdentifier;
+        uint8_t reasonCode = 0U;
+        MQTTPubAckType_t ackType;
+        MQTTEventCallback_t appCallback;
+        MQTTDeserializedInfo_t deserializedInfo;
+
+        assert( pContext != NULL );
+        assert( pIncomingPacket != NULL );
+        assert( pContext->appCallback != NULL );
+
+        appCallback = pContext->appCallback;
+
+        ackType = getAckFromPacketType( pIncomingPacket->type );
+        status = deserializeIncomingAck( pContext, pIncomingPacket, &packetIdentifier );
+        LogInfo( ( "Ack packet deserialized with result: %s.",
+                   MQTT_Status_strerror( status ) ) );
 
-        MQTT_POST_STATE_UPDATE_HOOK( pContext );
+        /* A failure reason code of MQTT 5 still ends the exchange with the
+         * acknowledged packet. The failure is given to the application. */
+        ackResult = status;
 
-        if( status == MQTTSuccess )
+        if( status == MQTTServerRefused )
         {
-            LogInfo( ( "State record updated. New state=%s.",
-                       MQTT_State_strerror( publishRecordState ) ) );
+            status = MQTTSuccess;
         }
-        else
+
+        if( ( status == MQTTSuccess ) && ( pContext->protocolVersion == MQTT_VERSION_5 ) )
         {
-            LogError( ( "Updating the state engine for packet id %hu"
-                        " failed with error %s.",
-                        ( unsigned short ) packetIdentifier,
-                        MQTT_Status_strerror( status ) ) );
+            status = MQTT_GetReasonCodeV5( pIncomingPacket, &reasonCode );
         }
-    }
 
-    if( ( ackType == MQTTPuback ) || ( ackType == MQTTPubrec ) )
-    {
-        if( ( status == MQTTSuccess ) &&
-            ( pContext->clearFunction != NULL ) )
+        if( status == MQTTSuccess )
         {
-            pContext->clearFunction( pContext, packetIdentifier );
-        }
-    }
+            MQTT_PRE_STATE_UPDATE_HOOK( pContext );
 
-    if( status == MQTTSuccess )
-    {
-        /* Set fields of deserialized struct. */
-        deserializedInfo.packetIdentifier = packetIdentifier;
-        deserializedInfo.deserializationResult = status;
-        deserializedInfo.pPublishInfo = NULL;
+            status = MQTT_UpdateStateAck( pContext,
+                                          packetIdentifier,
+                                          ackType,
+                                          MQTT_RECEIVE,
+                                          &publishRecordState );
 
-        /* Invoke application callback to hand the buffer over to application
-         * before sending acks. */
-        appCallback( pContext, pIncomingPacket, &deserializedInfo );
+            /* The server refused the publish instead of receiving it, so it
+             * is released without a PUBREL. */
+            if( ( status == MQTTSuccess ) && ( ackResult == MQTTServerRefused ) &&
+                ( ackType == MQTTPubrec ) )
+            {
+                status = MQTT_RemoveStateRecord( pContext, packetIdentifier );
+                publishRecordState = MQTTStateNull;
+            }
+
+            MQTT_POST_STATE_UPDATE_HOOK( pContext );
+
+            if( status == MQTTSuccess )
+            {
+                LogInfo( ( "State record updated. New state=%s.",
+                           MQTT_State_strerror( publishRecordState ) ) );
+            }
+            else
+            {
+                LogError( ( "Updating the state engine for packet id %hu"
+                            " failed with error %s.",
+                            ( unsigned short ) packetIdentifier,
+                            MQTT_Status_strerror( status ) ) );
+            }
+        }
+
+        if( ( ackType == MQTTPuback ) || ( ackType == MQTTPubrec ) )
+        {
+            if( ( status == MQTTSuccess ) &&
+                ( pContext->clearFunction != NULL ) )
+            {
+                pContext->clearFunction( pContext, packetIdentifier );
+            }
+        }
+
+        if( status == MQTTSuccess )
+        {
+            /* Set fields of deserialized struct. */
+            deserializedInfo.packetIdentifier = packetIdentifier;
+            deserializedInfo.deserializationResult = ackResult;
+            deserializedInfo.pPublishInfo = NULL;
+            deserializedInfo.pSubscriptionIds = NULL;
+            deserializedInfo.subscriptionIdCount = 0U;
+            deserializedInfo.reasonCode = reasonCode;
+
+            /* Invoke application callback to hand the buffer over to application
+             * before sending acks. */
+            appCallback( pContext, pIncomingPacket, &deserializedInfo );
+
+            /* A PUBACK or PUBCOMP completes the publish, if it holds a
+             * completion token, and so does a PUBREC refusing it. The reason
+             * code of MQTT 5 decides the status. */
+            completedAckType = pIncomingPacket->type;
+
+            if( ( ackType == MQTTPubrec ) && ( ackResult == MQTTServerRefused ) )
+            {
+                completedAckType = MQTT_PACKET_TYPE_PUBCOMP;
+            }
 
-        /* Send PUBREL or PUBCOMP if necessary. */
-        status = sendPublishAcks( pContext,
-                                  packetIdentifier,
-                                  publishRecordState );
+            completeOperation( pContext,
+                               pIncomingPacket,
+                               packetIdentifier,
+                               completedAckType,
+                               ackResult );
+
+            /* Send PUBREL or PUBCOMP if necessary. */
+            status = sendPublishAcks( pContext,
+                                      packetIdentifier,
+                                      publishRecordState );
+        }
+
+        return status;
     }
 
-    return status;
-}
+#endif /* if ( MQTT_QOS0_ONLY == 0 ) */
 
 /*-----------------------------------------------------------*/
 
@@ -1674,15 +3477,17 @@ static MQTTStatus_t handleIncomingAck( MQTTContext_t * pContext,
 
     switch( pIncomingPacket->type )
     {
-        case MQTT_PACKET_TYPE_PUBACK:
-        case MQTT_PACKET_TYPE_PUBREC:
-        case MQTT_PACKET_TYPE_PUBREL:
-        case MQTT_PACKET_TYPE_PUBCOMP:
+        #if ( MQTT_QOS0_ONLY == 0 )
+            case MQTT_PACKET_TYPE_PUBACK:
+            case MQTT_PACKET_TYPE_PUBREC:
+            case MQTT_PACKET_TYPE_PUBREL:
+            case MQTT_PACKET_TYPE_PUBCOMP:
 
-            /* Handle all the publish acks. The app callback is invoked here. */
-            status = handlePublishAcks( pContext, pIncomingPacket );
+                /* Handle all the publish acks. The app callback is invoked here. */
+                status = handlePublishAcks( pContext, pIncomingPacket );
 
-            break;
+                break;
+        #endif
 
         case MQTT_PACKET_TYPE_PINGRESP:
             status = MQTT_DeserializeAck( pIncomingPacket, &packetIdentifier, NULL );
@@ -1690,7 +3495,9 @@ static MQTTStatus_t handleIncomingAck( MQTTContext_t * pContext,
 
             if( ( status == MQTTSuccess ) && ( manageKeepAlive == true ) )
             {
+                MQTT_PRE_STATE_UPDATE_HOOK( pContext );
                 pContext->waitingForPingResp = false;
+                MQTT_POST_STATE_UPDATE_HOOK( pContext );
             }
 
             break;
@@ -1698,10 +3505,17 @@ static MQTTStatus_t handleIncomingAck( MQTTContext_t * pContext,
         case MQTT_PACKET_TYPE_SUBACK:
         case MQTT_PACKET_TYPE_UNSUBACK:
             /* Deserialize and give these to the app provided callback. */
-            status = MQTT_DeserializeAck( pIncomingPacket, &packetIdentifier, NULL );
+            status = deserializeIncomingAck( pContext, pIncomingPacket, &packetIdentifier );
             invokeAppCallback = ( status == MQTTSuccess ) || ( status == MQTTServerRefused );
             break;
 
+        case MQTT_PACKET_TYPE_DISCONNECT:
+        case MQTT_PACKET_TYPE_AUTH:
+
+            /* The app callback is invoked here, before the connection ends. */
+            status = handleIncomingDisconnect( pContext, pIncomingPacket );
+            break;
+
         default:
             /* Bad response from the server. */
             LogError( ( "Unexpected packet type from server: PacketType=%02x.",
@@ -1716,548 +3530,469 @@ static MQTTStatus_t handleIncomingAck( MQTTContext_t * pContext,
         deserializedInfo.packetIdentifier = packetIdentifier;
         deserializedInfo.deserializationResult = status;
         deserializedInfo.pPublishInfo = NULL;
+        deserializedInfo.pSubscriptionIds = NULL;
+        deserializedInfo.subscriptionIdCount = 0U;
+        deserializedInfo.reasonCode = 0U;
         appCallback( pContext, pIncomingPacket, &deserializedInfo );
         /* In case a SUBACK indicated refusal, reset the status to continue the loop. */
         status = MQTTSuccess;
+
+        /* The registry is updated after the callback, which can still find the
+         * records awaiting the SUBACK. */
+        if( pIncomingPacket->type == MQTT_PACKET_TYPE_SUBACK )
+        {
+            handleRegistrySubAck( pContext, pIncomingPacket, packetIdentifier );
+        }
+
+        completeOperation( pContext,
+                           pIncomingPacket,
+                           packetIdentifier,
+                           pIncomingPacket->type,
+                           deserializedInfo.deserializationResult );
     }
 
     return status;
 }
+
 /*-----------------------------------------------------------*/
 
-static MQTTStatus_t receiveSingleIteration( MQTTContext_t * pContext,
-                                            bool manageKeepAlive )
+static MQTTStatus_t handleIncomingDisconnect( MQTTContext_t * pContext,
+                                              MQTTPacketInfo_t * pIncomingPacket )
 {
-    MQTTStatus_t status = MQTTSuccess;
-    MQTTPacketInfo_t incomingPacket = { 0 };
-    int32_t recvBytes;
-    size_t totalMQTTPacketLength = 0;
+    MQTTStatus_t status = MQTTBadResponse;
+    uint8_t reasonCode = 0U;
+    MQTTDeserializedInfo_t deserializedInfo;
 
     assert( pContext != NULL );
-    assert( pContext->networkBuffer.pBuffer != NULL );
-
-    /* Read as many bytes as possible into the network buffer. */
-    recvBytes = pContext->transportInterface.recv( pContext->transportInterface.pNetworkContext,
-                                                   &( pContext->networkBuffer.pBuffer[ pContext->index ] ),
-                                                   pContext->networkBuffer.size - pContext->index );
+    assert( pIncomingPacket != NULL );
+    assert( pContext->appCallback != NULL );
 
-    if( recvBytes < 0 )
+    if( pContext->protocolVersion != MQTT_VERSION_5 )
     {
-        /* The receive function has failed. Bubble up the error up to the user. */
-        status = MQTTRecvFailed;
-
-        MQTT_PRE_STATE_UPDATE_HOOK( pContext );
-
-        if( pContext->connectStatus == MQTTConnected )
-        {
-            pContext->connectStatus = MQTTDisconnectPending;
-        }
-
-        MQTT_POST_STATE_UPDATE_HOOK( pContext );
+        LogError( ( "Unexpected packet type from an MQTT 3.1.1 server: PacketType=%02x.",
+                    ( unsigned int ) pIncomingPacket->type ) );
     }
-    else if( ( recvBytes == 0 ) && ( pContext->index == 0U ) )
+    else
     {
-        /* No more bytes available since the last read and neither is anything in
-         * the buffer. */
-        status = MQTTNoDataAvailable;
+        status = MQTT_DeserializeAckV5( pIncomingPacket, NULL, NULL, NULL );
     }
 
-    /* Either something was received, or there is still data to be processed in the
-     * buffer, or both. */
-    else
+    if( status == MQTTSuccess )
     {
-        /* Update the number of bytes in the MQTT fixed buffer. */
-        pContext->index += ( size_t ) recvBytes;
-
-        status = MQTT_ProcessIncomingPacketTypeAndLength( pContext->networkBuffer.pBuffer,
-                                                          &( pContext->index ),
-                                                          &incomingPacket );
-
-        totalMQTTPacketLength = incomingPacket.remainingLength + incomingPacket.headerLength;
+        status = MQTT_GetReasonCodeV5( pIncomingPacket, &reasonCode );
     }
 
-    /* No data was received, check for keep alive timeout. */
-    if( recvBytes == 0 )
+    if( status == MQTTSuccess )
     {
-        if( manageKeepAlive == true )
+        deserializedInfo.packetIdentifier = MQTT_PACKET_ID_INVALID;
+        deserializedInfo.deserializationResult = status;
+        deserializedInfo.pPublishInfo = NULL;
+        deserializedInfo.pSubscriptionIds = NULL;
+        deserializedInfo.subscriptionIdCount = 0U;
+        deserializedInfo.reasonCode = reasonCode;
+        pContext->appCallback( pContext, pIncomingPacket, &deserializedInfo );
+
+        if( pIncomingPacket->type == MQTT_PACKET_TYPE_DISCONNECT )
         {
-            /* Keep the copy of the status to be reset later. */
-            MQTTStatus_t statusCopy = status;
+            LogInfo( ( "Disconnected by the broker with reason code %02x.",
+                       ( unsigned int ) reasonCode ) );
 
-            /* Assign status so an error can be bubbled up to application,
-             * but reset it on success. */
-            status = handleKeepAlive( pContext );
+            /* The server closes the network connection after a DISCONNECT, so
+             * none is sent back. */
+            MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+            pContext->connectStatus = MQTTNotConnected;
+            MQTT_POST_STATE_UPDATE_HOOK( pContext );
 
-            if( status == MQTTSuccess )
-            {
-                /* Reset the status. */
-                status = statusCopy;
-            }
-            else
-            {
-                LogError( ( "Handling of keep alive failed. Status=%s",
-                            MQTT_Status_strerror( status ) ) );
-            }
+            status = MQTTStatusNotConnected;
+        }
+        else
+        {
+            /* The CONNECT has no Authentication Method, so the server may not
+             * start an authentication exchange. */
+            LogError( ( "AUTH received without an Authentication Method in CONNECT." ) );
+            status = MQTTBadResponse;
         }
     }
 
-    /* Check whether there is data available before processing the packet further. */
-    if( ( status == MQTTNeedMoreBytes ) || ( status == MQTTNoDataAvailable ) )
-    {
-        /* Do nothing as there is nothing to be processed right now. The proper
-         * error code will be bubbled up to the user. */
-    }
-    /* Any other error code. */
-    else if( status != MQTTSuccess )
-    {
-        LogError( ( "Call to receiveSingleIteration failed. Status=%s",
-                    MQTT_Status_strerror( status ) ) );
-    }
-    /* If the MQTT Packet size is bigger than the buffer itself. */
-    else if( totalMQTTPacketLength > pContext->networkBuffer.size )
-    {
-        /* Discard the packet from the receive buffer and drain the pending
-         * data from the socket buffer. */
-        status = discardStoredPacket( pContext,
-                                      &incomingPacket );
-    }
-    /* If the total packet is of more length than the bytes we have available. */
-    else if( totalMQTTPacketLength > pContext->index )
-    {
-        status = MQTTNeedMoreBytes;
-    }
-    else
-    {
-        /* MISRA else. */
-    }
+    return status;
+}
+/*-----------------------------------------------------------*/
 
-    /* Handle received packet. If incomplete data was read then this will not execute. */
-    if( status == MQTTSuccess )
+static MQTTStatus_t borrowNetworkBuffer( MQTTContext_t * pContext )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTBufferPool_t * pBufferPool;
+    uint8_t * pBuffer = NULL;
+
+    assert( pContext != NULL );
+
+    pBufferPool = pContext->pBufferPool;
+
+    /* A partially received packet stays in the buffer it was received in. */
+    if( ( pBufferPool != NULL ) &&
+        ( pContext->networkBufferBorrowed == false ) &&
+        ( pContext->index == 0U ) )
     {
-        incomingPacket.pRemainingData = &pContext->networkBuffer.pBuffer[ incomingPacket.headerLength ];
+        pBuffer = takePoolBuffer( pBufferPool );
 
-        /* PUBLISH packets allow flags in the lower four bits. For other
-         * packet types, they are reserved. */
-        if( ( incomingPacket.type & 0xF0U ) == MQTT_PACKET_TYPE_PUBLISH )
+        if( pBuffer != NULL )
         {
-            status = handleIncomingPublish( pContext, &incomingPacket );
+            pContext->networkBuffer.pBuffer = pBuffer;
+            pContext->networkBuffer.size = pBufferPool->bufferSize;
+            pContext->networkBufferBorrowed = true;
         }
-        else
+        else if( pContext->privateNetworkBuffer.pBuffer != NULL )
         {
-            status = handleIncomingAck( pContext, &incomingPacket, manageKeepAlive );
+            LogDebug( ( "Buffer pool is exhausted. Using the network buffer of "
+                        "the context." ) );
         }
-
-        /* Update the index to reflect the remaining bytes in the buffer.  */
-        pContext->index -= totalMQTTPacketLength;
-
-        /* Move the remaining bytes to the front of the buffer. */
-        ( void ) memmove( pContext->networkBuffer.pBuffer,
-                          &( pContext->networkBuffer.pBuffer[ totalMQTTPacketLength ] ),
-                          pContext->index );
-
-        if( status == MQTTSuccess )
+        else
         {
-            pContext->lastPacketRxTime = pContext->getTime();
+            LogWarn( ( "Buffer pool is exhausted and the context has no network "
+                       "buffer of its own. Incoming data is left in the transport." ) );
+            status = MQTTNoMemory;
         }
     }
 
-    if( status == MQTTNoDataAvailable )
-    {
-        /* No data available is not an error. Reset to MQTTSuccess so the
-         * return code will indicate success. */
-        status = MQTTSuccess;
-    }
-
     return status;
 }
 
 /*-----------------------------------------------------------*/
 
-static MQTTStatus_t validateSubscribeUnsubscribeParams( const MQTTContext_t * pContext,
-                                                        const MQTTSubscribeInfo_t * pSubscriptionList,
-                                                        size_t subscriptionCount,
-                                                        uint16_t packetId )
+static void releaseNetworkBuffer( MQTTContext_t * pContext )
 {
-    MQTTStatus_t status = MQTTSuccess;
-    size_t iterator;
+    MQTTBufferPool_t * pBufferPool;
 
-    /* Validate all the parameters. */
-    if( ( pContext == NULL ) || ( pSubscriptionList == NULL ) )
-    {
-        LogError( ( "Argument cannot be NULL: pContext=%p, "
-                    "pSubscriptionList=%p.",
-                    ( void * ) pContext,
-                    ( void * ) pSubscriptionList ) );
-        status = MQTTBadParameter;
-    }
-    else if( subscriptionCount == 0UL )
-    {
-        LogError( ( "Subscription count is 0." ) );
-        status = MQTTBadParameter;
-    }
-    else if( packetId == 0U )
-    {
-        LogError( ( "Packet Id for subscription packet is 0." ) );
-        status = MQTTBadParameter;
-    }
-    else
+    assert( pContext != NULL );
+
+    pBufferPool = pContext->pBufferPool;
+
+    if( ( pContext->networkBufferBorrowed == true ) && ( pContext->index == 0U ) )
     {
-        if( pContext->incomingPublishRecords == NULL )
-        {
-            for( iterator = 0; iterator < subscriptionCount; iterator++ )
-            {
-                if( pSubscriptionList[ iterator ].qos > MQTTQoS0 )
-                {
-                    LogError( ( "The incoming publish record list is not "
-                                "initialised for QoS1/QoS2 records. Please call "
-                                " MQTT_InitStatefulQoS to enable use of QoS1 and "
-                                " QoS2 packets." ) );
-                    status = MQTTBadParameter;
-                    break;
-                }
-            }
-        }
-    }
+        assert( pBufferPool != NULL );
 
-    return status;
+        givePoolBuffer( pBufferPool, pContext->networkBuffer.pBuffer );
+
+        pContext->networkBuffer = pContext->privateNetworkBuffer;
+        pContext->networkBufferBorrowed = false;
+    }
 }
 
 /*-----------------------------------------------------------*/
 
-static size_t addEncodedStringToVector( uint8_t serializedLength[ CORE_MQTT_SERIALIZED_LENGTH_FIELD_BYTES ],
-                                        const char * const string,
-                                        uint16_t length,
-                                        TransportOutVector_t * iterator,
-                                        size_t * updatedLength )
+static uint8_t * takePoolBuffer( MQTTBufferPool_t * pBufferPool )
 {
-    size_t packetLength = 0U;
-    TransportOutVector_t * pLocalIterator = iterator;
-    size_t vectorsAdded = 0U;
+    uint8_t * pBuffer;
 
-    /* When length is non-zero, the string must be non-NULL. */
-    assert( ( length != 0U ) ? ( string != NULL ) : true );
+    assert( pBufferPool != NULL );
 
-    serializedLength[ 0 ] = ( ( uint8_t ) ( ( length ) >> 8 ) );
-    serializedLength[ 1 ] = ( ( uint8_t ) ( ( length ) & 0x00ffU ) );
+    MQTT_PRE_BUFFER_POOL_HOOK( pBufferPool );
 
-    /* Add the serialized length of the string first. */
-    pLocalIterator[ 0 ].iov_base = serializedLength;
-    pLocalIterator[ 0 ].iov_len = CORE_MQTT_SERIALIZED_LENGTH_FIELD_BYTES;
-    vectorsAdded++;
-    packetLength = CORE_MQTT_SERIALIZED_LENGTH_FIELD_BYTES;
+    pBuffer = pBufferPool->pFreeList;
 
-    /* Sometimes the string can be NULL that is, of 0 length. In that case,
-     * only the length field should be encoded in the vector. */
-    if( ( string != NULL ) && ( length != 0U ) )
+    if( pBuffer != NULL )
     {
-        /* Then add the pointer to the string itself. */
-        pLocalIterator[ 1 ].iov_base = string;
-        pLocalIterator[ 1 ].iov_len = length;
-        vectorsAdded++;
-        packetLength += length;
+        /* The link to the next free buffer is stored at the start of the
+         * buffer, which has no alignment requirement. */
+        ( void ) memcpy( &( pBufferPool->pFreeList ), pBuffer, sizeof( pBufferPool->pFreeList ) );
+        pBufferPool->freeCount--;
     }
 
-    ( *updatedLength ) = ( *updatedLength ) + packetLength;
+    MQTT_POST_BUFFER_POOL_HOOK( pBufferPool );
 
-    return vectorsAdded;
+    return pBuffer;
 }
 
 /*-----------------------------------------------------------*/
 
-static MQTTStatus_t sendSubscribeWithoutCopy( MQTTContext_t * pContext,
-                                              const MQTTSubscribeInfo_t * pSubscriptionList,
-                                              size_t subscriptionCount,
-                                              uint16_t packetId,
-                                              size_t remainingLength )
+static void givePoolBuffer( MQTTBufferPool_t * pBufferPool,
+                            uint8_t * pBuffer )
 {
-    MQTTStatus_t status = MQTTSuccess;
-    uint8_t * pIndex;
-    TransportOutVector_t pIoVector[ MQTT_SUB_UNSUB_MAX_VECTORS ];
-    TransportOutVector_t * pIterator;
-    uint8_t serializedTopicFieldLength[ MQTT_SUB_UNSUB_MAX_VECTORS ][ CORE_MQTT_SERIALIZED_LENGTH_FIELD_BYTES ];
-    size_t totalPacketLength = 0U;
-    size_t ioVectorLength = 0U;
-    size_t subscriptionsSent = 0U;
-    size_t vectorsAdded;
-    size_t topicFieldLengthIndex;
+    assert( pBufferPool != NULL );
+    assert( pBuffer != NULL );
 
-    /* Maximum number of bytes required by the 'fixed' part of the SUBSCRIBE
-     * packet header according to the MQTT specification.
-     * MQTT Control Byte      0 + 1 = 1
-     * Remaining length (max)   + 4 = 5
-     * Packet ID                + 2 = 7 */
-    uint8_t subscribeheader[ 7U ];
+    MQTT_PRE_BUFFER_POOL_HOOK( pBufferPool );
 
-    /* The vector array should be at least three element long as the topic
-     * string needs these many vector elements to be stored. */
-    assert( MQTT_SUB_UNSUB_MAX_VECTORS >= CORE_MQTT_SUBSCRIBE_PER_TOPIC_VECTOR_LENGTH );
+    ( void ) memcpy( pBuffer, &( pBufferPool->pFreeList ), sizeof( pBufferPool->pFreeList ) );
+    pBufferPool->pFreeList = pBuffer;
+    pBufferPool->freeCount++;
 
-    pIndex = subscribeheader;
-    pIterator = pIoVector;
+    MQTT_POST_BUFFER_POOL_HOOK( pBufferPool );
+}
 
-    pIndex = MQTT_SerializeSubscribeHeader( remainingLength,
-                                            pIndex,
-                                            packetId );
+/*-----------------------------------------------------------*/
 
-    /* The header is to be sent first. */
-    pIterator->iov_base = subscribeheader;
-    /* More details at: https://github.com/FreeRTOS/coreMQTT/blob/main/MISRA.md#rule-182 */
-    /* More details at: https://github.com/FreeRTOS/coreMQTT/blob/main/MISRA.md#rule-108 */
-    /* coverity[misra_c_2012_rule_18_2_violation] */
-    /* coverity[misra_c_2012_rule_10_8_violation] */
-    pIterator->iov_len = ( size_t ) ( pIndex - subscribeheader );
-    totalPacketLength += pIterator->iov_len;
-    pIterator++;
-    ioVectorLength++;
+static void consumeNetworkBuffer( MQTTContext_t * pContext,
+                                  size_t packetLength )
+{
+    uint8_t * pPacket = pContext->networkBuffer.pBuffer;
 
-    while( ( status == MQTTSuccess ) && ( subscriptionsSent < subscriptionCount ) )
-    {
-        /* Reset the index for next iteration. */
-        topicFieldLengthIndex = 0;
+    /* Update the index to reflect the remaining bytes in the buffer. */
+    pContext->index -= packetLength;
 
-        /* Check whether the subscription topic (with QoS) will fit in the
-         * given vector. */
-        while( ( ioVectorLength <= ( MQTT_SUB_UNSUB_MAX_VECTORS - CORE_MQTT_SUBSCRIBE_PER_TOPIC_VECTOR_LENGTH ) ) &&
-               ( subscriptionsSent < subscriptionCount ) )
-        {
-            /* The topic filter and the filter length gets sent next. */
-            vectorsAdded = addEncodedStringToVector( serializedTopicFieldLength[ topicFieldLengthIndex ],
-                                                     pSubscriptionList[ subscriptionsSent ].pTopicFilter,
-                                                     pSubscriptionList[ subscriptionsSent ].topicFilterLength,
-                                                     pIterator,
-                                                     &totalPacketLength );
+    if( pContext->pReplacementBuffer == NULL )
+    {
+        /* Move the remaining bytes to the front of the buffer. */
+        ( void ) memmove( pPacket,
+                          &( pPacket[ packetLength ] ),
+                          pContext->index );
+    }
+    else
+    {
+        /* The claimed buffer now belongs to the application. The remaining
+         * bytes continue in the buffer which replaces it. */
+        ( void ) memcpy( pContext->pReplacementBuffer,
+                         &( pPacket[ packetLength ] ),
+                         pContext->index );
+        pContext->networkBuffer.pBuffer = pContext->pReplacementBuffer;
+        pContext->pReplacementBuffer = NULL;
+    }
+}
 
-            /* Update the pointer after the above operation. */
-            pIterator = &pIterator[ vectorsAdded ];
+/*-----------------------------------------------------------*/
 
-            /* Lastly, the QoS gets sent. */
-            pIterator->iov_base = &( pSubscriptionList[ subscriptionsSent ].qos );
-            pIterator->iov_len = 1U;
-            totalPacketLength += pIterator->iov_len;
+#if ( MQTT_QOS0_ONLY == 0 )
 
-            /* Increment the pointer. */
-            pIterator++;
+    static MQTTPubAckInfo_t * claimSlabChunk( MQTTRecordSlab_t * pRecordSlab )
+    {
+        MQTTPubAckInfo_t * pChunk = NULL;
+        size_t wordIndex, wordCount;
+        uint32_t freeChunks, claimedChunk = 0U;
+        bool claimed = false;
 
-            /* Two slots get used by the topic string length and topic string.
-             * One slot gets used by the quality of service. */
-            ioVectorLength += vectorsAdded + 1U;
+        assert( pRecordSlab != NULL );
 
-            subscriptionsSent++;
+        wordCount = MQTT_RECORD_SLAB_BITMAP_WORDS( pRecordSlab->chunkCount );
 
-            /* The index needs to be updated for next iteration. */
-            topicFieldLengthIndex++;
-        }
+        #if ( MQTT_RECORD_SLAB_USE_ATOMICS == 0 )
+            MQTT_PRE_RECORD_SLAB_HOOK( pRecordSlab );
+        #endif
 
-        if( sendMessageVector( pContext,
-                               pIoVector,
-                               ioVectorLength ) != ( int32_t ) totalPacketLength )
+        for( wordIndex = 0U; ( wordIndex < wordCount ) && ( claimed == false ); wordIndex++ )
         {
-            status = MQTTSendFailed;
+            #if ( MQTT_RECORD_SLAB_USE_ATOMICS != 0 )
+                freeChunks = __atomic_load_n( &pRecordSlab->pFreeChunks[ wordIndex ], __ATOMIC_ACQUIRE );
+            #else
+                freeChunks = pRecordSlab->pFreeChunks[ wordIndex ];
+            #endif
+
+            while( ( freeChunks != 0U ) && ( claimed == false ) )
+            {
+                /* Isolate the lowest free chunk of the word. */
+                claimedChunk = freeChunks & ( ~freeChunks + 1U );
+
+                #if ( MQTT_RECORD_SLAB_USE_ATOMICS != 0 )
+
+                    /* On failure, freeChunks is reloaded with the current value
+                     * of the word, so the claim is retried on what remains. */
+                    claimed = __atomic_compare_exchange_n( &pRecordSlab->pFreeChunks[ wordIndex ],
+                                                           &freeChunks,
+                                                           freeChunks & ~claimedChunk,
+                                                           false,
+                                                           __ATOMIC_ACQ_REL,
+                                                           __ATOMIC_ACQUIRE );
+                #else
+                    pRecordSlab->pFreeChunks[ wordIndex ] = freeChunks & ~claimedChunk;
+                    claimed = true;
+                #endif
+            }
+
+            if( claimed == true )
+            {
+                size_t chunkIndex = wordIndex * 32U;
+
+                while( claimedChunk != 1U )
+                {
+                    claimedChunk >>= 1U;
+                    chunkIndex++;
+                }
+
+                pChunk = &pRecordSlab->pRecords[ chunkIndex * pRecordSlab->recordsPerChunk ];
+            }
         }
 
-        /* Update the iterator for the next potential loop iteration. */
-        pIterator = pIoVector;
-        /* Reset the vector length for the next potential loop iteration. */
-        ioVectorLength = 0U;
-        /* Reset the packet length for the next potential loop iteration. */
-        totalPacketLength = 0U;
+        #if ( MQTT_RECORD_SLAB_USE_ATOMICS == 0 )
+            MQTT_POST_RECORD_SLAB_HOOK( pRecordSlab );
+        #endif
+
+        return pChunk;
     }
 
-    return status;
-}
+#endif /* if ( MQTT_QOS0_ONLY == 0 ) */
 
 /*-----------------------------------------------------------*/
 
-static MQTTStatus_t sendUnsubscribeWithoutCopy( MQTTContext_t * pContext,
-                                                const MQTTSubscribeInfo_t * pSubscriptionList,
-                                                size_t subscriptionCount,
-                                                uint16_t packetId,
-                                                size_t remainingLength )
-{
-    MQTTStatus_t status = MQTTSuccess;
-    uint8_t * pIndex;
-    TransportOutVector_t pIoVector[ MQTT_SUB_UNSUB_MAX_VECTORS ];
-    TransportOutVector_t * pIterator;
-    uint8_t serializedTopicFieldLength[ MQTT_SUB_UNSUB_MAX_VECTORS ][ CORE_MQTT_SERIALIZED_LENGTH_FIELD_BYTES ];
-    size_t totalPacketLength = 0U;
-    size_t unsubscriptionsSent = 0U;
-    size_t ioVectorLength = 0U;
-    size_t vectorsAdded;
-    size_t topicFieldLengthIndex;
+#if ( MQTT_QOS0_ONLY == 0 )
 
-    /* Maximum number of bytes required by the 'fixed' part of the UNSUBSCRIBE
-     * packet header according to the MQTT specification.
-     * MQTT Control Byte      0 + 1 = 1
-     * Remaining length (max)   + 4 = 5
-     * Packet ID                + 2 = 7  */
-    uint8_t unsubscribeheader[ 7U ];
+    static void releaseSlabChunk( MQTTRecordSlab_t * pRecordSlab,
+                                  MQTTPubAckInfo_t * pChunk )
+    {
+        size_t chunkIndex;
+        uint32_t chunkBit;
 
-    /* The vector array should be at least three element long as the topic
-     * string needs these many vector elements to be stored. */
-    assert( MQTT_SUB_UNSUB_MAX_VECTORS >= CORE_MQTT_UNSUBSCRIBE_PER_TOPIC_VECTOR_LENGTH );
+        assert( pRecordSlab != NULL );
+        assert( pChunk != NULL );
 
-    pIndex = unsubscribeheader;
-    pIterator = pIoVector;
+        chunkIndex = ( size_t ) ( pChunk - pRecordSlab->pRecords ) / pRecordSlab->recordsPerChunk;
+        assert( chunkIndex < pRecordSlab->chunkCount );
 
-    pIndex = MQTT_SerializeUnsubscribeHeader( remainingLength,
-                                              pIndex,
-                                              packetId );
+        chunkBit = ( uint32_t ) 1U << ( chunkIndex % 32U );
 
-    /* The header is to be sent first. */
-    pIterator->iov_base = unsubscribeheader;
-    /* More details at: https://github.com/FreeRTOS/coreMQTT/blob/main/MISRA.md#rule-182 */
-    /* More details at: https://github.com/FreeRTOS/coreMQTT/blob/main/MISRA.md#rule-108 */
-    /* coverity[misra_c_2012_rule_18_2_violation] */
-    /* coverity[misra_c_2012_rule_10_8_violation] */
-    pIterator->iov_len = ( size_t ) ( pIndex - unsubscribeheader );
-    totalPacketLength += pIterator->iov_len;
-    pIterator++;
-    ioVectorLength++;
+        #if ( MQTT_RECORD_SLAB_USE_ATOMICS != 0 )
+            ( void ) __atomic_fetch_or( &pRecordSlab->pFreeChunks[ chunkIndex / 32U ],
+                                        chunkBit,
+                                        __ATOMIC_RELEASE );
+        #else
+            MQTT_PRE_RECORD_SLAB_HOOK( pRecordSlab );
+            pRecordSlab->pFreeChunks[ chunkIndex / 32U ] |= chunkBit;
+            MQTT_POST_RECORD_SLAB_HOOK( pRecordSlab );
+        #endif
+    }
 
-    while( ( status == MQTTSuccess ) && ( unsubscriptionsSent < subscriptionCount ) )
-    {
-        /* Reset the index for next iteration. */
-        topicFieldLengthIndex = 0;
+#endif /* if ( MQTT_QOS0_ONLY == 0 ) */
 
-        /* Check whether the subscription topic will fit in the given vector. */
-        while( ( ioVectorLength <= ( MQTT_SUB_UNSUB_MAX_VECTORS - CORE_MQTT_UNSUBSCRIBE_PER_TOPIC_VECTOR_LENGTH ) ) &&
-               ( unsubscriptionsSent < subscriptionCount ) )
-        {
-            /* The topic filter gets sent next. */
-            vectorsAdded = addEncodedStringToVector( serializedTopicFieldLength[ topicFieldLengthIndex ],
-                                                     pSubscriptionList[ unsubscriptionsSent ].pTopicFilter,
-                                                     pSubscriptionList[ unsubscriptionsSent ].topicFilterLength,
-                                                     pIterator,
-                                                     &totalPacketLength );
+/*-----------------------------------------------------------*/
 
-            /* Update the iterator to point to the next empty location. */
-            pIterator = &pIterator[ vectorsAdded ];
-            /* Update the total count based on how many vectors were added. */
-            ioVectorLength += vectorsAdded;
+#if ( MQTT_QOS0_ONLY == 0 )
 
-            unsubscriptionsSent++;
+    static MQTTStatus_t claimStateRecords( MQTTContext_t * pContext,
+                                           bool isOutgoing )
+    {
+        MQTTStatus_t status = MQTTSuccess;
+        MQTTPubAckInfo_t ** pRecords;
+        size_t * pRecordMaxCount;
 
-            /* Update the index for next iteration. */
-            topicFieldLengthIndex++;
+        assert( pContext != NULL );
+
+        if( isOutgoing == true )
+        {
+            pRecords = &pContext->outgoingPublishRecords;
+            pRecordMaxCount = &pContext->outgoingPublishRecordMaxCount;
+        }
+        else
+        {
+            pRecords = &pContext->incomingPublishRecords;
+            pRecordMaxCount = &pContext->incomingPublishRecordMaxCount;
         }
 
-        if( sendMessageVector( pContext, pIoVector, ioVectorLength ) != ( int32_t ) totalPacketLength )
+        if( ( pContext->pRecordSlab != NULL ) && ( *pRecords == NULL ) )
         {
-            status = MQTTSendFailed;
+            *pRecords = claimSlabChunk( pContext->pRecordSlab );
+
+            if( *pRecords == NULL )
+            {
+                LogError( ( "No free chunk of state records in the slab." ) );
+                status = MQTTNoMemory;
+            }
+            else
+            {
+                *pRecordMaxCount = pContext->pRecordSlab->recordsPerChunk;
+                ( void ) memset( *pRecords, 0x00, *pRecordMaxCount * sizeof( **pRecords ) );
+            }
         }
 
-        /* Update the iterator for the next potential loop iteration. */
-        pIterator = pIoVector;
-        /* Reset the vector length for the next potential loop iteration. */
-        ioVectorLength = 0U;
-        /* Reset the packet length for the next potential loop iteration. */
-        totalPacketLength = 0U;
+        return status;
     }
 
-    return status;
-}
+#endif /* if ( MQTT_QOS0_ONLY == 0 ) */
 
 /*-----------------------------------------------------------*/
 
-static MQTTStatus_t sendPublishWithoutCopy( MQTTContext_t * pContext,
-                                            const MQTTPublishInfo_t * pPublishInfo,
-                                            uint8_t * pMqttHeader,
-                                            size_t headerSize,
-                                            uint16_t packetId )
-{
-    MQTTStatus_t status = MQTTSuccess;
-    size_t ioVectorLength;
-    size_t totalMessageLength;
-    bool dupFlagChanged = false;
+#if ( MQTT_QOS0_ONLY == 0 )
 
-    /* Bytes required to encode the packet ID in an MQTT header according to
-     * the MQTT specification. */
-    uint8_t serializedPacketID[ 2U ];
+    static void releaseStateRecords( MQTTContext_t * pContext )
+    {
+        size_t index;
+        bool isEmpty;
 
-    /* Maximum number of vectors required to encode and send a publish
-     * packet. The breakdown is shown below.
-     * Fixed header (including topic string length)      0 + 1 = 1
-     * Topic string                                        + 1 = 2
-     * Packet ID (only when QoS > QoS0)                    + 1 = 3
-     * Payload                                             + 1 = 4  */
-    TransportOutVector_t pIoVector[ 4U ];
+        assert( pContext != NULL );
 
-    /* The header is sent first. */
-    pIoVector[ 0U ].iov_base = pMqttHeader;
-    pIoVector[ 0U ].iov_len = headerSize;
-    totalMessageLength = headerSize;
+        if( pContext->pRecordSlab != NULL )
+        {
+            if( pContext->outgoingPublishRecords != NULL )
+            {
+                isEmpty = true;
 
-    /* Then the topic name has to be sent. */
-    pIoVector[ 1U ].iov_base = pPublishInfo->pTopicName;
-    pIoVector[ 1U ].iov_len = pPublishInfo->topicNameLength;
-    totalMessageLength += pPublishInfo->topicNameLength;
+                for( index = 0U; ( index < pContext->outgoingPublishRecordMaxCount ) && ( isEmpty == true ); index++ )
+                {
+                    isEmpty = ( pContext->outgoingPublishRecords[ index ].packetId == MQTT_PACKET_ID_INVALID );
+                }
 
-    /* The next field's index should be 2 as the first two fields
-     * have been filled in. */
-    ioVectorLength = 2U;
+                if( isEmpty == true )
+                {
+                    releaseSlabChunk( pContext->pRecordSlab, pContext->outgoingPublishRecords );
+                    pContext->outgoingPublishRecords = NULL;
+                    pContext->outgoingPublishRecordMaxCount = 0U;
+                }
+            }
 
-    if( pPublishInfo->qos > MQTTQoS0 )
-    {
-        /* Encode the packet ID. */
-        serializedPacketID[ 0 ] = ( ( uint8_t ) ( ( packetId ) >> 8 ) );
-        serializedPacketID[ 1 ] = ( ( uint8_t ) ( ( packetId ) & 0x00ffU ) );
+            if( pContext->incomingPublishRecords != NULL )
+            {
+                isEmpty = true;
 
-        pIoVector[ ioVectorLength ].iov_base = serializedPacketID;
-        pIoVector[ ioVectorLength ].iov_len = sizeof( serializedPacketID );
+                for( index = 0U; ( index < pContext->incomingPublishRecordMaxCount ) && ( isEmpty == true ); index++ )
+                {
+                    isEmpty = ( pContext->incomingPublishRecords[ index ].packetId == MQTT_PACKET_ID_INVALID );
+                }
 
-        ioVectorLength++;
-        totalMessageLength += sizeof( serializedPacketID );
+                if( isEmpty == true )
+                {
+                    releaseSlabChunk( pContext->pRecordSlab, pContext->incomingPublishRecords );
+                    pContext->incomingPublishRecords = NULL;
+                    pContext->incomingPublishRecordMaxCount = 0U;
+                }
+            }
+        }
     }
 
-    /* Publish packets are allowed to contain no payload. */
-    if( pPublishInfo->payloadLength > 0U )
-    {
-        pIoVector[ ioVectorLength ].iov_base = pPublishInfo->pPayload;
-        pIoVector[ ioVectorLength ].iov_len = pPublishInfo->payloadLength;
+#endif /* if ( MQTT_QOS0_ONLY == 0 ) */
 
-        ioVectorLength++;
-        totalMessageLength += pPublishInfo->payloadLength;
-    }
+/*-----------------------------------------------------------*/
 
-    /* store a copy of the publish for retransmission purposes */
-    if( ( pPublishInfo->qos > MQTTQoS0 ) &&
-        ( pContext->storeFunction != NULL ) )
-    {
-        /* If not already set, set the dup flag before storing a copy of the publish
-         * this is because on retrieving back this copy we will get it in the form of an
-         * array of TransportOutVector_t that holds the data in a const pointer which cannot be
-         * changed after retrieving. */
-        if( pPublishInfo->dup != true )
-        {
-            status = MQTT_UpdateDuplicatePublishFlag( pMqttHeader, true );
+static MQTTStatus_t deserializeIncomingPublish( const MQTTContext_t * pContext,
+                                                const MQTTPacketInfo_t * pIncomingPacket,
+                                                uint16_t * pPacketId,
+                                                MQTTPublishInfo_t * pPublishInfo,
+                                                uint32_t * pSubscriptionIds,
+                                                size_t * pSubscriptionIdCount )
+{
+    MQTTStatus_t status;
 
-            dupFlagChanged = ( status == MQTTSuccess );
-        }
+    assert( pSubscriptionIdCount != NULL );
 
-        if( status == MQTTSuccess )
-        {
-            MQTTVec_t mqttVec;
+    if( pContext->protocolVersion == MQTT_VERSION_5 )
+    {
+        *pSubscriptionIdCount = MQTT_MAX_SUBSCRIPTION_IDS;
+        status = MQTT_DeserializePublishV5( pIncomingPacket,
+                                            pPacketId,
+                                            pPublishInfo,
+                                            pSubscriptionIds,
+                                            pSubscriptionIdCount );
+    }
+    else
+    {
+        *pSubscriptionIdCount = 0U;
+        status = MQTT_DeserializePublish( pIncomingPacket, pPacketId, pPublishInfo );
+    }
 
-            mqttVec.pVector = pIoVector;
-            mqttVec.vectorLen = ioVectorLength;
+    return status;
+}
 
-            if( pContext->storeFunction( pContext, packetId, &mqttVec ) != true )
-            {
-                status = MQTTPublishStoreFailed;
-            }
-        }
+/*-----------------------------------------------------------*/
 
-        /* change the value of the dup flag to its original, if it was changed */
-        if( ( status == MQTTSuccess ) && ( dupFlagChanged == true ) )
-        {
-            status = MQTT_UpdateDuplicatePublishFlag( pMqttHeader, false );
-        }
-    }
+static MQTTStatus_t deserializeIncomingAck( const MQTTContext_t * pContext,
+                                            const MQTTPacketInfo_t * pIncomingPacket,
+                                            uint16_t * pPacketId )
+{
+    MQTTStatus_t status;
 
-    if( ( status == MQTTSuccess ) &&
-        ( sendMessageVector( pContext, pIoVector, ioVectorLength ) != ( int32_t ) totalMessageLength ) )
+    if( pContext->protocolVersion == MQTT_VERSION_5 )
     {
-        status = MQTTSendFailed;
+        status = MQTT_DeserializeAckV5( pIncomingPacket, pPacketId, NULL, NULL );
+    }
+    else
+    {
+        status = MQTT_DeserializeAck( pIncomingPacket, pPacketId, NULL );
     }
 
     return status;
@@ -2265,13 +4000,1727 @@ static MQTTStatus_t sendPublishWithoutCopy( MQTTContext_t * pContext,
 
 /*-----------------------------------------------------------*/
 
-static MQTTStatus_t sendConnectWithoutCopy( MQTTContext_t * pContext,
-                                            const MQTTConnectInfo_t * pConnectInfo,
-                                            const MQTTPublishInfo_t * pWillInfo,
-                                            size_t remainingLength )
+static void resetTopicAliases( MQTTContext_t * pContext,
+                               uint16_t topicAliasMaximum )
 {
-    MQTTStatus_t status = MQTTSuccess;
-    TransportOutVector_t * iterator;
+    uint16_t index;
+
+    assert( pContext != NULL );
+
+    /* Aliases are scoped to a network connection. */
+    for( index = 0U; index < pContext->topicAliasMaxCount; index++ )
+    {
+        pContext->pTopicAliases[ index ].topicNameLength = 0U;
+    }
+
+    pContext->topicAliasCount = ( topicAliasMaximum < pContext->topicAliasMaxCount ) ?
+                                topicAliasMaximum : pContext->topicAliasMaxCount;
+    pContext->topicAliasClock = 0U;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint16_t getTopicAlias( MQTTContext_t * pContext,
+                               const char * pTopicName,
+                               uint16_t topicNameLength,
+                               bool * pAssigned )
+{
+    MQTTTopicAliasRecord_t * pRecord;
+    uint32_t topicHash, age, oldestAge = 0U;
+    uint16_t index, topicAlias = 0U;
+    uint16_t freeIndex = pContext->topicAliasCount;
+    uint16_t oldestIndex = 0U;
+
+    assert( pContext != NULL );
+    assert( pContext->topicAliasCount > 0U );
+    assert( pTopicName != NULL );
+    assert( pAssigned != NULL );
+
+    *pAssigned = false;
+
+    if( topicNameLength <= MQTT_TOPIC_ALIAS_MAX_TOPIC_LENGTH )
+    {
+        topicHash = hashTopic( pTopicName, topicNameLength );
+
+        /* A single scan finds the alias of the topic, or else a free record
+         * and the least recently used one to replace. */
+        for( index = 0U; index < pContext->topicAliasCount; index++ )
+        {
+            pRecord = &pContext->pTopicAliases[ index ];
+
+            if( pRecord->topicNameLength == 0U )
+            {
+                if( freeIndex == pContext->topicAliasCount )
+                {
+                    freeIndex = index;
+                }
+            }
+            else if( ( pRecord->topicHash == topicHash ) &&
+                     ( pRecord->topicNameLength == topicNameLength ) &&
+                     ( memcmp( pRecord->topicName, pTopicName, topicNameLength ) == 0 ) )
+            {
+                topicAlias = index + 1U;
+                break;
+            }
+            else
+            {
+                /* The clock wraps around, so the age is compared rather than
+                 * the timestamp. */
+                age = pContext->topicAliasClock - pRecord->lastUsed;
+
+                if( age >= oldestAge )
+                {
+                    oldestAge = age;
+                    oldestIndex = index;
+                }
+            }
+        }
+
+        if( topicAlias == 0U )
+        {
+            index = ( freeIndex < pContext->topicAliasCount ) ? freeIndex : oldestIndex;
+            pRecord = &pContext->pTopicAliases[ index ];
+
+            ( void ) memcpy( pRecord->topicName, pTopicName, topicNameLength );
+            pRecord->topicNameLength = topicNameLength;
+            pRecord->topicHash = topicHash;
+
+            topicAlias = index + 1U;
+            *pAssigned = true;
+        }
+
+        pContext->pTopicAliases[ topicAlias - 1U ].lastUsed = pContext->topicAliasClock;
+        pContext->topicAliasClock++;
+    }
+
+    return topicAlias;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t receiveSingleIteration( MQTTContext_t * pContext,
+                                            bool manageKeepAlive )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    int32_t recvBytes = 0;
+    size_t totalMQTTPacketLength = 0;
+
+    assert( pContext != NULL );
+    assert( ( pContext->networkBuffer.pBuffer != NULL ) || ( pContext->pBufferPool != NULL ) );
+
+    status = borrowNetworkBuffer( pContext );
+
+    if( status == MQTTSuccess )
+    {
+        /* Read as many bytes as possible into the network buffer. */
+        recvBytes = pContext->transportInterface.recv( pContext->transportInterface.pNetworkContext,
+                                                       &( pContext->networkBuffer.pBuffer[ pContext->index ] ),
+                                                       pContext->networkBuffer.size - pContext->index );
+    }
+
+    if( status != MQTTSuccess )
+    {
+        /* Without a buffer, nothing is read from the transport. Keep alive is
+         * still managed below. */
+    }
+    else if( recvBytes < 0 )
+    {
+        /* The receive function has failed. Bubble up the error up to the user. */
+        status = MQTTRecvFailed;
+
+        MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+
+        if( pContext->connectStatus == MQTTConnected )
+        {
+            pContext->connectStatus = MQTTDisconnectPending;
+        }
+
+        MQTT_POST_STATE_UPDATE_HOOK( pContext );
+    }
+    else if( ( recvBytes == 0 ) && ( pContext->index == 0U ) )
+    {
+        /* No more bytes available since the last read and neither is anything in
+         * the buffer. */
+        status = MQTTNoDataAvailable;
+    }
+
+    /* Either something was received, or there is still data to be processed in the
+     * buffer, or both. */
+    else
+    {
+        /* Update the number of bytes in the MQTT fixed buffer. */
+        pContext->index += ( size_t ) recvBytes;
+
+        status = MQTT_ProcessIncomingPacketTypeAndLength( pContext->networkBuffer.pBuffer,
+                                                          &( pContext->index ),
+                                                          &incomingPacket );
+
+        totalMQTTPacketLength = incomingPacket.remainingLength + incomingPacket.headerLength;
+    }
+
+    /* No data was received, check for keep alive timeout. */
+    if( recvBytes == 0 )
+    {
+        if( manageKeepAlive == true )
+        {
+            /* Keep the copy of the status to be reset later. */
+            MQTTStatus_t statusCopy = status;
+
+            /* Assign status so an error can be bubbled up to application,
+             * but reset it on success. */
+            status = handleKeepAlive( pContext );
+
+            if( status == MQTTSuccess )
+            {
+                /* Reset the status. */
+                status = statusCopy;
+            }
+            else
+            {
+                LogError( ( "Handling of keep alive failed. Status=%s",
+                            MQTT_Status_strerror( status ) ) );
+            }
+        }
+    }
+
+    /* Check whether there is data available before processing the packet further. */
+    if( ( status == MQTTNeedMoreBytes ) || ( status == MQTTNoDataAvailable ) )
+    {
+        /* Do nothing as there is nothing to be processed right now. The proper
+         * error code will be bubbled up to the user. */
+    }
+    /* Any other error code. */
+    else if( status != MQTTSuccess )
+    {
+        LogError( ( "Call to receiveSingleIteration failed. Status=%s",
+                    MQTT_Status_strerror( status ) ) );
+    }
+    /* If the MQTT Packet size is bigger than the buffer itself. */
+    else if( totalMQTTPacketLength > pContext->networkBuffer.size )
+    {
+        /* Discard the packet from the receive buffer and drain the pending
+         * data from the socket buffer. */
+        status = discardStoredPacket( pContext,
+                                      &incomingPacket );
+    }
+    /* If the total packet is of more length than the bytes we have available. */
+    else if( totalMQTTPacketLength > pContext->index )
+    {
+        status = MQTTNeedMoreBytes;
+    }
+    else
+    {
+        /* MISRA else. */
+    }
+
+    /* Handle received packet. If incomplete data was read then this will not execute. */
+    if( status == MQTTSuccess )
+    {
+        incomingPacket.pRemainingData = &pContext->networkBuffer.pBuffer[ incomingPacket.headerLength ];
+
+        /* PUBLISH packets allow flags in the lower four bits. For other
+         * packet types, they are reserved. */
+        if( ( incomingPacket.type & 0xF0U ) == MQTT_PACKET_TYPE_PUBLISH )
+        {
+            /* Only a buffer of the pool can be claimed by the application. */
+            if( pContext->networkBufferBorrowed == true )
+            {
+                pContext->pClaimableBuffer = pContext->networkBuffer.pBuffer;
+            }
+
+            status = handleIncomingPublish( pContext, &incomingPacket );
+            pContext->pClaimableBuffer = NULL;
+        }
+        else
+        {
+            status = handleIncomingAck( pContext, &incomingPacket, manageKeepAlive );
+        }
+
+        consumeNetworkBuffer( pContext, totalMQTTPacketLength );
+
+        if( status == MQTTSuccess )
+        {
+            pContext->lastPacketRxTime = pContext->getTime();
+        }
+    }
+
+    if( status == MQTTNoDataAvailable )
+    {
+        /* No data available is not an error. Reset to MQTTSuccess so the
+         * return code will indicate success. */
+        status = MQTTSuccess;
+    }
+
+    /* Give the buffer back to the pool once all received data is processed. */
+    releaseNetworkBuffer( pContext );
+
+    #if ( MQTT_QOS0_ONLY == 0 )
+        if( pContext->pRecordSlab != NULL )
+        {
+            /* Acks handled above may have completed the last publishes in flight. */
+            MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+            releaseStateRecords( pContext );
+            MQTT_POST_STATE_UPDATE_HOOK( pContext );
+        }
+    #endif
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t validateSubscribeUnsubscribeParams( const MQTTContext_t * pContext,
+                                                        const MQTTSubscribeInfo_t * pSubscriptionList,
+                                                        size_t subscriptionCount,
+                                                        uint16_t packetId )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    size_t iterator;
+
+    /* Validate all the parameters. */
+    if( ( pContext == NULL ) || ( pSubscriptionList == NULL ) )
+    {
+        LogError( ( "Argument cannot be NULL: pContext=%p, "
+                    "pSubscriptionList=%p.",
+                    ( void * ) pContext,
+                    ( void * ) pSubscriptionList ) );
+        status = MQTTBadParameter;
+    }
+    else if( subscriptionCount == 0UL )
+    {
+        LogError( ( "Subscription count is 0." ) );
+        status = MQTTBadParameter;
+    }
+    else if( packetId == 0U )
+    {
+        LogError( ( "Packet Id for subscription packet is 0." ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        #if ( MQTT_QOS0_ONLY == 0 )
+            if( ( pContext->incomingPublishRecords == NULL ) && ( pContext->pRecordSlab == NULL ) )
+            {
+                for( iterator = 0; iterator < subscriptionCount; iterator++ )
+                {
+                    if( pSubscriptionList[ iterator ].qos > MQTTQoS0 )
+                    {
+                        LogError( ( "The incoming publish record list is not "
+                                    "initialised for QoS1/QoS2 records. Please call "
+                                    " MQTT_InitStatefulQoS to enable use of QoS1 and "
+                                    " QoS2 packets." ) );
+                        status = MQTTBadParameter;
+                        break;
+                    }
+                }
+            }
+        #else
+            for( iterator = 0; iterator < subscriptionCount; iterator++ )
+            {
+                if( pSubscriptionList[ iterator ].qos > MQTTQoS0 )
+                {
+                    LogError( ( "Subscriptions with QoS > MQTTQoS0 are not "
+                                "supported when MQTT_QOS0_ONLY is enabled." ) );
+                    status = MQTTBadParameter;
+                    break;
+                }
+            }
+        #endif
+
+        /* A missing topic filter is reported by the serializer, so only the
+         * contents of present topic filters are validated here. */
+        for( iterator = 0; ( iterator < subscriptionCount ) && ( status == MQTTSuccess ); iterator++ )
+        {
+            if( ( pSubscriptionList[ iterator ].pTopicFilter != NULL ) &&
+                ( pSubscriptionList[ iterator ].topicFilterLength > 0U ) )
+            {
+                status = MQTT_ValidateTopic( pSubscriptionList[ iterator ].pTopicFilter,
+                                             pSubscriptionList[ iterator ].topicFilterLength,
+                                             true,
+                                             NULL,
+                                             NULL );
+            }
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t addEncodedStringToVector( uint8_t serializedLength[ CORE_MQTT_SERIALIZED_LENGTH_FIELD_BYTES ],
+                                        const char * const string,
+                                        uint16_t length,
+                                        TransportOutVector_t * iterator,
+                                        size_t * updatedLength )
+{
+    size_t packetLength = 0U;
+    TransportOutVector_t * pLocalIterator = iterator;
+    size_t vectorsAdded = 0U;
+
+    /* When length is non-zero, the string must be non-NULL. */
+    assert( ( length != 0U ) ? ( string != NULL ) : true );
+
+    serializedLength[ 0 ] = ( ( uint8_t ) ( ( length ) >> 8 ) );
+    serializedLength[ 1 ] = ( ( uint8_t ) ( ( length ) & 0x00ffU ) );
+
+    /* Add the serialized length of the string first. */
+    pLocalIterator[ 0 ].iov_base = serializedLength;
+    pLocalIterator[ 0 ].iov_len = CORE_MQTT_SERIALIZED_LENGTH_FIELD_BYTES;
+    vectorsAdded++;
+    packetLength = CORE_MQTT_SERIALIZED_LENGTH_FIELD_BYTES;
+
+    /* Sometimes the string can be NULL that is, of 0 length. In that case,
+     * only the length field should be encoded in the vector. */
+    if( ( string != NULL ) && ( length != 0U ) )
+    {
+        /* Then add the pointer to the string itself. */
+        pLocalIterator[ 1 ].iov_base = string;
+        pLocalIterator[ 1 ].iov_len = length;
+        vectorsAdded++;
+        packetLength += length;
+    }
+
+    ( *updatedLength ) = ( *updatedLength ) + packetLength;
+
+    return vectorsAdded;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t sendSubscribeWithoutCopy( MQTTContext_t * pContext,
+                                              const MQTTSubscribeInfo_t * pSubscriptionList,
+                                              size_t subscriptionCount,
+                                              uint16_t packetId,
+                                              size_t remainingLength,
+                                              uint32_t subscriptionId )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    uint8_t * pIndex;
+    TransportOutVector_t pIoVector[ MQTT_SUB_UNSUB_MAX_VECTORS ];
+    TransportOutVector_t * pIterator;
+    uint8_t serializedTopicFieldLength[ MQTT_SUB_UNSUB_MAX_VECTORS ][ CORE_MQTT_SERIALIZED_LENGTH_FIELD_BYTES ];
+    size_t totalPacketLength = 0U;
+    size_t ioVectorLength = 0U;
+    size_t subscriptionsSent = 0U;
+    size_t vectorsAdded;
+    size_t topicFieldLengthIndex;
+
+    /* Maximum number of bytes required by the 'fixed' part of the SUBSCRIBE
+     * packet header according to the MQTT specification.
+     * MQTT Control Byte      0 + 1 = 1
+     * Remaining length (max)   + 4 = 5
+     * Packet ID                + 2 = 7
+     * Property length (MQTT 5) + 1 = 8
+     * Subscription Identifier  + 5 = 13 */
+    uint8_t subscribeheader[ MQTT_SUBSCRIBE_HEADER_MAX_SIZE_V5 ];
+
+    /* The vector array should be at least three element long as the topic
+     * string needs these many vector elements to be stored. */
+    assert( MQTT_SUB_UNSUB_MAX_VECTORS >= CORE_MQTT_SUBSCRIBE_PER_TOPIC_VECTOR_LENGTH );
+
+    pIndex = subscribeheader;
+    pIterator = pIoVector;
+
+    if( pContext->protocolVersion == MQTT_VERSION_5 )
+    {
+        pIndex = MQTT_SerializeSubscribeHeaderV5( remainingLength,
+                                                  pIndex,
+                                                  packetId,
+                                                  subscriptionId );
+    }
+    else
+    {
+        pIndex = MQTT_SerializeSubscribeHeader( remainingLength,
+                                                pIndex,
+                                                packetId );
+    }
+
+    /* The header is to be sent first. */
+    pIterator->iov_base = subscribeheader;
+    /* More details at: https://github.com/FreeRTOS/coreMQTT/blob/main/MISRA.md#rule-182 */
+    /* More details at: https://github.com/FreeRTOS/coreMQTT/blob/main/MISRA.md#rule-108 */
+    /* coverity[misra_c_2012_rule_18_2_violation] */
+    /* coverity[misra_c_2012_rule_10_8_violation] */
+    pIterator->iov_len = ( size_t ) ( pIndex - subscribeheader );
+    totalPacketLength += pIterator->iov_len;
+    pIterator++;
+    ioVectorLength++;
+
+    while( ( status == MQTTSuccess ) && ( subscriptionsSent < subscriptionCount ) )
+    {
+        /* Reset the index for next iteration. */
+        topicFieldLengthIndex = 0;
+
+        /* Check whether the subscription topic (with QoS) will fit in the
+         * given vector. */
+        while( ( ioVectorLength <= ( MQTT_SUB_UNSUB_MAX_VECTORS - CORE_MQTT_SUBSCRIBE_PER_TOPIC_VECTOR_LENGTH ) ) &&
+               ( subscriptionsSent < subscriptionCount ) )
+        {
+            /* The topic filter and the filter length gets sent next. */
+            vectorsAdded = addEncodedStringToVector( serializedTopicFieldLength[ topicFieldLengthIndex ],
+                                                     pSubscriptionList[ subscriptionsSent ].pTopicFilter,
+                                                     pSubscriptionList[ subscriptionsSent ].topicFilterLength,
+                                                     pIterator,
+                                                     &totalPacketLength );
+
+            /* Update the pointer after the above operation. */
+            pIterator = &pIterator[ vectorsAdded ];
+
+            /* Lastly, the QoS gets sent. */
+            pIterator->iov_base = &( pSubscriptionList[ subscriptionsSent ].qos );
+            pIterator->iov_len = 1U;
+            totalPacketLength += pIterator->iov_len;
+
+            /* Increment the pointer. */
+            pIterator++;
+
+            /* Two slots get used by the topic string length and topic string.
+             * One slot gets used by the quality of service. */
+            ioVectorLength += vectorsAdded + 1U;
+
+            subscriptionsSent++;
+
+            /* The index needs to be updated for next iteration. */
+            topicFieldLengthIndex++;
+        }
+
+        if( sendMessageVector( pContext,
+                               pIoVector,
+                               ioVectorLength ) != ( int32_t ) totalPacketLength )
+        {
+            status = MQTTSendFailed;
+        }
+
+        /* Update the iterator for the next potential loop iteration. */
+        pIterator = pIoVector;
+        /* Reset the vector length for the next potential loop iteration. */
+        ioVectorLength = 0U;
+        /* Reset the packet length for the next potential loop iteration. */
+        totalPacketLength = 0U;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t sendUnsubscribeWithoutCopy( MQTTContext_t * pContext,
+                                                const MQTTSubscribeInfo_t * pSubscriptionList,
+                                                size_t subscriptionCount,
+                                                uint16_t packetId,
+                                                size_t remainingLength )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    uint8_t * pIndex;
+    TransportOutVector_t pIoVector[ MQTT_SUB_UNSUB_MAX_VECTORS ];
+    TransportOutVector_t * pIterator;
+    uint8_t serializedTopicFieldLength[ MQTT_SUB_UNSUB_MAX_VECTORS ][ CORE_MQTT_SERIALIZED_LENGTH_FIELD_BYTES ];
+    size_t totalPacketLength = 0U;
+    size_t unsubscriptionsSent = 0U;
+    size_t ioVectorLength = 0U;
+    size_t vectorsAdded;
+    size_t topicFieldLengthIndex;
+
+    /* Maximum number of bytes required by the 'fixed' part of the UNSUBSCRIBE
+     * packet header according to the MQTT specification.
+     * MQTT Control Byte      0 + 1 = 1
+     * Remaining length (max)   + 4 = 5
+     * Packet ID                + 2 = 7
+     * Property length (MQTT 5) + 1 = 8 */
+    uint8_t unsubscribeheader[ 8U ];
+
+    /* The vector array should be at least three element long as the topic
+     * string needs these many vector elements to be stored. */
+    assert( MQTT_SUB_UNSUB_MAX_VECTORS >= CORE_MQTT_UNSUBSCRIBE_PER_TOPIC_VECTOR_LENGTH );
+
+    pIndex = unsubscribeheader;
+    pIterator = pIoVector;
+
+    if( pContext->protocolVersion == MQTT_VERSION_5 )
+    {
+        pIndex = MQTT_SerializeUnsubscribeHeaderV5( remainingLength,
+                                                    pIndex,
+                                                    packetId );
+    }
+    else
+    {
+        pIndex = MQTT_SerializeUnsubscribeHeader( remainingLength,
+                                                  pIndex,
+                                                  packetId );
+    }
+
+    /* The header is to be sent first. */
+    pIterator->iov_base = unsubscribeheader;
+    /* More details at: https://github.com/FreeRTOS/coreMQTT/blob/main/MISRA.md#rule-182 */
+    /* More details at: https://github.com/FreeRTOS/coreMQTT/blob/main/MISRA.md#rule-108 */
+    /* coverity[misra_c_2012_rule_18_2_violation] */
+    /* coverity[misra_c_2012_rule_10_8_violation] */
+    pIterator->iov_len = ( size_t ) ( pIndex - unsubscribeheader );
+    totalPacketLength += pIterator->iov_len;
+    pIterator++;
+    ioVectorLength++;
+
+    while( ( status == MQTTSuccess ) && ( unsubscriptionsSent < subscriptionCount ) )
+    {
+        /* Reset the index for next iteration. */
+        topicFieldLengthIndex = 0;
+
+        /* Check whether the subscription topic will fit in the given vector. */
+        while( ( ioVectorLength <= ( MQTT_SUB_UNSUB_MAX_VECTORS - CORE_MQTT_UNSUBSCRIBE_PER_TOPIC_VECTOR_LENGTH ) ) &&
+               ( unsubscriptionsSent < subscriptionCount ) )
+        {
+            /* The topic filter gets sent next. */
+            vectorsAdded = addEncodedStringToVector( serializedTopicFieldLength[ topicFieldLengthIndex ],
+                                                     pSubscriptionList[ unsubscriptionsSent ].pTopicFilter,
+                                                     pSubscriptionList[ unsubscriptionsSent ].topicFilterLength,
+                                                     pIterator,
+                                                     &totalPacketLength );
+
+            /* Update the iterator to point to the next empty location. */
+            pIterator = &pIterator[ vectorsAdded ];
+            /* Update the total count based on how many vectors were added. */
+            ioVectorLength += vectorsAdded;
+
+            unsubscriptionsSent++;
+
+            /* Update the index for next iteration. */
+            topicFieldLengthIndex++;
+        }
+
+        if( sendMessageVector( pContext, pIoVector, ioVectorLength ) != ( int32_t ) totalPacketLength )
+        {
+            status = MQTTSendFailed;
+        }
+
+        /* Update the iterator for the next potential loop iteration. */
+        pIterator = pIoVector;
+        /* Reset the vector length for the next potential loop iteration. */
+        ioVectorLength = 0U;
+        /* Reset the packet length for the next potential loop iteration. */
+        totalPacketLength = 0U;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t getBulkPacketFilterCount( const MQTTSubscribeInfo_t * pSubscriptionList,
+                                        size_t subscriptionCount,
+                                        size_t payloadLimit,
+                                        bool isSubscribe )
+{
+    size_t filterCount = 0U;
+    size_t payloadSize = 0U;
+    size_t filterSize;
+    bool packetFull = false;
+
+    assert( pSubscriptionList != NULL );
+
+    while( ( packetFull == false ) && ( filterCount < subscriptionCount ) )
+    {
+        /* The topic filter is preceded by its length, and followed by the
+         * subscription options in a SUBSCRIBE. */
+        filterSize = CORE_MQTT_SERIALIZED_LENGTH_FIELD_BYTES +
+                     ( size_t ) pSubscriptionList[ filterCount ].topicFilterLength;
+
+        if( isSubscribe == true )
+        {
+            filterSize += 1U;
+        }
+
+        if( filterSize > ( payloadLimit - payloadSize ) )
+        {
+            packetFull = true;
+        }
+        else
+        {
+            payloadSize += filterSize;
+            filterCount++;
+        }
+    }
+
+    return filterCount;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t sendBulkPacket( MQTTContext_t * pContext,
+                                    const MQTTSubscribeInfo_t * pSubscriptionList,
+                                    size_t subscriptionCount,
+                                    const MQTTFixedBuffer_t * pStagingBuffer,
+                                    bool isSubscribe,
+                                    uint16_t * pPacketId )
+{
+    MQTTStatus_t status;
+    MQTTConnectionStatus_t connectStatus;
+    size_t remainingLength = 0UL, packetSize = 0UL, index;
+    uint16_t packetId;
+    uint16_t topicFilterLength;
+    uint8_t * pIndex;
+
+    assert( pStagingBuffer != NULL );
+    assert( pPacketId != NULL );
+
+    packetId = MQTT_GetPacketId( pContext );
+
+    if( isSubscribe == true )
+    {
+        if( pContext->protocolVersion == MQTT_VERSION_5 )
+        {
+            status = MQTT_GetSubscribePacketSizeV5( pSubscriptionList,
+                                                    subscriptionCount,
+                                                    0U,
+                                                    &remainingLength,
+                                                    &packetSize );
+        }
+        else
+        {
+            status = MQTT_GetSubscribePacketSize( pSubscriptionList,
+                                                  subscriptionCount,
+                                                  &remainingLength,
+                                                  &packetSize );
+        }
+    }
+    else
+    {
+        if( pContext->protocolVersion == MQTT_VERSION_5 )
+        {
+            status = MQTT_GetUnsubscribePacketSizeV5( pSubscriptionList,
+                                                      subscriptionCount,
+                                                      &remainingLength,
+                                                      &packetSize );
+        }
+        else
+        {
+            status = MQTT_GetUnsubscribePacketSize( pSubscriptionList,
+                                                    subscriptionCount,
+                                                    &remainingLength,
+                                                    &packetSize );
+        }
+    }
+
+    if( status == MQTTSuccess )
+    {
+        /* The filters were chosen to fit in the staging buffer. */
+        assert( packetSize <= pStagingBuffer->size );
+
+        pIndex = pStagingBuffer->pBuffer;
+
+        if( isSubscribe == true )
+        {
+            pIndex = ( pContext->protocolVersion == MQTT_VERSION_5 ) ?
+                     MQTT_SerializeSubscribeHeaderV5( remainingLength, pIndex, packetId, 0U ) :
+                     MQTT_SerializeSubscribeHeader( remainingLength, pIndex, packetId );
+        }
+        else
+        {
+            pIndex = ( pContext->protocolVersion == MQTT_VERSION_5 ) ?
+                     MQTT_SerializeUnsubscribeHeaderV5( remainingLength, pIndex, packetId ) :
+                     MQTT_SerializeUnsubscribeHeader( remainingLength, pIndex, packetId );
+        }
+
+        for( index = 0U; index < subscriptionCount; index++ )
+        {
+            topicFilterLength = pSubscriptionList[ index ].topicFilterLength;
+            pIndex[ 0 ] = ( uint8_t ) ( topicFilterLength >> 8 );
+            pIndex[ 1 ] = ( uint8_t ) ( topicFilterLength & 0x00ffU );
+            ( void ) memcpy( &pIndex[ CORE_MQTT_SERIALIZED_LENGTH_FIELD_BYTES ],
+                             pSubscriptionList[ index ].pTopicFilter,
+                             topicFilterLength );
+            pIndex = &pIndex[ CORE_MQTT_SERIALIZED_LENGTH_FIELD_BYTES + topicFilterLength ];
+
+            if( isSubscribe == true )
+            {
+                *pIndex = ( uint8_t ) pSubscriptionList[ index ].qos;
+                pIndex++;
+            }
+        }
+
+        MQTT_PRE_SEND_HOOK( pContext );
+
+        MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+        connectStatus = pContext->connectStatus;
+        MQTT_POST_STATE_UPDATE_HOOK( pContext );
+
+        if( connectStatus != MQTTConnected )
+        {
+            status = ( connectStatus == MQTTNotConnected ) ? MQTTStatusNotConnected : MQTTStatusDisconnectPending;
+        }
+        else
+        {
+            /* The registry is updated first, as the ack may be received by
+             * another thread as soon as the packet is sent. */
+            if( isSubscribe == true )
+            {
+                recordSubscriptions( pContext, pSubscriptionList, subscriptionCount, packetId, 0U );
+            }
+            else
+            {
+                removeSubscriptions( pContext, pSubscriptionList, subscriptionCount );
+            }
+
+            if( sendBuffer( pContext, pStagingBuffer->pBuffer, packetSize ) != ( int32_t ) packetSize )
+            {
+                LogError( ( "Failed to send bulk %s packet with %lu topic filters.",
+                            ( isSubscribe == true ) ? "SUBSCRIBE" : "UNSUBSCRIBE",
+                            ( unsigned long ) subscriptionCount ) );
+                status = MQTTSendFailed;
+
+                if( isSubscribe == true )
+                {
+                    completeSubscriptions( pContext, packetId, NULL, 0U );
+                }
+            }
+            else
+            {
+                *pPacketId = packetId;
+            }
+        }
+
+        MQTT_POST_SEND_HOOK( pContext );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t sendBulkSubscribeUnsubscribe( MQTTContext_t * pContext,
+                                                  const MQTTSubscribeInfo_t * pSubscriptionList,
+                                                  size_t subscriptionCount,
+                                                  const MQTTFixedBuffer_t * pStagingBuffer,
+                                                  uint16_t * pPacketIds,
+                                                  size_t * pPacketIdCount,
+                                                  bool isSubscribe )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    size_t payloadLimit = 0U, first, filterCount = 0U, packetCount = 0U;
+
+    if( ( pContext == NULL ) || ( pSubscriptionList == NULL ) ||
+        ( pStagingBuffer == NULL ) || ( pPacketIds == NULL ) || ( pPacketIdCount == NULL ) )
+    {
+        LogError( ( "Argument cannot be NULL: pContext=%p, pSubscriptionList=%p, "
+                    "pStagingBuffer=%p, pPacketIds=%p, pPacketIdCount=%p.",
+                    ( void * ) pContext,
+                    ( void * ) pSubscriptionList,
+                    ( void * ) pStagingBuffer,
+                    ( void * ) pPacketIds,
+                    ( void * ) pPacketIdCount ) );
+        status = MQTTBadParameter;
+    }
+    else if( subscriptionCount == 0UL )
+    {
+        LogError( ( "Subscription count is 0." ) );
+        status = MQTTBadParameter;
+    }
+    else if( ( pStagingBuffer->pBuffer == NULL ) ||
+             ( pStagingBuffer->size <= CORE_MQTT_BULK_HEADER_MAX_SIZE ) )
+    {
+        LogError( ( "Staging buffer must hold more than %lu bytes: pBuffer=%p, size=%lu.",
+                    ( unsigned long ) CORE_MQTT_BULK_HEADER_MAX_SIZE,
+                    ( void * ) pStagingBuffer->pBuffer,
+                    ( unsigned long ) pStagingBuffer->size ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        /* The packet IDs are only taken when the packets are sent, so any
+         * valid one does for validating the topic filters. */
+        status = validateSubscribeUnsubscribeParams( pContext,
+                                                     pSubscriptionList,
+                                                     subscriptionCount,
+                                                     1U );
+        payloadLimit = pStagingBuffer->size - CORE_MQTT_BULK_HEADER_MAX_SIZE;
+
+        for( first = 0U; ( status == MQTTSuccess ) && ( first < subscriptionCount ); first++ )
+        {
+            if( ( pSubscriptionList[ first ].pTopicFilter == NULL ) ||
+                ( pSubscriptionList[ first ].topicFilterLength == 0U ) )
+            {
+                LogError( ( "Topic filter %lu cannot be empty.",
+                            ( unsigned long ) first ) );
+                status = MQTTBadParameter;
+            }
+        }
+
+        /* Count the packets first, so that nothing is sent unless every topic
+         * filter and packet ID fits. */
+        for( first = 0U; ( status == MQTTSuccess ) && ( first < subscriptionCount ); first += filterCount )
+        {
+            filterCount = getBulkPacketFilterCount( &pSubscriptionList[ first ],
+                                                    subscriptionCount - first,
+                                                    payloadLimit,
+                                                    isSubscribe );
+
+            if( filterCount == 0U )
+            {
+                LogError( ( "Topic filter %lu does not fit in a staging buffer of %lu bytes.",
+                            ( unsigned long ) first,
+                            ( unsigned long ) pStagingBuffer->size ) );
+                status = MQTTNoMemory;
+            }
+
+            packetCount++;
+        }
+
+        if( ( status == MQTTSuccess ) && ( packetCount > *pPacketIdCount ) )
+        {
+            LogError( ( "%lu packets are needed but only %lu packet IDs can be returned.",
+                        ( unsigned long ) packetCount,
+                        ( unsigned long ) *pPacketIdCount ) );
+            status = MQTTNoMemory;
+        }
+
+        packetCount = 0U;
+    }
+
+    /* The packets are sent back to back without waiting for their acks. */
+    for( first = 0U; ( status == MQTTSuccess ) && ( first < subscriptionCount ); first += filterCount )
+    {
+        filterCount = getBulkPacketFilterCount( &pSubscriptionList[ first ],
+                                                subscriptionCount - first,
+                                                payloadLimit,
+                                                isSubscribe );
+
+        status = sendBulkPacket( pContext,
+                                 &pSubscriptionList[ first ],
+                                 filterCount,
+                                 pStagingBuffer,
+                                 isSubscribe,
+                                 &pPacketIds[ packetCount ] );
+
+        if( status == MQTTSuccess )
+        {
+            packetCount++;
+        }
+    }
+
+    if( pPacketIdCount != NULL )
+    {
+        *pPacketIdCount = packetCount;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTSubscriptionRecord_t * findSubscriptionRecord( const MQTTContext_t * pContext,
+                                                          const char * pTopicFilter,
+                                                          uint16_t topicFilterLength,
+                                                          uint32_t filterHash,
+                                                          MQTTSubscriptionRecord_t ** ppFreeRecord )
+{
+    MQTTSubscriptionRecord_t * pRecord;
+    MQTTSubscriptionRecord_t * pFoundRecord = NULL;
+    MQTTSubscriptionRecord_t * pFreeRecord = NULL;
+    size_t index;
+
+    assert( pContext != NULL );
+    assert( pContext->pSubscriptionRecords != NULL );
+    assert( pTopicFilter != NULL );
+
+    for( index = 0U; index < pContext->subscriptionRecordMaxCount; index++ )
+    {
+        pRecord = &pContext->pSubscriptionRecords[ index ];
+
+        if( pRecord->topicFilterLength == 0U )
+        {
+            if( pFreeRecord == NULL )
+            {
+                pFreeRecord = pRecord;
+            }
+        }
+        else if( ( pRecord->filterHash == filterHash ) &&
+                 ( pRecord->topicFilterLength == topicFilterLength ) &&
+                 ( memcmp( pRecord->topicFilter, pTopicFilter, topicFilterLength ) == 0 ) )
+        {
+            pFoundRecord = pRecord;
+            break;
+        }
+        else
+        {
+            /* Empty else MISRA 15.7 */
+        }
+    }
+
+    if( ppFreeRecord != NULL )
+    {
+        *ppFreeRecord = pFreeRecord;
+    }
+
+    return pFoundRecord;
+}
+
+/*-----------------------------------------------------------*/
+
+static void recordSubscriptions( MQTTContext_t * pContext,
+                                 const MQTTSubscribeInfo_t * pSubscriptionList,
+                                 size_t subscriptionCount,
+                                 uint16_t packetId,
+                                 uint32_t subscriptionId )
+{
+    MQTTSubscriptionRecord_t * pRecord;
+    MQTTSubscriptionRecord_t * pFreeRecord = NULL;
+    uint16_t topicFilterLength;
+    uint32_t filterHash;
+    size_t index;
+
+    assert( pContext != NULL );
+    assert( pSubscriptionList != NULL );
+
+    if( pContext->pSubscriptionRecords != NULL )
+    {
+        MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+
+        for( index = 0U; index < subscriptionCount; index++ )
+        {
+            topicFilterLength = pSubscriptionList[ index ].topicFilterLength;
+
+            if( topicFilterLength > MQTT_SUBSCRIPTION_REGISTRY_MAX_FILTER_LENGTH )
+            {
+                LogWarn( ( "Topic filter %.*s is too long for the subscription registry.",
+                           ( int ) topicFilterLength,
+                           pSubscriptionList[ index ].pTopicFilter ) );
+            }
+            else
+            {
+                filterHash = hashTopic( pSubscriptionList[ index ].pTopicFilter, topicFilterLength );
+                pRecord = findSubscriptionRecord( pContext,
+                                                  pSubscriptionList[ index ].pTopicFilter,
+                                                  topicFilterLength,
+                                                  filterHash,
+                                                  &pFreeRecord );
+
+                if( ( pRecord == NULL ) && ( pFreeRecord != NULL ) )
+                {
+                    pRecord = pFreeRecord;
+                    ( void ) memcpy( pRecord->topicFilter,
+                                     pSubscriptionList[ index ].pTopicFilter,
+                                     topicFilterLength );
+                    pRecord->topicFilterLength = topicFilterLength;
+                    pRecord->filterHash = filterHash;
+                    pRecord->active = false;
+                }
+
+                /* The subscription keeps its QoS and Subscription Identifier
+                 * until the SUBACK grants the new ones. */
+                if( pRecord != NULL )
+                {
+                    pRecord->pendingQos = pSubscriptionList[ index ].qos;
+                    pRecord->pendingSubscriptionId = subscriptionId;
+                    pRecord->packetId = packetId;
+                    pRecord->subAckIndex = index;
+                }
+                else
+                {
+                    LogWarn( ( "Subscription registry is full. Topic filter %.*s is not recorded.",
+                               ( int ) topicFilterLength,
+                               pSubscriptionList[ index ].pTopicFilter ) );
+                }
+            }
+        }
+
+        MQTT_POST_STATE_UPDATE_HOOK( pContext );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void removeSubscriptions( MQTTContext_t * pContext,
+                                 const MQTTSubscribeInfo_t * pSubscriptionList,
+                                 size_t subscriptionCount )
+{
+    MQTTSubscriptionRecord_t * pRecord;
+    uint16_t topicFilterLength;
+    size_t index;
+
+    assert( pContext != NULL );
+    assert( pSubscriptionList != NULL );
+
+    if( pContext->pSubscriptionRecords != NULL )
+    {
+        MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+
+        for( index = 0U; index < subscriptionCount; index++ )
+        {
+            topicFilterLength = pSubscriptionList[ index ].topicFilterLength;
+            pRecord = findSubscriptionRecord( pContext,
+                                              pSubscriptionList[ index ].pTopicFilter,
+                                              topicFilterLength,
+                                              hashTopic( pSubscriptionList[ index ].pTopicFilter, topicFilterLength ),
+                                              NULL );
+
+            if( pRecord != NULL )
+            {
+                ( void ) memset( pRecord, 0x00, sizeof( MQTTSubscriptionRecord_t ) );
+            }
+        }
+
+        MQTT_POST_STATE_UPDATE_HOOK( pContext );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void completeSubscriptions( MQTTContext_t * pContext,
+                                   uint16_t packetId,
+                                   const uint8_t * pSubAckCodes,
+                                   size_t subAckCodeCount )
+{
+    MQTTSubscriptionRecord_t * pRecord;
+    size_t index;
+
+    assert( pContext != NULL );
+
+    if( pContext->pSubscriptionRecords != NULL )
+    {
+        MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+
+        for( index = 0U; index < pContext->subscriptionRecordMaxCount; index++ )
+        {
+            pRecord = &pContext->pSubscriptionRecords[ index ];
+
+            if( ( pRecord->topicFilterLength == 0U ) || ( pRecord->packetId != packetId ) )
+            {
+                /* Not awaiting this SUBACK. */
+            }
+            else if( ( pRecord->subAckIndex < subAckCodeCount ) &&
+                     ( pSubAckCodes[ pRecord->subAckIndex ] < ( uint8_t ) MQTTSubAckFailure ) )
+            {
+                pRecord->qos = pRecord->pendingQos;
+                pRecord->subscriptionId = pRecord->pendingSubscriptionId;
+                pRecord->active = true;
+                pRecord->packetId = MQTT_PACKET_ID_INVALID;
+            }
+            else if( pRecord->active == false )
+            {
+                LogWarn( ( "Subscription to %.*s was not granted. Removing it from the registry.",
+                           ( int ) pRecord->topicFilterLength,
+                           pRecord->topicFilter ) );
+                ( void ) memset( pRecord, 0x00, sizeof( MQTTSubscriptionRecord_t ) );
+            }
+            else
+            {
+                /* A refused SUBSCRIBE leaves an existing subscription as it was. */
+                pRecord->packetId = MQTT_PACKET_ID_INVALID;
+            }
+        }
+
+        MQTT_POST_STATE_UPDATE_HOOK( pContext );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void handleRegistrySubAck( MQTTContext_t * pContext,
+                                  const MQTTPacketInfo_t * pIncomingPacket,
+                                  uint16_t packetId )
+{
+    uint8_t * pSubAckCodes = NULL;
+    size_t subAckCodeCount = 0U;
+    MQTTStatus_t status;
+
+    assert( pContext != NULL );
+    assert( pIncomingPacket != NULL );
+
+    if( pContext->pSubscriptionRecords != NULL )
+    {
+        if( pContext->protocolVersion == MQTT_VERSION_5 )
+        {
+            status = MQTT_GetSubAckReasonCodesV5( pIncomingPacket, &pSubAckCodes, &subAckCodeCount );
+        }
+        else
+        {
+            status = MQTT_GetSubAckStatusCodes( pIncomingPacket, &pSubAckCodes, &subAckCodeCount );
+        }
+
+        if( status != MQTTSuccess )
+        {
+            subAckCodeCount = 0U;
+        }
+
+        completeSubscriptions( pContext, packetId, pSubAckCodes, subAckCodeCount );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t sendRegistrySubscribes( MQTTContext_t * pContext,
+                                            size_t firstIndex,
+                                            uint32_t subscriptionId,
+                                            size_t * pFilterCount,
+                                            size_t * pPacketCount )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTSubscriptionRecord_t * pRecord;
+    uint8_t header[ MQTT_SUBSCRIBE_HEADER_MAX_SIZE_V5 ];
+    uint8_t * pBuffer;
+    uint8_t * pIndex;
+    size_t index, filterSize, payloadSize, headerSize, subAckIndex;
+    size_t headerRoom = CORE_MQTT_BULK_HEADER_MAX_SIZE;
+    size_t propertySize = 1U;
+    uint32_t remainingId;
+    uint16_t packetId;
+    bool packetFull;
+
+    assert( pContext != NULL );
+    assert( pFilterCount != NULL );
+    assert( pPacketCount != NULL );
+
+    /* The Subscription Identifier property is its identifier byte and a
+     * variable byte integer, after the property length. */
+    if( subscriptionId != 0U )
+    {
+        headerRoom = MQTT_SUBSCRIBE_HEADER_MAX_SIZE_V5;
+        propertySize += 2U;
+
+        for( remainingId = subscriptionId >> 7; remainingId > 0U; remainingId >>= 7 )
+        {
+            propertySize++;
+        }
+    }
+
+    pBuffer = pContext->subscriptionStagingBuffer.pBuffer;
+    index = firstIndex;
+
+    while( ( status == MQTTSuccess ) && ( index < pContext->subscriptionRecordMaxCount ) )
+    {
+        packetId = MQTT_GetPacketId( pContext );
+
+        /* The payload is serialized after room for the largest header, and
+         * the header is copied in front of it once its length is known. */
+        pIndex = &pBuffer[ headerRoom ];
+        payloadSize = 0U;
+        subAckIndex = 0U;
+        packetFull = false;
+
+        MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+
+        while( ( packetFull == false ) && ( index < pContext->subscriptionRecordMaxCount ) )
+        {
+            pRecord = &pContext->pSubscriptionRecords[ index ];
+            filterSize = CORE_MQTT_SERIALIZED_LENGTH_FIELD_BYTES + ( size_t ) pRecord->topicFilterLength + 1U;
+
+            if( ( pRecord->topicFilterLength == 0U ) || ( pRecord->subscriptionId != subscriptionId ) )
+            {
+                index++;
+            }
+            else if( filterSize > ( pContext->subscriptionStagingBuffer.size - headerRoom - payloadSize ) )
+            {
+                packetFull = true;
+            }
+            else
+            {
+                pIndex[ 0 ] = ( uint8_t ) ( pRecord->topicFilterLength >> 8 );
+                pIndex[ 1 ] = ( uint8_t ) ( pRecord->topicFilterLength & 0x00ffU );
+                ( void ) memcpy( &pIndex[ CORE_MQTT_SERIALIZED_LENGTH_FIELD_BYTES ],
+                                 pRecord->topicFilter,
+                                 pRecord->topicFilterLength );
+                pIndex[ filterSize - 1U ] = ( uint8_t ) pRecord->qos;
+                pIndex = &pIndex[ filterSize ];
+
+                pRecord->pendingQos = pRecord->qos;
+                pRecord->pendingSubscriptionId = pRecord->subscriptionId;
+                pRecord->packetId = packetId;
+                pRecord->subAckIndex = subAckIndex;
+                payloadSize += filterSize;
+                subAckIndex++;
+                index++;
+            }
+        }
+
+        MQTT_POST_STATE_UPDATE_HOOK( pContext );
+
+        if( payloadSize > 0U )
+        {
+            /* The remaining length covers the packet ID, the properties of
+             * MQTT 5 and the payload. */
+            if( pContext->protocolVersion == MQTT_VERSION_5 )
+            {
+                pIndex = MQTT_SerializeSubscribeHeaderV5( sizeof( uint16_t ) + propertySize + payloadSize,
+                                                          header,
+                                                          packetId,
+                                                          subscriptionId );
+            }
+            else
+            {
+                pIndex = MQTT_SerializeSubscribeHeader( sizeof( uint16_t ) + payloadSize, header, packetId );
+            }
+
+            headerSize = ( size_t ) ( pIndex - header );
+            pIndex = &pBuffer[ headerRoom - headerSize ];
+            ( void ) memcpy( pIndex, header, headerSize );
+
+            MQTT_PRE_SEND_HOOK( pContext );
+
+            if( sendBuffer( pContext, pIndex, headerSize + payloadSize ) != ( int32_t ) ( headerSize + payloadSize ) )
+            {
+                LogError( ( "Failed to send SUBSCRIBE of the subscription registry." ) );
+                status = MQTTSendFailed;
+            }
+
+            MQTT_POST_SEND_HOOK( pContext );
+
+            *pFilterCount += subAckIndex;
+            ( *pPacketCount )++;
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t resubscribeFromRegistry( MQTTContext_t * pContext )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTSubscriptionRecord_t * pRecord;
+    size_t index, earlier;
+    size_t filterCount = 0U, packetCount = 0U;
+    uint32_t subscriptionId;
+    bool firstWithId;
+
+    assert( pContext != NULL );
+
+    if( pContext->pSubscriptionRecords != NULL )
+    {
+        MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+
+        /* Subscriptions whose SUBACK was not received before the session ended
+         * are forgotten, as the broker may not have granted them. */
+        for( index = 0U; index < pContext->subscriptionRecordMaxCount; index++ )
+        {
+            pRecord = &pContext->pSubscriptionRecords[ index ];
+
+            if( pRecord->active == false )
+            {
+                ( void ) memset( pRecord, 0x00, sizeof( MQTTSubscriptionRecord_t ) );
+            }
+            else
+            {
+                pRecord->packetId = MQTT_PACKET_ID_INVALID;
+            }
+        }
+
+        MQTT_POST_STATE_UPDATE_HOOK( pContext );
+
+        /* The Subscription Identifier belongs to a whole SUBSCRIBE, so the
+         * topic filters are sent in groups of the same identifier, each from
+         * the first record with it. */
+        for( index = 0U; ( status == MQTTSuccess ) && ( index < pContext->subscriptionRecordMaxCount ); index++ )
+        {
+            MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+
+            pRecord = &pContext->pSubscriptionRecords[ index ];
+            subscriptionId = pRecord->subscriptionId;
+            firstWithId = ( pRecord->topicFilterLength != 0U );
+
+            for( earlier = 0U; ( firstWithId == true ) && ( earlier < index ); earlier++ )
+            {
+                firstWithId = ( pContext->pSubscriptionRecords[ earlier ].topicFilterLength == 0U ) ||
+                              ( pContext->pSubscriptionRecords[ earlier ].subscriptionId != subscriptionId );
+            }
+
+            MQTT_POST_STATE_UPDATE_HOOK( pContext );
+
+            if( firstWithId == true )
+            {
+                status = sendRegistrySubscribes( pContext, index, subscriptionId, &filterCount, &packetCount );
+            }
+        }
+
+        LogInfo( ( "Subscribed again to %lu topic filters with %lu SUBSCRIBE packets.",
+                   ( unsigned long ) filterCount,
+                   ( unsigned long ) packetCount ) );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t reserveCompletionToken( MQTTContext_t * pContext,
+                                            uint16_t packetId,
+                                            uint8_t ackType,
+                                            MQTTCompletionCallback_t callback,
+                                            void * pUserData )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTCompletionToken_t * pToken;
+    MQTTCompletionToken_t * pFreeToken = NULL;
+    size_t index;
+
+    assert( pContext != NULL );
+    assert( callback != NULL );
+
+    if( pContext->pCompletionTokens == NULL )
+    {
+        LogError( ( "Completion tokens must be initialized with MQTT_InitCompletionTokens." ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+
+        for( index = 0U; index < pContext->completionTokenMaxCount; index++ )
+        {
+            pToken = &pContext->pCompletionTokens[ index ];
+
+            if( pToken->callback == NULL )
+            {
+                if( pFreeToken == NULL )
+                {
+                    pFreeToken = pToken;
+                }
+            }
+            else if( ( pToken->packetId == packetId ) && ( pToken->ackType == ackType ) )
+            {
+                LogError( ( "An operation with packet ID %hu is already awaiting its acknowledgement.",
+                            ( unsigned short ) packetId ) );
+                status = MQTTStateCollision;
+                break;
+            }
+            else
+            {
+                /* Empty else MISRA 15.7 */
+            }
+        }
+
+        if( ( status == MQTTSuccess ) && ( pFreeToken == NULL ) )
+        {
+            LogError( ( "No completion token is free for packet ID %hu.",
+                        ( unsigned short ) packetId ) );
+            status = MQTTNoMemory;
+        }
+        else if( status == MQTTSuccess )
+        {
+            pFreeToken->callback = callback;
+            pFreeToken->pUserData = pUserData;
+            pFreeToken->packetId = packetId;
+            pFreeToken->ackType = ackType;
+        }
+        else
+        {
+            /* Empty else MISRA 15.7 */
+        }
+
+        MQTT_POST_STATE_UPDATE_HOOK( pContext );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool releaseCompletionToken( MQTTContext_t * pContext,
+                                    uint16_t packetId,
+                                    uint8_t ackType,
+                                    MQTTCompletionToken_t * pToken )
+{
+    bool found = false;
+    size_t index;
+
+    assert( pContext != NULL );
+    assert( pToken != NULL );
+
+    if( pContext->pCompletionTokens != NULL )
+    {
+        MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+
+        for( index = 0U; index < pContext->completionTokenMaxCount; index++ )
+        {
+            if( ( pContext->pCompletionTokens[ index ].callback != NULL ) &&
+                ( pContext->pCompletionTokens[ index ].packetId == packetId ) &&
+                ( pContext->pCompletionTokens[ index ].ackType == ackType ) )
+            {
+                *pToken = pContext->pCompletionTokens[ index ];
+                pContext->pCompletionTokens[ index ].callback = NULL;
+                found = true;
+                break;
+            }
+        }
+
+        MQTT_POST_STATE_UPDATE_HOOK( pContext );
+    }
+
+    return found;
+}
+
+/*-----------------------------------------------------------*/
+
+static void completeOperation( MQTTContext_t * pContext,
+                               MQTTPacketInfo_t * pAckPacket,
+                               uint16_t packetId,
+                               uint8_t ackType,
+                               MQTTStatus_t status )
+{
+    MQTTCompletionToken_t token;
+
+    assert( pContext != NULL );
+    assert( pAckPacket != NULL );
+
+    /* The token is freed before the callback is invoked, which may then
+     * start another operation. */
+    if( releaseCompletionToken( pContext, packetId, ackType, &token ) == true )
+    {
+        token.callback( pContext, packetId, status, pAckPacket, token.pUserData );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void abandonOperations( MQTTContext_t * pContext,
+                               bool sessionPresent )
+{
+    MQTTCompletionToken_t token;
+    MQTTCompletionToken_t * pToken;
+    size_t index;
+    bool abandoned;
+
+    assert( pContext != NULL );
+
+    for( index = 0U; index < pContext->completionTokenMaxCount; index++ )
+    {
+        pToken = &pContext->pCompletionTokens[ index ];
+        abandoned = false;
+
+        MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+
+        /* SUBSCRIBE packets are not sent again on a new connection, while
+         * publishes are when the session is kept. */
+        if( ( pToken->callback != NULL ) &&
+            ( ( sessionPresent == false ) || ( pToken->ackType == MQTT_PACKET_TYPE_SUBACK ) ) )
+        {
+            token = *pToken;
+            pToken->callback = NULL;
+            abandoned = true;
+        }
+
+        MQTT_POST_STATE_UPDATE_HOOK( pContext );
+
+        if( abandoned == true )
+        {
+            LogWarn( ( "Operation with packet ID %hu was abandoned by the new connection.",
+                       ( unsigned short ) token.packetId ) );
+            token.callback( pContext, token.packetId, MQTTStatusNotConnected, NULL, token.pUserData );
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t sendPublishWithoutCopy( MQTTContext_t * pContext,
+                                            const MQTTPublishInfo_t * pPublishInfo,
+                                            uint8_t * pMqttHeader,
+                                            size_t headerSize,
+                                            uint16_t packetId,
+                                            uint8_t * pProperties,
+                                            size_t propertiesSize )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    size_t ioVectorLength;
+    size_t totalMessageLength;
+
+    #if ( MQTT_QOS0_ONLY == 0 )
+        bool dupFlagChanged = false;
+    #endif
+
+    /* Bytes required to encode the packet ID in an MQTT header according to
+     * the MQTT specification. */
+    uint8_t serializedPacketID[ 2U ];
+
+    /* Maximum number of vectors required to encode and send a publish
+     * packet. The breakdown is shown below.
+     * Fixed header (including topic string length)      0 + 1 = 1
+     * Topic string (empty with an MQTT 5 topic alias)     + 1 = 2
+     * Packet ID (only when QoS > QoS0)                    + 1 = 3
+     * Properties (only for MQTT 5)                        + 1 = 4
+     * Payload                                             + 1 = 5  */
+    TransportOutVector_t pIoVector[ 5U ];
+
+    /* The header is sent first. */
+    pIoVector[ 0U ].iov_base = pMqttHeader;
+    pIoVector[ 0U ].iov_len = headerSize;
+    totalMessageLength = headerSize;
+    ioVectorLength = 1U;
+
+    /* Then the topic name has to be sent. */
+    if( pPublishInfo->topicNameLength > 0U )
+    {
+        pIoVector[ ioVectorLength ].iov_base = pPublishInfo->pTopicName;
+        pIoVector[ ioVectorLength ].iov_len = pPublishInfo->topicNameLength;
+
+        ioVectorLength++;
+        totalMessageLength += pPublishInfo->topicNameLength;
+    }
+
+    if( pPublishInfo->qos > MQTTQoS0 )
+    {
+        /* Encode the packet ID. */
+        serializedPacketID[ 0 ] = ( ( uint8_t ) ( ( packetId ) >> 8 ) );
+        serializedPacketID[ 1 ] = ( ( uint8_t ) ( ( packetId ) & 0x00ffU ) );
+
+        pIoVector[ ioVectorLength ].iov_base = serializedPacketID;
+        pIoVector[ ioVectorLength ].iov_len = sizeof( serializedPacketID );
+
+        ioVectorLength++;
+        totalMessageLength += sizeof( serializedPacketID );
+    }
+
+    if( pProperties != NULL )
+    {
+        pIoVector[ ioVectorLength ].iov_base = pProperties;
+        pIoVector[ ioVectorLength ].iov_len = propertiesSize;
+
+        ioVectorLength++;
+        totalMessageLength += propertiesSize;
+    }
+
+    /* Publish packets are allowed to contain no payload. */
+    if( pPublishInfo->payloadLength > 0U )
+    {
+        pIoVector[ ioVectorLength ].iov_base = pPublishInfo->pPayload;
+        pIoVector[ ioVectorLength ].iov_len = pPublishInfo->payloadLength;
+
+        ioVectorLength++;
+        totalMessageLength += pPublishInfo->payloadLength;
+    }
+
+    #if ( MQTT_QOS0_ONLY == 0 )
+        /* store a copy of the publish for retransmission purposes */
+        if( ( pPublishInfo->qos > MQTTQoS0 ) &&
+            ( pContext->storeFunction != NULL ) )
+        {
+            /* If not already set, set the dup flag before storing a copy of the publish
+             * this is because on retrieving back this copy we will get it in the form of an
+             * array of TransportOutVector_t that holds the data in a const pointer which cannot be
+             * changed after retrieving. */
+            if( pPublishInfo->dup != true )
+            {
+                status = MQTT_UpdateDuplicatePublishFlag( pMqttHeader, true );
+
+                dupFlagChanged = ( status == MQTTSuccess );
+            }
+
+            if( status == MQTTSuccess )
+            {
+                MQTTVec_t mqttVec;
+
+                mqttVec.pVector = pIoVector;
+                mqttVec.vectorLen = ioVectorLength;
+
+                if( pContext->storeFunction( pContext, packetId, &mqttVec ) != true )
+                {
+                    status = MQTTPublishStoreFailed;
+                }
+            }
+
+            /* change the value of the dup flag to its original, if it was changed */
+            if( ( status == MQTTSuccess ) && ( dupFlagChanged == true ) )
+            {
+                status = MQTT_UpdateDuplicatePublishFlag( pMqttHeader, false );
+            }
+        }
+    #endif
+
+    if( ( status == MQTTSuccess ) &&
+        ( sendMessageVector( pContext, pIoVector, ioVectorLength ) != ( int32_t ) totalMessageLength ) )
+    {
+        status = MQTTSendFailed;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t sendPublishV5( MQTTContext_t * pContext,
+                                   const MQTTPublishInfo_t * pPublishInfo,
+                                   uint16_t packetId )
+{
+    MQTTStatus_t status;
+    MQTTPublishInfo_t publishInfo;
+    size_t remainingLength = 0UL, packetSize = 0UL, headerSize = 0UL;
+    uint16_t topicAlias = 0U;
+    bool useTopicAlias, aliasAssigned = false;
+    uint8_t * pPropertiesEnd;
+
+    /* Fixed part of the PUBLISH header, as in #MQTT_Publish. */
+    uint8_t mqttHeader[ 7U ];
+    uint8_t properties[ MQTT_PUBLISH_PROPERTIES_MAX_SIZE_V5 ];
+
+    assert( pContext != NULL );
+    assert( pPublishInfo != NULL );
+
+    publishInfo = *pPublishInfo;
+    useTopicAlias = ( pContext->topicAliasCount > 0U );
+
+    #if ( MQTT_QOS0_ONLY == 0 )
+        /* A stored copy may be resent on a connection where the alias is not
+         * known, so it must carry the topic name. */
+        if( ( pPublishInfo->qos > MQTTQoS0 ) && ( pContext->storeFunction != NULL ) )
+        {
+            useTopicAlias = false;
+        }
+    #endif
+
+    if( useTopicAlias == true )
+    {
+        topicAlias = getTopicAlias( pContext,
+                                    pPublishInfo->pTopicName,
+                                    pPublishInfo->topicNameLength,
+                                    &aliasAssigned );
+
+        /* The broker already knows the topic of an alias it has been sent. */
+        if( ( topicAlias != 0U ) && ( aliasAssigned == false ) )
+        {
+            publishInfo.pTopicName = NULL;
+            publishInfo.topicNameLength = 0U;
+        }
+    }
+
+    status = MQTT_GetPublishPacketSizeV5( &publishInfo,
+                                          topicAlias,
+                                          &remainingLength,
+                                          &packetSize );
+
+    if( status == MQTTSuccess )
+    {
+        status = MQTT_SerializePublishHeaderWithoutTopic( &publishInfo,
+                                                          remainingLength,
+                                                          mqttHeader,
+                                                          &headerSize );
+    }
+
+    if( status == MQTTSuccess )
+    {
+        pPropertiesEnd = MQTT_SerializePublishPropertiesV5( topicAlias, properties );
+
+        status = sendPublishWithoutCopy( pContext,
+                                         &publishInfo,
+                                         mqttHeader,
+                                         headerSize,
+                                         packetId,
+                                         properties,
+                                         ( size_t ) ( pPropertiesEnd - properties ) );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t sendConnectWithoutCopy( MQTTContext_t * pContext,
+                                            const MQTTConnectInfo_t * pConnectInfo,
+                                            const MQTTPublishInfo_t * pWillInfo,
+                                            size_t remainingLength )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    TransportOutVector_t * iterator;
     size_t ioVectorLength = 0U;
     size_t totalMessageLength = 0U;
     int32_t bytesSentOrError;
@@ -2283,127 +5732,715 @@ static MQTTStatus_t sendConnectWithoutCopy( MQTTContext_t * pContext,
     uint8_t serializedPasswordLength[ 2 ];
     size_t vectorsAdded;
 
-    /* Maximum number of bytes required by the 'fixed' part of the CONNECT
-     * packet header according to the MQTT specification.
-     * MQTT Control Byte      0 + 1 = 1
-     * Remaining length (max)   + 4 = 5
-     * Protocol Name Length     + 2 = 7
-     * Protocol Name (MQTT)     + 4 = 11
-     * Protocol level           + 1 = 12
-     * Connect flags            + 1 = 13
-     * Keep alive               + 2 = 15 */
-    uint8_t connectPacketHeader[ 15U ];
+    /* Empty property length of the will message of MQTT 5. */
+    uint8_t willProperties = 0U;
+
+    /* Maximum number of bytes required by the 'fixed' part of the CONNECT
+     * packet header according to the MQTT specification.
+     * MQTT Control Byte      0 + 1 = 1
+     * Remaining length (max)   + 4 = 5
+     * Protocol Name Length     + 2 = 7
+     * Protocol Name (MQTT)     + 4 = 11
+     * Protocol level           + 1 = 12
+     * Connect flags            + 1 = 13
+     * Keep alive               + 2 = 15
+     * Property length (MQTT 5) + 1 = 16 */
+    uint8_t connectPacketHeader[ 16U ];
+
+    /* The maximum vectors required to encode and send a connect packet. The
+     * breakdown is shown below.
+     * Fixed header           0 + 1 = 1
+     * Client ID                + 2 = 3
+     * Will properties (MQTT 5) + 1 = 4
+     * Will topic               + 2 = 6
+     * Will payload             + 2 = 8
+     * Username                 + 2 = 10
+     * Password                 + 2 = 12 */
+    TransportOutVector_t pIoVector[ 12U ];
+
+    iterator = pIoVector;
+    pIndex = connectPacketHeader;
+
+    /* Validate arguments. */
+    if( ( pWillInfo != NULL ) && ( pWillInfo->pTopicName == NULL ) )
+    {
+        LogError( ( "pWillInfo->pTopicName cannot be NULL if Will is present." ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        if( pContext->protocolVersion == MQTT_VERSION_5 )
+        {
+            pIndex = MQTT_SerializeConnectFixedHeaderV5( pIndex,
+                                                         pConnectInfo,
+                                                         pWillInfo,
+                                                         remainingLength );
+        }
+        else
+        {
+            pIndex = MQTT_SerializeConnectFixedHeader( pIndex,
+                                                       pConnectInfo,
+                                                       pWillInfo,
+                                                       remainingLength );
+        }
+
+        assert( ( ( size_t ) ( pIndex - connectPacketHeader ) ) <= sizeof( connectPacketHeader ) );
+
+        /* The header gets sent first. */
+        iterator->iov_base = connectPacketHeader;
+        /* More details at: https://github.com/FreeRTOS/coreMQTT/blob/main/MISRA.md#rule-182 */
+        /* More details at: https://github.com/FreeRTOS/coreMQTT/blob/main/MISRA.md#rule-108 */
+        /* coverity[misra_c_2012_rule_18_2_violation] */
+        /* coverity[misra_c_2012_rule_10_8_violation] */
+        iterator->iov_len = ( size_t ) ( pIndex - connectPacketHeader );
+        totalMessageLength += iterator->iov_len;
+        iterator++;
+        ioVectorLength++;
+
+        /* Serialize the client ID. */
+        vectorsAdded = addEncodedStringToVector( serializedClientIDLength,
+                                                 pConnectInfo->pClientIdentifier,
+                                                 pConnectInfo->clientIdentifierLength,
+                                                 iterator,
+                                                 &totalMessageLength );
+
+        /* Update the iterator to point to the next empty slot. */
+        iterator = &iterator[ vectorsAdded ];
+        ioVectorLength += vectorsAdded;
+
+        if( pWillInfo != NULL )
+        {
+            if( pContext->protocolVersion == MQTT_VERSION_5 )
+            {
+                /* The will message is sent without properties. */
+                iterator->iov_base = &willProperties;
+                iterator->iov_len = sizeof( willProperties );
+                totalMessageLength += iterator->iov_len;
+                iterator++;
+                ioVectorLength++;
+            }
+
+            /* Serialize the topic. */
+            vectorsAdded = addEncodedStringToVector( serializedTopicLength,
+                                                     pWillInfo->pTopicName,
+                                                     pWillInfo->topicNameLength,
+                                                     iterator,
+                                                     &totalMessageLength );
+
+            /* Update the iterator to point to the next empty slot. */
+            iterator = &iterator[ vectorsAdded ];
+            ioVectorLength += vectorsAdded;
+
+
+            /* Serialize the payload. Payload of last will and testament can be NULL. */
+            vectorsAdded = addEncodedStringToVector( serializedPayloadLength,
+                                                     pWillInfo->pPayload,
+                                                     ( uint16_t ) pWillInfo->payloadLength,
+                                                     iterator,
+                                                     &totalMessageLength );
+
+            /* Update the iterator to point to the next empty slot. */
+            iterator = &iterator[ vectorsAdded ];
+            ioVectorLength += vectorsAdded;
+        }
+
+        /* Encode the user name if provided. */
+        if( pConnectInfo->pUserName != NULL )
+        {
+            /* Serialize the user name string. */
+            vectorsAdded = addEncodedStringToVector( serializedUsernameLength,
+                                                     pConnectInfo->pUserName,
+                                                     pConnectInfo->userNameLength,
+                                                     iterator,
+                                                     &totalMessageLength );
+
+            /* Update the iterator to point to the next empty slot. */
+            iterator = &iterator[ vectorsAdded ];
+            ioVectorLength += vectorsAdded;
+        }
+
+        /* Encode the password if provided. */
+        if( pConnectInfo->pPassword != NULL )
+        {
+            /* Serialize the user name string. */
+            vectorsAdded = addEncodedStringToVector( serializedPasswordLength,
+                                                     pConnectInfo->pPassword,
+                                                     pConnectInfo->passwordLength,
+                                                     iterator,
+                                                     &totalMessageLength );
+            /* Update the iterator to point to the next empty slot. */
+            ioVectorLength += vectorsAdded;
+        }
+
+        bytesSentOrError = sendMessageVector( pContext, pIoVector, ioVectorLength );
+
+        if( bytesSentOrError != ( int32_t ) totalMessageLength )
+        {
+            status = MQTTSendFailed;
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t receiveConnack( MQTTContext_t * pContext,
+                                    uint32_t timeoutMs,
+                                    bool cleanSession,
+                                    MQTTPacketInfo_t * pIncomingPacket,
+                                    bool * pSessionPresent,
+                                    MQTTConnackProperties_t * pConnackProperties )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTGetCurrentTimeFunc_t getTimeStamp = NULL;
+    uint32_t entryTimeMs = 0U, remainingTimeMs = 0U, timeTakenMs = 0U;
+    bool breakFromLoop = false;
+    uint16_t loopCount = 0U;
+
+    assert( pContext != NULL );
+    assert( pIncomingPacket != NULL );
+    assert( pContext->getTime != NULL );
+
+    getTimeStamp = pContext->getTime;
+
+    /* Get the entry time for the function. */
+    entryTimeMs = getTimeStamp();
+
+    do
+    {
+        /* Transport read for incoming CONNACK packet type and length.
+         * MQTT_GetIncomingPacketTypeAndLength is a blocking call and it is
+         * returned after a transport receive timeout, an error, or a successful
+         * receive of packet type and length. */
+        status = MQTT_GetIncomingPacketTypeAndLength( pContext->transportInterface.recv,
+                                                      pContext->transportInterface.pNetworkContext,
+                                                      pIncomingPacket );
+
+        /* The loop times out based on 2 conditions.
+         * 1. If timeoutMs is greater than 0:
+         *    Loop times out based on the timeout calculated by getTime()
+         *    function.
+         * 2. If timeoutMs is 0:
+         *    Loop times out based on the maximum number of retries config
+         *    MQTT_MAX_CONNACK_RECEIVE_RETRY_COUNT. This config will control
+         *    maximum the number of retry attempts to read the CONNACK packet.
+         *    A value of 0 for the config will try once to read CONNACK. */
+        if( timeoutMs > 0U )
+        {
+            breakFromLoop = calculateElapsedTime( getTimeStamp(), entryTimeMs ) >= timeoutMs;
+        }
+        else
+        {
+            breakFromLoop = loopCount >= MQTT_MAX_CONNACK_RECEIVE_RETRY_COUNT;
+            loopCount++;
+        }
+
+        if( ( status == MQTTNoDataAvailable ) && ( breakFromLoop == false ) && ( timeoutMs > 0U ) )
+        {
+            waitForTransport( pContext, TRANSPORT_WAIT_READABLE, entryTimeMs, timeoutMs );
+        }
+
+        /* Loop until there is data to read or if we have exceeded the timeout/retries. */
+    } while( ( status == MQTTNoDataAvailable ) && ( breakFromLoop == false ) );
+
+    if( status == MQTTSuccess )
+    {
+        /* Time taken in this function so far. */
+        timeTakenMs = calculateElapsedTime( getTimeStamp(), entryTimeMs );
+
+        if( timeTakenMs < timeoutMs )
+        {
+            /* Calculate remaining time for receiving the remainder of
+             * the packet. */
+            remainingTimeMs = timeoutMs - timeTakenMs;
+        }
+
+        /* Reading the remainder of the packet by transport recv.
+         * Attempt to read once even if the timeout has expired.
+         * Invoking receivePacket with remainingTime as 0 would attempt to
+         * recv from network once. If using retries, the remainder of the
+         * CONNACK packet is tried to be read only once. Reading once would be
+         * good as the packet type and remaining length was already read. Hence,
+         * the probability of the remaining 2 bytes available to read is very high. */
+        if( pIncomingPacket->type == MQTT_PACKET_TYPE_CONNACK )
+        {
+            status = receivePacket( pContext,
+                                    *pIncomingPacket,
+                                    remainingTimeMs );
+        }
+        else
+        {
+            LogError( ( "Incorrect packet type %X received while expecting"
+                        " CONNACK(%X).",
+                        ( unsigned int ) pIncomingPacket->type,
+                        MQTT_PACKET_TYPE_CONNACK ) );
+            status = MQTTBadResponse;
+        }
+    }
+
+    if( status == MQTTSuccess )
+    {
+        /* Update the packet info pointer to the buffer read. */
+        pIncomingPacket->pRemainingData = pContext->networkBuffer.pBuffer;
+
+        /* Deserialize CONNACK. */
+        if( pContext->protocolVersion == MQTT_VERSION_5 )
+        {
+            status = MQTT_DeserializeAckV5( pIncomingPacket, NULL, pSessionPresent, pConnackProperties );
+        }
+        else
+        {
+            status = MQTT_DeserializeAck( pIncomingPacket, NULL, pSessionPresent );
+        }
+    }
 
-    /* The maximum vectors required to encode and send a connect packet. The
-     * breakdown is shown below.
-     * Fixed header      0 + 1 = 1
-     * Client ID           + 2 = 3
-     * Will topic          + 2 = 5
-     * Will payload        + 2 = 7
-     * Username            + 2 = 9
-     * Password            + 2 = 11 */
-    TransportOutVector_t pIoVector[ 11U ];
+    /* If a clean session is requested, a session present should not be set by
+     * broker. */
+    if( status == MQTTSuccess )
+    {
+        if( ( cleanSession == true ) && ( *pSessionPresent == true ) )
+        {
+            LogError( ( "Unexpected session present flag in CONNACK response from broker."
+                        " CONNECT request with clean session was made with broker." ) );
+            status = MQTTBadResponse;
+        }
+    }
 
-    iterator = pIoVector;
-    pIndex = connectPacketHeader;
+    if( status == MQTTSuccess )
+    {
+        LogDebug( ( "Received MQTT CONNACK successfully from broker." ) );
+    }
+    else
+    {
+        LogError( ( "CONNACK recv failed with status = %s.",
+                    MQTT_Status_strerror( status ) ) );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+#if ( MQTT_QOS0_ONLY == 0 )
+
+    static MQTTStatus_t handleUncleanSessionResumption( MQTTContext_t * pContext )
+    {
+        MQTTStatus_t status = MQTTSuccess;
+        MQTTStateCursor_t cursor = MQTT_STATE_CURSOR_INITIALIZER;
+        uint16_t packetId = MQTT_PACKET_ID_INVALID;
+        MQTTPublishState_t state = MQTTStateNull;
+        size_t totalMessageLength = 0;
+        uint8_t * pMqttPacket = NULL;
+
+        assert( pContext != NULL );
+
+        /* Get the next packet ID for which a PUBREL need to be resent. */
+        packetId = MQTT_PubrelToResend( pContext, &cursor, &state );
+
+        /* Resend all the PUBREL acks after session is reestablished. */
+        while( ( packetId != MQTT_PACKET_ID_INVALID ) &&
+               ( status == MQTTSuccess ) )
+        {
+            status = sendPublishAcks( pContext, packetId, state );
+
+            packetId = MQTT_PubrelToResend( pContext, &cursor, &state );
+        }
+
+        if( ( status == MQTTSuccess ) &&
+            ( pContext->retrieveFunction != NULL ) )
+        {
+            cursor = MQTT_STATE_CURSOR_INITIALIZER;
+
+            /* Resend all the PUBLISH for which PUBACK/PUBREC is not received
+             * after session is reestablished. */
+            do
+            {
+                packetId = MQTT_PublishToResend( pContext, &cursor );
+
+                if( packetId != MQTT_PACKET_ID_INVALID )
+                {
+                    if( pContext->retrieveFunction( pContext, packetId, &pMqttPacket, &totalMessageLength ) != true )
+                    {
+                        status = MQTTPublishRetrieveFailed;
+                        break;
+                    }
+
+                    MQTT_PRE_SEND_HOOK( pContext );
+
+                    if( sendBuffer( pContext, pMqttPacket, totalMessageLength ) != ( int32_t ) totalMessageLength )
+                    {
+                        status = MQTTSendFailed;
+                    }
+
+                    MQTT_POST_SEND_HOOK( pContext );
+                }
+            } while( ( packetId != MQTT_PACKET_ID_INVALID ) &&
+                     ( status == MQTTSuccess ) );
+        }
+
+        return status;
+    }
+
+#endif /* if ( MQTT_QOS0_ONLY == 0 ) */
+
+static MQTTStatus_t handleCleanSession( MQTTContext_t * pContext )
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    #if ( MQTT_QOS0_ONLY == 0 )
+        MQTTStateCursor_t cursor = MQTT_STATE_CURSOR_INITIALIZER;
+        uint16_t packetId = MQTT_PACKET_ID_INVALID;
+    #endif
+
+    assert( pContext != NULL );
+
+    /* Reset the index and clear the buffer when a new session is established. */
+    pContext->index = 0;
+    ( void ) memset( pContext->networkBuffer.pBuffer, 0, pContext->networkBuffer.size );
+
+    #if ( MQTT_QOS0_ONLY == 0 )
+        if( pContext->clearFunction != NULL )
+        {
+            cursor = MQTT_STATE_CURSOR_INITIALIZER;
+
+            /* Resend all the PUBLISH for which PUBACK/PUBREC is not received
+             * after session is reestablished. */
+            do
+            {
+                packetId = MQTT_PublishToResend( pContext, &cursor );
+
+                if( packetId != MQTT_PACKET_ID_INVALID )
+                {
+                    pContext->clearFunction( pContext, packetId );
+                }
+            } while( packetId != MQTT_PACKET_ID_INVALID );
+        }
+
+        if( pContext->outgoingPublishRecordMaxCount > 0U )
+        {
+            /* Clear any existing records if a new session is established. */
+            ( void ) memset( pContext->outgoingPublishRecords,
+                             0x00,
+                             pContext->outgoingPublishRecordMaxCount * sizeof( *pContext->outgoingPublishRecords ) );
+        }
+
+        if( pContext->incomingPublishRecordMaxCount > 0U )
+        {
+            ( void ) memset( pContext->incomingPublishRecords,
+                             0x00,
+                             pContext->incomingPublishRecordMaxCount * sizeof( *pContext->incomingPublishRecords ) );
+        }
+
+        /* The cleared records are no longer needed by a context using a slab. */
+        releaseStateRecords( pContext );
+    #endif
+
+    return status;
+}
+
+static MQTTStatus_t validatePublishParams( const MQTTContext_t * pContext,
+                                           const MQTTPublishInfo_t * pPublishInfo,
+                                           uint16_t packetId )
+{
+    MQTTStatus_t status = MQTTSuccess;
 
     /* Validate arguments. */
-    if( ( pWillInfo != NULL ) && ( pWillInfo->pTopicName == NULL ) )
+    if( ( pContext == NULL ) || ( pPublishInfo == NULL ) )
     {
-        LogError( ( "pWillInfo->pTopicName cannot be NULL if Will is present." ) );
+        LogError( ( "Argument cannot be NULL: pContext=%p, "
+                    "pPublishInfo=%p.",
+                    ( void * ) pContext,
+                    ( void * ) pPublishInfo ) );
+        status = MQTTBadParameter;
+    }
+    else if( ( pPublishInfo->qos != MQTTQoS0 ) && ( packetId == 0U ) )
+    {
+        LogError( ( "Packet Id is 0 for PUBLISH with QoS=%u.",
+                    ( unsigned int ) pPublishInfo->qos ) );
+        status = MQTTBadParameter;
+    }
+    else if( ( pPublishInfo->payloadLength > 0U ) && ( pPublishInfo->pPayload == NULL ) )
+    {
+        LogError( ( "A nonzero payload length requires a non-NULL payload: "
+                    "payloadLength=%lu, pPayload=%p.",
+                    ( unsigned long ) pPublishInfo->payloadLength,
+                    pPublishInfo->pPayload ) );
+        status = MQTTBadParameter;
+    }
+    #if ( MQTT_QOS0_ONLY == 0 )
+        else if( ( pContext->outgoingPublishRecords == NULL ) &&
+                 ( pContext->pRecordSlab == NULL ) &&
+                 ( pPublishInfo->qos > MQTTQoS0 ) )
+        {
+            LogError( ( "Trying to publish a QoS > MQTTQoS0 packet when outgoing publishes "
+                        "for QoS1/QoS2 have not been enabled. Please, call MQTT_InitStatefulQoS "
+                        "to initialize and enable the use of QoS1/QoS2 publishes." ) );
+            status = MQTTBadParameter;
+        }
+    #else
+        else if( pPublishInfo->qos > MQTTQoS0 )
+        {
+            LogError( ( "Publishes with QoS > MQTTQoS0 are not supported when "
+                        "MQTT_QOS0_ONLY is enabled." ) );
+            status = MQTTBadParameter;
+        }
+    #endif
+    else if( ( pPublishInfo->pTopicName != NULL ) && ( pPublishInfo->topicNameLength > 0U ) )
+    {
+        /* A missing topic name is reported by the serializer, so only the
+         * contents of a present topic name are validated here. */
+        status = MQTT_ValidateTopic( pPublishInfo->pTopicName,
+                                     pPublishInfo->topicNameLength,
+                                     false,
+                                     NULL,
+                                     NULL );
+    }
+    else
+    {
+        /* MISRA else */
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_Init( MQTTContext_t * pContext,
+                        const TransportInterface_t * pTransportInterface,
+                        MQTTGetCurrentTimeFunc_t getTimeFunction,
+                        MQTTEventCallback_t userCallback,
+                        const MQTTFixedBuffer_t * pNetworkBuffer )
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    /* Validate arguments. */
+    if( ( pContext == NULL ) || ( pTransportInterface == NULL ) ||
+        ( pNetworkBuffer == NULL ) )
+    {
+        LogError( ( "Argument cannot be NULL: pContext=%p, "
+                    "pTransportInterface=%p, "
+                    "pNetworkBuffer=%p",
+                    ( void * ) pContext,
+                    ( void * ) pTransportInterface,
+                    ( void * ) pNetworkBuffer ) );
+        status = MQTTBadParameter;
+    }
+    else if( getTimeFunction == NULL )
+    {
+        LogError( ( "Invalid parameter: getTimeFunction is NULL" ) );
+        status = MQTTBadParameter;
+    }
+    else if( userCallback == NULL )
+    {
+        LogError( ( "Invalid parameter: userCallback is NULL" ) );
+        status = MQTTBadParameter;
+    }
+    else if( pTransportInterface->recv == NULL )
+    {
+        LogError( ( "Invalid parameter: pTransportInterface->recv is NULL" ) );
+        status = MQTTBadParameter;
+    }
+    else if( pTransportInterface->send == NULL )
+    {
+        LogError( ( "Invalid parameter: pTransportInterface->send is NULL" ) );
+        status = MQTTBadParameter;
+    }
+    else if( ( pTransportInterface->getTxBuffer == NULL ) !=
+             ( pTransportInterface->commitTxBuffer == NULL ) )
+    {
+        LogError( ( "Invalid parameter: pTransportInterface->getTxBuffer and "
+                    "pTransportInterface->commitTxBuffer must be set together" ) );
         status = MQTTBadParameter;
     }
     else
     {
-        pIndex = MQTT_SerializeConnectFixedHeader( pIndex,
-                                                   pConnectInfo,
-                                                   pWillInfo,
-                                                   remainingLength );
+        ( void ) memset( pContext, 0x00, sizeof( MQTTContext_t ) );
 
-        assert( ( ( size_t ) ( pIndex - connectPacketHeader ) ) <= sizeof( connectPacketHeader ) );
+        pContext->connectStatus = MQTTNotConnected;
+        pContext->transportInterface = *pTransportInterface;
+        pContext->getTime = getTimeFunction;
+        pContext->appCallback = userCallback;
+        pContext->networkBuffer = *pNetworkBuffer;
 
-        /* The header gets sent first. */
-        iterator->iov_base = connectPacketHeader;
-        /* More details at: https://github.com/FreeRTOS/coreMQTT/blob/main/MISRA.md#rule-182 */
-        /* More details at: https://github.com/FreeRTOS/coreMQTT/blob/main/MISRA.md#rule-108 */
-        /* coverity[misra_c_2012_rule_18_2_violation] */
-        /* coverity[misra_c_2012_rule_10_8_violation] */
-        iterator->iov_len = ( size_t ) ( pIndex - connectPacketHeader );
-        totalMessageLength += iterator->iov_len;
-        iterator++;
-        ioVectorLength++;
+        /* Zero is not a valid packet ID per MQTT spec. Start from 1. */
+        pContext->nextPacketId = 1;
 
-        /* Serialize the client ID. */
-        vectorsAdded = addEncodedStringToVector( serializedClientIDLength,
-                                                 pConnectInfo->pClientIdentifier,
-                                                 pConnectInfo->clientIdentifierLength,
-                                                 iterator,
-                                                 &totalMessageLength );
+        pContext->protocolVersion = MQTT_VERSION_3_1_1;
+    }
 
-        /* Update the iterator to point to the next empty slot. */
-        iterator = &iterator[ vectorsAdded ];
-        ioVectorLength += vectorsAdded;
+    return status;
+}
 
-        if( pWillInfo != NULL )
+/*-----------------------------------------------------------*/
+
+#if ( MQTT_QOS0_ONLY == 0 )
+
+    MQTTStatus_t MQTT_InitStatefulQoS( MQTTContext_t * pContext,
+                                       MQTTPubAckInfo_t * pOutgoingPublishRecords,
+                                       size_t outgoingPublishCount,
+                                       MQTTPubAckInfo_t * pIncomingPublishRecords,
+                                       size_t incomingPublishCount )
+    {
+        MQTTStatus_t status = MQTTSuccess;
+
+        if( pContext == NULL )
         {
-            /* Serialize the topic. */
-            vectorsAdded = addEncodedStringToVector( serializedTopicLength,
-                                                     pWillInfo->pTopicName,
-                                                     pWillInfo->topicNameLength,
-                                                     iterator,
-                                                     &totalMessageLength );
+            LogError( ( "Argument cannot be NULL: pContext=%p\n",
+                        ( void * ) pContext ) );
+            status = MQTTBadParameter;
+        }
 
-            /* Update the iterator to point to the next empty slot. */
-            iterator = &iterator[ vectorsAdded ];
-            ioVectorLength += vectorsAdded;
+        /* Check whether the arguments make sense. Not equal here behaves
+         * like an exclusive-or operator for boolean values. */
+        else if( ( outgoingPublishCount == 0U ) !=
+                 ( pOutgoingPublishRecords == NULL ) )
+        {
+            LogError( ( "Arguments do not match: pOutgoingPublishRecords=%p, "
+                        "outgoingPublishCount=%lu",
+                        ( void * ) pOutgoingPublishRecords,
+                        ( unsigned long ) outgoingPublishCount ) );
+            status = MQTTBadParameter;
+        }
+
+        /* Check whether the arguments make sense. Not equal here behaves
+         * like an exclusive-or operator for boolean values. */
+        else if( ( incomingPublishCount == 0U ) !=
+                 ( pIncomingPublishRecords == NULL ) )
+        {
+            LogError( ( "Arguments do not match: pIncomingPublishRecords=%p, "
+                        "incomingPublishCount=%lu",
+                        ( void * ) pIncomingPublishRecords,
+                        ( unsigned long ) incomingPublishCount ) );
+            status = MQTTBadParameter;
+        }
+        else if( pContext->appCallback == NULL )
+        {
+            LogError( ( "MQTT_InitStatefulQoS must be called only after MQTT_Init has"
+                        " been called successfully.\n" ) );
+            status = MQTTBadParameter;
+        }
+        else
+        {
+            pContext->incomingPublishRecordMaxCount = incomingPublishCount;
+            pContext->incomingPublishRecords = pIncomingPublishRecords;
+            pContext->outgoingPublishRecordMaxCount = outgoingPublishCount;
+            pContext->outgoingPublishRecords = pOutgoingPublishRecords;
+        }
+
+        return status;
+    }
+
+#endif /* if ( MQTT_QOS0_ONLY == 0 ) */
+
+/*-----------------------------------------------------------*/
+
+#if ( MQTT_QOS0_ONLY == 0 )
+
+    MQTTStatus_t MQTT_InitRetransmits( MQTTContext_t * pContext,
+                                       MQTTStorePacketForRetransmit storeFunction,
+                                       MQTTRetrievePacketForRetransmit retrieveFunction,
+                                       MQTTClearPacketForRetransmit clearFunction )
+    {
+        MQTTStatus_t status = MQTTSuccess;
+
+        if( pContext == NULL )
+        {
+            LogError( ( "Argument cannot be NULL: pContext=%p\n",
+                        ( void * ) pContext ) );
+            status = MQTTBadParameter;
+        }
+        else if( storeFunction == NULL )
+        {
+            LogError( ( "Invalid parameter: storeFunction is NULL" ) );
+            status = MQTTBadParameter;
+        }
+        else if( retrieveFunction == NULL )
+        {
+            LogError( ( "Invalid parameter: retrieveFunction is NULL" ) );
+            status = MQTTBadParameter;
+        }
+        else if( clearFunction == NULL )
+        {
+            LogError( ( "Invalid parameter: clearFunction is NULL" ) );
+            status = MQTTBadParameter;
+        }
+        else
+        {
+            pContext->storeFunction = storeFunction;
+            pContext->retrieveFunction = retrieveFunction;
+            pContext->clearFunction = clearFunction;
+        }
 
+        return status;
+    }
 
-            /* Serialize the payload. Payload of last will and testament can be NULL. */
-            vectorsAdded = addEncodedStringToVector( serializedPayloadLength,
-                                                     pWillInfo->pPayload,
-                                                     ( uint16_t ) pWillInfo->payloadLength,
-                                                     iterator,
-                                                     &totalMessageLength );
+#endif /* if ( MQTT_QOS0_ONLY == 0 ) */
 
-            /* Update the iterator to point to the next empty slot. */
-            iterator = &iterator[ vectorsAdded ];
-            ioVectorLength += vectorsAdded;
-        }
+/*-----------------------------------------------------------*/
 
-        /* Encode the user name if provided. */
-        if( pConnectInfo->pUserName != NULL )
-        {
-            /* Serialize the user name string. */
-            vectorsAdded = addEncodedStringToVector( serializedUsernameLength,
-                                                     pConnectInfo->pUserName,
-                                                     pConnectInfo->userNameLength,
-                                                     iterator,
-                                                     &totalMessageLength );
+MQTTStatus_t MQTT_InitTopicHandlers( MQTTContext_t * pContext,
+                                     MQTTTopicHandlerRecord_t * pExactTopicHandlers,
+                                     size_t exactTopicHandlerCount,
+                                     MQTTTopicHandlerRecord_t * pWildcardTopicHandlers,
+                                     size_t wildcardTopicHandlerCount )
+{
+    MQTTStatus_t status = MQTTSuccess;
 
-            /* Update the iterator to point to the next empty slot. */
-            iterator = &iterator[ vectorsAdded ];
-            ioVectorLength += vectorsAdded;
-        }
+    if( pContext == NULL )
+    {
+        LogError( ( "Argument cannot be NULL: pContext=%p\n",
+                    ( void * ) pContext ) );
+        status = MQTTBadParameter;
+    }
 
-        /* Encode the password if provided. */
-        if( pConnectInfo->pPassword != NULL )
+    /* Check whether the arguments make sense. Not equal here behaves
+     * like an exclusive-or operator for boolean values. */
+    else if( ( exactTopicHandlerCount == 0U ) !=
+             ( pExactTopicHandlers == NULL ) )
+    {
+        LogError( ( "Arguments do not match: pExactTopicHandlers=%p, "
+                    "exactTopicHandlerCount=%lu",
+                    ( void * ) pExactTopicHandlers,
+                    ( unsigned long ) exactTopicHandlerCount ) );
+        status = MQTTBadParameter;
+    }
+    else if( ( wildcardTopicHandlerCount == 0U ) !=
+             ( pWildcardTopicHandlers == NULL ) )
+    {
+        LogError( ( "Arguments do not match: pWildcardTopicHandlers=%p, "
+                    "wildcardTopicHandlerCount=%lu",
+                    ( void * ) pWildcardTopicHandlers,
+                    ( unsigned long ) wildcardTopicHandlerCount ) );
+        status = MQTTBadParameter;
+    }
+    else if( pContext->appCallback == NULL )
+    {
+        LogError( ( "MQTT_InitTopicHandlers must be called only after MQTT_Init has"
+                    " been called successfully.\n" ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        if( pExactTopicHandlers != NULL )
         {
-            /* Serialize the user name string. */
-            vectorsAdded = addEncodedStringToVector( serializedPasswordLength,
-                                                     pConnectInfo->pPassword,
-                                                     pConnectInfo->passwordLength,
-                                                     iterator,
-                                                     &totalMessageLength );
-            /* Update the iterator to point to the next empty slot. */
-            ioVectorLength += vectorsAdded;
+            ( void ) memset( pExactTopicHandlers,
+                             0x00,
+                             exactTopicHandlerCount * sizeof( MQTTTopicHandlerRecord_t ) );
         }
 
-        bytesSentOrError = sendMessageVector( pContext, pIoVector, ioVectorLength );
-
-        if( bytesSentOrError != ( int32_t ) totalMessageLength )
+        if( pWildcardTopicHandlers != NULL )
         {
-            status = MQTTSendFailed;
+            ( void ) memset( pWildcardTopicHandlers,
+                             0x00,
+                             wildcardTopicHandlerCount * sizeof( MQTTTopicHandlerRecord_t ) );
         }
+
+        pContext->pExactTopicHandlers = pExactTopicHandlers;
+        pContext->exactTopicHandlerMaxCount = exactTopicHandlerCount;
+        pContext->pWildcardTopicHandlers = pWildcardTopicHandlers;
+        pContext->wildcardTopicHandlerMaxCount = wildcardTopicHandlerCount;
+        pContext->wildcardTopicHandlerCount = 0U;
     }
 
     return status;
@@ -2411,123 +6448,284 @@ static MQTTStatus_t sendConnectWithoutCopy( MQTTContext_t * pContext,
 
 /*-----------------------------------------------------------*/
 
-static MQTTStatus_t receiveConnack( MQTTContext_t * pContext,
-                                    uint32_t timeoutMs,
-                                    bool cleanSession,
-                                    MQTTPacketInfo_t * pIncomingPacket,
-                                    bool * pSessionPresent )
+MQTTStatus_t MQTT_RegisterTopicHandler( MQTTContext_t * pContext,
+                                        const char * pTopicFilter,
+                                        uint16_t topicFilterLength,
+                                        MQTTTopicHandler_t handler,
+                                        void * pHandlerContext )
 {
     MQTTStatus_t status = MQTTSuccess;
-    MQTTGetCurrentTimeFunc_t getTimeStamp = NULL;
-    uint32_t entryTimeMs = 0U, remainingTimeMs = 0U, timeTakenMs = 0U;
-    bool breakFromLoop = false;
-    uint16_t loopCount = 0U;
-
-    assert( pContext != NULL );
-    assert( pIncomingPacket != NULL );
-    assert( pContext->getTime != NULL );
-
-    getTimeStamp = pContext->getTime;
+    MQTTTopicHandlerRecord_t * pRecord = NULL;
+    uint16_t prefixLength = 0U;
+    uint32_t filterHash = 0U;
+    size_t index;
+    bool hasWildcard = false, found = false;
 
-    /* Get the entry time for the function. */
-    entryTimeMs = getTimeStamp();
-
-    do
+    if( ( pContext == NULL ) || ( pTopicFilter == NULL ) )
     {
-        /* Transport read for incoming CONNACK packet type and length.
-         * MQTT_GetIncomingPacketTypeAndLength is a blocking call and it is
-         * returned after a transport receive timeout, an error, or a successful
-         * receive of packet type and length. */
-        status = MQTT_GetIncomingPacketTypeAndLength( pContext->transportInterface.recv,
-                                                      pContext->transportInterface.pNetworkContext,
-                                                      pIncomingPacket );
+        LogError( ( "Argument cannot be NULL: pContext=%p, "
+                    "pTopicFilter=%p.",
+                    ( void * ) pContext,
+                    ( const void * ) pTopicFilter ) );
+        status = MQTTBadParameter;
+    }
+    else if( handler == NULL )
+    {
+        LogError( ( "Invalid parameter: handler is NULL" ) );
+        status = MQTTBadParameter;
+    }
+    else if( topicFilterLength == 0U )
+    {
+        LogError( ( "Invalid parameter: topicFilterLength is 0." ) );
+        status = MQTTBadParameter;
+    }
+    else if( MQTT_ValidateTopic( pTopicFilter, topicFilterLength, true, NULL, NULL ) != MQTTSuccess )
+    {
+        LogError( ( "Invalid parameter: %.*s is not a valid topic filter.",
+                    ( int ) topicFilterLength,
+                    pTopicFilter ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        prefixLength = getTopicFilterPrefixLength( pTopicFilter,
+                                                   topicFilterLength,
+                                                   &hasWildcard );
+    }
 
-        /* The loop times out based on 2 conditions.
-         * 1. If timeoutMs is greater than 0:
-         *    Loop times out based on the timeout calculated by getTime()
-         *    function.
-         * 2. If timeoutMs is 0:
-         *    Loop times out based on the maximum number of retries config
-         *    MQTT_MAX_CONNACK_RECEIVE_RETRY_COUNT. This config will control
-         *    maximum the number of retry attempts to read the CONNACK packet.
-         *    A value of 0 for the config will try once to read CONNACK. */
-        if( timeoutMs > 0U )
+    if( status != MQTTSuccess )
+    {
+        /* Parameters are invalid. */
+    }
+    else if( hasWildcard == false )
+    {
+        if( pContext->pExactTopicHandlers == NULL )
         {
-            breakFromLoop = calculateElapsedTime( getTimeStamp(), entryTimeMs ) >= timeoutMs;
+            LogError( ( "Topic handlers for filters without wildcards are not "
+                        "initialized. Please call MQTT_InitTopicHandlers first." ) );
+            status = MQTTBadParameter;
         }
         else
         {
-            breakFromLoop = loopCount >= MQTT_MAX_CONNACK_RECEIVE_RETRY_COUNT;
-            loopCount++;
+            filterHash = hashTopic( pTopicFilter, topicFilterLength );
+            index = findExactTopicHandler( pContext,
+                                           pTopicFilter,
+                                           topicFilterLength,
+                                           filterHash,
+                                           &found );
+
+            if( index < pContext->exactTopicHandlerMaxCount )
+            {
+                pRecord = &pContext->pExactTopicHandlers[ index ];
+            }
+        }
+    }
+    else
+    {
+        if( pContext->pWildcardTopicHandlers == NULL )
+        {
+            LogError( ( "Topic handlers for filters with wildcards are not "
+                        "initialized. Please call MQTT_InitTopicHandlers first." ) );
+            status = MQTTBadParameter;
         }
+        else
+        {
+            index = findWildcardTopicHandler( pContext,
+                                              pTopicFilter,
+                                              topicFilterLength );
 
-        /* Loop until there is data to read or if we have exceeded the timeout/retries. */
-    } while( ( status == MQTTNoDataAvailable ) && ( breakFromLoop == false ) );
+            if( index < pContext->wildcardTopicHandlerCount )
+            {
+                found = true;
+                pRecord = &pContext->pWildcardTopicHandlers[ index ];
+            }
+            else if( index < pContext->wildcardTopicHandlerMaxCount )
+            {
+                pRecord = &pContext->pWildcardTopicHandlers[ index ];
+                pContext->wildcardTopicHandlerCount++;
+            }
+            else
+            {
+                /* No free record for the filter. */
+            }
+        }
+    }
 
-    if( status == MQTTSuccess )
+    if( status != MQTTSuccess )
     {
-        /* Time taken in this function so far. */
-        timeTakenMs = calculateElapsedTime( getTimeStamp(), entryTimeMs );
+        /* Parameters are invalid. */
+    }
+    else if( pRecord == NULL )
+    {
+        LogError( ( "No free topic handler record for topic filter %.*s.",
+                    ( int ) topicFilterLength,
+                    pTopicFilter ) );
+        status = MQTTNoMemory;
+    }
+    else
+    {
+        if( found == false )
+        {
+            pRecord->pTopicFilter = pTopicFilter;
+            pRecord->topicFilterLength = topicFilterLength;
+            pRecord->prefixLength = prefixLength;
+            pRecord->filterHash = filterHash;
+        }
 
-        if( timeTakenMs < timeoutMs )
+        pRecord->handler = handler;
+        pRecord->pHandlerContext = pHandlerContext;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_UnregisterTopicHandler( MQTTContext_t * pContext,
+                                          const char * pTopicFilter,
+                                          uint16_t topicFilterLength )
+{
+    MQTTStatus_t status = MQTTBadParameter;
+    size_t index;
+    bool found = false;
+
+    if( ( pContext == NULL ) || ( pTopicFilter == NULL ) || ( topicFilterLength == 0U ) )
+    {
+        LogError( ( "Invalid parameter: pContext=%p, pTopicFilter=%p, "
+                    "topicFilterLength=%hu.",
+                    ( void * ) pContext,
+                    ( const void * ) pTopicFilter,
+                    ( unsigned short ) topicFilterLength ) );
+    }
+    else
+    {
+        if( pContext->pExactTopicHandlers != NULL )
         {
-            /* Calculate remaining time for receiving the remainder of
-             * the packet. */
-            remainingTimeMs = timeoutMs - timeTakenMs;
+            index = findExactTopicHandler( pContext,
+                                           pTopicFilter,
+                                           topicFilterLength,
+                                           hashTopic( pTopicFilter, topicFilterLength ),
+                                           &found );
+
+            if( found == true )
+            {
+                removeExactTopicHandler( pContext, index );
+                status = MQTTSuccess;
+            }
         }
 
-        /* Reading the remainder of the packet by transport recv.
-         * Attempt to read once even if the timeout has expired.
-         * Invoking receivePacket with remainingTime as 0 would attempt to
-         * recv from network once. If using retries, the remainder of the
-         * CONNACK packet is tried to be read only once. Reading once would be
-         * good as the packet type and remaining length was already read. Hence,
-         * the probability of the remaining 2 bytes available to read is very high. */
-        if( pIncomingPacket->type == MQTT_PACKET_TYPE_CONNACK )
+        if( ( found == false ) && ( pContext->pWildcardTopicHandlers != NULL ) )
         {
-            status = receivePacket( pContext,
-                                    *pIncomingPacket,
-                                    remainingTimeMs );
+            index = findWildcardTopicHandler( pContext,
+                                              pTopicFilter,
+                                              topicFilterLength );
+
+            if( index < pContext->wildcardTopicHandlerCount )
+            {
+                /* Keep the registration order of the remaining filters. */
+                for( ; index < ( pContext->wildcardTopicHandlerCount - 1U ); index++ )
+                {
+                    pContext->pWildcardTopicHandlers[ index ] = pContext->pWildcardTopicHandlers[ index + 1U ];
+                }
+
+                ( void ) memset( &pContext->pWildcardTopicHandlers[ index ],
+                                 0x00,
+                                 sizeof( MQTTTopicHandlerRecord_t ) );
+                pContext->wildcardTopicHandlerCount--;
+                status = MQTTSuccess;
+            }
         }
-        else
+
+        if( status != MQTTSuccess )
         {
-            LogError( ( "Incorrect packet type %X received while expecting"
-                        " CONNACK(%X).",
-                        ( unsigned int ) pIncomingPacket->type,
-                        MQTT_PACKET_TYPE_CONNACK ) );
-            status = MQTTBadResponse;
+            LogError( ( "No handler is registered for topic filter %.*s.",
+                        ( int ) topicFilterLength,
+                        pTopicFilter ) );
         }
     }
 
-    if( status == MQTTSuccess )
-    {
-        /* Update the packet info pointer to the buffer read. */
-        pIncomingPacket->pRemainingData = pContext->networkBuffer.pBuffer;
+    return status;
+}
 
-        /* Deserialize CONNACK. */
-        status = MQTT_DeserializeAck( pIncomingPacket, NULL, pSessionPresent );
-    }
+/*-----------------------------------------------------------*/
 
-    /* If a clean session is requested, a session present should not be set by
-     * broker. */
-    if( status == MQTTSuccess )
+MQTTStatus_t MQTT_InitBufferPool( MQTTBufferPool_t * pBufferPool,
+                                  uint8_t * pBuffers,
+                                  size_t bufferSize,
+                                  size_t bufferCount )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    size_t index;
+    uint8_t * pNextBuffer = NULL;
+
+    if( ( pBufferPool == NULL ) || ( pBuffers == NULL ) )
     {
-        if( ( cleanSession == true ) && ( *pSessionPresent == true ) )
+        LogError( ( "Argument cannot be NULL: pBufferPool=%p, pBuffers=%p.",
+                    ( void * ) pBufferPool,
+                    ( void * ) pBuffers ) );
+        status = MQTTBadParameter;
+    }
+    else if( bufferSize < sizeof( pBufferPool->pFreeList ) )
+    {
+        LogError( ( "Buffer size %lu is smaller than the minimum of %lu.",
+                    ( unsigned long ) bufferSize,
+                    ( unsigned long ) sizeof( pBufferPool->pFreeList ) ) );
+        status = MQTTBadParameter;
+    }
+    else if( bufferCount == 0U )
+    {
+        LogError( ( "Buffer count cannot be 0." ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        /* Link the buffers from last to first so that the first buffer is
+         * lent first. */
+        for( index = bufferCount; index > 0U; index-- )
         {
-            LogError( ( "Unexpected session present flag in CONNACK response from broker."
-                        " CONNECT request with clean session was made with broker." ) );
-            status = MQTTBadResponse;
+            ( void ) memcpy( &pBuffers[ ( index - 1U ) * bufferSize ],
+                             &pNextBuffer,
+                             sizeof( pNextBuffer ) );
+            pNextBuffer = &pBuffers[ ( index - 1U ) * bufferSize ];
         }
+
+        pBufferPool->pFreeList = pNextBuffer;
+        pBufferPool->bufferSize = bufferSize;
+        pBufferPool->bufferCount = bufferCount;
+        pBufferPool->freeCount = bufferCount;
     }
 
-    if( status == MQTTSuccess )
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_SetBufferPool( MQTTContext_t * pContext,
+                                 MQTTBufferPool_t * pBufferPool )
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    if( pContext == NULL )
     {
-        LogDebug( ( "Received MQTT CONNACK successfully from broker." ) );
+        LogError( ( "Argument cannot be NULL: pContext=%p.",
+                    ( void * ) pContext ) );
+        status = MQTTBadParameter;
+    }
+    else if( ( pContext->index != 0U ) || ( pContext->networkBufferBorrowed == true ) )
+    {
+        LogError( ( "The buffer pool cannot be changed while a packet is being received." ) );
+        status = MQTTBadParameter;
     }
     else
     {
-        LogError( ( "CONNACK recv failed with status = %s.",
-                    MQTT_Status_strerror( status ) ) );
+        /* Keep the buffer given to MQTT_Init to fall back to when the pool is
+         * exhausted. */
+        if( pContext->pBufferPool == NULL )
+        {
+            pContext->privateNetworkBuffer = pContext->networkBuffer;
+        }
+
+        pContext->pBufferPool = pBufferPool;
     }
 
     return status;
@@ -2535,150 +6733,155 @@ static MQTTStatus_t receiveConnack( MQTTContext_t * pContext,
 
 /*-----------------------------------------------------------*/
 
-static MQTTStatus_t handleUncleanSessionResumption( MQTTContext_t * pContext )
+MQTTStatus_t MQTT_ClaimNetworkBuffer( MQTTContext_t * pContext,
+                                      uint8_t ** ppBuffer )
 {
     MQTTStatus_t status = MQTTSuccess;
-    MQTTStateCursor_t cursor = MQTT_STATE_CURSOR_INITIALIZER;
-    uint16_t packetId = MQTT_PACKET_ID_INVALID;
-    MQTTPublishState_t state = MQTTStateNull;
-    size_t totalMessageLength = 0;
-    uint8_t * pMqttPacket = NULL;
-
-    assert( pContext != NULL );
-
-    /* Get the next packet ID for which a PUBREL need to be resent. */
-    packetId = MQTT_PubrelToResend( pContext, &cursor, &state );
+    uint8_t * pReplacementBuffer = NULL;
 
-    /* Resend all the PUBREL acks after session is reestablished. */
-    while( ( packetId != MQTT_PACKET_ID_INVALID ) &&
-           ( status == MQTTSuccess ) )
+    if( ( pContext == NULL ) || ( ppBuffer == NULL ) )
     {
-        status = sendPublishAcks( pContext, packetId, state );
-
-        packetId = MQTT_PubrelToResend( pContext, &cursor, &state );
+        LogError( ( "Argument cannot be NULL: pContext=%p, ppBuffer=%p.",
+                    ( void * ) pContext,
+                    ( void * ) ppBuffer ) );
+        status = MQTTBadParameter;
     }
-
-    if( ( status == MQTTSuccess ) &&
-        ( pContext->retrieveFunction != NULL ) )
+    else if( pContext->pClaimableBuffer == NULL )
+    {
+        LogError( ( "No incoming publish in a buffer of the pool can be claimed." ) );
+        status = MQTTBadParameter;
+    }
+    else
     {
-        cursor = MQTT_STATE_CURSOR_INITIALIZER;
+        /* The buffer is only claimed if another one can take its place. */
+        pReplacementBuffer = takePoolBuffer( pContext->pBufferPool );
 
-        /* Resend all the PUBLISH for which PUBACK/PUBREC is not received
-         * after session is reestablished. */
-        do
+        if( pReplacementBuffer == NULL )
         {
-            packetId = MQTT_PublishToResend( pContext, &cursor );
+            LogWarn( ( "Buffer pool is exhausted. The network buffer cannot be claimed." ) );
+            status = MQTTNoMemory;
+        }
+        else
+        {
+            pContext->pReplacementBuffer = pReplacementBuffer;
+            *ppBuffer = pContext->pClaimableBuffer;
+            pContext->pClaimableBuffer = NULL;
+        }
+    }
 
-            if( packetId != MQTT_PACKET_ID_INVALID )
-            {
-                if( pContext->retrieveFunction( pContext, packetId, &pMqttPacket, &totalMessageLength ) != true )
-                {
-                    status = MQTTPublishRetrieveFailed;
-                    break;
-                }
+    return status;
+}
 
-                MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+/*-----------------------------------------------------------*/
 
-                if( sendBuffer( pContext, pMqttPacket, totalMessageLength ) != ( int32_t ) totalMessageLength )
-                {
-                    status = MQTTSendFailed;
-                }
+MQTTStatus_t MQTT_ReleaseNetworkBuffer( MQTTBufferPool_t * pBufferPool,
+                                        uint8_t * pBuffer )
+{
+    MQTTStatus_t status = MQTTSuccess;
 
-                MQTT_POST_STATE_UPDATE_HOOK( pContext );
-            }
-        } while( ( packetId != MQTT_PACKET_ID_INVALID ) &&
-                 ( status == MQTTSuccess ) );
+    if( ( pBufferPool == NULL ) || ( pBuffer == NULL ) )
+    {
+        LogError( ( "Argument cannot be NULL: pBufferPool=%p, pBuffer=%p.",
+                    ( void * ) pBufferPool,
+                    ( void * ) pBuffer ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        givePoolBuffer( pBufferPool, pBuffer );
     }
 
     return status;
 }
 
-static MQTTStatus_t handleCleanSession( MQTTContext_t * pContext )
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_SetProtocolVersion( MQTTContext_t * pContext,
+                                      uint8_t protocolVersion )
 {
     MQTTStatus_t status = MQTTSuccess;
-    MQTTStateCursor_t cursor = MQTT_STATE_CURSOR_INITIALIZER;
-    uint16_t packetId = MQTT_PACKET_ID_INVALID;
-
-    assert( pContext != NULL );
-
-    /* Reset the index and clear the buffer when a new session is established. */
-    pContext->index = 0;
-    ( void ) memset( pContext->networkBuffer.pBuffer, 0, pContext->networkBuffer.size );
 
-    if( pContext->clearFunction != NULL )
+    if( pContext == NULL )
     {
-        cursor = MQTT_STATE_CURSOR_INITIALIZER;
-
-        /* Resend all the PUBLISH for which PUBACK/PUBREC is not received
-         * after session is reestablished. */
-        do
-        {
-            packetId = MQTT_PublishToResend( pContext, &cursor );
-
-            if( packetId != MQTT_PACKET_ID_INVALID )
-            {
-                pContext->clearFunction( pContext, packetId );
-            }
-        } while( packetId != MQTT_PACKET_ID_INVALID );
+        LogError( ( "Argument cannot be NULL: pContext=%p",
+                    ( void * ) pContext ) );
+        status = MQTTBadParameter;
     }
-
-    if( pContext->outgoingPublishRecordMaxCount > 0U )
+    else if( ( protocolVersion != MQTT_VERSION_3_1_1 ) &&
+             ( protocolVersion != MQTT_VERSION_5 ) )
     {
-        /* Clear any existing records if a new session is established. */
-        ( void ) memset( pContext->outgoingPublishRecords,
-                         0x00,
-                         pContext->outgoingPublishRecordMaxCount * sizeof( *pContext->outgoingPublishRecords ) );
+        LogError( ( "Unsupported MQTT protocol version %u.",
+                    ( unsigned int ) protocolVersion ) );
+        status = MQTTBadParameter;
     }
-
-    if( pContext->incomingPublishRecordMaxCount > 0U )
+    else
     {
-        ( void ) memset( pContext->incomingPublishRecords,
-                         0x00,
-                         pContext->incomingPublishRecordMaxCount * sizeof( *pContext->incomingPublishRecords ) );
+        MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+
+        if( pContext->connectStatus != MQTTNotConnected )
+        {
+            LogError( ( "The protocol version cannot be changed while connected." ) );
+            status = MQTTBadParameter;
+        }
+        else
+        {
+            pContext->protocolVersion = protocolVersion;
+        }
+
+        MQTT_POST_STATE_UPDATE_HOOK( pContext );
     }
 
     return status;
 }
 
-static MQTTStatus_t validatePublishParams( const MQTTContext_t * pContext,
-                                           const MQTTPublishInfo_t * pPublishInfo,
-                                           uint16_t packetId )
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_InitTopicAliases( MQTTContext_t * pContext,
+                                    MQTTTopicAliasRecord_t * pTopicAliases,
+                                    size_t topicAliasCount )
 {
     MQTTStatus_t status = MQTTSuccess;
 
-    /* Validate arguments. */
-    if( ( pContext == NULL ) || ( pPublishInfo == NULL ) )
+    if( ( pContext == NULL ) || ( pTopicAliases == NULL ) )
     {
-        LogError( ( "Argument cannot be NULL: pContext=%p, "
-                    "pPublishInfo=%p.",
+        LogError( ( "Argument cannot be NULL: pContext=%p, pTopicAliases=%p",
                     ( void * ) pContext,
-                    ( void * ) pPublishInfo ) );
-        status = MQTTBadParameter;
-    }
-    else if( ( pPublishInfo->qos != MQTTQoS0 ) && ( packetId == 0U ) )
-    {
-        LogError( ( "Packet Id is 0 for PUBLISH with QoS=%u.",
-                    ( unsigned int ) pPublishInfo->qos ) );
+                    ( void * ) pTopicAliases ) );
         status = MQTTBadParameter;
     }
-    else if( ( pPublishInfo->payloadLength > 0U ) && ( pPublishInfo->pPayload == NULL ) )
+    else if( ( topicAliasCount == 0U ) || ( topicAliasCount > UINT16_MAX ) )
     {
-        LogError( ( "A nonzero payload length requires a non-NULL payload: "
-                    "payloadLength=%lu, pPayload=%p.",
-                    ( unsigned long ) pPublishInfo->payloadLength,
-                    pPublishInfo->pPayload ) );
+        LogError( ( "Invalid topic alias count %lu.",
+                    ( unsigned long ) topicAliasCount ) );
         status = MQTTBadParameter;
     }
-    else if( ( pContext->outgoingPublishRecords == NULL ) && ( pPublishInfo->qos > MQTTQoS0 ) )
+    else if( pContext->protocolVersion != MQTT_VERSION_5 )
     {
-        LogError( ( "Trying to publish a QoS > MQTTQoS0 packet when outgoing publishes "
-                    "for QoS1/QoS2 have not been enabled. Please, call MQTT_InitStatefulQoS "
-                    "to initialize and enable the use of QoS1/QoS2 publishes." ) );
+        LogError( ( "Topic aliases require MQTT 5. Call MQTT_SetProtocolVersion first." ) );
         status = MQTTBadParameter;
     }
     else
     {
-        /* MISRA else */
+        MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+
+        if( pContext->connectStatus != MQTTNotConnected )
+        {
+            LogError( ( "Topic aliases cannot be initialized while connected." ) );
+            status = MQTTBadParameter;
+        }
+        else
+        {
+            ( void ) memset( pTopicAliases,
+                             0x00,
+                             topicAliasCount * sizeof( MQTTTopicAliasRecord_t ) );
+
+            pContext->pTopicAliases = pTopicAliases;
+            pContext->topicAliasMaxCount = ( uint16_t ) topicAliasCount;
+            pContext->topicAliasCount = 0U;
+            pContext->topicAliasClock = 0U;
+        }
+
+        MQTT_POST_STATE_UPDATE_HOOK( pContext );
     }
 
     return status;
@@ -2686,58 +6889,40 @@ static MQTTStatus_t validatePublishParams( const MQTTContext_t * pContext,
 
 /*-----------------------------------------------------------*/
 
-MQTTStatus_t MQTT_Init( MQTTContext_t * pContext,
-                        const TransportInterface_t * pTransportInterface,
-                        MQTTGetCurrentTimeFunc_t getTimeFunction,
-                        MQTTEventCallback_t userCallback,
-                        const MQTTFixedBuffer_t * pNetworkBuffer )
+MQTTStatus_t MQTT_InitSubscriptionHandlers( MQTTContext_t * pContext,
+                                            MQTTSubscriptionHandlerRecord_t * pSubscriptionHandlers,
+                                            size_t subscriptionHandlerCount )
 {
     MQTTStatus_t status = MQTTSuccess;
 
-    /* Validate arguments. */
-    if( ( pContext == NULL ) || ( pTransportInterface == NULL ) ||
-        ( pNetworkBuffer == NULL ) )
+    if( ( pContext == NULL ) || ( pSubscriptionHandlers == NULL ) )
     {
-        LogError( ( "Argument cannot be NULL: pContext=%p, "
-                    "pTransportInterface=%p, "
-                    "pNetworkBuffer=%p",
+        LogError( ( "Argument cannot be NULL: pContext=%p, pSubscriptionHandlers=%p",
                     ( void * ) pContext,
-                    ( void * ) pTransportInterface,
-                    ( void * ) pNetworkBuffer ) );
-        status = MQTTBadParameter;
-    }
-    else if( getTimeFunction == NULL )
-    {
-        LogError( ( "Invalid parameter: getTimeFunction is NULL" ) );
-        status = MQTTBadParameter;
-    }
-    else if( userCallback == NULL )
-    {
-        LogError( ( "Invalid parameter: userCallback is NULL" ) );
+                    ( void * ) pSubscriptionHandlers ) );
         status = MQTTBadParameter;
     }
-    else if( pTransportInterface->recv == NULL )
+    else if( ( subscriptionHandlerCount == 0U ) ||
+             ( subscriptionHandlerCount > MQTT_SUBSCRIPTION_ID_MAX ) )
     {
-        LogError( ( "Invalid parameter: pTransportInterface->recv is NULL" ) );
+        LogError( ( "Invalid subscription handler count %lu.",
+                    ( unsigned long ) subscriptionHandlerCount ) );
         status = MQTTBadParameter;
     }
-    else if( pTransportInterface->send == NULL )
+    else if( pContext->appCallback == NULL )
     {
-        LogError( ( "Invalid parameter: pTransportInterface->send is NULL" ) );
+        LogError( ( "MQTT_InitSubscriptionHandlers must be called only after MQTT_Init has"
+                    " been called successfully." ) );
         status = MQTTBadParameter;
     }
     else
     {
-        ( void ) memset( pContext, 0x00, sizeof( MQTTContext_t ) );
-
-        pContext->connectStatus = MQTTNotConnected;
-        pContext->transportInterface = *pTransportInterface;
-        pContext->getTime = getTimeFunction;
-        pContext->appCallback = userCallback;
-        pContext->networkBuffer = *pNetworkBuffer;
+        ( void ) memset( pSubscriptionHandlers,
+                         0x00,
+                         subscriptionHandlerCount * sizeof( MQTTSubscriptionHandlerRecord_t ) );
 
-        /* Zero is not a valid packet ID per MQTT spec. Start from 1. */
-        pContext->nextPacketId = 1;
+        pContext->pSubscriptionHandlers = pSubscriptionHandlers;
+        pContext->subscriptionHandlerMaxCount = subscriptionHandlerCount;
     }
 
     return status;
@@ -2745,56 +6930,33 @@ MQTTStatus_t MQTT_Init( MQTTContext_t * pContext,
 
 /*-----------------------------------------------------------*/
 
-MQTTStatus_t MQTT_InitStatefulQoS( MQTTContext_t * pContext,
-                                   MQTTPubAckInfo_t * pOutgoingPublishRecords,
-                                   size_t outgoingPublishCount,
-                                   MQTTPubAckInfo_t * pIncomingPublishRecords,
-                                   size_t incomingPublishCount )
+MQTTStatus_t MQTT_RegisterSubscriptionHandler( MQTTContext_t * pContext,
+                                               uint32_t subscriptionId,
+                                               MQTTTopicHandler_t handler,
+                                               void * pHandlerContext )
 {
     MQTTStatus_t status = MQTTSuccess;
+    MQTTSubscriptionHandlerRecord_t * pRecord;
 
-    if( pContext == NULL )
+    if( ( pContext == NULL ) || ( pContext->pSubscriptionHandlers == NULL ) )
     {
-        LogError( ( "Argument cannot be NULL: pContext=%p\n",
+        LogError( ( "pContext must be initialized with MQTT_InitSubscriptionHandlers: pContext=%p",
                     ( void * ) pContext ) );
         status = MQTTBadParameter;
     }
-
-    /* Check whether the arguments make sense. Not equal here behaves
-     * like an exclusive-or operator for boolean values. */
-    else if( ( outgoingPublishCount == 0U ) !=
-             ( pOutgoingPublishRecords == NULL ) )
-    {
-        LogError( ( "Arguments do not match: pOutgoingPublishRecords=%p, "
-                    "outgoingPublishCount=%lu",
-                    ( void * ) pOutgoingPublishRecords,
-                    ( unsigned long ) outgoingPublishCount ) );
-        status = MQTTBadParameter;
-    }
-
-    /* Check whether the arguments make sense. Not equal here behaves
-     * like an exclusive-or operator for boolean values. */
-    else if( ( incomingPublishCount == 0U ) !=
-             ( pIncomingPublishRecords == NULL ) )
-    {
-        LogError( ( "Arguments do not match: pIncomingPublishRecords=%p, "
-                    "incomingPublishCount=%lu",
-                    ( void * ) pIncomingPublishRecords,
-                    ( unsigned long ) incomingPublishCount ) );
-        status = MQTTBadParameter;
-    }
-    else if( pContext->appCallback == NULL )
+    else if( ( subscriptionId == 0U ) ||
+             ( subscriptionId > pContext->subscriptionHandlerMaxCount ) )
     {
-        LogError( ( "MQTT_InitStatefulQoS must be called only after MQTT_Init has"
-                    " been called successfully.\n" ) );
+        LogError( ( "Subscription Identifier %lu is outside the table of %lu handlers.",
+                    ( unsigned long ) subscriptionId,
+                    ( unsigned long ) pContext->subscriptionHandlerMaxCount ) );
         status = MQTTBadParameter;
     }
     else
     {
-        pContext->incomingPublishRecordMaxCount = incomingPublishCount;
-        pContext->incomingPublishRecords = pIncomingPublishRecords;
-        pContext->outgoingPublishRecordMaxCount = outgoingPublishCount;
-        pContext->outgoingPublishRecords = pOutgoingPublishRecords;
+        pRecord = &pContext->pSubscriptionHandlers[ subscriptionId - 1U ];
+        pRecord->handler = handler;
+        pRecord->pHandlerContext = ( handler != NULL ) ? pHandlerContext : NULL;
     }
 
     return status;
@@ -2802,39 +6964,63 @@ MQTTStatus_t MQTT_InitStatefulQoS( MQTTContext_t * pContext,
 
 /*-----------------------------------------------------------*/
 
-MQTTStatus_t MQTT_InitRetransmits( MQTTContext_t * pContext,
-                                   MQTTStorePacketForRetransmit storeFunction,
-                                   MQTTRetrievePacketForRetransmit retrieveFunction,
-                                   MQTTClearPacketForRetransmit clearFunction )
+MQTTStatus_t MQTT_InitSubscriptionRegistry( MQTTContext_t * pContext,
+                                            MQTTSubscriptionRecord_t * pSubscriptionRecords,
+                                            size_t subscriptionRecordCount,
+                                            const MQTTFixedBuffer_t * pStagingBuffer )
 {
     MQTTStatus_t status = MQTTSuccess;
 
-    if( pContext == NULL )
-    {
-        LogError( ( "Argument cannot be NULL: pContext=%p\n",
-                    ( void * ) pContext ) );
-        status = MQTTBadParameter;
-    }
-    else if( storeFunction == NULL )
+    if( ( pContext == NULL ) || ( pSubscriptionRecords == NULL ) || ( pStagingBuffer == NULL ) )
     {
-        LogError( ( "Invalid parameter: storeFunction is NULL" ) );
+        LogError( ( "Argument cannot be NULL: pContext=%p, pSubscriptionRecords=%p, "
+                    "pStagingBuffer=%p.",
+                    ( void * ) pContext,
+                    ( void * ) pSubscriptionRecords,
+                    ( void * ) pStagingBuffer ) );
         status = MQTTBadParameter;
     }
-    else if( retrieveFunction == NULL )
+    else if( subscriptionRecordCount == 0U )
     {
-        LogError( ( "Invalid parameter: retrieveFunction is NULL" ) );
+        LogError( ( "Subscription record count is 0." ) );
         status = MQTTBadParameter;
     }
-    else if( clearFunction == NULL )
+
+    /* Any recorded topic filter must fit in a SUBSCRIBE of the staging buffer. */
+    else if( ( pStagingBuffer->pBuffer == NULL ) ||
+             ( pStagingBuffer->size < ( MQTT_SUBSCRIBE_HEADER_MAX_SIZE_V5 +
+                                        CORE_MQTT_SERIALIZED_LENGTH_FIELD_BYTES +
+                                        MQTT_SUBSCRIPTION_REGISTRY_MAX_FILTER_LENGTH + 1U ) ) )
     {
-        LogError( ( "Invalid parameter: clearFunction is NULL" ) );
+        LogError( ( "Staging buffer must hold at least %lu bytes: pBuffer=%p, size=%lu.",
+                    ( unsigned long ) ( MQTT_SUBSCRIBE_HEADER_MAX_SIZE_V5 +
+                                        CORE_MQTT_SERIALIZED_LENGTH_FIELD_BYTES +
+                                        MQTT_SUBSCRIPTION_REGISTRY_MAX_FILTER_LENGTH + 1U ),
+                    ( void * ) pStagingBuffer->pBuffer,
+                    ( unsigned long ) pStagingBuffer->size ) );
         status = MQTTBadParameter;
     }
     else
     {
-        pContext->storeFunction = storeFunction;
-        pContext->retrieveFunction = retrieveFunction;
-        pContext->clearFunction = clearFunction;
+        MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+
+        if( pContext->connectStatus != MQTTNotConnected )
+        {
+            LogError( ( "The subscription registry cannot be initialized while connected." ) );
+            status = MQTTBadParameter;
+        }
+        else
+        {
+            ( void ) memset( pSubscriptionRecords,
+                             0x00,
+                             subscriptionRecordCount * sizeof( MQTTSubscriptionRecord_t ) );
+
+            pContext->pSubscriptionRecords = pSubscriptionRecords;
+            pContext->subscriptionRecordMaxCount = subscriptionRecordCount;
+            pContext->subscriptionStagingBuffer = *pStagingBuffer;
+        }
+
+        MQTT_POST_STATE_UPDATE_HOOK( pContext );
     }
 
     return status;
@@ -2842,29 +7028,42 @@ MQTTStatus_t MQTT_InitRetransmits( MQTTContext_t * pContext,
 
 /*-----------------------------------------------------------*/
 
-MQTTStatus_t MQTT_CancelCallback( const MQTTContext_t * pContext,
-                                  uint16_t packetId )
+MQTTStatus_t MQTT_InitCompletionTokens( MQTTContext_t * pContext,
+                                        MQTTCompletionToken_t * pCompletionTokens,
+                                        size_t completionTokenCount )
 {
     MQTTStatus_t status = MQTTSuccess;
 
-    if( pContext == NULL )
+    if( ( pContext == NULL ) || ( pCompletionTokens == NULL ) )
     {
-        LogWarn( ( "pContext is NULL\n" ) );
+        LogError( ( "Argument cannot be NULL: pContext=%p, pCompletionTokens=%p",
+                    ( void * ) pContext,
+                    ( void * ) pCompletionTokens ) );
         status = MQTTBadParameter;
     }
-    else if( pContext->outgoingPublishRecords == NULL )
+    else if( completionTokenCount == 0U )
     {
-        LogError( ( "QoS1/QoS2 is not initialized for use. Please, "
-                    "call MQTT_InitStatefulQoS to enable QoS1 and QoS2 "
-                    "publishes.\n" ) );
+        LogError( ( "Completion token count is 0." ) );
         status = MQTTBadParameter;
     }
     else
     {
         MQTT_PRE_STATE_UPDATE_HOOK( pContext );
 
-        status = MQTT_RemoveStateRecord( pContext,
-                                         packetId );
+        if( pContext->connectStatus != MQTTNotConnected )
+        {
+            LogError( ( "Completion tokens cannot be initialized while connected." ) );
+            status = MQTTBadParameter;
+        }
+        else
+        {
+            ( void ) memset( pCompletionTokens,
+                             0x00,
+                             completionTokenCount * sizeof( MQTTCompletionToken_t ) );
+
+            pContext->pCompletionTokens = pCompletionTokens;
+            pContext->completionTokenMaxCount = completionTokenCount;
+        }
 
         MQTT_POST_STATE_UPDATE_HOOK( pContext );
     }
@@ -2874,6 +7073,130 @@ MQTTStatus_t MQTT_CancelCallback( const MQTTContext_t * pContext,
 
 /*-----------------------------------------------------------*/
 
+#if ( MQTT_QOS0_ONLY == 0 )
+
+    MQTTStatus_t MQTT_InitRecordSlab( MQTTRecordSlab_t * pRecordSlab,
+                                      MQTTPubAckInfo_t * pRecords,
+                                      size_t recordsPerChunk,
+                                      uint32_t * pFreeChunks,
+                                      size_t chunkCount )
+    {
+        MQTTStatus_t status = MQTTSuccess;
+        size_t wordIndex, wordCount;
+
+        if( ( pRecordSlab == NULL ) || ( pRecords == NULL ) || ( pFreeChunks == NULL ) )
+        {
+            LogError( ( "Argument cannot be NULL: pRecordSlab=%p, pRecords=%p, "
+                        "pFreeChunks=%p.",
+                        ( void * ) pRecordSlab,
+                        ( void * ) pRecords,
+                        ( void * ) pFreeChunks ) );
+            status = MQTTBadParameter;
+        }
+        else if( ( recordsPerChunk == 0U ) || ( chunkCount == 0U ) )
+        {
+            LogError( ( "Records per chunk and chunk count must be non-zero: "
+                        "recordsPerChunk=%lu, chunkCount=%lu.",
+                        ( unsigned long ) recordsPerChunk,
+                        ( unsigned long ) chunkCount ) );
+            status = MQTTBadParameter;
+        }
+        else
+        {
+            wordCount = MQTT_RECORD_SLAB_BITMAP_WORDS( chunkCount );
+
+            /* Mark all chunks as free, leaving the bits past the last chunk clear. */
+            for( wordIndex = 0U; wordIndex < wordCount; wordIndex++ )
+            {
+                pFreeChunks[ wordIndex ] = UINT32_MAX;
+            }
+
+            if( ( chunkCount % 32U ) != 0U )
+            {
+                pFreeChunks[ wordCount - 1U ] = ( ( uint32_t ) 1U << ( chunkCount % 32U ) ) - 1U;
+            }
+
+            pRecordSlab->pRecords = pRecords;
+            pRecordSlab->pFreeChunks = pFreeChunks;
+            pRecordSlab->recordsPerChunk = recordsPerChunk;
+            pRecordSlab->chunkCount = chunkCount;
+        }
+
+        return status;
+    }
+
+#endif /* if ( MQTT_QOS0_ONLY == 0 ) */
+
+/*-----------------------------------------------------------*/
+
+#if ( MQTT_QOS0_ONLY == 0 )
+
+    MQTTStatus_t MQTT_SetRecordSlab( MQTTContext_t * pContext,
+                                     MQTTRecordSlab_t * pRecordSlab )
+    {
+        MQTTStatus_t status = MQTTSuccess;
+
+        if( pContext == NULL )
+        {
+            LogError( ( "Argument cannot be NULL: pContext=%p.",
+                        ( void * ) pContext ) );
+            status = MQTTBadParameter;
+        }
+        else if( ( pContext->outgoingPublishRecords != NULL ) ||
+                 ( pContext->incomingPublishRecords != NULL ) )
+        {
+            LogError( ( "The context has state records of its own, or still holds "
+                        "a chunk of the slab." ) );
+            status = MQTTBadParameter;
+        }
+        else
+        {
+            pContext->pRecordSlab = pRecordSlab;
+        }
+
+        return status;
+    }
+
+#endif /* if ( MQTT_QOS0_ONLY == 0 ) */
+
+/*-----------------------------------------------------------*/
+
+#if ( MQTT_QOS0_ONLY == 0 )
+
+    MQTTStatus_t MQTT_CancelCallback( const MQTTContext_t * pContext,
+                                      uint16_t packetId )
+    {
+        MQTTStatus_t status = MQTTSuccess;
+
+        if( pContext == NULL )
+        {
+            LogWarn( ( "pContext is NULL\n" ) );
+            status = MQTTBadParameter;
+        }
+        else if( pContext->outgoingPublishRecords == NULL )
+        {
+            LogError( ( "QoS1/QoS2 is not initialized for use. Please, "
+                        "call MQTT_InitStatefulQoS to enable QoS1 and QoS2 "
+                        "publishes.\n" ) );
+            status = MQTTBadParameter;
+        }
+        else
+        {
+            MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+
+            status = MQTT_RemoveStateRecord( pContext,
+                                             packetId );
+
+            MQTT_POST_STATE_UPDATE_HOOK( pContext );
+        }
+
+        return status;
+    }
+
+#endif /* if ( MQTT_QOS0_ONLY == 0 ) */
+
+/*-----------------------------------------------------------*/
+
 MQTTStatus_t MQTT_CheckConnectStatus( const MQTTContext_t * pContext )
 {
     MQTTConnectionStatus_t connectStatus;
@@ -2925,6 +7248,7 @@ MQTTStatus_t MQTT_Connect( MQTTContext_t * pContext,
     MQTTStatus_t status = MQTTSuccess;
     MQTTPacketInfo_t incomingPacket = { 0 };
     MQTTConnectionStatus_t connectStatus;
+    MQTTConnackProperties_t connackProperties = { 0 };
 
     incomingPacket.type = ( uint8_t ) 0;
 
@@ -2938,13 +7262,24 @@ MQTTStatus_t MQTT_Connect( MQTTContext_t * pContext,
         status = MQTTBadParameter;
     }
 
-    if( status == MQTTSuccess )
-    {
-        /* Get MQTT connect packet size and remaining length. */
-        status = MQTT_GetConnectPacketSize( pConnectInfo,
-                                            pWillInfo,
-                                            &remainingLength,
-                                            &packetSize );
+    if( status == MQTTSuccess )
+    {
+        /* Get MQTT connect packet size and remaining length. */
+        if( pContext->protocolVersion == MQTT_VERSION_5 )
+        {
+            status = MQTT_GetConnectPacketSizeV5( pConnectInfo,
+                                                  pWillInfo,
+                                                  &remainingLength,
+                                                  &packetSize );
+        }
+        else
+        {
+            status = MQTT_GetConnectPacketSize( pConnectInfo,
+                                                pWillInfo,
+                                                &remainingLength,
+                                                &packetSize );
+        }
+
         /* coverity[sensitive_data_leak] */
         LogDebug( ( "CONNECT packet size is %lu and remaining length is %lu.",
                     ( unsigned long ) packetSize,
@@ -2953,6 +7288,11 @@ MQTTStatus_t MQTT_Connect( MQTTContext_t * pContext,
 
     if( status == MQTTSuccess )
     {
+        /* The send hook is held from the status check until the connection
+         * status is updated from the CONNACK, so a concurrent MQTT_Connect
+         * neither sends a second CONNECT nor reads this CONNACK. */
+        MQTT_PRE_SEND_HOOK( pContext );
+
         MQTT_PRE_STATE_UPDATE_HOOK( pContext );
 
         connectStatus = pContext->connectStatus;
@@ -2962,6 +7302,14 @@ MQTTStatus_t MQTT_Connect( MQTTContext_t * pContext,
             status = ( connectStatus == MQTTConnected ) ? MQTTStatusConnected : MQTTStatusDisconnectPending;
         }
 
+        /* A buffer for the CONNACK is needed before sending CONNECT. */
+        if( status == MQTTSuccess )
+        {
+            status = borrowNetworkBuffer( pContext );
+        }
+
+        MQTT_POST_STATE_UPDATE_HOOK( pContext );
+
         if( status == MQTTSuccess )
         {
             status = sendConnectWithoutCopy( pContext,
@@ -2970,16 +7318,20 @@ MQTTStatus_t MQTT_Connect( MQTTContext_t * pContext,
                                              remainingLength );
         }
 
-        /* Read CONNACK from transport layer. */
+        /* Read CONNACK from transport layer. The state update hook is not held
+         * while waiting, as a failed receive takes it to update the status. */
         if( status == MQTTSuccess )
         {
             status = receiveConnack( pContext,
                                      timeoutMs,
                                      pConnectInfo->cleanSession,
                                      &incomingPacket,
-                                     pSessionPresent );
+                                     pSessionPresent,
+                                     &connackProperties );
         }
 
+        MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+
         if( ( status == MQTTSuccess ) && ( *pSessionPresent != true ) )
         {
             status = handleCleanSession( pContext );
@@ -2992,15 +7344,41 @@ MQTTStatus_t MQTT_Connect( MQTTContext_t * pContext,
             pContext->keepAliveIntervalSec = pConnectInfo->keepAliveSeconds;
             pContext->waitingForPingResp = false;
             pContext->pingReqSendTimeMs = 0U;
+
+            /* An MQTT 5 broker may override the keep-alive interval. */
+            if( connackProperties.serverKeepAlivePresent == true )
+            {
+                pContext->keepAliveIntervalSec = connackProperties.serverKeepAlive;
+            }
+
+            resetTopicAliases( pContext, connackProperties.topicAliasMaximum );
         }
 
+        /* The CONNACK has been processed, so the buffer is no longer needed. */
+        releaseNetworkBuffer( pContext );
+
         MQTT_POST_STATE_UPDATE_HOOK( pContext );
+
+        MQTT_POST_SEND_HOOK( pContext );
+    }
+
+    #if ( MQTT_QOS0_ONLY == 0 )
+        if( ( status == MQTTSuccess ) && ( *pSessionPresent == true ) )
+        {
+            /* Resend PUBRELs and PUBLISHES when reestablishing a session */
+            status = handleUncleanSessionResumption( pContext );
+        }
+    #endif
+
+    if( ( status == MQTTSuccess ) && ( pContext->pCompletionTokens != NULL ) )
+    {
+        abandonOperations( pContext, *pSessionPresent );
     }
 
-    if( ( status == MQTTSuccess ) && ( *pSessionPresent == true ) )
+    if( ( status == MQTTSuccess ) && ( *pSessionPresent != true ) )
     {
-        /* Resend PUBRELs and PUBLISHES when reestablishing a session */
-        status = handleUncleanSessionResumption( pContext );
+        /* The broker has no subscriptions in a new session. */
+        status = resubscribeFromRegistry( pContext );
     }
 
     if( status == MQTTSuccess )
@@ -3047,6 +7425,21 @@ MQTTStatus_t MQTT_Subscribe( MQTTContext_t * pContext,
                              const MQTTSubscribeInfo_t * pSubscriptionList,
                              size_t subscriptionCount,
                              uint16_t packetId )
+{
+    return MQTT_SubscribeWithId( pContext,
+                                 pSubscriptionList,
+                                 subscriptionCount,
+                                 packetId,
+                                 0U );
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_SubscribeWithId( MQTTContext_t * pContext,
+                                   const MQTTSubscribeInfo_t * pSubscriptionList,
+                                   size_t subscriptionCount,
+                                   uint16_t packetId,
+                                   uint32_t subscriptionId )
 {
     MQTTConnectionStatus_t connectStatus;
     size_t remainingLength = 0UL, packetSize = 0UL;
@@ -3057,13 +7450,33 @@ MQTTStatus_t MQTT_Subscribe( MQTTContext_t * pContext,
                                                               subscriptionCount,
                                                               packetId );
 
+    if( ( status == MQTTSuccess ) &&
+        ( subscriptionId != 0U ) &&
+        ( pContext->protocolVersion != MQTT_VERSION_5 ) )
+    {
+        LogError( ( "Subscription Identifiers require MQTT 5. Call MQTT_SetProtocolVersion first." ) );
+        status = MQTTBadParameter;
+    }
+
     if( status == MQTTSuccess )
     {
         /* Get the remaining length and packet size.*/
-        status = MQTT_GetSubscribePacketSize( pSubscriptionList,
-                                              subscriptionCount,
-                                              &remainingLength,
-                                              &packetSize );
+        if( pContext->protocolVersion == MQTT_VERSION_5 )
+        {
+            status = MQTT_GetSubscribePacketSizeV5( pSubscriptionList,
+                                                    subscriptionCount,
+                                                    subscriptionId,
+                                                    &remainingLength,
+                                                    &packetSize );
+        }
+        else
+        {
+            status = MQTT_GetSubscribePacketSize( pSubscriptionList,
+                                                  subscriptionCount,
+                                                  &remainingLength,
+                                                  &packetSize );
+        }
+
         LogDebug( ( "SUBSCRIBE packet size is %lu and remaining length is %lu.",
                     ( unsigned long ) packetSize,
                     ( unsigned long ) remainingLength ) );
@@ -3071,9 +7484,11 @@ MQTTStatus_t MQTT_Subscribe( MQTTContext_t * pContext,
 
     if( status == MQTTSuccess )
     {
-        MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+        MQTT_PRE_SEND_HOOK( pContext );
 
+        MQTT_PRE_STATE_UPDATE_HOOK( pContext );
         connectStatus = pContext->connectStatus;
+        MQTT_POST_STATE_UPDATE_HOOK( pContext );
 
         if( connectStatus != MQTTConnected )
         {
@@ -3082,15 +7497,90 @@ MQTTStatus_t MQTT_Subscribe( MQTTContext_t * pContext,
 
         if( status == MQTTSuccess )
         {
+            /* The topic filters are recorded first, as the SUBACK may be
+             * received by another thread as soon as the packet is sent. */
+            recordSubscriptions( pContext, pSubscriptionList, subscriptionCount, packetId, subscriptionId );
+
             /* Send MQTT SUBSCRIBE packet. */
             status = sendSubscribeWithoutCopy( pContext,
                                                pSubscriptionList,
                                                subscriptionCount,
                                                packetId,
-                                               remainingLength );
+                                               remainingLength,
+                                               subscriptionId );
+
+            if( status != MQTTSuccess )
+            {
+                completeSubscriptions( pContext, packetId, NULL, 0U );
+            }
         }
 
-        MQTT_POST_STATE_UPDATE_HOOK( pContext );
+        MQTT_POST_SEND_HOOK( pContext );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_SubscribeBulk( MQTTContext_t * pContext,
+                                 const MQTTSubscribeInfo_t * pSubscriptionList,
+                                 size_t subscriptionCount,
+                                 const MQTTFixedBuffer_t * pStagingBuffer,
+                                 uint16_t * pPacketIds,
+                                 size_t * pPacketIdCount )
+{
+    return sendBulkSubscribeUnsubscribe( pContext,
+                                         pSubscriptionList,
+                                         subscriptionCount,
+                                         pStagingBuffer,
+                                         pPacketIds,
+                                         pPacketIdCount,
+                                         true );
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_SubscribeWithCompletion( MQTTContext_t * pContext,
+                                           const MQTTSubscribeInfo_t * pSubscriptionList,
+                                           size_t subscriptionCount,
+                                           uint16_t packetId,
+                                           MQTTCompletionCallback_t callback,
+                                           void * pUserData )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTCompletionToken_t token;
+
+    if( pContext == NULL )
+    {
+        LogError( ( "Argument cannot be NULL: pContext=%p.",
+                    ( void * ) pContext ) );
+        status = MQTTBadParameter;
+    }
+    else if( callback == NULL )
+    {
+        LogError( ( "Invalid parameter: callback is NULL." ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        /* The token is taken first, as the SUBACK may be received by another
+         * thread as soon as the packet is sent. */
+        status = reserveCompletionToken( pContext,
+                                         packetId,
+                                         MQTT_PACKET_TYPE_SUBACK,
+                                         callback,
+                                         pUserData );
+    }
+
+    if( status == MQTTSuccess )
+    {
+        status = MQTT_Subscribe( pContext, pSubscriptionList, subscriptionCount, packetId );
+
+        if( status != MQTTSuccess )
+        {
+            ( void ) releaseCompletionToken( pContext, packetId, MQTT_PACKET_TYPE_SUBACK, &token );
+        }
     }
 
     return status;
@@ -3105,9 +7595,12 @@ MQTTStatus_t MQTT_Publish( MQTTContext_t * pContext,
     size_t headerSize = 0UL;
     size_t remainingLength = 0UL;
     size_t packetSize = 0UL;
-    MQTTPublishState_t publishStatus = MQTTStateNull;
     MQTTConnectionStatus_t connectStatus;
 
+    #if ( MQTT_QOS0_ONLY == 0 )
+        MQTTPublishState_t publishStatus = MQTTStateNull;
+    #endif
+
     /* Maximum number of bytes required by the 'fixed' part of the PUBLISH
      * packet header according to the MQTT specifications.
      * Header byte           0 + 1 = 1
@@ -3124,26 +7617,42 @@ MQTTStatus_t MQTT_Publish( MQTTContext_t * pContext,
     /* Validate arguments. */
     MQTTStatus_t status = validatePublishParams( pContext, pPublishInfo, packetId );
 
-    if( status == MQTTSuccess )
+    if( ( status == MQTTSuccess ) && ( pContext->protocolVersion == MQTT_VERSION_5 ) )
+    {
+        /* Validate the packet now. It is serialized while holding the send
+         * hook, as its topic alias depends on the publishes sent before it. */
+        status = MQTT_GetPublishPacketSizeV5( pPublishInfo,
+                                              0U,
+                                              &remainingLength,
+                                              &packetSize );
+    }
+    else if( status == MQTTSuccess )
     {
         /* Get the remaining length and packet size.*/
         status = MQTT_GetPublishPacketSize( pPublishInfo,
                                             &remainingLength,
                                             &packetSize );
-    }
 
-    if( status == MQTTSuccess )
+        if( status == MQTTSuccess )
+        {
+            status = MQTT_SerializePublishHeaderWithoutTopic( pPublishInfo,
+                                                              remainingLength,
+                                                              mqttHeader,
+                                                              &headerSize );
+        }
+    }
+    else
     {
-        status = MQTT_SerializePublishHeaderWithoutTopic( pPublishInfo,
-                                                          remainingLength,
-                                                          mqttHeader,
-                                                          &headerSize );
+        /* MISRA else */
     }
 
     if( status == MQTTSuccess )
     {
-        /* Take the mutex as multiple send calls are required for sending this
-         * packet. */
+        /* Hold the send hook so that the packets of other calls are not
+         * written in between the multiple send calls of this packet, and so
+         * that publishes go out in the order their state was recorded. */
+        MQTT_PRE_SEND_HOOK( pContext );
+
         MQTT_PRE_STATE_UPDATE_HOOK( pContext );
 
         connectStatus = pContext->connectStatus;
@@ -3153,59 +7662,77 @@ MQTTStatus_t MQTT_Publish( MQTTContext_t * pContext,
             status = ( connectStatus == MQTTNotConnected ) ? MQTTStatusNotConnected : MQTTStatusDisconnectPending;
         }
 
-        if( ( status == MQTTSuccess ) && ( pPublishInfo->qos > MQTTQoS0 ) )
-        {
-            /* Set the flag so that the corresponding hook can be called later. */
+        #if ( MQTT_QOS0_ONLY == 0 )
+            if( ( status == MQTTSuccess ) && ( pPublishInfo->qos > MQTTQoS0 ) )
+            {
+                status = claimStateRecords( pContext, true );
+            }
+
+            if( ( status == MQTTSuccess ) && ( pPublishInfo->qos > MQTTQoS0 ) )
+            {
+                /* Set the flag so that the corresponding hook can be called later. */
 
-            status = MQTT_ReserveState( pContext,
-                                        packetId,
-                                        pPublishInfo->qos );
+                status = MQTT_ReserveState( pContext,
+                                            packetId,
+                                            pPublishInfo->qos );
+
+                /* State already exists for a duplicate packet.
+                 * If a state doesn't exist, it will be handled as a new publish in
+                 * state engine. */
+                if( ( status == MQTTStateCollision ) && ( pPublishInfo->dup == true ) )
+                {
+                    status = MQTTSuccess;
+                }
+            }
 
-            /* State already exists for a duplicate packet.
-             * If a state doesn't exist, it will be handled as a new publish in
-             * state engine. */
-            if( ( status == MQTTStateCollision ) && ( pPublishInfo->dup == true ) )
+            if( ( status == MQTTSuccess ) &&
+                ( pPublishInfo->qos > MQTTQoS0 ) )
             {
-                status = MQTTSuccess;
+                /* Update state machine before the PUBLISH is sent, as the state
+                 * update hook is not held while sending and the receive loop
+                 * may read the ack as soon as the packet is written. A publish
+                 * which then fails to send is resent on session resumption
+                 * like any other publish awaiting its ack.
+                 * Only to be done for QoS1 or QoS2. */
+                status = MQTT_UpdateStatePublish( pContext,
+                                                  packetId,
+                                                  MQTT_SEND,
+                                                  pPublishInfo->qos,
+                                                  &publishStatus );
+
+                if( status != MQTTSuccess )
+                {
+                    LogError( ( "Update state for publish failed with status %s.",
+                                MQTT_Status_strerror( status ) ) );
+                }
             }
-        }
 
-        if( status == MQTTSuccess )
+            /* Give back a chunk claimed above if the publish was not recorded. */
+            releaseStateRecords( pContext );
+        #endif /* if ( MQTT_QOS0_ONLY == 0 ) */
+
+        MQTT_POST_STATE_UPDATE_HOOK( pContext );
+
+        if( ( status == MQTTSuccess ) && ( pContext->protocolVersion == MQTT_VERSION_5 ) )
+        {
+            status = sendPublishV5( pContext, pPublishInfo, packetId );
+        }
+        else if( status == MQTTSuccess )
         {
             status = sendPublishWithoutCopy( pContext,
                                              pPublishInfo,
                                              mqttHeader,
                                              headerSize,
-                                             packetId );
+                                             packetId,
+                                             NULL,
+                                             0U );
         }
-
-        if( ( status == MQTTSuccess ) &&
-            ( pPublishInfo->qos > MQTTQoS0 ) )
+        else
         {
-            /* Update state machine after PUBLISH is sent.
-             * Only to be done for QoS1 or QoS2. */
-            status = MQTT_UpdateStatePublish( pContext,
-                                              packetId,
-                                              MQTT_SEND,
-                                              pPublishInfo->qos,
-                                              &publishStatus );
-
-            if( status != MQTTSuccess )
-            {
-                LogError( ( "Update state for publish failed with status %s."
-                            " However PUBLISH packet was sent to the broker."
-                            " Any further handling of ACKs for the packet Id"
-                            " will fail.",
-                            MQTT_Status_strerror( status ) ) );
-            }
+            /* MISRA else */
         }
 
-        /* mutex should be released and not before updating the state
-         * because we need to make sure that the state is updated
-         * after sending the publish packet, before the receive
-         * loop receives ack for this and would want to update its state
-         */
-        MQTT_POST_STATE_UPDATE_HOOK( pContext );
+        MQTT_POST_SEND_HOOK( pContext );
     }
 
     if( status != MQTTSuccess )
@@ -3219,6 +7746,63 @@ MQTTStatus_t MQTT_Publish( MQTTContext_t * pContext,
 
 /*-----------------------------------------------------------*/
 
+MQTTStatus_t MQTT_PublishWithCompletion( MQTTContext_t * pContext,
+                                         const MQTTPublishInfo_t * pPublishInfo,
+                                         uint16_t packetId,
+                                         MQTTCompletionCallback_t callback,
+                                         void * pUserData )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTCompletionToken_t token;
+    uint8_t ackType;
+
+    if( ( pContext == NULL ) || ( pPublishInfo == NULL ) )
+    {
+        LogError( ( "Argument cannot be NULL: pContext=%p, "
+                    "pPublishInfo=%p.",
+                    ( void * ) pContext,
+                    ( const void * ) pPublishInfo ) );
+        status = MQTTBadParameter;
+    }
+    else if( callback == NULL )
+    {
+        LogError( ( "Invalid parameter: callback is NULL." ) );
+        status = MQTTBadParameter;
+    }
+    else if( pPublishInfo->qos == MQTTQoS0 )
+    {
+        /* A QoS0 publish is complete once it is sent. */
+        status = MQTT_Publish( pContext, pPublishInfo, packetId );
+
+        if( status == MQTTSuccess )
+        {
+            callback( pContext, packetId, MQTTSuccess, NULL, pUserData );
+        }
+    }
+    else
+    {
+        ackType = ( pPublishInfo->qos == MQTTQoS1 ) ? MQTT_PACKET_TYPE_PUBACK : MQTT_PACKET_TYPE_PUBCOMP;
+
+        /* The token is taken first, as the acknowledgement may be received by
+         * another thread as soon as the packet is sent. */
+        status = reserveCompletionToken( pContext, packetId, ackType, callback, pUserData );
+
+        if( status == MQTTSuccess )
+        {
+            status = MQTT_Publish( pContext, pPublishInfo, packetId );
+
+            if( status != MQTTSuccess )
+            {
+                ( void ) releaseCompletionToken( pContext, packetId, ackType, &token );
+            }
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
 MQTTStatus_t MQTT_Ping( MQTTContext_t * pContext )
 {
     int32_t sendResult = 0;
@@ -3263,8 +7847,7 @@ MQTTStatus_t MQTT_Ping( MQTTContext_t * pContext )
 
     if( status == MQTTSuccess )
     {
-        /* Take the mutex as the send call should not be interrupted in
-         * between. */
+        MQTT_PRE_SEND_HOOK( pContext );
 
         MQTT_PRE_STATE_UPDATE_HOOK( pContext );
 
@@ -3274,6 +7857,15 @@ MQTTStatus_t MQTT_Ping( MQTTContext_t * pContext )
         {
             status = ( connectStatus == MQTTNotConnected ) ? MQTTStatusNotConnected : MQTTStatusDisconnectPending;
         }
+        else
+        {
+            /* Wait for the PINGRESP before it can be received by another
+             * thread, since the state update hook is not held while sending. */
+            pContext->pingReqSendTimeMs = pContext->getTime();
+            pContext->waitingForPingResp = true;
+        }
+
+        MQTT_POST_STATE_UPDATE_HOOK( pContext );
 
         if( status == MQTTSuccess )
         {
@@ -3290,17 +7882,23 @@ MQTTStatus_t MQTT_Ping( MQTTContext_t * pContext )
             {
                 LogError( ( "Transport send failed for PINGREQ packet." ) );
                 status = MQTTSendFailed;
+
+                MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+                pContext->waitingForPingResp = false;
+                MQTT_POST_STATE_UPDATE_HOOK( pContext );
             }
             else
             {
+                MQTT_PRE_STATE_UPDATE_HOOK( pContext );
                 pContext->pingReqSendTimeMs = pContext->lastPacketTxTime;
-                pContext->waitingForPingResp = true;
+                MQTT_POST_STATE_UPDATE_HOOK( pContext );
+
                 LogDebug( ( "Sent %ld bytes of PINGREQ packet.",
                             ( long int ) sendResult ) );
             }
         }
 
-        MQTT_POST_STATE_UPDATE_HOOK( pContext );
+        MQTT_POST_SEND_HOOK( pContext );
     }
 
     return status;
@@ -3325,10 +7923,21 @@ MQTTStatus_t MQTT_Unsubscribe( MQTTContext_t * pContext,
     if( status == MQTTSuccess )
     {
         /* Get the remaining length and packet size.*/
-        status = MQTT_GetUnsubscribePacketSize( pSubscriptionList,
-                                                subscriptionCount,
-                                                &remainingLength,
-                                                &packetSize );
+        if( pContext->protocolVersion == MQTT_VERSION_5 )
+        {
+            status = MQTT_GetUnsubscribePacketSizeV5( pSubscriptionList,
+                                                      subscriptionCount,
+                                                      &remainingLength,
+                                                      &packetSize );
+        }
+        else
+        {
+            status = MQTT_GetUnsubscribePacketSize( pSubscriptionList,
+                                                    subscriptionCount,
+                                                    &remainingLength,
+                                                    &packetSize );
+        }
+
         LogDebug( ( "UNSUBSCRIBE packet size is %lu and remaining length is %lu.",
                     ( unsigned long ) packetSize,
                     ( unsigned long ) remainingLength ) );
@@ -3336,10 +7945,11 @@ MQTTStatus_t MQTT_Unsubscribe( MQTTContext_t * pContext,
 
     if( status == MQTTSuccess )
     {
-        /* Take the mutex because the below call should not be interrupted. */
-        MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+        MQTT_PRE_SEND_HOOK( pContext );
 
+        MQTT_PRE_STATE_UPDATE_HOOK( pContext );
         connectStatus = pContext->connectStatus;
+        MQTT_POST_STATE_UPDATE_HOOK( pContext );
 
         if( connectStatus != MQTTConnected )
         {
@@ -3348,6 +7958,8 @@ MQTTStatus_t MQTT_Unsubscribe( MQTTContext_t * pContext,
 
         if( status == MQTTSuccess )
         {
+            removeSubscriptions( pContext, pSubscriptionList, subscriptionCount );
+
             status = sendUnsubscribeWithoutCopy( pContext,
                                                  pSubscriptionList,
                                                  subscriptionCount,
@@ -3355,7 +7967,7 @@ MQTTStatus_t MQTT_Unsubscribe( MQTTContext_t * pContext,
                                                  remainingLength );
         }
 
-        MQTT_POST_STATE_UPDATE_HOOK( pContext );
+        MQTT_POST_SEND_HOOK( pContext );
     }
 
     return status;
@@ -3363,6 +7975,24 @@ MQTTStatus_t MQTT_Unsubscribe( MQTTContext_t * pContext,
 
 /*-----------------------------------------------------------*/
 
+MQTTStatus_t MQTT_UnsubscribeBulk( MQTTContext_t * pContext,
+                                   const MQTTSubscribeInfo_t * pSubscriptionList,
+                                   size_t subscriptionCount,
+                                   const MQTTFixedBuffer_t * pStagingBuffer,
+                                   uint16_t * pPacketIds,
+                                   size_t * pPacketIdCount )
+{
+    return sendBulkSubscribeUnsubscribe( pContext,
+                                         pSubscriptionList,
+                                         subscriptionCount,
+                                         pStagingBuffer,
+                                         pPacketIds,
+                                         pPacketIdCount,
+                                         false );
+}
+
+/*-----------------------------------------------------------*/
+
 MQTTStatus_t MQTT_Disconnect( MQTTContext_t * pContext )
 {
     size_t packetSize = 0U;
@@ -3398,7 +8028,10 @@ MQTTStatus_t MQTT_Disconnect( MQTTContext_t * pContext )
 
     if( status == MQTTSuccess )
     {
-        /* Take the mutex because the below call should not be interrupted. */
+        /* The send hook is taken first, so that a packet of another call
+         * which already checked the connection is not sent after DISCONNECT. */
+        MQTT_PRE_SEND_HOOK( pContext );
+
         MQTT_PRE_STATE_UPDATE_HOOK( pContext );
 
         connectStatus = pContext->connectStatus;
@@ -3415,8 +8048,19 @@ MQTTStatus_t MQTT_Disconnect( MQTTContext_t * pContext )
 
             /* Reset the index and clean the buffer on a successful disconnect. */
             pContext->index = 0;
-            ( void ) memset( pContext->networkBuffer.pBuffer, 0, pContext->networkBuffer.size );
 
+            if( pContext->networkBuffer.pBuffer != NULL )
+            {
+                ( void ) memset( pContext->networkBuffer.pBuffer, 0, pContext->networkBuffer.size );
+            }
+
+            releaseNetworkBuffer( pContext );
+        }
+
+        MQTT_POST_STATE_UPDATE_HOOK( pContext );
+
+        if( status == MQTTSuccess )
+        {
             LogError( ( "MQTT Connection Disconnected Successfully" ) );
 
             /* Here we do not use vectors as the disconnect packet has fixed fields
@@ -3438,7 +8082,7 @@ MQTTStatus_t MQTT_Disconnect( MQTTContext_t * pContext )
             }
         }
 
-        MQTT_POST_STATE_UPDATE_HOOK( pContext );
+        MQTT_POST_SEND_HOOK( pContext );
     }
 
     return status;
@@ -3458,7 +8102,7 @@ MQTTStatus_t MQTT_ProcessLoop( MQTTContext_t * pContext )
     {
         LogError( ( "Invalid input parameter: MQTT Context must have valid getTime." ) );
     }
-    else if( pContext->networkBuffer.pBuffer == NULL )
+    else if( ( pContext->networkBuffer.pBuffer == NULL ) && ( pContext->pBufferPool == NULL ) )
     {
         LogError( ( "Invalid input parameter: The MQTT context's networkBuffer must not be NULL." ) );
     }
@@ -3485,7 +8129,7 @@ MQTTStatus_t MQTT_ReceiveLoop( MQTTContext_t * pContext )
     {
         LogError( ( "Invalid input parameter: MQTT Context must have a valid getTime function." ) );
     }
-    else if( pContext->networkBuffer.pBuffer == NULL )
+    else if( ( pContext->networkBuffer.pBuffer == NULL ) && ( pContext->pBufferPool == NULL ) )
     {
         LogError( ( "Invalid input parameter: MQTT context's networkBuffer must not be NULL." ) );
     }
@@ -3535,8 +8179,6 @@ MQTTStatus_t MQTT_MatchTopic( const char * pTopicName,
                               bool * pIsMatch )
 {
     MQTTStatus_t status = MQTTSuccess;
-    bool topicFilterStartsWithWildcard = false;
-    bool matchStatus = false;
 
     if( ( pTopicName == NULL ) || ( topicNameLength == 0u ) )
     {
@@ -3562,34 +8204,109 @@ MQTTStatus_t MQTT_MatchTopic( const char * pTopicName,
     }
     else
     {
-        /* Check for an exact match if the incoming topic name and the registered
-         * topic filter length match. */
-        if( topicNameLength == topicFilterLength )
-        {
-            matchStatus = strncmp( pTopicName, pTopicFilter, topicNameLength ) == 0;
-        }
+        *pIsMatch = matchTopic( pTopicName,
+                                topicNameLength,
+                                pTopicFilter,
+                                topicFilterLength,
+                                NULL,
+                                0U );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_ValidateTopic( const char * pTopic,
+                                 uint16_t topicLength,
+                                 bool isTopicFilter,
+                                 uint16_t * pLevelOffsets,
+                                 size_t * pLevelCount )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    size_t levelCount = 0U, maxLevelCount = 0U;
+    uint16_t invalidIndex = 0U;
 
-        if( matchStatus == false )
+    if( ( pTopic == NULL ) || ( topicLength == 0U ) )
+    {
+        LogError( ( "Invalid parameter: Topic should be non-NULL and its "
+                    "length should be > 0: Topic=%p, TopicLength=%hu",
+                    ( const void * ) pTopic,
+                    ( unsigned short ) topicLength ) );
+        status = MQTTBadParameter;
+    }
+    else if( ( pLevelOffsets != NULL ) && ( pLevelCount == NULL ) )
+    {
+        LogError( ( "Invalid parameter: pLevelCount must be non-NULL to "
+                    "store level separator offsets." ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        /* Without an array for the offsets, the level separators are only
+         * counted. */
+        if( pLevelOffsets != NULL )
         {
-            /* If an exact match was not found, match against wildcard characters in
-             * topic filter.*/
+            maxLevelCount = *pLevelCount;
+        }
 
-            /* Determine if topic filter starts with a wildcard. */
-            topicFilterStartsWithWildcard = ( pTopicFilter[ 0 ] == '+' ) ||
-                                            ( pTopicFilter[ 0 ] == '#' );
+        status = scanTopic( pTopic,
+                            topicLength,
+                            isTopicFilter,
+                            pLevelOffsets,
+                            maxLevelCount,
+                            &levelCount,
+                            &invalidIndex );
 
-            /* Note: According to the MQTT 3.1.1 specification, incoming PUBLISH topic names
-             * starting with "$" character cannot be matched against topic filter starting with
-             * a wildcard, i.e. for example, "$SYS/sport" cannot be matched with "#" or
-             * "+/sport" topic filters. */
-            if( !( ( pTopicName[ 0 ] == '$' ) && ( topicFilterStartsWithWildcard == true ) ) )
+        if( status == MQTTBadParameter )
+        {
+            if( ( ( uint8_t ) pTopic[ invalidIndex ] ) >= 0x80U )
+            {
+                LogError( ( "Topic contains an ill-formed UTF-8 sequence at "
+                            "offset %hu.",
+                            ( unsigned short ) invalidIndex ) );
+            }
+            else if( pTopic[ invalidIndex ] == '\0' )
+            {
+                LogError( ( "Topic contains a NUL character at offset %hu.",
+                            ( unsigned short ) invalidIndex ) );
+            }
+            else if( isTopicFilter == false )
             {
-                matchStatus = matchTopicFilter( pTopicName, topicNameLength, pTopicFilter, topicFilterLength );
+                LogError( ( "Topic name contains a wildcard character at "
+                            "offset %hu.",
+                            ( unsigned short ) invalidIndex ) );
+            }
+            else
+            {
+                LogError( ( "Topic filter contains a misplaced wildcard "
+                            "character at offset %hu.",
+                            ( unsigned short ) invalidIndex ) );
             }
         }
+        else
+        {
+            if( pLevelCount != NULL )
+            {
+                *pLevelCount = levelCount;
+            }
 
-        /* Update the output parameter with the match result. */
-        *pIsMatch = matchStatus;
+            if( pLevelOffsets == NULL )
+            {
+                status = MQTTSuccess;
+            }
+            else if( status == MQTTNoMemory )
+            {
+                LogError( ( "Topic has %lu level separators but only %lu offsets "
+                            "can be stored.",
+                            ( unsigned long ) levelCount,
+                            ( unsigned long ) maxLevelCount ) );
+            }
+            else
+            {
+                /* Empty else MISRA 15.7 */
+            }
+        }
     }
 
     return status;
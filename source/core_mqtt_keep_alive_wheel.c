@@ -0,0 +1,531 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file core_mqtt_keep_alive_wheel.c
+ * @brief Implements the hierarchical timing wheel of keep-alive deadlines.
+ */
+#include <string.h>
+#include <assert.h>
+
+#include "core_mqtt_keep_alive_wheel.h"
+
+/* Include config defaults header to get default values of configs. */
+#include "core_mqtt_config_defaults.h"
+
+/**
+ * @brief Mask of the slot index within a level.
+ */
+#define SLOT_MASK             ( ( uint32_t ) MQTT_KEEP_ALIVE_WHEEL_SLOTS - 1U )
+
+/**
+ * @brief Largest number of ticks between the next tick to process and a
+ * deadline held by the wheel.
+ */
+#define MAX_DEADLINE_TICKS    ( ( 1UL << ( MQTT_KEEP_ALIVE_WHEEL_SLOT_BITS * MQTT_KEEP_ALIVE_WHEEL_LEVELS ) ) - 1UL )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Link an entry into the slot of its expiry tick, in the lowest level
+ * covering the distance to the next tick to process.
+ *
+ * @param[in] pWheel The wheel.
+ * @param[in] pEntry The entry, not linked.
+ */
+static void linkEntry( MQTTKeepAliveWheel_t * pWheel,
+                       MQTTKeepAliveEntry_t * pEntry );
+
+/**
+ * @brief Unlink an entry from its slot.
+ *
+ * @param[in] pWheel The wheel.
+ * @param[in] pEntry The entry, linked.
+ */
+static void unlinkEntry( MQTTKeepAliveWheel_t * pWheel,
+                         MQTTKeepAliveEntry_t * pEntry );
+
+/**
+ * @brief Link an entry to be examined at the first tick starting at or after
+ * a deadline.
+ *
+ * @param[in] pWheel The wheel.
+ * @param[in] pEntry The entry, not linked.
+ * @param[in] deadlineMs The deadline.
+ */
+static void scheduleEntry( MQTTKeepAliveWheel_t * pWheel,
+                           MQTTKeepAliveEntry_t * pEntry,
+                           uint32_t deadlineMs );
+
+/**
+ * @brief Get the next keep-alive deadline of a context, as checked by
+ * #MQTT_ProcessLoop.
+ *
+ * @param[in] pContext The context.
+ * @param[out] pDeadlineMs The deadline of the PINGRESP if one is awaited, or
+ * else of the next PINGREQ.
+ *
+ * @return `true` if a deadline is set; `false` if the context has no
+ * keep-alive.
+ */
+static bool getDeadline( const MQTTContext_t * pContext,
+                         uint32_t * pDeadlineMs );
+
+/**
+ * @brief Handle an entry whose deadline was reached: send a PINGREQ if it is
+ * due, report a missing PINGRESP, or schedule the entry again.
+ *
+ * @param[in] pWheel The wheel.
+ * @param[in] pEntry The entry, not linked.
+ * @param[in] now The current time.
+ */
+static void handleExpiry( MQTTKeepAliveWheel_t * pWheel,
+                          MQTTKeepAliveEntry_t * pEntry,
+                          uint32_t now );
+
+/**
+ * @brief Move the entries of a slot of a higher level to the levels below.
+ *
+ * @param[in] pWheel The wheel.
+ * @param[in] level The level of the slot.
+ * @param[in] slot The slot.
+ *
+ * @return The slot, which is 0 when the level above must be cascaded too.
+ */
+static uint32_t cascade( MQTTKeepAliveWheel_t * pWheel,
+                         size_t level,
+                         uint32_t slot );
+
+/**
+ * @brief Process the next tick: cascade the higher levels when the lowest
+ * level wraps, then handle the entries of the tick.
+ *
+ * @param[in] pWheel The wheel.
+ * @param[in] now The current time.
+ */
+static void processTick( MQTTKeepAliveWheel_t * pWheel,
+                         uint32_t now );
+
+/*-----------------------------------------------------------*/
+
+static void linkEntry( MQTTKeepAliveWheel_t * pWheel,
+                       MQTTKeepAliveEntry_t * pEntry )
+{
+    uint32_t distance = pEntry->expiryTick - pWheel->nextTick;
+    size_t level = 0U;
+    MQTTKeepAliveEntry_t ** ppSlot;
+
+    /* A deadline already passed is handled by the next tick. */
+    if( distance > ( uint32_t ) INT32_MAX )
+    {
+        pEntry->expiryTick = pWheel->nextTick;
+        distance = 0U;
+    }
+    else if( distance > MAX_DEADLINE_TICKS )
+    {
+        pEntry->expiryTick = pWheel->nextTick + ( uint32_t ) MAX_DEADLINE_TICKS;
+        distance = ( uint32_t ) MAX_DEADLINE_TICKS;
+    }
+    else
+    {
+        /* MISRA else. */
+    }
+
+    while( ( level < ( MQTT_KEEP_ALIVE_WHEEL_LEVELS - 1U ) ) &&
+           ( distance >= ( 1UL << ( MQTT_KEEP_ALIVE_WHEEL_SLOT_BITS * ( level + 1U ) ) ) ) )
+    {
+        level++;
+    }
+
+    ppSlot = &pWheel->slots[ level ][ ( pEntry->expiryTick >> ( MQTT_KEEP_ALIVE_WHEEL_SLOT_BITS * level ) ) & SLOT_MASK ];
+
+    pEntry->pNext = *ppSlot;
+
+    if( pEntry->pNext != NULL )
+    {
+        pEntry->pNext->ppPrev = &pEntry->pNext;
+    }
+
+    pEntry->ppPrev = ppSlot;
+    *ppSlot = pEntry;
+    pWheel->entryCount++;
+}
+
+/*-----------------------------------------------------------*/
+
+static void unlinkEntry( MQTTKeepAliveWheel_t * pWheel,
+                         MQTTKeepAliveEntry_t * pEntry )
+{
+    assert( pEntry->ppPrev != NULL );
+
+    *pEntry->ppPrev = pEntry->pNext;
+
+    if( pEntry->pNext != NULL )
+    {
+        pEntry->pNext->ppPrev = pEntry->ppPrev;
+    }
+
+    pEntry->pNext = NULL;
+    pEntry->ppPrev = NULL;
+    pWheel->entryCount--;
+}
+
+/*-----------------------------------------------------------*/
+
+static void scheduleEntry( MQTTKeepAliveWheel_t * pWheel,
+                           MQTTKeepAliveEntry_t * pEntry,
+                           uint32_t deadlineMs )
+{
+    uint32_t sinceTickStart = deadlineMs - pWheel->tickStartMs;
+
+    if( sinceTickStart > ( uint32_t ) INT32_MAX )
+    {
+        /* The deadline is before the current tick. */
+        pEntry->expiryTick = pWheel->currentTick;
+    }
+    else
+    {
+        /* The first tick starting at or after the deadline. */
+        pEntry->expiryTick = pWheel->currentTick +
+                             ( ( sinceTickStart + MQTT_KEEP_ALIVE_WHEEL_TICK_MS - 1U ) / MQTT_KEEP_ALIVE_WHEEL_TICK_MS );
+    }
+
+    linkEntry( pWheel, pEntry );
+}
+
+/*-----------------------------------------------------------*/
+
+static bool getDeadline( const MQTTContext_t * pContext,
+                         uint32_t * pDeadlineMs )
+{
+    uint32_t txTimeoutMs = 1000U * ( uint32_t ) pContext->keepAliveIntervalSec;
+    uint32_t rxDeadlineMs;
+    bool hasDeadline = true;
+
+    if( PACKET_TX_TIMEOUT_MS < txTimeoutMs )
+    {
+        txTimeoutMs = PACKET_TX_TIMEOUT_MS;
+    }
+
+    if( pContext->waitingForPingResp == true )
+    {
+        /* #MQTT_ProcessLoop times out once more than the timeout elapsed. */
+        *pDeadlineMs = pContext->pingReqSendTimeMs + MQTT_PINGRESP_TIMEOUT_MS + 1U;
+    }
+    else if( txTimeoutMs == 0U )
+    {
+        hasDeadline = false;
+    }
+    else
+    {
+        *pDeadlineMs = pContext->lastPacketTxTime + txTimeoutMs;
+        rxDeadlineMs = pContext->lastPacketRxTime + PACKET_RX_TIMEOUT_MS;
+
+        /* A PINGREQ is also due when nothing was received for a while. */
+        if( ( rxDeadlineMs - *pDeadlineMs ) > ( uint32_t ) INT32_MAX )
+        {
+            *pDeadlineMs = rxDeadlineMs;
+        }
+    }
+
+    return hasDeadline;
+}
+
+/*-----------------------------------------------------------*/
+
+static void handleExpiry( MQTTKeepAliveWheel_t * pWheel,
+                          MQTTKeepAliveEntry_t * pEntry,
+                          uint32_t now )
+{
+    MQTTContext_t * pContext = pEntry->pContext;
+    MQTTStatus_t status = MQTTSuccess;
+    uint32_t deadlineMs = 0U;
+    bool hasDeadline;
+
+    pWheel->examinedCount++;
+
+    hasDeadline = getDeadline( pContext, &deadlineMs );
+
+    /* The deadline moved if packets were sent or received meanwhile. */
+    if( ( hasDeadline == true ) && ( ( now - deadlineMs ) <= ( uint32_t ) INT32_MAX ) )
+    {
+        if( pContext->waitingForPingResp == true )
+        {
+            status = MQTTKeepAliveTimeout;
+        }
+        else
+        {
+            status = MQTT_Ping( pContext );
+
+            if( status == MQTTSuccess )
+            {
+                pWheel->pingCount++;
+                hasDeadline = getDeadline( pContext, &deadlineMs );
+            }
+        }
+    }
+
+    if( status != MQTTSuccess )
+    {
+        LogError( ( "Keep-alive failed: Status=%s.",
+                    MQTT_Status_strerror( status ) ) );
+        pWheel->errorCallback( pWheel, pEntry, status );
+    }
+    else if( hasDeadline == true )
+    {
+        scheduleEntry( pWheel, pEntry, deadlineMs );
+    }
+    else
+    {
+        /* Keep-alive is disabled; the entry stays unscheduled. */
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static uint32_t cascade( MQTTKeepAliveWheel_t * pWheel,
+                         size_t level,
+                         uint32_t slot )
+{
+    MQTTKeepAliveEntry_t * pEntry = pWheel->slots[ level ][ slot ];
+    MQTTKeepAliveEntry_t * pNext;
+
+    pWheel->slots[ level ][ slot ] = NULL;
+
+    while( pEntry != NULL )
+    {
+        pNext = pEntry->pNext;
+        pWheel->entryCount--;
+        linkEntry( pWheel, pEntry );
+        pEntry = pNext;
+    }
+
+    return slot;
+}
+
+/*-----------------------------------------------------------*/
+
+static void processTick( MQTTKeepAliveWheel_t * pWheel,
+                         uint32_t now )
+{
+    uint32_t slot = pWheel->nextTick & SLOT_MASK;
+    size_t level = 1U;
+    MQTTKeepAliveEntry_t * pExpired;
+    MQTTKeepAliveEntry_t * pEntry;
+
+    /* Each time a level wraps, the next slot of the level above is spread
+     * over the levels below. */
+    if( slot == 0U )
+    {
+        while( ( level < MQTT_KEEP_ALIVE_WHEEL_LEVELS ) &&
+               ( cascade( pWheel, level,
+                          ( pWheel->nextTick >> ( MQTT_KEEP_ALIVE_WHEEL_SLOT_BITS * level ) ) & SLOT_MASK ) == 0U ) )
+        {
+            level++;
+        }
+    }
+
+    /* Entries scheduled while handling the tick are linked after it, so the
+     * expired entries are first moved to a list of their own. The error
+     * callback may still remove any of them. */
+    pWheel->nextTick++;
+    pExpired = pWheel->slots[ 0 ][ slot ];
+    pWheel->slots[ 0 ][ slot ] = NULL;
+
+    if( pExpired != NULL )
+    {
+        pExpired->ppPrev = &pExpired;
+    }
+
+    while( pExpired != NULL )
+    {
+        pEntry = pExpired;
+        unlinkEntry( pWheel, pEntry );
+        handleExpiry( pWheel, pEntry, now );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTTKeepAliveWheel_Init( MQTTKeepAliveWheel_t * pWheel,
+                                      MQTTGetCurrentTimeFunc_t getTimeFunction,
+                                      MQTTKeepAliveErrorCallback_t errorCallback )
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    if( ( pWheel == NULL ) || ( getTimeFunction == NULL ) || ( errorCallback == NULL ) )
+    {
+        LogError( ( "Argument cannot be NULL: pWheel=%p, getTimeFunction=%p, "
+                    "errorCallback=%p.",
+                    ( void * ) pWheel,
+                    ( void * ) getTimeFunction,
+                    ( void * ) errorCallback ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        ( void ) memset( pWheel, 0x00, sizeof( MQTTKeepAliveWheel_t ) );
+        pWheel->getTime = getTimeFunction;
+        pWheel->errorCallback = errorCallback;
+        pWheel->tickStartMs = getTimeFunction();
+        pWheel->nextTick = 1U;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTTKeepAliveWheel_Add( MQTTKeepAliveWheel_t * pWheel,
+                                     MQTTKeepAliveEntry_t * pEntry )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    uint32_t deadlineMs = 0U;
+
+    if( ( pWheel == NULL ) || ( pWheel->getTime == NULL ) ||
+        ( pEntry == NULL ) || ( pEntry->pContext == NULL ) )
+    {
+        LogError( ( "Argument cannot be NULL: pWheel=%p, pEntry=%p.",
+                    ( void * ) pWheel,
+                    ( void * ) pEntry ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        if( pEntry->ppPrev != NULL )
+        {
+            unlinkEntry( pWheel, pEntry );
+        }
+
+        if( getDeadline( pEntry->pContext, &deadlineMs ) == true )
+        {
+            scheduleEntry( pWheel, pEntry, deadlineMs );
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTTKeepAliveWheel_Remove( MQTTKeepAliveWheel_t * pWheel,
+                                        MQTTKeepAliveEntry_t * pEntry )
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    if( ( pWheel == NULL ) || ( pEntry == NULL ) )
+    {
+        LogError( ( "Argument cannot be NULL: pWheel=%p, pEntry=%p.",
+                    ( void * ) pWheel,
+                    ( void * ) pEntry ) );
+        status = MQTTBadParameter;
+    }
+    else if( pEntry->ppPrev != NULL )
+    {
+        unlinkEntry( pWheel, pEntry );
+    }
+    else
+    {
+        /* MISRA else. */
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTTKeepAliveWheel_Process( MQTTKeepAliveWheel_t * pWheel )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    uint32_t now;
+    uint32_t elapsedTicks;
+
+    if( ( pWheel == NULL ) || ( pWheel->getTime == NULL ) )
+    {
+        LogError( ( "Argument cannot be NULL: pWheel=%p.",
+                    ( void * ) pWheel ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        now = pWheel->getTime();
+        elapsedTicks = ( now - pWheel->tickStartMs ) / MQTT_KEEP_ALIVE_WHEEL_TICK_MS;
+        pWheel->tickStartMs += elapsedTicks * MQTT_KEEP_ALIVE_WHEEL_TICK_MS;
+        pWheel->currentTick += elapsedTicks;
+
+        /* Process every tick up to the current one. Entries which became due
+         * are handled now, even if their tick started a while ago. */
+        while( ( pWheel->currentTick - pWheel->nextTick ) <= ( uint32_t ) INT32_MAX )
+        {
+            processTick( pWheel, now );
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t MQTTKeepAliveWheel_GetNextTimeout( const MQTTKeepAliveWheel_t * pWheel )
+{
+    uint32_t timeoutMs = MQTT_KEEP_ALIVE_WHEEL_NO_TIMEOUT;
+    uint32_t tick;
+    uint32_t sinceTickStart;
+    bool found = false;
+
+    if( ( pWheel != NULL ) && ( pWheel->getTime != NULL ) && ( pWheel->entryCount > 0U ) )
+    {
+        tick = pWheel->nextTick;
+
+        /* Find the first tick with entries in the lowest level, or at which
+         * the lowest level wraps and entries of the level above move down. */
+        while( found == false )
+        {
+            if( ( pWheel->slots[ 0 ][ tick & SLOT_MASK ] != NULL ) ||
+                ( ( tick & SLOT_MASK ) == 0U ) )
+            {
+                found = true;
+            }
+            else
+            {
+                tick++;
+            }
+        }
+
+        sinceTickStart = pWheel->getTime() - pWheel->tickStartMs;
+
+        if( ( tick - pWheel->currentTick ) > ( uint32_t ) INT32_MAX )
+        {
+            /* The tick was reached already. */
+            timeoutMs = 0U;
+        }
+        else
+        {
+            timeoutMs = ( ( tick - pWheel->currentTick ) * MQTT_KEEP_ALIVE_WHEEL_TICK_MS );
+            timeoutMs = ( timeoutMs > sinceTickStart ) ? ( timeoutMs - sinceTickStart ) : 0U;
+        }
+    }
+
+    return timeoutMs;
+}
@@ -0,0 +1,300 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file core_mqtt_publish_queue.c
+ * @brief Implements the multi-producer, single-consumer publish queue.
+ */
+#include <string.h>
+#include <assert.h>
+
+#include "core_mqtt_publish_queue.h"
+
+/* Include config defaults header to get default values of configs. */
+#include "core_mqtt_config_defaults.h"
+
+#ifndef MQTT_PRE_PUBLISH_QUEUE_HOOK
+
+/**
+ * @brief Hook called just before the list of submitted requests of a publish
+ * queue is updated, unless #MQTT_PUBLISH_QUEUE_USE_ATOMICS is enabled.
+ */
+    #define MQTT_PRE_PUBLISH_QUEUE_HOOK( pQueue )
+#endif /* !MQTT_PRE_PUBLISH_QUEUE_HOOK */
+
+#ifndef MQTT_POST_PUBLISH_QUEUE_HOOK
+
+/**
+ * @brief Hook called just after the list of submitted requests of a publish
+ * queue has been updated, unless #MQTT_PUBLISH_QUEUE_USE_ATOMICS is enabled.
+ */
+    #define MQTT_POST_PUBLISH_QUEUE_HOOK( pQueue )
+#endif /* !MQTT_POST_PUBLISH_QUEUE_HOOK */
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Take every submitted request and append it, oldest first, to the
+ * pending requests of the owner thread.
+ *
+ * @param[in] pQueue The publish queue.
+ */
+static void takeSubmitted( MQTTPublishQueue_t * pQueue );
+
+/**
+ * @brief Send one request and report its result, unless it has to wait for a
+ * free state record.
+ *
+ * @param[in] pQueue The publish queue.
+ * @param[in] pRequest The oldest pending request.
+ *
+ * @return `true` if the request was completed; `false` if it stays pending.
+ */
+static bool sendRequest( MQTTPublishQueue_t * pQueue,
+                         MQTTPublishRequest_t * pRequest );
+
+/*-----------------------------------------------------------*/
+
+static void takeSubmitted( MQTTPublishQueue_t * pQueue )
+{
+    MQTTPublishRequest_t * pSubmitted = NULL;
+    MQTTPublishRequest_t * pOldest = NULL;
+    MQTTPublishRequest_t * pNewest = NULL;
+    MQTTPublishRequest_t * pNext = NULL;
+
+    assert( pQueue != NULL );
+
+    #if ( MQTT_PUBLISH_QUEUE_USE_ATOMICS != 0 )
+        pSubmitted = __atomic_exchange_n( &pQueue->pSubmitted, NULL, __ATOMIC_ACQUIRE );
+    #else
+        MQTT_PRE_PUBLISH_QUEUE_HOOK( pQueue );
+        pSubmitted = pQueue->pSubmitted;
+        pQueue->pSubmitted = NULL;
+        MQTT_POST_PUBLISH_QUEUE_HOOK( pQueue );
+    #endif
+
+    /* Producers push the newest request first. Reverse the list, so that the
+     * requests of each producer are sent in order. */
+    if( pSubmitted != NULL )
+    {
+        pNewest = pSubmitted;
+
+        while( pSubmitted != NULL )
+        {
+            pNext = pSubmitted->pNext;
+            pSubmitted->pNext = pOldest;
+            pOldest = pSubmitted;
+            pSubmitted = pNext;
+        }
+
+        if( pQueue->pPendingHead == NULL )
+        {
+            pQueue->pPendingHead = pOldest;
+        }
+        else
+        {
+            pQueue->pPendingTail->pNext = pOldest;
+        }
+
+        pQueue->pPendingTail = pNewest;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static bool sendRequest( MQTTPublishQueue_t * pQueue,
+                         MQTTPublishRequest_t * pRequest )
+{
+    MQTTStatus_t status;
+    bool completed = true;
+
+    assert( pQueue != NULL );
+    assert( pRequest != NULL );
+
+    if( ( pRequest->publishInfo.qos != MQTTQoS0 ) && ( pRequest->packetId == 0U ) )
+    {
+        /* Only the owner thread uses the packet identifiers of the context. */
+        pRequest->packetId = MQTT_GetPacketId( pQueue->pContext );
+    }
+
+    status = MQTT_Publish( pQueue->pContext, &pRequest->publishInfo, pRequest->packetId );
+
+    if( ( status == MQTTNoMemory ) && ( pRequest->publishInfo.qos != MQTTQoS0 ) )
+    {
+        /* Every state record is in use. The request is retried once
+         * acknowledgements have been received, which keeps producers from
+         * overrunning the records. */
+        completed = false;
+    }
+    else
+    {
+        pQueue->pPendingHead = pRequest->pNext;
+
+        if( pQueue->pPendingHead == NULL )
+        {
+            pQueue->pPendingTail = NULL;
+        }
+
+        pRequest->pNext = NULL;
+        pQueue->completeCallback( pQueue, pRequest, status );
+    }
+
+    return completed;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTTPublishQueue_Init( MQTTPublishQueue_t * pQueue,
+                                    MQTTContext_t * pContext,
+                                    MQTTPublishCompleteCallback_t completeCallback )
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    if( ( pQueue == NULL ) || ( pContext == NULL ) || ( completeCallback == NULL ) )
+    {
+        LogError( ( "Argument cannot be NULL: pQueue=%p, pContext=%p, "
+                    "completeCallback=%p.",
+                    ( void * ) pQueue,
+                    ( void * ) pContext,
+                    ( void * ) completeCallback ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        ( void ) memset( pQueue, 0x00, sizeof( MQTTPublishQueue_t ) );
+        pQueue->pContext = pContext;
+        pQueue->completeCallback = completeCallback;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTTPublishQueue_Enqueue( MQTTPublishQueue_t * pQueue,
+                                       MQTTPublishRequest_t * pRequest )
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    #if ( MQTT_PUBLISH_QUEUE_USE_ATOMICS != 0 )
+        MQTTPublishRequest_t * pHead = NULL;
+    #endif
+
+    if( ( pQueue == NULL ) || ( pQueue->pContext == NULL ) || ( pRequest == NULL ) )
+    {
+        LogError( ( "Argument cannot be NULL: pQueue=%p, pRequest=%p.",
+                    ( void * ) pQueue,
+                    ( void * ) pRequest ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        #if ( MQTT_PUBLISH_QUEUE_USE_ATOMICS != 0 )
+            pHead = __atomic_load_n( &pQueue->pSubmitted, __ATOMIC_RELAXED );
+
+            /* The owner only ever takes the whole list, so a request is never
+             * removed from under a producer and the exchange is free of ABA.
+             * On failure, pHead is reloaded with the current list. */
+            do
+            {
+                pRequest->pNext = pHead;
+            } while( __atomic_compare_exchange_n( &pQueue->pSubmitted,
+                                                  &pHead,
+                                                  pRequest,
+                                                  true,
+                                                  __ATOMIC_RELEASE,
+                                                  __ATOMIC_RELAXED ) == false );
+        #else
+            MQTT_PRE_PUBLISH_QUEUE_HOOK( pQueue );
+            pRequest->pNext = pQueue->pSubmitted;
+            pQueue->pSubmitted = pRequest;
+            MQTT_POST_PUBLISH_QUEUE_HOOK( pQueue );
+        #endif
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTTPublishQueue_Drain( MQTTPublishQueue_t * pQueue,
+                                     size_t maxCount,
+                                     size_t * pSentCount )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    size_t sentCount = 0U;
+    size_t limit = maxCount;
+    bool completed = true;
+
+    if( ( pQueue == NULL ) || ( pQueue->pContext == NULL ) )
+    {
+        LogError( ( "Argument cannot be NULL: pQueue=%p.", ( void * ) pQueue ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        takeSubmitted( pQueue );
+
+        while( ( completed == true ) && ( pQueue->pPendingHead != NULL ) &&
+               ( ( limit == 0U ) || ( sentCount < limit ) ) )
+        {
+            completed = sendRequest( pQueue, pQueue->pPendingHead );
+
+            if( completed == true )
+            {
+                sentCount++;
+            }
+        }
+    }
+
+    if( pSentCount != NULL )
+    {
+        *pSentCount = sentCount;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+bool MQTTPublishQueue_IsPending( const MQTTPublishQueue_t * pQueue )
+{
+    bool pending = false;
+
+    if( pQueue != NULL )
+    {
+        #if ( MQTT_PUBLISH_QUEUE_USE_ATOMICS != 0 )
+            pending = ( pQueue->pPendingHead != NULL ) ||
+                      ( __atomic_load_n( &pQueue->pSubmitted, __ATOMIC_RELAXED ) != NULL );
+        #else
+            MQTT_PRE_PUBLISH_QUEUE_HOOK( pQueue );
+            pending = ( pQueue->pPendingHead != NULL ) || ( pQueue->pSubmitted != NULL );
+            MQTT_POST_PUBLISH_QUEUE_HOOK( pQueue );
+        #endif
+    }
+
+    return pending;
+}
+
+/*-----------------------------------------------------------*/
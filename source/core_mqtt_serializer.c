@@ -34,11 +34,6 @@
 /* Include config defaults header to get default values of configs. */
 #include "core_mqtt_config_defaults.h"
 
-/**
- * @brief MQTT protocol version 3.1.1.
- */
-#define MQTT_VERSION_3_1_1                          ( ( uint8_t ) 4U )
-
 /**
  * @brief Size of the fixed and variable header of a CONNECT packet.
  */
@@ -147,6 +142,35 @@
  */
 #define MQTT_MIN_PUBLISH_REMAINING_LENGTH_QOS0    ( 3U )
 
+/*
+ * Identifiers of the MQTT 5 properties read or written by the library.
+ */
+#define MQTT_PROPERTY_SUBSCRIPTION_IDENTIFIER     ( ( uint8_t ) 0x0BU ) /**< @brief Subscription Identifier. */
+#define MQTT_PROPERTY_SERVER_KEEP_ALIVE           ( ( uint8_t ) 0x13U ) /**< @brief Server Keep Alive. */
+#define MQTT_PROPERTY_TOPIC_ALIAS_MAXIMUM         ( ( uint8_t ) 0x22U ) /**< @brief Topic Alias Maximum. */
+#define MQTT_PROPERTY_TOPIC_ALIAS                 ( ( uint8_t ) 0x23U ) /**< @brief Topic Alias. */
+
+/**
+ * @brief Size of an empty property length of MQTT 5.
+ */
+#define MQTT_EMPTY_PROPERTIES_SIZE                ( 1U )
+
+/**
+ * @brief Size of the Topic Alias property: its identifier and 2-byte value.
+ */
+#define MQTT_TOPIC_ALIAS_PROPERTY_SIZE            ( 3U )
+
+/**
+ * @brief Reason codes of MQTT 5 from this value on indicate a failure.
+ */
+#define MQTT_REASON_CODE_FAILURE                  ( ( uint8_t ) 0x80U )
+
+/**
+ * @brief Reason code of an MQTT 5 UNSUBACK for a topic filter which was not
+ * subscribed.
+ */
+#define MQTT_REASON_NO_SUBSCRIPTION_EXISTED       ( ( uint8_t ) 0x11U )
+
 /*-----------------------------------------------------------*/
 
 
@@ -451,6 +475,229 @@ static MQTTStatus_t deserializeSimpleAck( const MQTTPacketInfo_t * pAck,
  */
 static MQTTStatus_t deserializePingresp( const MQTTPacketInfo_t * pPingresp );
 
+/**
+ * @brief Serialize the fixed part of a CONNECT packet header for a protocol
+ * version.
+ *
+ * @param[out] pIndex Pointer to the buffer where the header is to be serialized.
+ * @param[in] pConnectInfo The connect information.
+ * @param[in] pWillInfo The last will and testament information.
+ * @param[in] remainingLength The remaining length of the packet.
+ * @param[in] protocolVersion #MQTT_VERSION_3_1_1 or #MQTT_VERSION_5.
+ *
+ * @return A pointer to the end of the header.
+ */
+static uint8_t * serializeConnectFixedHeader( uint8_t * pIndex,
+                                              const MQTTConnectInfo_t * pConnectInfo,
+                                              const MQTTPublishInfo_t * pWillInfo,
+                                              size_t remainingLength,
+                                              uint8_t protocolVersion );
+
+/**
+ * @brief Add the size of MQTT 5 properties to the Remaining Length of a packet
+ * and recalculate its total size.
+ *
+ * @param[in] propertiesSize Size of the properties, including their length.
+ * @param[in,out] pRemainingLength The Remaining Length of the packet.
+ * @param[out] pPacketSize The total size of the packet.
+ *
+ * @return #MQTTBadParameter if the packet would exceed the size allowed by the
+ * MQTT spec; #MQTTSuccess otherwise.
+ */
+static MQTTStatus_t addPropertiesSize( size_t propertiesSize,
+                                       size_t * pRemainingLength,
+                                       size_t * pPacketSize );
+
+/**
+ * @brief Decode a Variable Byte Integer of MQTT 5 from a buffer.
+ *
+ * @param[in] pBuffer The encoded integer.
+ * @param[in] length Number of bytes available in @p pBuffer.
+ * @param[out] pValue The decoded value.
+ * @param[out] pEncodedSize Number of bytes of the encoding.
+ *
+ * @return #MQTTBadResponse if the encoding is invalid or truncated;
+ * #MQTTSuccess otherwise.
+ */
+static MQTTStatus_t decodeVariableByteInteger( const uint8_t * pBuffer,
+                                               size_t length,
+                                               size_t * pValue,
+                                               size_t * pEncodedSize );
+
+/**
+ * @brief Locate the properties of an MQTT 5 packet, which start with their
+ * length.
+ *
+ * @param[in] pBuffer The property length followed by the properties.
+ * @param[in] length Number of bytes available in @p pBuffer.
+ * @param[out] ppProperties The first property.
+ * @param[out] pPropertiesLength The length of the properties.
+ * @param[out] pConsumed Size of the property length and the properties.
+ *
+ * @return #MQTTBadResponse if the properties do not fit in @p length;
+ * #MQTTSuccess otherwise.
+ */
+static MQTTStatus_t getProperties( const uint8_t * pBuffer,
+                                   size_t length,
+                                   const uint8_t ** ppProperties,
+                                   size_t * pPropertiesLength,
+                                   size_t * pConsumed );
+
+/**
+ * @brief Read the next property of MQTT 5 properties.
+ *
+ * @param[in] pProperties The properties.
+ * @param[in] propertiesLength The length of the properties.
+ * @param[in,out] pOffset Offset of the property to read, advanced past it.
+ * @param[out] pPropertyId The identifier of the property.
+ * @param[out] ppValue The value of the property.
+ *
+ * @return #MQTTBadResponse if the property is unknown or does not fit in the
+ * properties; #MQTTSuccess otherwise.
+ */
+static MQTTStatus_t nextProperty( const uint8_t * pProperties,
+                                  size_t propertiesLength,
+                                  size_t * pOffset,
+                                  uint8_t * pPropertyId,
+                                  const uint8_t ** ppValue );
+
+/**
+ * @brief Deserialize an MQTT 5 CONNACK packet.
+ *
+ * @param[in] pConnack Pointer to an MQTT packet struct representing a CONNACK.
+ * @param[out] pSessionPresent Whether a previous session was present.
+ * @param[out] pConnackProperties Properties of the CONNACK. May be NULL.
+ *
+ * @return #MQTTSuccess if CONNACK specifies that CONNECT was accepted;
+ * #MQTTServerRefused if CONNACK specifies that CONNECT was rejected;
+ * #MQTTBadResponse if the CONNACK packet doesn't follow MQTT spec.
+ */
+static MQTTStatus_t deserializeConnackV5( const MQTTPacketInfo_t * pConnack,
+                                          bool * pSessionPresent,
+                                          MQTTConnackProperties_t * pConnackProperties );
+
+/**
+ * @brief Deserialize an MQTT 5 PUBACK, PUBREC, PUBREL or PUBCOMP packet.
+ *
+ * @param[in] pAck Pointer to the MQTT packet structure representing the packet.
+ * @param[out] pPacketIdentifier Packet ID of the ack type packet.
+ *
+ * @return #MQTTSuccess if the packet is valid; #MQTTServerRefused if a
+ * PUBACK, PUBREC or PUBCOMP has a failure reason code; #MQTTBadResponse if the
+ * packet doesn't follow the MQTT spec.
+ */
+static MQTTStatus_t deserializePublishAckV5( const MQTTPacketInfo_t * pAck,
+                                             uint16_t * pPacketIdentifier );
+
+/**
+ * @brief Deserialize an MQTT 5 DISCONNECT or AUTH packet.
+ *
+ * @param[in] pPacket Pointer to the MQTT packet structure representing the
+ * packet.
+ *
+ * @return #MQTTSuccess if the packet is valid; #MQTTBadResponse if the packet
+ * doesn't follow the MQTT spec.
+ */
+static MQTTStatus_t deserializeDisconnectV5( const MQTTPacketInfo_t * pPacket );
+
+/**
+ * @brief Deserialize an MQTT 5 SUBACK or UNSUBACK packet.
+ *
+ * @param[in] pAck Pointer to the MQTT packet structure representing the packet.
+ * @param[out] pPacketIdentifier Packet ID of the packet.
+ *
+ * @return #MQTTSuccess if every topic filter was accepted; #MQTTServerRefused
+ * if any was refused; #MQTTBadResponse if the packet doesn't follow the MQTT
+ * spec.
+ */
+static MQTTStatus_t deserializeSubscriptionAckV5( const MQTTPacketInfo_t * pAck,
+                                                  uint16_t * pPacketIdentifier );
+
+/**
+ * @brief Check if an incoming packet type is valid for a server to receive.
+ *
+ * @param[in] packetType The packet type to check.
+ *
+ * @return `true` if the packet type is one a client sends; `false` otherwise.
+ */
+static bool incomingServerPacketValid( uint8_t packetType );
+
+/**
+ * @brief Decode a length-prefixed string or binary field of a packet, without
+ * copying it.
+ *
+ * @param[in] pBuffer The remaining data of the packet.
+ * @param[in] length The remaining length of the packet.
+ * @param[in,out] pOffset Offset of the field, advanced past it.
+ * @param[out] ppString The start of the field in @p pBuffer.
+ * @param[out] pStringLength The length of the field.
+ *
+ * @return #MQTTBadResponse if the field does not fit in the packet;
+ * #MQTTSuccess otherwise.
+ */
+static MQTTStatus_t decodeString( const uint8_t * pBuffer,
+                                  size_t length,
+                                  size_t * pOffset,
+                                  const char ** ppString,
+                                  uint16_t * pStringLength );
+
+/**
+ * @brief Check the flags of a CONNECT packet against the MQTT 3.1.1 spec.
+ *
+ * @param[in] connectFlags The Connect Flags byte.
+ *
+ * @return #MQTTBadResponse if the flags are malformed; #MQTTSuccess otherwise.
+ */
+static MQTTStatus_t checkConnectFlags( uint8_t connectFlags );
+
+/**
+ * @brief Deserialize an MQTT 3.1.1 CONNECT packet.
+ *
+ * @param[in] pConnect Pointer to an MQTT packet struct representing a CONNECT.
+ * @param[out] pConnectInfo The connection parameters.
+ * @param[out] pWillInfo The Last Will and Testament.
+ * @param[out] pWillPresent Whether the CONNECT carries a Last Will and
+ * Testament.
+ *
+ * @return #MQTTSuccess if the CONNECT is valid; #MQTTBadResponse otherwise.
+ */
+static MQTTStatus_t deserializeConnect( const MQTTPacketInfo_t * pConnect,
+                                        MQTTConnectInfo_t * pConnectInfo,
+                                        MQTTPublishInfo_t * pWillInfo,
+                                        bool * pWillPresent );
+
+/**
+ * @brief Deserialize the packet identifier and topic filters of a SUBSCRIBE or
+ * UNSUBSCRIBE packet.
+ *
+ * @param[in] pPacket Pointer to an MQTT packet struct representing the packet.
+ * @param[out] pPacketId The packet identifier.
+ * @param[out] pSubscriptionList The topic filters, and the requested QoS of
+ * each for a SUBSCRIBE.
+ * @param[in,out] pSubscriptionCount The length of @p pSubscriptionList, set to
+ * the number of topic filters.
+ *
+ * @return #MQTTSuccess if the packet is valid; #MQTTNoMemory if it has more
+ * topic filters than @p pSubscriptionList holds; #MQTTBadResponse otherwise.
+ */
+static MQTTStatus_t deserializeSubscriptions( const MQTTPacketInfo_t * pPacket,
+                                              uint16_t * pPacketId,
+                                              MQTTSubscribeInfo_t * pSubscriptionList,
+                                              size_t * pSubscriptionCount );
+
+/**
+ * @brief Check a packet which carries nothing after its fixed header, such as
+ * PINGREQ and DISCONNECT.
+ *
+ * @param[in] pPacket Pointer to an MQTT packet struct representing the packet.
+ * @param[in] packetType The expected packet type.
+ *
+ * @return #MQTTBadParameter if @p pPacket is NULL or not of @p packetType;
+ * #MQTTBadResponse if it has a remaining length; #MQTTSuccess otherwise.
+ */
+static MQTTStatus_t deserializeEmptyPacket( const MQTTPacketInfo_t * pPacket,
+                                            uint8_t packetType );
+
 /*-----------------------------------------------------------*/
 
 static size_t remainingLengthEncodedSize( size_t length )
@@ -931,6 +1178,8 @@ static bool incomingPacketValid( uint8_t packetType )
         case MQTT_PACKET_TYPE_SUBACK:
         case MQTT_PACKET_TYPE_UNSUBACK:
         case MQTT_PACKET_TYPE_PINGRESP:
+        case MQTT_PACKET_TYPE_DISCONNECT:
+        case MQTT_PACKET_TYPE_AUTH:
             status = true;
             break;
 
@@ -1547,10 +1796,11 @@ static MQTTStatus_t deserializePingresp( const MQTTPacketInfo_t * pPingresp )
     return status;
 }
 
-uint8_t * MQTT_SerializeConnectFixedHeader( uint8_t * pIndex,
-                                            const MQTTConnectInfo_t * pConnectInfo,
-                                            const MQTTPublishInfo_t * pWillInfo,
-                                            size_t remainingLength )
+static uint8_t * serializeConnectFixedHeader( uint8_t * pIndex,
+                                              const MQTTConnectInfo_t * pConnectInfo,
+                                              const MQTTPublishInfo_t * pWillInfo,
+                                              size_t remainingLength,
+                                              uint8_t protocolVersion )
 {
     uint8_t * pIndexLocal = pIndex;
     uint8_t connectFlags = 0U;
@@ -1569,7 +1819,7 @@ uint8_t * MQTT_SerializeConnectFixedHeader( uint8_t * pIndex,
     pIndexLocal = encodeString( pIndexLocal, "MQTT", 4 );
 
     /* The MQTT protocol version is the second field of the variable header. */
-    *pIndexLocal = MQTT_VERSION_3_1_1;
+    *pIndexLocal = protocolVersion;
     pIndexLocal++;
 
     /* Set the clean session flag if needed. */
@@ -1624,6 +1874,20 @@ uint8_t * MQTT_SerializeConnectFixedHeader( uint8_t * pIndex,
 
     return pIndexLocal;
 }
+
+/*-----------------------------------------------------------*/
+
+uint8_t * MQTT_SerializeConnectFixedHeader( uint8_t * pIndex,
+                                            const MQTTConnectInfo_t * pConnectInfo,
+                                            const MQTTPublishInfo_t * pWillInfo,
+                                            size_t remainingLength )
+{
+    return serializeConnectFixedHeader( pIndex,
+                                        pConnectInfo,
+                                        pWillInfo,
+                                        remainingLength,
+                                        MQTT_VERSION_3_1_1 );
+}
 /*-----------------------------------------------------------*/
 
 static void serializeConnectPacket( const MQTTConnectInfo_t * pConnectInfo,
@@ -2704,3 +2968,1811 @@ MQTTStatus_t MQTT_ProcessIncomingPacketTypeAndLength( const uint8_t * pBuffer,
 }
 
 /*-----------------------------------------------------------*/
+
+static MQTTStatus_t addPropertiesSize( size_t propertiesSize,
+                                       size_t * pRemainingLength,
+                                       size_t * pPacketSize )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    size_t remainingLength;
+
+    assert( pRemainingLength != NULL );
+    assert( pPacketSize != NULL );
+
+    /* The Remaining Length given by the MQTT 3.1.1 calculation is at most
+     * MQTT_MAX_REMAINING_LENGTH, so this addition cannot overflow. */
+    remainingLength = *pRemainingLength + propertiesSize;
+
+    if( remainingLength > MQTT_MAX_REMAINING_LENGTH )
+    {
+        LogError( ( "Packet remaining length of %lu with properties exceeds "
+                    "the maximum of %lu.",
+                    ( unsigned long ) remainingLength,
+                    MQTT_MAX_REMAINING_LENGTH ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        *pRemainingLength = remainingLength;
+        *pPacketSize = remainingLength + 1U + remainingLengthEncodedSize( remainingLength );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t decodeVariableByteInteger( const uint8_t * pBuffer,
+                                               size_t length,
+                                               size_t * pValue,
+                                               size_t * pEncodedSize )
+{
+    MQTTStatus_t status = MQTTBadResponse;
+    size_t value = 0U, multiplier = 1U, i;
+
+    assert( pBuffer != NULL );
+    assert( pValue != NULL );
+    assert( pEncodedSize != NULL );
+
+    /* A Variable Byte Integer is encoded in at most 4 bytes, each holding 7
+     * bits of the value and a continuation bit. */
+    for( i = 0U; ( i < length ) && ( i < 4U ); i++ )
+    {
+        value += ( size_t ) ( pBuffer[ i ] & 0x7FU ) * multiplier;
+        multiplier *= 128U;
+
+        if( ( pBuffer[ i ] & 0x80U ) == 0U )
+        {
+            *pValue = value;
+            *pEncodedSize = i + 1U;
+            status = MQTTSuccess;
+            break;
+        }
+    }
+
+    if( status != MQTTSuccess )
+    {
+        LogError( ( "Invalid or truncated variable byte integer." ) );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t getProperties( const uint8_t * pBuffer,
+                                   size_t length,
+                                   const uint8_t ** ppProperties,
+                                   size_t * pPropertiesLength,
+                                   size_t * pConsumed )
+{
+    MQTTStatus_t status;
+    size_t propertiesLength = 0U, encodedSize = 0U;
+
+    assert( ppProperties != NULL );
+    assert( pPropertiesLength != NULL );
+    assert( pConsumed != NULL );
+
+    status = decodeVariableByteInteger( pBuffer, length, &propertiesLength, &encodedSize );
+
+    if( ( status == MQTTSuccess ) && ( propertiesLength > ( length - encodedSize ) ) )
+    {
+        LogError( ( "Property length %lu exceeds the %lu bytes left in the packet.",
+                    ( unsigned long ) propertiesLength,
+                    ( unsigned long ) ( length - encodedSize ) ) );
+        status = MQTTBadResponse;
+    }
+
+    if( status == MQTTSuccess )
+    {
+        *ppProperties = &pBuffer[ encodedSize ];
+        *pPropertiesLength = propertiesLength;
+        *pConsumed = encodedSize + propertiesLength;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t nextProperty( const uint8_t * pProperties,
+                                  size_t propertiesLength,
+                                  size_t * pOffset,
+                                  uint8_t * pPropertyId,
+                                  const uint8_t ** ppValue )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    const uint8_t * pValue;
+    size_t available, valueLength = 0U, stringLength, encodedSize = 0U;
+
+    assert( pProperties != NULL );
+    assert( pOffset != NULL );
+    assert( *pOffset < propertiesLength );
+    assert( pPropertyId != NULL );
+    assert( ppValue != NULL );
+
+    *pPropertyId = pProperties[ *pOffset ];
+    pValue = &pProperties[ *pOffset + 1U ];
+    available = propertiesLength - *pOffset - 1U;
+
+    switch( *pPropertyId )
+    {
+        /* Byte properties. */
+        case 0x01U:
+        case 0x17U:
+        case 0x19U:
+        case 0x24U:
+        case 0x25U:
+        case 0x28U:
+        case 0x29U:
+        case 0x2AU:
+            valueLength = 1U;
+            break;
+
+        /* Two Byte Integer properties. */
+        case MQTT_PROPERTY_SERVER_KEEP_ALIVE:
+        case 0x21U:
+        case MQTT_PROPERTY_TOPIC_ALIAS_MAXIMUM:
+        case MQTT_PROPERTY_TOPIC_ALIAS:
+            valueLength = 2U;
+            break;
+
+        /* Four Byte Integer properties. */
+        case 0x02U:
+        case 0x11U:
+        case 0x18U:
+        case 0x27U:
+            valueLength = 4U;
+            break;
+
+        /* The Subscription Identifier is a Variable Byte Integer. */
+        case MQTT_PROPERTY_SUBSCRIPTION_IDENTIFIER:
+            status = decodeVariableByteInteger( pValue, available, &stringLength, &encodedSize );
+            valueLength = encodedSize;
+            break;
+
+        /* UTF-8 String and Binary Data properties, prefixed with their length. */
+        case 0x03U:
+        case 0x08U:
+        case 0x09U:
+        case 0x12U:
+        case 0x15U:
+        case 0x16U:
+        case 0x1AU:
+        case 0x1CU:
+        case 0x1FU:
+
+            if( available >= sizeof( uint16_t ) )
+            {
+                valueLength = sizeof( uint16_t ) + UINT16_DECODE( pValue );
+            }
+            else
+            {
+                status = MQTTBadResponse;
+            }
+
+            break;
+
+        /* The User Property is a pair of UTF-8 strings. */
+        case 0x26U:
+
+            if( available >= sizeof( uint16_t ) )
+            {
+                valueLength = sizeof( uint16_t ) + UINT16_DECODE( pValue );
+
+                if( available >= ( valueLength + sizeof( uint16_t ) ) )
+                {
+                    stringLength = UINT16_DECODE( ( &pValue[ valueLength ] ) );
+                    valueLength += sizeof( uint16_t ) + stringLength;
+                }
+                else
+                {
+                    status = MQTTBadResponse;
+                }
+            }
+            else
+            {
+                status = MQTTBadResponse;
+            }
+
+            break;
+
+        default:
+            LogError( ( "Unknown property identifier %02x.",
+                        ( unsigned int ) *pPropertyId ) );
+            status = MQTTBadResponse;
+            break;
+    }
+
+    if( ( status == MQTTSuccess ) && ( valueLength > available ) )
+    {
+        status = MQTTBadResponse;
+    }
+
+    if( status == MQTTSuccess )
+    {
+        *ppValue = pValue;
+        *pOffset += 1U + valueLength;
+    }
+    else
+    {
+        LogError( ( "Property %02x does not fit in the properties.",
+                    ( unsigned int ) *pPropertyId ) );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t deserializeConnackV5( const MQTTPacketInfo_t * pConnack,
+                                          bool * pSessionPresent,
+                                          MQTTConnackProperties_t * pConnackProperties )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    const uint8_t * pRemainingData = NULL;
+    const uint8_t * pProperties = NULL;
+    const uint8_t * pValue = NULL;
+    size_t propertiesLength = 0U, consumed = 0U, offset = 0U;
+    uint8_t propertyId = 0U;
+    uint8_t reasonCode;
+
+    assert( pConnack != NULL );
+    assert( pSessionPresent != NULL );
+    pRemainingData = pConnack->pRemainingData;
+
+    /* An MQTT 5 CONNACK holds the acknowledge flags, the reason code and the
+     * properties, which take at least one byte for their length. */
+    if( pConnack->remainingLength < 3U )
+    {
+        LogError( ( "CONNACK remaining length %lu is less than 3.",
+                    ( unsigned long ) pConnack->remainingLength ) );
+        status = MQTTBadResponse;
+    }
+    else if( ( pRemainingData[ 0 ] | 0x01U ) != 0x01U )
+    {
+        LogError( ( "Reserved bits in CONNACK incorrect." ) );
+        status = MQTTBadResponse;
+    }
+    else
+    {
+        *pSessionPresent = ( ( pRemainingData[ 0 ] & MQTT_PACKET_CONNACK_SESSION_PRESENT_MASK )
+                             == MQTT_PACKET_CONNACK_SESSION_PRESENT_MASK );
+
+        status = getProperties( &pRemainingData[ 2 ],
+                                pConnack->remainingLength - 2U,
+                                &pProperties,
+                                &propertiesLength,
+                                &consumed );
+
+        if( ( status == MQTTSuccess ) && ( consumed != ( pConnack->remainingLength - 2U ) ) )
+        {
+            LogError( ( "CONNACK has data after its properties." ) );
+            status = MQTTBadResponse;
+        }
+    }
+
+    while( ( status == MQTTSuccess ) && ( offset < propertiesLength ) )
+    {
+        status = nextProperty( pProperties, propertiesLength, &offset, &propertyId, &pValue );
+
+        if( ( status == MQTTSuccess ) && ( pConnackProperties != NULL ) )
+        {
+            if( propertyId == MQTT_PROPERTY_TOPIC_ALIAS_MAXIMUM )
+            {
+                pConnackProperties->topicAliasMaximum = UINT16_DECODE( pValue );
+            }
+            else if( propertyId == MQTT_PROPERTY_SERVER_KEEP_ALIVE )
+            {
+                pConnackProperties->serverKeepAlive = UINT16_DECODE( pValue );
+                pConnackProperties->serverKeepAlivePresent = true;
+            }
+            else
+            {
+                /* Other properties are not used by the library. */
+            }
+        }
+    }
+
+    if( status == MQTTSuccess )
+    {
+        reasonCode = pRemainingData[ 1 ];
+
+        if( reasonCode == 0U )
+        {
+            LogDebug( ( "CONNACK session present bit %s.",
+                        ( *pSessionPresent == true ) ? "set" : "not set" ) );
+        }
+        else if( ( reasonCode < MQTT_REASON_CODE_FAILURE ) || ( *pSessionPresent == true ) )
+        {
+            LogError( ( "CONNACK reason code %02x is invalid.",
+                        ( unsigned int ) reasonCode ) );
+            status = MQTTBadResponse;
+        }
+        else
+        {
+            LogError( ( "Connection refused with reason code %02x.",
+                        ( unsigned int ) reasonCode ) );
+            status = MQTTServerRefused;
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t deserializePublishAckV5( const MQTTPacketInfo_t * pAck,
+                                             uint16_t * pPacketIdentifier )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    const uint8_t * pProperties = NULL;
+    size_t propertiesLength = 0U, consumed = 0U;
+
+    assert( pAck != NULL );
+    assert( pPacketIdentifier != NULL );
+
+    /* The reason code and the properties may be omitted, leaving the packet
+     * identifier of an MQTT 3.1.1 ack. */
+    if( pAck->remainingLength < MQTT_PACKET_SIMPLE_ACK_REMAINING_LENGTH )
+    {
+        LogError( ( "ACK remaining length %lu is less than %u.",
+                    ( unsigned long ) pAck->remainingLength,
+                    ( unsigned int ) MQTT_PACKET_SIMPLE_ACK_REMAINING_LENGTH ) );
+        status = MQTTBadResponse;
+    }
+    else
+    {
+        *pPacketIdentifier = UINT16_DECODE( pAck->pRemainingData );
+
+        if( *pPacketIdentifier == 0U )
+        {
+            LogError( ( "Packet identifier cannot be 0." ) );
+            status = MQTTBadResponse;
+        }
+    }
+
+    if( ( status == MQTTSuccess ) && ( pAck->remainingLength > 3U ) )
+    {
+        status = getProperties( &pAck->pRemainingData[ 3 ],
+                                pAck->remainingLength - 3U,
+                                &pProperties,
+                                &propertiesLength,
+                                &consumed );
+
+        if( ( status == MQTTSuccess ) && ( consumed != ( pAck->remainingLength - 3U ) ) )
+        {
+            LogError( ( "ACK has data after its properties." ) );
+            status = MQTTBadResponse;
+        }
+    }
+
+    /* A PUBREL is answered with a PUBCOMP whatever its reason code, so only a
+     * failure in a PUBACK, PUBREC or PUBCOMP is reported. */
+    if( ( status == MQTTSuccess ) && ( pAck->remainingLength > 2U ) &&
+        ( pAck->pRemainingData[ 2 ] >= MQTT_REASON_CODE_FAILURE ) )
+    {
+        LogWarn( ( "Packet %hu acknowledged with reason code %02x.",
+                   ( unsigned short ) *pPacketIdentifier,
+                   ( unsigned int ) pAck->pRemainingData[ 2 ] ) );
+
+        if( pAck->type != MQTT_PACKET_TYPE_PUBREL )
+        {
+            status = MQTTServerRefused;
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t deserializeDisconnectV5( const MQTTPacketInfo_t * pPacket )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    const uint8_t * pProperties = NULL;
+    size_t propertiesLength = 0U, consumed = 0U;
+
+    assert( pPacket != NULL );
+
+    /* A remaining length of 0 means the success reason code, and a remaining
+     * length of 1 means no properties. */
+    if( pPacket->remainingLength > 1U )
+    {
+        status = getProperties( &pPacket->pRemainingData[ 1 ],
+                                pPacket->remainingLength - 1U,
+                                &pProperties,
+                                &propertiesLength,
+                                &consumed );
+
+        if( ( status == MQTTSuccess ) && ( consumed != ( pPacket->remainingLength - 1U ) ) )
+        {
+            LogError( ( "Packet type %02x has data after its properties.",
+                        ( unsigned int ) pPacket->type ) );
+            status = MQTTBadResponse;
+        }
+    }
+
+    if( ( status == MQTTSuccess ) && ( pPacket->remainingLength > 0U ) &&
+        ( pPacket->pRemainingData[ 0 ] >= MQTT_REASON_CODE_FAILURE ) )
+    {
+        LogWarn( ( "Packet type %02x received with reason code %02x.",
+                   ( unsigned int ) pPacket->type,
+                   ( unsigned int ) pPacket->pRemainingData[ 0 ] ) );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t deserializeSubscriptionAckV5( const MQTTPacketInfo_t * pAck,
+                                                  uint16_t * pPacketIdentifier )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    const uint8_t * pProperties = NULL;
+    size_t propertiesLength = 0U, consumed = 0U, i;
+    uint8_t reasonCode;
+
+    assert( pAck != NULL );
+    assert( pPacketIdentifier != NULL );
+
+    /* The packet identifier, the property length and at least one reason
+     * code. */
+    if( pAck->remainingLength < 4U )
+    {
+        LogError( ( "SUBACK or UNSUBACK cannot have a remaining length less than 4." ) );
+        status = MQTTBadResponse;
+    }
+    else
+    {
+        *pPacketIdentifier = UINT16_DECODE( pAck->pRemainingData );
+
+        if( *pPacketIdentifier == 0U )
+        {
+            LogError( ( "Packet identifier cannot be 0." ) );
+            status = MQTTBadResponse;
+        }
+        else
+        {
+            status = getProperties( &pAck->pRemainingData[ sizeof( uint16_t ) ],
+                                    pAck->remainingLength - sizeof( uint16_t ),
+                                    &pProperties,
+                                    &propertiesLength,
+                                    &consumed );
+        }
+    }
+
+    if( ( status == MQTTSuccess ) && ( consumed >= ( pAck->remainingLength - sizeof( uint16_t ) ) ) )
+    {
+        LogError( ( "SUBACK or UNSUBACK has no reason codes." ) );
+        status = MQTTBadResponse;
+    }
+
+    for( i = sizeof( uint16_t ) + consumed;
+         ( status != MQTTBadResponse ) && ( i < pAck->remainingLength );
+         i++ )
+    {
+        reasonCode = pAck->pRemainingData[ i ];
+
+        if( reasonCode >= MQTT_REASON_CODE_FAILURE )
+        {
+            LogWarn( ( "Topic filter %lu refused with reason code %02x.",
+                       ( unsigned long ) ( i - sizeof( uint16_t ) - consumed ),
+                       ( unsigned int ) reasonCode ) );
+            status = MQTTServerRefused;
+        }
+        else if( ( pAck->type == MQTT_PACKET_TYPE_SUBACK ) ?
+                 ( reasonCode > ( uint8_t ) MQTTQoS2 ) :
+                 ( ( reasonCode != 0U ) && ( reasonCode != MQTT_REASON_NO_SUBSCRIPTION_EXISTED ) ) )
+        {
+            LogError( ( "Bad reason code %02x.", ( unsigned int ) reasonCode ) );
+            status = MQTTBadResponse;
+        }
+        else
+        {
+            /* Empty else MISRA 15.7 */
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+uint8_t * MQTT_SerializeConnectFixedHeaderV5( uint8_t * pIndex,
+                                              const MQTTConnectInfo_t * pConnectInfo,
+                                              const MQTTPublishInfo_t * pWillInfo,
+                                              size_t remainingLength )
+{
+    uint8_t * pIndexLocal;
+
+    pIndexLocal = serializeConnectFixedHeader( pIndex,
+                                               pConnectInfo,
+                                               pWillInfo,
+                                               remainingLength,
+                                               MQTT_VERSION_5 );
+
+    /* The CONNECT is sent without properties. */
+    *pIndexLocal = 0U;
+    pIndexLocal++;
+
+    return pIndexLocal;
+}
+
+/*-----------------------------------------------------------*/
+
+uint8_t * MQTT_SerializeSubscribeHeaderV5( size_t remainingLength,
+                                           uint8_t * pIndex,
+                                           uint16_t packetId,
+                                           uint32_t subscriptionId )
+{
+    uint8_t * pIterator;
+
+    pIterator = MQTT_SerializeSubscribeHeader( remainingLength, pIndex, packetId );
+
+    if( subscriptionId != 0U )
+    {
+        /* The property length fits in one byte. */
+        *pIterator = ( uint8_t ) ( 1U + remainingLengthEncodedSize( subscriptionId ) );
+        pIterator++;
+        *pIterator = MQTT_PROPERTY_SUBSCRIPTION_IDENTIFIER;
+        pIterator++;
+        pIterator = encodeRemainingLength( pIterator, subscriptionId );
+    }
+    else
+    {
+        *pIterator = 0U;
+        pIterator++;
+    }
+
+    return pIterator;
+}
+
+/*-----------------------------------------------------------*/
+
+uint8_t * MQTT_SerializeUnsubscribeHeaderV5( size_t remainingLength,
+                                             uint8_t * pIndex,
+                                             uint16_t packetId )
+{
+    uint8_t * pIterator;
+
+    pIterator = MQTT_SerializeUnsubscribeHeader( remainingLength, pIndex, packetId );
+
+    /* The UNSUBSCRIBE is sent without properties. */
+    *pIterator = 0U;
+    pIterator++;
+
+    return pIterator;
+}
+
+/*-----------------------------------------------------------*/
+
+uint8_t * MQTT_SerializePublishPropertiesV5( uint16_t topicAlias,
+                                             uint8_t * pIndex )
+{
+    uint8_t * pIterator = pIndex;
+
+    if( topicAlias != 0U )
+    {
+        /* The property length fits in one byte. */
+        pIterator[ 0 ] = ( uint8_t ) MQTT_TOPIC_ALIAS_PROPERTY_SIZE;
+        pIterator[ 1 ] = MQTT_PROPERTY_TOPIC_ALIAS;
+        pIterator[ 2 ] = UINT16_HIGH_BYTE( topicAlias );
+        pIterator[ 3 ] = UINT16_LOW_BYTE( topicAlias );
+        pIterator = &pIterator[ 4 ];
+    }
+    else
+    {
+        *pIterator = 0U;
+        pIterator++;
+    }
+
+    return pIterator;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_GetConnectPacketSizeV5( const MQTTConnectInfo_t * pConnectInfo,
+                                          const MQTTPublishInfo_t * pWillInfo,
+                                          size_t * pRemainingLength,
+                                          size_t * pPacketSize )
+{
+    MQTTStatus_t status;
+    size_t propertiesSize = MQTT_EMPTY_PROPERTIES_SIZE;
+
+    status = MQTT_GetConnectPacketSize( pConnectInfo,
+                                        pWillInfo,
+                                        pRemainingLength,
+                                        pPacketSize );
+
+    if( status == MQTTSuccess )
+    {
+        /* The will message has properties of its own. */
+        if( pWillInfo != NULL )
+        {
+            propertiesSize += MQTT_EMPTY_PROPERTIES_SIZE;
+        }
+
+        status = addPropertiesSize( propertiesSize, pRemainingLength, pPacketSize );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_GetSubscribePacketSizeV5( const MQTTSubscribeInfo_t * pSubscriptionList,
+                                            size_t subscriptionCount,
+                                            uint32_t subscriptionId,
+                                            size_t * pRemainingLength,
+                                            size_t * pPacketSize )
+{
+    MQTTStatus_t status;
+    size_t propertiesSize = MQTT_EMPTY_PROPERTIES_SIZE;
+
+    if( subscriptionId > MQTT_SUBSCRIPTION_ID_MAX )
+    {
+        LogError( ( "Subscription Identifier %lu exceeds the maximum of %lu.",
+                    ( unsigned long ) subscriptionId,
+                    ( unsigned long ) MQTT_SUBSCRIPTION_ID_MAX ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        status = MQTT_GetSubscribePacketSize( pSubscriptionList,
+                                              subscriptionCount,
+                                              pRemainingLength,
+                                              pPacketSize );
+    }
+
+    if( status == MQTTSuccess )
+    {
+        if( subscriptionId != 0U )
+        {
+            propertiesSize += 1U + remainingLengthEncodedSize( subscriptionId );
+        }
+
+        status = addPropertiesSize( propertiesSize, pRemainingLength, pPacketSize );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_GetUnsubscribePacketSizeV5( const MQTTSubscribeInfo_t * pSubscriptionList,
+                                              size_t subscriptionCount,
+                                              size_t * pRemainingLength,
+                                              size_t * pPacketSize )
+{
+    MQTTStatus_t status;
+
+    status = MQTT_GetUnsubscribePacketSize( pSubscriptionList,
+                                            subscriptionCount,
+                                            pRemainingLength,
+                                            pPacketSize );
+
+    if( status == MQTTSuccess )
+    {
+        status = addPropertiesSize( MQTT_EMPTY_PROPERTIES_SIZE, pRemainingLength, pPacketSize );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_GetPublishPacketSizeV5( const MQTTPublishInfo_t * pPublishInfo,
+                                          uint16_t topicAlias,
+                                          size_t * pRemainingLength,
+                                          size_t * pPacketSize )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    size_t propertiesSize = MQTT_EMPTY_PROPERTIES_SIZE;
+
+    if( ( pPublishInfo == NULL ) || ( pRemainingLength == NULL ) || ( pPacketSize == NULL ) )
+    {
+        LogError( ( "Argument cannot be NULL: pPublishInfo=%p, "
+                    "pRemainingLength=%p, pPacketSize=%p.",
+                    ( void * ) pPublishInfo,
+                    ( void * ) pRemainingLength,
+                    ( void * ) pPacketSize ) );
+        status = MQTTBadParameter;
+    }
+    /* The topic name may only be left out when a topic alias is sent. */
+    else if( ( topicAlias == 0U ) &&
+             ( ( pPublishInfo->pTopicName == NULL ) || ( pPublishInfo->topicNameLength == 0U ) ) )
+    {
+        LogError( ( "Invalid topic name for PUBLISH without topic alias: pTopicName=%p, "
+                    "topicNameLength=%hu.",
+                    ( void * ) pPublishInfo->pTopicName,
+                    ( unsigned short ) pPublishInfo->topicNameLength ) );
+        status = MQTTBadParameter;
+    }
+    else if( ( pPublishInfo->pTopicName == NULL ) && ( pPublishInfo->topicNameLength != 0U ) )
+    {
+        LogError( ( "Topic name cannot be NULL with topicNameLength=%hu.",
+                    ( unsigned short ) pPublishInfo->topicNameLength ) );
+        status = MQTTBadParameter;
+    }
+    else if( calculatePublishPacketSize( pPublishInfo, pRemainingLength, pPacketSize ) == false )
+    {
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        if( topicAlias != 0U )
+        {
+            propertiesSize += MQTT_TOPIC_ALIAS_PROPERTY_SIZE;
+        }
+
+        status = addPropertiesSize( propertiesSize, pRemainingLength, pPacketSize );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_DeserializePublishV5( const MQTTPacketInfo_t * pIncomingPacket,
+                                        uint16_t * pPacketId,
+                                        MQTTPublishInfo_t * pPublishInfo,
+                                        uint32_t * pSubscriptionIds,
+                                        size_t * pSubscriptionIdCount )
+{
+    MQTTStatus_t status;
+    const uint8_t * pProperties = NULL;
+    const uint8_t * pValue = NULL;
+    const uint8_t * pPropertiesStart = NULL;
+    size_t propertiesLength = 0U, consumed = 0U, offset = 0U;
+    size_t idCapacity = 0U, idCount = 0U, subscriptionId = 0U, encodedSize = 0U;
+    uint8_t propertyId = 0U;
+
+    if( ( pSubscriptionIds != NULL ) && ( pSubscriptionIdCount == NULL ) )
+    {
+        LogError( ( "pSubscriptionIdCount cannot be NULL when pSubscriptionIds is given." ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        if( pSubscriptionIds != NULL )
+        {
+            idCapacity = *pSubscriptionIdCount;
+        }
+
+        /* The MQTT 3.1.1 deserialization leaves the properties at the start of
+         * the payload. */
+        status = MQTT_DeserializePublish( pIncomingPacket, pPacketId, pPublishInfo );
+    }
+
+    if( ( status == MQTTSuccess ) && ( pPublishInfo->payloadLength == 0U ) )
+    {
+        LogError( ( "PUBLISH has no property length." ) );
+        status = MQTTBadResponse;
+    }
+
+    if( status == MQTTSuccess )
+    {
+        pPropertiesStart = ( const uint8_t * ) pPublishInfo->pPayload;
+        status = getProperties( pPropertiesStart,
+                                pPublishInfo->payloadLength,
+                                &pProperties,
+                                &propertiesLength,
+                                &consumed );
+    }
+
+    while( ( status == MQTTSuccess ) && ( offset < propertiesLength ) )
+    {
+        status = nextProperty( pProperties, propertiesLength, &offset, &propertyId, &pValue );
+
+        /* The CONNECT does not allow the server to send topic aliases. */
+        if( ( status == MQTTSuccess ) && ( propertyId == MQTT_PROPERTY_TOPIC_ALIAS ) )
+        {
+            LogError( ( "PUBLISH has a topic alias, which the client does not accept." ) );
+            status = MQTTBadResponse;
+        }
+        /* A PUBLISH carries one Subscription Identifier for each matching
+         * subscription that was given one. */
+        else if( ( status == MQTTSuccess ) && ( propertyId == MQTT_PROPERTY_SUBSCRIPTION_IDENTIFIER ) )
+        {
+            /* nextProperty() has already checked the encoding. */
+            ( void ) decodeVariableByteInteger( pValue,
+                                                ( size_t ) ( &pProperties[ offset ] - pValue ),
+                                                &subscriptionId,
+                                                &encodedSize );
+
+            if( subscriptionId == 0U )
+            {
+                LogError( ( "PUBLISH has a Subscription Identifier of 0." ) );
+                status = MQTTBadResponse;
+            }
+            else if( idCount < idCapacity )
+            {
+                pSubscriptionIds[ idCount ] = ( uint32_t ) subscriptionId;
+                idCount++;
+            }
+            else
+            {
+                LogWarn( ( "Dropping Subscription Identifier %lu, which does not fit in %lu entries.",
+                           ( unsigned long ) subscriptionId,
+                           ( unsigned long ) idCapacity ) );
+            }
+        }
+        else
+        {
+            /* Empty else MISRA 15.7 */
+        }
+    }
+
+    if( status == MQTTSuccess )
+    {
+        pPublishInfo->payloadLength -= consumed;
+        pPublishInfo->pPayload = ( pPublishInfo->payloadLength != 0U ) ? &pPropertiesStart[ consumed ] : NULL;
+
+        if( pSubscriptionIdCount != NULL )
+        {
+            *pSubscriptionIdCount = idCount;
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_DeserializeAckV5( const MQTTPacketInfo_t * pIncomingPacket,
+                                    uint16_t * pPacketId,
+                                    bool * pSessionPresent,
+                                    MQTTConnackProperties_t * pConnackProperties )
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    if( pIncomingPacket == NULL )
+    {
+        LogError( ( "pIncomingPacket cannot be NULL." ) );
+        status = MQTTBadParameter;
+    }
+    else if( ( pPacketId == NULL ) &&
+             ( ( pIncomingPacket->type != MQTT_PACKET_TYPE_CONNACK ) &&
+               ( pIncomingPacket->type != MQTT_PACKET_TYPE_PINGRESP ) &&
+               ( pIncomingPacket->type != MQTT_PACKET_TYPE_DISCONNECT ) &&
+               ( pIncomingPacket->type != MQTT_PACKET_TYPE_AUTH ) ) )
+    {
+        LogError( ( "pPacketId cannot be NULL for packet type %02x.",
+                    ( unsigned int ) pIncomingPacket->type ) );
+        status = MQTTBadParameter;
+    }
+    else if( ( pSessionPresent == NULL ) &&
+             ( pIncomingPacket->type == MQTT_PACKET_TYPE_CONNACK ) )
+    {
+        LogError( ( "pSessionPresent cannot be NULL for CONNACK packet." ) );
+        status = MQTTBadParameter;
+    }
+    else if( ( pIncomingPacket->pRemainingData == NULL ) &&
+             ( pIncomingPacket->type != MQTT_PACKET_TYPE_PINGRESP ) &&
+             ( pIncomingPacket->remainingLength > 0U ) )
+    {
+        LogError( ( "Remaining data of incoming packet is NULL." ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        switch( pIncomingPacket->type )
+        {
+            case MQTT_PACKET_TYPE_CONNACK:
+                status = deserializeConnackV5( pIncomingPacket, pSessionPresent, pConnackProperties );
+                break;
+
+            case MQTT_PACKET_TYPE_SUBACK:
+            case MQTT_PACKET_TYPE_UNSUBACK:
+                status = deserializeSubscriptionAckV5( pIncomingPacket, pPacketId );
+                break;
+
+            case MQTT_PACKET_TYPE_PINGRESP:
+                status = deserializePingresp( pIncomingPacket );
+                break;
+
+            case MQTT_PACKET_TYPE_PUBACK:
+            case MQTT_PACKET_TYPE_PUBREC:
+            case MQTT_PACKET_TYPE_PUBREL:
+            case MQTT_PACKET_TYPE_PUBCOMP:
+                status = deserializePublishAckV5( pIncomingPacket, pPacketId );
+                break;
+
+            case MQTT_PACKET_TYPE_DISCONNECT:
+            case MQTT_PACKET_TYPE_AUTH:
+                status = deserializeDisconnectV5( pIncomingPacket );
+                break;
+
+            default:
+                LogError( ( "MQTT_DeserializeAckV5() called with unknown packet type:(%02x).",
+                            ( unsigned int ) pIncomingPacket->type ) );
+                status = MQTTBadResponse;
+                break;
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_GetReasonCodeV5( const MQTTPacketInfo_t * pIncomingPacket,
+                                   uint8_t * pReasonCode )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    size_t offset = 0U;
+
+    if( ( pIncomingPacket == NULL ) || ( pReasonCode == NULL ) )
+    {
+        LogError( ( "Arguments cannot be NULL: pIncomingPacket=%p, pReasonCode=%p.",
+                    ( const void * ) pIncomingPacket,
+                    ( void * ) pReasonCode ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        switch( pIncomingPacket->type )
+        {
+            case MQTT_PACKET_TYPE_PUBACK:
+            case MQTT_PACKET_TYPE_PUBREC:
+            case MQTT_PACKET_TYPE_PUBREL:
+            case MQTT_PACKET_TYPE_PUBCOMP:
+                /* The reason code follows the packet identifier. */
+                offset = sizeof( uint16_t );
+                break;
+
+            case MQTT_PACKET_TYPE_DISCONNECT:
+            case MQTT_PACKET_TYPE_AUTH:
+                offset = 0U;
+                break;
+
+            default:
+                LogError( ( "Packet type %02x has no single reason code.",
+                            ( unsigned int ) pIncomingPacket->type ) );
+                status = MQTTBadParameter;
+                break;
+        }
+    }
+
+    if( status != MQTTSuccess )
+    {
+        /* Nothing to read. */
+    }
+    else if( pIncomingPacket->remainingLength <= offset )
+    {
+        /* An omitted reason code means success. */
+        *pReasonCode = 0U;
+    }
+    else if( pIncomingPacket->pRemainingData == NULL )
+    {
+        LogError( ( "Remaining data of incoming packet is NULL." ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        *pReasonCode = pIncomingPacket->pRemainingData[ offset ];
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_GetSubAckReasonCodesV5( const MQTTPacketInfo_t * pIncomingPacket,
+                                          uint8_t ** ppReasonCodes,
+                                          size_t * pReasonCodeCount )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    const uint8_t * pProperties = NULL;
+    size_t propertiesLength = 0U, consumed = 0U;
+
+    if( ( pIncomingPacket == NULL ) || ( ppReasonCodes == NULL ) || ( pReasonCodeCount == NULL ) )
+    {
+        LogError( ( "Arguments cannot be NULL: pIncomingPacket=%p, ppReasonCodes=%p, "
+                    "pReasonCodeCount=%p.",
+                    ( const void * ) pIncomingPacket,
+                    ( void * ) ppReasonCodes,
+                    ( void * ) pReasonCodeCount ) );
+        status = MQTTBadParameter;
+    }
+    else if( ( pIncomingPacket->type != MQTT_PACKET_TYPE_SUBACK ) &&
+             ( pIncomingPacket->type != MQTT_PACKET_TYPE_UNSUBACK ) )
+    {
+        LogError( ( "Packet type %02x is not a SUBACK or UNSUBACK.",
+                    ( unsigned int ) pIncomingPacket->type ) );
+        status = MQTTBadParameter;
+    }
+    else if( ( pIncomingPacket->pRemainingData == NULL ) ||
+             ( pIncomingPacket->remainingLength <= sizeof( uint16_t ) ) )
+    {
+        LogError( ( "SUBACK or UNSUBACK has no property length." ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        /* The reason codes follow the packet identifier and the properties. */
+        if( getProperties( &pIncomingPacket->pRemainingData[ sizeof( uint16_t ) ],
+                           pIncomingPacket->remainingLength - sizeof( uint16_t ),
+                           &pProperties,
+                           &propertiesLength,
+                           &consumed ) != MQTTSuccess )
+        {
+            status = MQTTBadParameter;
+        }
+        else
+        {
+            *ppReasonCodes = &pIncomingPacket->pRemainingData[ sizeof( uint16_t ) + consumed ];
+            *pReasonCodeCount = pIncomingPacket->remainingLength - sizeof( uint16_t ) - consumed;
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool incomingServerPacketValid( uint8_t packetType )
+{
+    bool status = false;
+
+    /* Check packet type. Mask out lower bits to ignore flags. */
+    switch( packetType & 0xF0U )
+    {
+        /* The flags of PUBLISH are checked when it is deserialized. */
+        case MQTT_PACKET_TYPE_PUBLISH:
+            status = true;
+            break;
+
+        /* The flags of every other packet sent by a client are fixed by the
+         * spec, and a server must close a connection on which they differ. */
+        case MQTT_PACKET_TYPE_CONNECT:
+        case MQTT_PACKET_TYPE_PUBACK:
+        case MQTT_PACKET_TYPE_PUBREC:
+        case MQTT_PACKET_TYPE_PUBCOMP:
+        case MQTT_PACKET_TYPE_PINGREQ:
+        case MQTT_PACKET_TYPE_DISCONNECT:
+            status = ( ( packetType & 0x0FU ) == 0x00U );
+            break;
+
+        case ( MQTT_PACKET_TYPE_PUBREL & 0xF0U ):
+        case ( MQTT_PACKET_TYPE_SUBSCRIBE & 0xF0U ):
+        case ( MQTT_PACKET_TYPE_UNSUBSCRIBE & 0xF0U ):
+            status = ( ( packetType & 0x0FU ) == 0x02U );
+            break;
+
+        /* Any other packet type is invalid. */
+        default:
+            LogWarn( ( "Incoming packet invalid: Packet type=%u.",
+                       ( unsigned int ) packetType ) );
+            break;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t decodeString( const uint8_t * pBuffer,
+                                  size_t length,
+                                  size_t * pOffset,
+                                  const char ** ppString,
+                                  uint16_t * pStringLength )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    size_t offset = *pOffset;
+
+    if( ( length - offset ) < sizeof( uint16_t ) )
+    {
+        LogError( ( "Packet too short for the length of a field at offset %lu.",
+                    ( unsigned long ) offset ) );
+        status = MQTTBadResponse;
+    }
+    else
+    {
+        *pStringLength = UINT16_DECODE( ( &pBuffer[ offset ] ) );
+        offset += sizeof( uint16_t );
+
+        if( ( length - offset ) < ( size_t ) *pStringLength )
+        {
+            LogError( ( "Field of length %hu does not fit in the packet.",
+                        ( unsigned short ) *pStringLength ) );
+            status = MQTTBadResponse;
+        }
+        else
+        {
+            /* The field is not copied, so it is only valid as long as the
+             * buffer of the packet. */
+            *ppString = ( const char * ) &pBuffer[ offset ];
+            *pOffset = offset + ( size_t ) *pStringLength;
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t checkConnectFlags( uint8_t connectFlags )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    bool willFlag = UINT8_CHECK_BIT( connectFlags, MQTT_CONNECT_FLAG_WILL );
+
+    /* The lowest bit of the Connect Flags is reserved and must be 0. */
+    if( ( connectFlags & 0x01U ) != 0U )
+    {
+        LogError( ( "Reserved bit of the connect flags is set." ) );
+        status = MQTTBadResponse;
+    }
+    /* A Will QoS of 3 is invalid. */
+    else if( UINT8_CHECK_BIT( connectFlags, MQTT_CONNECT_FLAG_WILL_QOS1 ) &&
+             UINT8_CHECK_BIT( connectFlags, MQTT_CONNECT_FLAG_WILL_QOS2 ) )
+    {
+        LogError( ( "Will QoS of the connect flags is 3." ) );
+        status = MQTTBadResponse;
+    }
+    /* Without a will, the Will QoS and Will Retain flags must be 0. */
+    else if( ( willFlag == false ) &&
+             ( UINT8_CHECK_BIT( connectFlags, MQTT_CONNECT_FLAG_WILL_QOS1 ) ||
+               UINT8_CHECK_BIT( connectFlags, MQTT_CONNECT_FLAG_WILL_QOS2 ) ||
+               UINT8_CHECK_BIT( connectFlags, MQTT_CONNECT_FLAG_WILL_RETAIN ) ) )
+    {
+        LogError( ( "Will QoS or retain flag is set without a will." ) );
+        status = MQTTBadResponse;
+    }
+    /* MQTT 3.1.1 does not allow a password without a user name. */
+    else if( UINT8_CHECK_BIT( connectFlags, MQTT_CONNECT_FLAG_PASSWORD ) &&
+             ( UINT8_CHECK_BIT( connectFlags, MQTT_CONNECT_FLAG_USERNAME ) == false ) )
+    {
+        LogError( ( "Password flag is set without the user name flag." ) );
+        status = MQTTBadResponse;
+    }
+    else
+    {
+        /* Empty else MISRA 15.7 */
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t deserializeConnect( const MQTTPacketInfo_t * pConnect,
+                                        MQTTConnectInfo_t * pConnectInfo,
+                                        MQTTPublishInfo_t * pWillInfo,
+                                        bool * pWillPresent )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    const uint8_t * pVariableHeader = pConnect->pRemainingData;
+    size_t remainingLength = pConnect->remainingLength;
+    size_t offset = MQTT_PACKET_CONNECT_HEADER_SIZE;
+    uint8_t connectFlags = 0U;
+    const char * pWillPayload = NULL;
+    uint16_t willPayloadLength = 0U;
+
+    assert( pConnectInfo != NULL );
+    assert( pWillInfo != NULL );
+    assert( pWillPresent != NULL );
+
+    /* The variable header holds the protocol name "MQTT", the protocol level,
+     * the connect flags and the keep alive. */
+    if( remainingLength < MQTT_PACKET_CONNECT_HEADER_SIZE )
+    {
+        LogError( ( "CONNECT cannot have a remaining length less than %lu.",
+                    ( unsigned long ) MQTT_PACKET_CONNECT_HEADER_SIZE ) );
+        status = MQTTBadResponse;
+    }
+    else if( ( UINT16_DECODE( pVariableHeader ) != 4U ) ||
+             ( memcmp( &pVariableHeader[ 2 ], "MQTT", 4U ) != 0 ) )
+    {
+        LogError( ( "CONNECT does not carry the protocol name MQTT." ) );
+        status = MQTTBadResponse;
+    }
+    else if( pVariableHeader[ 6 ] != MQTT_VERSION_3_1_1 )
+    {
+        LogError( ( "CONNECT has unsupported protocol level %u.",
+                    ( unsigned int ) pVariableHeader[ 6 ] ) );
+        status = MQTTBadResponse;
+    }
+    else
+    {
+        connectFlags = pVariableHeader[ 7 ];
+        status = checkConnectFlags( connectFlags );
+    }
+
+    if( status == MQTTSuccess )
+    {
+        pConnectInfo->cleanSession = UINT8_CHECK_BIT( connectFlags, MQTT_CONNECT_FLAG_CLEAN );
+        pConnectInfo->keepAliveSeconds = UINT16_DECODE( ( &pVariableHeader[ 8 ] ) );
+        pConnectInfo->pUserName = NULL;
+        pConnectInfo->userNameLength = 0U;
+        pConnectInfo->pPassword = NULL;
+        pConnectInfo->passwordLength = 0U;
+        *pWillPresent = UINT8_CHECK_BIT( connectFlags, MQTT_CONNECT_FLAG_WILL );
+        ( void ) memset( pWillInfo, 0x00, sizeof( MQTTPublishInfo_t ) );
+
+        /* The client identifier always comes first in the payload. */
+        status = decodeString( pVariableHeader, remainingLength, &offset,
+                               &pConnectInfo->pClientIdentifier,
+                               &pConnectInfo->clientIdentifierLength );
+    }
+
+    if( ( status == MQTTSuccess ) && ( *pWillPresent == true ) )
+    {
+        status = decodeString( pVariableHeader, remainingLength, &offset,
+                               &pWillInfo->pTopicName,
+                               &pWillInfo->topicNameLength );
+
+        if( status == MQTTSuccess )
+        {
+            status = decodeString( pVariableHeader, remainingLength, &offset,
+                                   &pWillPayload, &willPayloadLength );
+        }
+
+        if( ( status == MQTTSuccess ) && ( pWillInfo->topicNameLength == 0U ) )
+        {
+            LogError( ( "Will topic cannot be empty." ) );
+            status = MQTTBadResponse;
+        }
+
+        if( status == MQTTSuccess )
+        {
+            pWillInfo->pPayload = ( willPayloadLength != 0U ) ? pWillPayload : NULL;
+            pWillInfo->payloadLength = willPayloadLength;
+            pWillInfo->retain = UINT8_CHECK_BIT( connectFlags, MQTT_CONNECT_FLAG_WILL_RETAIN );
+
+            if( UINT8_CHECK_BIT( connectFlags, MQTT_CONNECT_FLAG_WILL_QOS1 ) )
+            {
+                pWillInfo->qos = MQTTQoS1;
+            }
+            else if( UINT8_CHECK_BIT( connectFlags, MQTT_CONNECT_FLAG_WILL_QOS2 ) )
+            {
+                pWillInfo->qos = MQTTQoS2;
+            }
+            else
+            {
+                pWillInfo->qos = MQTTQoS0;
+            }
+        }
+    }
+
+    if( ( status == MQTTSuccess ) && UINT8_CHECK_BIT( connectFlags, MQTT_CONNECT_FLAG_USERNAME ) )
+    {
+        status = decodeString( pVariableHeader, remainingLength, &offset,
+                               &pConnectInfo->pUserName,
+                               &pConnectInfo->userNameLength );
+    }
+
+    if( ( status == MQTTSuccess ) && UINT8_CHECK_BIT( connectFlags, MQTT_CONNECT_FLAG_PASSWORD ) )
+    {
+        status = decodeString( pVariableHeader, remainingLength, &offset,
+                               &pConnectInfo->pPassword,
+                               &pConnectInfo->passwordLength );
+    }
+
+    if( ( status == MQTTSuccess ) && ( offset != remainingLength ) )
+    {
+        LogError( ( "CONNECT has %lu bytes after its payload.",
+                    ( unsigned long ) ( remainingLength - offset ) ) );
+        status = MQTTBadResponse;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t deserializeSubscriptions( const MQTTPacketInfo_t * pPacket,
+                                              uint16_t * pPacketId,
+                                              MQTTSubscribeInfo_t * pSubscriptionList,
+                                              size_t * pSubscriptionCount )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    const uint8_t * pVariableHeader = pPacket->pRemainingData;
+    size_t remainingLength = pPacket->remainingLength;
+    size_t offset = sizeof( uint16_t );
+    size_t count = 0U;
+    bool subscribe = ( pPacket->type == MQTT_PACKET_TYPE_SUBSCRIBE );
+    MQTTSubscribeInfo_t * pSubscription = NULL;
+    uint8_t requestedQoS;
+
+    assert( pPacketId != NULL );
+    assert( pSubscriptionList != NULL );
+    assert( pSubscriptionCount != NULL );
+
+    /* The packet identifier must be followed by at least one topic filter. */
+    if( remainingLength <= sizeof( uint16_t ) )
+    {
+        LogError( ( "Packet type %02x must have at least one topic filter.",
+                    ( unsigned int ) pPacket->type ) );
+        status = MQTTBadResponse;
+    }
+    else
+    {
+        *pPacketId = UINT16_DECODE( pVariableHeader );
+
+        if( *pPacketId == 0U )
+        {
+            LogError( ( "Packet identifier cannot be 0." ) );
+            status = MQTTBadResponse;
+        }
+    }
+
+    while( ( status == MQTTSuccess ) && ( offset < remainingLength ) )
+    {
+        if( count == *pSubscriptionCount )
+        {
+            LogError( ( "Packet has more than %lu topic filters.",
+                        ( unsigned long ) *pSubscriptionCount ) );
+            status = MQTTNoMemory;
+        }
+        else
+        {
+            pSubscription = &pSubscriptionList[ count ];
+            pSubscription->qos = MQTTQoS0;
+            status = decodeString( pVariableHeader, remainingLength, &offset,
+                                   &pSubscription->pTopicFilter,
+                                   &pSubscription->topicFilterLength );
+        }
+
+        if( ( status == MQTTSuccess ) && ( pSubscription->topicFilterLength == 0U ) )
+        {
+            LogError( ( "Topic filter cannot be empty." ) );
+            status = MQTTBadResponse;
+        }
+
+        /* Each topic filter of a SUBSCRIBE is followed by the requested QoS,
+         * whose upper 6 bits are reserved. */
+        if( ( status == MQTTSuccess ) && ( subscribe == true ) )
+        {
+            if( offset == remainingLength )
+            {
+                LogError( ( "SUBSCRIBE is missing the QoS of its last topic filter." ) );
+                status = MQTTBadResponse;
+            }
+            else
+            {
+                requestedQoS = pVariableHeader[ offset ];
+                offset++;
+
+                if( requestedQoS > ( uint8_t ) MQTTQoS2 )
+                {
+                    LogError( ( "Invalid requested QoS %u.", ( unsigned int ) requestedQoS ) );
+                    status = MQTTBadResponse;
+                }
+                else
+                {
+                    pSubscription->qos = ( MQTTQoS_t ) requestedQoS;
+                }
+            }
+        }
+
+        if( status == MQTTSuccess )
+        {
+            count++;
+        }
+    }
+
+    if( status == MQTTSuccess )
+    {
+        *pSubscriptionCount = count;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t deserializeEmptyPacket( const MQTTPacketInfo_t * pPacket,
+                                            uint8_t packetType )
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    if( pPacket == NULL )
+    {
+        LogError( ( "pIncomingPacket cannot be NULL." ) );
+        status = MQTTBadParameter;
+    }
+    else if( pPacket->type != packetType )
+    {
+        LogError( ( "Packet type %02x is not %02x.",
+                    ( unsigned int ) pPacket->type,
+                    ( unsigned int ) packetType ) );
+        status = MQTTBadParameter;
+    }
+    else if( pPacket->remainingLength != 0U )
+    {
+        LogError( ( "Packet type %02x does not have remaining length of 0.",
+                    ( unsigned int ) packetType ) );
+        status = MQTTBadResponse;
+    }
+    else
+    {
+        /* Empty else MISRA 15.7 */
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_ProcessIncomingServerPacketTypeAndLength( const uint8_t * pBuffer,
+                                                            const size_t * pIndex,
+                                                            MQTTPacketInfo_t * pIncomingPacket )
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    if( ( pIncomingPacket == NULL ) || ( pIndex == NULL ) || ( pBuffer == NULL ) )
+    {
+        LogError( ( "Argument cannot be NULL: pBuffer=%p, pIndex=%p, pIncomingPacket=%p.",
+                    ( const void * ) pBuffer,
+                    ( const void * ) pIndex,
+                    ( void * ) pIncomingPacket ) );
+        status = MQTTBadParameter;
+    }
+    /* There should be at least one byte in the buffer */
+    else if( *pIndex < 1U )
+    {
+        status = MQTTNoDataAvailable;
+    }
+    else
+    {
+        pIncomingPacket->type = pBuffer[ 0 ];
+    }
+
+    if( status == MQTTSuccess )
+    {
+        if( incomingServerPacketValid( pIncomingPacket->type ) == true )
+        {
+            status = processRemainingLength( pBuffer,
+                                             pIndex,
+                                             pIncomingPacket );
+        }
+        else
+        {
+            LogError( ( "Incoming packet invalid: Packet type=%u.",
+                        ( unsigned int ) pIncomingPacket->type ) );
+            status = MQTTBadResponse;
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_DeserializeConnect( const MQTTPacketInfo_t * pIncomingPacket,
+                                      MQTTConnectInfo_t * pConnectInfo,
+                                      MQTTPublishInfo_t * pWillInfo,
+                                      bool * pWillPresent )
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    if( ( pIncomingPacket == NULL ) || ( pConnectInfo == NULL ) ||
+        ( pWillInfo == NULL ) || ( pWillPresent == NULL ) )
+    {
+        LogError( ( "Argument cannot be NULL: pIncomingPacket=%p, "
+                    "pConnectInfo=%p, pWillInfo=%p, pWillPresent=%p.",
+                    ( const void * ) pIncomingPacket,
+                    ( void * ) pConnectInfo,
+                    ( void * ) pWillInfo,
+                    ( void * ) pWillPresent ) );
+        status = MQTTBadParameter;
+    }
+    else if( pIncomingPacket->type != MQTT_PACKET_TYPE_CONNECT )
+    {
+        LogError( ( "Packet is not CONNECT. Packet type: %02x.",
+                    ( unsigned int ) pIncomingPacket->type ) );
+        status = MQTTBadParameter;
+    }
+    else if( pIncomingPacket->pRemainingData == NULL )
+    {
+        LogError( ( "Remaining data of incoming packet is NULL." ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        status = deserializeConnect( pIncomingPacket, pConnectInfo, pWillInfo, pWillPresent );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_DeserializeSubscribe( const MQTTPacketInfo_t * pIncomingPacket,
+                                        uint16_t * pPacketId,
+                                        MQTTSubscribeInfo_t * pSubscriptionList,
+                                        size_t * pSubscriptionCount )
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    if( ( pIncomingPacket == NULL ) || ( pPacketId == NULL ) ||
+        ( pSubscriptionList == NULL ) || ( pSubscriptionCount == NULL ) )
+    {
+        LogError( ( "Argument cannot be NULL: pIncomingPacket=%p, pPacketId=%p, "
+                    "pSubscriptionList=%p, pSubscriptionCount=%p.",
+                    ( const void * ) pIncomingPacket,
+                    ( void * ) pPacketId,
+                    ( void * ) pSubscriptionList,
+                    ( void * ) pSubscriptionCount ) );
+        status = MQTTBadParameter;
+    }
+    else if( pIncomingPacket->type != MQTT_PACKET_TYPE_SUBSCRIBE )
+    {
+        LogError( ( "Packet is not SUBSCRIBE. Packet type: %02x.",
+                    ( unsigned int ) pIncomingPacket->type ) );
+        status = MQTTBadParameter;
+    }
+    else if( pIncomingPacket->pRemainingData == NULL )
+    {
+        LogError( ( "Remaining data of incoming packet is NULL." ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        status = deserializeSubscriptions( pIncomingPacket, pPacketId,
+                                           pSubscriptionList, pSubscriptionCount );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_DeserializeUnsubscribe( const MQTTPacketInfo_t * pIncomingPacket,
+                                          uint16_t * pPacketId,
+                                          MQTTSubscribeInfo_t * pSubscriptionList,
+                                          size_t * pSubscriptionCount )
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    if( ( pIncomingPacket == NULL ) || ( pPacketId == NULL ) ||
+        ( pSubscriptionList == NULL ) || ( pSubscriptionCount == NULL ) )
+    {
+        LogError( ( "Argument cannot be NULL: pIncomingPacket=%p, pPacketId=%p, "
+                    "pSubscriptionList=%p, pSubscriptionCount=%p.",
+                    ( const void * ) pIncomingPacket,
+                    ( void * ) pPacketId,
+                    ( void * ) pSubscriptionList,
+                    ( void * ) pSubscriptionCount ) );
+        status = MQTTBadParameter;
+    }
+    else if( pIncomingPacket->type != MQTT_PACKET_TYPE_UNSUBSCRIBE )
+    {
+        LogError( ( "Packet is not UNSUBSCRIBE. Packet type: %02x.",
+                    ( unsigned int ) pIncomingPacket->type ) );
+        status = MQTTBadParameter;
+    }
+    else if( pIncomingPacket->pRemainingData == NULL )
+    {
+        LogError( ( "Remaining data of incoming packet is NULL." ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        status = deserializeSubscriptions( pIncomingPacket, pPacketId,
+                                           pSubscriptionList, pSubscriptionCount );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_DeserializePingreq( const MQTTPacketInfo_t * pIncomingPacket )
+{
+    return deserializeEmptyPacket( pIncomingPacket, MQTT_PACKET_TYPE_PINGREQ );
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_DeserializeDisconnect( const MQTTPacketInfo_t * pIncomingPacket )
+{
+    return deserializeEmptyPacket( pIncomingPacket, MQTT_PACKET_TYPE_DISCONNECT );
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_SerializeConnack( const MQTTFixedBuffer_t * pFixedBuffer,
+                                    bool sessionPresent,
+                                    uint8_t returnCode )
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    if( ( pFixedBuffer == NULL ) || ( pFixedBuffer->pBuffer == NULL ) )
+    {
+        LogError( ( "pFixedBuffer and pFixedBuffer->pBuffer cannot be NULL." ) );
+        status = MQTTBadParameter;
+    }
+    else if( pFixedBuffer->size < MQTT_CONNACK_PACKET_SIZE )
+    {
+        LogError( ( "Insufficient memory for packet." ) );
+        status = MQTTNoMemory;
+    }
+    /* MQTT 3.1.1 defines return codes 0 to 5. */
+    else if( returnCode > 5U )
+    {
+        LogError( ( "Invalid CONNACK return code %u.", ( unsigned int ) returnCode ) );
+        status = MQTTBadParameter;
+    }
+    /* A refused connection never has a session. */
+    else if( ( returnCode != 0U ) && ( sessionPresent == true ) )
+    {
+        LogError( ( "Session present must be 0 for return code %u.",
+                    ( unsigned int ) returnCode ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        pFixedBuffer->pBuffer[ 0 ] = MQTT_PACKET_TYPE_CONNACK;
+        pFixedBuffer->pBuffer[ 1 ] = MQTT_PACKET_CONNACK_REMAINING_LENGTH;
+        pFixedBuffer->pBuffer[ 2 ] = ( sessionPresent == true ) ? MQTT_PACKET_CONNACK_SESSION_PRESENT_MASK : 0U;
+        pFixedBuffer->pBuffer[ 3 ] = returnCode;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_GetSubackPacketSize( size_t returnCodeCount,
+                                       size_t * pRemainingLength,
+                                       size_t * pPacketSize )
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    if( ( pRemainingLength == NULL ) || ( pPacketSize == NULL ) )
+    {
+        LogError( ( "Argument cannot be NULL: pRemainingLength=%p, pPacketSize=%p.",
+                    ( void * ) pRemainingLength,
+                    ( void * ) pPacketSize ) );
+        status = MQTTBadParameter;
+    }
+    else if( ( returnCodeCount == 0U ) ||
+             ( returnCodeCount > ( MQTT_MAX_REMAINING_LENGTH - sizeof( uint16_t ) ) ) )
+    {
+        LogError( ( "Invalid return code count %lu.", ( unsigned long ) returnCodeCount ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        /* The packet identifier is followed by one return code per topic
+         * filter of the SUBSCRIBE. */
+        *pRemainingLength = sizeof( uint16_t ) + returnCodeCount;
+        *pPacketSize = 1U + remainingLengthEncodedSize( *pRemainingLength ) + *pRemainingLength;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_SerializeSuback( const uint8_t * pReturnCodes,
+                                   size_t returnCodeCount,
+                                   uint16_t packetId,
+                                   size_t remainingLength,
+                                   const MQTTFixedBuffer_t * pFixedBuffer )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    size_t packetSize = 0U, i;
+    uint8_t * pIndex;
+
+    if( ( pReturnCodes == NULL ) || ( pFixedBuffer == NULL ) || ( pFixedBuffer->pBuffer == NULL ) )
+    {
+        LogError( ( "Argument cannot be NULL: pReturnCodes=%p, pFixedBuffer=%p.",
+                    ( const void * ) pReturnCodes,
+                    ( const void * ) pFixedBuffer ) );
+        status = MQTTBadParameter;
+    }
+    else if( packetId == 0U )
+    {
+        LogError( ( "Packet ID cannot be 0." ) );
+        status = MQTTBadParameter;
+    }
+    else if( ( returnCodeCount == 0U ) || ( remainingLength != ( sizeof( uint16_t ) + returnCodeCount ) ) )
+    {
+        LogError( ( "Remaining length %lu does not match %lu return codes.",
+                    ( unsigned long ) remainingLength,
+                    ( unsigned long ) returnCodeCount ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        packetSize = 1U + remainingLengthEncodedSize( remainingLength ) + remainingLength;
+
+        if( pFixedBuffer->size < packetSize )
+        {
+            LogError( ( "Buffer size of %lu is not sufficient to hold "
+                        "serialized SUBACK packet of size of %lu.",
+                        ( unsigned long ) pFixedBuffer->size,
+                        ( unsigned long ) packetSize ) );
+            status = MQTTNoMemory;
+        }
+    }
+
+    /* MQTT 3.1.1 defines the granted QoS 0 to 2 and failure. */
+    for( i = 0U; ( status == MQTTSuccess ) && ( i < returnCodeCount ); i++ )
+    {
+        if( ( pReturnCodes[ i ] > 0x02U ) && ( pReturnCodes[ i ] != MQTT_REASON_CODE_FAILURE ) )
+        {
+            LogError( ( "Invalid SUBACK return code %u.", ( unsigned int ) pReturnCodes[ i ] ) );
+            status = MQTTBadParameter;
+        }
+    }
+
+    if( status == MQTTSuccess )
+    {
+        pIndex = pFixedBuffer->pBuffer;
+        *pIndex = MQTT_PACKET_TYPE_SUBACK;
+        pIndex++;
+        pIndex = encodeRemainingLength( pIndex, remainingLength );
+        pIndex[ 0 ] = UINT16_HIGH_BYTE( packetId );
+        pIndex[ 1 ] = UINT16_LOW_BYTE( packetId );
+        ( void ) memcpy( ( void * ) &pIndex[ 2 ], ( const void * ) pReturnCodes, returnCodeCount );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_SerializeUnsuback( const MQTTFixedBuffer_t * pFixedBuffer,
+                                     uint16_t packetId )
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    if( ( pFixedBuffer == NULL ) || ( pFixedBuffer->pBuffer == NULL ) )
+    {
+        LogError( ( "pFixedBuffer and pFixedBuffer->pBuffer cannot be NULL." ) );
+        status = MQTTBadParameter;
+    }
+    else if( pFixedBuffer->size < MQTT_UNSUBACK_PACKET_SIZE )
+    {
+        LogError( ( "Insufficient memory for packet." ) );
+        status = MQTTNoMemory;
+    }
+    else if( packetId == 0U )
+    {
+        LogError( ( "Packet ID cannot be 0." ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        pFixedBuffer->pBuffer[ 0 ] = MQTT_PACKET_TYPE_UNSUBACK;
+        pFixedBuffer->pBuffer[ 1 ] = MQTT_PACKET_SIMPLE_ACK_REMAINING_LENGTH;
+        pFixedBuffer->pBuffer[ 2 ] = UINT16_HIGH_BYTE( packetId );
+        pFixedBuffer->pBuffer[ 3 ] = UINT16_LOW_BYTE( packetId );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_SerializePingresp( const MQTTFixedBuffer_t * pFixedBuffer )
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    if( ( pFixedBuffer == NULL ) || ( pFixedBuffer->pBuffer == NULL ) )
+    {
+        LogError( ( "pFixedBuffer and pFixedBuffer->pBuffer cannot be NULL." ) );
+        status = MQTTBadParameter;
+    }
+    else if( pFixedBuffer->size < MQTT_PINGRESP_PACKET_SIZE )
+    {
+        LogError( ( "Insufficient memory for packet." ) );
+        status = MQTTNoMemory;
+    }
+    else
+    {
+        /* Ping response packets are always the same. */
+        pFixedBuffer->pBuffer[ 0 ] = MQTT_PACKET_TYPE_PINGRESP;
+        pFixedBuffer->pBuffer[ 1 ] = ( uint8_t ) MQTT_PACKET_PINGRESP_REMAINING_LENGTH;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
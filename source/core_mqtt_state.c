@@ -33,6 +33,9 @@
 /* Include config defaults header to get default values of configs. */
 #include "core_mqtt_config_defaults.h"
 
+/* The state engine is only needed for QoS1 and QoS2 publishes. */
+#if ( MQTT_QOS0_ONLY == 0 )
+
 /*-----------------------------------------------------------*/
 
 /**
@@ -1204,3 +1207,5 @@ const char * MQTT_State_strerror( MQTTPublishState_t state )
 }
 
 /*-----------------------------------------------------------*/
+
+#endif /* if ( MQTT_QOS0_ONLY == 0 ) */
@@ -0,0 +1,439 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file core_mqtt_striped.c
+ * @brief Implements the functions in core_mqtt_striped.h.
+ */
+#include <stddef.h>
+
+#include "core_mqtt_striped.h"
+
+/* Include config defaults header to get default values of configs. */
+#include "core_mqtt_config_defaults.h"
+
+/**
+ * @brief Offset basis of the 32-bit FNV-1a hash routing topics to stripes.
+ */
+#define STRIPED_FNV_OFFSET_BASIS    ( 2166136261UL )
+
+/**
+ * @brief Prime of the 32-bit FNV-1a hash routing topics to stripes.
+ */
+#define STRIPED_FNV_PRIME           ( 16777619UL )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Event callback of every stripe, forwarding packets to the callback
+ * of the striped client.
+ *
+ * @param[in] pContext The context of the stripe.
+ * @param[in] pPacketInfo Information on the type of incoming MQTT packet.
+ * @param[in] pDeserializedInfo Deserialized information from incoming packet.
+ */
+static void stripeEventCallback( MQTTContext_t * pContext,
+                                 MQTTPacketInfo_t * pPacketInfo,
+                                 MQTTDeserializedInfo_t * pDeserializedInfo );
+
+/**
+ * @brief Check that a striped client is initialized.
+ *
+ * @param[in] pClient The striped client.
+ *
+ * @return true if the client can be used; false otherwise.
+ */
+static bool isValidClient( const MQTTStripedClient_t * pClient );
+
+/**
+ * @brief Validate a subscription and find the stripe carrying it.
+ *
+ * @param[in] pClient The striped client.
+ * @param[in] pSubscription The subscription.
+ * @param[out] pStripe Receives the stripe carrying the topic filter.
+ *
+ * @return #MQTTBadParameter or #MQTTSuccess.
+ */
+static MQTTStatus_t getSubscriptionStripe( const MQTTStripedClient_t * pClient,
+                                           const MQTTSubscribeInfo_t * pSubscription,
+                                           MQTTStripe_t ** pStripe );
+
+/*-----------------------------------------------------------*/
+
+static void stripeEventCallback( MQTTContext_t * pContext,
+                                 MQTTPacketInfo_t * pPacketInfo,
+                                 MQTTDeserializedInfo_t * pDeserializedInfo )
+{
+    /* The context is the first member of its stripe. */
+    const MQTTStripe_t * pStripe = ( const MQTTStripe_t * ) pContext;
+
+    pStripe->pClient->appCallback( pStripe->pClient,
+                                   pStripe->stripeIndex,
+                                   pPacketInfo,
+                                   pDeserializedInfo );
+}
+
+/*-----------------------------------------------------------*/
+
+static bool isValidClient( const MQTTStripedClient_t * pClient )
+{
+    return ( pClient != NULL ) && ( pClient->pStripes != NULL ) && ( pClient->stripeCount > 0U );
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t getSubscriptionStripe( const MQTTStripedClient_t * pClient,
+                                           const MQTTSubscribeInfo_t * pSubscription,
+                                           MQTTStripe_t ** pStripe )
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    if( ( isValidClient( pClient ) == false ) || ( pSubscription == NULL ) ||
+        ( pSubscription->pTopicFilter == NULL ) || ( pSubscription->topicFilterLength == 0U ) )
+    {
+        LogError( ( "Invalid parameter: pClient=%p, pSubscription=%p.",
+                    ( const void * ) pClient,
+                    ( const void * ) pSubscription ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        *pStripe = &pClient->pStripes[ MQTTStriped_GetStripeIndex( pClient,
+                                                                   pSubscription->pTopicFilter,
+                                                                   pSubscription->topicFilterLength ) ];
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTTStriped_Init( MQTTStripedClient_t * pClient,
+                               MQTTStripe_t * pStripes,
+                               size_t stripeCount,
+                               const TransportInterface_t * pTransportInterfaces,
+                               MQTTGetCurrentTimeFunc_t getTimeFunction,
+                               MQTTStripedEventCallback_t userCallback,
+                               const MQTTFixedBuffer_t * pNetworkBuffers )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    size_t index;
+
+    if( ( pClient == NULL ) || ( pStripes == NULL ) || ( stripeCount == 0U ) ||
+        ( pTransportInterfaces == NULL ) || ( userCallback == NULL ) || ( pNetworkBuffers == NULL ) )
+    {
+        LogError( ( "Invalid parameter: pClient=%p, pStripes=%p, stripeCount=%lu, "
+                    "pTransportInterfaces=%p, pNetworkBuffers=%p.",
+                    ( void * ) pClient,
+                    ( void * ) pStripes,
+                    ( unsigned long ) stripeCount,
+                    ( const void * ) pTransportInterfaces,
+                    ( const void * ) pNetworkBuffers ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        pClient->pStripes = pStripes;
+        pClient->stripeCount = stripeCount;
+        pClient->appCallback = userCallback;
+
+        for( index = 0U; ( index < stripeCount ) && ( status == MQTTSuccess ); index++ )
+        {
+            status = MQTT_Init( &pStripes[ index ].context,
+                                &pTransportInterfaces[ index ],
+                                getTimeFunction,
+                                stripeEventCallback,
+                                &pNetworkBuffers[ index ] );
+            pStripes[ index ].pClient = pClient;
+            pStripes[ index ].stripeIndex = index;
+        }
+
+        if( status != MQTTSuccess )
+        {
+            pClient->pStripes = NULL;
+            pClient->stripeCount = 0U;
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTContext_t * MQTTStriped_GetContext( const MQTTStripedClient_t * pClient,
+                                        size_t stripeIndex )
+{
+    MQTTContext_t * pContext = NULL;
+
+    if( ( isValidClient( pClient ) == true ) && ( stripeIndex < pClient->stripeCount ) )
+    {
+        pContext = &pClient->pStripes[ stripeIndex ].context;
+    }
+
+    return pContext;
+}
+
+/*-----------------------------------------------------------*/
+
+size_t MQTTStriped_GetStripeIndex( const MQTTStripedClient_t * pClient,
+                                   const char * pTopic,
+                                   uint16_t topicLength )
+{
+    uint32_t hash = STRIPED_FNV_OFFSET_BASIS;
+    size_t stripeIndex = 0U;
+    uint16_t index;
+
+    if( ( isValidClient( pClient ) == true ) && ( pTopic != NULL ) )
+    {
+        for( index = 0U; index < topicLength; index++ )
+        {
+            hash ^= ( uint32_t ) ( ( uint8_t ) pTopic[ index ] );
+            hash *= STRIPED_FNV_PRIME;
+        }
+
+        stripeIndex = ( size_t ) hash % pClient->stripeCount;
+    }
+
+    return stripeIndex;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTTStriped_Connect( MQTTStripedClient_t * pClient,
+                                  const MQTTConnectInfo_t * pConnectInfos,
+                                  const MQTTPublishInfo_t * pWillInfo,
+                                  uint32_t timeoutMs,
+                                  bool * pSessionPresent )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    bool sessionPresent = false;
+    size_t index;
+
+    if( ( isValidClient( pClient ) == false ) || ( pConnectInfos == NULL ) )
+    {
+        LogError( ( "Invalid parameter: pClient=%p, pConnectInfos=%p.",
+                    ( void * ) pClient,
+                    ( const void * ) pConnectInfos ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        for( index = 0U; ( index < pClient->stripeCount ) && ( status == MQTTSuccess ); index++ )
+        {
+            status = MQTT_Connect( &pClient->pStripes[ index ].context,
+                                   &pConnectInfos[ index ],
+                                   ( index == 0U ) ? pWillInfo : NULL,
+                                   timeoutMs,
+                                   &sessionPresent );
+
+            if( pSessionPresent != NULL )
+            {
+                pSessionPresent[ index ] = sessionPresent;
+            }
+
+            if( status != MQTTSuccess )
+            {
+                LogError( ( "Stripe %lu failed to connect: %s.",
+                            ( unsigned long ) index,
+                            MQTT_Status_strerror( status ) ) );
+            }
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTTStriped_Publish( MQTTStripedClient_t * pClient,
+                                  const MQTTPublishInfo_t * pPublishInfo,
+                                  size_t * pStripeIndex,
+                                  uint16_t * pPacketId )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    size_t stripeIndex = 0U;
+    uint16_t packetId = 0U;
+
+    if( ( isValidClient( pClient ) == false ) || ( pPublishInfo == NULL ) ||
+        ( pPublishInfo->pTopicName == NULL ) )
+    {
+        LogError( ( "Invalid parameter: pClient=%p, pPublishInfo=%p.",
+                    ( void * ) pClient,
+                    ( const void * ) pPublishInfo ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        stripeIndex = MQTTStriped_GetStripeIndex( pClient,
+                                                  pPublishInfo->pTopicName,
+                                                  pPublishInfo->topicNameLength );
+
+        if( pPublishInfo->qos != MQTTQoS0 )
+        {
+            packetId = MQTT_GetPacketId( &pClient->pStripes[ stripeIndex ].context );
+        }
+
+        status = MQTT_Publish( &pClient->pStripes[ stripeIndex ].context, pPublishInfo, packetId );
+    }
+
+    if( pStripeIndex != NULL )
+    {
+        *pStripeIndex = stripeIndex;
+    }
+
+    if( pPacketId != NULL )
+    {
+        *pPacketId = packetId;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTTStriped_Subscribe( MQTTStripedClient_t * pClient,
+                                    const MQTTSubscribeInfo_t * pSubscription,
+                                    size_t * pStripeIndex,
+                                    uint16_t * pPacketId )
+{
+    MQTTStripe_t * pStripe = NULL;
+    uint16_t packetId = 0U;
+    MQTTStatus_t status = getSubscriptionStripe( pClient, pSubscription, &pStripe );
+
+    if( status == MQTTSuccess )
+    {
+        packetId = MQTT_GetPacketId( &pStripe->context );
+        status = MQTT_Subscribe( &pStripe->context, pSubscription, 1U, packetId );
+
+        if( pStripeIndex != NULL )
+        {
+            *pStripeIndex = pStripe->stripeIndex;
+        }
+    }
+
+    if( pPacketId != NULL )
+    {
+        *pPacketId = packetId;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTTStriped_Unsubscribe( MQTTStripedClient_t * pClient,
+                                      const MQTTSubscribeInfo_t * pSubscription,
+                                      size_t * pStripeIndex,
+                                      uint16_t * pPacketId )
+{
+    MQTTStripe_t * pStripe = NULL;
+    uint16_t packetId = 0U;
+    MQTTStatus_t status = getSubscriptionStripe( pClient, pSubscription, &pStripe );
+
+    if( status == MQTTSuccess )
+    {
+        packetId = MQTT_GetPacketId( &pStripe->context );
+        status = MQTT_Unsubscribe( &pStripe->context, pSubscription, 1U, packetId );
+
+        if( pStripeIndex != NULL )
+        {
+            *pStripeIndex = pStripe->stripeIndex;
+        }
+    }
+
+    if( pPacketId != NULL )
+    {
+        *pPacketId = packetId;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTTStriped_ProcessLoop( MQTTStripedClient_t * pClient )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTStatus_t stripeStatus;
+    size_t index;
+
+    if( isValidClient( pClient ) == false )
+    {
+        LogError( ( "Invalid parameter: pClient=%p.", ( void * ) pClient ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        /* A failed stripe must not starve the others. */
+        for( index = 0U; index < pClient->stripeCount; index++ )
+        {
+            stripeStatus = MQTT_ProcessLoop( &pClient->pStripes[ index ].context );
+
+            if( ( status == MQTTSuccess ) && ( stripeStatus != MQTTSuccess ) &&
+                ( stripeStatus != MQTTNeedMoreBytes ) )
+            {
+                LogError( ( "Stripe %lu failed: %s.",
+                            ( unsigned long ) index,
+                            MQTT_Status_strerror( stripeStatus ) ) );
+                status = stripeStatus;
+            }
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTTStriped_Disconnect( MQTTStripedClient_t * pClient )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTStatus_t stripeStatus;
+    size_t index;
+
+    if( isValidClient( pClient ) == false )
+    {
+        LogError( ( "Invalid parameter: pClient=%p.", ( void * ) pClient ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        for( index = 0U; index < pClient->stripeCount; index++ )
+        {
+            if( pClient->pStripes[ index ].context.connectStatus == MQTTConnected )
+            {
+                stripeStatus = MQTT_Disconnect( &pClient->pStripes[ index ].context );
+
+                if( ( status == MQTTSuccess ) && ( stripeStatus != MQTTSuccess ) )
+                {
+                    status = stripeStatus;
+                }
+            }
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
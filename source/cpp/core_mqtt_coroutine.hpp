@@ -0,0 +1,702 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file core_mqtt_coroutine.hpp
+ * @brief Optional header-only C++20 layer awaiting the operations of an MQTT
+ * context with coroutines.
+ *
+ * A #coremqtt::Client owns an MQTT context. `co_await client.publish( info )`
+ * resumes the coroutine when the PUBACK or PUBCOMP of the publish is received,
+ * `co_await client.subscribe( list, count )` when the SUBACK is received, and
+ * `co_await client.receive()` when the next incoming publish is received. The
+ * operations are built on #MQTT_PublishWithCompletion and
+ * #MQTT_SubscribeWithCompletion; their state lives in the awaiter, which is
+ * part of the frame of the awaiting coroutine, so an operation does not
+ * allocate.
+ *
+ * The client is its own single-threaded executor: #coremqtt::Client::poll runs
+ * #MQTT_ProcessLoop once and then resumes the coroutines whose operations
+ * completed. All calls on a client, and the coroutines awaiting it, must be
+ * made from one thread, and the send and state update hooks are not needed.
+ *
+ * Coroutines returning #coremqtt::Task allocate their frames from
+ * #coremqtt::FramePool, a fixed pool of #MQTT_COROUTINE_FRAME_COUNT blocks of
+ * #MQTT_COROUTINE_FRAME_SIZE bytes, rather than from the heap.
+ */
+
+#ifndef CORE_MQTT_COROUTINE_HPP
+#define CORE_MQTT_COROUTINE_HPP
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <type_traits>
+
+#include "core_mqtt.h"
+
+/**
+ * @brief Size in bytes of a block of the coroutine frame pool. A
+ * #coremqtt::Task coroutine with a larger frame fails to start.
+ */
+#ifndef MQTT_COROUTINE_FRAME_SIZE
+    #define MQTT_COROUTINE_FRAME_SIZE    ( 512U )
+#endif
+
+/**
+ * @brief Number of blocks of the coroutine frame pool, that is the largest
+ * number of #coremqtt::Task coroutines alive at once.
+ */
+#ifndef MQTT_COROUTINE_FRAME_COUNT
+    #define MQTT_COROUTINE_FRAME_COUNT    ( 16U )
+#endif
+
+namespace coremqtt
+{
+    /**
+     * @brief Fixed pool of coroutine frames.
+     *
+     * Blocks are taken from the free list, or else from the part of the pool
+     * never used yet. The pool is not thread safe; the coroutines using it must
+     * be created and must finish on one thread.
+     */
+    class FramePool
+    {
+        public:
+
+            /**
+             * @brief Take a block of the pool.
+             *
+             * @param[in] size Size of the coroutine frame.
+             *
+             * @return The block, or nullptr if the frame is larger than a block
+             * or the pool is exhausted.
+             */
+            static void * allocate( std::size_t size ) noexcept
+            {
+                Block * pBlock = nullptr;
+
+                if( size > MQTT_COROUTINE_FRAME_SIZE )
+                {
+                    pBlock = nullptr;
+                }
+                else if( pFree != nullptr )
+                {
+                    pBlock = pFree;
+                    pFree = pBlock->pNext;
+                }
+                else if( unusedIndex < MQTT_COROUTINE_FRAME_COUNT )
+                {
+                    pBlock = &blocks[ unusedIndex ];
+                    unusedIndex++;
+                }
+                else
+                {
+                    /* Empty else MISRA 15.7 */
+                }
+
+                return pBlock;
+            }
+
+            /**
+             * @brief Return a block taken with #FramePool::allocate.
+             *
+             * @param[in] pFrame The block.
+             */
+            static void release( void * pFrame ) noexcept
+            {
+                Block * pBlock = static_cast< Block * >( pFrame );
+
+                pBlock->pNext = pFree;
+                pFree = pBlock;
+            }
+
+            /**
+             * @brief The number of blocks in use.
+             */
+            static std::size_t usedCount() noexcept
+            {
+                std::size_t count = unusedIndex;
+
+                for( const Block * pBlock = pFree; pBlock != nullptr; pBlock = pBlock->pNext )
+                {
+                    count--;
+                }
+
+                return count;
+            }
+
+        private:
+
+            /**
+             * @brief A block, linked in the free list when it is not used.
+             */
+            union Block
+            {
+                Block * pNext;                                                      /**< @brief Next free block. */
+                alignas( std::max_align_t ) unsigned char frame[ MQTT_COROUTINE_FRAME_SIZE ]; /**< @brief The coroutine frame. */
+            };
+
+            static inline Block blocks[ MQTT_COROUTINE_FRAME_COUNT ]; /**< @brief The blocks. */
+            static inline Block * pFree = nullptr;                    /**< @brief Blocks returned to the pool. */
+            static inline std::size_t unusedIndex = 0U;               /**< @brief First block never used. */
+    };
+
+    /**
+     * @brief Return type of a detached coroutine, started when it is called and
+     * destroyed when it finishes, with its frame in #FramePool.
+     *
+     * A coroutine whose frame cannot be allocated does not run, and returns a
+     * task for which #Task::valid is false.
+     */
+    class Task
+    {
+        public:
+
+            /**
+             * @brief The promise of a #Task coroutine.
+             */
+            struct promise_type
+            {
+                Task get_return_object() noexcept
+                {
+                    return Task( true );
+                }
+
+                static Task get_return_object_on_allocation_failure() noexcept
+                {
+                    return Task( false );
+                }
+
+                std::suspend_never initial_suspend() noexcept
+                {
+                    return {};
+                }
+
+                std::suspend_never final_suspend() noexcept
+                {
+                    return {};
+                }
+
+                void return_void() noexcept
+                {
+                }
+
+                void unhandled_exception() noexcept
+                {
+                    std::terminate();
+                }
+
+                static void * operator new( std::size_t size ) noexcept
+                {
+                    return FramePool::allocate( size );
+                }
+
+                static void operator delete( void * pFrame ) noexcept
+                {
+                    FramePool::release( pFrame );
+                }
+            };
+
+            /**
+             * @brief Whether the coroutine was started.
+             */
+            bool valid() const noexcept
+            {
+                return started;
+            }
+
+        private:
+
+            explicit Task( bool isStarted ) noexcept : started( isStarted )
+            {
+            }
+
+            bool started; /**< @brief Whether the coroutine frame was allocated. */
+    };
+
+    /**
+     * @brief An MQTT context with awaitable operations.
+     *
+     * The client must not be moved once initialized, as the library refers to
+     * its context. Coroutines awaiting operations must complete, or the
+     * receiver be cancelled with #Client::cancelReceive, before the client is
+     * destroyed.
+     */
+    class Client
+    {
+        private:
+
+            /**
+             * @brief State common to the awaiters of the client. Completed
+             * operations are linked in the ready list of the client until
+             * #Client::poll resumes them.
+             */
+            class Operation
+            {
+                public:
+
+                    Operation( const Operation & ) = delete;
+                    Operation & operator=( const Operation & ) = delete;
+
+                    bool await_ready() const noexcept
+                    {
+                        return false;
+                    }
+
+                protected:
+
+                    explicit Operation( Client & owner ) noexcept : client( owner )
+                    {
+                    }
+
+                    /**
+                     * @brief Suspend the awaiting coroutine unless the operation
+                     * failed to start or completed while starting.
+                     */
+                    bool suspendAfterStart( MQTTStatus_t startStatus ) noexcept
+                    {
+                        if( startStatus != MQTTSuccess )
+                        {
+                            status = startStatus;
+                        }
+                        else if( completed == false )
+                        {
+                            suspended = true;
+                        }
+                        else
+                        {
+                            /* Empty else MISRA 15.7 */
+                        }
+
+                        return suspended;
+                    }
+
+                    /**
+                     * @brief #MQTTCompletionCallback_t of the operations, with
+                     * the operation as user data.
+                     */
+                    static void onCompletion( MQTTContext_t * pContext,
+                                              uint16_t packetId,
+                                              MQTTStatus_t completionStatus,
+                                              MQTTPacketInfo_t * pAckPacket,
+                                              void * pUserData ) noexcept
+                    {
+                        Operation * pOperation = static_cast< Operation * >( pUserData );
+
+                        ( void ) pContext;
+                        ( void ) packetId;
+                        ( void ) pAckPacket;
+
+                        pOperation->status = completionStatus;
+                        pOperation->completed = true;
+
+                        /* An operation completing while it starts is not
+                         * suspended, and resumes without the ready list. */
+                        if( pOperation->suspended == true )
+                        {
+                            pOperation->client.makeReady( *pOperation );
+                        }
+                    }
+
+                    Client & client;                              /**< @brief The client of the operation. */
+                    std::coroutine_handle<> handle;               /**< @brief The awaiting coroutine. */
+                    Operation * pNext = nullptr;                  /**< @brief Next operation of the ready list. */
+                    MQTTStatus_t status = MQTTSuccess;            /**< @brief Result of the operation. */
+                    bool completed = false;                       /**< @brief Whether the completion callback was invoked. */
+                    bool suspended = false;                       /**< @brief Whether the awaiting coroutine is suspended. */
+
+                    friend class Client;
+            };
+
+        public:
+
+            /**
+             * @brief Awaiter of a publish, returned by #Client::publish.
+             * `co_await` gives the #MQTTStatus_t of the publish.
+             */
+            class PublishOperation : public Operation
+            {
+                public:
+
+                    bool await_suspend( std::coroutine_handle<> awaiting ) noexcept
+                    {
+                        MQTTContext_t * pContext = client.context();
+                        uint16_t packetId = 0U;
+
+                        handle = awaiting;
+
+                        if( publishInfo.qos != MQTTQoS0 )
+                        {
+                            packetId = MQTT_GetPacketId( pContext );
+                        }
+
+                        return suspendAfterStart( MQTT_PublishWithCompletion( pContext,
+                                                                              &publishInfo,
+                                                                              packetId,
+                                                                              &Operation::onCompletion,
+                                                                              this ) );
+                    }
+
+                    MQTTStatus_t await_resume() const noexcept
+                    {
+                        return status;
+                    }
+
+                private:
+
+                    PublishOperation( Client & owner,
+                                      const MQTTPublishInfo_t & info ) noexcept :
+                        Operation( owner ), publishInfo( info )
+                    {
+                    }
+
+                    const MQTTPublishInfo_t & publishInfo; /**< @brief The publish to send. */
+
+                    friend class Client;
+            };
+
+            /**
+             * @brief Awaiter of a subscribe, returned by #Client::subscribe.
+             * `co_await` gives #MQTTSuccess if all subscriptions were granted,
+             * #MQTTServerRefused if one was refused, or the error of the
+             * subscribe.
+             */
+            class SubscribeOperation : public Operation
+            {
+                public:
+
+                    bool await_suspend( std::coroutine_handle<> awaiting ) noexcept
+                    {
+                        MQTTContext_t * pContext = client.context();
+
+                        handle = awaiting;
+
+                        return suspendAfterStart( MQTT_SubscribeWithCompletion( pContext,
+                                                                                pSubscriptionList,
+                                                                                subscriptionCount,
+                                                                                MQTT_GetPacketId( pContext ),
+                                                                                &Operation::onCompletion,
+                                                                                this ) );
+                    }
+
+                    MQTTStatus_t await_resume() const noexcept
+                    {
+                        return status;
+                    }
+
+                private:
+
+                    SubscribeOperation( Client & owner,
+                                        const MQTTSubscribeInfo_t * pList,
+                                        std::size_t count ) noexcept :
+                        Operation( owner ), pSubscriptionList( pList ), subscriptionCount( count )
+                    {
+                    }
+
+                    const MQTTSubscribeInfo_t * pSubscriptionList; /**< @brief The subscriptions to request. */
+                    std::size_t subscriptionCount;                  /**< @brief The number of subscriptions. */
+
+                    friend class Client;
+            };
+
+            /**
+             * @brief Awaiter of the next incoming publish, returned by
+             * #Client::receive.
+             *
+             * `co_await` gives the incoming publish, or nullptr if another
+             * coroutine is already receiving or the receive was cancelled with
+             * #Client::cancelReceive. The coroutine is resumed from within
+             * #MQTT_ProcessLoop, as the publish is in the network buffer: the
+             * publish is only valid until the coroutine suspends again.
+             */
+            class ReceiveOperation
+            {
+                public:
+
+                    ReceiveOperation( const ReceiveOperation & ) = delete;
+                    ReceiveOperation & operator=( const ReceiveOperation & ) = delete;
+
+                    bool await_ready() const noexcept
+                    {
+                        return false;
+                    }
+
+                    bool await_suspend( std::coroutine_handle<> awaiting ) noexcept
+                    {
+                        bool suspend = false;
+
+                        if( client.pReceiver == nullptr )
+                        {
+                            handle = awaiting;
+                            client.pReceiver = this;
+                            suspend = true;
+                        }
+
+                        return suspend;
+                    }
+
+                    const MQTTPublishInfo_t * await_resume() const noexcept
+                    {
+                        return pPublishInfo;
+                    }
+
+                private:
+
+                    explicit ReceiveOperation( Client & owner ) noexcept : client( owner )
+                    {
+                    }
+
+                    Client & client;                                 /**< @brief The client receiving. */
+                    std::coroutine_handle<> handle;                  /**< @brief The receiving coroutine. */
+                    const MQTTPublishInfo_t * pPublishInfo = nullptr; /**< @brief The received publish. */
+
+                    friend class Client;
+            };
+
+            Client() noexcept = default;
+            Client( const Client & ) = delete;
+            Client & operator=( const Client & ) = delete;
+
+            /**
+             * @brief Initialize the context of the client and its completion
+             * tokens, with the same parameters as #MQTT_Init and
+             * #MQTT_InitCompletionTokens.
+             *
+             * The application may further initialize the context, for example
+             * with #MQTT_InitStatefulQoS, and connects it with #MQTT_Connect.
+             *
+             * @return The status of #MQTT_Init or #MQTT_InitCompletionTokens.
+             */
+            MQTTStatus_t init( const TransportInterface_t & transport,
+                               MQTTGetCurrentTimeFunc_t getTimeFunction,
+                               const MQTTFixedBuffer_t & networkBuffer,
+                               MQTTCompletionToken_t * pCompletionTokens,
+                               std::size_t completionTokenCount ) noexcept
+            {
+                MQTTStatus_t status = MQTT_Init( &mqttContext,
+                                                 &transport,
+                                                 getTimeFunction,
+                                                 &Client::onEvent,
+                                                 &networkBuffer );
+
+                if( status == MQTTSuccess )
+                {
+                    status = MQTT_InitCompletionTokens( &mqttContext, pCompletionTokens, completionTokenCount );
+                }
+
+                return status;
+            }
+
+            /**
+             * @brief The MQTT context of the client.
+             */
+            MQTTContext_t * context() noexcept
+            {
+                return &mqttContext;
+            }
+
+            /**
+             * @brief Publish, with a packet ID from #MQTT_GetPacketId for QoS1
+             * and QoS2. The publish info must remain valid until it is awaited.
+             */
+            PublishOperation publish( const MQTTPublishInfo_t & publishInfo ) noexcept
+            {
+                return PublishOperation( *this, publishInfo );
+            }
+
+            /**
+             * @brief Subscribe, with a packet ID from #MQTT_GetPacketId. The
+             * subscription list must remain valid until it is awaited.
+             */
+            SubscribeOperation subscribe( const MQTTSubscribeInfo_t * pSubscriptionList,
+                                          std::size_t subscriptionCount ) noexcept
+            {
+                return SubscribeOperation( *this, pSubscriptionList, subscriptionCount );
+            }
+
+            /**
+             * @brief Receive the next incoming publish. Publishes received while
+             * no coroutine is receiving are acknowledged as usual and counted
+             * by #Client::droppedCount.
+             */
+            ReceiveOperation receive() noexcept
+            {
+                return ReceiveOperation( *this );
+            }
+
+            /**
+             * @brief Resume the receiving coroutine, if any, with nullptr.
+             */
+            void cancelReceive() noexcept
+            {
+                ReceiveOperation * pOperation = pReceiver;
+
+                if( pOperation != nullptr )
+                {
+                    pReceiver = nullptr;
+                    pOperation->pPublishInfo = nullptr;
+                    pOperation->handle.resume();
+                }
+            }
+
+            /**
+             * @brief Run #MQTT_ProcessLoop once, and resume the coroutines whose
+             * operations completed. This function must not be called from a
+             * coroutine awaiting the client.
+             *
+             * @return The status of #MQTT_ProcessLoop.
+             */
+            MQTTStatus_t poll() noexcept
+            {
+                MQTTStatus_t status;
+
+                /* Operations abandoned by #MQTT_Connect complete outside
+                 * #MQTT_ProcessLoop. */
+                resumeReady();
+                status = MQTT_ProcessLoop( &mqttContext );
+                resumeReady();
+
+                return status;
+            }
+
+            /**
+             * @brief Call #Client::poll until stop is set or it fails.
+             *
+             * @return #MQTTSuccess if stopped, or the error of #MQTT_ProcessLoop.
+             */
+            MQTTStatus_t run( const volatile bool & stop ) noexcept
+            {
+                MQTTStatus_t status = MQTTSuccess;
+
+                while( ( stop == false ) &&
+                       ( ( status == MQTTSuccess ) || ( status == MQTTNeedMoreBytes ) ) )
+                {
+                    status = poll();
+                }
+
+                if( status == MQTTNeedMoreBytes )
+                {
+                    status = MQTTSuccess;
+                }
+
+                return status;
+            }
+
+            /**
+             * @brief The number of incoming publishes received while no
+             * coroutine was receiving.
+             */
+            std::uint32_t droppedCount() const noexcept
+            {
+                return droppedPublishCount;
+            }
+
+        private:
+
+            /**
+             * @brief #MQTTEventCallback_t of the context, giving incoming
+             * publishes to the receiving coroutine.
+             */
+            static void onEvent( MQTTContext_t * pContext,
+                                 MQTTPacketInfo_t * pPacketInfo,
+                                 MQTTDeserializedInfo_t * pDeserializedInfo ) noexcept
+            {
+                /* The context is the first member of the standard layout
+                 * client, so both have the same address. */
+                Client * pClient = reinterpret_cast< Client * >( pContext );
+                ReceiveOperation * pOperation = pClient->pReceiver;
+
+                if( ( pPacketInfo->type & 0xF0U ) != MQTT_PACKET_TYPE_PUBLISH )
+                {
+                    /* Acknowledgements complete operations through their
+                     * completion tokens. */
+                }
+                else if( pOperation != nullptr )
+                {
+                    pClient->pReceiver = nullptr;
+                    pOperation->pPublishInfo = pDeserializedInfo->pPublishInfo;
+                    pOperation->handle.resume();
+                }
+                else
+                {
+                    pClient->droppedPublishCount++;
+                }
+            }
+
+            /**
+             * @brief Link a completed operation at the end of the ready list.
+             */
+            void makeReady( Operation & operation ) noexcept
+            {
+                operation.pNext = nullptr;
+
+                if( pReadyTail == nullptr )
+                {
+                    pReadyHead = &operation;
+                }
+                else
+                {
+                    pReadyTail->pNext = &operation;
+                }
+
+                pReadyTail = &operation;
+            }
+
+            /**
+             * @brief Resume the coroutines of the ready list, including those
+             * completed by the resumed coroutines.
+             */
+            void resumeReady() noexcept
+            {
+                while( pReadyHead != nullptr )
+                {
+                    Operation * pOperation = pReadyHead;
+
+                    pReadyHead = pOperation->pNext;
+
+                    if( pReadyHead == nullptr )
+                    {
+                        pReadyTail = nullptr;
+                    }
+
+                    /* The operation is destroyed when its coroutine resumes. */
+                    pOperation->suspended = false;
+                    pOperation->handle.resume();
+                }
+            }
+
+            MQTTContext_t mqttContext = {};             /**< @brief The MQTT context; the first member. */
+            Operation * pReadyHead = nullptr;           /**< @brief First completed operation to resume. */
+            Operation * pReadyTail = nullptr;           /**< @brief Last completed operation to resume. */
+            ReceiveOperation * pReceiver = nullptr;     /**< @brief The receiving coroutine. */
+            std::uint32_t droppedPublishCount = 0U;     /**< @brief Publishes received without receiver. */
+    };
+
+    static_assert( std::is_standard_layout_v< Client >,
+                   "The MQTT context must have the address of the client." );
+}
+
+#endif /* ifndef CORE_MQTT_COROUTINE_HPP */
@@ -0,0 +1,560 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file core_mqtt_router.hpp
+ * @brief Optional header-only C++20 router dispatching incoming publishes to
+ * handlers bound to topic filters known at compile time.
+ *
+ * The topic filters of a #coremqtt::Router are template arguments. They are
+ * validated with `static_assert`, and compiled into a tree with one node per
+ * level: the router walks the levels of a topic name once, comparing the hash
+ * of each level to the precomputed hashes of the literal levels of the
+ * filters, rather than parsing every topic filter as #MQTT_MatchTopic does.
+ *
+ * Matching follows #MQTT_MatchTopic, and a publish matching several filters
+ * is given to the handler chosen as with #MQTT_RegisterTopicHandler: a filter
+ * without wildcards which is the topic name, or else the first matching
+ * wildcard filter in the order of the routes.
+ */
+
+#ifndef CORE_MQTT_ROUTER_HPP
+#define CORE_MQTT_ROUTER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include "core_mqtt.h"
+
+namespace coremqtt
+{
+    /**
+     * @brief A topic filter given as a template argument, such as
+     * `Route< "sensors/+/temperature", handler >`.
+     */
+    template< std::size_t Size >
+    struct TopicFilter
+    {
+        /**
+         * @brief Copy a string literal.
+         */
+        constexpr TopicFilter( const char ( &pFilter )[ Size ] ) noexcept
+        {
+            for( std::size_t i = 0U; i < Size; i++ )
+            {
+                value[ i ] = pFilter[ i ];
+            }
+        }
+
+        /**
+         * @brief Length of the topic filter.
+         */
+        constexpr std::size_t length() const noexcept
+        {
+            return Size - 1U;
+        }
+
+        char value[ Size ] = {}; /**< @brief The topic filter with its terminator. */
+    };
+
+    /**
+     * @brief Hash of a topic level, computed at compile time for the literal
+     * levels of the filters and at run time for the levels of topic names.
+     */
+    constexpr std::uint32_t hashTopicLevel( const char * pLevel,
+                                            std::size_t length ) noexcept
+    {
+        /* 32-bit FNV-1a. */
+        std::uint32_t hash = 2166136261U;
+
+        for( std::size_t i = 0U; i < length; i++ )
+        {
+            hash = ( hash ^ static_cast< std::uint8_t >( pLevel[ i ] ) ) * 16777619U;
+        }
+
+        return hash;
+    }
+
+    /**
+     * @brief Whether a topic filter is valid: not empty, with '+' and '#'
+     * only as whole levels and '#' only as the last level.
+     */
+    template< std::size_t Size >
+    constexpr bool isValidTopicFilter( const TopicFilter< Size > & filter ) noexcept
+    {
+        bool valid = ( filter.length() > 0U ) && ( filter.length() <= UINT16_MAX );
+
+        for( std::size_t i = 0U; ( i < filter.length() ) && ( valid == true ); i++ )
+        {
+            const char c = filter.value[ i ];
+            const bool levelStart = ( i == 0U ) || ( filter.value[ i - 1U ] == '/' );
+            const bool levelEnd = ( ( i + 1U ) == filter.length() ) || ( filter.value[ i + 1U ] == '/' );
+
+            if( c == '\0' )
+            {
+                valid = false;
+            }
+            else if( c == '+' )
+            {
+                valid = levelStart && levelEnd;
+            }
+            else if( c == '#' )
+            {
+                valid = levelStart && ( ( i + 1U ) == filter.length() );
+            }
+            else
+            {
+                /* Empty else MISRA 15.7 */
+            }
+        }
+
+        return valid;
+    }
+
+    /**
+     * @brief Binding of a handler to a topic filter. The handler is a function
+     * with the parameters of #MQTTEventCallback_t.
+     */
+    template< TopicFilter Filter, auto Handler >
+    struct Route
+    {
+        static_assert( isValidTopicFilter( Filter ), "Invalid topic filter." );
+
+        static constexpr auto filter = Filter;   /**< @brief The topic filter. */
+        static constexpr auto handler = Handler; /**< @brief The handler of matching publishes. */
+    };
+
+    /**
+     * @brief Dispatcher of incoming publishes to the handlers of a fixed set of
+     * routes.
+     *
+     * @tparam Routes #Route types.
+     */
+    template< typename ... Routes >
+    class Router
+    {
+        public:
+
+            /**
+             * @brief The value returned by #Router::match when no route
+             * matches.
+             */
+            static constexpr std::size_t noRoute = sizeof...( Routes );
+
+            /**
+             * @brief Find the route of a topic name.
+             *
+             * @param[in] pTopicName The topic name.
+             * @param[in] topicNameLength Length of the topic name.
+             *
+             * @return The index of the route in the template arguments, or
+             * #Router::noRoute.
+             */
+            static std::size_t match( const char * pTopicName,
+                                      std::size_t topicNameLength ) noexcept
+            {
+                std::size_t best = noRank;
+
+                if( ( pTopicName != nullptr ) && ( topicNameLength > 0U ) )
+                {
+                    visit< 0 >( pTopicName, topicNameLength, 0U, best );
+                }
+
+                return ( best == noRank ) ? noRoute : routeOfRank( best );
+            }
+
+            /**
+             * @brief Give an incoming publish to the handler of its route.
+             * Called from the #MQTTEventCallback_t of the context.
+             *
+             * @return true if the packet is a publish which matched a route.
+             */
+            static bool dispatch( MQTTContext_t * pContext,
+                                  MQTTPacketInfo_t * pPacketInfo,
+                                  MQTTDeserializedInfo_t * pDeserializedInfo ) noexcept
+            {
+                bool handled = false;
+
+                if( ( pPacketInfo->type & 0xF0U ) == MQTT_PACKET_TYPE_PUBLISH )
+                {
+                    const MQTTPublishInfo_t * pPublishInfo = pDeserializedInfo->pPublishInfo;
+
+                    handled = invoke( match( pPublishInfo->pTopicName, pPublishInfo->topicNameLength ),
+                                      pContext,
+                                      pPacketInfo,
+                                      pDeserializedInfo,
+                                      std::make_index_sequence< sizeof...( Routes ) >() );
+                }
+
+                return handled;
+            }
+
+        private:
+
+            /**
+             * @brief Rank of a route: filters without wildcards come first,
+             * then the others, each in the order of the routes. The best match
+             * is the one of lowest rank.
+             */
+            static constexpr std::size_t noRank = 2U * sizeof...( Routes );
+
+            /**
+             * @brief Marks the absence of a node.
+             */
+            static constexpr int noNode = -1;
+
+            /**
+             * @brief A node of the tree, for one level of one or more filters.
+             * The root is the node before the first level.
+             */
+            struct Node
+            {
+                std::uint32_t hash = 0U;        /**< @brief Hash of the literal level. */
+                std::size_t textOffset = 0U;    /**< @brief Offset of the literal level in the text of the tree. */
+                std::size_t textLength = 0U;    /**< @brief Length of the literal level. */
+                int firstLiteral = noNode;      /**< @brief First child for a literal level. */
+                int nextLiteral = noNode;       /**< @brief Next sibling for a literal level. */
+                int plusChild = noNode;         /**< @brief Child for a '+' level. */
+                std::size_t endRank = noRank;   /**< @brief Best route of a filter ending at this node. */
+                std::size_t hashRank = noRank;  /**< @brief Best route of a filter with a '#' level after this node. */
+                std::size_t bestRank = noRank;  /**< @brief Best route of the filters through this node. */
+                int parent = noNode;            /**< @brief The parent node. */
+            };
+
+            /**
+             * @brief The tree of the filters, with the text of their literal
+             * levels.
+             */
+            struct Tree
+            {
+                Node nodes[ 1U + ( Routes::filter.length() + ... + 0U ) ];
+                char text[ 1U + ( Routes::filter.length() + ... + 0U ) ];
+                std::size_t nodeCount;
+                std::size_t textLength;
+            };
+
+            /**
+             * @brief Whether a topic filter has a wildcard level.
+             */
+            template< std::size_t Size >
+            static constexpr bool hasWildcard( const TopicFilter< Size > & filter ) noexcept
+            {
+                bool wildcard = false;
+
+                for( std::size_t i = 0U; i < filter.length(); i++ )
+                {
+                    wildcard = wildcard || ( filter.value[ i ] == '+' ) || ( filter.value[ i ] == '#' );
+                }
+
+                return wildcard;
+            }
+
+            /**
+             * @brief Add the levels of a filter to the tree.
+             */
+            template< std::size_t Size >
+            static constexpr void addFilter( Tree & tree,
+                                             const TopicFilter< Size > & filter,
+                                             std::size_t rank ) noexcept
+            {
+                int node = 0;
+                std::size_t levelStart = 0U;
+                bool done = false;
+
+                while( done == false )
+                {
+                    std::size_t levelEnd = levelStart;
+
+                    while( ( levelEnd < filter.length() ) && ( filter.value[ levelEnd ] != '/' ) )
+                    {
+                        levelEnd++;
+                    }
+
+                    const char * pLevel = &filter.value[ levelStart ];
+                    const std::size_t levelLength = levelEnd - levelStart;
+
+                    if( ( levelLength == 1U ) && ( pLevel[ 0 ] == '#' ) )
+                    {
+                        tree.nodes[ node ].hashRank = minRank( tree.nodes[ node ].hashRank, rank );
+                        done = true;
+                    }
+                    else
+                    {
+                        if( ( levelLength == 1U ) && ( pLevel[ 0 ] == '+' ) )
+                        {
+                            if( tree.nodes[ node ].plusChild == noNode )
+                            {
+                                tree.nodes[ node ].plusChild = newNode( tree, node );
+                            }
+
+                            node = tree.nodes[ node ].plusChild;
+                        }
+                        else
+                        {
+                            node = literalChild( tree, node, pLevel, levelLength );
+                        }
+
+                        if( levelEnd == filter.length() )
+                        {
+                            tree.nodes[ node ].endRank = minRank( tree.nodes[ node ].endRank, rank );
+                            done = true;
+                        }
+                        else
+                        {
+                            levelStart = levelEnd + 1U;
+                        }
+                    }
+                }
+            }
+
+            /**
+             * @brief Find or add the child of a node for a literal level.
+             */
+            static constexpr int literalChild( Tree & tree,
+                                               int parent,
+                                               const char * pLevel,
+                                               std::size_t levelLength ) noexcept
+            {
+                int child = tree.nodes[ parent ].firstLiteral;
+                int * pLink = &tree.nodes[ parent ].firstLiteral;
+
+                while( ( child != noNode ) && ( sameLevel( tree, tree.nodes[ child ], pLevel, levelLength ) == false ) )
+                {
+                    pLink = &tree.nodes[ child ].nextLiteral;
+                    child = tree.nodes[ child ].nextLiteral;
+                }
+
+                if( child == noNode )
+                {
+                    child = newNode( tree, parent );
+                    tree.nodes[ child ].hash = hashTopicLevel( pLevel, levelLength );
+                    tree.nodes[ child ].textOffset = tree.textLength;
+                    tree.nodes[ child ].textLength = levelLength;
+
+                    for( std::size_t i = 0U; i < levelLength; i++ )
+                    {
+                        tree.text[ tree.textLength ] = pLevel[ i ];
+                        tree.textLength++;
+                    }
+
+                    *pLink = child;
+                }
+
+                return child;
+            }
+
+            static constexpr bool sameLevel( const Tree & tree,
+                                             const Node & node,
+                                             const char * pLevel,
+                                             std::size_t levelLength ) noexcept
+            {
+                bool same = ( node.textLength == levelLength );
+
+                for( std::size_t i = 0U; ( i < levelLength ) && ( same == true ); i++ )
+                {
+                    same = ( tree.text[ node.textOffset + i ] == pLevel[ i ] );
+                }
+
+                return same;
+            }
+
+            static constexpr int newNode( Tree & tree,
+                                          int parent ) noexcept
+            {
+                const int node = static_cast< int >( tree.nodeCount );
+
+                tree.nodes[ node ] = Node {};
+                tree.nodes[ node ].parent = parent;
+                tree.nodeCount++;
+
+                return node;
+            }
+
+            static constexpr std::size_t minRank( std::size_t a,
+                                                  std::size_t b ) noexcept
+            {
+                return ( a < b ) ? a : b;
+            }
+
+            /**
+             * @brief Build the tree of the routes.
+             */
+            static constexpr Tree buildTree() noexcept
+            {
+                Tree tree {};
+                std::size_t index = 0U;
+
+                tree.nodeCount = 1U;
+                tree.textLength = 0U;
+
+                ( ( addFilter( tree,
+                               Routes::filter,
+                               hasWildcard( Routes::filter ) ? ( sizeof...( Routes ) + index ) : index ),
+                    index++ ), ... );
+
+                /* Children are added after their parent, so the best rank of
+                 * every child is final when it is given to the parent. */
+                for( std::size_t i = tree.nodeCount; i > 0U; i-- )
+                {
+                    Node & node = tree.nodes[ i - 1U ];
+
+                    node.bestRank = minRank( node.bestRank, minRank( node.endRank, node.hashRank ) );
+
+                    if( node.parent != noNode )
+                    {
+                        tree.nodes[ node.parent ].bestRank = minRank( tree.nodes[ node.parent ].bestRank, node.bestRank );
+                    }
+                }
+
+                return tree;
+            }
+
+            static constexpr Tree tree = buildTree(); /**< @brief The tree of the routes. */
+
+            static constexpr std::size_t routeOfRank( std::size_t rank ) noexcept
+            {
+                return ( rank < sizeof...( Routes ) ) ? rank : ( rank - sizeof...( Routes ) );
+            }
+
+            /**
+             * @brief Match the levels of a topic name from levelStart against
+             * the subtree of a node, keeping the best rank found.
+             *
+             * @param[in] pTopicName The topic name.
+             * @param[in] topicNameLength Length of the topic name.
+             * @param[in] levelStart Start of the next level. Past the end of
+             * the topic name when all levels were matched.
+             * @param[in,out] best The best rank found.
+             */
+            template< int NodeIndex >
+            static void visit( const char * pTopicName,
+                               std::size_t topicNameLength,
+                               std::size_t levelStart,
+                               std::size_t & best ) noexcept
+            {
+                constexpr Node node = tree.nodes[ NodeIndex ];
+
+                /* Topic names starting with '$' do not match filters starting
+                 * with a wildcard. */
+                const bool wildcards = ( NodeIndex != 0 ) || ( pTopicName[ 0 ] != '$' );
+
+                if( node.bestRank >= best )
+                {
+                    /* No filter through this node is better than the match
+                     * found. */
+                }
+                else if( levelStart > topicNameLength )
+                {
+                    /* A '#' level also matches the parent level. */
+                    best = minRank( best, minRank( node.endRank, node.hashRank ) );
+                }
+                else
+                {
+                    std::size_t levelEnd = levelStart;
+
+                    while( ( levelEnd < topicNameLength ) && ( pTopicName[ levelEnd ] != '/' ) )
+                    {
+                        levelEnd++;
+                    }
+
+                    if( ( wildcards == true ) && ( node.hashRank != noRank ) )
+                    {
+                        best = minRank( best, node.hashRank );
+                    }
+
+                    if constexpr( node.firstLiteral != noNode )
+                    {
+                        visitLiteral< node.firstLiteral >( pTopicName,
+                                                           topicNameLength,
+                                                           levelStart,
+                                                           levelEnd - levelStart,
+                                                           hashTopicLevel( &pTopicName[ levelStart ], levelEnd - levelStart ),
+                                                           best );
+                    }
+
+                    if constexpr( node.plusChild != noNode )
+                    {
+                        if( wildcards == true )
+                        {
+                            visit< node.plusChild >( pTopicName, topicNameLength, levelEnd + 1U, best );
+                        }
+                    }
+                }
+            }
+
+            /**
+             * @brief Match a level of a topic name against the literal children
+             * of a node, from ChildIndex on. At most one of them matches.
+             */
+            template< int ChildIndex >
+            static void visitLiteral( const char * pTopicName,
+                                      std::size_t topicNameLength,
+                                      std::size_t levelStart,
+                                      std::size_t levelLength,
+                                      std::uint32_t hash,
+                                      std::size_t & best ) noexcept
+            {
+                constexpr Node child = tree.nodes[ ChildIndex ];
+
+                bool same = ( hash == child.hash ) && ( levelLength == child.textLength );
+
+                /* The hash is confirmed with the text of the level, of a length
+                 * known at compile time. */
+                for( std::size_t i = 0U; ( i < child.textLength ) && ( same == true ); i++ )
+                {
+                    same = ( pTopicName[ levelStart + i ] == tree.text[ child.textOffset + i ] );
+                }
+
+                if( same == true )
+                {
+                    visit< ChildIndex >( pTopicName, topicNameLength, levelStart + levelLength + 1U, best );
+                }
+                else if constexpr( child.nextLiteral != noNode )
+                {
+                    visitLiteral< child.nextLiteral >( pTopicName, topicNameLength, levelStart, levelLength, hash, best );
+                }
+                else
+                {
+                    /* Empty else MISRA 15.7 */
+                }
+            }
+
+            /**
+             * @brief Invoke the handler of a route.
+             */
+            template< std::size_t ... Indexes >
+            static bool invoke( std::size_t route,
+                                MQTTContext_t * pContext,
+                                MQTTPacketInfo_t * pPacketInfo,
+                                MQTTDeserializedInfo_t * pDeserializedInfo,
+                                std::index_sequence< Indexes... > ) noexcept
+            {
+                return ( ( ( route == Indexes ) &&
+                           ( Routes::handler( pContext, pPacketInfo, pDeserializedInfo ), true ) ) || ... );
+            }
+    };
+}
+
+#endif /* ifndef CORE_MQTT_ROUTER_HPP */
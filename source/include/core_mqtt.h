@@ -41,6 +41,10 @@
 /* Include transport interface. */
 #include "transport_interface.h"
 
+/* Include config defaults header, as the profile selected by the config
+ * changes the layout of #MQTTContext_t. */
+#include "core_mqtt_config_defaults.h"
+
 /**
  * @cond DOXYGEN_IGNORE
  * The current version of this library.
@@ -97,7 +101,9 @@ typedef uint32_t (* MQTTGetCurrentTimeFunc_t )( void );
  *
  * @note This callback will be called only if packets are deserialized with a
  * result of #MQTTSuccess or #MQTTServerRefused. The latter can be obtained
- * when deserializing a SUBACK, indicating a broker's rejection of a subscribe.
+ * when deserializing a SUBACK, indicating a broker's rejection of a subscribe,
+ * or an MQTT 5 PUBACK, PUBREC or PUBCOMP with a failure reason code. A publish
+ * refused by a PUBREC is released without sending a PUBREL.
  *
  * @param[in] pContext Initialized MQTT context.
  * @param[in] pPacketInfo Information on the type of incoming MQTT packet.
@@ -158,6 +164,57 @@ typedef void (* MQTTClearPacketForRetransmit)( struct MQTTContext * pContext,
                                                uint16_t packetId );
 /* @[define_mqtt_retransmitclearpacket] */
 
+/**
+ * @ingroup mqtt_callback_types
+ * @brief Application handler for incoming publishes matching a topic filter
+ * registered with #MQTT_RegisterTopicHandler.
+ *
+ * @note The handler is invoked instead of the #MQTTEventCallback_t of the
+ * context for the incoming publishes it matches. It is called with the same
+ * arguments the #MQTTEventCallback_t would have been called with.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] pPacketInfo Information on the type of incoming MQTT packet.
+ * @param[in] pDeserializedInfo Deserialized information from incoming packet.
+ * @param[in] pHandlerContext The context registered along with the handler.
+ */
+/* @[define_mqtt_topichandler] */
+typedef void (* MQTTTopicHandler_t )( struct MQTTContext * pContext,
+                                      struct MQTTPacketInfo * pPacketInfo,
+                                      struct MQTTDeserializedInfo * pDeserializedInfo,
+                                      void * pHandlerContext );
+/* @[define_mqtt_topichandler] */
+
+/**
+ * @ingroup mqtt_callback_types
+ * @brief Application callback invoked when an operation started with
+ * #MQTT_PublishWithCompletion or #MQTT_SubscribeWithCompletion completes.
+ *
+ * The callback is invoked after the #MQTTEventCallback_t of the context has
+ * been given the acknowledgement, and the completion token is free again, so
+ * the callback may start another operation.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] packetId The packet identifier of the operation.
+ * @param[in] status #MQTTSuccess if the operation was acknowledged;
+ * #MQTTServerRefused if a SUBACK refused at least one topic filter, or an
+ * MQTT 5 PUBACK, PUBREC or PUBCOMP has a failure reason code;
+ * #MQTTStatusNotConnected if the operation was abandoned by a new connection.
+ * @param[in] pAckPacket The PUBACK, PUBCOMP or SUBACK completing the operation,
+ * or the PUBREC refusing a QoS2 publish. The return codes of a SUBACK are given
+ * by #MQTT_GetSubAckStatusCodes, or #MQTT_GetSubAckReasonCodesV5 for MQTT 5, and
+ * the reason code of an MQTT 5 publish ack by #MQTT_GetReasonCodeV5. NULL for a
+ * QoS0 publish or an abandoned operation.
+ * @param[in] pUserData The user data given with the operation.
+ */
+/* @[define_mqtt_completioncallback] */
+typedef void (* MQTTCompletionCallback_t )( struct MQTTContext * pContext,
+                                            uint16_t packetId,
+                                            MQTTStatus_t status,
+                                            struct MQTTPacketInfo * pAckPacket,
+                                            void * pUserData );
+/* @[define_mqtt_completioncallback] */
+
 /**
  * @ingroup mqtt_enum_types
  * @brief Values indicating if an MQTT connection exists.
@@ -225,29 +282,175 @@ typedef struct MQTTPubAckInfo
 
 /**
  * @ingroup mqtt_struct_types
- * @brief A struct representing an MQTT connection.
+ * @brief An element of the topic handler tables used by #MQTT_RegisterTopicHandler.
+ *
+ * @note The application only provides the memory for these records through
+ * #MQTT_InitTopicHandlers; the members are managed by the library.
  */
-typedef struct MQTTContext
+typedef struct MQTTTopicHandlerRecord
 {
-    /**
-     * @brief State engine records for outgoing publishes.
-     */
-    MQTTPubAckInfo_t * outgoingPublishRecords;
+    const char * pTopicFilter;  /**< @brief The registered topic filter. NULL for an empty record. */
+    uint16_t topicFilterLength; /**< @brief Length of the registered topic filter. */
+    uint16_t prefixLength;      /**< @brief Length of the literal levels preceding the first wildcard. */
+    uint32_t filterHash;        /**< @brief Hash of the topic filter used by the exact-match table. */
+    MQTTTopicHandler_t handler; /**< @brief The handler to invoke for matching publishes. */
+    void * pHandlerContext;     /**< @brief The context passed to the handler. */
+} MQTTTopicHandlerRecord_t;
 
-    /**
-     * @brief State engine records for incoming publishes.
-     */
-    MQTTPubAckInfo_t * incomingPublishRecords;
+/**
+ * @ingroup mqtt_struct_types
+ * @brief An element of the MQTT 5 topic alias table of a context.
+ *
+ * @note The application only provides the memory for these records through
+ * #MQTT_InitTopicAliases; the members are managed by the library.
+ */
+typedef struct MQTTTopicAliasRecord
+{
+    uint32_t topicHash;                                  /**< @brief Hash of the topic name. */
+    uint32_t lastUsed;                                   /**< @brief Value of the alias clock of the context when the alias was last sent. */
+    uint16_t topicNameLength;                            /**< @brief Length of the topic name. 0 if the alias is not assigned. */
+    char topicName[ MQTT_TOPIC_ALIAS_MAX_TOPIC_LENGTH ]; /**< @brief The topic name of the alias. */
+} MQTTTopicAliasRecord_t;
+
+/**
+ * @ingroup mqtt_struct_types
+ * @brief An element of the MQTT 5 subscription handler table used by
+ * #MQTT_RegisterSubscriptionHandler.
+ *
+ * @note The application only provides the memory for these records through
+ * #MQTT_InitSubscriptionHandlers; the members are managed by the library.
+ */
+typedef struct MQTTSubscriptionHandlerRecord
+{
+    MQTTTopicHandler_t handler; /**< @brief The handler to invoke for publishes of the subscription. NULL for an empty record. */
+    void * pHandlerContext;     /**< @brief The context passed to the handler. */
+} MQTTSubscriptionHandlerRecord_t;
+
+/**
+ * @ingroup mqtt_struct_types
+ * @brief An element of the subscription registry of a context, used by
+ * #MQTT_InitSubscriptionRegistry.
+ *
+ * A record is taken for each topic filter subscribed to, and is active once a
+ * SUBACK grants the subscription. While a SUBSCRIBE is awaiting its SUBACK,
+ * the return code of the topic filter in that SUBACK is at
+ * #MQTTSubscriptionRecord_t.subAckIndex of the codes given by
+ * #MQTT_GetSubAckStatusCodes, or #MQTT_GetSubAckReasonCodesV5 for MQTT 5.
+ *
+ * @note The application only provides the memory for these records through
+ * #MQTT_InitSubscriptionRegistry; the members are managed by the library.
+ */
+typedef struct MQTTSubscriptionRecord
+{
+    uint32_t filterHash;                                              /**< @brief Hash of the topic filter. */
+    size_t subAckIndex;                                               /**< @brief Index of the topic filter in the SUBSCRIBE awaiting its SUBACK. */
+    uint16_t packetId;                                                /**< @brief Packet ID of the SUBSCRIBE awaiting its SUBACK. 0 if there is none. */
+    uint16_t topicFilterLength;                                       /**< @brief Length of the topic filter. 0 for an empty record. */
+    MQTTQoS_t qos;                                                    /**< @brief The requested QoS of the granted subscription. */
+    MQTTQoS_t pendingQos;                                             /**< @brief The QoS requested by the SUBSCRIBE awaiting its SUBACK. */
+    uint32_t subscriptionId;                                          /**< @brief The MQTT 5 Subscription Identifier of the granted subscription. 0 if there is none. */
+    uint32_t pendingSubscriptionId;                                   /**< @brief The Subscription Identifier of the SUBSCRIBE awaiting its SUBACK. */
+    bool active;                                                      /**< @brief Whether a SUBACK granted the subscription. */
+    char topicFilter[ MQTT_SUBSCRIPTION_REGISTRY_MAX_FILTER_LENGTH ]; /**< @brief The topic filter. */
+} MQTTSubscriptionRecord_t;
+
+/**
+ * @ingroup mqtt_struct_types
+ * @brief An element of the completion token table of a context, used by
+ * #MQTT_PublishWithCompletion and #MQTT_SubscribeWithCompletion.
+ *
+ * @note The application only provides the memory for these records through
+ * #MQTT_InitCompletionTokens; the members are managed by the library.
+ */
+typedef struct MQTTCompletionToken
+{
+    MQTTCompletionCallback_t callback; /**< @brief The callback of the operation. NULL for a free token. */
+    void * pUserData;                  /**< @brief The user data given to the callback. */
+    uint16_t packetId;                 /**< @brief The packet identifier of the operation. */
+    uint8_t ackType;                   /**< @brief The type of the packet completing the operation. */
+} MQTTCompletionToken_t;
+
+/**
+ * @ingroup mqtt_struct_types
+ * @brief A pool of equally sized network buffers shared by many MQTT contexts.
+ *
+ * A context attached to a pool with #MQTT_SetBufferPool borrows a buffer only
+ * while it is receiving a packet, so the memory for receive buffers tracks the
+ * number of connections with data in flight rather than the number of
+ * connections.
+ *
+ * @note The application only provides the memory for the buffers through
+ * #MQTT_InitBufferPool; the members are managed by the library.
+ */
+typedef struct MQTTBufferPool
+{
+    uint8_t * pFreeList; /**< @brief First free buffer. The start of each free buffer holds a pointer to the next. */
+    size_t bufferSize;   /**< @brief Size of each buffer in the pool. */
+    size_t bufferCount;  /**< @brief Number of buffers in the pool. */
+    size_t freeCount;    /**< @brief Number of buffers which are not lent to a context. */
+} MQTTBufferPool_t;
+
+#if ( MQTT_QOS0_ONLY == 0 )
 
     /**
-     * @brief The maximum number of outgoing publish records.
+     * @brief Number of words of the free chunk bitmap of a #MQTTRecordSlab_t with
+     * the given number of chunks.
+     *
+     * @param[in] chunkCount Number of chunks in the slab.
      */
-    size_t outgoingPublishRecordMaxCount;
+    #define MQTT_RECORD_SLAB_BITMAP_WORDS( chunkCount )    ( ( ( chunkCount ) + 31U ) / 32U )
 
     /**
-     * @brief The maximum number of incoming publish records.
+     * @ingroup mqtt_struct_types
+     * @brief A slab of state records shared by many MQTT contexts.
+     *
+     * The records are divided into equally sized chunks. A context attached to the
+     * slab with #MQTT_SetRecordSlab claims a chunk for its outgoing or incoming
+     * publishes when it has a QoS1 or QoS2 publish in flight in that direction, and
+     * releases it when all of those publishes are complete. The total record memory
+     * therefore tracks the number of contexts with publishes in flight, rather than
+     * the number of contexts.
+     *
+     * @note The application only provides the memory for the slab through
+     * #MQTT_InitRecordSlab; the members are managed by the library.
      */
-    size_t incomingPublishRecordMaxCount;
+    typedef struct MQTTRecordSlab
+    {
+        MQTTPubAckInfo_t * pRecords; /**< @brief The records of all chunks. */
+        uint32_t * pFreeChunks;      /**< @brief Bitmap with a bit set for every free chunk. */
+        size_t recordsPerChunk;      /**< @brief Number of records in each chunk. */
+        size_t chunkCount;           /**< @brief Number of chunks in the slab. */
+    } MQTTRecordSlab_t;
+#endif /* if ( MQTT_QOS0_ONLY == 0 ) */
+
+/**
+ * @ingroup mqtt_struct_types
+ * @brief A struct representing an MQTT connection.
+ */
+typedef struct MQTTContext
+{
+    #if ( MQTT_QOS0_ONLY == 0 )
+
+        /**
+         * @brief State engine records for outgoing publishes.
+         */
+        MQTTPubAckInfo_t * outgoingPublishRecords;
+
+        /**
+         * @brief State engine records for incoming publishes.
+         */
+        MQTTPubAckInfo_t * incomingPublishRecords;
+
+        /**
+         * @brief The maximum number of outgoing publish records.
+         */
+        size_t outgoingPublishRecordMaxCount;
+
+        /**
+         * @brief The maximum number of incoming publish records.
+         */
+        size_t incomingPublishRecordMaxCount;
+    #endif
 
     /**
      * @brief The transport interface used by the MQTT connection.
@@ -305,20 +508,155 @@ typedef struct MQTTContext
     uint32_t pingReqSendTimeMs;    /**< @brief Timestamp of the last sent PINGREQ. */
     bool waitingForPingResp;       /**< @brief If the library is currently awaiting a PINGRESP. */
 
+    #if ( MQTT_QOS0_ONLY == 0 )
+
+        /**
+         * @brief User defined API used to store outgoing publishes.
+         */
+        MQTTStorePacketForRetransmit storeFunction;
+
+        /**
+         * @brief User defined API used to retreive a copied publish for resend operation.
+         */
+        MQTTRetrievePacketForRetransmit retrieveFunction;
+
+        /**
+         * @brief User defined API used to clear a particular copied publish packet.
+         */
+        MQTTClearPacketForRetransmit clearFunction;
+    #endif
+
+    /**
+     * @brief Open-addressed hash table of handlers for topic filters without
+     * wildcards.
+     */
+    MQTTTopicHandlerRecord_t * pExactTopicHandlers;
+
+    /**
+     * @brief Handlers for topic filters containing wildcards, in registration order.
+     */
+    MQTTTopicHandlerRecord_t * pWildcardTopicHandlers;
+
+    /**
+     * @brief The number of records in the exact-match topic handler table.
+     */
+    size_t exactTopicHandlerMaxCount;
+
+    /**
+     * @brief The maximum number of wildcard topic handlers.
+     */
+    size_t wildcardTopicHandlerMaxCount;
+
+    /**
+     * @brief The number of wildcard topic handlers currently registered.
+     */
+    size_t wildcardTopicHandlerCount;
+
+    /**
+     * @brief Pool from which receive buffers are borrowed. NULL if the context
+     * only uses its own network buffer.
+     */
+    MQTTBufferPool_t * pBufferPool;
+
+    /**
+     * @brief The network buffer given to #MQTT_Init, used while no buffer is
+     * borrowed from the pool.
+     */
+    MQTTFixedBuffer_t privateNetworkBuffer;
+
+    /**
+     * @brief Whether #MQTTContext_t.networkBuffer is borrowed from the pool.
+     */
+    bool networkBufferBorrowed;
+
+    /**
+     * @brief The pool buffer holding the incoming publish given to the
+     * application, which may claim it with #MQTT_ClaimNetworkBuffer. NULL
+     * otherwise.
+     */
+    uint8_t * pClaimableBuffer;
+
+    /**
+     * @brief The pool buffer taking the place of a claimed network buffer once
+     * the incoming publish is processed. NULL if the buffer was not claimed.
+     */
+    uint8_t * pReplacementBuffer;
+
+    #if ( MQTT_QOS0_ONLY == 0 )
+
+        /**
+         * @brief Slab from which chunks of state records are claimed. NULL if the
+         * records are provided with #MQTT_InitStatefulQoS.
+         */
+        MQTTRecordSlab_t * pRecordSlab;
+    #endif
+
+    /**
+     * @brief The MQTT protocol version of the connection, #MQTT_VERSION_3_1_1 or
+     * #MQTT_VERSION_5.
+     */
+    uint8_t protocolVersion;
+
+    /**
+     * @brief Topic alias table for outgoing publishes of MQTT 5. NULL if topic
+     * aliases are not used.
+     */
+    MQTTTopicAliasRecord_t * pTopicAliases;
+
+    /**
+     * @brief The number of records in the topic alias table.
+     */
+    uint16_t topicAliasMaxCount;
+
     /**
-     * @brief User defined API used to store outgoing publishes.
+     * @brief The number of topic aliases usable on the connection: the smaller of
+     * #MQTTContext_t.topicAliasMaxCount and the Topic Alias Maximum of the broker.
      */
-    MQTTStorePacketForRetransmit storeFunction;
+    uint16_t topicAliasCount;
 
     /**
-     * @brief User defined API used to retreive a copied publish for resend operation.
+     * @brief Incremented for every publish sent with a topic alias, to find the
+     * least recently used alias.
      */
-    MQTTRetrievePacketForRetransmit retrieveFunction;
+    uint32_t topicAliasClock;
 
     /**
-     * @brief User defined API used to clear a particular copied publish packet.
+     * @brief Handlers of MQTT 5 subscriptions, indexed by their Subscription
+     * Identifier minus one. NULL if no handler table is used.
      */
-    MQTTClearPacketForRetransmit clearFunction;
+    MQTTSubscriptionHandlerRecord_t * pSubscriptionHandlers;
+
+    /**
+     * @brief The number of records in the subscription handler table.
+     */
+    size_t subscriptionHandlerMaxCount;
+
+    /**
+     * @brief The subscription registry. NULL if subscriptions are not recorded.
+     */
+    MQTTSubscriptionRecord_t * pSubscriptionRecords;
+
+    /**
+     * @brief The number of records in the subscription registry.
+     */
+    size_t subscriptionRecordMaxCount;
+
+    /**
+     * @brief The buffer into which SUBSCRIBEs are serialized when the registry
+     * is subscribed to again after a clean session.
+     */
+    MQTTFixedBuffer_t subscriptionStagingBuffer;
+
+    /**
+     * @brief Completion tokens of operations awaiting their acknowledgement.
+     * NULL if no completion token table is used.
+     */
+    MQTTCompletionToken_t * pCompletionTokens;
+
+    /**
+     * @brief The number of records in the completion token table.
+     */
+    size_t completionTokenMaxCount;
 } MQTTContext_t;
 
 /**
@@ -331,6 +669,9 @@ typedef struct MQTTDeserializedInfo
     uint16_t packetIdentifier;          /**< @brief Packet ID of deserialized packet. */
     MQTTPublishInfo_t * pPublishInfo;   /**< @brief Pointer to deserialized publish info. */
     MQTTStatus_t deserializationResult; /**< @brief Return code of deserialization. */
+    const uint32_t * pSubscriptionIds;  /**< @brief MQTT 5 Subscription Identifiers of a PUBLISH. NULL if there are none. */
+    size_t subscriptionIdCount;         /**< @brief Number of entries in #MQTTDeserializedInfo_t.pSubscriptionIds. */
+    uint8_t reasonCode;                 /**< @brief MQTT 5 reason code of a PUBACK, PUBREC, PUBREL, PUBCOMP, DISCONNECT or AUTH. 0 otherwise. */
 } MQTTDeserializedInfo_t;
 
 /**
@@ -346,6 +687,10 @@ typedef struct MQTTDeserializedInfo
  * to be 0. This will result in loop functions running for a single iteration, and
  * #MQTT_Connect relying on #MQTT_MAX_CONNACK_RECEIVE_RETRY_COUNT to receive the CONNACK packet.
  *
+ * @note The optional #TransportGetTxBuffer_t and #TransportCommitTxBuffer_t
+ * functions of the transport interface are either both set or both NULL. When
+ * they are set, packets are written straight into the buffers of the transport.
+ *
  * @param[in] pContext The context to initialize.
  * @param[in] pTransportInterface The transport interface to use with the context.
  * @param[in] getTimeFunction The time utility function which can return the amount of time
@@ -387,6 +732,9 @@ typedef struct MQTTDeserializedInfo
  * // Clear context.
  * memset( ( void * ) &mqttContext, 0x00, sizeof( MQTTContext_t ) );
  *
+ * // Clear the transport interface, leaving its optional members unset.
+ * memset( ( void * ) &transport, 0x00, sizeof( TransportInterface_t ) );
+ *
  * // Set transport interface members.
  * transport.pNetworkContext = &someTransportContext;
  * transport.send = networkSend;
@@ -414,20 +762,202 @@ MQTTStatus_t MQTT_Init( MQTTContext_t * pContext,
                         const MQTTFixedBuffer_t * pNetworkBuffer );
 /* @[declare_mqtt_init] */
 
+#if ( MQTT_QOS0_ONLY == 0 )
+
+    /**
+     * @brief Initialize an MQTT context for QoS > 0.
+     *
+     * This function must be called on an #MQTTContext_t after MQTT_Init and before any other function.
+     *
+     * @param[in] pContext The context to initialize.
+     * @param[in] pOutgoingPublishRecords Pointer to memory which will be used to store state of outgoing
+     * publishes.
+     * @param[in] outgoingPublishCount Maximum number of records which can be kept in the memory
+     * pointed to by @p pOutgoingPublishRecords.
+     * @param[in] pIncomingPublishRecords Pointer to memory which will be used to store state of incoming
+     * publishes.
+     * @param[in] incomingPublishCount Maximum number of records which can be kept in the memory
+     * pointed to by @p pIncomingPublishRecords.
+     *
+     * @return #MQTTBadParameter if invalid parameters are passed;
+     * #MQTTSuccess otherwise.
+     *
+     * <b>Example</b>
+     * @code{c}
+     *
+     * // Function for obtaining a timestamp.
+     * uint32_t getTimeStampMs();
+     * // Callback function for receiving packets.
+     * void eventCallback(
+     *      MQTTContext_t * pContext,
+     *      MQTTPacketInfo_t * pPacketInfo,
+     *      MQTTDeserializedInfo_t * pDeserializedInfo
+     * );
+     * // Network send.
+     * int32_t networkSend( NetworkContext_t * pContext, const void * pBuffer, size_t bytes );
+     * // Network receive.
+     * int32_t networkRecv( NetworkContext_t * pContext, void * pBuffer, size_t bytes );
+     *
+     * MQTTContext_t mqttContext;
+     * TransportInterface_t transport;
+     * MQTTFixedBuffer_t fixedBuffer;
+     * uint8_t buffer[ 1024 ];
+     * const size_t outgoingPublishCount = 30;
+     * MQTTPubAckInfo_t outgoingPublishes[ outgoingPublishCount ];
+     *
+     * // Clear context.
+     * memset( ( void * ) &mqttContext, 0x00, sizeof( MQTTContext_t ) );
+     *
+     * // Clear the transport interface, leaving its optional members unset.
+     * memset( ( void * ) &transport, 0x00, sizeof( TransportInterface_t ) );
+     *
+     * // Set transport interface members.
+     * transport.pNetworkContext = &someTransportContext;
+     * transport.send = networkSend;
+     * transport.recv = networkRecv;
+     *
+     * // Set buffer members.
+     * fixedBuffer.pBuffer = buffer;
+     * fixedBuffer.size = 1024;
+     *
+     * status = MQTT_Init( &mqttContext, &transport, getTimeStampMs, eventCallback, &fixedBuffer );
+     *
+     * if( status == MQTTSuccess )
+     * {
+     *      // We do not expect any incoming publishes in this example, therefore the incoming
+     *      // publish pointer is NULL and the count is zero.
+     *      status = MQTT_InitStatefulQoS( &mqttContext, outgoingPublishes, outgoingPublishCount, NULL, 0 );
+     *
+     *      // Now QoS1 and/or QoS2 publishes can be sent with this context.
+     * }
+     * @endcode
+     */
+    /* @[declare_mqtt_initstatefulqos] */
+    MQTTStatus_t MQTT_InitStatefulQoS( MQTTContext_t * pContext,
+                                       MQTTPubAckInfo_t * pOutgoingPublishRecords,
+                                       size_t outgoingPublishCount,
+                                       MQTTPubAckInfo_t * pIncomingPublishRecords,
+                                       size_t incomingPublishCount );
+    /* @[declare_mqtt_initstatefulqos] */
+#endif /* if ( MQTT_QOS0_ONLY == 0 ) */
+
+#if ( MQTT_QOS0_ONLY == 0 )
+
+    /**
+     * @brief Initialize an MQTT context for publish retransmits for QoS > 0.
+     *
+     * This function must be called on an #MQTTContext_t after MQTT_InitstatefulQoS and before any other function.
+     *
+     * @param[in] pContext The context to initialize.
+     * @param[in] storeFunction User defined API used to store outgoing publishes.
+     * @param[in] retrieveFunction User defined API used to retreive a copied publish for resend operation.
+     * @param[in] clearFunction User defined API used to clear a particular copied publish packet.
+     *
+     * @return #MQTTBadParameter if invalid parameters are passed;
+     * #MQTTSuccess otherwise.
+     *
+     * <b>Example</b>
+     * @code{c}
+     *
+     * // Function for obtaining a timestamp.
+     * uint32_t getTimeStampMs();
+     * // Callback function for receiving packets.
+     * void eventCallback(
+     *      MQTTContext_t * pContext,
+     *      MQTTPacketInfo_t * pPacketInfo,
+     *      MQTTDeserializedInfo_t * pDeserializedInfo
+     * );
+     * // Network send.
+     * int32_t networkSend( NetworkContext_t * pContext, const void * pBuffer, size_t bytes );
+     * // Network receive.
+     * int32_t networkRecv( NetworkContext_t * pContext, void * pBuffer, size_t bytes );
+     * // User defined callback used to store outgoing publishes
+     * bool publishStoreCallback(struct MQTTContext* pContext,
+     *                           uint16_t packetId,
+     *                           MQTTVec_t* pIoVec);
+     * // User defined callback used to retreive a copied publish for resend operation
+     * bool publishRetrieveCallback(struct MQTTContext* pContext,
+     *                              uint16_t packetId,
+     *                              TransportOutVector_t** pIoVec,
+     *                              size_t* ioVecCount);
+     * // User defined callback used to clear a particular copied publish packet
+     * bool publishClearCallback(struct MQTTContext* pContext,
+     *                           uint16_t packetId);
+     * // User defined callback used to clear all copied publish packets
+     * bool publishClearAllCallback(struct MQTTContext* pContext);
+     *
+     * MQTTContext_t mqttContext;
+     * TransportInterface_t transport;
+     * MQTTFixedBuffer_t fixedBuffer;
+     * uint8_t buffer[ 1024 ];
+     * const size_t outgoingPublishCount = 30;
+     * MQTTPubAckInfo_t outgoingPublishes[ outgoingPublishCount ];
+     *
+     * // Clear context.
+     * memset( ( void * ) &mqttContext, 0x00, sizeof( MQTTContext_t ) );
+     *
+     * // Clear the transport interface, leaving its optional members unset.
+     * memset( ( void * ) &transport, 0x00, sizeof( TransportInterface_t ) );
+     *
+     * // Set transport interface members.
+     * transport.pNetworkContext = &someTransportContext;
+     * transport.send = networkSend;
+     * transport.recv = networkRecv;
+     *
+     * // Set buffer members.
+     * fixedBuffer.pBuffer = buffer;
+     * fixedBuffer.size = 1024;
+     *
+     * status = MQTT_Init( &mqttContext, &transport, getTimeStampMs, eventCallback, &fixedBuffer );
+     *
+     * if( status == MQTTSuccess )
+     * {
+     *      // We do not expect any incoming publishes in this example, therefore the incoming
+     *      // publish pointer is NULL and the count is zero.
+     *      status = MQTT_InitStatefulQoS( &mqttContext, outgoingPublishes, outgoingPublishCount, NULL, 0 );
+     *
+     *      // Now QoS1 and/or QoS2 publishes can be sent with this context.
+     * }
+     *
+     * if( status == MQTTSuccess )
+     * {
+     *      status = MQTT_InitRetransmits( &mqttContext, publishStoreCallback,
+     *                                                   publishRetrieveCallback,
+     *                                                   publishClearCallback,
+     *                                                   publishClearAllCallback );
+     *
+     *      // Now unacked Publishes can be resent on an unclean session resumption.
+     * }
+     * @endcode
+     */
+
+    /* @[declare_mqtt_initretransmits] */
+    MQTTStatus_t MQTT_InitRetransmits( MQTTContext_t * pContext,
+                                       MQTTStorePacketForRetransmit storeFunction,
+                                       MQTTRetrievePacketForRetransmit retrieveFunction,
+                                       MQTTClearPacketForRetransmit clearFunction );
+    /* @[declare_mqtt_initretransmits] */
+#endif /* if ( MQTT_QOS0_ONLY == 0 ) */
+
 /**
- * @brief Initialize an MQTT context for QoS > 0.
+ * @brief Initialize an MQTT context for per-topic dispatch of incoming publishes.
+ *
+ * This function must be called on an #MQTTContext_t after MQTT_Init and before
+ * #MQTT_RegisterTopicHandler. Any records in the provided memory are cleared.
  *
- * This function must be called on an #MQTTContext_t after MQTT_Init and before any other function.
+ * Topic filters without wildcards are kept in an open-addressed hash table so that
+ * an incoming publish on such a topic is dispatched with a single hash lookup.
+ * Topic filters with wildcards are kept in a separate list which is only searched
+ * when no exact-match handler exists for the topic of the incoming publish.
  *
  * @param[in] pContext The context to initialize.
- * @param[in] pOutgoingPublishRecords Pointer to memory which will be used to store state of outgoing
- * publishes.
- * @param[in] outgoingPublishCount Maximum number of records which can be kept in the memory
- * pointed to by @p pOutgoingPublishRecords.
- * @param[in] pIncomingPublishRecords Pointer to memory which will be used to store state of incoming
- * publishes.
- * @param[in] incomingPublishCount Maximum number of records which can be kept in the memory
- * pointed to by @p pIncomingPublishRecords.
+ * @param[in] pExactTopicHandlers Pointer to memory used for the hash table of
+ * handlers for topic filters without wildcards.
+ * @param[in] exactTopicHandlerCount Number of records in @p pExactTopicHandlers.
+ * Sizing the table larger than the number of filters keeps the probe sequences short.
+ * @param[in] pWildcardTopicHandlers Pointer to memory used to store the handlers
+ * for topic filters with wildcards.
+ * @param[in] wildcardTopicHandlerCount Number of records in @p pWildcardTopicHandlers.
  *
  * @return #MQTTBadParameter if invalid parameters are passed;
  * #MQTTSuccess otherwise.
@@ -435,149 +965,578 @@ MQTTStatus_t MQTT_Init( MQTTContext_t * pContext,
  * <b>Example</b>
  * @code{c}
  *
- * // Function for obtaining a timestamp.
- * uint32_t getTimeStampMs();
- * // Callback function for receiving packets.
- * void eventCallback(
- *      MQTTContext_t * pContext,
- *      MQTTPacketInfo_t * pPacketInfo,
- *      MQTTDeserializedInfo_t * pDeserializedInfo
- * );
- * // Network send.
- * int32_t networkSend( NetworkContext_t * pContext, const void * pBuffer, size_t bytes );
- * // Network receive.
- * int32_t networkRecv( NetworkContext_t * pContext, void * pBuffer, size_t bytes );
- *
  * MQTTContext_t mqttContext;
- * TransportInterface_t transport;
- * MQTTFixedBuffer_t fixedBuffer;
- * uint8_t buffer[ 1024 ];
- * const size_t outgoingPublishCount = 30;
- * MQTTPubAckInfo_t outgoingPublishes[ outgoingPublishCount ];
+ * MQTTTopicHandlerRecord_t exactHandlers[ 16 ];
+ * MQTTTopicHandlerRecord_t wildcardHandlers[ 4 ];
  *
- * // Clear context.
- * memset( ( void * ) &mqttContext, 0x00, sizeof( MQTTContext_t ) );
+ * // Initialize the context with MQTT_Init first.
+ * status = MQTT_InitTopicHandlers( &mqttContext,
+ *                                  exactHandlers, 16,
+ *                                  wildcardHandlers, 4 );
  *
- * // Set transport interface members.
- * transport.pNetworkContext = &someTransportContext;
- * transport.send = networkSend;
- * transport.recv = networkRecv;
+ * if( status == MQTTSuccess )
+ * {
+ *      // Handlers can now be registered with MQTT_RegisterTopicHandler.
+ * }
+ * @endcode
+ */
+/* @[declare_mqtt_inittopichandlers] */
+MQTTStatus_t MQTT_InitTopicHandlers( MQTTContext_t * pContext,
+                                     MQTTTopicHandlerRecord_t * pExactTopicHandlers,
+                                     size_t exactTopicHandlerCount,
+                                     MQTTTopicHandlerRecord_t * pWildcardTopicHandlers,
+                                     size_t wildcardTopicHandlerCount );
+/* @[declare_mqtt_inittopichandlers] */
+
+/**
+ * @brief Register a handler for incoming publishes matching a topic filter.
  *
- * // Set buffer members.
- * fixedBuffer.pBuffer = buffer;
- * fixedBuffer.size = 1024;
+ * Incoming publishes are dispatched to the handler of the topic filter which is
+ * an exact match of their topic name. If there is none, the wildcard topic filters
+ * are tried in registration order and the first matching handler is invoked.
+ * Publishes that match no registered topic filter are given to the
+ * #MQTTEventCallback_t of the context. Acks are always given to the
+ * #MQTTEventCallback_t.
  *
- * status = MQTT_Init( &mqttContext, &transport, getTimeStampMs, eventCallback, &fixedBuffer );
+ * Registering a topic filter which is already registered replaces its handler.
+ *
+ * @note The library does not copy the topic filter; the memory pointed to by
+ * @p pTopicFilter must remain valid until the handler is unregistered.
+ *
+ * @note This function must not be called concurrently with #MQTT_ProcessLoop or
+ * #MQTT_ReceiveLoop on the same context.
+ *
+ * @param[in] pContext Context initialized with #MQTT_InitTopicHandlers.
+ * @param[in] pTopicFilter The topic filter to register.
+ * @param[in] topicFilterLength Length of the topic filter.
+ * @param[in] handler The handler to invoke for matching incoming publishes.
+ * @param[in] pHandlerContext Application context passed to @p handler.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed, or if
+ * @p pTopicFilter is not a valid topic filter according to
+ * #MQTT_ValidateTopic; #MQTTNoMemory if there is no free record left for the
+ * topic filter; #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * // Handler for temperature readings.
+ * void temperatureHandler( MQTTContext_t * pContext,
+ *                          MQTTPacketInfo_t * pPacketInfo,
+ *                          MQTTDeserializedInfo_t * pDeserializedInfo,
+ *                          void * pHandlerContext );
+ *
+ * status = MQTT_RegisterTopicHandler( &mqttContext,
+ *                                     "sensors/+/temperature",
+ *                                     strlen( "sensors/+/temperature" ),
+ *                                     temperatureHandler,
+ *                                     &temperatureState );
+ * @endcode
+ */
+/* @[declare_mqtt_registertopichandler] */
+MQTTStatus_t MQTT_RegisterTopicHandler( MQTTContext_t * pContext,
+                                        const char * pTopicFilter,
+                                        uint16_t topicFilterLength,
+                                        MQTTTopicHandler_t handler,
+                                        void * pHandlerContext );
+/* @[declare_mqtt_registertopichandler] */
+
+/**
+ * @brief Remove the handler registered for a topic filter.
+ *
+ * @note This function must not be called concurrently with #MQTT_ProcessLoop or
+ * #MQTT_ReceiveLoop on the same context.
+ *
+ * @param[in] pContext Context initialized with #MQTT_InitTopicHandlers.
+ * @param[in] pTopicFilter The topic filter to unregister.
+ * @param[in] topicFilterLength Length of the topic filter.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed or the topic filter
+ * is not registered; #MQTTSuccess otherwise.
+ */
+/* @[declare_mqtt_unregistertopichandler] */
+MQTTStatus_t MQTT_UnregisterTopicHandler( MQTTContext_t * pContext,
+                                          const char * pTopicFilter,
+                                          uint16_t topicFilterLength );
+/* @[declare_mqtt_unregistertopichandler] */
+
+/**
+ * @brief Initialize a pool of network buffers which can be shared by many
+ * MQTT contexts.
+ *
+ * @param[in] pBufferPool The pool to initialize.
+ * @param[in] pBuffers Contiguous memory for @p bufferCount buffers of
+ * @p bufferSize bytes each.
+ * @param[in] bufferSize Size of each buffer. It must be large enough for the
+ * largest packet expected, and at least the size of a pointer.
+ * @param[in] bufferCount Number of buffers in @p pBuffers.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * // 64 buffers of 2 KB, shared by all the connections of a gateway.
+ * static uint8_t poolMemory[ 64 * 2048 ];
+ * static MQTTBufferPool_t bufferPool;
+ *
+ * status = MQTT_InitBufferPool( &bufferPool, poolMemory, 2048, 64 );
+ * @endcode
+ */
+/* @[declare_mqtt_initbufferpool] */
+MQTTStatus_t MQTT_InitBufferPool( MQTTBufferPool_t * pBufferPool,
+                                  uint8_t * pBuffers,
+                                  size_t bufferSize,
+                                  size_t bufferCount );
+/* @[declare_mqtt_initbufferpool] */
+
+/**
+ * @brief Make an MQTT context borrow its receive buffer from a shared pool.
+ *
+ * The context borrows a buffer from the pool when it starts receiving a packet,
+ * keeps it while a packet is partially received, and returns it as soon as all
+ * received packets have been processed. A context which is not receiving holds
+ * no pool buffer.
+ *
+ * If the pool is exhausted, the context falls back to the network buffer given
+ * to #MQTT_Init. If that buffer has a NULL #MQTTFixedBuffer_t.pBuffer, nothing is
+ * read from the transport: #MQTT_ProcessLoop and #MQTT_ReceiveLoop still manage
+ * keep-alive but return #MQTTNoMemory, and #MQTT_Connect returns #MQTTNoMemory
+ * without sending CONNECT. Incoming data is left in the transport until a
+ * buffer is free.
+ *
+ * @note Calls to the pool are serialized with the MQTT_PRE_BUFFER_POOL_HOOK and
+ * MQTT_POST_BUFFER_POOL_HOOK macros, which must be defined to take a lock if
+ * contexts sharing a pool are used from different threads.
+ *
+ * @param[in] pContext Context initialized with #MQTT_Init, which is not
+ * receiving a packet.
+ * @param[in] pBufferPool Pool initialized with #MQTT_InitBufferPool, or NULL to
+ * stop using a pool.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed or the context is
+ * receiving a packet; #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * // The context has no network buffer of its own.
+ * MQTTFixedBuffer_t noBuffer = { NULL, 0 };
+ *
+ * status = MQTT_Init( &mqttContext, &transport, getTimeStampMs, eventCallback, &noBuffer );
  *
  * if( status == MQTTSuccess )
  * {
- *      // We do not expect any incoming publishes in this example, therefore the incoming
- *      // publish pointer is NULL and the count is zero.
- *      status = MQTT_InitStatefulQoS( &mqttContext, outgoingPublishes, outgoingPublishCount, NULL, 0 );
+ *      status = MQTT_SetBufferPool( &mqttContext, &bufferPool );
+ * }
+ * @endcode
+ */
+/* @[declare_mqtt_setbufferpool] */
+MQTTStatus_t MQTT_SetBufferPool( MQTTContext_t * pContext,
+                                 MQTTBufferPool_t * pBufferPool );
+/* @[declare_mqtt_setbufferpool] */
+
+/**
+ * @brief Claim the network buffer holding an incoming publish, so that the
+ * application keeps the publish without copying it.
+ *
+ * The topic name and payload of an incoming publish point into the network
+ * buffer of the context, which is reused once the callback returns. Called
+ * from the #MQTTEventCallback_t or the #MQTTTopicHandler_t given the publish,
+ * this function hands the buffer to the application instead: the publish
+ * stays valid until the buffer is given back with
+ * #MQTT_ReleaseNetworkBuffer, for example by a worker thread. The context
+ * continues with another buffer of its pool.
+ *
+ * Only a buffer borrowed from the pool set with #MQTT_SetBufferPool can be
+ * claimed, and only if the pool has a free buffer to replace it.
+ *
+ * @param[in] pContext The context giving the incoming publish.
+ * @param[out] ppBuffer The claimed buffer, to pass to
+ * #MQTT_ReleaseNetworkBuffer.
  *
- *      // Now QoS1 and/or QoS2 publishes can be sent with this context.
+ * @return #MQTTBadParameter if invalid parameters are passed, or if the
+ * context is not giving an incoming publish held in a pool buffer, which
+ * includes a publish already claimed; #MQTTNoMemory if the pool has no buffer
+ * to replace the claimed one; #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * void eventCallback( MQTTContext_t * pContext,
+ *                     MQTTPacketInfo_t * pPacketInfo,
+ *                     MQTTDeserializedInfo_t * pDeserializedInfo )
+ * {
+ *      uint8_t * pBuffer;
+ *
+ *      if( ( pPacketInfo->type & 0xF0U ) == MQTT_PACKET_TYPE_PUBLISH )
+ *      {
+ *          if( MQTT_ClaimNetworkBuffer( pContext, &pBuffer ) == MQTTSuccess )
+ *          {
+ *              // The worker calls MQTT_ReleaseNetworkBuffer( &bufferPool, pBuffer )
+ *              // once done with the publish.
+ *              queueToWorker( pDeserializedInfo->pPublishInfo, pBuffer );
+ *          }
+ *          else
+ *          {
+ *              // Process or copy the publish before returning.
+ *          }
+ *      }
  * }
  * @endcode
  */
-/* @[declare_mqtt_initstatefulqos] */
-MQTTStatus_t MQTT_InitStatefulQoS( MQTTContext_t * pContext,
-                                   MQTTPubAckInfo_t * pOutgoingPublishRecords,
-                                   size_t outgoingPublishCount,
-                                   MQTTPubAckInfo_t * pIncomingPublishRecords,
-                                   size_t incomingPublishCount );
-/* @[declare_mqtt_initstatefulqos] */
+/* @[declare_mqtt_claimnetworkbuffer] */
+MQTTStatus_t MQTT_ClaimNetworkBuffer( MQTTContext_t * pContext,
+                                      uint8_t ** ppBuffer );
+/* @[declare_mqtt_claimnetworkbuffer] */
 
 /**
- * @brief Initialize an MQTT context for publish retransmits for QoS > 0.
+ * @brief Give a network buffer claimed with #MQTT_ClaimNetworkBuffer back to
+ * its pool.
  *
- * This function must be called on an #MQTTContext_t after MQTT_InitstatefulQoS and before any other function.
+ * @note This function may be called from any thread, as calls to the pool
+ * are serialized with the MQTT_PRE_BUFFER_POOL_HOOK and
+ * MQTT_POST_BUFFER_POOL_HOOK macros.
  *
- * @param[in] pContext The context to initialize.
- * @param[in] storeFunction User defined API used to store outgoing publishes.
- * @param[in] retrieveFunction User defined API used to retreive a copied publish for resend operation.
- * @param[in] clearFunction User defined API used to clear a particular copied publish packet.
+ * @param[in] pBufferPool The pool of the context which gave the buffer.
+ * @param[in] pBuffer The claimed buffer.
  *
  * @return #MQTTBadParameter if invalid parameters are passed;
  * #MQTTSuccess otherwise.
+ */
+/* @[declare_mqtt_releasenetworkbuffer] */
+MQTTStatus_t MQTT_ReleaseNetworkBuffer( MQTTBufferPool_t * pBufferPool,
+                                        uint8_t * pBuffer );
+/* @[declare_mqtt_releasenetworkbuffer] */
+
+/**
+ * @brief Select the MQTT protocol version used by a context.
+ *
+ * A context uses MQTT 3.1.1 unless MQTT 5 is selected with this function. In
+ * MQTT 5 mode the library sends packets without properties, except for the
+ * Topic Alias of outgoing publishes enabled with #MQTT_InitTopicAliases, and
+ * reads the reason codes and properties of the packets received. Incoming
+ * publishes with a Topic Alias are rejected, as the CONNECT does not allow the
+ * broker to send them.
+ *
+ * @param[in] pContext Context initialized with #MQTT_Init, which is not
+ * connected.
+ * @param[in] protocolVersion #MQTT_VERSION_3_1_1 or #MQTT_VERSION_5.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed or the context is
+ * connected; #MQTTSuccess otherwise.
+ */
+/* @[declare_mqtt_setprotocolversion] */
+MQTTStatus_t MQTT_SetProtocolVersion( MQTTContext_t * pContext,
+                                      uint8_t protocolVersion );
+/* @[declare_mqtt_setprotocolversion] */
+
+/**
+ * @brief Enable MQTT 5 topic aliases for the outgoing publishes of a context.
+ *
+ * After every CONNACK, the library uses as many records as the Topic Alias
+ * Maximum of the broker allows. The first publish to a topic assigns it a free
+ * alias, or the least recently used one when all are assigned, and is sent
+ * with both the topic name and the alias. Later publishes to the topic are
+ * sent with the alias and an empty topic name. The aliases are forgotten when
+ * the connection is established again.
+ *
+ * QoS1 and QoS2 publishes of a context with retransmit callbacks set with
+ * #MQTT_InitRetransmits are sent with their topic name and no alias, so that
+ * a copy resent on a new connection does not refer to an alias of the old one.
+ *
+ * @param[in] pContext Context initialized with #MQTT_Init and set to
+ * #MQTT_VERSION_5 with #MQTT_SetProtocolVersion, which is not connected.
+ * @param[in] pTopicAliases Memory for the topic alias table.
+ * @param[in] topicAliasCount Number of records in @p pTopicAliases, up to
+ * `UINT16_MAX`.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed, the context does
+ * not use MQTT 5 or is connected; #MQTTSuccess otherwise.
  *
  * <b>Example</b>
  * @code{c}
  *
- * // Function for obtaining a timestamp.
- * uint32_t getTimeStampMs();
- * // Callback function for receiving packets.
- * void eventCallback(
- *      MQTTContext_t * pContext,
- *      MQTTPacketInfo_t * pPacketInfo,
- *      MQTTDeserializedInfo_t * pDeserializedInfo
- * );
- * // Network send.
- * int32_t networkSend( NetworkContext_t * pContext, const void * pBuffer, size_t bytes );
- * // Network receive.
- * int32_t networkRecv( NetworkContext_t * pContext, void * pBuffer, size_t bytes );
- * // User defined callback used to store outgoing publishes
- * bool publishStoreCallback(struct MQTTContext* pContext,
- *                           uint16_t packetId,
- *                           MQTTVec_t* pIoVec);
- * // User defined callback used to retreive a copied publish for resend operation
- * bool publishRetrieveCallback(struct MQTTContext* pContext,
- *                              uint16_t packetId,
- *                              TransportOutVector_t** pIoVec,
- *                              size_t* ioVecCount);
- * // User defined callback used to clear a particular copied publish packet
- * bool publishClearCallback(struct MQTTContext* pContext,
- *                           uint16_t packetId);
- * // User defined callback used to clear all copied publish packets
- * bool publishClearAllCallback(struct MQTTContext* pContext);
+ * // Aliases for the 16 topics a device publishes to.
+ * static MQTTTopicAliasRecord_t topicAliases[ 16 ];
  *
- * MQTTContext_t mqttContext;
- * TransportInterface_t transport;
- * MQTTFixedBuffer_t fixedBuffer;
- * uint8_t buffer[ 1024 ];
- * const size_t outgoingPublishCount = 30;
- * MQTTPubAckInfo_t outgoingPublishes[ outgoingPublishCount ];
+ * status = MQTT_SetProtocolVersion( &mqttContext, MQTT_VERSION_5 );
  *
- * // Clear context.
- * memset( ( void * ) &mqttContext, 0x00, sizeof( MQTTContext_t ) );
+ * if( status == MQTTSuccess )
+ * {
+ *      status = MQTT_InitTopicAliases( &mqttContext, topicAliases, 16 );
+ * }
+ * @endcode
+ */
+/* @[declare_mqtt_inittopicaliases] */
+MQTTStatus_t MQTT_InitTopicAliases( MQTTContext_t * pContext,
+                                    MQTTTopicAliasRecord_t * pTopicAliases,
+                                    size_t topicAliasCount );
+/* @[declare_mqtt_inittopicaliases] */
+
+/**
+ * @brief Initialize an MQTT context for dispatch of incoming MQTT 5 publishes
+ * by Subscription Identifier.
  *
- * // Set transport interface members.
- * transport.pNetworkContext = &someTransportContext;
- * transport.send = networkSend;
- * transport.recv = networkRecv;
+ * This function must be called on an #MQTTContext_t after MQTT_Init and before
+ * #MQTT_RegisterSubscriptionHandler. Any records in the provided memory are
+ * cleared. The record of Subscription Identifier `n` is
+ * `pSubscriptionHandlers[ n - 1 ]`, so an application numbering its
+ * subscriptions from 1 needs one record per subscription.
  *
- * // Set buffer members.
- * fixedBuffer.pBuffer = buffer;
- * fixedBuffer.size = 1024;
+ * @param[in] pContext The context to initialize.
+ * @param[in] pSubscriptionHandlers Memory for the subscription handler table.
+ * @param[in] subscriptionHandlerCount Number of records in
+ * @p pSubscriptionHandlers, up to #MQTT_SUBSCRIPTION_ID_MAX.
  *
- * status = MQTT_Init( &mqttContext, &transport, getTimeStampMs, eventCallback, &fixedBuffer );
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * // Handlers for Subscription Identifiers 1 to 32.
+ * static MQTTSubscriptionHandlerRecord_t subscriptionHandlers[ 32 ];
+ *
+ * // Initialize the context with MQTT_Init first.
+ * status = MQTT_InitSubscriptionHandlers( &mqttContext, subscriptionHandlers, 32 );
  *
  * if( status == MQTTSuccess )
  * {
- *      // We do not expect any incoming publishes in this example, therefore the incoming
- *      // publish pointer is NULL and the count is zero.
- *      status = MQTT_InitStatefulQoS( &mqttContext, outgoingPublishes, outgoingPublishCount, NULL, 0 );
- *
- *      // Now QoS1 and/or QoS2 publishes can be sent with this context.
+ *      // Handlers can now be registered with MQTT_RegisterSubscriptionHandler.
  * }
+ * @endcode
+ */
+/* @[declare_mqtt_initsubscriptionhandlers] */
+MQTTStatus_t MQTT_InitSubscriptionHandlers( MQTTContext_t * pContext,
+                                            MQTTSubscriptionHandlerRecord_t * pSubscriptionHandlers,
+                                            size_t subscriptionHandlerCount );
+/* @[declare_mqtt_initsubscriptionhandlers] */
+
+/**
+ * @brief Register a handler for incoming publishes of the MQTT 5
+ * subscriptions made with a Subscription Identifier.
+ *
+ * The broker tags every publish it sends for a subscription with the
+ * Subscription Identifier given in #MQTT_SubscribeWithId, so an incoming
+ * publish is dispatched to its handler with an array index instead of
+ * matching its topic against topic filters. A publish matching several
+ * subscriptions is given to the handler of each of them. Publishes without a
+ * Subscription Identifier that has a handler are dispatched as described in
+ * #MQTT_RegisterTopicHandler.
+ *
+ * Registering a Subscription Identifier which already has a handler replaces
+ * it. A NULL @p handler removes the handler of the Subscription Identifier.
+ *
+ * @note This function must not be called concurrently with #MQTT_ProcessLoop or
+ * #MQTT_ReceiveLoop on the same context.
+ *
+ * @param[in] pContext Context initialized with #MQTT_InitSubscriptionHandlers.
+ * @param[in] subscriptionId The Subscription Identifier, from 1 to the number
+ * of records of the subscription handler table.
+ * @param[in] handler The handler to invoke for publishes of the subscription,
+ * or NULL.
+ * @param[in] pHandlerContext Application context passed to @p handler.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * #define TEMPERATURE_SUBSCRIPTION_ID    ( 1U )
+ *
+ * status = MQTT_RegisterSubscriptionHandler( &mqttContext,
+ *                                            TEMPERATURE_SUBSCRIPTION_ID,
+ *                                            temperatureHandler,
+ *                                            &temperatureState );
  *
  * if( status == MQTTSuccess )
  * {
- *      status = MQTT_InitRetransmits( &mqttContext, publishStoreCallback,
- *                                                   publishRetrieveCallback,
- *                                                   publishClearCallback,
- *                                                   publishClearAllCallback );
+ *      status = MQTT_SubscribeWithId( &mqttContext,
+ *                                     &temperatureSubscription,
+ *                                     1,
+ *                                     MQTT_GetPacketId( &mqttContext ),
+ *                                     TEMPERATURE_SUBSCRIPTION_ID );
+ * }
+ * @endcode
+ */
+/* @[declare_mqtt_registersubscriptionhandler] */
+MQTTStatus_t MQTT_RegisterSubscriptionHandler( MQTTContext_t * pContext,
+                                               uint32_t subscriptionId,
+                                               MQTTTopicHandler_t handler,
+                                               void * pHandlerContext );
+/* @[declare_mqtt_registersubscriptionhandler] */
+
+/**
+ * @brief Initialize the subscription registry of an MQTT context.
+ *
+ * With a registry, the topic filters and requested QoS of the subscriptions
+ * made with #MQTT_Subscribe, #MQTT_SubscribeWithId and #MQTT_SubscribeBulk are
+ * recorded, and kept once their SUBACK grants them. #MQTT_Unsubscribe and
+ * #MQTT_UnsubscribeBulk remove them again.
+ *
+ * When #MQTT_Connect starts a new session, the broker has no subscriptions of
+ * the client, so #MQTT_Connect subscribes again to every topic filter of the
+ * registry. The topic filters are packed into as few SUBSCRIBE packets as fit
+ * in @p pStagingBuffer, which are sent back to back without waiting for their
+ * SUBACKs. Topic filters subscribed to with #MQTT_SubscribeWithId are grouped
+ * into SUBSCRIBE packets carrying the same Subscription Identifier. The SUBACKs are given to the event callback as usual, where the
+ * return code of each topic filter can be found with
+ * #MQTT_GetSubAckStatusCodes, or #MQTT_GetSubAckReasonCodesV5 for MQTT 5, at
+ * the #MQTTSubscriptionRecord_t.subAckIndex of its record. A topic filter refused by the broker is removed from the
+ * registry once the event callback returns.
+ *
+ * Topic filters longer than #MQTT_SUBSCRIPTION_REGISTRY_MAX_FILTER_LENGTH, or
+ * subscribed to while the registry is full, are not recorded.
+ *
+ * @param[in] pContext Context initialized with #MQTT_Init, which is not
+ * connected.
+ * @param[in] pSubscriptionRecords Memory for the subscription registry.
+ * @param[in] subscriptionRecordCount Number of records in
+ * @p pSubscriptionRecords.
+ * @param[in] pStagingBuffer Buffer of at least
+ * #MQTT_SUBSCRIPTION_REGISTRY_MAX_FILTER_LENGTH + 16 bytes, into which
+ * SUBSCRIBE packets are serialized by #MQTT_Connect. It must not be used by
+ * the application while #MQTT_Connect runs.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed, the staging
+ * buffer is too small or the context is connected; #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
  *
- *      // Now unacked Publishes can be resent on an unclean session resumption.
+ * // A registry of up to 64 subscriptions.
+ * static MQTTSubscriptionRecord_t subscriptionRecords[ 64 ];
+ * static uint8_t resubscribeBuffer[ 1024 ];
+ * MQTTFixedBuffer_t stagingBuffer = { resubscribeBuffer, sizeof( resubscribeBuffer ) };
+ *
+ * // Initialize the context with MQTT_Init first.
+ * status = MQTT_InitSubscriptionRegistry( &mqttContext,
+ *                                         subscriptionRecords,
+ *                                         64,
+ *                                         &stagingBuffer );
+ *
+ * if( status == MQTTSuccess )
+ * {
+ *      // Subscriptions made from now on are made again by MQTT_Connect
+ *      // whenever the broker has no session for the client.
+ *      status = MQTT_Connect( &mqttContext, &connectInfo, NULL, 1000, &sessionPresent );
  * }
  * @endcode
  */
+/* @[declare_mqtt_initsubscriptionregistry] */
+MQTTStatus_t MQTT_InitSubscriptionRegistry( MQTTContext_t * pContext,
+                                            MQTTSubscriptionRecord_t * pSubscriptionRecords,
+                                            size_t subscriptionRecordCount,
+                                            const MQTTFixedBuffer_t * pStagingBuffer );
+/* @[declare_mqtt_initsubscriptionregistry] */
+
+/**
+ * @brief Initialize the completion token table of an MQTT context.
+ *
+ * Each publish or subscribe started with #MQTT_PublishWithCompletion or
+ * #MQTT_SubscribeWithCompletion holds a token until it is acknowledged, so the
+ * table needs a record for every such operation in flight.
+ *
+ * Operations still awaiting their acknowledgement when #MQTT_Connect makes a
+ * new connection are abandoned: subscribes always, as SUBSCRIBE packets are
+ * not sent again, and publishes when the broker has no session for the
+ * client. Their callbacks are invoked with #MQTTStatusNotConnected.
+ *
+ * @param[in] pContext Context initialized with #MQTT_Init, which is not
+ * connected.
+ * @param[in] pCompletionTokens Memory for the completion token table.
+ * @param[in] completionTokenCount Number of records in @p pCompletionTokens.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed or the context is
+ * connected; #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * // Up to 16 operations in flight.
+ * static MQTTCompletionToken_t completionTokens[ 16 ];
+ *
+ * // Initialize the context with MQTT_Init first.
+ * status = MQTT_InitCompletionTokens( &mqttContext, completionTokens, 16 );
+ * @endcode
+ */
+/* @[declare_mqtt_initcompletiontokens] */
+MQTTStatus_t MQTT_InitCompletionTokens( MQTTContext_t * pContext,
+                                        MQTTCompletionToken_t * pCompletionTokens,
+                                        size_t completionTokenCount );
+/* @[declare_mqtt_initcompletiontokens] */
 
-/* @[declare_mqtt_initretransmits] */
-MQTTStatus_t MQTT_InitRetransmits( MQTTContext_t * pContext,
-                                   MQTTStorePacketForRetransmit storeFunction,
-                                   MQTTRetrievePacketForRetransmit retrieveFunction,
-                                   MQTTClearPacketForRetransmit clearFunction );
-/* @[declare_mqtt_initretransmits] */
+#if ( MQTT_QOS0_ONLY == 0 )
+
+    /**
+     * @brief Initialize a slab of state records which can be shared by many MQTT
+     * contexts.
+     *
+     * @param[in] pRecordSlab The slab to initialize.
+     * @param[in] pRecords Memory for @p chunkCount chunks of @p recordsPerChunk
+     * records each.
+     * @param[in] recordsPerChunk Number of records in each chunk. This is the
+     * maximum number of publishes a context can have in flight in each direction.
+     * @param[in] pFreeChunks Memory for the free chunk bitmap, of
+     * #MQTT_RECORD_SLAB_BITMAP_WORDS( @p chunkCount ) words.
+     * @param[in] chunkCount Number of chunks in the slab.
+     *
+     * @return #MQTTBadParameter if invalid parameters are passed;
+     * #MQTTSuccess otherwise.
+     *
+     * <b>Example</b>
+     * @code{c}
+     *
+     * // 256 chunks of 8 records, shared by all the connections of a gateway.
+     * static MQTTPubAckInfo_t slabRecords[ 256 * 8 ];
+     * static uint32_t slabFreeChunks[ MQTT_RECORD_SLAB_BITMAP_WORDS( 256 ) ];
+     * static MQTTRecordSlab_t recordSlab;
+     *
+     * status = MQTT_InitRecordSlab( &recordSlab, slabRecords, 8, slabFreeChunks, 256 );
+     * @endcode
+     */
+    /* @[declare_mqtt_initrecordslab] */
+    MQTTStatus_t MQTT_InitRecordSlab( MQTTRecordSlab_t * pRecordSlab,
+                                      MQTTPubAckInfo_t * pRecords,
+                                      size_t recordsPerChunk,
+                                      uint32_t * pFreeChunks,
+                                      size_t chunkCount );
+    /* @[declare_mqtt_initrecordslab] */
+#endif /* if ( MQTT_QOS0_ONLY == 0 ) */
+
+#if ( MQTT_QOS0_ONLY == 0 )
+
+    /**
+     * @brief Enable QoS1 and QoS2 publishes on an MQTT context with state records
+     * claimed on demand from a shared slab.
+     *
+     * This is an alternative to #MQTT_InitStatefulQoS, for applications with many
+     * connections of which only a few have publishes in flight at a time. When no
+     * chunk is free, #MQTT_Publish of a QoS1 or QoS2 message returns #MQTTNoMemory,
+     * and so does #MQTT_ProcessLoop for an incoming QoS1 or QoS2 publish, in the
+     * same way as when the records given to #MQTT_InitStatefulQoS are full.
+     *
+     * @note Unless #MQTT_RECORD_SLAB_USE_ATOMICS is enabled, calls to the slab are
+     * serialized with the MQTT_PRE_RECORD_SLAB_HOOK and MQTT_POST_RECORD_SLAB_HOOK
+     * macros.
+     *
+     * @param[in] pContext Context initialized with #MQTT_Init, on which
+     * #MQTT_InitStatefulQoS has not been called.
+     * @param[in] pRecordSlab Slab initialized with #MQTT_InitRecordSlab, or NULL to
+     * stop using a slab.
+     *
+     * @return #MQTTBadParameter if invalid parameters are passed, the context has
+     * its own state records or it still holds a chunk of the slab;
+     * #MQTTSuccess otherwise.
+     */
+    /* @[declare_mqtt_setrecordslab] */
+    MQTTStatus_t MQTT_SetRecordSlab( MQTTContext_t * pContext,
+                                     MQTTRecordSlab_t * pRecordSlab );
+    /* @[declare_mqtt_setrecordslab] */
+#endif /* if ( MQTT_QOS0_ONLY == 0 ) */
 
 /**
  * @brief Checks the MQTT connection status with the broker.
@@ -774,6 +1733,156 @@ MQTTStatus_t MQTT_Subscribe( MQTTContext_t * pContext,
                              uint16_t packetId );
 /* @[declare_mqtt_subscribe] */
 
+/**
+ * @brief Sends an MQTT 5 SUBSCRIBE with a Subscription Identifier for the
+ * given list of topic filters to the broker.
+ *
+ * The broker returns the Subscription Identifier with every publish it sends
+ * for these topic filters. It is given to the application in
+ * #MQTTDeserializedInfo_t.pSubscriptionIds, and used to find the handler
+ * registered with #MQTT_RegisterSubscriptionHandler.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] pSubscriptionList Array of MQTT subscription info.
+ * @param[in] subscriptionCount The number of elements in @ pSubscriptionList
+ * array.
+ * @param[in] packetId Packet ID generated by #MQTT_GetPacketId.
+ * @param[in] subscriptionId The Subscription Identifier, from 1 to
+ * #MQTT_SUBSCRIPTION_ID_MAX, or 0 for none. A context which does not use
+ * #MQTT_VERSION_5 only accepts 0.
+ *
+ * @return #MQTTNoMemory if the #MQTTContext_t.networkBuffer is too small to
+ * hold the MQTT packet;
+ * #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTSendFailed if transport write failed;
+ * #MQTTStatusNotConnected if the connection is not established yet
+ * #MQTTStatusDisconnectPending if the user is expected to call MQTT_Disconnect
+ * before calling any other API
+ * #MQTTSuccess otherwise.
+ */
+/* @[declare_mqtt_subscribewithid] */
+MQTTStatus_t MQTT_SubscribeWithId( MQTTContext_t * pContext,
+                                   const MQTTSubscribeInfo_t * pSubscriptionList,
+                                   size_t subscriptionCount,
+                                   uint16_t packetId,
+                                   uint32_t subscriptionId );
+/* @[declare_mqtt_subscribewithid] */
+
+/**
+ * @brief Sends SUBSCRIBE packets for a long list of topic filters, such as
+ * the subscriptions to restore after a clean session, without being limited
+ * by #MQTT_SUB_UNSUB_MAX_VECTORS.
+ *
+ * The topic filters are copied into the staging buffer, which is filled with
+ * as many of them as fit before the packet is sent with a single transport
+ * write. The list is split across as many SUBSCRIBE packets as needed, each
+ * with a packet ID from #MQTT_GetPacketId. The packets are sent back to back;
+ * their SUBACKs are received by #MQTT_ProcessLoop or #MQTT_ReceiveLoop.
+ *
+ * Nothing is sent if a topic filter does not fit in the staging buffer, or if
+ * more packets are needed than @p pPacketIds can hold.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] pSubscriptionList Array of MQTT subscription info.
+ * @param[in] subscriptionCount The number of elements in @p pSubscriptionList.
+ * @param[in] pStagingBuffer Buffer the packets are serialized into. A larger
+ * buffer means fewer packets and transport writes.
+ * @param[out] pPacketIds The packet IDs of the SUBSCRIBE packets, in the
+ * order of the topic filters.
+ * @param[in,out] pPacketIdCount The capacity of @p pPacketIds on input, the
+ * number of packets sent on output.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTNoMemory if a topic filter does not fit in the staging buffer or
+ * @p pPacketIds is too small;
+ * #MQTTSendFailed if transport write failed;
+ * #MQTTStatusNotConnected if the connection is not established yet
+ * #MQTTStatusDisconnectPending if the user is expected to call MQTT_Disconnect
+ * before calling any other API
+ * #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * // 5000 topic filters to subscribe to.
+ * MQTTSubscribeInfo_t subscriptionList[ 5000 ];
+ * static uint8_t staging[ 4096 ];
+ * MQTTFixedBuffer_t stagingBuffer = { staging, sizeof( staging ) };
+ * uint16_t packetIds[ 64 ];
+ * size_t packetCount = 64;
+ *
+ * status = MQTT_SubscribeBulk( pContext, subscriptionList, 5000,
+ *                              &stagingBuffer, packetIds, &packetCount );
+ *
+ * if( status == MQTTSuccess )
+ * {
+ *      // packetCount SUBACKs, one for each of packetIds, are to be received
+ *      // with MQTT_ProcessLoop.
+ * }
+ * @endcode
+ */
+/* @[declare_mqtt_subscribebulk] */
+MQTTStatus_t MQTT_SubscribeBulk( MQTTContext_t * pContext,
+                                 const MQTTSubscribeInfo_t * pSubscriptionList,
+                                 size_t subscriptionCount,
+                                 const MQTTFixedBuffer_t * pStagingBuffer,
+                                 uint16_t * pPacketIds,
+                                 size_t * pPacketIdCount );
+/* @[declare_mqtt_subscribebulk] */
+
+/**
+ * @brief Sends MQTT SUBSCRIBE for the given list of topic filters, and invokes
+ * a completion callback with the SUBACK.
+ *
+ * This function behaves like #MQTT_Subscribe, and holds a completion token of
+ * the table given to #MQTT_InitCompletionTokens until the SUBACK is received.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] pSubscriptionList Array of MQTT subscription info.
+ * @param[in] subscriptionCount The number of elements in @p pSubscriptionList.
+ * @param[in] packetId Packet ID generated by #MQTT_GetPacketId.
+ * @param[in] callback Callback invoked with the SUBACK.
+ * @param[in] pUserData User data given to @p callback.
+ *
+ * @return The values returned by #MQTT_Subscribe, and #MQTTBadParameter if
+ * the context has no completion token table or @p callback is NULL;
+ * #MQTTNoMemory if no completion token is free;
+ * #MQTTStateCollision if an operation with the same packet ID is awaiting the
+ * same acknowledgement.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * // Called with the SUBACK.
+ * void onSubscribed( MQTTContext_t * pContext,
+ *                    uint16_t packetId,
+ *                    MQTTStatus_t status,
+ *                    MQTTPacketInfo_t * pAckPacket,
+ *                    void * pUserData )
+ * {
+ *      SubscribeRequest_t * pRequest = ( SubscribeRequest_t * ) pUserData;
+ *
+ *      pRequest->done = true;
+ *      pRequest->status = status;
+ * }
+ *
+ * status = MQTT_SubscribeWithCompletion( &mqttContext,
+ *                                        subscriptionList,
+ *                                        NUMBER_OF_SUBSCRIPTIONS,
+ *                                        MQTT_GetPacketId( &mqttContext ),
+ *                                        onSubscribed,
+ *                                        &subscribeRequest );
+ * @endcode
+ */
+/* @[declare_mqtt_subscribewithcompletion] */
+MQTTStatus_t MQTT_SubscribeWithCompletion( MQTTContext_t * pContext,
+                                           const MQTTSubscribeInfo_t * pSubscriptionList,
+                                           size_t subscriptionCount,
+                                           uint16_t packetId,
+                                           MQTTCompletionCallback_t callback,
+                                           void * pUserData );
+/* @[declare_mqtt_subscribewithcompletion] */
+
 /**
  * @brief Publishes a message to the given topic name.
  *
@@ -827,26 +1936,86 @@ MQTTStatus_t MQTT_Publish( MQTTContext_t * pContext,
 /* @[declare_mqtt_publish] */
 
 /**
- * @brief Cancels an outgoing publish callback (only for QoS > QoS0) by
- * removing it from the pending ACK list.
+ * @brief Publishes a message to the given topic name, and invokes a
+ * completion callback when the publish is complete.
  *
- * @note This cannot cancel the actual publish as that might have already
- * been sent to the broker. This only removes the details of the given packet
- * ID from the list of unACKed packet. That allows the caller to free any memory
- * associated with the publish payload, topic string etc. Also, after this API
- * call, the user provided callback will not be invoked when the ACK packet is
- * received.
+ * This function behaves like #MQTT_Publish. The callback of a QoS1 publish is
+ * invoked with its PUBACK, and that of a QoS2 publish with its PUBCOMP, while
+ * a completion token of the table given to #MQTT_InitCompletionTokens is held.
+ * A QoS0 publish needs no token, and its callback is invoked once it is sent,
+ * before this function returns.
  *
  * @param[in] pContext Initialized MQTT context.
- * @param[in] packetId packet ID corresponding to the outstanding publish.
+ * @param[in] pPublishInfo MQTT PUBLISH packet parameters.
+ * @param[in] packetId packet ID generated by #MQTT_GetPacketId.
+ * @param[in] callback Callback invoked when the publish is complete.
+ * @param[in] pUserData User data given to @p callback.
  *
- * @return #MQTTBadParameter if invalid parameters are passed;
- * #MQTTSuccess otherwise.
+ * @return The values returned by #MQTT_Publish, and #MQTTBadParameter if
+ * @p callback is NULL, or the context has no completion token table for a
+ * QoS1 or QoS2 publish; #MQTTNoMemory if no completion token is free;
+ * #MQTTStateCollision if an operation with the same packet ID is awaiting the
+ * same acknowledgement. The callback is not invoked when an error is
+ * returned.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * // Called with the PUBACK of the publish.
+ * void onPublished( MQTTContext_t * pContext,
+ *                   uint16_t packetId,
+ *                   MQTTStatus_t status,
+ *                   MQTTPacketInfo_t * pAckPacket,
+ *                   void * pUserData )
+ * {
+ *      Reading_t * pReading = ( Reading_t * ) pUserData;
+ *
+ *      if( status == MQTTSuccess )
+ *      {
+ *          releaseReading( pReading );
+ *      }
+ * }
+ *
+ * publishInfo.qos = MQTTQoS1;
+ * status = MQTT_PublishWithCompletion( &mqttContext,
+ *                                      &publishInfo,
+ *                                      MQTT_GetPacketId( &mqttContext ),
+ *                                      onPublished,
+ *                                      pReading );
+ * @endcode
  */
-/* @[declare_mqtt_cancelcallback] */
-MQTTStatus_t MQTT_CancelCallback( const MQTTContext_t * pContext,
-                                  uint16_t packetId );
-/* @[declare_mqtt_cancelcallback] */
+/* @[declare_mqtt_publishwithcompletion] */
+MQTTStatus_t MQTT_PublishWithCompletion( MQTTContext_t * pContext,
+                                         const MQTTPublishInfo_t * pPublishInfo,
+                                         uint16_t packetId,
+                                         MQTTCompletionCallback_t callback,
+                                         void * pUserData );
+/* @[declare_mqtt_publishwithcompletion] */
+
+#if ( MQTT_QOS0_ONLY == 0 )
+
+    /**
+     * @brief Cancels an outgoing publish callback (only for QoS > QoS0) by
+     * removing it from the pending ACK list.
+     *
+     * @note This cannot cancel the actual publish as that might have already
+     * been sent to the broker. This only removes the details of the given packet
+     * ID from the list of unACKed packet. That allows the caller to free any memory
+     * associated with the publish payload, topic string etc. Also, after this API
+     * call, the user provided callback will not be invoked when the ACK packet is
+     * received.
+     *
+     * @param[in] pContext Initialized MQTT context.
+     * @param[in] packetId packet ID corresponding to the outstanding publish.
+     *
+     * @return #MQTTBadParameter if invalid parameters are passed;
+     * #MQTTSuccess otherwise.
+     */
+    /* @[declare_mqtt_cancelcallback] */
+    MQTTStatus_t MQTT_CancelCallback( const MQTTContext_t * pContext,
+                                      uint16_t packetId );
+    /* @[declare_mqtt_cancelcallback] */
+#endif /* if ( MQTT_QOS0_ONLY == 0 ) */
 
 /**
  * @brief Sends an MQTT PINGREQ to broker.
@@ -923,6 +2092,40 @@ MQTTStatus_t MQTT_Unsubscribe( MQTTContext_t * pContext,
                                uint16_t packetId );
 /* @[declare_mqtt_unsubscribe] */
 
+/**
+ * @brief Sends UNSUBSCRIBE packets for a long list of topic filters without
+ * being limited by #MQTT_SUB_UNSUB_MAX_VECTORS.
+ *
+ * The topic filters are packed into UNSUBSCRIBE packets as described in
+ * #MQTT_SubscribeBulk.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] pSubscriptionList Array of MQTT subscription info.
+ * @param[in] subscriptionCount The number of elements in @p pSubscriptionList.
+ * @param[in] pStagingBuffer Buffer the packets are serialized into.
+ * @param[out] pPacketIds The packet IDs of the UNSUBSCRIBE packets, in the
+ * order of the topic filters.
+ * @param[in,out] pPacketIdCount The capacity of @p pPacketIds on input, the
+ * number of packets sent on output.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTNoMemory if a topic filter does not fit in the staging buffer or
+ * @p pPacketIds is too small;
+ * #MQTTSendFailed if transport write failed;
+ * #MQTTStatusNotConnected if the connection is not established yet
+ * #MQTTStatusDisconnectPending if the user is expected to call MQTT_Disconnect
+ * before calling any other API
+ * #MQTTSuccess otherwise.
+ */
+/* @[declare_mqtt_unsubscribebulk] */
+MQTTStatus_t MQTT_UnsubscribeBulk( MQTTContext_t * pContext,
+                                   const MQTTSubscribeInfo_t * pSubscriptionList,
+                                   size_t subscriptionCount,
+                                   const MQTTFixedBuffer_t * pStagingBuffer,
+                                   uint16_t * pPacketIds,
+                                   size_t * pPacketIdCount );
+/* @[declare_mqtt_unsubscribebulk] */
+
 /**
  * @brief Disconnect an MQTT session.
  *
@@ -968,7 +2171,9 @@ MQTTStatus_t MQTT_Disconnect( MQTTContext_t * pContext );
  * #MQTTNeedMoreBytes if MQTT_ProcessLoop has received
  * incomplete data; it should be called again (probably after a delay);
  * #MQTTStatusNotConnected if the connection is not established yet and a PING
- * or an ACK is being sent.
+ * or an ACK is being sent, or an MQTT 5 server sent a DISCONNECT, which was
+ * given to the #MQTTEventCallback_t and after which the network connection is
+ * closed without calling #MQTT_Disconnect.
  * #MQTTStatusDisconnectPending if the user is expected to call MQTT_Disconnect
  * before calling any other API
  * #MQTTSuccess on success.
@@ -1027,6 +2232,9 @@ MQTTStatus_t MQTT_ProcessLoop( MQTTContext_t * pContext );
  * invalid transition for the internal state machine;
  * #MQTTNeedMoreBytes if MQTT_ReceiveLoop has received
  * incomplete data; it should be called again (probably after a delay);
+ * #MQTTStatusNotConnected if an MQTT 5 server sent a DISCONNECT, which was
+ * given to the #MQTTEventCallback_t and after which the network connection is
+ * closed without calling #MQTT_Disconnect;
  * #MQTTSuccess on success.
  *
  * <b>Example</b>
@@ -1126,6 +2334,63 @@ MQTTStatus_t MQTT_MatchTopic( const char * pTopicName,
                               const uint16_t topicFilterLength,
                               bool * pIsMatch );
 
+/**
+ * @brief Validate a topic name or topic filter against the MQTT 3.1.1
+ * specification, optionally recording the offsets of its level separators.
+ *
+ * A single pass checks that the topic:
+ * - is well-formed UTF-8, with no encodings of the surrogate code points
+ * U+D800 to U+DFFF;
+ * - does not contain the NUL character U+0000;
+ * - does not contain wildcard characters, if it is a topic name; or
+ * - only has wildcards which occupy an entire level, and a multi-level wildcard
+ * only as its last character, if it is a topic filter.
+ *
+ * #MQTT_Publish, #MQTT_Subscribe and #MQTT_Unsubscribe call this function for
+ * their topics, so it is not required to call it before them.
+ *
+ * @param[in] pTopic The topic name or topic filter to validate.
+ * @param[in] topicLength Length of the topic.
+ * @param[in] isTopicFilter Whether @p pTopic is a topic filter which may
+ * contain wildcards.
+ * @param[out] pLevelOffsets Optional array to store the offset of each '/'
+ * level separator in. May be NULL.
+ * @param[in,out] pLevelCount Optional. On input, the number of entries in
+ * @p pLevelOffsets; it must be non-NULL if @p pLevelOffsets is non-NULL. On
+ * successful output, the number of level separators in the topic. The topic has
+ * one more level than it has separators.
+ *
+ * @return Returns one of the following:
+ * - #MQTTBadParameter, if any of the input parameters is invalid or the topic
+ * is not valid.
+ * - #MQTTNoMemory, if the topic is valid but @p pLevelOffsets is too small to
+ * store all level separator offsets. @p pLevelCount is still updated.
+ * - #MQTTSuccess, if the topic is valid.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * // Variables used in this example.
+ * const char * pFilter = "sensors/+/temperature";
+ * uint16_t levelOffsets[ 4 ];
+ * size_t levelCount = 4;
+ * MQTTStatus_t status;
+ *
+ * status = MQTT_ValidateTopic( pFilter, strlen( pFilter ), true, levelOffsets, &levelCount );
+ *
+ * // The filter is valid and has 2 level separators, at offsets 7 and 9.
+ * assert( status == MQTTSuccess );
+ * assert( levelCount == 2 );
+ * @endcode
+ */
+/* @[declare_mqtt_validatetopic] */
+MQTTStatus_t MQTT_ValidateTopic( const char * pTopic,
+                                 uint16_t topicLength,
+                                 bool isTopicFilter,
+                                 uint16_t * pLevelOffsets,
+                                 size_t * pLevelCount );
+/* @[declare_mqtt_validatetopic] */
+
 /**
  * @brief Parses the payload of an MQTT SUBACK packet that contains status codes
  * corresponding to topic filter subscription requests from the original
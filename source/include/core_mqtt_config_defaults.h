@@ -195,6 +195,117 @@
     #error MQTT_SEND_RETRY_TIMEOUT_MS is deprecated. Instead use MQTT_SEND_TIMEOUT_MS.
 #endif
 
+/**
+ * @brief Whether state record slabs shared by many MQTT contexts are managed
+ * with lock-free atomic operations.
+ *
+ * When enabled, chunks of a #MQTTRecordSlab_t are claimed and released with
+ * atomic compare-and-swap on the free chunk bitmap, so contexts using the same
+ * slab can run on different threads without a lock. This requires the
+ * `__atomic` builtins of GCC and Clang. When disabled, updates to the bitmap are
+ * bracketed by the MQTT_PRE_RECORD_SLAB_HOOK and MQTT_POST_RECORD_SLAB_HOOK
+ * macros, which must take a lock if the slab is shared across threads.
+ *
+ * <b>Possible values:</b> `0` or `1` <br>
+ * <b>Default value:</b> `1` if the `__atomic` builtins are available,
+ * otherwise `0`.
+ */
+#ifndef MQTT_RECORD_SLAB_USE_ATOMICS
+    #if defined( __GNUC__ ) && defined( __ATOMIC_ACQ_REL )
+        #define MQTT_RECORD_SLAB_USE_ATOMICS    ( 1 )
+    #else
+        #define MQTT_RECORD_SLAB_USE_ATOMICS    ( 0 )
+    #endif
+#endif
+
+/**
+ * @brief Whether producers submit to a publish queue with lock-free atomic
+ * operations.
+ *
+ * When enabled, #MQTTPublishQueue_Enqueue links a request into the queue with
+ * an atomic compare-and-swap, and the owner thread takes all submitted
+ * requests with one atomic exchange. This requires the `__atomic` builtins of
+ * GCC and Clang. When disabled, updates to the list of submitted requests are
+ * bracketed by the MQTT_PRE_PUBLISH_QUEUE_HOOK and
+ * MQTT_POST_PUBLISH_QUEUE_HOOK macros, which must take a lock.
+ *
+ * <b>Possible values:</b> `0` or `1` <br>
+ * <b>Default value:</b> `1` if the `__atomic` builtins are available,
+ * otherwise `0`.
+ */
+#ifndef MQTT_PUBLISH_QUEUE_USE_ATOMICS
+    #if defined( __GNUC__ ) && defined( __ATOMIC_ACQ_REL )
+        #define MQTT_PUBLISH_QUEUE_USE_ATOMICS    ( 1 )
+    #else
+        #define MQTT_PUBLISH_QUEUE_USE_ATOMICS    ( 0 )
+    #endif
+#endif
+
+/**
+ * @brief The longest topic name for which an MQTT 5 topic alias is assigned.
+ *
+ * Every #MQTTTopicAliasRecord_t given to #MQTT_InitTopicAliases keeps a copy of
+ * the topic name of its alias, so this macro sets the size of the records.
+ * Publishes to longer topics are sent with their topic name and no alias.
+ *
+ * <b>Possible values:</b> Any positive 16 bit integer. <br>
+ * <b>Default value:</b> `128`
+ */
+#ifndef MQTT_TOPIC_ALIAS_MAX_TOPIC_LENGTH
+    #define MQTT_TOPIC_ALIAS_MAX_TOPIC_LENGTH    ( 128U )
+#endif
+
+/**
+ * @brief The largest number of MQTT 5 Subscription Identifiers read from an
+ * incoming publish.
+ *
+ * A publish matching several subscriptions of the client carries the
+ * Subscription Identifier of each of them. The identifiers are kept on the
+ * stack while the publish is dispatched; those beyond this count are dropped.
+ *
+ * <b>Possible values:</b> Any positive integer. <br>
+ * <b>Default value:</b> `4`
+ */
+#ifndef MQTT_MAX_SUBSCRIPTION_IDS
+    #define MQTT_MAX_SUBSCRIPTION_IDS    ( 4U )
+#endif
+
+/**
+ * @brief The longest topic filter kept by the subscription registry of
+ * #MQTT_InitSubscriptionRegistry.
+ *
+ * Every #MQTTSubscriptionRecord_t keeps a copy of its topic filter, so this
+ * macro sets the size of the records. Longer topic filters are subscribed to
+ * as usual, but are not subscribed to again after a clean session.
+ *
+ * <b>Possible values:</b> Any positive 16 bit integer. <br>
+ * <b>Default value:</b> `128`
+ */
+#ifndef MQTT_SUBSCRIPTION_REGISTRY_MAX_FILTER_LENGTH
+    #define MQTT_SUBSCRIPTION_REGISTRY_MAX_FILTER_LENGTH    ( 128U )
+#endif
+
+/**
+ * @brief Build the MQTT library for QoS0 publishes and subscriptions only.
+ *
+ * When enabled, the state engine of core_mqtt_state.c is compiled out, together
+ * with the publish records, record slab and retransmit callbacks of
+ * #MQTTContext_t and the API functions that configure them. #MQTT_Publish and
+ * #MQTT_Subscribe reject QoS1 and QoS2, and a QoS1 or QoS2 PUBLISH or a publish
+ * acknowledgement received from the broker fails the receive loop with
+ * #MQTTBadResponse.
+ *
+ * The library and every application that includes core_mqtt.h MUST be built
+ * with the same value of this macro, as it changes the layout of
+ * #MQTTContext_t.
+ *
+ * <b>Possible values:</b> `0` or `1` <br>
+ * <b>Default value:</b> `0`
+ */
+#ifndef MQTT_QOS0_ONLY
+    #define MQTT_QOS0_ONLY    ( 0 )
+#endif
+
 /**
  * @brief Macro that is called in the MQTT library for logging "Error" level
  * messages.
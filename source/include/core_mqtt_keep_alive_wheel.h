@@ -0,0 +1,239 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file core_mqtt_keep_alive_wheel.h
+ * @brief A hierarchical timing wheel sending the keep-alive PINGREQs of many
+ * MQTT contexts.
+ *
+ * #MQTT_ProcessLoop checks the keep-alive of a context each time it is called,
+ * so an application serving many mostly idle connections otherwise calls it on
+ * every connection at each polling interval only to find that nothing is due.
+ * With a keep-alive wheel, #MQTT_ProcessLoop is only called on connections
+ * with received data, and the wheel holds the next keep-alive deadline of
+ * every context: the PINGREQ deadline derived from the last packet sent and
+ * received, or the PINGRESP deadline while a response is awaited. Scheduling
+ * a deadline and advancing the wheel by one tick take constant time, and a
+ * context is only examined when its deadline is reached. A context which
+ * sent or received packets since its deadline was scheduled is then simply
+ * scheduled again from its new timestamps; otherwise the wheel calls
+ * #MQTT_Ping, or reports a missing PINGRESP.
+ *
+ * The wheel is not thread safe. It must be processed by the thread which
+ * calls #MQTT_ProcessLoop on its contexts.
+ */
+#ifndef CORE_MQTT_KEEP_ALIVE_WHEEL_H
+#define CORE_MQTT_KEEP_ALIVE_WHEEL_H
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    extern "C" {
+#endif
+/* *INDENT-ON* */
+
+#include "core_mqtt.h"
+
+/**
+ * @brief Duration of one tick of the wheel in milliseconds. Deadlines are
+ * rounded up to the next tick.
+ */
+#ifndef MQTT_KEEP_ALIVE_WHEEL_TICK_MS
+    #define MQTT_KEEP_ALIVE_WHEEL_TICK_MS    ( 100U )
+#endif
+
+/**
+ * @brief Number of levels of the wheel.
+ */
+#define MQTT_KEEP_ALIVE_WHEEL_LEVELS       ( 4U )
+
+/**
+ * @brief Base 2 logarithm of the number of slots of each level.
+ */
+#define MQTT_KEEP_ALIVE_WHEEL_SLOT_BITS    ( 6U )
+
+/**
+ * @brief Number of slots of each level. A slot of a level spans all the slots
+ * of the level below, so the wheel holds deadlines up to 2^24 ticks away.
+ */
+#define MQTT_KEEP_ALIVE_WHEEL_SLOTS        ( 1UL << MQTT_KEEP_ALIVE_WHEEL_SLOT_BITS )
+
+/**
+ * @brief Value of #MQTTKeepAliveWheel_GetNextTimeout when no deadline is
+ * scheduled.
+ */
+#define MQTT_KEEP_ALIVE_WHEEL_NO_TIMEOUT    ( UINT32_MAX )
+
+/**
+ * @cond DOXYGEN_IGNORE
+ * Forward declarations for the callback type.
+ */
+struct MQTTKeepAliveWheel;
+struct MQTTKeepAliveEntry;
+/** @endcond */
+
+/**
+ * @ingroup mqtt_callback_types
+ * @brief Application callback invoked by #MQTTKeepAliveWheel_Process when the
+ * keep-alive of a context fails.
+ *
+ * The entry is no longer scheduled. The application usually disconnects the
+ * context, and removes the entry or adds it again after reconnecting.
+ *
+ * @param[in] pWheel The keep-alive wheel.
+ * @param[in] pEntry The entry of the context.
+ * @param[in] status #MQTTKeepAliveTimeout if no PINGRESP was received in time,
+ * or the status returned by #MQTT_Ping.
+ */
+/* @[define_mqtt_keepaliveerrorcallback] */
+typedef void (* MQTTKeepAliveErrorCallback_t )( struct MQTTKeepAliveWheel * pWheel,
+                                                struct MQTTKeepAliveEntry * pEntry,
+                                                MQTTStatus_t status );
+/* @[define_mqtt_keepaliveerrorcallback] */
+
+/**
+ * @ingroup mqtt_struct_types
+ * @brief A context tracked by a keep-alive wheel.
+ *
+ * The application sets #MQTTKeepAliveEntry_t.pContext before
+ * #MQTTKeepAliveWheel_Add; the other members are private.
+ */
+typedef struct MQTTKeepAliveEntry
+{
+    MQTTContext_t * pContext;             /**< @brief Connected MQTT context. */
+    void * pAppContext;                   /**< @brief Application data; not used by the wheel. */
+    struct MQTTKeepAliveEntry * pNext;    /**< @brief Next entry in the slot. */
+    struct MQTTKeepAliveEntry ** ppPrev;  /**< @brief Link pointing to this entry, or NULL if not scheduled. */
+    uint32_t expiryTick;                  /**< @brief Tick at which the entry is examined. */
+} MQTTKeepAliveEntry_t;
+
+/**
+ * @ingroup mqtt_struct_types
+ * @brief A hierarchical timing wheel of keep-alive deadlines.
+ *
+ * @note The members of this struct are private, except for
+ * #MQTTKeepAliveWheel_t.examinedCount and #MQTTKeepAliveWheel_t.pingCount
+ * which may be read as statistics.
+ */
+typedef struct MQTTKeepAliveWheel
+{
+    MQTTGetCurrentTimeFunc_t getTime;           /**< @brief Time source, the same as of the contexts. */
+    MQTTKeepAliveErrorCallback_t errorCallback; /**< @brief Callback for failed keep-alives. */
+    uint32_t tickStartMs;                       /**< @brief Time at which #MQTTKeepAliveWheel_t.currentTick began. */
+    uint32_t currentTick;                       /**< @brief The tick of the current time. */
+    uint32_t nextTick;                          /**< @brief The next tick to process. */
+    size_t entryCount;                          /**< @brief Number of scheduled entries. */
+    uint64_t examinedCount;                     /**< @brief Entries examined when their deadline was reached. */
+    uint64_t pingCount;                         /**< @brief PINGREQs sent by the wheel. */
+    MQTTKeepAliveEntry_t * slots[ MQTT_KEEP_ALIVE_WHEEL_LEVELS ][ MQTT_KEEP_ALIVE_WHEEL_SLOTS ]; /**< @brief Entries of each slot. */
+} MQTTKeepAliveWheel_t;
+
+/**
+ * @brief Initialize a keep-alive wheel.
+ *
+ * @param[in] pWheel The wheel to initialize.
+ * @param[in] getTimeFunction Time source in milliseconds. It must be the time
+ * source of the contexts added to the wheel.
+ * @param[in] errorCallback Callback for failed keep-alives.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTSuccess otherwise.
+ */
+/* @[declare_mqttkeepalivewheel_init] */
+MQTTStatus_t MQTTKeepAliveWheel_Init( MQTTKeepAliveWheel_t * pWheel,
+                                      MQTTGetCurrentTimeFunc_t getTimeFunction,
+                                      MQTTKeepAliveErrorCallback_t errorCallback );
+/* @[declare_mqttkeepalivewheel_init] */
+
+/**
+ * @brief Schedule the next keep-alive deadline of a connected context.
+ *
+ * Adding an entry which is already scheduled schedules it again, for example
+ * after the context reconnected.
+ *
+ * @param[in] pWheel Initialized wheel.
+ * @param[in] pEntry The entry, with its context set. It must remain valid
+ * until it is removed or reported to the error callback.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTSuccess otherwise.
+ */
+/* @[declare_mqttkeepalivewheel_add] */
+MQTTStatus_t MQTTKeepAliveWheel_Add( MQTTKeepAliveWheel_t * pWheel,
+                                     MQTTKeepAliveEntry_t * pEntry );
+/* @[declare_mqttkeepalivewheel_add] */
+
+/**
+ * @brief Remove an entry from the wheel. Removing an entry which is not
+ * scheduled has no effect.
+ *
+ * @param[in] pWheel Initialized wheel.
+ * @param[in] pEntry The entry to remove.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTSuccess otherwise.
+ */
+/* @[declare_mqttkeepalivewheel_remove] */
+MQTTStatus_t MQTTKeepAliveWheel_Remove( MQTTKeepAliveWheel_t * pWheel,
+                                        MQTTKeepAliveEntry_t * pEntry );
+/* @[declare_mqttkeepalivewheel_remove] */
+
+/**
+ * @brief Advance the wheel to the current time, and handle the entries whose
+ * deadline was reached: send a PINGREQ with #MQTT_Ping on contexts which were
+ * idle for their keep-alive interval, report the contexts whose PINGRESP did
+ * not arrive in time, and schedule the others again.
+ *
+ * @param[in] pWheel Initialized wheel.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTSuccess otherwise, whatever the results of the keep-alives.
+ */
+/* @[declare_mqttkeepalivewheel_process] */
+MQTTStatus_t MQTTKeepAliveWheel_Process( MQTTKeepAliveWheel_t * pWheel );
+/* @[declare_mqttkeepalivewheel_process] */
+
+/**
+ * @brief Get the time until #MQTTKeepAliveWheel_Process has entries to
+ * handle, for example as the timeout of a wait for received data.
+ *
+ * The time may be shorter than the nearest deadline when it is in a higher
+ * level of the wheel.
+ *
+ * @param[in] pWheel Initialized wheel.
+ *
+ * @return Milliseconds until the next deadline, 0 if one is due, or
+ * #MQTT_KEEP_ALIVE_WHEEL_NO_TIMEOUT if no entry is scheduled or @p pWheel is
+ * NULL.
+ */
+/* @[declare_mqttkeepalivewheel_getnexttimeout] */
+uint32_t MQTTKeepAliveWheel_GetNextTimeout( const MQTTKeepAliveWheel_t * pWheel );
+/* @[declare_mqttkeepalivewheel_getnexttimeout] */
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    }
+#endif
+/* *INDENT-ON* */
+
+#endif /* ifndef CORE_MQTT_KEEP_ALIVE_WHEEL_H */
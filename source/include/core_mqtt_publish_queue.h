@@ -0,0 +1,222 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file core_mqtt_publish_queue.h
+ * @brief A multi-producer, single-consumer queue of publishes in front of
+ * #MQTT_Publish.
+ *
+ * Threads publishing on one connection otherwise each call #MQTT_Publish,
+ * which holds the send hook of the context while the packet is written, so
+ * they serialize on the socket. With a publish queue, producers only link
+ * a request into the queue without taking a lock. One owner thread, usually
+ * the thread calling #MQTT_ProcessLoop, drains the queue in batches with
+ * #MQTTPublishQueue_Drain; it alone publishes on the context, and reports the
+ * result of each request to a completion callback.
+ */
+#ifndef CORE_MQTT_PUBLISH_QUEUE_H
+#define CORE_MQTT_PUBLISH_QUEUE_H
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    extern "C" {
+#endif
+/* *INDENT-ON* */
+
+#include "core_mqtt.h"
+
+/**
+ * @cond DOXYGEN_IGNORE
+ * Forward declarations for the callback type.
+ */
+struct MQTTPublishQueue;
+struct MQTTPublishRequest;
+/** @endcond */
+
+/**
+ * @ingroup mqtt_callback_types
+ * @brief Application callback invoked by the owner thread when a queued
+ * publish has been sent or has failed.
+ *
+ * The request is no longer used by the queue when the callback is invoked, so
+ * the callback may release or enqueue it again.
+ *
+ * @param[in] pQueue The publish queue.
+ * @param[in] pRequest The completed request. Its packet identifier is set if
+ * one was assigned by the queue.
+ * @param[in] status The status returned by #MQTT_Publish.
+ */
+/* @[define_mqtt_publishcompletecallback] */
+typedef void (* MQTTPublishCompleteCallback_t )( struct MQTTPublishQueue * pQueue,
+                                                 struct MQTTPublishRequest * pRequest,
+                                                 MQTTStatus_t status );
+/* @[define_mqtt_publishcompletecallback] */
+
+/**
+ * @ingroup mqtt_struct_types
+ * @brief A publish submitted to a publish queue.
+ *
+ * The request, and the topic and payload it points to, are owned by the queue
+ * from #MQTTPublishQueue_Enqueue until the completion callback.
+ */
+typedef struct MQTTPublishRequest
+{
+    /**
+     * @brief The publish to send.
+     */
+    MQTTPublishInfo_t publishInfo;
+
+    /**
+     * @brief Packet identifier of a QoS1 or QoS2 publish. If 0, the owner
+     * thread assigns one with #MQTT_GetPacketId before the publish is sent.
+     */
+    uint16_t packetId;
+
+    /**
+     * @brief Application data; not used by the queue.
+     */
+    void * pAppContext;
+
+    /**
+     * @brief Next request in the queue. Private.
+     */
+    struct MQTTPublishRequest * pNext;
+} MQTTPublishRequest_t;
+
+/**
+ * @ingroup mqtt_struct_types
+ * @brief A publish queue draining into one MQTT context.
+ *
+ * @note The members of this struct are private.
+ */
+typedef struct MQTTPublishQueue
+{
+    /**
+     * @brief The context the queued publishes are sent on.
+     */
+    MQTTContext_t * pContext;
+
+    /**
+     * @brief Callback receiving the result of each request.
+     */
+    MQTTPublishCompleteCallback_t completeCallback;
+
+    /**
+     * @brief Requests submitted by producers, newest first. Producers push
+     * onto it, and the owner thread takes the whole list at once.
+     */
+    MQTTPublishRequest_t * pSubmitted;
+
+    /**
+     * @brief Requests taken by the owner thread but not yet sent, oldest
+     * first.
+     */
+    MQTTPublishRequest_t * pPendingHead;
+
+    /**
+     * @brief Last request of #MQTTPublishQueue_t.pPendingHead.
+     */
+    MQTTPublishRequest_t * pPendingTail;
+} MQTTPublishQueue_t;
+
+/**
+ * @brief Initialize a publish queue for a context.
+ *
+ * @param[in] pQueue The queue to initialize.
+ * @param[in] pContext Initialized MQTT context the publishes are sent on.
+ * @param[in] completeCallback Callback receiving the result of each request.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTSuccess otherwise.
+ */
+/* @[declare_mqttpublishqueue_init] */
+MQTTStatus_t MQTTPublishQueue_Init( MQTTPublishQueue_t * pQueue,
+                                    MQTTContext_t * pContext,
+                                    MQTTPublishCompleteCallback_t completeCallback );
+/* @[declare_mqttpublishqueue_init] */
+
+/**
+ * @brief Submit a publish to the queue. It may be called from any thread, and
+ * never blocks.
+ *
+ * Requests of one producer are sent in the order they were enqueued.
+ * The publish is only validated when it is sent; an invalid publish is
+ * reported to the completion callback.
+ *
+ * @param[in] pQueue Initialized publish queue.
+ * @param[in] pRequest The request. It must not be in a queue already.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTSuccess otherwise.
+ */
+/* @[declare_mqttpublishqueue_enqueue] */
+MQTTStatus_t MQTTPublishQueue_Enqueue( MQTTPublishQueue_t * pQueue,
+                                       MQTTPublishRequest_t * pRequest );
+/* @[declare_mqttpublishqueue_enqueue] */
+
+/**
+ * @brief Send queued publishes with #MQTT_Publish and report each result to
+ * the completion callback. It must only be called from the owner thread of
+ * the queue.
+ *
+ * A QoS1 or QoS2 request for which #MQTT_Publish finds no free state record
+ * stays at the front of the queue, and the drain stops; it is retried by the
+ * next drain, after #MQTT_ProcessLoop has received acknowledgements. After the
+ * context has been disconnected, draining completes the remaining requests
+ * with the status of #MQTT_Publish, such as #MQTTStatusNotConnected.
+ *
+ * @param[in] pQueue Initialized publish queue.
+ * @param[in] maxCount Largest number of requests to send; 0 sends every
+ * request queued when the call started.
+ * @param[out] pSentCount Number of requests completed. It may be NULL.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTSuccess otherwise, whatever the results of the requests.
+ */
+/* @[declare_mqttpublishqueue_drain] */
+MQTTStatus_t MQTTPublishQueue_Drain( MQTTPublishQueue_t * pQueue,
+                                     size_t maxCount,
+                                     size_t * pSentCount );
+/* @[declare_mqttpublishqueue_drain] */
+
+/**
+ * @brief Whether the queue holds requests. It must only be called from the
+ * owner thread of the queue, for example to decide whether to wait for
+ * network data or to drain.
+ *
+ * @param[in] pQueue Initialized publish queue.
+ *
+ * @return `true` if requests are waiting to be drained; `false` otherwise.
+ */
+/* @[declare_mqttpublishqueue_ispending] */
+bool MQTTPublishQueue_IsPending( const MQTTPublishQueue_t * pQueue );
+/* @[declare_mqttpublishqueue_ispending] */
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    }
+#endif
+/* *INDENT-ON* */
+
+#endif /* ifndef CORE_MQTT_PUBLISH_QUEUE_H */
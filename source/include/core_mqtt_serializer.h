@@ -63,7 +63,8 @@
 #define MQTT_PACKET_TYPE_UNSUBACK       ( ( uint8_t ) 0xB0U )  /**< @brief UNSUBACK (server-to-client). */
 #define MQTT_PACKET_TYPE_PINGREQ        ( ( uint8_t ) 0xC0U )  /**< @brief PINGREQ (client-to-server). */
 #define MQTT_PACKET_TYPE_PINGRESP       ( ( uint8_t ) 0xD0U )  /**< @brief PINGRESP (server-to-client). */
-#define MQTT_PACKET_TYPE_DISCONNECT     ( ( uint8_t ) 0xE0U )  /**< @brief DISCONNECT (client-to-server). */
+#define MQTT_PACKET_TYPE_DISCONNECT     ( ( uint8_t ) 0xE0U )  /**< @brief DISCONNECT (client-to-server, bidirectional in MQTT 5). */
+#define MQTT_PACKET_TYPE_AUTH           ( ( uint8_t ) 0xF0U )  /**< @brief AUTH (bidirectional, MQTT 5 only). */
 /** @} */
 
 /**
@@ -72,6 +73,58 @@
  */
 #define MQTT_PUBLISH_ACK_PACKET_SIZE    ( 4UL )
 
+/**
+ * @ingroup mqtt_constants
+ * @brief The size of MQTT CONNACK packets, per MQTT spec.
+ */
+#define MQTT_CONNACK_PACKET_SIZE        ( 4UL )
+
+/**
+ * @ingroup mqtt_constants
+ * @brief The size of MQTT UNSUBACK packets, per MQTT spec.
+ */
+#define MQTT_UNSUBACK_PACKET_SIZE       ( 4UL )
+
+/**
+ * @ingroup mqtt_constants
+ * @brief The size of MQTT PINGRESP packets, per MQTT spec.
+ */
+#define MQTT_PINGRESP_PACKET_SIZE       ( 2UL )
+
+/**
+ * @ingroup mqtt_constants
+ * @brief Protocol level of MQTT 3.1.1.
+ */
+#define MQTT_VERSION_3_1_1              ( ( uint8_t ) 4U )
+
+/**
+ * @ingroup mqtt_constants
+ * @brief Protocol level of MQTT 5.
+ */
+#define MQTT_VERSION_5                  ( ( uint8_t ) 5U )
+
+/**
+ * @ingroup mqtt_constants
+ * @brief Largest size of the properties of an MQTT 5 PUBLISH serialized by
+ * #MQTT_SerializePublishPropertiesV5: the property length and a topic alias.
+ */
+#define MQTT_PUBLISH_PROPERTIES_MAX_SIZE_V5    ( 4UL )
+
+/**
+ * @ingroup mqtt_constants
+ * @brief Largest Subscription Identifier allowed by MQTT 5, the largest value
+ * of a Variable Byte Integer.
+ */
+#define MQTT_SUBSCRIPTION_ID_MAX               ( 268435455UL )
+
+/**
+ * @ingroup mqtt_constants
+ * @brief Largest size of the part of an MQTT 5 SUBSCRIBE header serialized by
+ * #MQTT_SerializeSubscribeHeaderV5: the fixed header, the packet identifier,
+ * the property length and a Subscription Identifier.
+ */
+#define MQTT_SUBSCRIBE_HEADER_MAX_SIZE_V5      ( 13UL )
+
 /* Structures defined in this file. */
 struct MQTTFixedBuffer;
 struct MQTTConnectInfo;
@@ -270,6 +323,31 @@ typedef struct MQTTPacketInfo
     size_t headerLength;
 } MQTTPacketInfo_t;
 
+/**
+ * @ingroup mqtt_struct_types
+ * @brief Properties of an MQTT 5 CONNACK used by the library.
+ */
+typedef struct MQTTConnackProperties
+{
+    /**
+     * @brief Highest topic alias the server accepts in PUBLISH packets. 0 if
+     * the server does not accept topic aliases.
+     */
+    uint16_t topicAliasMaximum;
+
+    /**
+     * @brief Keep alive interval assigned by the server, valid if
+     * #MQTTConnackProperties_t.serverKeepAlivePresent is set.
+     */
+    uint16_t serverKeepAlive;
+
+    /**
+     * @brief Whether the server assigned a keep alive interval, which the
+     * client must use instead of its own.
+     */
+    bool serverKeepAlivePresent;
+} MQTTConnackProperties_t;
+
 /**
  * @brief Get the size and Remaining Length of an MQTT CONNECT packet.
  *
@@ -1237,6 +1315,410 @@ MQTTStatus_t MQTT_ProcessIncomingPacketTypeAndLength( const uint8_t * pBuffer,
 MQTTStatus_t MQTT_UpdateDuplicatePublishFlag( uint8_t * pHeader , bool set);
 /* @[declare_mqtt_updateduplicatepublishflag] */
 
+/**
+ * @brief Get the size and Remaining Length of an MQTT 5 CONNECT packet
+ * without properties, other than their empty property lengths.
+ *
+ * @param[in] pConnectInfo MQTT CONNECT packet parameters.
+ * @param[in] pWillInfo Last Will and Testament. Pass NULL if not used.
+ * @param[out] pRemainingLength The Remaining Length of the MQTT CONNECT packet.
+ * @param[out] pPacketSize The total size of the MQTT CONNECT packet.
+ *
+ * @return #MQTTBadParameter if the packet would exceed the size allowed by the
+ * MQTT spec; #MQTTSuccess otherwise.
+ */
+/* @[declare_mqtt_getconnectpacketsizev5] */
+MQTTStatus_t MQTT_GetConnectPacketSizeV5( const MQTTConnectInfo_t * pConnectInfo,
+                                          const MQTTPublishInfo_t * pWillInfo,
+                                          size_t * pRemainingLength,
+                                          size_t * pPacketSize );
+/* @[declare_mqtt_getconnectpacketsizev5] */
+
+/**
+ * @brief Get the size and Remaining Length of an MQTT 5 SUBSCRIBE packet
+ * whose only property is an optional Subscription Identifier.
+ *
+ * @param[in] pSubscriptionList List of MQTT subscription info.
+ * @param[in] subscriptionCount The number of elements in pSubscriptionList.
+ * @param[in] subscriptionId The Subscription Identifier to send, or 0 for
+ * none. At most #MQTT_SUBSCRIPTION_ID_MAX.
+ * @param[out] pRemainingLength The Remaining Length of the MQTT SUBSCRIBE packet.
+ * @param[out] pPacketSize The total size of the MQTT SUBSCRIBE packet.
+ *
+ * @return #MQTTBadParameter if the packet would exceed the size allowed by the
+ * MQTT spec; #MQTTSuccess otherwise.
+ */
+/* @[declare_mqtt_getsubscribepacketsizev5] */
+MQTTStatus_t MQTT_GetSubscribePacketSizeV5( const MQTTSubscribeInfo_t * pSubscriptionList,
+                                            size_t subscriptionCount,
+                                            uint32_t subscriptionId,
+                                            size_t * pRemainingLength,
+                                            size_t * pPacketSize );
+/* @[declare_mqtt_getsubscribepacketsizev5] */
+
+/**
+ * @brief Get the size and Remaining Length of an MQTT 5 UNSUBSCRIBE packet
+ * without properties.
+ *
+ * @param[in] pSubscriptionList List of MQTT subscription info.
+ * @param[in] subscriptionCount The number of elements in pSubscriptionList.
+ * @param[out] pRemainingLength The Remaining Length of the MQTT UNSUBSCRIBE packet.
+ * @param[out] pPacketSize The total size of the MQTT UNSUBSCRIBE packet.
+ *
+ * @return #MQTTBadParameter if the packet would exceed the size allowed by the
+ * MQTT spec; #MQTTSuccess otherwise.
+ */
+/* @[declare_mqtt_getunsubscribepacketsizev5] */
+MQTTStatus_t MQTT_GetUnsubscribePacketSizeV5( const MQTTSubscribeInfo_t * pSubscriptionList,
+                                              size_t subscriptionCount,
+                                              size_t * pRemainingLength,
+                                              size_t * pPacketSize );
+/* @[declare_mqtt_getunsubscribepacketsizev5] */
+
+/**
+ * @brief Get the size and Remaining Length of an MQTT 5 PUBLISH packet whose
+ * only property is an optional topic alias.
+ *
+ * The topic name may be empty if @p topicAlias is not 0, in which case the
+ * server uses the topic name it last received with the same alias.
+ *
+ * @param[in] pPublishInfo MQTT PUBLISH packet parameters.
+ * @param[in] topicAlias The topic alias to send, or 0 for none.
+ * @param[out] pRemainingLength The Remaining Length of the MQTT PUBLISH packet.
+ * @param[out] pPacketSize The total size of the MQTT PUBLISH packet.
+ *
+ * @return #MQTTBadParameter if the packet would exceed the size allowed by the
+ * MQTT spec or if invalid parameters are passed; #MQTTSuccess otherwise.
+ */
+/* @[declare_mqtt_getpublishpacketsizev5] */
+MQTTStatus_t MQTT_GetPublishPacketSizeV5( const MQTTPublishInfo_t * pPublishInfo,
+                                          uint16_t topicAlias,
+                                          size_t * pRemainingLength,
+                                          size_t * pPacketSize );
+/* @[declare_mqtt_getpublishpacketsizev5] */
+
+/**
+ * @brief Deserialize an incoming MQTT 5 PUBLISH packet.
+ *
+ * The properties of the PUBLISH are validated and skipped, except for the
+ * Subscription Identifiers, which are returned. A topic alias is rejected, as
+ * the library does not allow the server to send them.
+ *
+ * @param[in] pIncomingPacket #MQTTPacketInfo_t containing the buffer.
+ * @param[out] pPacketId The packet ID obtained from the buffer.
+ * @param[out] pPublishInfo Struct containing information about the publish.
+ * @param[out] pSubscriptionIds Array receiving the Subscription Identifiers
+ * of the subscriptions matched by the PUBLISH. May be NULL.
+ * @param[in,out] pSubscriptionIdCount The capacity of @p pSubscriptionIds on
+ * input, the number of identifiers written to it on output. Identifiers that
+ * do not fit are dropped. May be NULL if @p pSubscriptionIds is NULL.
+ *
+ * @return #MQTTBadParameter, #MQTTBadResponse, or #MQTTSuccess.
+ */
+/* @[declare_mqtt_deserializepublishv5] */
+MQTTStatus_t MQTT_DeserializePublishV5( const MQTTPacketInfo_t * pIncomingPacket,
+                                        uint16_t * pPacketId,
+                                        MQTTPublishInfo_t * pPublishInfo,
+                                        uint32_t * pSubscriptionIds,
+                                        size_t * pSubscriptionIdCount );
+/* @[declare_mqtt_deserializepublishv5] */
+
+/**
+ * @brief Deserialize an MQTT 5 CONNACK, SUBACK, UNSUBACK, PUBACK, PUBREC,
+ * PUBREL, PUBCOMP, PINGRESP, DISCONNECT or AUTH.
+ *
+ * A failure reason code in a CONNACK, SUBACK, UNSUBACK, PUBACK, PUBREC or
+ * PUBCOMP is reported as #MQTTServerRefused, after the packet identifier is
+ * written. A PUBREL is answered with a PUBCOMP whatever its reason code, so a
+ * failure in it is only logged. The reason code and properties of a
+ * DISCONNECT or AUTH are validated, and a failure reason code in them is not
+ * reported in the return value. The reason code of a publish ack, DISCONNECT
+ * or AUTH is read with #MQTT_GetReasonCodeV5.
+ *
+ * @param[in] pIncomingPacket #MQTTPacketInfo_t containing the buffer.
+ * @param[out] pPacketId The packet ID of obtained from the buffer. Not used
+ * in CONNACK, PINGRESP, DISCONNECT or AUTH.
+ * @param[out] pSessionPresent Boolean flag from a CONNACK indicating present session.
+ * @param[out] pConnackProperties Properties of a CONNACK. May be NULL.
+ *
+ * @return #MQTTBadParameter, #MQTTBadResponse, #MQTTServerRefused, or #MQTTSuccess.
+ */
+/* @[declare_mqtt_deserializeackv5] */
+MQTTStatus_t MQTT_DeserializeAckV5( const MQTTPacketInfo_t * pIncomingPacket,
+                                    uint16_t * pPacketId,
+                                    bool * pSessionPresent,
+                                    MQTTConnackProperties_t * pConnackProperties );
+/* @[declare_mqtt_deserializeackv5] */
+
+/**
+ * @brief Get the reason code of an MQTT 5 PUBACK, PUBREC, PUBREL, PUBCOMP,
+ * DISCONNECT or AUTH.
+ *
+ * The packet should have been validated with #MQTT_DeserializeAckV5.
+ *
+ * @param[in] pIncomingPacket #MQTTPacketInfo_t containing the buffer.
+ * @param[out] pReasonCode The reason code. A reason code omitted from the
+ * packet is the success code 0x00.
+ *
+ * @return #MQTTBadParameter or #MQTTSuccess.
+ */
+/* @[declare_mqtt_getreasoncodev5] */
+MQTTStatus_t MQTT_GetReasonCodeV5( const MQTTPacketInfo_t * pIncomingPacket,
+                                   uint8_t * pReasonCode );
+/* @[declare_mqtt_getreasoncodev5] */
+
+/**
+ * @brief Get the reason codes of an MQTT 5 SUBACK or UNSUBACK, which follow
+ * its properties.
+ *
+ * Each reason code corresponds to a topic filter of the SUBSCRIBE or
+ * UNSUBSCRIBE being acknowledged. For a SUBACK, the codes below 0x80 are the
+ * granted QoS, as for #MQTT_GetSubAckStatusCodes in MQTT 3.1.1.
+ *
+ * @param[in] pIncomingPacket #MQTTPacketInfo_t containing the buffer.
+ * @param[out] ppReasonCodes The first reason code in the packet buffer.
+ * @param[out] pReasonCodeCount The number of reason codes.
+ *
+ * @return #MQTTBadParameter if the packet is not a SUBACK or UNSUBACK or its
+ * properties are malformed; #MQTTSuccess otherwise.
+ */
+/* @[declare_mqtt_getsubackreasoncodesv5] */
+MQTTStatus_t MQTT_GetSubAckReasonCodesV5( const MQTTPacketInfo_t * pIncomingPacket,
+                                          uint8_t ** ppReasonCodes,
+                                          size_t * pReasonCodeCount );
+/* @[declare_mqtt_getsubackreasoncodesv5] */
+
+/**
+ * @brief Extract the MQTT packet type and length from a packet received by a
+ * server.
+ *
+ * This is the server-role counterpart of
+ * #MQTT_ProcessIncomingPacketTypeAndLength: it accepts the packets a client
+ * sends, rather than those a server sends, and rejects every packet other than
+ * PUBLISH whose reserved flags are not those of the spec.
+ *
+ * @param[in] pBuffer The buffer holding the raw data to be processed
+ * @param[in] pIndex Pointer to the index within the buffer to marking the end
+ *            of raw data available.
+ * @param[out] pIncomingPacket Structure used to hold the fields of the
+ *            incoming packet.
+ *
+ * @return #MQTTSuccess on successful extraction of type and length,
+ * #MQTTBadParameter if an argument is NULL,
+ * #MQTTBadResponse if an invalid packet is read,
+ * #MQTTNeedMoreBytes if the remaining length is not complete, and
+ * #MQTTNoDataAvailable if there is nothing to read.
+ */
+/* @[declare_mqtt_processincomingserverpackettypeandlength] */
+MQTTStatus_t MQTT_ProcessIncomingServerPacketTypeAndLength( const uint8_t * pBuffer,
+                                                            const size_t * pIndex,
+                                                            MQTTPacketInfo_t * pIncomingPacket );
+/* @[declare_mqtt_processincomingserverpackettypeandlength] */
+
+/**
+ * @brief Deserialize an MQTT 3.1.1 CONNECT.
+ *
+ * Nothing is copied: the client identifier, user name, password and will of
+ * the output point into #MQTTPacketInfo_t.pRemainingData, and are only valid
+ * as long as that buffer.
+ *
+ * @param[in] pIncomingPacket #MQTTPacketInfo_t containing the buffer.
+ * @param[out] pConnectInfo The connection parameters. The user name and
+ * password are NULL if the CONNECT has none.
+ * @param[out] pWillInfo The Last Will and Testament, if @p pWillPresent is set.
+ * @param[out] pWillPresent Whether the CONNECT carries a Last Will and
+ * Testament.
+ *
+ * @return #MQTTBadParameter, #MQTTBadResponse if the packet is malformed or of
+ * another protocol level, or #MQTTSuccess.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * // Variables used in this example.
+ * MQTTStatus_t status;
+ * MQTTPacketInfo_t incomingPacket;
+ * MQTTConnectInfo_t connectInfo;
+ * MQTTPublishInfo_t willInfo;
+ * bool willPresent;
+ *
+ * // Receive an incoming packet and populate all fields. The details are out of scope
+ * // for this example.
+ * receiveIncomingPacket( &incomingPacket );
+ *
+ * if( incomingPacket.type == MQTT_PACKET_TYPE_CONNECT )
+ * {
+ *      status = MQTT_DeserializeConnect( &incomingPacket, &connectInfo, &willInfo, &willPresent );
+ *
+ *      if( status == MQTTSuccess )
+ *      {
+ *          // Authenticate the client, then answer with MQTT_SerializeConnack.
+ *      }
+ * }
+ * @endcode
+ */
+/* @[declare_mqtt_deserializeconnect] */
+MQTTStatus_t MQTT_DeserializeConnect( const MQTTPacketInfo_t * pIncomingPacket,
+                                      MQTTConnectInfo_t * pConnectInfo,
+                                      MQTTPublishInfo_t * pWillInfo,
+                                      bool * pWillPresent );
+/* @[declare_mqtt_deserializeconnect] */
+
+/**
+ * @brief Deserialize an MQTT SUBSCRIBE.
+ *
+ * The topic filters of the output point into
+ * #MQTTPacketInfo_t.pRemainingData, and are only valid as long as that
+ * buffer.
+ *
+ * @param[in] pIncomingPacket #MQTTPacketInfo_t containing the buffer.
+ * @param[out] pPacketId The packet identifier, to answer with in the SUBACK.
+ * @param[out] pSubscriptionList The topic filters and their requested QoS.
+ * @param[in,out] pSubscriptionCount The length of @p pSubscriptionList, set to
+ * the number of topic filters of the SUBSCRIBE.
+ *
+ * @return #MQTTBadParameter, #MQTTBadResponse if the packet is malformed,
+ * #MQTTNoMemory if it has more topic filters than @p pSubscriptionList holds,
+ * or #MQTTSuccess.
+ */
+/* @[declare_mqtt_deserializesubscribe] */
+MQTTStatus_t MQTT_DeserializeSubscribe( const MQTTPacketInfo_t * pIncomingPacket,
+                                        uint16_t * pPacketId,
+                                        MQTTSubscribeInfo_t * pSubscriptionList,
+                                        size_t * pSubscriptionCount );
+/* @[declare_mqtt_deserializesubscribe] */
+
+/**
+ * @brief Deserialize an MQTT UNSUBSCRIBE.
+ *
+ * The topic filters of the output point into
+ * #MQTTPacketInfo_t.pRemainingData, and are only valid as long as that
+ * buffer. Their QoS is set to #MQTTQoS0.
+ *
+ * @param[in] pIncomingPacket #MQTTPacketInfo_t containing the buffer.
+ * @param[out] pPacketId The packet identifier, to answer with in the UNSUBACK.
+ * @param[out] pSubscriptionList The topic filters.
+ * @param[in,out] pSubscriptionCount The length of @p pSubscriptionList, set to
+ * the number of topic filters of the UNSUBSCRIBE.
+ *
+ * @return #MQTTBadParameter, #MQTTBadResponse if the packet is malformed,
+ * #MQTTNoMemory if it has more topic filters than @p pSubscriptionList holds,
+ * or #MQTTSuccess.
+ */
+/* @[declare_mqtt_deserializeunsubscribe] */
+MQTTStatus_t MQTT_DeserializeUnsubscribe( const MQTTPacketInfo_t * pIncomingPacket,
+                                          uint16_t * pPacketId,
+                                          MQTTSubscribeInfo_t * pSubscriptionList,
+                                          size_t * pSubscriptionCount );
+/* @[declare_mqtt_deserializeunsubscribe] */
+
+/**
+ * @brief Deserialize an MQTT PINGREQ.
+ *
+ * @param[in] pIncomingPacket #MQTTPacketInfo_t of the packet.
+ *
+ * @return #MQTTBadParameter, #MQTTBadResponse if the packet has a remaining
+ * length, or #MQTTSuccess.
+ */
+/* @[declare_mqtt_deserializepingreq] */
+MQTTStatus_t MQTT_DeserializePingreq( const MQTTPacketInfo_t * pIncomingPacket );
+/* @[declare_mqtt_deserializepingreq] */
+
+/**
+ * @brief Deserialize an MQTT 3.1.1 DISCONNECT.
+ *
+ * @param[in] pIncomingPacket #MQTTPacketInfo_t of the packet.
+ *
+ * @return #MQTTBadParameter, #MQTTBadResponse if the packet has a remaining
+ * length, or #MQTTSuccess.
+ */
+/* @[declare_mqtt_deserializedisconnect] */
+MQTTStatus_t MQTT_DeserializeDisconnect( const MQTTPacketInfo_t * pIncomingPacket );
+/* @[declare_mqtt_deserializedisconnect] */
+
+/**
+ * @brief Serialize an MQTT CONNACK into the given buffer.
+ *
+ * @param[out] pFixedBuffer Buffer for packet serialization, of at least
+ * #MQTT_CONNACK_PACKET_SIZE bytes.
+ * @param[in] sessionPresent Whether the server has a session for the client.
+ * Must be false if @p returnCode is not 0.
+ * @param[in] returnCode The Connect Return code, 0 to accept the connection or
+ * 1 to 5 to refuse it.
+ *
+ * @return #MQTTBadParameter, #MQTTNoMemory, or #MQTTSuccess.
+ */
+/* @[declare_mqtt_serializeconnack] */
+MQTTStatus_t MQTT_SerializeConnack( const MQTTFixedBuffer_t * pFixedBuffer,
+                                    bool sessionPresent,
+                                    uint8_t returnCode );
+/* @[declare_mqtt_serializeconnack] */
+
+/**
+ * @brief Get the size and Remaining Length of an MQTT SUBACK packet.
+ *
+ * @param[in] returnCodeCount Number of return codes, one for each topic filter
+ * of the SUBSCRIBE.
+ * @param[out] pRemainingLength The Remaining Length of the MQTT SUBACK packet.
+ * @param[out] pPacketSize The total size of the MQTT SUBACK packet.
+ *
+ * @return #MQTTBadParameter if the packet would exceed the size allowed by the
+ * MQTT spec; #MQTTSuccess otherwise.
+ */
+/* @[declare_mqtt_getsubackpacketsize] */
+MQTTStatus_t MQTT_GetSubackPacketSize( size_t returnCodeCount,
+                                       size_t * pRemainingLength,
+                                       size_t * pPacketSize );
+/* @[declare_mqtt_getsubackpacketsize] */
+
+/**
+ * @brief Serialize an MQTT SUBACK into the given buffer.
+ *
+ * @param[in] pReturnCodes The return code of each topic filter of the
+ * SUBSCRIBE: the granted QoS 0 to 2, or 0x80 for a failure.
+ * @param[in] returnCodeCount Number of return codes.
+ * @param[in] packetId The packet identifier of the SUBSCRIBE.
+ * @param[in] remainingLength Remaining Length provided by
+ * #MQTT_GetSubackPacketSize.
+ * @param[out] pFixedBuffer Buffer for packet serialization, of at least the
+ * packet size provided by #MQTT_GetSubackPacketSize.
+ *
+ * @return #MQTTBadParameter, #MQTTNoMemory, or #MQTTSuccess.
+ */
+/* @[declare_mqtt_serializesuback] */
+MQTTStatus_t MQTT_SerializeSuback( const uint8_t * pReturnCodes,
+                                   size_t returnCodeCount,
+                                   uint16_t packetId,
+                                   size_t remainingLength,
+                                   const MQTTFixedBuffer_t * pFixedBuffer );
+/* @[declare_mqtt_serializesuback] */
+
+/**
+ * @brief Serialize an MQTT UNSUBACK into the given buffer.
+ *
+ * @param[out] pFixedBuffer Buffer for packet serialization, of at least
+ * #MQTT_UNSUBACK_PACKET_SIZE bytes.
+ * @param[in] packetId The packet identifier of the UNSUBSCRIBE.
+ *
+ * @return #MQTTBadParameter, #MQTTNoMemory, or #MQTTSuccess.
+ */
+/* @[declare_mqtt_serializeunsuback] */
+MQTTStatus_t MQTT_SerializeUnsuback( const MQTTFixedBuffer_t * pFixedBuffer,
+                                     uint16_t packetId );
+/* @[declare_mqtt_serializeunsuback] */
+
+/**
+ * @brief Serialize an MQTT PINGRESP into the given buffer.
+ *
+ * @param[out] pFixedBuffer Buffer for packet serialization, of at least
+ * #MQTT_PINGRESP_PACKET_SIZE bytes.
+ *
+ * @return #MQTTBadParameter, #MQTTNoMemory, or #MQTTSuccess.
+ */
+/* @[declare_mqtt_serializepingresp] */
+MQTTStatus_t MQTT_SerializePingresp( const MQTTFixedBuffer_t * pFixedBuffer );
+/* @[declare_mqtt_serializepingresp] */
+
 /**
  * @fn uint8_t * MQTT_SerializeConnectFixedHeader( uint8_t * pIndex, const MQTTConnectInfo_t * pConnectInfo, const MQTTPublishInfo_t * pWillInfo, size_t remainingLength );
  * @brief Serialize the fixed part of the connect packet header.
@@ -1305,6 +1787,101 @@ uint8_t * MQTT_SerializeUnsubscribeHeader( size_t remainingLength,
                                            uint16_t packetId );
 /** @endcond */
 
+/**
+ * @fn uint8_t * MQTT_SerializeConnectFixedHeaderV5( uint8_t * pIndex, const MQTTConnectInfo_t * pConnectInfo, const MQTTPublishInfo_t * pWillInfo, size_t remainingLength );
+ * @brief Serialize the fixed part of the MQTT 5 connect packet header, up to
+ * and including its empty property length.
+ *
+ * @param[out] pIndex Pointer to the buffer where the header is to
+ * be serialized.
+ * @param[in] pConnectInfo The connect information.
+ * @param[in] pWillInfo The last will and testament information.
+ * @param[in] remainingLength The remaining length of the packet to be
+ * serialized.
+ *
+ * @return A pointer to the end of the encoded string.
+ */
+
+/**
+ * @cond DOXYGEN_IGNORE
+ * Doxygen should ignore this definition, this function is private.
+ */
+uint8_t * MQTT_SerializeConnectFixedHeaderV5( uint8_t * pIndex,
+                                              const MQTTConnectInfo_t * pConnectInfo,
+                                              const MQTTPublishInfo_t * pWillInfo,
+                                              size_t remainingLength );
+/** @endcond */
+
+/**
+ * @fn uint8_t * MQTT_SerializeSubscribeHeaderV5( size_t remainingLength, uint8_t * pIndex, uint16_t packetId, uint32_t subscriptionId );
+ * @brief Serialize the fixed part of the MQTT 5 subscribe packet header, up
+ * to and including its properties.
+ *
+ * @param[in] remainingLength The remaining length of the packet to be
+ * serialized.
+ * @param[in] pIndex Pointer to a buffer of at least
+ * #MQTT_SUBSCRIBE_HEADER_MAX_SIZE_V5 bytes where the header is to be
+ * serialized.
+ * @param[in] packetId The packet ID to be serialized.
+ * @param[in] subscriptionId The Subscription Identifier to be serialized, or
+ * 0 for none.
+ *
+ * @return A pointer to the end of the encoded string.
+ */
+
+/**
+ * @cond DOXYGEN_IGNORE
+ * Doxygen should ignore this definition, this function is private.
+ */
+uint8_t * MQTT_SerializeSubscribeHeaderV5( size_t remainingLength,
+                                           uint8_t * pIndex,
+                                           uint16_t packetId,
+                                           uint32_t subscriptionId );
+/** @endcond */
+
+/**
+ * @fn uint8_t * MQTT_SerializeUnsubscribeHeaderV5( size_t remainingLength, uint8_t * pIndex, uint16_t packetId );
+ * @brief Serialize the fixed part of the MQTT 5 unsubscribe packet header,
+ * up to and including its empty property length.
+ *
+ * @param[in] remainingLength The remaining length of the packet to be
+ * serialized.
+ * @param[in] pIndex Pointer to the buffer where the header is to
+ * be serialized.
+ * @param[in] packetId The packet ID to be serialized.
+ *
+ * @return A pointer to the end of the encoded string.
+ */
+
+/**
+ * @cond DOXYGEN_IGNORE
+ * Doxygen should ignore this definition, this function is private.
+ */
+uint8_t * MQTT_SerializeUnsubscribeHeaderV5( size_t remainingLength,
+                                             uint8_t * pIndex,
+                                             uint16_t packetId );
+/** @endcond */
+
+/**
+ * @fn uint8_t * MQTT_SerializePublishPropertiesV5( uint16_t topicAlias, uint8_t * pIndex );
+ * @brief Serialize the properties of an MQTT 5 PUBLISH packet, which follow
+ * the packet identifier.
+ *
+ * @param[in] topicAlias The topic alias to send, or 0 for none.
+ * @param[out] pIndex Pointer to a buffer of at least
+ * #MQTT_PUBLISH_PROPERTIES_MAX_SIZE_V5 bytes.
+ *
+ * @return A pointer to the end of the encoded properties.
+ */
+
+/**
+ * @cond DOXYGEN_IGNORE
+ * Doxygen should ignore this definition, this function is private.
+ */
+uint8_t * MQTT_SerializePublishPropertiesV5( uint16_t topicAlias,
+                                             uint8_t * pIndex );
+/** @endcond */
+
 /* *INDENT-OFF* */
 #ifdef __cplusplus
     }
@@ -63,6 +63,9 @@ typedef enum MQTTStateOperation
 } MQTTStateOperation_t;
 /** @endcond */
 
+/* The state engine is only built for QoS1 and QoS2 publishes. */
+#if ( MQTT_QOS0_ONLY == 0 )
+
 /**
  * @fn MQTTStatus_t MQTT_ReserveState( const MQTTContext_t * pMqttContext, uint16_t packetId, MQTTQoS_t qos );
  * @brief Reserve an entry for an outgoing QoS 1 or Qos 2 publish.
@@ -301,6 +304,8 @@ uint16_t MQTT_PublishToResend( const MQTTContext_t * pMqttContext,
 const char * MQTT_State_strerror( MQTTPublishState_t state );
 /** @endcond */
 
+#endif /* if ( MQTT_QOS0_ONLY == 0 ) */
+
 /* *INDENT-OFF* */
 #ifdef __cplusplus
     }
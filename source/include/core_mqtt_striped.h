@@ -0,0 +1,314 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file core_mqtt_striped.h
+ * @brief One logical MQTT client striped over several connections to the
+ * same broker.
+ *
+ * A broker typically serves each connection from one session, so a single
+ * #MQTTContext_t caps the throughput of a client. A striped client owns one
+ * context per connection ("stripe"). Publishes and subscriptions are routed
+ * to a stripe by a hash of their topic, so all packets of a topic travel over
+ * one connection and keep their order. Packets received on any stripe are
+ * given to a single callback.
+ *
+ * Each stripe is an ordinary #MQTTContext_t, available with
+ * #MQTTStriped_GetContext, so features such as #MQTT_InitStatefulQoS or
+ * #MQTT_RegisterTopicHandler are set up per stripe. Stripes are independent:
+ * an application may call #MQTT_ProcessLoop for each stripe from its own
+ * thread rather than calling #MQTTStriped_ProcessLoop.
+ */
+#ifndef CORE_MQTT_STRIPED_H
+#define CORE_MQTT_STRIPED_H
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    extern "C" {
+#endif
+/* *INDENT-ON* */
+
+#include "core_mqtt.h"
+
+/**
+ * @cond DOXYGEN_IGNORE
+ * Forward declaration for the callback type.
+ */
+struct MQTTStripedClient;
+/** @endcond */
+
+/**
+ * @ingroup mqtt_callback_types
+ * @brief Application callback receiving the packets of every stripe of a
+ * striped client.
+ *
+ * @note When stripes are processed from several threads, the callback is
+ * called concurrently from those threads.
+ *
+ * @param[in] pClient The striped client.
+ * @param[in] stripeIndex Index of the stripe which received the packet.
+ * Packet identifiers are only unique within a stripe.
+ * @param[in] pPacketInfo Information on the type of incoming MQTT packet.
+ * @param[in] pDeserializedInfo Deserialized information from incoming packet.
+ */
+/* @[define_mqtt_stripedeventcallback] */
+typedef void (* MQTTStripedEventCallback_t )( struct MQTTStripedClient * pClient,
+                                              size_t stripeIndex,
+                                              MQTTPacketInfo_t * pPacketInfo,
+                                              MQTTDeserializedInfo_t * pDeserializedInfo );
+/* @[define_mqtt_stripedeventcallback] */
+
+/**
+ * @ingroup mqtt_struct_types
+ * @brief One connection of a striped client.
+ */
+typedef struct MQTTStripe
+{
+    /**
+     * @brief The MQTT context of the connection. It must be the first member,
+     * so that the stripe is found from the context given to its callback.
+     */
+    MQTTContext_t context;
+
+    /**
+     * @brief The striped client owning the stripe.
+     */
+    struct MQTTStripedClient * pClient;
+
+    /**
+     * @brief Index of the stripe in the client.
+     */
+    size_t stripeIndex;
+} MQTTStripe_t;
+
+/**
+ * @ingroup mqtt_struct_types
+ * @brief A logical MQTT client striped over several connections.
+ */
+typedef struct MQTTStripedClient
+{
+    /**
+     * @brief The stripes of the client.
+     */
+    MQTTStripe_t * pStripes;
+
+    /**
+     * @brief Number of stripes.
+     */
+    size_t stripeCount;
+
+    /**
+     * @brief Callback receiving the packets of every stripe.
+     */
+    MQTTStripedEventCallback_t appCallback;
+} MQTTStripedClient_t;
+
+/**
+ * @brief Initialize a striped client, and the context of each of its stripes.
+ *
+ * @param[in] pClient The striped client to initialize.
+ * @param[in] pStripes Memory for @p stripeCount stripes. It must remain valid
+ * for the lifetime of the client.
+ * @param[in] stripeCount Number of stripes.
+ * @param[in] pTransportInterfaces One connected transport interface per stripe.
+ * @param[in] getTimeFunction The time utility function shared by the stripes.
+ * @param[in] userCallback The callback receiving the packets of every stripe.
+ * @param[in] pNetworkBuffers One network buffer per stripe.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * MQTTStripedClient_t client;
+ * MQTTStripe_t stripes[ 4 ];
+ * TransportInterface_t transports[ 4 ];
+ * MQTTFixedBuffer_t networkBuffers[ 4 ];
+ *
+ * // Connect one transport and set up one network buffer per stripe, then:
+ * status = MQTTStriped_Init( &client, stripes, 4, transports,
+ *                            getTimeStampMs, eventCallback, networkBuffers );
+ * @endcode
+ */
+/* @[declare_mqttstriped_init] */
+MQTTStatus_t MQTTStriped_Init( MQTTStripedClient_t * pClient,
+                               MQTTStripe_t * pStripes,
+                               size_t stripeCount,
+                               const TransportInterface_t * pTransportInterfaces,
+                               MQTTGetCurrentTimeFunc_t getTimeFunction,
+                               MQTTStripedEventCallback_t userCallback,
+                               const MQTTFixedBuffer_t * pNetworkBuffers );
+/* @[declare_mqttstriped_init] */
+
+/**
+ * @brief Get the MQTT context of a stripe.
+ *
+ * @param[in] pClient Initialized striped client.
+ * @param[in] stripeIndex Index of the stripe.
+ *
+ * @return The context, or NULL if the parameters are invalid.
+ */
+/* @[declare_mqttstriped_getcontext] */
+MQTTContext_t * MQTTStriped_GetContext( const MQTTStripedClient_t * pClient,
+                                        size_t stripeIndex );
+/* @[declare_mqttstriped_getcontext] */
+
+/**
+ * @brief Get the stripe carrying a topic name or topic filter.
+ *
+ * @param[in] pClient Initialized striped client.
+ * @param[in] pTopic The topic name or topic filter.
+ * @param[in] topicLength Length of @p pTopic.
+ *
+ * @return Index of the stripe. It is 0 if the parameters are invalid.
+ */
+/* @[declare_mqttstriped_getstripeindex] */
+size_t MQTTStriped_GetStripeIndex( const MQTTStripedClient_t * pClient,
+                                   const char * pTopic,
+                                   uint16_t topicLength );
+/* @[declare_mqttstriped_getstripeindex] */
+
+/**
+ * @brief Establish the MQTT session of every stripe.
+ *
+ * The stripes are connected one after the other, and the function stops at
+ * the first stripe which fails to connect.
+ *
+ * @param[in] pClient Initialized striped client.
+ * @param[in] pConnectInfos One set of connection information per stripe. The
+ * client identifiers must be different, as a broker allows one connection per
+ * client identifier.
+ * @param[in] pWillInfo Last Will and Testament, or NULL. It is only sent with
+ * the connection of stripe 0, so that it is published once.
+ * @param[in] timeoutMs Maximum time to wait for each CONNACK.
+ * @param[out] pSessionPresent Receives whether a previous session was present
+ * for each stripe; may be NULL.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed; the status of
+ * the first failed #MQTT_Connect; #MQTTSuccess otherwise.
+ */
+/* @[declare_mqttstriped_connect] */
+MQTTStatus_t MQTTStriped_Connect( MQTTStripedClient_t * pClient,
+                                  const MQTTConnectInfo_t * pConnectInfos,
+                                  const MQTTPublishInfo_t * pWillInfo,
+                                  uint32_t timeoutMs,
+                                  bool * pSessionPresent );
+/* @[declare_mqttstriped_connect] */
+
+/**
+ * @brief Publish on the stripe carrying the topic of the publish.
+ *
+ * @param[in] pClient Initialized and connected striped client.
+ * @param[in] pPublishInfo MQTT PUBLISH packet parameters.
+ * @param[out] pStripeIndex Receives the stripe used; may be NULL.
+ * @param[out] pPacketId Receives the packet identifier used on that stripe,
+ * 0 for a QoS 0 publish; may be NULL.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed; the status of
+ * #MQTT_Publish otherwise.
+ */
+/* @[declare_mqttstriped_publish] */
+MQTTStatus_t MQTTStriped_Publish( MQTTStripedClient_t * pClient,
+                                  const MQTTPublishInfo_t * pPublishInfo,
+                                  size_t * pStripeIndex,
+                                  uint16_t * pPacketId );
+/* @[declare_mqttstriped_publish] */
+
+/**
+ * @brief Subscribe to a topic filter on the stripe carrying it.
+ *
+ * Publishes on the topics of the filter are delivered by that stripe only,
+ * so they are not duplicated across connections. A topic filter without
+ * wildcards is carried by the same stripe as publishes on that topic.
+ *
+ * @param[in] pClient Initialized and connected striped client.
+ * @param[in] pSubscription The topic filter to subscribe to.
+ * @param[out] pStripeIndex Receives the stripe used; may be NULL.
+ * @param[out] pPacketId Receives the packet identifier of the SUBSCRIBE on
+ * that stripe, to match with its SUBACK; may be NULL.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed; the status of
+ * #MQTT_Subscribe otherwise.
+ */
+/* @[declare_mqttstriped_subscribe] */
+MQTTStatus_t MQTTStriped_Subscribe( MQTTStripedClient_t * pClient,
+                                    const MQTTSubscribeInfo_t * pSubscription,
+                                    size_t * pStripeIndex,
+                                    uint16_t * pPacketId );
+/* @[declare_mqttstriped_subscribe] */
+
+/**
+ * @brief Unsubscribe from a topic filter on the stripe carrying it.
+ *
+ * @param[in] pClient Initialized and connected striped client.
+ * @param[in] pSubscription The topic filter to unsubscribe from.
+ * @param[out] pStripeIndex Receives the stripe used; may be NULL.
+ * @param[out] pPacketId Receives the packet identifier of the UNSUBSCRIBE on
+ * that stripe, to match with its UNSUBACK; may be NULL.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed; the status of
+ * #MQTT_Unsubscribe otherwise.
+ */
+/* @[declare_mqttstriped_unsubscribe] */
+MQTTStatus_t MQTTStriped_Unsubscribe( MQTTStripedClient_t * pClient,
+                                      const MQTTSubscribeInfo_t * pSubscription,
+                                      size_t * pStripeIndex,
+                                      uint16_t * pPacketId );
+/* @[declare_mqttstriped_unsubscribe] */
+
+/**
+ * @brief Run #MQTT_ProcessLoop once for every stripe.
+ *
+ * Every stripe is processed even if an earlier one fails.
+ *
+ * @param[in] pClient Initialized and connected striped client.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed; the first status
+ * of #MQTT_ProcessLoop other than #MQTTSuccess and #MQTTNeedMoreBytes;
+ * #MQTTSuccess otherwise.
+ */
+/* @[declare_mqttstriped_processloop] */
+MQTTStatus_t MQTTStriped_ProcessLoop( MQTTStripedClient_t * pClient );
+/* @[declare_mqttstriped_processloop] */
+
+/**
+ * @brief Disconnect every connected stripe.
+ *
+ * @param[in] pClient Initialized striped client.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed; the first status
+ * of #MQTT_Disconnect other than #MQTTSuccess; #MQTTSuccess otherwise.
+ */
+/* @[declare_mqttstriped_disconnect] */
+MQTTStatus_t MQTTStriped_Disconnect( MQTTStripedClient_t * pClient );
+/* @[declare_mqttstriped_disconnect] */
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    }
+#endif
+/* *INDENT-ON* */
+
+#endif /* ifndef CORE_MQTT_STRIPED_H */
@@ -58,6 +58,13 @@
  * - [Transport Receive](@ref TransportRecv_t)
  * - [Transport Send](@ref TransportSend_t)
  *
+ * Transports with buffers of their own may also implement the optional
+ * [Transport Get TX Buffer](@ref TransportGetTxBuffer_t) and
+ * [Transport Commit TX Buffer](@ref TransportCommitTxBuffer_t) functions.
+ * Non-blocking transports may implement the optional
+ * [Transport Wait](@ref TransportWait_t) function, so that the library sleeps
+ * rather than retries while the transport is not ready.
+ *
  * Each of the functions above take in an opaque context @ref NetworkContext_t.
  * The functions above and the context are also grouped together in the
  * @ref TransportInterface_t structure:<br><br>
@@ -294,6 +301,95 @@ typedef int32_t ( * TransportWritev_t )( NetworkContext_t * pNetworkContext,
                                          size_t ioVecCount );
 /* @[define_transportwritev] */
 
+/**
+ * @transportcallback
+ * @brief Transport interface function lending a buffer of the transport, into
+ * which the MQTT library writes a packet to send.
+ *
+ * Transports which copy the bytes they send into buffers of their own, like
+ * the mbufs of a user-space TCP stack or the slots of a shared-memory ring,
+ * can implement this function along with #TransportCommitTxBuffer_t. The
+ * library then serializes packets straight into the memory of the transport,
+ * which saves the transport a copy of every packet. The library takes one
+ * buffer at a time, and commits it before taking another.
+ *
+ * @note Implementing this function is optional. When it is not implemented,
+ * or returns NULL, the library sends the packet with the send or writev
+ * function instead.
+ *
+ * @param[in] pNetworkContext Implementation-defined network context.
+ * @param[in] bytesToWrite Number of bytes the buffer must hold.
+ *
+ * @return A buffer holding at least @p bytesToWrite bytes, or NULL when the
+ * transport has no such buffer available.
+ */
+/* @[define_transportgettxbuffer] */
+typedef void * ( * TransportGetTxBuffer_t )( NetworkContext_t * pNetworkContext,
+                                             size_t bytesToWrite );
+/* @[define_transportgettxbuffer] */
+
+/**
+ * @transportcallback
+ * @brief Transport interface function sending the first bytes of a buffer
+ * returned by #TransportGetTxBuffer_t.
+ *
+ * The buffer goes back to the transport with this call, whatever its result.
+ * Committing zero bytes gives the buffer back without sending anything.
+ *
+ * @param[in] pNetworkContext Implementation-defined network context.
+ * @param[in] pBuffer The buffer returned by #TransportGetTxBuffer_t.
+ * @param[in] bytesToSend Number of bytes written at the start of the buffer.
+ *
+ * @return @p bytesToSend once the bytes are sent or queued for sending, or a
+ * negative value to indicate error. Unlike #TransportSend_t, a commit cannot
+ * send part of the buffer.
+ */
+/* @[define_transportcommittxbuffer] */
+typedef int32_t ( * TransportCommitTxBuffer_t )( NetworkContext_t * pNetworkContext,
+                                                 void * pBuffer,
+                                                 size_t bytesToSend );
+/* @[define_transportcommittxbuffer] */
+
+/**
+ * @transportstruct
+ * @brief What a #TransportWait_t function waits for.
+ */
+typedef enum TransportWaitEvent
+{
+    TRANSPORT_WAIT_READABLE = 0, /**< Data can be received. */
+    TRANSPORT_WAIT_WRITABLE = 1  /**< Data can be sent. */
+} TransportWaitEvent_t;
+
+/**
+ * @transportcallback
+ * @brief Transport interface function waiting until the transport can
+ * receive or send.
+ *
+ * The library receives and sends with non-blocking calls, and retries a call
+ * which transferred nothing until a timeout expires. When this function is
+ * implemented, the library calls it between the retries, so that a thread
+ * waiting on a slow peer sleeps instead of spinning. The timeouts of the
+ * library are unchanged.
+ *
+ * @note Implementing this function is optional. The function may return
+ * early, as the library retries the transfer and waits again until its
+ * timeout expires.
+ *
+ * @param[in] pNetworkContext Implementation-defined network context.
+ * @param[in] event Whether to wait for data to receive or for space to send.
+ * @param[in] timeoutMs Longest time to wait, in milliseconds.
+ *
+ * @return A positive value when the transport is ready, or when the next
+ * receive or send reports an error; 0 when the timeout expired; a negative
+ * value to indicate error. On error, the library goes on with the next receive
+ * or send, which reports the failure.
+ */
+/* @[define_transportwait] */
+typedef int32_t ( * TransportWait_t )( NetworkContext_t * pNetworkContext,
+                                       TransportWaitEvent_t event,
+                                       uint32_t timeoutMs );
+/* @[define_transportwait] */
+
 /**
  * @transportstruct
  * @brief The transport layer interface.
@@ -301,10 +397,13 @@ typedef int32_t ( * TransportWritev_t )( NetworkContext_t * pNetworkContext,
 /* @[define_transportinterface] */
 typedef struct TransportInterface
 {
-    TransportRecv_t recv;               /**< Transport receive function pointer. */
-    TransportSend_t send;               /**< Transport send function pointer. */
-    TransportWritev_t writev;           /**< Transport writev function pointer. */
-    NetworkContext_t * pNetworkContext; /**< Implementation-defined network context. */
+    TransportRecv_t recv;                     /**< Transport receive function pointer. */
+    TransportSend_t send;                     /**< Transport send function pointer. */
+    TransportWritev_t writev;                 /**< Transport writev function pointer. */
+    NetworkContext_t * pNetworkContext;       /**< Implementation-defined network context. */
+    TransportGetTxBuffer_t getTxBuffer;       /**< Transport function lending a TX buffer, or NULL. */
+    TransportCommitTxBuffer_t commitTxBuffer; /**< Transport function sending a lent TX buffer, or NULL. */
+    TransportWait_t wait;                     /**< Transport function waiting until it is ready, or NULL. */
 } TransportInterface_t;
 /* @[define_transportinterface] */
 
@@ -0,0 +1,856 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file core_mqtt_reactor.c
+ * @brief Implements the reactor driving many MQTT contexts with a pool of
+ * worker threads.
+ */
+
+/* epoll and eventfd are Linux interfaces. */
+#ifndef _GNU_SOURCE
+    #define _GNU_SOURCE
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "core_mqtt_reactor.h"
+
+/* Include config defaults header to get default values of configs. */
+#include "core_mqtt_config_defaults.h"
+
+/**
+ * @brief Largest number of events returned by one wait of a worker.
+ */
+#define MQTT_REACTOR_EVENTS_PER_WAIT    ( 64 )
+
+/**
+ * @brief Number of tasks a worker runs before it looks for ready connections
+ * without waiting. A connection with buffered packets is queued again after
+ * each task, so the queue alone may never run empty.
+ */
+#define MQTT_REACTOR_TASKS_PER_POLL     ( 8U )
+
+/**
+ * @brief Events a connection is armed for. With EPOLLONESHOT, a connection
+ * reports readiness once until its task re-arms it, so that it is never
+ * queued twice.
+ */
+#define MQTT_REACTOR_EVENTS             ( ( uint32_t ) EPOLLIN | ( uint32_t ) EPOLLRDHUP | ( uint32_t ) EPOLLONESHOT )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Append a connection to the queue of a worker. The mutex of the
+ * worker must be held.
+ *
+ * @param[in] pWorker The worker.
+ * @param[in] pConnection The connection, already marked as scheduled.
+ */
+static void pushTask( MQTTReactorWorker_t * pWorker,
+                      MQTTReactorConnection_t * pConnection );
+
+/**
+ * @brief Take a task from a worker: its own oldest task, or the newest task
+ * of another worker.
+ *
+ * @param[in] pWorker The worker looking for a task.
+ *
+ * @return The connection to process, or NULL if no worker has queued tasks.
+ */
+static MQTTReactorConnection_t * takeTask( MQTTReactorWorker_t * pWorker );
+
+/**
+ * @brief Queue a registered connection which is not yet scheduled on the
+ * worker owning it. The mutex of the worker must be held.
+ *
+ * @param[in] pWorker The worker owning the connection.
+ * @param[in] pConnection The connection.
+ *
+ * @return true if the connection was queued.
+ */
+static bool scheduleConnection( MQTTReactorWorker_t * pWorker,
+                                MQTTReactorConnection_t * pConnection );
+
+/**
+ * @brief Wake up to @p count workers other than @p pWorker which wait for
+ * events, so that they steal queued tasks.
+ *
+ * @param[in] pWorker The worker which queued the tasks.
+ * @param[in] count Number of tasks the other workers may take.
+ */
+static void wakeIdleWorkers( const MQTTReactorWorker_t * pWorker,
+                             size_t count );
+
+/**
+ * @brief Wait for the shard of a worker to become ready and queue the ready
+ * connections.
+ *
+ * @param[in] pWorker The worker.
+ * @param[in] timeoutMs Longest time to wait; 0 only collects ready
+ * connections.
+ */
+static void waitForEvents( MQTTReactorWorker_t * pWorker,
+                           int timeoutMs );
+
+/**
+ * @brief Queue every connection of the shard of a worker once per
+ * #MQTT_REACTOR_TICK_MS, so that #MQTT_ProcessLoop maintains its keep-alive.
+ *
+ * @param[in] pWorker The worker.
+ */
+static void queueTick( MQTTReactorWorker_t * pWorker );
+
+/**
+ * @brief Run #MQTT_ProcessLoop once for a connection, then re-arm it.
+ *
+ * @param[in] pWorker The worker running the task.
+ * @param[in] pConnection The connection.
+ */
+static void runTask( MQTTReactorWorker_t * pWorker,
+                     MQTTReactorConnection_t * pConnection );
+
+/**
+ * @brief Thread function of a worker.
+ *
+ * @param[in] pArgument The worker.
+ *
+ * @return NULL.
+ */
+static void * workerThread( void * pArgument );
+
+/**
+ * @brief Release the epoll instance and event descriptor of the first
+ * @p count workers.
+ *
+ * @param[in] pReactor The reactor.
+ * @param[in] count Number of workers to release.
+ */
+static void releaseWorkers( MQTTReactor_t * pReactor,
+                            size_t count );
+
+/*-----------------------------------------------------------*/
+
+static void pushTask( MQTTReactorWorker_t * pWorker,
+                      MQTTReactorConnection_t * pConnection )
+{
+    size_t count = pWorker->queueCount;
+
+    /* A connection is queued at most once, so the queue never holds more
+     * tasks than the shard has connections. */
+    assert( count < MQTT_REACTOR_MAX_CONNECTIONS_PER_WORKER );
+
+    pWorker->queue[ ( pWorker->queueHead + count ) % MQTT_REACTOR_MAX_CONNECTIONS_PER_WORKER ] = pConnection;
+
+    /* The count is read without the mutex by workers looking for a task. */
+    __atomic_store_n( &( pWorker->queueCount ), count + 1U, __ATOMIC_SEQ_CST );
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTReactorConnection_t * takeTask( MQTTReactorWorker_t * pWorker )
+{
+    MQTTReactor_t * pReactor = pWorker->pReactor;
+    MQTTReactorWorker_t * pVictim = NULL;
+    MQTTReactorConnection_t * pConnection = NULL;
+    size_t offset = 0U;
+    size_t count = 0U;
+
+    ( void ) pthread_mutex_lock( &( pWorker->mutex ) );
+
+    count = pWorker->queueCount;
+
+    if( count > 0U )
+    {
+        pConnection = pWorker->queue[ pWorker->queueHead ];
+        pWorker->queueHead = ( pWorker->queueHead + 1U ) % MQTT_REACTOR_MAX_CONNECTIONS_PER_WORKER;
+        __atomic_store_n( &( pWorker->queueCount ), count - 1U, __ATOMIC_SEQ_CST );
+    }
+
+    ( void ) pthread_mutex_unlock( &( pWorker->mutex ) );
+
+    /* Steal from the back of the queues of the other workers, starting with
+     * the next one, so that the owner keeps taking its oldest tasks. */
+    for( offset = 1U; ( pConnection == NULL ) && ( offset < pReactor->workerCount ); offset++ )
+    {
+        pVictim = &( pReactor->pWorkers[ ( ( size_t ) ( pWorker - pReactor->pWorkers ) + offset ) % pReactor->workerCount ] );
+
+        if( __atomic_load_n( &( pVictim->queueCount ), __ATOMIC_SEQ_CST ) > 0U )
+        {
+            ( void ) pthread_mutex_lock( &( pVictim->mutex ) );
+
+            count = pVictim->queueCount;
+
+            if( count > 0U )
+            {
+                pConnection = pVictim->queue[ ( pVictim->queueHead + count - 1U ) % MQTT_REACTOR_MAX_CONNECTIONS_PER_WORKER ];
+                __atomic_store_n( &( pVictim->queueCount ), count - 1U, __ATOMIC_SEQ_CST );
+                pWorker->stolenCount++;
+            }
+
+            ( void ) pthread_mutex_unlock( &( pVictim->mutex ) );
+        }
+    }
+
+    return pConnection;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool scheduleConnection( MQTTReactorWorker_t * pWorker,
+                                MQTTReactorConnection_t * pConnection )
+{
+    bool queued = false;
+    uint32_t expected = 0U;
+
+    /* The registration is checked under the mutex, so no connection is queued
+     * after #MQTTReactor_Remove has unregistered it. */
+    if( ( pConnection->registered == true ) &&
+        ( __atomic_compare_exchange_n( &( pConnection->scheduled ), &expected, 1U, false,
+                                       __ATOMIC_ACQUIRE, __ATOMIC_RELAXED ) == true ) )
+    {
+        pushTask( pWorker, pConnection );
+        queued = true;
+    }
+
+    return queued;
+}
+
+/*-----------------------------------------------------------*/
+
+static void wakeIdleWorkers( const MQTTReactorWorker_t * pWorker,
+                             size_t count )
+{
+    const MQTTReactor_t * pReactor = pWorker->pReactor;
+    size_t i = 0U;
+    size_t woken = 0U;
+    uint64_t one = 1U;
+
+    /* Pairs with the fence in waitForEvents: either the waiting worker sees
+     * the queued tasks, or this worker sees it waiting. */
+    __atomic_thread_fence( __ATOMIC_SEQ_CST );
+
+    for( i = 0U; ( i < pReactor->workerCount ) && ( woken < count ); i++ )
+    {
+        if( ( &( pReactor->pWorkers[ i ] ) != pWorker ) &&
+            ( __atomic_load_n( &( pReactor->pWorkers[ i ].waiting ), __ATOMIC_SEQ_CST ) != 0U ) )
+        {
+            ( void ) write( pReactor->pWorkers[ i ].wakeDescriptor, &one, sizeof( one ) );
+            woken++;
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void waitForEvents( MQTTReactorWorker_t * pWorker,
+                           int timeoutMs )
+{
+    const MQTTReactor_t * pReactor = pWorker->pReactor;
+    struct epoll_event events[ MQTT_REACTOR_EVENTS_PER_WAIT ];
+    MQTTReactorConnection_t * pConnection = NULL;
+    int eventCount = 0;
+    int i = 0;
+    size_t queued = 0U;
+    size_t w = 0U;
+    bool tasksPending = false;
+    uint64_t value = 0U;
+
+    if( timeoutMs > 0 )
+    {
+        __atomic_store_n( &( pWorker->waiting ), 1U, __ATOMIC_SEQ_CST );
+        __atomic_thread_fence( __ATOMIC_SEQ_CST );
+
+        /* Do not sleep if a task was queued since the last look. */
+        for( w = 0U; ( w < pReactor->workerCount ) && ( tasksPending == false ); w++ )
+        {
+            tasksPending = ( __atomic_load_n( &( pReactor->pWorkers[ w ].queueCount ), __ATOMIC_SEQ_CST ) > 0U );
+        }
+    }
+
+    if( tasksPending == false )
+    {
+        eventCount = epoll_wait( pWorker->epollDescriptor,
+                                 events,
+                                 MQTT_REACTOR_EVENTS_PER_WAIT,
+                                 timeoutMs );
+    }
+
+    __atomic_store_n( &( pWorker->waiting ), 0U, __ATOMIC_SEQ_CST );
+
+    if( eventCount > 0 )
+    {
+        ( void ) pthread_mutex_lock( &( pWorker->mutex ) );
+
+        for( i = 0; i < eventCount; i++ )
+        {
+            pConnection = ( MQTTReactorConnection_t * ) events[ i ].data.ptr;
+
+            if( pConnection == NULL )
+            {
+                ( void ) read( pWorker->wakeDescriptor, &value, sizeof( value ) );
+            }
+            else if( scheduleConnection( pWorker, pConnection ) == true )
+            {
+                queued++;
+            }
+            else
+            {
+                /* MISRA else. */
+            }
+        }
+
+        ( void ) pthread_mutex_unlock( &( pWorker->mutex ) );
+    }
+
+    /* This worker takes one of the tasks itself. */
+    if( queued > 1U )
+    {
+        wakeIdleWorkers( pWorker, queued - 1U );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void queueTick( MQTTReactorWorker_t * pWorker )
+{
+    const MQTTReactor_t * pReactor = pWorker->pReactor;
+    uint32_t now = pReactor->getTime();
+    size_t i = 0U;
+    size_t queued = 0U;
+
+    if( ( uint32_t ) ( now - pWorker->lastTickMs ) >= MQTT_REACTOR_TICK_MS )
+    {
+        pWorker->lastTickMs = now;
+
+        ( void ) pthread_mutex_lock( &( pWorker->mutex ) );
+
+        for( i = 0U; i < pWorker->connectionCount; i++ )
+        {
+            if( ( pWorker->connections[ i ]->failed == false ) &&
+                ( scheduleConnection( pWorker, pWorker->connections[ i ] ) == true ) )
+            {
+                queued++;
+            }
+        }
+
+        ( void ) pthread_mutex_unlock( &( pWorker->mutex ) );
+
+        if( queued > 1U )
+        {
+            wakeIdleWorkers( pWorker, queued - 1U );
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void runTask( MQTTReactorWorker_t * pWorker,
+                     MQTTReactorConnection_t * pConnection )
+{
+    MQTTReactor_t * pReactor = pWorker->pReactor;
+    MQTTReactorWorker_t * pOwner = pConnection->pOwner;
+    MQTTStatus_t status = MQTTSuccess;
+    struct epoll_event event;
+    bool process = false;
+    bool requeue = false;
+
+    ( void ) pthread_mutex_lock( &( pOwner->mutex ) );
+    process = ( pConnection->registered == true ) && ( pConnection->failed == false );
+    ( void ) pthread_mutex_unlock( &( pOwner->mutex ) );
+
+    if( process == true )
+    {
+        /* One iteration handles at most one packet, so a connection with more
+         * data goes back to its queue instead of holding this worker. */
+        status = MQTT_ProcessLoop( pConnection->pContext );
+
+        if( ( status != MQTTSuccess ) && ( status != MQTTNeedMoreBytes ) )
+        {
+            LogError( ( "Reactor connection failed: Status=%s.",
+                        MQTT_Status_strerror( status ) ) );
+            pConnection->failed = true;
+
+            if( pReactor->errorCallback != NULL )
+            {
+                pReactor->errorCallback( pReactor, pConnection, status );
+            }
+        }
+        else
+        {
+            /* A complete packet may already be buffered, which the socket will
+             * not report again. */
+            requeue = ( status == MQTTSuccess ) && ( pConnection->pContext->index > 0U );
+        }
+    }
+
+    pWorker->processedCount++;
+
+    ( void ) pthread_mutex_lock( &( pOwner->mutex ) );
+
+    if( ( pConnection->registered == true ) && ( pConnection->failed == false ) )
+    {
+        if( requeue == true )
+        {
+            /* The connection stays scheduled. */
+            pushTask( pOwner, pConnection );
+        }
+        else
+        {
+            ( void ) memset( &event, 0x00, sizeof( event ) );
+            event.events = MQTT_REACTOR_EVENTS;
+            event.data.ptr = pConnection;
+
+            /* Re-arming reports data which arrived while the task ran, as the
+             * connection is level-triggered. */
+            if( epoll_ctl( pOwner->epollDescriptor, EPOLL_CTL_MOD,
+                           pConnection->socketDescriptor, &event ) != 0 )
+            {
+                LogError( ( "Failed to re-arm reactor connection: errno=%d.", errno ) );
+            }
+
+            __atomic_store_n( &( pConnection->scheduled ), 0U, __ATOMIC_RELEASE );
+        }
+    }
+    else
+    {
+        __atomic_store_n( &( pConnection->scheduled ), 0U, __ATOMIC_RELEASE );
+    }
+
+    ( void ) pthread_mutex_unlock( &( pOwner->mutex ) );
+}
+
+/*-----------------------------------------------------------*/
+
+static void * workerThread( void * pArgument )
+{
+    MQTTReactorWorker_t * pWorker = ( MQTTReactorWorker_t * ) pArgument;
+    const MQTTReactor_t * pReactor = pWorker->pReactor;
+    MQTTReactorConnection_t * pConnection = NULL;
+    uint32_t tasksSincePoll = 0U;
+
+    while( __atomic_load_n( &( pReactor->running ), __ATOMIC_ACQUIRE ) != 0U )
+    {
+        pConnection = takeTask( pWorker );
+
+        if( pConnection != NULL )
+        {
+            runTask( pWorker, pConnection );
+            tasksSincePoll++;
+
+            if( tasksSincePoll >= MQTT_REACTOR_TASKS_PER_POLL )
+            {
+                waitForEvents( pWorker, 0 );
+                tasksSincePoll = 0U;
+            }
+        }
+        else
+        {
+            waitForEvents( pWorker, ( int ) MQTT_REACTOR_TICK_MS );
+            tasksSincePoll = 0U;
+        }
+
+        queueTick( pWorker );
+    }
+
+    return NULL;
+}
+
+/*-----------------------------------------------------------*/
+
+static void releaseWorkers( MQTTReactor_t * pReactor,
+                            size_t count )
+{
+    size_t i = 0U;
+
+    for( i = 0U; i < count; i++ )
+    {
+        ( void ) close( pReactor->pWorkers[ i ].wakeDescriptor );
+        ( void ) close( pReactor->pWorkers[ i ].epollDescriptor );
+        ( void ) pthread_mutex_destroy( &( pReactor->pWorkers[ i ].mutex ) );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTTReactor_Init( MQTTReactor_t * pReactor,
+                               MQTTReactorWorker_t * pWorkers,
+                               size_t workerCount,
+                               MQTTGetCurrentTimeFunc_t getTimeFunction,
+                               MQTTReactorErrorCallback_t errorCallback )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTReactorWorker_t * pWorker = NULL;
+    struct epoll_event event;
+    size_t i = 0U;
+
+    if( ( pReactor == NULL ) || ( pWorkers == NULL ) ||
+        ( workerCount == 0U ) || ( getTimeFunction == NULL ) )
+    {
+        LogError( ( "Argument cannot be NULL: pReactor=%p, pWorkers=%p, "
+                    "workerCount=%lu, getTimeFunction=%p.",
+                    ( void * ) pReactor,
+                    ( void * ) pWorkers,
+                    ( unsigned long ) workerCount,
+                    ( void * ) getTimeFunction ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        ( void ) memset( pReactor, 0x00, sizeof( MQTTReactor_t ) );
+        ( void ) memset( pWorkers, 0x00, workerCount * sizeof( MQTTReactorWorker_t ) );
+        pReactor->pWorkers = pWorkers;
+        pReactor->workerCount = workerCount;
+        pReactor->getTime = getTimeFunction;
+        pReactor->errorCallback = errorCallback;
+
+        for( i = 0U; ( i < workerCount ) && ( status == MQTTSuccess ); i++ )
+        {
+            pWorker = &( pWorkers[ i ] );
+            pWorker->pReactor = pReactor;
+            pWorker->epollDescriptor = epoll_create1( EPOLL_CLOEXEC );
+            pWorker->wakeDescriptor = eventfd( 0U, EFD_NONBLOCK | EFD_CLOEXEC );
+
+            /* The event descriptor is the only one registered without a
+             * connection. */
+            ( void ) memset( &event, 0x00, sizeof( event ) );
+            event.events = EPOLLIN;
+            event.data.ptr = NULL;
+
+            if( ( pWorker->epollDescriptor < 0 ) || ( pWorker->wakeDescriptor < 0 ) ||
+                ( epoll_ctl( pWorker->epollDescriptor, EPOLL_CTL_ADD,
+                             pWorker->wakeDescriptor, &event ) != 0 ) ||
+                ( pthread_mutex_init( &( pWorker->mutex ), NULL ) != 0 ) )
+            {
+                LogError( ( "Failed to create the epoll instance of worker %lu: errno=%d.",
+                            ( unsigned long ) i, errno ) );
+
+                if( pWorker->wakeDescriptor >= 0 )
+                {
+                    ( void ) close( pWorker->wakeDescriptor );
+                }
+
+                if( pWorker->epollDescriptor >= 0 )
+                {
+                    ( void ) close( pWorker->epollDescriptor );
+                }
+
+                releaseWorkers( pReactor, i );
+                status = MQTTNoMemory;
+            }
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTTReactor_Start( MQTTReactor_t * pReactor )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    uint32_t now = 0U;
+    size_t i = 0U;
+
+    if( ( pReactor == NULL ) || ( pReactor->pWorkers == NULL ) )
+    {
+        LogError( ( "Argument cannot be NULL: pReactor=%p.", ( void * ) pReactor ) );
+        status = MQTTBadParameter;
+    }
+    else if( __atomic_load_n( &( pReactor->running ), __ATOMIC_ACQUIRE ) != 0U )
+    {
+        LogError( ( "The reactor is already running." ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        now = pReactor->getTime();
+        __atomic_store_n( &( pReactor->running ), 1U, __ATOMIC_RELEASE );
+
+        for( i = 0U; ( i < pReactor->workerCount ) && ( status == MQTTSuccess ); i++ )
+        {
+            pReactor->pWorkers[ i ].lastTickMs = now;
+
+            if( pthread_create( &( pReactor->pWorkers[ i ].thread ), NULL,
+                                workerThread, &( pReactor->pWorkers[ i ] ) ) == 0 )
+            {
+                pReactor->pWorkers[ i ].threadStarted = true;
+            }
+            else
+            {
+                LogError( ( "Failed to create the thread of worker %lu.",
+                            ( unsigned long ) i ) );
+                status = MQTTIllegalState;
+            }
+        }
+
+        if( status != MQTTSuccess )
+        {
+            ( void ) MQTTReactor_Stop( pReactor );
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTTReactor_Stop( MQTTReactor_t * pReactor )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTReactorWorker_t * pWorker = NULL;
+    MQTTReactorConnection_t * pConnection = NULL;
+    struct epoll_event event;
+    uint64_t one = 1U;
+    size_t i = 0U;
+    size_t j = 0U;
+
+    if( ( pReactor == NULL ) || ( pReactor->pWorkers == NULL ) )
+    {
+        LogError( ( "Argument cannot be NULL: pReactor=%p.", ( void * ) pReactor ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        __atomic_store_n( &( pReactor->running ), 0U, __ATOMIC_RELEASE );
+
+        for( i = 0U; i < pReactor->workerCount; i++ )
+        {
+            ( void ) write( pReactor->pWorkers[ i ].wakeDescriptor, &one, sizeof( one ) );
+        }
+
+        for( i = 0U; i < pReactor->workerCount; i++ )
+        {
+            pWorker = &( pReactor->pWorkers[ i ] );
+
+            if( pWorker->threadStarted == true )
+            {
+                ( void ) pthread_join( pWorker->thread, NULL );
+                pWorker->threadStarted = false;
+            }
+        }
+
+        /* No task runs any more. Dropped tasks leave their connections
+         * disarmed; re-arm them so that a restarted reactor picks them up. */
+        for( i = 0U; i < pReactor->workerCount; i++ )
+        {
+            pWorker = &( pReactor->pWorkers[ i ] );
+
+            ( void ) pthread_mutex_lock( &( pWorker->mutex ) );
+
+            pWorker->queueHead = 0U;
+            __atomic_store_n( &( pWorker->queueCount ), 0U, __ATOMIC_SEQ_CST );
+
+            for( j = 0U; j < pWorker->connectionCount; j++ )
+            {
+                pConnection = pWorker->connections[ j ];
+
+                if( ( pConnection->failed == false ) &&
+                    ( __atomic_load_n( &( pConnection->scheduled ), __ATOMIC_ACQUIRE ) != 0U ) )
+                {
+                    ( void ) memset( &event, 0x00, sizeof( event ) );
+                    event.events = MQTT_REACTOR_EVENTS;
+                    event.data.ptr = pConnection;
+                    ( void ) epoll_ctl( pWorker->epollDescriptor, EPOLL_CTL_MOD,
+                                        pConnection->socketDescriptor, &event );
+                }
+
+                __atomic_store_n( &( pConnection->scheduled ), 0U, __ATOMIC_RELEASE );
+            }
+
+            ( void ) pthread_mutex_unlock( &( pWorker->mutex ) );
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTTReactor_Cleanup( MQTTReactor_t * pReactor )
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    if( ( pReactor == NULL ) || ( pReactor->pWorkers == NULL ) )
+    {
+        LogError( ( "Argument cannot be NULL: pReactor=%p.", ( void * ) pReactor ) );
+        status = MQTTBadParameter;
+    }
+    else if( __atomic_load_n( &( pReactor->running ), __ATOMIC_ACQUIRE ) != 0U )
+    {
+        LogError( ( "The reactor must be stopped before cleanup." ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        releaseWorkers( pReactor, pReactor->workerCount );
+        pReactor->pWorkers = NULL;
+        pReactor->workerCount = 0U;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTTReactor_Add( MQTTReactor_t * pReactor,
+                              MQTTReactorConnection_t * pConnection )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTReactorWorker_t * pWorker = NULL;
+    struct epoll_event event;
+    size_t i = 0U;
+
+    if( ( pReactor == NULL ) || ( pReactor->pWorkers == NULL ) ||
+        ( pConnection == NULL ) || ( pConnection->pContext == NULL ) ||
+        ( pConnection->socketDescriptor < 0 ) )
+    {
+        LogError( ( "Argument cannot be NULL: pReactor=%p, pConnection=%p.",
+                    ( void * ) pReactor,
+                    ( void * ) pConnection ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        /* The counts only guide the choice; the capacity is checked under
+         * the mutex. */
+        pWorker = &( pReactor->pWorkers[ 0 ] );
+
+        for( i = 1U; i < pReactor->workerCount; i++ )
+        {
+            if( pReactor->pWorkers[ i ].connectionCount < pWorker->connectionCount )
+            {
+                pWorker = &( pReactor->pWorkers[ i ] );
+            }
+        }
+
+        ( void ) pthread_mutex_lock( &( pWorker->mutex ) );
+
+        if( pWorker->connectionCount >= MQTT_REACTOR_MAX_CONNECTIONS_PER_WORKER )
+        {
+            LogError( ( "Every reactor shard is full." ) );
+            status = MQTTNoMemory;
+        }
+        else
+        {
+            pConnection->pOwner = pWorker;
+            pConnection->shardIndex = pWorker->connectionCount;
+            pConnection->scheduled = 0U;
+            pConnection->failed = false;
+
+            ( void ) memset( &event, 0x00, sizeof( event ) );
+            event.events = MQTT_REACTOR_EVENTS;
+            event.data.ptr = pConnection;
+
+            if( epoll_ctl( pWorker->epollDescriptor, EPOLL_CTL_ADD,
+                           pConnection->socketDescriptor, &event ) != 0 )
+            {
+                LogError( ( "Failed to add socket %d to epoll: errno=%d.",
+                            pConnection->socketDescriptor, errno ) );
+                status = MQTTNoMemory;
+            }
+            else
+            {
+                pWorker->connections[ pWorker->connectionCount ] = pConnection;
+                pWorker->connectionCount++;
+                pConnection->registered = true;
+            }
+        }
+
+        ( void ) pthread_mutex_unlock( &( pWorker->mutex ) );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTTReactor_Remove( MQTTReactor_t * pReactor,
+                                 MQTTReactorConnection_t * pConnection )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTReactorWorker_t * pWorker = NULL;
+    size_t last = 0U;
+    struct timespec pause = { 0, 1000000L };
+
+    if( ( pReactor == NULL ) || ( pConnection == NULL ) ||
+        ( pConnection->pOwner == NULL ) )
+    {
+        LogError( ( "Argument cannot be NULL: pReactor=%p, pConnection=%p.",
+                    ( void * ) pReactor,
+                    ( void * ) pConnection ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        pWorker = pConnection->pOwner;
+
+        ( void ) pthread_mutex_lock( &( pWorker->mutex ) );
+
+        if( pConnection->registered == false )
+        {
+            LogError( ( "The connection is not registered." ) );
+            status = MQTTBadParameter;
+        }
+        else
+        {
+            pConnection->registered = false;
+            ( void ) epoll_ctl( pWorker->epollDescriptor, EPOLL_CTL_DEL,
+                                pConnection->socketDescriptor, NULL );
+
+            /* Move the last connection of the shard into the gap. */
+            last = pWorker->connectionCount - 1U;
+            pWorker->connections[ pConnection->shardIndex ] = pWorker->connections[ last ];
+            pWorker->connections[ pConnection->shardIndex ]->shardIndex = pConnection->shardIndex;
+            pWorker->connections[ last ] = NULL;
+            pWorker->connectionCount = last;
+        }
+
+        ( void ) pthread_mutex_unlock( &( pWorker->mutex ) );
+
+        /* A queued task of the connection is skipped by its worker, or dropped
+         * by #MQTTReactor_Stop; either clears the flag. */
+        while( ( status == MQTTSuccess ) &&
+               ( __atomic_load_n( &( pConnection->scheduled ), __ATOMIC_ACQUIRE ) != 0U ) )
+        {
+            ( void ) nanosleep( &pause, NULL );
+        }
+
+        if( status == MQTTSuccess )
+        {
+            pConnection->pOwner = NULL;
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
@@ -0,0 +1,262 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file core_mqtt_reactor.h
+ * @brief A pool of worker threads driving #MQTT_ProcessLoop for many
+ * connected MQTT contexts on Linux.
+ *
+ * Connections are sharded across the workers, and each worker waits for its
+ * shard on its own epoll instance. A connection with data is queued as a task
+ * which runs #MQTT_ProcessLoop once, and with it the application callbacks of
+ * at most one packet; the connection is then re-armed, so a connection which
+ * keeps receiving goes to the back of the queue each time rather than
+ * holding its worker. Workers without tasks steal queued tasks of other
+ * shards, so that slow callbacks on one shard do not delay ready connections
+ * while other workers are idle. Every connection is also queued periodically
+ * so that #MQTT_ProcessLoop maintains its keep-alive.
+ *
+ * A connection is processed by one worker at a time, but by different workers
+ * over its lifetime. Application calls such as #MQTT_Publish may be made on a
+ * registered context from other threads when #MQTT_PRE_SEND_HOOK and
+ * #MQTT_PRE_STATE_UPDATE_HOOK are defined, for example as mutexes.
+ */
+
+#ifndef CORE_MQTT_REACTOR_H
+#define CORE_MQTT_REACTOR_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    extern "C" {
+#endif
+/* *INDENT-ON* */
+
+#include "core_mqtt.h"
+
+/**
+ * @brief Largest number of connections in the shard of one worker.
+ */
+#ifndef MQTT_REACTOR_MAX_CONNECTIONS_PER_WORKER
+    #define MQTT_REACTOR_MAX_CONNECTIONS_PER_WORKER    ( 1024U )
+#endif
+
+/**
+ * @brief Interval at which every connection is processed even without data,
+ * to maintain its keep-alive.
+ */
+#ifndef MQTT_REACTOR_TICK_MS
+    #define MQTT_REACTOR_TICK_MS    ( 100U )
+#endif
+
+/**
+ * @cond DOXYGEN_IGNORE
+ * Forward declarations for the structures referring to each other.
+ */
+struct MQTTReactor;
+struct MQTTReactorWorker;
+/** @endcond */
+
+/**
+ * @ingroup mqtt_struct_types
+ * @brief A connection driven by the reactor.
+ *
+ * The application sets #MQTTReactorConnection_t.pContext and
+ * #MQTTReactorConnection_t.socketDescriptor before #MQTTReactor_Add; the
+ * other members are private.
+ */
+typedef struct MQTTReactorConnection
+{
+    MQTTContext_t * pContext;          /**< @brief Connected MQTT context. */
+    int socketDescriptor;              /**< @brief Socket of the transport of the context. */
+    void * pAppContext;                /**< @brief Application data; not used by the reactor. */
+    struct MQTTReactorWorker * pOwner; /**< @brief Worker whose shard holds the connection. */
+    size_t shardIndex;                 /**< @brief Position of the connection in its shard. */
+    uint32_t scheduled;                /**< @brief Non-zero while queued or being processed. */
+    bool registered;                   /**< @brief Whether the connection is in a shard. */
+    bool failed;                       /**< @brief Whether #MQTT_ProcessLoop failed on the connection. */
+} MQTTReactorConnection_t;
+
+/**
+ * @ingroup mqtt_callback_types
+ * @brief Application callback invoked by a worker when #MQTT_ProcessLoop fails
+ * on a connection, for example because the peer closed it.
+ *
+ * The connection is no longer processed; the application removes it with
+ * #MQTTReactor_Remove from another thread.
+ *
+ * @param[in] pReactor The reactor.
+ * @param[in] pConnection The failed connection.
+ * @param[in] status The status returned by #MQTT_ProcessLoop.
+ */
+typedef void (* MQTTReactorErrorCallback_t )( struct MQTTReactor * pReactor,
+                                              MQTTReactorConnection_t * pConnection,
+                                              MQTTStatus_t status );
+
+/**
+ * @ingroup mqtt_struct_types
+ * @brief A worker thread with its shard of connections.
+ *
+ * @note The members of this struct are private, except for
+ * #MQTTReactorWorker_t.processedCount and #MQTTReactorWorker_t.stolenCount
+ * which may be read as statistics.
+ */
+typedef struct MQTTReactorWorker
+{
+    struct MQTTReactor * pReactor;  /**< @brief The reactor of the worker. */
+    pthread_t thread;               /**< @brief The thread of the worker. */
+    bool threadStarted;             /**< @brief Whether the thread is running. */
+    int epollDescriptor;            /**< @brief Epoll instance waiting for the shard. */
+    int wakeDescriptor;             /**< @brief Event descriptor interrupting the wait. */
+    uint32_t waiting;               /**< @brief Non-zero while the worker waits for events. */
+    pthread_mutex_t mutex;          /**< @brief Protects the queue and the shard. */
+    size_t queueHead;               /**< @brief Index of the oldest queued task. */
+    size_t queueCount;              /**< @brief Number of queued tasks. */
+    size_t connectionCount;         /**< @brief Number of connections in the shard. */
+    uint32_t lastTickMs;            /**< @brief Time the shard was last queued for keep-alive. */
+    uint64_t processedCount;        /**< @brief Tasks run by the worker. */
+    uint64_t stolenCount;           /**< @brief Tasks the worker stole from other shards. */
+    MQTTReactorConnection_t * queue[ MQTT_REACTOR_MAX_CONNECTIONS_PER_WORKER ];       /**< @brief Ring of queued tasks. */
+    MQTTReactorConnection_t * connections[ MQTT_REACTOR_MAX_CONNECTIONS_PER_WORKER ]; /**< @brief The shard. */
+} MQTTReactorWorker_t;
+
+/**
+ * @ingroup mqtt_struct_types
+ * @brief The reactor: a pool of workers.
+ */
+typedef struct MQTTReactor
+{
+    MQTTReactorWorker_t * pWorkers;           /**< @brief The workers. */
+    size_t workerCount;                       /**< @brief Number of workers. */
+    MQTTGetCurrentTimeFunc_t getTime;         /**< @brief Time source for keep-alive ticks. */
+    MQTTReactorErrorCallback_t errorCallback; /**< @brief Callback for failed connections. */
+    uint32_t running;                         /**< @brief Non-zero while the workers run. */
+} MQTTReactor_t;
+
+/**
+ * @brief Initialize a reactor and the epoll instance of each worker.
+ *
+ * @param[in] pReactor The reactor to initialize.
+ * @param[in] pWorkers Memory for @p workerCount workers. It must remain valid
+ * until #MQTTReactor_Cleanup.
+ * @param[in] workerCount Number of worker threads.
+ * @param[in] getTimeFunction Time source in milliseconds.
+ * @param[in] errorCallback Callback for failed connections; may be NULL.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed; #MQTTNoMemory
+ * if an epoll instance or event descriptor could not be created;
+ * #MQTTSuccess otherwise.
+ */
+/* @[declare_mqttreactor_init] */
+MQTTStatus_t MQTTReactor_Init( MQTTReactor_t * pReactor,
+                               MQTTReactorWorker_t * pWorkers,
+                               size_t workerCount,
+                               MQTTGetCurrentTimeFunc_t getTimeFunction,
+                               MQTTReactorErrorCallback_t errorCallback );
+/* @[declare_mqttreactor_init] */
+
+/**
+ * @brief Start the worker threads.
+ *
+ * @param[in] pReactor Initialized reactor.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed or the reactor
+ * already runs; #MQTTIllegalState if a thread could not be created;
+ * #MQTTSuccess otherwise.
+ */
+/* @[declare_mqttreactor_start] */
+MQTTStatus_t MQTTReactor_Start( MQTTReactor_t * pReactor );
+/* @[declare_mqttreactor_start] */
+
+/**
+ * @brief Stop and join the worker threads. Queued tasks are dropped; the
+ * connections stay registered.
+ *
+ * @note This function must not be called from a callback run by a worker.
+ *
+ * @param[in] pReactor Initialized reactor.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed; #MQTTSuccess
+ * otherwise.
+ */
+/* @[declare_mqttreactor_stop] */
+MQTTStatus_t MQTTReactor_Stop( MQTTReactor_t * pReactor );
+/* @[declare_mqttreactor_stop] */
+
+/**
+ * @brief Release the epoll instances of a stopped reactor.
+ *
+ * @param[in] pReactor Stopped reactor.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed or the reactor
+ * runs; #MQTTSuccess otherwise.
+ */
+/* @[declare_mqttreactor_cleanup] */
+MQTTStatus_t MQTTReactor_Cleanup( MQTTReactor_t * pReactor );
+/* @[declare_mqttreactor_cleanup] */
+
+/**
+ * @brief Add a connected context to the shard with the fewest connections.
+ *
+ * @param[in] pReactor Initialized reactor.
+ * @param[in] pConnection The connection, with its context and socket set. It
+ * must remain valid until it is removed.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed; #MQTTNoMemory
+ * if every shard is full or the socket could not be added to epoll;
+ * #MQTTSuccess otherwise.
+ */
+/* @[declare_mqttreactor_add] */
+MQTTStatus_t MQTTReactor_Add( MQTTReactor_t * pReactor,
+                              MQTTReactorConnection_t * pConnection );
+/* @[declare_mqttreactor_add] */
+
+/**
+ * @brief Remove a connection, waiting until no worker processes it.
+ *
+ * @note This function must not be called from a callback run for the same
+ * connection.
+ *
+ * @param[in] pReactor Initialized reactor.
+ * @param[in] pConnection The connection to remove.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed or the connection
+ * is not registered; #MQTTSuccess otherwise.
+ */
+/* @[declare_mqttreactor_remove] */
+MQTTStatus_t MQTTReactor_Remove( MQTTReactor_t * pReactor,
+                                 MQTTReactorConnection_t * pConnection );
+/* @[declare_mqttreactor_remove] */
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    }
+#endif
+/* *INDENT-ON* */
+
+#endif /* ifndef CORE_MQTT_REACTOR_H */
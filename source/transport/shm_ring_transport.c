@@ -0,0 +1,1049 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file shm_ring_transport.c
+ * @brief Implements the transport interface over ring buffers in shared
+ * memory.
+ */
+
+/* syscall() is not part of POSIX. */
+#ifndef _GNU_SOURCE
+    #define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include "shm_ring_transport.h"
+
+/* Include config defaults header to get default values of configs. */
+#include "core_mqtt_config_defaults.h"
+
+/**
+ * @brief Each compilation unit that uses the transport must define the
+ * NetworkContext struct.
+ */
+struct NetworkContext
+{
+    ShmRingTransportParams_t * pParams;
+};
+
+/**
+ * @brief Value identifying a segment laid out by
+ * #ShmRingTransport_InitSegment.
+ */
+#define SHM_RING_TRANSPORT_MAGIC            ( 0x4D515352U )
+
+/**
+ * @brief Size of a cache line, by which the indices written by each side are
+ * kept apart.
+ */
+#define SHM_RING_TRANSPORT_CACHE_LINE       ( 64U )
+
+/**
+ * @brief Smallest size of a ring.
+ */
+#define SHM_RING_TRANSPORT_MIN_RING_SIZE    ( 64U )
+
+/**
+ * @brief Largest size of a ring, so that the indices of a ring never overflow
+ * the difference of two 32-bit values.
+ */
+#define SHM_RING_TRANSPORT_MAX_RING_SIZE    ( 0x40000000U )
+
+/**
+ * @brief Number of nanoseconds in a second.
+ */
+#define NANOSECONDS_PER_SECOND              ( 1000000000L )
+
+/**
+ * @brief Shared state of one ring.
+ *
+ * The indices run freely and are masked into the ring, so that a full ring is
+ * told apart from an empty one. The producer and the consumer each write to a
+ * cache line of their own.
+ */
+typedef struct RingControl
+{
+    uint32_t tail;                                                 /**< @brief End of the sent data, written by the producer. The consumer sleeps on it. */
+    uint32_t producerWaiting;                                      /**< @brief Whether the producer sleeps, or is about to sleep, on the head. */
+    uint8_t producerPad[ SHM_RING_TRANSPORT_CACHE_LINE - 8U ];     /**< @brief Keeps the consumer fields on another cache line. */
+    uint32_t head;                                                 /**< @brief End of the received data, written by the consumer. The producer sleeps on it. */
+    uint32_t consumerWaiting;                                      /**< @brief Whether the consumer sleeps, or is about to sleep, on the tail. */
+    uint8_t consumerPad[ SHM_RING_TRANSPORT_CACHE_LINE - 8U ];     /**< @brief Keeps the next ring on another cache line. */
+} RingControl_t;
+
+/**
+ * @brief Layout of the start of a segment. The data of the ring sent by the
+ * client follows it, then the data of the ring sent by the server.
+ */
+typedef struct SegmentHeader
+{
+    uint32_t magic;                                                 /**< @brief #SHM_RING_TRANSPORT_MAGIC, once the segment is laid out. */
+    uint32_t ringSize;                                              /**< @brief Size of each ring. */
+    uint32_t closed[ 2 ];                                           /**< @brief Whether each side has closed, indexed by #ShmRingTransportSide_t. */
+    uint8_t headerPad[ SHM_RING_TRANSPORT_CACHE_LINE - 16U ];       /**< @brief Keeps the rings on other cache lines. */
+    RingControl_t rings[ 2 ];                                       /**< @brief The ring sent by each side, indexed by #ShmRingTransportSide_t. */
+} SegmentHeader_t;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Get the parameters of a network context.
+ *
+ * @param[in] pNetworkContext Network context of the connection.
+ *
+ * @return The parameters, or NULL if the network context is not attached.
+ */
+static ShmRingTransportParams_t * getParams( const NetworkContext_t * pNetworkContext );
+
+/**
+ * @brief Check that a ring size is a power of 2 within the supported range.
+ *
+ * @param[in] ringSize The ring size.
+ *
+ * @return true if the ring size is valid.
+ */
+static bool isValidRingSize( uint32_t ringSize );
+
+/**
+ * @brief Get the header of the segment of a side.
+ *
+ * @param[in] pParams Parameters of the side.
+ *
+ * @return The header.
+ */
+static SegmentHeader_t * getHeader( const ShmRingTransportParams_t * pParams );
+
+/**
+ * @brief Get the data of the ring sent by a side.
+ *
+ * @param[in] pParams Parameters of either side.
+ * @param[in] sender The side sending on the ring.
+ *
+ * @return The data of the ring.
+ */
+static uint8_t * getRingData( const ShmRingTransportParams_t * pParams,
+                              ShmRingTransportSide_t sender );
+
+/**
+ * @brief Get the side at the other end of a segment.
+ *
+ * @param[in] side A side.
+ *
+ * @return The other side.
+ */
+static ShmRingTransportSide_t getPeer( ShmRingTransportSide_t side );
+
+/**
+ * @brief Check whether the peer has closed its side.
+ *
+ * @param[in] pParams Parameters of the side.
+ *
+ * @return true if the peer has closed its side.
+ */
+static bool isPeerClosed( const ShmRingTransportParams_t * pParams );
+
+/**
+ * @brief Get the number of free bytes of the transmit ring, reading the head
+ * written by the peer only if fewer than @p bytesWanted are known to be free.
+ *
+ * @param[in] pParams Parameters of the side.
+ * @param[in] tail Tail of the transmit ring.
+ * @param[in] bytesWanted Number of bytes the caller would like to write.
+ *
+ * @return The number of free bytes.
+ */
+static uint32_t getFreeSpace( ShmRingTransportParams_t * pParams,
+                              uint32_t tail,
+                              size_t bytesWanted );
+
+/**
+ * @brief Make the bytes written into the transmit ring visible to the peer,
+ * and wake the peer if it sleeps on the ring.
+ *
+ * @param[in] pParams Parameters of the side.
+ * @param[in] tail New tail of the transmit ring.
+ */
+static void publishTail( const ShmRingTransportParams_t * pParams,
+                         uint32_t tail );
+
+/**
+ * @brief Check whether there is data to receive, or the peer has closed its
+ * side.
+ *
+ * @param[in] pParams Parameters of the side.
+ *
+ * @return true if a receive would not return 0.
+ */
+static bool isReadable( ShmRingTransportParams_t * pParams );
+
+/**
+ * @brief Check whether there is space to send, or the peer has closed its
+ * side.
+ *
+ * @param[in] pParams Parameters of the side.
+ *
+ * @return true if a send would not return 0.
+ */
+static bool isWritable( ShmRingTransportParams_t * pParams );
+
+/**
+ * @brief Wake the threads sleeping on a futex.
+ *
+ * @param[in] pWord The futex.
+ */
+static void wakeFutex( uint32_t * pWord );
+
+/**
+ * @brief Copy buffers into the transmit ring, as far as there is space, and
+ * publish them at once.
+ *
+ * @param[in] pParams Parameters of the side.
+ * @param[in] pIoVec The buffers to send.
+ * @param[in] ioVecCount Number of buffers in @p pIoVec.
+ *
+ * @return The number of bytes sent; 0 if the ring is full; -1 if the peer has
+ * closed its side.
+ */
+static int32_t sendVectors( ShmRingTransportParams_t * pParams,
+                            const TransportOutVector_t * pIoVec,
+                            size_t ioVecCount );
+
+/**
+ * @brief Wait until one of the rings of a side is ready, spinning first and
+ * then sleeping on its futex.
+ *
+ * @param[in] pParams Parameters of the side.
+ * @param[in] event #TRANSPORT_WAIT_READABLE to wait for data on the receive
+ * ring, #TRANSPORT_WAIT_WRITABLE to wait for space on the transmit ring.
+ * @param[in] timeoutMs Time to wait; 0 to only check.
+ *
+ * @return #SHM_RING_TRANSPORT_SUCCESS, #SHM_RING_TRANSPORT_TIMEOUT or
+ * #SHM_RING_TRANSPORT_SYSTEM_ERROR.
+ */
+static ShmRingTransportStatus_t waitForRing( ShmRingTransportParams_t * pParams,
+                                             TransportWaitEvent_t event,
+                                             uint32_t timeoutMs );
+
+/*-----------------------------------------------------------*/
+
+static ShmRingTransportParams_t * getParams( const NetworkContext_t * pNetworkContext )
+{
+    ShmRingTransportParams_t * pParams = NULL;
+
+    if( ( pNetworkContext != NULL ) && ( pNetworkContext->pParams != NULL ) &&
+        ( pNetworkContext->pParams->pSegment != NULL ) )
+    {
+        pParams = pNetworkContext->pParams;
+    }
+
+    return pParams;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool isValidRingSize( uint32_t ringSize )
+{
+    return ( ringSize >= SHM_RING_TRANSPORT_MIN_RING_SIZE ) &&
+           ( ringSize <= SHM_RING_TRANSPORT_MAX_RING_SIZE ) &&
+           ( ( ringSize & ( ringSize - 1U ) ) == 0U );
+}
+
+/*-----------------------------------------------------------*/
+
+static SegmentHeader_t * getHeader( const ShmRingTransportParams_t * pParams )
+{
+    return ( SegmentHeader_t * ) pParams->pSegment;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint8_t * getRingData( const ShmRingTransportParams_t * pParams,
+                              ShmRingTransportSide_t sender )
+{
+    return &pParams->pSegment[ sizeof( SegmentHeader_t ) + ( ( size_t ) sender * pParams->ringSize ) ];
+}
+
+/*-----------------------------------------------------------*/
+
+static ShmRingTransportSide_t getPeer( ShmRingTransportSide_t side )
+{
+    return ( side == SHM_RING_TRANSPORT_CLIENT ) ? SHM_RING_TRANSPORT_SERVER : SHM_RING_TRANSPORT_CLIENT;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool isPeerClosed( const ShmRingTransportParams_t * pParams )
+{
+    return __atomic_load_n( &( getHeader( pParams )->closed[ getPeer( pParams->side ) ] ),
+                            __ATOMIC_ACQUIRE ) != 0U;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint32_t getFreeSpace( ShmRingTransportParams_t * pParams,
+                              uint32_t tail,
+                              size_t bytesWanted )
+{
+    RingControl_t * pRing = &( getHeader( pParams )->rings[ pParams->side ] );
+    uint32_t freeSpace = pParams->ringSize - ( tail - pParams->txHead );
+
+    /* The head is on a cache line written by the peer, so it is only read
+     * when the last value read does not leave enough space. */
+    if( freeSpace < bytesWanted )
+    {
+        pParams->txHead = __atomic_load_n( &( pRing->head ), __ATOMIC_ACQUIRE );
+        freeSpace = pParams->ringSize - ( tail - pParams->txHead );
+    }
+
+    return freeSpace;
+}
+
+/*-----------------------------------------------------------*/
+
+static void publishTail( const ShmRingTransportParams_t * pParams,
+                         uint32_t tail )
+{
+    RingControl_t * pRing = &( getHeader( pParams )->rings[ pParams->side ] );
+
+    __atomic_store_n( &( pRing->tail ), tail, __ATOMIC_RELEASE );
+
+    /* Pairs with the fence of waitForRing: either the peer sees the new tail
+     * before sleeping, or this sees that it sleeps. */
+    __atomic_thread_fence( __ATOMIC_SEQ_CST );
+
+    if( __atomic_load_n( &( pRing->consumerWaiting ), __ATOMIC_RELAXED ) != 0U )
+    {
+        wakeFutex( &( pRing->tail ) );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static bool isReadable( ShmRingTransportParams_t * pParams )
+{
+    RingControl_t * pRing = &( getHeader( pParams )->rings[ getPeer( pParams->side ) ] );
+
+    pParams->rxTail = __atomic_load_n( &( pRing->tail ), __ATOMIC_ACQUIRE );
+
+    return ( pParams->rxTail != __atomic_load_n( &( pRing->head ), __ATOMIC_RELAXED ) ) ||
+           isPeerClosed( pParams );
+}
+
+/*-----------------------------------------------------------*/
+
+static bool isWritable( ShmRingTransportParams_t * pParams )
+{
+    uint32_t tail = __atomic_load_n( &( getHeader( pParams )->rings[ pParams->side ].tail ), __ATOMIC_RELAXED );
+
+    return ( getFreeSpace( pParams, tail, 1U ) > 0U ) || isPeerClosed( pParams );
+}
+
+/*-----------------------------------------------------------*/
+
+static void wakeFutex( uint32_t * pWord )
+{
+    /* The segment may be shared between processes, so the futex is not
+     * private. */
+    if( syscall( SYS_futex, pWord, FUTEX_WAKE, INT_MAX, NULL, NULL, 0 ) < 0 )
+    {
+        LogError( ( "Failed to wake the peer: errno=%d.", errno ) );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static int32_t sendVectors( ShmRingTransportParams_t * pParams,
+                            const TransportOutVector_t * pIoVec,
+                            size_t ioVecCount )
+{
+    int32_t bytesSent = -1;
+    RingControl_t * pRing = &( getHeader( pParams )->rings[ pParams->side ] );
+    uint8_t * pData = getRingData( pParams, pParams->side );
+    uint32_t mask = pParams->ringSize - 1U;
+    uint32_t tail, freeSpace, offset, chunk, length;
+    size_t bytesWanted = 0U, index;
+    const uint8_t * pSource;
+
+    if( isPeerClosed( pParams ) == false )
+    {
+        for( index = 0U; index < ioVecCount; index++ )
+        {
+            bytesWanted += pIoVec[ index ].iov_len;
+        }
+
+        tail = __atomic_load_n( &( pRing->tail ), __ATOMIC_RELAXED );
+        freeSpace = getFreeSpace( pParams, tail, bytesWanted );
+
+        for( index = 0U; ( index < ioVecCount ) && ( freeSpace > 0U ); index++ )
+        {
+            pSource = ( const uint8_t * ) pIoVec[ index ].iov_base;
+            length = ( pIoVec[ index ].iov_len < freeSpace ) ? ( uint32_t ) pIoVec[ index ].iov_len : freeSpace;
+            freeSpace -= length;
+
+            /* Copy up to the end of the ring, then from its start. */
+            while( length > 0U )
+            {
+                offset = tail & mask;
+                chunk = ( length < ( pParams->ringSize - offset ) ) ? length : ( pParams->ringSize - offset );
+                ( void ) memcpy( &pData[ offset ], pSource, chunk );
+                pSource = &pSource[ chunk ];
+                tail += chunk;
+                length -= chunk;
+            }
+        }
+
+        bytesSent = ( int32_t ) ( tail - __atomic_load_n( &( pRing->tail ), __ATOMIC_RELAXED ) );
+
+        if( bytesSent > 0 )
+        {
+            publishTail( pParams, tail );
+        }
+    }
+
+    return bytesSent;
+}
+
+/*-----------------------------------------------------------*/
+
+static ShmRingTransportStatus_t waitForRing( ShmRingTransportParams_t * pParams,
+                                             TransportWaitEvent_t event,
+                                             uint32_t timeoutMs )
+{
+    ShmRingTransportStatus_t status = SHM_RING_TRANSPORT_TIMEOUT;
+    bool writable = ( event == TRANSPORT_WAIT_WRITABLE );
+    RingControl_t * pRing;
+    uint32_t * pFutex, * pWaiting, * pSeen;
+    struct timespec now, deadline, remaining;
+    uint32_t spin;
+    int64_t remainingNs;
+
+    /* A reader sleeps on the tail of the receive ring, a writer on the head
+     * of the transmit ring, each expecting the value it last read. */
+    if( writable == true )
+    {
+        pRing = &( getHeader( pParams )->rings[ pParams->side ] );
+        pFutex = &( pRing->head );
+        pWaiting = &( pRing->producerWaiting );
+        pSeen = &( pParams->txHead );
+    }
+    else
+    {
+        pRing = &( getHeader( pParams )->rings[ getPeer( pParams->side ) ] );
+        pFutex = &( pRing->tail );
+        pWaiting = &( pRing->consumerWaiting );
+        pSeen = &( pParams->rxTail );
+    }
+
+    for( spin = 0U; ( spin <= pParams->spinCount ) && ( status == SHM_RING_TRANSPORT_TIMEOUT ); spin++ )
+    {
+        if( ( ( writable == true ) ? isWritable( pParams ) : isReadable( pParams ) ) == true )
+        {
+            status = SHM_RING_TRANSPORT_SUCCESS;
+        }
+    }
+
+    if( ( status == SHM_RING_TRANSPORT_TIMEOUT ) && ( timeoutMs > 0U ) )
+    {
+        ( void ) clock_gettime( CLOCK_MONOTONIC, &deadline );
+        deadline.tv_sec += ( time_t ) ( timeoutMs / 1000U );
+        deadline.tv_nsec += ( long ) ( timeoutMs % 1000U ) * 1000000L;
+
+        if( deadline.tv_nsec >= NANOSECONDS_PER_SECOND )
+        {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= NANOSECONDS_PER_SECOND;
+        }
+
+        while( status == SHM_RING_TRANSPORT_TIMEOUT )
+        {
+            /* Pairs with the fence of publishTail, or of the receive for a
+             * writer: either the peer sees this side waiting, or this side
+             * sees the index the peer moved. */
+            __atomic_store_n( pWaiting, 1U, __ATOMIC_RELAXED );
+            __atomic_thread_fence( __ATOMIC_SEQ_CST );
+
+            ( void ) clock_gettime( CLOCK_MONOTONIC, &now );
+            remainingNs = ( ( ( int64_t ) deadline.tv_sec - ( int64_t ) now.tv_sec ) * ( int64_t ) NANOSECONDS_PER_SECOND ) +
+                          ( ( int64_t ) deadline.tv_nsec - ( int64_t ) now.tv_nsec );
+
+            if( ( ( writable == true ) ? isWritable( pParams ) : isReadable( pParams ) ) == true )
+            {
+                status = SHM_RING_TRANSPORT_SUCCESS;
+            }
+            else if( remainingNs <= 0 )
+            {
+                break;
+            }
+            else
+            {
+                remaining.tv_sec = ( time_t ) ( remainingNs / ( int64_t ) NANOSECONDS_PER_SECOND );
+                remaining.tv_nsec = ( long ) ( remainingNs % ( int64_t ) NANOSECONDS_PER_SECOND );
+
+                /* The futex only sleeps while the index is still the one seen
+                 * by the check above. */
+                if( ( syscall( SYS_futex, pFutex, FUTEX_WAIT, *pSeen,
+                               &remaining, NULL, 0 ) < 0 ) &&
+                    ( errno != EAGAIN ) && ( errno != EINTR ) && ( errno != ETIMEDOUT ) )
+                {
+                    LogError( ( "Failed to wait for the peer: errno=%d.", errno ) );
+                    status = SHM_RING_TRANSPORT_SYSTEM_ERROR;
+                }
+            }
+        }
+
+        __atomic_store_n( pWaiting, 0U, __ATOMIC_RELAXED );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+size_t ShmRingTransport_SegmentSize( uint32_t ringSize )
+{
+    size_t segmentSize = 0U;
+
+    if( isValidRingSize( ringSize ) == true )
+    {
+        segmentSize = sizeof( SegmentHeader_t ) + ( 2U * ( size_t ) ringSize );
+    }
+
+    return segmentSize;
+}
+
+/*-----------------------------------------------------------*/
+
+ShmRingTransportStatus_t ShmRingTransport_InitSegment( void * pSegment,
+                                                       size_t segmentSize,
+                                                       uint32_t ringSize )
+{
+    ShmRingTransportStatus_t status = SHM_RING_TRANSPORT_SUCCESS;
+    SegmentHeader_t * pHeader = ( SegmentHeader_t * ) pSegment;
+
+    if( ( pSegment == NULL ) ||
+        ( ( ( uintptr_t ) pSegment % SHM_RING_TRANSPORT_CACHE_LINE ) != 0U ) )
+    {
+        LogError( ( "Invalid parameter: pSegment=%p must be aligned to %u bytes.",
+                    pSegment, ( unsigned int ) SHM_RING_TRANSPORT_CACHE_LINE ) );
+        status = SHM_RING_TRANSPORT_INVALID_PARAMETER;
+    }
+    else if( ( ShmRingTransport_SegmentSize( ringSize ) == 0U ) ||
+             ( ShmRingTransport_SegmentSize( ringSize ) > segmentSize ) )
+    {
+        LogError( ( "Invalid parameter: ringSize=%lu does not fit segmentSize=%lu.",
+                    ( unsigned long ) ringSize,
+                    ( unsigned long ) segmentSize ) );
+        status = SHM_RING_TRANSPORT_INVALID_PARAMETER;
+    }
+    else
+    {
+        ( void ) memset( pHeader, 0x00, sizeof( SegmentHeader_t ) );
+        pHeader->ringSize = ringSize;
+
+        /* The magic is written last, so that a side which sees it also sees
+         * the rest of the layout. */
+        __atomic_store_n( &( pHeader->magic ), SHM_RING_TRANSPORT_MAGIC, __ATOMIC_RELEASE );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+ShmRingTransportStatus_t ShmRingTransport_Attach( NetworkContext_t * pNetworkContext,
+                                                  void * pSegment,
+                                                  size_t segmentSize,
+                                                  ShmRingTransportSide_t side )
+{
+    ShmRingTransportStatus_t status = SHM_RING_TRANSPORT_SUCCESS;
+    const SegmentHeader_t * pHeader = ( const SegmentHeader_t * ) pSegment;
+    ShmRingTransportParams_t * pParams;
+    uint32_t ringSize = 0U;
+
+    if( ( pNetworkContext == NULL ) || ( pNetworkContext->pParams == NULL ) ||
+        ( pSegment == NULL ) ||
+        ( ( side != SHM_RING_TRANSPORT_CLIENT ) && ( side != SHM_RING_TRANSPORT_SERVER ) ) )
+    {
+        LogError( ( "Invalid parameter: pNetworkContext=%p, pSegment=%p, side=%d.",
+                    ( void * ) pNetworkContext, pSegment, ( int ) side ) );
+        status = SHM_RING_TRANSPORT_INVALID_PARAMETER;
+    }
+    else if( ( segmentSize < sizeof( SegmentHeader_t ) ) ||
+             ( __atomic_load_n( &( pHeader->magic ), __ATOMIC_ACQUIRE ) != SHM_RING_TRANSPORT_MAGIC ) )
+    {
+        LogError( ( "The memory does not hold a laid out segment." ) );
+        status = SHM_RING_TRANSPORT_INVALID_SEGMENT;
+    }
+    else
+    {
+        ringSize = pHeader->ringSize;
+
+        if( ( ShmRingTransport_SegmentSize( ringSize ) == 0U ) ||
+            ( ShmRingTransport_SegmentSize( ringSize ) > segmentSize ) )
+        {
+            LogError( ( "The segment of %lu bytes cannot hold rings of %lu bytes.",
+                        ( unsigned long ) segmentSize,
+                        ( unsigned long ) ringSize ) );
+            status = SHM_RING_TRANSPORT_INVALID_SEGMENT;
+        }
+    }
+
+    if( status == SHM_RING_TRANSPORT_SUCCESS )
+    {
+        pParams = pNetworkContext->pParams;
+        pParams->pSegment = ( uint8_t * ) pSegment;
+        pParams->segmentSize = segmentSize;
+        pParams->side = side;
+        pParams->ringSize = ringSize;
+        pParams->txHead = __atomic_load_n( &( pHeader->rings[ side ].head ), __ATOMIC_ACQUIRE );
+        pParams->rxTail = __atomic_load_n( &( pHeader->rings[ getPeer( side ) ].tail ), __ATOMIC_ACQUIRE );
+        pParams->spinCount = ( sysconf( _SC_NPROCESSORS_ONLN ) > 1L ) ? SHM_RING_TRANSPORT_SPIN_COUNT : 0U;
+        pParams->mapped = false;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+ShmRingTransportStatus_t ShmRingTransport_Create( NetworkContext_t * pNetworkContext,
+                                                  const char * pName,
+                                                  uint32_t ringSize )
+{
+    ShmRingTransportStatus_t status = SHM_RING_TRANSPORT_SUCCESS;
+    size_t segmentSize = ShmRingTransport_SegmentSize( ringSize );
+    void * pSegment = MAP_FAILED;
+    int fileDescriptor = -1;
+
+    if( ( pNetworkContext == NULL ) || ( pNetworkContext->pParams == NULL ) ||
+        ( pName == NULL ) || ( segmentSize == 0U ) )
+    {
+        LogError( ( "Invalid parameter: pNetworkContext=%p, pName=%p, ringSize=%lu.",
+                    ( void * ) pNetworkContext,
+                    ( const void * ) pName,
+                    ( unsigned long ) ringSize ) );
+        status = SHM_RING_TRANSPORT_INVALID_PARAMETER;
+    }
+    else
+    {
+        fileDescriptor = shm_open( pName, O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR );
+
+        if( fileDescriptor < 0 )
+        {
+            LogError( ( "Failed to create the segment %s: errno=%d.", pName, errno ) );
+            status = SHM_RING_TRANSPORT_SYSTEM_ERROR;
+        }
+    }
+
+    if( status == SHM_RING_TRANSPORT_SUCCESS )
+    {
+        if( ftruncate( fileDescriptor, ( off_t ) segmentSize ) == 0 )
+        {
+            pSegment = mmap( NULL, segmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor, 0 );
+        }
+
+        /* The mapping keeps the segment alive. */
+        ( void ) close( fileDescriptor );
+
+        if( pSegment == MAP_FAILED )
+        {
+            LogError( ( "Failed to map the segment %s: errno=%d.", pName, errno ) );
+            ( void ) shm_unlink( pName );
+            status = SHM_RING_TRANSPORT_SYSTEM_ERROR;
+        }
+    }
+
+    if( status == SHM_RING_TRANSPORT_SUCCESS )
+    {
+        /* The mapping is page aligned and large enough, so neither can fail. */
+        ( void ) ShmRingTransport_InitSegment( pSegment, segmentSize, ringSize );
+        ( void ) ShmRingTransport_Attach( pNetworkContext, pSegment, segmentSize, SHM_RING_TRANSPORT_SERVER );
+        pNetworkContext->pParams->mapped = true;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+ShmRingTransportStatus_t ShmRingTransport_Open( NetworkContext_t * pNetworkContext,
+                                                const char * pName )
+{
+    ShmRingTransportStatus_t status = SHM_RING_TRANSPORT_SUCCESS;
+    void * pSegment = MAP_FAILED;
+    struct stat segmentStat;
+    int fileDescriptor = -1;
+
+    if( ( pNetworkContext == NULL ) || ( pNetworkContext->pParams == NULL ) || ( pName == NULL ) )
+    {
+        LogError( ( "Invalid parameter: pNetworkContext=%p, pName=%p.",
+                    ( void * ) pNetworkContext,
+                    ( const void * ) pName ) );
+        status = SHM_RING_TRANSPORT_INVALID_PARAMETER;
+    }
+    else
+    {
+        fileDescriptor = shm_open( pName, O_RDWR, 0 );
+
+        if( fileDescriptor < 0 )
+        {
+            LogError( ( "Failed to open the segment %s: errno=%d.", pName, errno ) );
+            status = SHM_RING_TRANSPORT_SYSTEM_ERROR;
+        }
+    }
+
+    if( status == SHM_RING_TRANSPORT_SUCCESS )
+    {
+        if( ( fstat( fileDescriptor, &segmentStat ) == 0 ) && ( segmentStat.st_size > 0 ) )
+        {
+            pSegment = mmap( NULL, ( size_t ) segmentStat.st_size, PROT_READ | PROT_WRITE,
+                             MAP_SHARED, fileDescriptor, 0 );
+        }
+
+        ( void ) close( fileDescriptor );
+
+        if( pSegment == MAP_FAILED )
+        {
+            LogError( ( "Failed to map the segment %s: errno=%d.", pName, errno ) );
+            status = SHM_RING_TRANSPORT_SYSTEM_ERROR;
+        }
+    }
+
+    if( status == SHM_RING_TRANSPORT_SUCCESS )
+    {
+        status = ShmRingTransport_Attach( pNetworkContext, pSegment,
+                                          ( size_t ) segmentStat.st_size,
+                                          SHM_RING_TRANSPORT_CLIENT );
+
+        if( status == SHM_RING_TRANSPORT_SUCCESS )
+        {
+            pNetworkContext->pParams->mapped = true;
+        }
+        else
+        {
+            ( void ) munmap( pSegment, ( size_t ) segmentStat.st_size );
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+ShmRingTransportStatus_t ShmRingTransport_Disconnect( NetworkContext_t * pNetworkContext )
+{
+    ShmRingTransportStatus_t status = SHM_RING_TRANSPORT_SUCCESS;
+    ShmRingTransportParams_t * pParams = getParams( pNetworkContext );
+    SegmentHeader_t * pHeader;
+
+    if( pParams == NULL )
+    {
+        LogError( ( "Invalid parameter: the network context is not attached." ) );
+        status = SHM_RING_TRANSPORT_INVALID_PARAMETER;
+    }
+    else
+    {
+        pHeader = getHeader( pParams );
+
+        /* The peer may sleep on either ring, so it is woken to see the close.
+         * This is rare, so the wakes are not made conditional. */
+        __atomic_store_n( &( pHeader->closed[ pParams->side ] ), 1U, __ATOMIC_RELEASE );
+        wakeFutex( &( pHeader->rings[ pParams->side ].tail ) );
+        wakeFutex( &( pHeader->rings[ getPeer( pParams->side ) ].head ) );
+
+        if( pParams->mapped == true )
+        {
+            ( void ) munmap( pParams->pSegment, pParams->segmentSize );
+        }
+
+        pParams->pSegment = NULL;
+        pParams->segmentSize = 0U;
+        pParams->mapped = false;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+ShmRingTransportStatus_t ShmRingTransport_Wait( NetworkContext_t * pNetworkContext,
+                                                uint32_t timeoutMs )
+{
+    ShmRingTransportStatus_t status = SHM_RING_TRANSPORT_INVALID_PARAMETER;
+    ShmRingTransportParams_t * pParams = getParams( pNetworkContext );
+
+    if( pParams == NULL )
+    {
+        LogError( ( "Invalid parameter: the network context is not attached." ) );
+    }
+    else
+    {
+        status = waitForRing( pParams, TRANSPORT_WAIT_READABLE, timeoutMs );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+int32_t ShmRingTransport_WaitEvent( NetworkContext_t * pNetworkContext,
+                                    TransportWaitEvent_t event,
+                                    uint32_t timeoutMs )
+{
+    int32_t waitResult = -1;
+    ShmRingTransportParams_t * pParams = getParams( pNetworkContext );
+    ShmRingTransportStatus_t status;
+
+    if( pParams == NULL )
+    {
+        LogError( ( "Invalid parameter: the network context is not attached." ) );
+    }
+    else
+    {
+        status = waitForRing( pParams, event, timeoutMs );
+
+        if( status == SHM_RING_TRANSPORT_SUCCESS )
+        {
+            waitResult = 1;
+        }
+        else if( status == SHM_RING_TRANSPORT_TIMEOUT )
+        {
+            waitResult = 0;
+        }
+        else
+        {
+            /* Empty else MISRA 15.7 */
+        }
+    }
+
+    return waitResult;
+}
+
+/*-----------------------------------------------------------*/
+
+int32_t ShmRingTransport_Recv( NetworkContext_t * pNetworkContext,
+                               void * pBuffer,
+                               size_t bytesToRecv )
+{
+    int32_t bytesReceived = -1;
+    ShmRingTransportParams_t * pParams = getParams( pNetworkContext );
+    RingControl_t * pRing;
+    const uint8_t * pData;
+    uint8_t * pDestination = ( uint8_t * ) pBuffer;
+    uint32_t mask, head, available, offset, chunk, copied = 0U;
+
+    if( ( pParams == NULL ) || ( pBuffer == NULL ) )
+    {
+        LogError( ( "Invalid parameter: pParams=%p, pBuffer=%p.",
+                    ( void * ) pParams, pBuffer ) );
+    }
+    else
+    {
+        pRing = &( getHeader( pParams )->rings[ getPeer( pParams->side ) ] );
+        pData = getRingData( pParams, getPeer( pParams->side ) );
+        mask = pParams->ringSize - 1U;
+        head = __atomic_load_n( &( pRing->head ), __ATOMIC_RELAXED );
+
+        /* The tail is on a cache line written by the peer, so it is only read
+         * once the data seen before has been received. */
+        if( pParams->rxTail == head )
+        {
+            pParams->rxTail = __atomic_load_n( &( pRing->tail ), __ATOMIC_ACQUIRE );
+        }
+
+        available = pParams->rxTail - head;
+
+        if( ( available == 0U ) && ( isPeerClosed( pParams ) == true ) )
+        {
+            /* The peer sent everything before closing, so the tail is read
+             * again to receive what it sent last. */
+            pParams->rxTail = __atomic_load_n( &( pRing->tail ), __ATOMIC_ACQUIRE );
+            available = pParams->rxTail - head;
+        }
+
+        if( available > 0U )
+        {
+            if( bytesToRecv < available )
+            {
+                available = ( uint32_t ) bytesToRecv;
+            }
+
+            while( copied < available )
+            {
+                offset = head & mask;
+                chunk = ( ( available - copied ) < ( pParams->ringSize - offset ) ) ?
+                        ( available - copied ) : ( pParams->ringSize - offset );
+                ( void ) memcpy( &pDestination[ copied ], &pData[ offset ], chunk );
+                head += chunk;
+                copied += chunk;
+            }
+
+            __atomic_store_n( &( pRing->head ), head, __ATOMIC_RELEASE );
+
+            /* Pairs with the fence of waitForRing: either the peer sees the
+             * new head before sleeping, or this sees that it sleeps. */
+            __atomic_thread_fence( __ATOMIC_SEQ_CST );
+
+            if( __atomic_load_n( &( pRing->producerWaiting ), __ATOMIC_RELAXED ) != 0U )
+            {
+                wakeFutex( &( pRing->head ) );
+            }
+
+            bytesReceived = ( int32_t ) copied;
+        }
+        else if( isPeerClosed( pParams ) == false )
+        {
+            bytesReceived = 0;
+        }
+        else
+        {
+            LogDebug( ( "The peer has closed its side." ) );
+        }
+    }
+
+    return bytesReceived;
+}
+
+/*-----------------------------------------------------------*/
+
+int32_t ShmRingTransport_Send( NetworkContext_t * pNetworkContext,
+                               const void * pBuffer,
+                               size_t bytesToSend )
+{
+    int32_t bytesSent = -1;
+    ShmRingTransportParams_t * pParams = getParams( pNetworkContext );
+    TransportOutVector_t vector;
+
+    if( ( pParams == NULL ) || ( pBuffer == NULL ) )
+    {
+        LogError( ( "Invalid parameter: pParams=%p, pBuffer=%p.",
+                    ( void * ) pParams, pBuffer ) );
+    }
+    else
+    {
+        vector.iov_base = pBuffer;
+        vector.iov_len = bytesToSend;
+        bytesSent = sendVectors( pParams, &vector, 1U );
+    }
+
+    return bytesSent;
+}
+
+/*-----------------------------------------------------------*/
+
+int32_t ShmRingTransport_Writev( NetworkContext_t * pNetworkContext,
+                                 TransportOutVector_t * pIoVec,
+                                 size_t ioVecCount )
+{
+    int32_t bytesSent = -1;
+    ShmRingTransportParams_t * pParams = getParams( pNetworkContext );
+
+    if( ( pParams == NULL ) || ( pIoVec == NULL ) )
+    {
+        LogError( ( "Invalid parameter: pParams=%p, pIoVec=%p.",
+                    ( void * ) pParams, ( void * ) pIoVec ) );
+    }
+    else
+    {
+        bytesSent = sendVectors( pParams, pIoVec, ioVecCount );
+    }
+
+    return bytesSent;
+}
+
+/*-----------------------------------------------------------*/
+
+void * ShmRingTransport_GetTxBuffer( NetworkContext_t * pNetworkContext,
+                                     size_t bytesToWrite )
+{
+    void * pTxBuffer = NULL;
+    ShmRingTransportParams_t * pParams = getParams( pNetworkContext );
+    uint32_t tail, offset;
+
+    if( ( pParams != NULL ) && ( isPeerClosed( pParams ) == false ) )
+    {
+        tail = __atomic_load_n( &( getHeader( pParams )->rings[ pParams->side ].tail ), __ATOMIC_RELAXED );
+        offset = tail & ( pParams->ringSize - 1U );
+
+        if( ( bytesToWrite <= ( size_t ) ( pParams->ringSize - offset ) ) &&
+            ( bytesToWrite <= getFreeSpace( pParams, tail, bytesToWrite ) ) )
+        {
+            pTxBuffer = &( getRingData( pParams, pParams->side )[ offset ] );
+        }
+    }
+
+    return pTxBuffer;
+}
+
+/*-----------------------------------------------------------*/
+
+int32_t ShmRingTransport_CommitTxBuffer( NetworkContext_t * pNetworkContext,
+                                         void * pBuffer,
+                                         size_t bytesToSend )
+{
+    int32_t bytesSent = -1;
+    ShmRingTransportParams_t * pParams = getParams( pNetworkContext );
+    uint32_t tail, offset;
+
+    if( pParams != NULL )
+    {
+        tail = __atomic_load_n( &( getHeader( pParams )->rings[ pParams->side ].tail ), __ATOMIC_RELAXED );
+        offset = tail & ( pParams->ringSize - 1U );
+
+        if( ( pBuffer != &( getRingData( pParams, pParams->side )[ offset ] ) ) ||
+            ( bytesToSend > ( size_t ) ( pParams->ringSize - offset ) ) )
+        {
+            LogError( ( "Invalid parameter: pBuffer=%p is not the lent buffer.", pBuffer ) );
+        }
+        else if( isPeerClosed( pParams ) == true )
+        {
+            LogDebug( ( "The peer has closed its side." ) );
+        }
+        else
+        {
+            if( bytesToSend > 0U )
+            {
+                publishTail( pParams, tail + ( uint32_t ) bytesToSend );
+            }
+
+            bytesSent = ( int32_t ) bytesToSend;
+        }
+    }
+
+    return bytesSent;
+}
+
+/*-----------------------------------------------------------*/
@@ -0,0 +1,366 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file shm_ring_transport.h
+ * @brief Reference implementation of the transport interface over a pair of
+ * ring buffers in shared memory, for processes on the same Linux host.
+ *
+ * A segment holds one single-producer, single-consumer ring for each
+ * direction. The server side, typically a local broker, creates the segment
+ * and the client side opens it; both may also attach to memory they mapped
+ * themselves, such as an anonymous shared mapping inherited through `fork`.
+ *
+ * Sending and receiving only read and write the rings, so that traffic
+ * between the two sides makes no system call while both are busy. A side
+ * with nothing to receive can sleep in #ShmRingTransport_Wait, on a futex of
+ * the ring, and a side with a full ring in #ShmRingTransport_WaitEvent; the
+ * other side only wakes it, with a system call, when it marked itself as
+ * sleeping.
+ *
+ * Each side must be used from a single thread at a time.
+ *
+ * Every compilation unit which uses this transport must define
+ * `struct NetworkContext` with a `pParams` member pointing to a
+ * #ShmRingTransportParams_t:
+ *
+ * @code{c}
+ * struct NetworkContext
+ * {
+ *     ShmRingTransportParams_t * pParams;
+ * };
+ * @endcode
+ */
+
+#ifndef SHM_RING_TRANSPORT_H_
+#define SHM_RING_TRANSPORT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    extern "C" {
+#endif
+/* *INDENT-ON* */
+
+/* Include transport interface. */
+#include "transport_interface.h"
+
+/**
+ * @brief Number of times #ShmRingTransport_Wait and
+ * #ShmRingTransport_WaitEvent check a ring before sleeping on its futex.
+ *
+ * Spinning briefly keeps the latency of a busy exchange low, as the peer
+ * usually answers before a sleep would pay off. On a host with a single online
+ * CPU, the peer cannot answer while this side spins, so the transport sleeps
+ * at once.
+ */
+#ifndef SHM_RING_TRANSPORT_SPIN_COUNT
+    #define SHM_RING_TRANSPORT_SPIN_COUNT    ( 1000U )
+#endif
+
+/**
+ * @brief Return codes of the segment and connection management functions of
+ * the transport.
+ */
+typedef enum ShmRingTransportStatus
+{
+    SHM_RING_TRANSPORT_SUCCESS = 0,       /**< @brief Function successfully completed. */
+    SHM_RING_TRANSPORT_INVALID_PARAMETER, /**< @brief At least one parameter was invalid. */
+    SHM_RING_TRANSPORT_INVALID_SEGMENT,   /**< @brief The memory does not hold a segment of the transport. */
+    SHM_RING_TRANSPORT_SYSTEM_ERROR,      /**< @brief A shared memory or futex system call failed. */
+    SHM_RING_TRANSPORT_TIMEOUT            /**< @brief Nothing was received in time. */
+} ShmRingTransportStatus_t;
+
+/**
+ * @brief The two sides of a segment. Each side sends on the ring the other
+ * side receives from.
+ */
+typedef enum ShmRingTransportSide
+{
+    SHM_RING_TRANSPORT_CLIENT = 0, /**< @brief The side which opens the segment. */
+    SHM_RING_TRANSPORT_SERVER = 1  /**< @brief The side which creates the segment. */
+} ShmRingTransportSide_t;
+
+/**
+ * @brief Parameters of one side of a segment, referenced by the `pParams`
+ * member of `struct NetworkContext`.
+ *
+ * @note The members of this struct are managed by the transport and must not
+ * be accessed by the application.
+ */
+typedef struct ShmRingTransportParams
+{
+    uint8_t * pSegment;           /**< @brief The segment, or NULL if not attached. */
+    size_t segmentSize;           /**< @brief Size of the segment. */
+    ShmRingTransportSide_t side;  /**< @brief The side of the segment this end uses. */
+    uint32_t ringSize;            /**< @brief Size of each ring, a power of 2. */
+    uint32_t txHead;              /**< @brief Head of the transmit ring, as last read from the peer. */
+    uint32_t rxTail;              /**< @brief Tail of the receive ring, as last read from the peer. */
+    uint32_t spinCount;           /**< @brief Number of checks before sleeping, 0 on a single CPU. */
+    bool mapped;                  /**< @brief Whether the transport mapped the segment, and unmaps it. */
+} ShmRingTransportParams_t;
+
+/**
+ * @brief Get the size of a segment holding two rings of a given size.
+ *
+ * @param[in] ringSize Size of each ring, a power of 2 of at least 64 bytes.
+ *
+ * @return The size of the segment, or 0 if @p ringSize is not valid.
+ */
+/* @[declare_shmringtransport_segmentsize] */
+size_t ShmRingTransport_SegmentSize( uint32_t ringSize );
+/* @[declare_shmringtransport_segmentsize] */
+
+/**
+ * @brief Lay out an empty segment in memory which both sides can map.
+ *
+ * @param[in] pSegment The memory, aligned to 64 bytes.
+ * @param[in] segmentSize Size of @p pSegment, at least
+ * #ShmRingTransport_SegmentSize of @p ringSize.
+ * @param[in] ringSize Size of each ring, a power of 2 of at least 64 bytes.
+ *
+ * @return #SHM_RING_TRANSPORT_SUCCESS or #SHM_RING_TRANSPORT_INVALID_PARAMETER.
+ */
+/* @[declare_shmringtransport_initsegment] */
+ShmRingTransportStatus_t ShmRingTransport_InitSegment( void * pSegment,
+                                                       size_t segmentSize,
+                                                       uint32_t ringSize );
+/* @[declare_shmringtransport_initsegment] */
+
+/**
+ * @brief Use one side of a segment laid out by #ShmRingTransport_InitSegment.
+ *
+ * @param[in] pNetworkContext Network context whose parameters receive the
+ * segment.
+ * @param[in] pSegment The segment, which must remain mapped until
+ * #ShmRingTransport_Disconnect is called.
+ * @param[in] segmentSize Size of @p pSegment.
+ * @param[in] side The side to use.
+ *
+ * @return #SHM_RING_TRANSPORT_SUCCESS, #SHM_RING_TRANSPORT_INVALID_PARAMETER or
+ * #SHM_RING_TRANSPORT_INVALID_SEGMENT.
+ */
+/* @[declare_shmringtransport_attach] */
+ShmRingTransportStatus_t ShmRingTransport_Attach( NetworkContext_t * pNetworkContext,
+                                                  void * pSegment,
+                                                  size_t segmentSize,
+                                                  ShmRingTransportSide_t side );
+/* @[declare_shmringtransport_attach] */
+
+/**
+ * @brief Create a named POSIX shared memory segment, lay it out, and use its
+ * server side.
+ *
+ * The name is left for the client to open; the application removes it with
+ * `shm_unlink` once the client has opened it, or when it is no longer needed.
+ *
+ * @param[in] pNetworkContext Network context whose parameters receive the
+ * segment.
+ * @param[in] pName Name of the segment, as given to `shm_open`. It must not
+ * exist yet.
+ * @param[in] ringSize Size of each ring, a power of 2 of at least 64 bytes.
+ *
+ * @return #SHM_RING_TRANSPORT_SUCCESS, #SHM_RING_TRANSPORT_INVALID_PARAMETER or
+ * #SHM_RING_TRANSPORT_SYSTEM_ERROR.
+ */
+/* @[declare_shmringtransport_create] */
+ShmRingTransportStatus_t ShmRingTransport_Create( NetworkContext_t * pNetworkContext,
+                                                  const char * pName,
+                                                  uint32_t ringSize );
+/* @[declare_shmringtransport_create] */
+
+/**
+ * @brief Open a named segment created by #ShmRingTransport_Create, and use its
+ * client side.
+ *
+ * @param[in] pNetworkContext Network context whose parameters receive the
+ * segment.
+ * @param[in] pName Name of the segment, as given to `shm_open`.
+ *
+ * @return #SHM_RING_TRANSPORT_SUCCESS, #SHM_RING_TRANSPORT_INVALID_PARAMETER,
+ * #SHM_RING_TRANSPORT_INVALID_SEGMENT or #SHM_RING_TRANSPORT_SYSTEM_ERROR.
+ */
+/* @[declare_shmringtransport_open] */
+ShmRingTransportStatus_t ShmRingTransport_Open( NetworkContext_t * pNetworkContext,
+                                                const char * pName );
+/* @[declare_shmringtransport_open] */
+
+/**
+ * @brief Close this side of the segment, so that the peer receives an error
+ * once it has received everything sent before, and unmap the segment if it
+ * was mapped by the transport.
+ *
+ * @param[in] pNetworkContext Network context of the connection.
+ *
+ * @return #SHM_RING_TRANSPORT_SUCCESS or #SHM_RING_TRANSPORT_INVALID_PARAMETER.
+ */
+/* @[declare_shmringtransport_disconnect] */
+ShmRingTransportStatus_t ShmRingTransport_Disconnect( NetworkContext_t * pNetworkContext );
+/* @[declare_shmringtransport_disconnect] */
+
+/**
+ * @brief Wait until there is data to receive, or the peer has closed its
+ * side.
+ *
+ * The receive ring is checked #SHM_RING_TRANSPORT_SPIN_COUNT times, if the
+ * host has more than one online CPU, before the calling thread sleeps on its
+ * futex.
+ *
+ * @param[in] pNetworkContext Network context of the connection.
+ * @param[in] timeoutMs Time to wait; 0 to only check.
+ *
+ * @return #SHM_RING_TRANSPORT_SUCCESS if there is data to receive or the peer
+ * has closed its side; #SHM_RING_TRANSPORT_TIMEOUT,
+ * #SHM_RING_TRANSPORT_INVALID_PARAMETER or #SHM_RING_TRANSPORT_SYSTEM_ERROR
+ * otherwise.
+ */
+/* @[declare_shmringtransport_wait] */
+ShmRingTransportStatus_t ShmRingTransport_Wait( NetworkContext_t * pNetworkContext,
+                                                uint32_t timeoutMs );
+/* @[declare_shmringtransport_wait] */
+
+/**
+ * @brief Wait until there is data to receive or space to send, or the peer
+ * has closed its side.
+ *
+ * Implements #TransportWait_t. A side waiting for space sleeps on the futex
+ * of the head of its transmit ring, and the peer wakes it when it receives.
+ *
+ * @param[in] pNetworkContext Network context of the connection.
+ * @param[in] event Whether to wait for data to receive or space to send.
+ * @param[in] timeoutMs Time to wait; 0 to only check.
+ *
+ * @return 1 if the ring is ready or the peer has closed its side; 0 if the
+ * timeout expired; a negative value if the network context is not attached or
+ * the futex system call failed.
+ */
+/* @[declare_shmringtransport_waitevent] */
+int32_t ShmRingTransport_WaitEvent( NetworkContext_t * pNetworkContext,
+                                    TransportWaitEvent_t event,
+                                    uint32_t timeoutMs );
+/* @[declare_shmringtransport_waitevent] */
+
+/**
+ * @brief Copy data from the receive ring.
+ *
+ * Implements #TransportRecv_t.
+ *
+ * @param[in] pNetworkContext Network context of the connection.
+ * @param[out] pBuffer Buffer to receive the data into.
+ * @param[in] bytesToRecv Size of @p pBuffer.
+ *
+ * @return The number of bytes received; 0 if no data is available; a negative
+ * value if the peer has closed its side and all its data was received.
+ */
+/* @[declare_shmringtransport_recv] */
+int32_t ShmRingTransport_Recv( NetworkContext_t * pNetworkContext,
+                               void * pBuffer,
+                               size_t bytesToRecv );
+/* @[declare_shmringtransport_recv] */
+
+/**
+ * @brief Copy data into the transmit ring.
+ *
+ * Implements #TransportSend_t.
+ *
+ * @param[in] pNetworkContext Network context of the connection.
+ * @param[in] pBuffer Data to send.
+ * @param[in] bytesToSend Number of bytes in @p pBuffer.
+ *
+ * @return The number of bytes sent; 0 if the ring is full; a negative value if
+ * the peer has closed its side.
+ */
+/* @[declare_shmringtransport_send] */
+int32_t ShmRingTransport_Send( NetworkContext_t * pNetworkContext,
+                               const void * pBuffer,
+                               size_t bytesToSend );
+/* @[declare_shmringtransport_send] */
+
+/**
+ * @brief Copy a list of buffers into the transmit ring, and make them visible
+ * to the peer at once.
+ *
+ * Implements #TransportWritev_t.
+ *
+ * @param[in] pNetworkContext Network context of the connection.
+ * @param[in] pIoVec The buffers to send.
+ * @param[in] ioVecCount Number of buffers in @p pIoVec.
+ *
+ * @return The number of bytes sent; 0 if the ring is full; a negative value if
+ * the peer has closed its side.
+ */
+/* @[declare_shmringtransport_writev] */
+int32_t ShmRingTransport_Writev( NetworkContext_t * pNetworkContext,
+                                 TransportOutVector_t * pIoVec,
+                                 size_t ioVecCount );
+/* @[declare_shmringtransport_writev] */
+
+/**
+ * @brief Lend the free space of the transmit ring, so that a packet is
+ * written straight into the ring.
+ *
+ * Implements #TransportGetTxBuffer_t. Only contiguous space is lent: a packet
+ * which would wrap around the end of the ring is sent with
+ * #ShmRingTransport_Send or #ShmRingTransport_Writev instead.
+ *
+ * @param[in] pNetworkContext Network context of the connection.
+ * @param[in] bytesToWrite Number of bytes the buffer must hold.
+ *
+ * @return The free space of the ring, or NULL if it has fewer than
+ * @p bytesToWrite contiguous bytes free or the peer has closed its side.
+ */
+/* @[declare_shmringtransport_gettxbuffer] */
+void * ShmRingTransport_GetTxBuffer( NetworkContext_t * pNetworkContext,
+                                     size_t bytesToWrite );
+/* @[declare_shmringtransport_gettxbuffer] */
+
+/**
+ * @brief Make the bytes written into a buffer lent by
+ * #ShmRingTransport_GetTxBuffer visible to the peer.
+ *
+ * Implements #TransportCommitTxBuffer_t.
+ *
+ * @param[in] pNetworkContext Network context of the connection.
+ * @param[in] pBuffer The lent buffer.
+ * @param[in] bytesToSend Number of bytes written at the start of @p pBuffer.
+ *
+ * @return @p bytesToSend, or a negative value if @p pBuffer is not the lent
+ * buffer or the peer has closed its side.
+ */
+/* @[declare_shmringtransport_committxbuffer] */
+int32_t ShmRingTransport_CommitTxBuffer( NetworkContext_t * pNetworkContext,
+                                         void * pBuffer,
+                                         size_t bytesToSend );
+/* @[declare_shmringtransport_committxbuffer] */
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    }
+#endif
+/* *INDENT-ON* */
+
+#endif /* ifndef SHM_RING_TRANSPORT_H_ */
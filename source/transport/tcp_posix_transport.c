@@ -0,0 +1,620 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file tcp_posix_transport.c
+ * @brief Implements the transport interface over a non-blocking POSIX TCP
+ * socket.
+ */
+
+/* getaddrinfo, MSG_NOSIGNAL and sendmsg require POSIX.1-2008. */
+#ifndef _POSIX_C_SOURCE
+    #define _POSIX_C_SOURCE    200809L
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "tcp_posix_transport.h"
+
+/* Include config defaults header to get default values of configs. */
+#include "core_mqtt_config_defaults.h"
+
+/**
+ * @brief Each compilation unit that uses the transport must define the
+ * NetworkContext struct.
+ */
+struct NetworkContext
+{
+    TcpPosixTransportParams_t * pParams;
+};
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Get the socket of a network context.
+ *
+ * @param[in] pNetworkContext Network context of the connection.
+ *
+ * @return The socket, or -1 if the network context is not connected.
+ */
+static int getSocket( const NetworkContext_t * pNetworkContext );
+
+/**
+ * @brief Put a socket into non-blocking mode and disable Nagle's algorithm.
+ *
+ * @param[in] socketDescriptor The socket to configure.
+ *
+ * @return #TCP_POSIX_TRANSPORT_SUCCESS or #TCP_POSIX_TRANSPORT_SOCKET_ERROR.
+ */
+static TcpPosixTransportStatus_t configureSocket( int socketDescriptor );
+
+/**
+ * @brief Wait for a non-blocking connect to complete.
+ *
+ * @param[in] socketDescriptor The connecting socket.
+ * @param[in] connectTimeoutMs Time to wait for the connection.
+ *
+ * @return #TCP_POSIX_TRANSPORT_SUCCESS or #TCP_POSIX_TRANSPORT_CONNECT_FAILURE.
+ */
+static TcpPosixTransportStatus_t waitForConnect( int socketDescriptor,
+                                                 uint32_t connectTimeoutMs );
+
+/**
+ * @brief Connect a new non-blocking socket to one resolved address.
+ *
+ * @param[in] pAddress The address to connect to.
+ * @param[in] connectTimeoutMs Time to wait for the connection.
+ * @param[out] pSocketDescriptor The connected socket.
+ *
+ * @return #TCP_POSIX_TRANSPORT_SUCCESS, #TCP_POSIX_TRANSPORT_CONNECT_FAILURE or
+ * #TCP_POSIX_TRANSPORT_SOCKET_ERROR.
+ */
+static TcpPosixTransportStatus_t connectToAddress( const struct addrinfo * pAddress,
+                                                   uint32_t connectTimeoutMs,
+                                                   int * pSocketDescriptor );
+
+/**
+ * @brief Convert the result of a send or receive system call to the return
+ * value expected by the transport interface.
+ *
+ * @param[in] result The value returned by the system call.
+ *
+ * @return @p result if data was transferred; 0 if the call would have blocked
+ * or was interrupted; -1 otherwise.
+ */
+static int32_t toTransportResult( ssize_t result );
+
+/*-----------------------------------------------------------*/
+
+static int getSocket( const NetworkContext_t * pNetworkContext )
+{
+    int socketDescriptor = -1;
+
+    if( ( pNetworkContext != NULL ) && ( pNetworkContext->pParams != NULL ) )
+    {
+        socketDescriptor = pNetworkContext->pParams->socketDescriptor;
+    }
+
+    return socketDescriptor;
+}
+
+/*-----------------------------------------------------------*/
+
+static TcpPosixTransportStatus_t configureSocket( int socketDescriptor )
+{
+    TcpPosixTransportStatus_t status = TCP_POSIX_TRANSPORT_SUCCESS;
+    int flags;
+    int noDelay = 1;
+
+    flags = fcntl( socketDescriptor, F_GETFL, 0 );
+
+    if( ( flags < 0 ) || ( fcntl( socketDescriptor, F_SETFL, flags | O_NONBLOCK ) < 0 ) )
+    {
+        LogError( ( "Failed to make socket %d non-blocking: errno=%d.",
+                    socketDescriptor, errno ) );
+        status = TCP_POSIX_TRANSPORT_SOCKET_ERROR;
+    }
+    else if( setsockopt( socketDescriptor, IPPROTO_TCP, TCP_NODELAY,
+                         &noDelay, ( socklen_t ) sizeof( noDelay ) ) < 0 )
+    {
+        LogError( ( "Failed to set TCP_NODELAY on socket %d: errno=%d.",
+                    socketDescriptor, errno ) );
+        status = TCP_POSIX_TRANSPORT_SOCKET_ERROR;
+    }
+    else
+    {
+        /* MISRA else */
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static TcpPosixTransportStatus_t waitForConnect( int socketDescriptor,
+                                                 uint32_t connectTimeoutMs )
+{
+    TcpPosixTransportStatus_t status = TCP_POSIX_TRANSPORT_SUCCESS;
+    struct pollfd pollDescriptor;
+    int socketError = 0;
+    socklen_t socketErrorLength = ( socklen_t ) sizeof( socketError );
+    int pollResult;
+    int timeoutMs = ( connectTimeoutMs > ( uint32_t ) INT_MAX ) ? INT_MAX : ( int ) connectTimeoutMs;
+
+    pollDescriptor.fd = socketDescriptor;
+    pollDescriptor.events = POLLOUT;
+    pollDescriptor.revents = 0;
+
+    do
+    {
+        pollResult = poll( &pollDescriptor, 1U, timeoutMs );
+    } while( ( pollResult < 0 ) && ( errno == EINTR ) );
+
+    if( pollResult <= 0 )
+    {
+        LogError( ( "Timed out or failed waiting for connection: pollResult=%d.",
+                    pollResult ) );
+        status = TCP_POSIX_TRANSPORT_CONNECT_FAILURE;
+    }
+    else if( ( getsockopt( socketDescriptor, SOL_SOCKET, SO_ERROR,
+                           &socketError, &socketErrorLength ) < 0 ) ||
+             ( socketError != 0 ) )
+    {
+        LogError( ( "Connection failed: error=%d.", socketError ) );
+        status = TCP_POSIX_TRANSPORT_CONNECT_FAILURE;
+    }
+    else
+    {
+        /* MISRA else */
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static TcpPosixTransportStatus_t connectToAddress( const struct addrinfo * pAddress,
+                                                   uint32_t connectTimeoutMs,
+                                                   int * pSocketDescriptor )
+{
+    TcpPosixTransportStatus_t status;
+    int socketDescriptor;
+
+    socketDescriptor = socket( pAddress->ai_family, pAddress->ai_socktype, pAddress->ai_protocol );
+
+    if( socketDescriptor < 0 )
+    {
+        LogError( ( "Failed to create socket: errno=%d.", errno ) );
+        status = TCP_POSIX_TRANSPORT_SOCKET_ERROR;
+    }
+    else
+    {
+        status = configureSocket( socketDescriptor );
+    }
+
+    if( status == TCP_POSIX_TRANSPORT_SUCCESS )
+    {
+        if( connect( socketDescriptor, pAddress->ai_addr, pAddress->ai_addrlen ) == 0 )
+        {
+            /* Connected immediately, as may happen over loopback. */
+        }
+        else if( errno == EINPROGRESS )
+        {
+            status = waitForConnect( socketDescriptor, connectTimeoutMs );
+        }
+        else
+        {
+            LogError( ( "Failed to connect: errno=%d.", errno ) );
+            status = TCP_POSIX_TRANSPORT_CONNECT_FAILURE;
+        }
+    }
+
+    if( status == TCP_POSIX_TRANSPORT_SUCCESS )
+    {
+        *pSocketDescriptor = socketDescriptor;
+    }
+    else if( socketDescriptor >= 0 )
+    {
+        ( void ) close( socketDescriptor );
+    }
+    else
+    {
+        /* MISRA else */
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static int32_t toTransportResult( ssize_t result )
+{
+    int32_t transportResult;
+
+    if( result >= 0 )
+    {
+        /* The interface returns int32_t, so larger transfers are reported as
+         * partial, which the caller handles by sending the rest. */
+        transportResult = ( result > ( ssize_t ) INT32_MAX ) ? INT32_MAX : ( int32_t ) result;
+    }
+    else if( ( errno == EAGAIN ) || ( errno == EWOULDBLOCK ) || ( errno == EINTR ) )
+    {
+        /* Nothing could be transferred without blocking; the caller retries. */
+        transportResult = 0;
+    }
+    else
+    {
+        LogError( ( "Socket operation failed: errno=%d.", errno ) );
+        transportResult = -1;
+    }
+
+    return transportResult;
+}
+
+/*-----------------------------------------------------------*/
+
+TcpPosixTransportStatus_t TcpPosixTransport_Connect( NetworkContext_t * pNetworkContext,
+                                                     const char * pHostName,
+                                                     uint16_t port,
+                                                     uint32_t connectTimeoutMs )
+{
+    TcpPosixTransportStatus_t status = TCP_POSIX_TRANSPORT_SUCCESS;
+    struct addrinfo hints;
+    struct addrinfo * pAddresses = NULL;
+    const struct addrinfo * pAddress;
+    char portString[ 6 ];
+    int socketDescriptor = -1;
+
+    if( ( pNetworkContext == NULL ) || ( pNetworkContext->pParams == NULL ) || ( pHostName == NULL ) )
+    {
+        LogError( ( "Argument cannot be NULL: pNetworkContext=%p, pHostName=%p.",
+                    ( void * ) pNetworkContext,
+                    ( const void * ) pHostName ) );
+        status = TCP_POSIX_TRANSPORT_INVALID_PARAMETER;
+    }
+    else
+    {
+        ( void ) memset( &hints, 0x00, sizeof( hints ) );
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_protocol = IPPROTO_TCP;
+
+        ( void ) snprintf( portString, sizeof( portString ), "%u", ( unsigned int ) port );
+
+        if( getaddrinfo( pHostName, portString, &hints, &pAddresses ) != 0 )
+        {
+            LogError( ( "Failed to resolve %s.", pHostName ) );
+            status = TCP_POSIX_TRANSPORT_DNS_FAILURE;
+        }
+    }
+
+    if( status == TCP_POSIX_TRANSPORT_SUCCESS )
+    {
+        status = TCP_POSIX_TRANSPORT_CONNECT_FAILURE;
+
+        /* Try every resolved address until one accepts the connection. */
+        for( pAddress = pAddresses;
+             ( pAddress != NULL ) && ( status != TCP_POSIX_TRANSPORT_SUCCESS );
+             pAddress = pAddress->ai_next )
+        {
+            status = connectToAddress( pAddress, connectTimeoutMs, &socketDescriptor );
+        }
+
+        freeaddrinfo( pAddresses );
+    }
+
+    if( status == TCP_POSIX_TRANSPORT_SUCCESS )
+    {
+        pNetworkContext->pParams->socketDescriptor = socketDescriptor;
+        LogDebug( ( "Connected to %s:%u.", pHostName, ( unsigned int ) port ) );
+    }
+    else if( ( pNetworkContext != NULL ) && ( pNetworkContext->pParams != NULL ) )
+    {
+        pNetworkContext->pParams->socketDescriptor = -1;
+    }
+    else
+    {
+        /* MISRA else */
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+TcpPosixTransportStatus_t TcpPosixTransport_Attach( NetworkContext_t * pNetworkContext,
+                                                    int socketDescriptor )
+{
+    TcpPosixTransportStatus_t status;
+
+    if( ( pNetworkContext == NULL ) || ( pNetworkContext->pParams == NULL ) || ( socketDescriptor < 0 ) )
+    {
+        LogError( ( "Invalid parameter: pNetworkContext=%p, socketDescriptor=%d.",
+                    ( void * ) pNetworkContext,
+                    socketDescriptor ) );
+        status = TCP_POSIX_TRANSPORT_INVALID_PARAMETER;
+    }
+    else
+    {
+        status = configureSocket( socketDescriptor );
+    }
+
+    if( status == TCP_POSIX_TRANSPORT_SUCCESS )
+    {
+        pNetworkContext->pParams->socketDescriptor = socketDescriptor;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+TcpPosixTransportStatus_t TcpPosixTransport_Disconnect( const NetworkContext_t * pNetworkContext )
+{
+    TcpPosixTransportStatus_t status = TCP_POSIX_TRANSPORT_SUCCESS;
+    int socketDescriptor = getSocket( pNetworkContext );
+
+    if( socketDescriptor < 0 )
+    {
+        LogError( ( "The network context is not connected." ) );
+        status = TCP_POSIX_TRANSPORT_INVALID_PARAMETER;
+    }
+    else
+    {
+        ( void ) shutdown( socketDescriptor, SHUT_RDWR );
+        ( void ) close( socketDescriptor );
+        pNetworkContext->pParams->socketDescriptor = -1;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+TcpPosixTransportStatus_t TcpPosixTransport_SetNoDelay( const NetworkContext_t * pNetworkContext,
+                                                        bool noDelay )
+{
+    TcpPosixTransportStatus_t status = TCP_POSIX_TRANSPORT_SUCCESS;
+    int socketDescriptor = getSocket( pNetworkContext );
+    int value = ( noDelay == true ) ? 1 : 0;
+
+    if( socketDescriptor < 0 )
+    {
+        LogError( ( "The network context is not connected." ) );
+        status = TCP_POSIX_TRANSPORT_INVALID_PARAMETER;
+    }
+    else if( setsockopt( socketDescriptor, IPPROTO_TCP, TCP_NODELAY,
+                         &value, ( socklen_t ) sizeof( value ) ) < 0 )
+    {
+        LogError( ( "Failed to set TCP_NODELAY: errno=%d.", errno ) );
+        status = TCP_POSIX_TRANSPORT_SOCKET_ERROR;
+    }
+    else
+    {
+        /* MISRA else */
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+TcpPosixTransportStatus_t TcpPosixTransport_SetCork( const NetworkContext_t * pNetworkContext,
+                                                     bool corked )
+{
+    TcpPosixTransportStatus_t status = TCP_POSIX_TRANSPORT_SUCCESS;
+    int socketDescriptor = getSocket( pNetworkContext );
+
+    if( socketDescriptor < 0 )
+    {
+        LogError( ( "The network context is not connected." ) );
+        status = TCP_POSIX_TRANSPORT_INVALID_PARAMETER;
+    }
+    else
+    {
+        #ifdef TCP_CORK
+            int value = ( corked == true ) ? 1 : 0;
+
+            if( setsockopt( socketDescriptor, IPPROTO_TCP, TCP_CORK,
+                            &value, ( socklen_t ) sizeof( value ) ) < 0 )
+            {
+                LogError( ( "Failed to set TCP_CORK: errno=%d.", errno ) );
+                status = TCP_POSIX_TRANSPORT_SOCKET_ERROR;
+            }
+        #else
+            ( void ) corked;
+            LogError( ( "TCP_CORK is not supported on this platform." ) );
+            status = TCP_POSIX_TRANSPORT_SOCKET_ERROR;
+        #endif
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+int32_t TcpPosixTransport_Recv( NetworkContext_t * pNetworkContext,
+                                void * pBuffer,
+                                size_t bytesToRecv )
+{
+    int32_t bytesReceived = -1;
+    ssize_t result;
+    int socketDescriptor = getSocket( pNetworkContext );
+
+    if( ( socketDescriptor < 0 ) || ( pBuffer == NULL ) )
+    {
+        LogError( ( "Invalid parameter: socketDescriptor=%d, pBuffer=%p.",
+                    socketDescriptor, pBuffer ) );
+    }
+    else if( bytesToRecv == 0U )
+    {
+        bytesReceived = 0;
+    }
+    else
+    {
+        result = recv( socketDescriptor, pBuffer, bytesToRecv, 0 );
+
+        if( result == 0 )
+        {
+            /* The interface reserves 0 for "no data yet", so an orderly
+             * shutdown by the peer is reported as an error. */
+            LogDebug( ( "Connection closed by peer." ) );
+            bytesReceived = -1;
+        }
+        else
+        {
+            bytesReceived = toTransportResult( result );
+        }
+    }
+
+    return bytesReceived;
+}
+
+/*-----------------------------------------------------------*/
+
+int32_t TcpPosixTransport_Send( NetworkContext_t * pNetworkContext,
+                                const void * pBuffer,
+                                size_t bytesToSend )
+{
+    int32_t bytesSent = -1;
+    int socketDescriptor = getSocket( pNetworkContext );
+
+    if( ( socketDescriptor < 0 ) || ( pBuffer == NULL ) )
+    {
+        LogError( ( "Invalid parameter: socketDescriptor=%d, pBuffer=%p.",
+                    socketDescriptor, pBuffer ) );
+    }
+    else
+    {
+        /* MSG_NOSIGNAL reports a closed connection as EPIPE instead of
+         * raising SIGPIPE. */
+        bytesSent = toTransportResult( send( socketDescriptor, pBuffer, bytesToSend, MSG_NOSIGNAL ) );
+    }
+
+    return bytesSent;
+}
+
+/*-----------------------------------------------------------*/
+
+int32_t TcpPosixTransport_Writev( NetworkContext_t * pNetworkContext,
+                                  TransportOutVector_t * pIoVec,
+                                  size_t ioVecCount )
+{
+    int32_t bytesSent = -1;
+    int socketDescriptor = getSocket( pNetworkContext );
+    struct iovec ioVectors[ TCP_POSIX_TRANSPORT_MAX_IOVECS ];
+    struct msghdr message;
+    size_t index;
+
+    if( ( socketDescriptor < 0 ) || ( pIoVec == NULL ) )
+    {
+        LogError( ( "Invalid parameter: socketDescriptor=%d, pIoVec=%p.",
+                    socketDescriptor, ( void * ) pIoVec ) );
+    }
+    else
+    {
+        if( ioVecCount > TCP_POSIX_TRANSPORT_MAX_IOVECS )
+        {
+            /* The remaining vectors are sent by the next call. */
+            ioVecCount = TCP_POSIX_TRANSPORT_MAX_IOVECS;
+        }
+
+        /* TransportOutVector_t holds const pointers, so it cannot be passed
+         * as a struct iovec array directly. */
+        for( index = 0U; index < ioVecCount; index++ )
+        {
+            /* coverity[misra_c_2012_rule_11_8_violation] */
+            ioVectors[ index ].iov_base = ( void * ) pIoVec[ index ].iov_base;
+            ioVectors[ index ].iov_len = pIoVec[ index ].iov_len;
+        }
+
+        ( void ) memset( &message, 0x00, sizeof( message ) );
+        message.msg_iov = ioVectors;
+        message.msg_iovlen = ioVecCount;
+
+        /* sendmsg is writev with flags, so MSG_NOSIGNAL can be passed. */
+        bytesSent = toTransportResult( sendmsg( socketDescriptor, &message, MSG_NOSIGNAL ) );
+    }
+
+    return bytesSent;
+}
+
+/*-----------------------------------------------------------*/
+
+int32_t TcpPosixTransport_Wait( NetworkContext_t * pNetworkContext,
+                                TransportWaitEvent_t event,
+                                uint32_t timeoutMs )
+{
+    int32_t waitResult = -1;
+    int socketDescriptor = getSocket( pNetworkContext );
+    struct pollfd pollDescriptor;
+    int pollResult;
+
+    if( socketDescriptor < 0 )
+    {
+        LogError( ( "Invalid parameter: socketDescriptor=%d.", socketDescriptor ) );
+    }
+    else
+    {
+        pollDescriptor.fd = socketDescriptor;
+        pollDescriptor.events = ( event == TRANSPORT_WAIT_WRITABLE ) ? POLLOUT : POLLIN;
+        pollDescriptor.revents = 0;
+
+        pollResult = poll( &pollDescriptor, 1U,
+                           ( timeoutMs > ( uint32_t ) INT_MAX ) ? INT_MAX : ( int ) timeoutMs );
+
+        /* An error or hang-up of the socket also ends the wait, so that the
+         * next receive or send reports it. */
+        if( pollResult >= 0 )
+        {
+            waitResult = ( int32_t ) pollResult;
+        }
+        else if( errno == EINTR )
+        {
+            waitResult = 0;
+        }
+        else
+        {
+            LogError( ( "Failed to wait for the socket: errno=%d.", errno ) );
+        }
+    }
+
+    return waitResult;
+}
+
+/*-----------------------------------------------------------*/
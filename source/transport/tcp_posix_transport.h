@@ -0,0 +1,251 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file tcp_posix_transport.h
+ * @brief Reference implementation of the transport interface over a
+ * non-blocking POSIX TCP socket.
+ *
+ * Every compilation unit which uses this transport must define
+ * `struct NetworkContext` with a `pParams` member pointing to a
+ * #TcpPosixTransportParams_t:
+ *
+ * @code{c}
+ * struct NetworkContext
+ * {
+ *     TcpPosixTransportParams_t * pParams;
+ * };
+ * @endcode
+ */
+
+#ifndef TCP_POSIX_TRANSPORT_H_
+#define TCP_POSIX_TRANSPORT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    extern "C" {
+#endif
+/* *INDENT-ON* */
+
+/* Include transport interface. */
+#include "transport_interface.h"
+
+/**
+ * @brief Maximum number of vectors written with a single system call by
+ * #TcpPosixTransport_Writev. Any further vectors are left to the next call,
+ * as a partial write is allowed by the transport interface.
+ */
+#ifndef TCP_POSIX_TRANSPORT_MAX_IOVECS
+    #define TCP_POSIX_TRANSPORT_MAX_IOVECS    ( 16U )
+#endif
+
+/**
+ * @brief Return codes of the connection management functions of the transport.
+ */
+typedef enum TcpPosixTransportStatus
+{
+    TCP_POSIX_TRANSPORT_SUCCESS = 0,       /**< @brief Function successfully completed. */
+    TCP_POSIX_TRANSPORT_INVALID_PARAMETER, /**< @brief At least one parameter was invalid. */
+    TCP_POSIX_TRANSPORT_DNS_FAILURE,       /**< @brief Resolving the host name failed. */
+    TCP_POSIX_TRANSPORT_CONNECT_FAILURE,   /**< @brief The connection could not be established in time. */
+    TCP_POSIX_TRANSPORT_SOCKET_ERROR       /**< @brief A socket option could not be applied. */
+} TcpPosixTransportStatus_t;
+
+/**
+ * @brief Parameters of a TCP connection, referenced by the `pParams` member of
+ * `struct NetworkContext`.
+ */
+typedef struct TcpPosixTransportParams
+{
+    int socketDescriptor; /**< @brief The socket of the connection, or -1 if not connected. */
+} TcpPosixTransportParams_t;
+
+/**
+ * @brief Establish a TCP connection and put the socket into non-blocking mode
+ * with Nagle's algorithm disabled.
+ *
+ * @param[in] pNetworkContext Network context whose parameters receive the socket.
+ * @param[in] pHostName Host name or IP address of the server.
+ * @param[in] port Port of the server.
+ * @param[in] connectTimeoutMs Time to wait for the connection to be established.
+ *
+ * @return #TCP_POSIX_TRANSPORT_SUCCESS if the connection is established;
+ * #TCP_POSIX_TRANSPORT_INVALID_PARAMETER, #TCP_POSIX_TRANSPORT_DNS_FAILURE,
+ * #TCP_POSIX_TRANSPORT_CONNECT_FAILURE or #TCP_POSIX_TRANSPORT_SOCKET_ERROR
+ * otherwise.
+ */
+/* @[declare_tcpposixtransport_connect] */
+TcpPosixTransportStatus_t TcpPosixTransport_Connect( NetworkContext_t * pNetworkContext,
+                                                     const char * pHostName,
+                                                     uint16_t port,
+                                                     uint32_t connectTimeoutMs );
+/* @[declare_tcpposixtransport_connect] */
+
+/**
+ * @brief Use an already connected TCP socket, such as one returned by
+ * `accept`, and configure it as #TcpPosixTransport_Connect does.
+ *
+ * @param[in] pNetworkContext Network context whose parameters receive the socket.
+ * @param[in] socketDescriptor The connected socket.
+ *
+ * @return #TCP_POSIX_TRANSPORT_SUCCESS, #TCP_POSIX_TRANSPORT_INVALID_PARAMETER or
+ * #TCP_POSIX_TRANSPORT_SOCKET_ERROR.
+ */
+/* @[declare_tcpposixtransport_attach] */
+TcpPosixTransportStatus_t TcpPosixTransport_Attach( NetworkContext_t * pNetworkContext,
+                                                    int socketDescriptor );
+/* @[declare_tcpposixtransport_attach] */
+
+/**
+ * @brief Close the TCP connection.
+ *
+ * @param[in] pNetworkContext Network context of the connection.
+ *
+ * @return #TCP_POSIX_TRANSPORT_SUCCESS or #TCP_POSIX_TRANSPORT_INVALID_PARAMETER.
+ */
+/* @[declare_tcpposixtransport_disconnect] */
+TcpPosixTransportStatus_t TcpPosixTransport_Disconnect( const NetworkContext_t * pNetworkContext );
+/* @[declare_tcpposixtransport_disconnect] */
+
+/**
+ * @brief Enable or disable Nagle's algorithm on the connection.
+ *
+ * Nagle's algorithm is disabled when the connection is established, so that
+ * small MQTT packets are not delayed.
+ *
+ * @param[in] pNetworkContext Network context of the connection.
+ * @param[in] noDelay Whether to disable Nagle's algorithm.
+ *
+ * @return #TCP_POSIX_TRANSPORT_SUCCESS, #TCP_POSIX_TRANSPORT_INVALID_PARAMETER or
+ * #TCP_POSIX_TRANSPORT_SOCKET_ERROR.
+ */
+/* @[declare_tcpposixtransport_setnodelay] */
+TcpPosixTransportStatus_t TcpPosixTransport_SetNoDelay( const NetworkContext_t * pNetworkContext,
+                                                        bool noDelay );
+/* @[declare_tcpposixtransport_setnodelay] */
+
+/**
+ * @brief Cork or uncork the connection.
+ *
+ * While corked, the kernel only sends full segments, so a burst of publishes
+ * can be coalesced into fewer TCP segments. Uncorking flushes any partial
+ * segment. This is only supported where `TCP_CORK` is available.
+ *
+ * @param[in] pNetworkContext Network context of the connection.
+ * @param[in] corked Whether to cork the connection.
+ *
+ * @return #TCP_POSIX_TRANSPORT_SUCCESS, #TCP_POSIX_TRANSPORT_INVALID_PARAMETER or
+ * #TCP_POSIX_TRANSPORT_SOCKET_ERROR.
+ */
+/* @[declare_tcpposixtransport_setcork] */
+TcpPosixTransportStatus_t TcpPosixTransport_SetCork( const NetworkContext_t * pNetworkContext,
+                                                     bool corked );
+/* @[declare_tcpposixtransport_setcork] */
+
+/**
+ * @brief Receive data from the connection without blocking.
+ *
+ * Implements #TransportRecv_t.
+ *
+ * @param[in] pNetworkContext Network context of the connection.
+ * @param[out] pBuffer Buffer to receive the data into.
+ * @param[in] bytesToRecv Size of @p pBuffer.
+ *
+ * @return The number of bytes received; 0 if no data is available; a negative
+ * value if the connection failed or was closed by the peer.
+ */
+/* @[declare_tcpposixtransport_recv] */
+int32_t TcpPosixTransport_Recv( NetworkContext_t * pNetworkContext,
+                                void * pBuffer,
+                                size_t bytesToRecv );
+/* @[declare_tcpposixtransport_recv] */
+
+/**
+ * @brief Send data over the connection without blocking.
+ *
+ * Implements #TransportSend_t.
+ *
+ * @param[in] pNetworkContext Network context of the connection.
+ * @param[in] pBuffer Data to send.
+ * @param[in] bytesToSend Number of bytes in @p pBuffer.
+ *
+ * @return The number of bytes sent; 0 if the socket buffer is full; a negative
+ * value if the connection failed.
+ */
+/* @[declare_tcpposixtransport_send] */
+int32_t TcpPosixTransport_Send( NetworkContext_t * pNetworkContext,
+                                const void * pBuffer,
+                                size_t bytesToSend );
+/* @[declare_tcpposixtransport_send] */
+
+/**
+ * @brief Send a list of buffers over the connection with a single system call,
+ * without blocking.
+ *
+ * Implements #TransportWritev_t. At most #TCP_POSIX_TRANSPORT_MAX_IOVECS
+ * vectors are written per call.
+ *
+ * @param[in] pNetworkContext Network context of the connection.
+ * @param[in] pIoVec The buffers to send.
+ * @param[in] ioVecCount Number of buffers in @p pIoVec.
+ *
+ * @return The number of bytes sent; 0 if the socket buffer is full; a negative
+ * value if the connection failed.
+ */
+/* @[declare_tcpposixtransport_writev] */
+int32_t TcpPosixTransport_Writev( NetworkContext_t * pNetworkContext,
+                                  TransportOutVector_t * pIoVec,
+                                  size_t ioVecCount );
+/* @[declare_tcpposixtransport_writev] */
+
+/**
+ * @brief Wait until the socket can receive or send.
+ *
+ * Implements #TransportWait_t with `poll`.
+ *
+ * @param[in] pNetworkContext Network context of the connection.
+ * @param[in] event Whether to wait for data to receive or space to send.
+ * @param[in] timeoutMs Longest time to wait.
+ *
+ * @return A positive value if the socket is ready or has failed; 0 if the
+ * timeout expired or a signal interrupted the wait; a negative value if the
+ * network context is not connected or `poll` failed.
+ */
+/* @[declare_tcpposixtransport_wait] */
+int32_t TcpPosixTransport_Wait( NetworkContext_t * pNetworkContext,
+                                TransportWaitEvent_t event,
+                                uint32_t timeoutMs );
+/* @[declare_tcpposixtransport_wait] */
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    }
+#endif
+/* *INDENT-ON* */
+
+#endif /* ifndef TCP_POSIX_TRANSPORT_H_ */
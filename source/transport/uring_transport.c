@@ -0,0 +1,1185 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file uring_transport.c
+ * @brief Implements the transport interface over Linux io_uring.
+ */
+
+/* syscall() is not part of POSIX. io_uring is used without liburing, so that
+ * the transport has no dependency beyond the kernel headers. */
+#ifndef _GNU_SOURCE
+    #define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+#include "uring_transport.h"
+
+/* Include config defaults header to get default values of configs. */
+#include "core_mqtt_config_defaults.h"
+
+/**
+ * @brief Each compilation unit that uses the transport must define the
+ * NetworkContext struct.
+ */
+struct NetworkContext
+{
+    UringTransportParams_t * pParams;
+};
+
+/**
+ * @brief ID of the provided buffer group of the receive buffers.
+ */
+#define URING_TRANSPORT_BUFFER_GROUP           ( 0U )
+
+/**
+ * @brief Buffer ID terminating a list of received buffers.
+ */
+#define URING_TRANSPORT_NO_BUFFER              ( 0xFFFFU )
+
+/**
+ * @brief Operation tags stored in the low bits of the user data of a
+ * submission, next to the address of the connection parameters.
+ */
+#define URING_TRANSPORT_OP_RECV                ( 0U )
+#define URING_TRANSPORT_OP_WRITE               ( 1U )
+#define URING_TRANSPORT_OP_MASK                ( 3U )
+
+/**
+ * @brief Time to wait for each completion while disconnecting.
+ */
+#define URING_TRANSPORT_DISCONNECT_WAIT_MS     ( 1000U )
+
+/**
+ * @brief Bookkeeping of a receive buffer, stored after the provided buffer
+ * ring.
+ */
+typedef struct RxBufferInfo
+{
+    uint32_t length; /**< @brief Number of bytes received into the buffer. */
+    uint16_t next;   /**< @brief Next buffer received by the same connection. */
+} RxBufferInfo_t;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Get the parameters of a network context.
+ *
+ * @param[in] pNetworkContext Network context of the connection.
+ *
+ * @return The parameters, or NULL if the network context is not attached.
+ */
+static UringTransportParams_t * getParams( const NetworkContext_t * pNetworkContext );
+
+/**
+ * @brief Create the io_uring instance and map its queues.
+ *
+ * @param[in] pRing The ring.
+ *
+ * @return #URING_TRANSPORT_SUCCESS or #URING_TRANSPORT_SYSTEM_ERROR.
+ */
+static UringTransportStatus_t setupQueues( UringTransportRing_t * pRing );
+
+/**
+ * @brief Register the provided buffer ring of the receive buffers and fill it.
+ *
+ * @param[in] pRing The ring.
+ *
+ * @return #URING_TRANSPORT_SUCCESS or #URING_TRANSPORT_SYSTEM_ERROR.
+ */
+static UringTransportStatus_t setupBufferRing( UringTransportRing_t * pRing );
+
+/**
+ * @brief Unmap and close everything set up for a ring.
+ *
+ * @param[in] pRing The ring.
+ */
+static void releaseRing( UringTransportRing_t * pRing );
+
+/**
+ * @brief Get the bookkeeping of the receive buffers of a ring.
+ *
+ * @param[in] pRing The ring.
+ *
+ * @return The bookkeeping array, indexed by buffer ID.
+ */
+static RxBufferInfo_t * getRxBufferInfo( const UringTransportRing_t * pRing );
+
+/**
+ * @brief Give a receive buffer back to the kernel.
+ *
+ * @param[in] pRing The ring.
+ * @param[in] bufferId ID of the buffer.
+ */
+static void recycleRxBuffer( UringTransportRing_t * pRing,
+                             uint16_t bufferId );
+
+/**
+ * @brief Get a free submission queue entry, submitting the queued entries if
+ * the queue is full.
+ *
+ * @param[in] pRing The ring.
+ *
+ * @return The cleared entry, or NULL if the queue stays full.
+ */
+static struct io_uring_sqe * getSqe( UringTransportRing_t * pRing );
+
+/**
+ * @brief Make an entry obtained from #getSqe visible to the kernel.
+ *
+ * @param[in] pRing The ring.
+ */
+static void queueSqe( UringTransportRing_t * pRing );
+
+/**
+ * @brief Queue a multishot receive for a connection.
+ *
+ * @param[in] pParams Parameters of the connection.
+ */
+static void armRecv( UringTransportParams_t * pParams );
+
+/**
+ * @brief Queue a write of the staged bytes of a connection.
+ *
+ * @param[in] pParams Parameters of the connection.
+ *
+ * @return true if the write was queued; false if the submission queue is full.
+ */
+static bool queueWrite( UringTransportParams_t * pParams );
+
+/**
+ * @brief Submit the queued entries and optionally wait for completions.
+ *
+ * @param[in] pRing The ring.
+ * @param[in] timeoutMs Time to wait for a completion; 0 not to wait.
+ *
+ * @return #URING_TRANSPORT_SUCCESS or #URING_TRANSPORT_SYSTEM_ERROR.
+ */
+static UringTransportStatus_t enterRing( UringTransportRing_t * pRing,
+                                         uint32_t timeoutMs );
+
+/**
+ * @brief Handle all available completions.
+ *
+ * @param[in] pRing The ring.
+ */
+static void reapCompletions( UringTransportRing_t * pRing );
+
+/**
+ * @brief Handle the completion of a receive.
+ *
+ * @param[in] pParams Parameters of the connection.
+ * @param[in] pCqe The completion.
+ */
+static void handleRecvCompletion( UringTransportParams_t * pParams,
+                                  const struct io_uring_cqe * pCqe );
+
+/**
+ * @brief Handle the completion of a write.
+ *
+ * @param[in] pParams Parameters of the connection.
+ * @param[in] pCqe The completion.
+ */
+static void handleWriteCompletion( UringTransportParams_t * pParams,
+                                   const struct io_uring_cqe * pCqe );
+
+/**
+ * @brief Append a connection to the ready list of its ring, unless it is
+ * already in it.
+ *
+ * @param[in] pParams Parameters of the connection.
+ */
+static void markReady( UringTransportParams_t * pParams );
+
+/**
+ * @brief Remove a connection from the ready list of its ring.
+ *
+ * @param[in] pParams Parameters of the connection.
+ */
+static void unlinkReady( UringTransportParams_t * pParams );
+
+/**
+ * @brief Copy data into the transmit buffer of a connection and queue its
+ * write.
+ *
+ * @param[in] pParams Parameters of the connection.
+ * @param[in] pIoVec The buffers to stage.
+ * @param[in] ioVecCount Number of buffers in @p pIoVec.
+ *
+ * @return The number of bytes staged; 0 if the transmit buffer is full; -1 if
+ * the connection failed.
+ */
+static int32_t stageVectors( UringTransportParams_t * pParams,
+                             const TransportOutVector_t * pIoVec,
+                             size_t ioVecCount );
+
+/*-----------------------------------------------------------*/
+
+static UringTransportParams_t * getParams( const NetworkContext_t * pNetworkContext )
+{
+    UringTransportParams_t * pParams = NULL;
+
+    if( ( pNetworkContext != NULL ) && ( pNetworkContext->pParams != NULL ) &&
+        ( pNetworkContext->pParams->socketDescriptor >= 0 ) )
+    {
+        pParams = pNetworkContext->pParams;
+    }
+
+    return pParams;
+}
+
+/*-----------------------------------------------------------*/
+
+static UringTransportStatus_t setupQueues( UringTransportRing_t * pRing )
+{
+    UringTransportStatus_t status = URING_TRANSPORT_SUCCESS;
+    struct io_uring_params params;
+    size_t sqRingSize, cqRingSize;
+    uint32_t * pSqArray;
+    uint32_t index;
+    void * pMapping;
+
+    /* Completions are only reaped by the thread submitting, so the kernel
+     * need not interrupt it to run completion work. */
+    ( void ) memset( &params, 0x00, sizeof( params ) );
+    params.flags = IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN;
+    pRing->ringDescriptor = ( int ) syscall( __NR_io_uring_setup, pRing->config.entries, &params );
+
+    if( ( pRing->ringDescriptor < 0 ) && ( errno == EINVAL ) )
+    {
+        /* Older kernels do not know the flags. */
+        ( void ) memset( &params, 0x00, sizeof( params ) );
+        pRing->ringDescriptor = ( int ) syscall( __NR_io_uring_setup, pRing->config.entries, &params );
+    }
+
+    if( pRing->ringDescriptor < 0 )
+    {
+        LogError( ( "Failed to set up io_uring: errno=%d.", errno ) );
+        status = URING_TRANSPORT_SYSTEM_ERROR;
+    }
+    else if( ( ( params.features & IORING_FEAT_SINGLE_MMAP ) == 0U ) ||
+             ( ( params.features & IORING_FEAT_EXT_ARG ) == 0U ) ||
+             ( ( params.features & IORING_FEAT_NODROP ) == 0U ) )
+    {
+        LogError( ( "The kernel lacks required io_uring features: features=0x%x.",
+                    ( unsigned int ) params.features ) );
+        status = URING_TRANSPORT_SYSTEM_ERROR;
+    }
+    else
+    {
+        sqRingSize = params.sq_off.array + ( params.sq_entries * sizeof( uint32_t ) );
+        cqRingSize = params.cq_off.cqes + ( params.cq_entries * sizeof( struct io_uring_cqe ) );
+        pRing->queueRingsSize = ( sqRingSize > cqRingSize ) ? sqRingSize : cqRingSize;
+        pRing->sqesSize = params.sq_entries * sizeof( struct io_uring_sqe );
+
+        pMapping = mmap( NULL, pRing->queueRingsSize, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, pRing->ringDescriptor, IORING_OFF_SQ_RING );
+        pRing->pQueueRings = ( pMapping == MAP_FAILED ) ? NULL : ( uint8_t * ) pMapping;
+
+        pMapping = mmap( NULL, pRing->sqesSize, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, pRing->ringDescriptor, IORING_OFF_SQES );
+        pRing->pSqes = ( pMapping == MAP_FAILED ) ? NULL : ( struct io_uring_sqe * ) pMapping;
+
+        if( ( pRing->pQueueRings == NULL ) || ( pRing->pSqes == NULL ) )
+        {
+            LogError( ( "Failed to map the io_uring queues: errno=%d.", errno ) );
+            status = URING_TRANSPORT_SYSTEM_ERROR;
+        }
+    }
+
+    if( status == URING_TRANSPORT_SUCCESS )
+    {
+        pRing->pSqHead = ( uint32_t * ) &pRing->pQueueRings[ params.sq_off.head ];
+        pRing->pSqTail = ( uint32_t * ) &pRing->pQueueRings[ params.sq_off.tail ];
+        pRing->sqMask = *( uint32_t * ) &pRing->pQueueRings[ params.sq_off.ring_mask ];
+        pRing->sqEntries = params.sq_entries;
+        pRing->sqTail = *pRing->pSqTail;
+        pRing->pCqHead = ( uint32_t * ) &pRing->pQueueRings[ params.cq_off.head ];
+        pRing->pCqTail = ( uint32_t * ) &pRing->pQueueRings[ params.cq_off.tail ];
+        pRing->cqMask = *( uint32_t * ) &pRing->pQueueRings[ params.cq_off.ring_mask ];
+        pRing->pCqes = ( struct io_uring_cqe * ) &pRing->pQueueRings[ params.cq_off.cqes ];
+
+        /* Entries are always submitted in order, so the indirection array is
+         * filled once with the identity mapping. */
+        pSqArray = ( uint32_t * ) &pRing->pQueueRings[ params.sq_off.array ];
+
+        for( index = 0U; index < params.sq_entries; index++ )
+        {
+            pSqArray[ index ] = index;
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static UringTransportStatus_t setupBufferRing( UringTransportRing_t * pRing )
+{
+    UringTransportStatus_t status = URING_TRANSPORT_SUCCESS;
+    struct io_uring_buf_reg registration;
+    uint32_t bufferId;
+    void * pMapping;
+
+    /* The ring must be page aligned, so it is mapped rather than taken from
+     * the application. The bookkeeping of each buffer follows it. */
+    pRing->bufferRingSize = pRing->config.rxBufferCount *
+                            ( sizeof( struct io_uring_buf ) + sizeof( RxBufferInfo_t ) );
+    pMapping = mmap( NULL, pRing->bufferRingSize, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+    pRing->pBufferRing = ( pMapping == MAP_FAILED ) ? NULL : ( uint8_t * ) pMapping;
+
+    if( pRing->pBufferRing == NULL )
+    {
+        LogError( ( "Failed to map the provided buffer ring: errno=%d.", errno ) );
+        status = URING_TRANSPORT_SYSTEM_ERROR;
+    }
+    else
+    {
+        ( void ) memset( &registration, 0x00, sizeof( registration ) );
+        registration.ring_addr = ( uint64_t ) ( uintptr_t ) pRing->pBufferRing;
+        registration.ring_entries = pRing->config.rxBufferCount;
+        registration.bgid = URING_TRANSPORT_BUFFER_GROUP;
+
+        if( syscall( __NR_io_uring_register, pRing->ringDescriptor,
+                     IORING_REGISTER_PBUF_RING, &registration, 1U ) < 0 )
+        {
+            LogError( ( "Failed to register the provided buffer ring: errno=%d.", errno ) );
+            status = URING_TRANSPORT_SYSTEM_ERROR;
+        }
+    }
+
+    if( status == URING_TRANSPORT_SUCCESS )
+    {
+        for( bufferId = 0U; bufferId < pRing->config.rxBufferCount; bufferId++ )
+        {
+            recycleRxBuffer( pRing, ( uint16_t ) bufferId );
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static void releaseRing( UringTransportRing_t * pRing )
+{
+    /* Closing the ring unregisters its buffers, so it is closed before the
+     * buffer ring is unmapped. */
+    if( pRing->ringDescriptor >= 0 )
+    {
+        ( void ) close( pRing->ringDescriptor );
+        pRing->ringDescriptor = -1;
+    }
+
+    if( pRing->pQueueRings != NULL )
+    {
+        ( void ) munmap( pRing->pQueueRings, pRing->queueRingsSize );
+        pRing->pQueueRings = NULL;
+    }
+
+    if( pRing->pSqes != NULL )
+    {
+        ( void ) munmap( pRing->pSqes, pRing->sqesSize );
+        pRing->pSqes = NULL;
+    }
+
+    if( pRing->pBufferRing != NULL )
+    {
+        ( void ) munmap( pRing->pBufferRing, pRing->bufferRingSize );
+        pRing->pBufferRing = NULL;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static RxBufferInfo_t * getRxBufferInfo( const UringTransportRing_t * pRing )
+{
+    return ( RxBufferInfo_t * ) &pRing->pBufferRing[ pRing->config.rxBufferCount *
+                                                     sizeof( struct io_uring_buf ) ];
+}
+
+/*-----------------------------------------------------------*/
+
+static void recycleRxBuffer( UringTransportRing_t * pRing,
+                             uint16_t bufferId )
+{
+    struct io_uring_buf * pEntries = ( struct io_uring_buf * ) pRing->pBufferRing;
+    struct io_uring_buf * pEntry;
+
+    pEntry = &pEntries[ pRing->bufferRingTail & ( pRing->config.rxBufferCount - 1U ) ];
+
+    /* The tail of the ring overlays the reserved field of the first entry,
+     * so only the other fields are written. */
+    pEntry->addr = ( uint64_t ) ( uintptr_t ) &pRing->config.pRxBuffers[ ( size_t ) bufferId *
+                                                                         pRing->config.rxBufferSize ];
+    pEntry->len = pRing->config.rxBufferSize;
+    pEntry->bid = bufferId;
+
+    pRing->bufferRingTail++;
+    __atomic_store_n( &pEntries[ 0 ].resv, pRing->bufferRingTail, __ATOMIC_RELEASE );
+}
+
+/*-----------------------------------------------------------*/
+
+static struct io_uring_sqe * getSqe( UringTransportRing_t * pRing )
+{
+    struct io_uring_sqe * pSqe = NULL;
+    uint32_t head = __atomic_load_n( pRing->pSqHead, __ATOMIC_ACQUIRE );
+
+    if( ( pRing->sqTail - head ) >= pRing->sqEntries )
+    {
+        /* The kernel consumes entries as soon as they are submitted. */
+        ( void ) enterRing( pRing, 0U );
+        head = __atomic_load_n( pRing->pSqHead, __ATOMIC_ACQUIRE );
+    }
+
+    if( ( pRing->sqTail - head ) < pRing->sqEntries )
+    {
+        pSqe = &pRing->pSqes[ pRing->sqTail & pRing->sqMask ];
+        ( void ) memset( pSqe, 0x00, sizeof( *pSqe ) );
+    }
+    else
+    {
+        LogError( ( "The io_uring submission queue is full." ) );
+    }
+
+    return pSqe;
+}
+
+/*-----------------------------------------------------------*/
+
+static void queueSqe( UringTransportRing_t * pRing )
+{
+    pRing->sqTail++;
+    pRing->pendingSubmissions++;
+    __atomic_store_n( pRing->pSqTail, pRing->sqTail, __ATOMIC_RELEASE );
+}
+
+/*-----------------------------------------------------------*/
+
+static void armRecv( UringTransportParams_t * pParams )
+{
+    struct io_uring_sqe * pSqe = getSqe( pParams->pRing );
+
+    /* Without a free entry, the receive is armed by a later call to
+     * UringTransport_Recv. */
+    if( pSqe != NULL )
+    {
+        pSqe->opcode = IORING_OP_RECV;
+        pSqe->fd = pParams->socketDescriptor;
+        pSqe->ioprio = IORING_RECV_MULTISHOT;
+        pSqe->flags = IOSQE_BUFFER_SELECT;
+        pSqe->buf_group = URING_TRANSPORT_BUFFER_GROUP;
+        pSqe->user_data = ( uint64_t ) ( uintptr_t ) pParams | URING_TRANSPORT_OP_RECV;
+        queueSqe( pParams->pRing );
+        pParams->recvArmed = true;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static bool queueWrite( UringTransportParams_t * pParams )
+{
+    const UringTransportRing_t * pRing = pParams->pRing;
+    struct io_uring_sqe * pSqe = getSqe( pParams->pRing );
+    const uint8_t * pTxBuffer = &pRing->config.pTxBuffers[ ( size_t ) pParams->txSlot *
+                                                           pRing->config.txBufferSize ];
+
+    if( pSqe != NULL )
+    {
+        /* The transmit buffers are registered as a single buffer, so any
+         * range of them can be written with index 0. */
+        pSqe->opcode = IORING_OP_WRITE_FIXED;
+        pSqe->fd = pParams->socketDescriptor;
+        pSqe->addr = ( uint64_t ) ( uintptr_t ) &pTxBuffer[ pParams->txHead ];
+        pSqe->len = pParams->txLength - pParams->txHead;
+        pSqe->buf_index = 0U;
+        pSqe->user_data = ( uint64_t ) ( uintptr_t ) pParams | URING_TRANSPORT_OP_WRITE;
+        queueSqe( pParams->pRing );
+        pParams->writeInFlight = true;
+    }
+
+    return pSqe != NULL;
+}
+
+/*-----------------------------------------------------------*/
+
+static UringTransportStatus_t enterRing( UringTransportRing_t * pRing,
+                                         uint32_t timeoutMs )
+{
+    UringTransportStatus_t status = URING_TRANSPORT_SUCCESS;
+    struct io_uring_getevents_arg argument;
+    struct __kernel_timespec timeout;
+    unsigned int flags = IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+    long result;
+
+    ( void ) memset( &argument, 0x00, sizeof( argument ) );
+    timeout.tv_sec = timeoutMs / 1000U;
+    timeout.tv_nsec = ( timeoutMs % 1000U ) * 1000000U;
+    argument.ts = ( uint64_t ) ( uintptr_t ) &timeout;
+
+    result = syscall( __NR_io_uring_enter, pRing->ringDescriptor,
+                      pRing->pendingSubmissions,
+                      ( timeoutMs > 0U ) ? 1U : 0U,
+                      flags, &argument, sizeof( argument ) );
+
+    if( result >= 0 )
+    {
+        pRing->pendingSubmissions -= ( uint32_t ) result;
+    }
+    else if( ( errno == ETIME ) || ( errno == EINTR ) || ( errno == EAGAIN ) || ( errno == EBUSY ) )
+    {
+        /* Nothing completed in time, or the kernel is short of resources
+         * until completions are reaped. */
+    }
+    else
+    {
+        LogError( ( "io_uring_enter failed: errno=%d.", errno ) );
+        status = URING_TRANSPORT_SYSTEM_ERROR;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static void reapCompletions( UringTransportRing_t * pRing )
+{
+    uint32_t head = *pRing->pCqHead;
+    uint32_t tail = __atomic_load_n( pRing->pCqTail, __ATOMIC_ACQUIRE );
+    const struct io_uring_cqe * pCqe;
+    UringTransportParams_t * pParams;
+
+    while( head != tail )
+    {
+        pCqe = &pRing->pCqes[ head & pRing->cqMask ];
+        pParams = ( UringTransportParams_t * ) ( uintptr_t ) ( pCqe->user_data &
+                                                               ~( uint64_t ) URING_TRANSPORT_OP_MASK );
+
+        if( ( pCqe->user_data & URING_TRANSPORT_OP_MASK ) == URING_TRANSPORT_OP_RECV )
+        {
+            handleRecvCompletion( pParams, pCqe );
+        }
+        else
+        {
+            handleWriteCompletion( pParams, pCqe );
+        }
+
+        head++;
+
+        if( head == tail )
+        {
+            /* Pick up completions posted while these were handled. */
+            tail = __atomic_load_n( pRing->pCqTail, __ATOMIC_ACQUIRE );
+        }
+    }
+
+    __atomic_store_n( pRing->pCqHead, head, __ATOMIC_RELEASE );
+}
+
+/*-----------------------------------------------------------*/
+
+static void handleRecvCompletion( UringTransportParams_t * pParams,
+                                  const struct io_uring_cqe * pCqe )
+{
+    RxBufferInfo_t * pInfo = getRxBufferInfo( pParams->pRing );
+    uint16_t bufferId = URING_TRANSPORT_NO_BUFFER;
+
+    if( ( pCqe->flags & IORING_CQE_F_BUFFER ) != 0U )
+    {
+        bufferId = ( uint16_t ) ( pCqe->flags >> IORING_CQE_BUFFER_SHIFT );
+    }
+
+    if( ( pCqe->res > 0 ) && ( bufferId != URING_TRANSPORT_NO_BUFFER ) )
+    {
+        /* Append the buffer to the received data of the connection. */
+        pInfo[ bufferId ].length = ( uint32_t ) pCqe->res;
+        pInfo[ bufferId ].next = URING_TRANSPORT_NO_BUFFER;
+
+        if( pParams->rxTail == URING_TRANSPORT_NO_BUFFER )
+        {
+            pParams->rxHead = bufferId;
+        }
+        else
+        {
+            pInfo[ pParams->rxTail ].next = bufferId;
+        }
+
+        pParams->rxTail = bufferId;
+    }
+    else
+    {
+        if( bufferId != URING_TRANSPORT_NO_BUFFER )
+        {
+            recycleRxBuffer( pParams->pRing, bufferId );
+        }
+
+        if( pCqe->res == -ENOBUFS )
+        {
+            /* The receive buffers ran out. The connection is reported so that
+             * its data is consumed, which re-arms the receive. */
+            LogDebug( ( "No receive buffer for socket %d.", pParams->socketDescriptor ) );
+        }
+        else
+        {
+            LogDebug( ( "Connection closed: res=%d.", ( int ) pCqe->res ) );
+            pParams->closed = true;
+        }
+    }
+
+    if( ( pCqe->flags & IORING_CQE_F_MORE ) == 0U )
+    {
+        pParams->recvArmed = false;
+    }
+
+    markReady( pParams );
+}
+
+/*-----------------------------------------------------------*/
+
+static void handleWriteCompletion( UringTransportParams_t * pParams,
+                                   const struct io_uring_cqe * pCqe )
+{
+    pParams->writeInFlight = false;
+
+    if( pCqe->res <= 0 )
+    {
+        LogError( ( "Write failed: res=%d.", ( int ) pCqe->res ) );
+        pParams->closed = true;
+        markReady( pParams );
+    }
+    else
+    {
+        pParams->txHead += ( uint32_t ) pCqe->res;
+
+        /* Write the rest of a short write together with the bytes staged
+         * since it was queued. */
+        if( ( pParams->txHead < pParams->txLength ) && ( queueWrite( pParams ) == false ) )
+        {
+            pParams->closed = true;
+            markReady( pParams );
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void markReady( UringTransportParams_t * pParams )
+{
+    UringTransportRing_t * pRing = pParams->pRing;
+
+    if( pParams->ready == false )
+    {
+        pParams->ready = true;
+        pParams->pNextReady = NULL;
+
+        if( pRing->pReadyTail == NULL )
+        {
+            pRing->pReadyHead = pParams;
+        }
+        else
+        {
+            pRing->pReadyTail->pNextReady = pParams;
+        }
+
+        pRing->pReadyTail = pParams;
+        pRing->readyCount++;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void unlinkReady( UringTransportParams_t * pParams )
+{
+    UringTransportRing_t * pRing = pParams->pRing;
+    UringTransportParams_t * pPrevious = NULL;
+    UringTransportParams_t * pCurrent = pRing->pReadyHead;
+
+    while( ( pCurrent != NULL ) && ( pCurrent != pParams ) )
+    {
+        pPrevious = pCurrent;
+        pCurrent = pCurrent->pNextReady;
+    }
+
+    if( pCurrent != NULL )
+    {
+        if( pPrevious == NULL )
+        {
+            pRing->pReadyHead = pParams->pNextReady;
+        }
+        else
+        {
+            pPrevious->pNextReady = pParams->pNextReady;
+        }
+
+        if( pRing->pReadyTail == pParams )
+        {
+            pRing->pReadyTail = pPrevious;
+        }
+
+        pRing->readyCount--;
+    }
+
+    pParams->ready = false;
+    pParams->pNextReady = NULL;
+}
+
+/*-----------------------------------------------------------*/
+
+static int32_t stageVectors( UringTransportParams_t * pParams,
+                             const TransportOutVector_t * pIoVec,
+                             size_t ioVecCount )
+{
+    const UringTransportRing_t * pRing = pParams->pRing;
+    uint8_t * pTxBuffer = &pRing->config.pTxBuffers[ ( size_t ) pParams->txSlot *
+                                                     pRing->config.txBufferSize ];
+    int32_t bytesStaged = -1;
+    size_t index, space, chunk;
+    bool wasIdle;
+
+    if( ( pParams->writeInFlight == false ) && ( pParams->txHead > 0U ) )
+    {
+        /* Nothing references the buffer, so move any unwritten bytes to its
+         * start. */
+        ( void ) memmove( pTxBuffer, &pTxBuffer[ pParams->txHead ], pParams->txLength - pParams->txHead );
+        pParams->txLength -= pParams->txHead;
+        pParams->txHead = 0U;
+    }
+
+    if( pParams->closed == false )
+    {
+        wasIdle = ( pParams->writeInFlight == false );
+        space = pRing->config.txBufferSize - pParams->txLength;
+        bytesStaged = 0;
+
+        for( index = 0U; ( index < ioVecCount ) && ( space > 0U ); index++ )
+        {
+            chunk = ( pIoVec[ index ].iov_len < space ) ? pIoVec[ index ].iov_len : space;
+            ( void ) memcpy( &pTxBuffer[ pParams->txLength ], pIoVec[ index ].iov_base, chunk );
+            pParams->txLength += ( uint32_t ) chunk;
+            bytesStaged += ( int32_t ) chunk;
+            space -= chunk;
+        }
+
+        /* A write in flight picks up the new bytes when it completes. */
+        if( ( bytesStaged > 0 ) && ( wasIdle == true ) && ( queueWrite( pParams ) == false ) )
+        {
+            /* Take the bytes back, so the caller retries them. */
+            pParams->txLength -= ( uint32_t ) bytesStaged;
+            bytesStaged = 0;
+        }
+    }
+
+    return bytesStaged;
+}
+
+/*-----------------------------------------------------------*/
+
+UringTransportStatus_t UringTransport_InitRing( UringTransportRing_t * pRing,
+                                                const UringTransportRingConfig_t * pConfig )
+{
+    UringTransportStatus_t status = URING_TRANSPORT_SUCCESS;
+    struct iovec txRegion;
+
+    if( ( pRing == NULL ) || ( pConfig == NULL ) )
+    {
+        LogError( ( "Argument cannot be NULL: pRing=%p, pConfig=%p.",
+                    ( void * ) pRing,
+                    ( const void * ) pConfig ) );
+        status = URING_TRANSPORT_INVALID_PARAMETER;
+    }
+    else if( ( pConfig->entries == 0U ) || ( pConfig->pRxBuffers == NULL ) ||
+             ( pConfig->rxBufferSize == 0U ) || ( pConfig->rxBufferCount == 0U ) ||
+             ( pConfig->rxBufferCount > URING_TRANSPORT_MAX_RX_BUFFERS ) ||
+             ( ( pConfig->rxBufferCount & ( pConfig->rxBufferCount - 1U ) ) != 0U ) )
+    {
+        LogError( ( "Invalid receive buffers: entries=%lu, rxBufferSize=%lu, rxBufferCount=%lu.",
+                    ( unsigned long ) pConfig->entries,
+                    ( unsigned long ) pConfig->rxBufferSize,
+                    ( unsigned long ) pConfig->rxBufferCount ) );
+        status = URING_TRANSPORT_INVALID_PARAMETER;
+    }
+    else if( ( pConfig->pTxBuffers == NULL ) || ( pConfig->txBufferSize == 0U ) ||
+             ( pConfig->txBufferSize > ( uint32_t ) INT32_MAX ) || ( pConfig->txBufferCount == 0U ) ||
+             ( pConfig->txBufferCount > ( SIZE_MAX / pConfig->txBufferSize ) ) )
+    {
+        LogError( ( "Invalid transmit buffers: txBufferSize=%lu, txBufferCount=%lu.",
+                    ( unsigned long ) pConfig->txBufferSize,
+                    ( unsigned long ) pConfig->txBufferCount ) );
+        status = URING_TRANSPORT_INVALID_PARAMETER;
+    }
+    else
+    {
+        ( void ) memset( pRing, 0x00, sizeof( *pRing ) );
+        pRing->config = *pConfig;
+        status = setupQueues( pRing );
+
+        if( status == URING_TRANSPORT_SUCCESS )
+        {
+            status = setupBufferRing( pRing );
+        }
+
+        if( status == URING_TRANSPORT_SUCCESS )
+        {
+            /* Registering the transmit buffers once spares the kernel from
+             * pinning their pages for every write. */
+            txRegion.iov_base = pConfig->pTxBuffers;
+            txRegion.iov_len = ( size_t ) pConfig->txBufferCount * pConfig->txBufferSize;
+
+            if( syscall( __NR_io_uring_register, pRing->ringDescriptor,
+                         IORING_REGISTER_BUFFERS, &txRegion, 1U ) < 0 )
+            {
+                LogError( ( "Failed to register the transmit buffers: errno=%d.", errno ) );
+                status = URING_TRANSPORT_SYSTEM_ERROR;
+            }
+        }
+
+        if( status != URING_TRANSPORT_SUCCESS )
+        {
+            releaseRing( pRing );
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+UringTransportStatus_t UringTransport_CleanupRing( UringTransportRing_t * pRing )
+{
+    UringTransportStatus_t status = URING_TRANSPORT_SUCCESS;
+
+    if( ( pRing == NULL ) || ( pRing->ringDescriptor < 0 ) )
+    {
+        LogError( ( "The ring is not set up." ) );
+        status = URING_TRANSPORT_INVALID_PARAMETER;
+    }
+    else
+    {
+        releaseRing( pRing );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+UringTransportStatus_t UringTransport_Attach( NetworkContext_t * pNetworkContext,
+                                              UringTransportRing_t * pRing,
+                                              int socketDescriptor,
+                                              uint32_t txSlot )
+{
+    UringTransportStatus_t status = URING_TRANSPORT_SUCCESS;
+    UringTransportParams_t * pParams;
+    int flags;
+    int noDelay = 1;
+
+    if( ( pNetworkContext == NULL ) || ( pNetworkContext->pParams == NULL ) ||
+        ( pRing == NULL ) || ( pRing->ringDescriptor < 0 ) ||
+        ( socketDescriptor < 0 ) || ( txSlot >= pRing->config.txBufferCount ) )
+    {
+        LogError( ( "Invalid parameter: pNetworkContext=%p, pRing=%p, socketDescriptor=%d, txSlot=%lu.",
+                    ( void * ) pNetworkContext,
+                    ( void * ) pRing,
+                    socketDescriptor,
+                    ( unsigned long ) txSlot ) );
+        status = URING_TRANSPORT_INVALID_PARAMETER;
+    }
+    else
+    {
+        /* io_uring completes operations on blocking sockets asynchronously,
+         * whereas it fails them with EAGAIN on non-blocking ones. */
+        flags = fcntl( socketDescriptor, F_GETFL, 0 );
+
+        if( ( flags < 0 ) || ( fcntl( socketDescriptor, F_SETFL, flags & ~O_NONBLOCK ) < 0 ) )
+        {
+            LogError( ( "Failed to make socket %d blocking: errno=%d.", socketDescriptor, errno ) );
+            status = URING_TRANSPORT_SYSTEM_ERROR;
+        }
+    }
+
+    if( status == URING_TRANSPORT_SUCCESS )
+    {
+        /* Not all sockets are TCP sockets, so failure is not an error. */
+        ( void ) setsockopt( socketDescriptor, IPPROTO_TCP, TCP_NODELAY,
+                             &noDelay, ( socklen_t ) sizeof( noDelay ) );
+
+        pParams = pNetworkContext->pParams;
+        pParams->pRing = pRing;
+        pParams->socketDescriptor = socketDescriptor;
+        pParams->txSlot = txSlot;
+        pParams->txHead = 0U;
+        pParams->txLength = 0U;
+        pParams->rxOffset = 0U;
+        pParams->rxHead = URING_TRANSPORT_NO_BUFFER;
+        pParams->rxTail = URING_TRANSPORT_NO_BUFFER;
+        pParams->recvArmed = false;
+        pParams->writeInFlight = false;
+        pParams->closed = false;
+        pParams->ready = false;
+        pParams->pNextReady = NULL;
+
+        armRecv( pParams );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+UringTransportStatus_t UringTransport_Disconnect( const NetworkContext_t * pNetworkContext )
+{
+    UringTransportStatus_t status = URING_TRANSPORT_SUCCESS;
+    UringTransportParams_t * pParams = getParams( pNetworkContext );
+    uint16_t bufferId;
+
+    if( pParams == NULL )
+    {
+        LogError( ( "The network context is not attached." ) );
+        status = URING_TRANSPORT_INVALID_PARAMETER;
+    }
+    else
+    {
+        /* Let staged bytes, such as an MQTT DISCONNECT, reach the peer. */
+        while( ( pParams->writeInFlight == true ) && ( pParams->closed == false ) &&
+               ( enterRing( pParams->pRing, URING_TRANSPORT_DISCONNECT_WAIT_MS ) == URING_TRANSPORT_SUCCESS ) )
+        {
+            reapCompletions( pParams->pRing );
+        }
+
+        /* Shutting the socket down completes its operations, and the kernel
+         * must be done with the buffers of the connection before the
+         * parameters can be released. */
+        ( void ) shutdown( pParams->socketDescriptor, SHUT_RDWR );
+
+        while( ( ( pParams->recvArmed == true ) || ( pParams->writeInFlight == true ) ) &&
+               ( enterRing( pParams->pRing, URING_TRANSPORT_DISCONNECT_WAIT_MS ) == URING_TRANSPORT_SUCCESS ) )
+        {
+            reapCompletions( pParams->pRing );
+        }
+
+        ( void ) close( pParams->socketDescriptor );
+
+        while( pParams->rxHead != URING_TRANSPORT_NO_BUFFER )
+        {
+            bufferId = pParams->rxHead;
+            pParams->rxHead = getRxBufferInfo( pParams->pRing )[ bufferId ].next;
+            recycleRxBuffer( pParams->pRing, bufferId );
+        }
+
+        pParams->rxTail = URING_TRANSPORT_NO_BUFFER;
+        unlinkReady( pParams );
+        pParams->socketDescriptor = -1;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+UringTransportStatus_t UringTransport_Process( UringTransportRing_t * pRing,
+                                               uint32_t timeoutMs,
+                                               UringTransportReadyCallback_t readyCallback )
+{
+    UringTransportStatus_t status = URING_TRANSPORT_SUCCESS;
+    UringTransportParams_t * pParams;
+    uint32_t readyCount;
+
+    if( ( pRing == NULL ) || ( pRing->ringDescriptor < 0 ) || ( readyCallback == NULL ) )
+    {
+        LogError( ( "Invalid parameter: pRing=%p.", ( void * ) pRing ) );
+        status = URING_TRANSPORT_INVALID_PARAMETER;
+    }
+    else
+    {
+        /* Do not wait when connections are already waiting to be served. */
+        status = enterRing( pRing, ( pRing->pReadyHead == NULL ) ? timeoutMs : 0U );
+    }
+
+    if( status == URING_TRANSPORT_SUCCESS )
+    {
+        reapCompletions( pRing );
+
+        /* The callback may make connections ready again, or disconnect them,
+         * so they are popped one at a time, and connections made ready again
+         * are served by the next call. */
+        readyCount = pRing->readyCount;
+
+        while( ( readyCount > 0U ) && ( pRing->pReadyHead != NULL ) )
+        {
+            pParams = pRing->pReadyHead;
+            unlinkReady( pParams );
+            readyCallback( pParams );
+            readyCount--;
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+int32_t UringTransport_Recv( NetworkContext_t * pNetworkContext,
+                             void * pBuffer,
+                             size_t bytesToRecv )
+{
+    int32_t bytesReceived = -1;
+    UringTransportParams_t * pParams = getParams( pNetworkContext );
+    RxBufferInfo_t * pInfo;
+    uint8_t * pDestination = ( uint8_t * ) pBuffer;
+    const uint8_t * pSource;
+    size_t copied = 0U, chunk;
+    uint16_t bufferId;
+
+    if( ( pParams == NULL ) || ( pBuffer == NULL ) )
+    {
+        LogError( ( "Invalid parameter: pParams=%p, pBuffer=%p.",
+                    ( void * ) pParams, pBuffer ) );
+    }
+    else
+    {
+        pInfo = getRxBufferInfo( pParams->pRing );
+
+        if( ( pParams->rxHead == URING_TRANSPORT_NO_BUFFER ) && ( pParams->closed == false ) )
+        {
+            if( pParams->recvArmed == false )
+            {
+                armRecv( pParams );
+            }
+
+            /* Let callers which wait for a response make progress. */
+            if( enterRing( pParams->pRing, 0U ) == URING_TRANSPORT_SUCCESS )
+            {
+                reapCompletions( pParams->pRing );
+            }
+        }
+
+        while( ( copied < bytesToRecv ) && ( pParams->rxHead != URING_TRANSPORT_NO_BUFFER ) )
+        {
+            bufferId = pParams->rxHead;
+            pSource = &pParams->pRing->config.pRxBuffers[ ( size_t ) bufferId *
+                                                          pParams->pRing->config.rxBufferSize ];
+            chunk = pInfo[ bufferId ].length - pParams->rxOffset;
+            chunk = ( chunk < ( bytesToRecv - copied ) ) ? chunk : ( bytesToRecv - copied );
+
+            ( void ) memcpy( &pDestination[ copied ], &pSource[ pParams->rxOffset ], chunk );
+            copied += chunk;
+            pParams->rxOffset += ( uint32_t ) chunk;
+
+            if( pParams->rxOffset == pInfo[ bufferId ].length )
+            {
+                pParams->rxHead = pInfo[ bufferId ].next;
+                pParams->rxOffset = 0U;
+
+                if( pParams->rxHead == URING_TRANSPORT_NO_BUFFER )
+                {
+                    pParams->rxTail = URING_TRANSPORT_NO_BUFFER;
+                }
+
+                recycleRxBuffer( pParams->pRing, bufferId );
+            }
+        }
+
+        if( copied > 0U )
+        {
+            /* The interface returns int32_t, and a caller never asks for more
+             * than its network buffer. */
+            bytesReceived = ( copied > ( size_t ) INT32_MAX ) ? INT32_MAX : ( int32_t ) copied;
+        }
+        else if( pParams->closed == false )
+        {
+            bytesReceived = 0;
+        }
+        else
+        {
+            /* Every received byte has been consumed. */
+            bytesReceived = -1;
+        }
+    }
+
+    return bytesReceived;
+}
+
+/*-----------------------------------------------------------*/
+
+int32_t UringTransport_Send( NetworkContext_t * pNetworkContext,
+                             const void * pBuffer,
+                             size_t bytesToSend )
+{
+    TransportOutVector_t ioVector;
+
+    ioVector.iov_base = pBuffer;
+    ioVector.iov_len = bytesToSend;
+
+    return UringTransport_Writev( pNetworkContext, &ioVector, 1U );
+}
+
+/*-----------------------------------------------------------*/
+
+int32_t UringTransport_Writev( NetworkContext_t * pNetworkContext,
+                               TransportOutVector_t * pIoVec,
+                               size_t ioVecCount )
+{
+    int32_t bytesSent = -1;
+    UringTransportParams_t * pParams = getParams( pNetworkContext );
+
+    if( ( pParams == NULL ) || ( pIoVec == NULL ) )
+    {
+        LogError( ( "Invalid parameter: pParams=%p, pIoVec=%p.",
+                    ( void * ) pParams, ( void * ) pIoVec ) );
+    }
+    else
+    {
+        bytesSent = stageVectors( pParams, pIoVec, ioVecCount );
+
+        if( bytesSent == 0 )
+        {
+            /* The transmit buffer is full; let the kernel drain it, so that
+             * the caller's retry can make progress without a reactor. */
+            if( enterRing( pParams->pRing, 0U ) == URING_TRANSPORT_SUCCESS )
+            {
+                reapCompletions( pParams->pRing );
+            }
+
+            bytesSent = stageVectors( pParams, pIoVec, ioVecCount );
+        }
+    }
+
+    return bytesSent;
+}
+
+/*-----------------------------------------------------------*/
@@ -0,0 +1,404 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file uring_transport.h
+ * @brief Reference implementation of the transport interface over Linux
+ * io_uring, serving many connections from one ring.
+ *
+ * Each connection keeps a multishot receive armed, which fills buffers taken
+ * from a pool shared by all connections of the ring, and stages outgoing data
+ * in a registered buffer of its own. Neither #UringTransport_Recv nor
+ * #UringTransport_Send enter the kernel while there is data to consume or
+ * space to stage into; instead, #UringTransport_Process submits the queued
+ * sends and receives of every connection and reaps their completions with a
+ * single `io_uring_enter` call, then reports the connections with new data.
+ *
+ * A ring and its connections must be used from a single thread.
+ *
+ * Every compilation unit which uses this transport must define
+ * `struct NetworkContext` with a `pParams` member pointing to a
+ * #UringTransportParams_t:
+ *
+ * @code{c}
+ * struct NetworkContext
+ * {
+ *     UringTransportParams_t * pParams;
+ * };
+ * @endcode
+ */
+
+#ifndef URING_TRANSPORT_H_
+#define URING_TRANSPORT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include <linux/io_uring.h>
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    extern "C" {
+#endif
+/* *INDENT-ON* */
+
+/* Include transport interface. */
+#include "transport_interface.h"
+
+/**
+ * @brief Maximum number of receive buffers of a ring.
+ *
+ * Buffer IDs are 16 bits wide in io_uring, and one value is reserved to
+ * terminate the lists of received buffers.
+ */
+#define URING_TRANSPORT_MAX_RX_BUFFERS    ( 32768U )
+
+/**
+ * @brief Return codes of the ring and connection management functions of the
+ * transport.
+ */
+typedef enum UringTransportStatus
+{
+    URING_TRANSPORT_SUCCESS = 0,       /**< @brief Function successfully completed. */
+    URING_TRANSPORT_INVALID_PARAMETER, /**< @brief At least one parameter was invalid. */
+    URING_TRANSPORT_SYSTEM_ERROR       /**< @brief An io_uring or socket system call failed. */
+} UringTransportStatus_t;
+
+/**
+ * @brief Memory given to a ring by the application.
+ */
+typedef struct UringTransportRingConfig
+{
+    uint32_t entries;       /**< @brief Number of submission queue entries. */
+    uint8_t * pRxBuffers;   /**< @brief Receive buffers shared by all connections, `rxBufferCount * rxBufferSize` bytes. */
+    uint32_t rxBufferSize;  /**< @brief Size of each receive buffer. */
+    uint32_t rxBufferCount; /**< @brief Number of receive buffers, a power of 2 up to #URING_TRANSPORT_MAX_RX_BUFFERS. */
+    uint8_t * pTxBuffers;   /**< @brief Transmit buffers, one per connection slot, `txBufferCount * txBufferSize` bytes. */
+    uint32_t txBufferSize;  /**< @brief Size of each transmit buffer. */
+    uint32_t txBufferCount; /**< @brief Number of connection slots. */
+} UringTransportRingConfig_t;
+
+/**
+ * @brief An io_uring instance serving many connections.
+ *
+ * @note The members of this struct are managed by the transport and must not
+ * be accessed by the application.
+ */
+typedef struct UringTransportRing
+{
+    /**
+     * @brief The io_uring file descriptor.
+     */
+    int ringDescriptor;
+
+    /**
+     * @brief Memory given to the ring.
+     */
+    UringTransportRingConfig_t config;
+
+    /**
+     * @brief Mapping of the submission and completion queue rings.
+     */
+    uint8_t * pQueueRings;
+
+    /**
+     * @brief Size of #UringTransportRing_t.pQueueRings.
+     */
+    size_t queueRingsSize;
+
+    /**
+     * @brief Mapping of the submission queue entries.
+     */
+    struct io_uring_sqe * pSqes;
+
+    /**
+     * @brief Size of #UringTransportRing_t.pSqes.
+     */
+    size_t sqesSize;
+
+    /**
+     * @brief Kernel side head of the submission queue.
+     */
+    uint32_t * pSqHead;
+
+    /**
+     * @brief Shared tail of the submission queue.
+     */
+    uint32_t * pSqTail;
+
+    /**
+     * @brief Local tail of the submission queue.
+     */
+    uint32_t sqTail;
+
+    /**
+     * @brief Mask of the submission queue indices.
+     */
+    uint32_t sqMask;
+
+    /**
+     * @brief Number of entries of the submission queue.
+     */
+    uint32_t sqEntries;
+
+    /**
+     * @brief Entries queued but not yet submitted to the kernel.
+     */
+    uint32_t pendingSubmissions;
+
+    /**
+     * @brief Shared head of the completion queue.
+     */
+    uint32_t * pCqHead;
+
+    /**
+     * @brief Kernel side tail of the completion queue.
+     */
+    uint32_t * pCqTail;
+
+    /**
+     * @brief Mask of the completion queue indices.
+     */
+    uint32_t cqMask;
+
+    /**
+     * @brief Completion queue entries.
+     */
+    struct io_uring_cqe * pCqes;
+
+    /**
+     * @brief Provided buffer ring from which receives take their buffers,
+     * followed by the bookkeeping of each receive buffer.
+     */
+    uint8_t * pBufferRing;
+
+    /**
+     * @brief Size of #UringTransportRing_t.pBufferRing.
+     */
+    size_t bufferRingSize;
+
+    /**
+     * @brief Local tail of the provided buffer ring.
+     */
+    uint16_t bufferRingTail;
+
+    /**
+     * @brief First connection with new data or events to report.
+     */
+    struct UringTransportParams * pReadyHead;
+
+    /**
+     * @brief Last connection with new data or events to report.
+     */
+    struct UringTransportParams * pReadyTail;
+
+    /**
+     * @brief Number of connections in the ready list.
+     */
+    uint32_t readyCount;
+} UringTransportRing_t;
+
+/**
+ * @brief Parameters of a connection, referenced by the `pParams` member of
+ * `struct NetworkContext`.
+ *
+ * @note Only #UringTransportParams_t.pAppContext may be accessed by the
+ * application; the other members are managed by the transport.
+ */
+typedef struct UringTransportParams
+{
+    void * pAppContext;                       /**< @brief Application data, such as the MQTT context of the connection. */
+    UringTransportRing_t * pRing;             /**< @brief The ring serving the connection. */
+    int socketDescriptor;                     /**< @brief The socket of the connection, or -1 if not attached. */
+    uint32_t txSlot;                          /**< @brief Index of the transmit buffer of the connection. */
+    uint32_t txHead;                          /**< @brief Offset of the first staged byte not yet written. */
+    uint32_t txLength;                        /**< @brief Number of bytes in the transmit buffer. */
+    uint32_t rxOffset;                        /**< @brief Bytes already consumed from the first received buffer. */
+    uint16_t rxHead;                          /**< @brief First received buffer not yet consumed. */
+    uint16_t rxTail;                          /**< @brief Last received buffer not yet consumed. */
+    bool recvArmed;                           /**< @brief Whether a multishot receive is queued or active. */
+    bool writeInFlight;                       /**< @brief Whether a write is queued or active. */
+    bool closed;                              /**< @brief Whether the connection failed or was closed by the peer. */
+    bool ready;                               /**< @brief Whether the connection is in the ready list of the ring. */
+    struct UringTransportParams * pNextReady; /**< @brief Next connection in the ready list of the ring. */
+} UringTransportParams_t;
+
+/**
+ * @brief Application callback invoked by #UringTransport_Process for each
+ * connection with new data, or which was closed.
+ *
+ * The callback typically runs #MQTT_ProcessLoop on the MQTT context stored in
+ * #UringTransportParams_t.pAppContext.
+ *
+ * @param[in] pParams Parameters of the connection.
+ */
+typedef void (* UringTransportReadyCallback_t )( UringTransportParams_t * pParams );
+
+/**
+ * @brief Set up an io_uring instance and register its buffers.
+ *
+ * @param[out] pRing The ring to set up.
+ * @param[in] pConfig Memory given to the ring, which must remain valid until
+ * #UringTransport_CleanupRing is called.
+ *
+ * @return #URING_TRANSPORT_SUCCESS, #URING_TRANSPORT_INVALID_PARAMETER or
+ * #URING_TRANSPORT_SYSTEM_ERROR.
+ */
+/* @[declare_uringtransport_initring] */
+UringTransportStatus_t UringTransport_InitRing( UringTransportRing_t * pRing,
+                                                const UringTransportRingConfig_t * pConfig );
+/* @[declare_uringtransport_initring] */
+
+/**
+ * @brief Tear down an io_uring instance. All of its connections must have
+ * been disconnected.
+ *
+ * @param[in] pRing The ring to tear down.
+ *
+ * @return #URING_TRANSPORT_SUCCESS or #URING_TRANSPORT_INVALID_PARAMETER.
+ */
+/* @[declare_uringtransport_cleanupring] */
+UringTransportStatus_t UringTransport_CleanupRing( UringTransportRing_t * pRing );
+/* @[declare_uringtransport_cleanupring] */
+
+/**
+ * @brief Serve a connected socket from a ring, and arm its receive.
+ *
+ * The socket is put into blocking mode, so that io_uring waits for readiness
+ * itself rather than failing with `EAGAIN`; the calling thread never blocks on
+ * it.
+ *
+ * @param[in] pNetworkContext Network context of the connection.
+ * @param[in] pRing The ring serving the connection.
+ * @param[in] socketDescriptor The connected socket.
+ * @param[in] txSlot Index of the transmit buffer of the connection, which must
+ * not be used by another connection of the ring.
+ *
+ * @return #URING_TRANSPORT_SUCCESS, #URING_TRANSPORT_INVALID_PARAMETER or
+ * #URING_TRANSPORT_SYSTEM_ERROR.
+ */
+/* @[declare_uringtransport_attach] */
+UringTransportStatus_t UringTransport_Attach( NetworkContext_t * pNetworkContext,
+                                              UringTransportRing_t * pRing,
+                                              int socketDescriptor,
+                                              uint32_t txSlot );
+/* @[declare_uringtransport_attach] */
+
+/**
+ * @brief Write the staged data of a connection and close it, once the kernel
+ * has finished its operations on the buffers of the connection.
+ *
+ * @param[in] pNetworkContext Network context of the connection.
+ *
+ * @return #URING_TRANSPORT_SUCCESS or #URING_TRANSPORT_INVALID_PARAMETER.
+ */
+/* @[declare_uringtransport_disconnect] */
+UringTransportStatus_t UringTransport_Disconnect( const NetworkContext_t * pNetworkContext );
+/* @[declare_uringtransport_disconnect] */
+
+/**
+ * @brief Submit the queued operations of all connections of a ring, reap
+ * their completions, and invoke a callback for each connection with new data.
+ *
+ * @param[in] pRing The ring.
+ * @param[in] timeoutMs Time to wait for a completion if none is available;
+ * 0 to return immediately.
+ * @param[in] readyCallback Callback invoked for each connection with new data,
+ * or which was closed.
+ *
+ * @return #URING_TRANSPORT_SUCCESS, #URING_TRANSPORT_INVALID_PARAMETER or
+ * #URING_TRANSPORT_SYSTEM_ERROR.
+ */
+/* @[declare_uringtransport_process] */
+UringTransportStatus_t UringTransport_Process( UringTransportRing_t * pRing,
+                                               uint32_t timeoutMs,
+                                               UringTransportReadyCallback_t readyCallback );
+/* @[declare_uringtransport_process] */
+
+/**
+ * @brief Copy received data of the connection.
+ *
+ * Implements #TransportRecv_t. When no data has been received, the ring is
+ * flushed once without waiting, so that calls of the MQTT library which wait
+ * for a response, such as #MQTT_Connect, make progress without
+ * #UringTransport_Process.
+ *
+ * @param[in] pNetworkContext Network context of the connection.
+ * @param[out] pBuffer Buffer to receive the data into.
+ * @param[in] bytesToRecv Size of @p pBuffer.
+ *
+ * @return The number of bytes received; 0 if no data is available; a negative
+ * value if the connection failed or was closed by the peer.
+ */
+/* @[declare_uringtransport_recv] */
+int32_t UringTransport_Recv( NetworkContext_t * pNetworkContext,
+                             void * pBuffer,
+                             size_t bytesToRecv );
+/* @[declare_uringtransport_recv] */
+
+/**
+ * @brief Stage data to be written by the next submission of the ring.
+ *
+ * Implements #TransportSend_t.
+ *
+ * @param[in] pNetworkContext Network context of the connection.
+ * @param[in] pBuffer Data to send.
+ * @param[in] bytesToSend Number of bytes in @p pBuffer.
+ *
+ * @return The number of bytes staged; 0 if the transmit buffer is full; a
+ * negative value if the connection failed.
+ */
+/* @[declare_uringtransport_send] */
+int32_t UringTransport_Send( NetworkContext_t * pNetworkContext,
+                             const void * pBuffer,
+                             size_t bytesToSend );
+/* @[declare_uringtransport_send] */
+
+/**
+ * @brief Stage a list of buffers to be written by the next submission of the
+ * ring, as a single write.
+ *
+ * Implements #TransportWritev_t.
+ *
+ * @param[in] pNetworkContext Network context of the connection.
+ * @param[in] pIoVec The buffers to send.
+ * @param[in] ioVecCount Number of buffers in @p pIoVec.
+ *
+ * @return The number of bytes staged; 0 if the transmit buffer is full; a
+ * negative value if the connection failed.
+ */
+/* @[declare_uringtransport_writev] */
+int32_t UringTransport_Writev( NetworkContext_t * pNetworkContext,
+                               TransportOutVector_t * pIoVec,
+                               size_t ioVecCount );
+/* @[declare_uringtransport_writev] */
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    }
+#endif
+/* *INDENT-ON* */
+
+#endif /* ifndef URING_TRANSPORT_H_ */
@@ -0,0 +1,1118 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file websocket_transport.c
+ * @brief Implements client side WebSocket framing over another transport.
+ */
+
+/* snprintf requires POSIX.1-2001 when building as C90. */
+#ifndef _POSIX_C_SOURCE
+    #define _POSIX_C_SOURCE    200809L
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include "websocket_transport.h"
+
+/* Include config defaults header to get default values of configs. */
+#include "core_mqtt_config_defaults.h"
+
+#if ( WEBSOCKET_TRANSPORT_USE_SIMD != 0 )
+    #if defined( __AVX2__ )
+        #include <immintrin.h>
+    #elif defined( __SSE2__ ) || defined( _M_X64 )
+        #include <emmintrin.h>
+    #elif defined( __ARM_NEON )
+        #include <arm_neon.h>
+    #endif
+#endif
+
+/**
+ * @brief Each compilation unit that uses the transport must define the
+ * NetworkContext struct.
+ */
+struct NetworkContext
+{
+    WebSocketTransportParams_t * pParams;
+};
+
+/**
+ * @brief Frame opcodes.
+ */
+#define WEBSOCKET_OPCODE_CONTINUATION    ( 0x0U )
+#define WEBSOCKET_OPCODE_BINARY          ( 0x2U )
+#define WEBSOCKET_OPCODE_CLOSE           ( 0x8U )
+#define WEBSOCKET_OPCODE_PING            ( 0x9U )
+#define WEBSOCKET_OPCODE_PONG            ( 0xAU )
+
+/**
+ * @brief Bits of the first two bytes of a frame header.
+ */
+#define WEBSOCKET_FIN_BIT                ( 0x80U )
+#define WEBSOCKET_OPCODE_MASK            ( 0x0FU )
+#define WEBSOCKET_CONTROL_BIT            ( 0x08U )
+#define WEBSOCKET_MASK_BIT               ( 0x80U )
+#define WEBSOCKET_LENGTH_MASK            ( 0x7FU )
+
+/**
+ * @brief Payload length values announcing a 16-bit or a 64-bit extended length.
+ */
+#define WEBSOCKET_LENGTH_16_BIT          ( 126U )
+#define WEBSOCKET_LENGTH_64_BIT          ( 127U )
+
+/**
+ * @brief Size of a masking key.
+ */
+#define WEBSOCKET_MASK_KEY_SIZE          ( 4U )
+
+/**
+ * @brief Size of the handshake key before and after base64 encoding.
+ */
+#define WEBSOCKET_KEY_SIZE               ( 16U )
+#define WEBSOCKET_KEY_ENCODED_SIZE       ( 24U )
+
+/**
+ * @brief Size of a SHA-1 digest, and of its base64 encoding.
+ */
+#define WEBSOCKET_SHA1_SIZE              ( 20U )
+#define WEBSOCKET_ACCEPT_ENCODED_SIZE    ( 28U )
+
+/**
+ * @brief GUID appended to the handshake key to compute the accept value.
+ */
+#define WEBSOCKET_GUID                   "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+/**
+ * @brief Size of the buffer receiving the handshake response headers.
+ */
+#define WEBSOCKET_RESPONSE_BUFFER_SIZE   ( 1024U )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Get the parameters of a network context.
+ *
+ * @param[in] pNetworkContext Network context of the WebSocket.
+ *
+ * @return The parameters, or NULL if the network context is not set up.
+ */
+static WebSocketTransportParams_t * getParams( const NetworkContext_t * pNetworkContext );
+
+/**
+ * @brief XOR a buffer with a repeating masking key while copying it.
+ *
+ * @param[out] pDestination Where to write the masked bytes; may equal
+ * @p pSource.
+ * @param[in] pSource The bytes to mask.
+ * @param[in] length Number of bytes to mask.
+ * @param[in] pMaskKey The 4 byte masking key.
+ * @param[in,out] pPhase Position in the masking key of the first byte; updated
+ * to the position after the last byte.
+ */
+static void maskCopy( uint8_t * pDestination,
+                      const uint8_t * pSource,
+                      size_t length,
+                      const uint8_t * pMaskKey,
+                      uint8_t * pPhase );
+
+/**
+ * @brief Write a masked frame header into the transmit buffer.
+ *
+ * @param[in] pParams Parameters of the WebSocket.
+ * @param[in] opcode Opcode of the frame.
+ * @param[in] payloadLength Payload length of the frame.
+ * @param[out] pMaskKey Receives the masking key of the frame.
+ *
+ * @return Size of the header.
+ */
+static size_t writeFrameHeader( WebSocketTransportParams_t * pParams,
+                                uint8_t opcode,
+                                size_t payloadLength,
+                                uint8_t * pMaskKey );
+
+/**
+ * @brief Send the unsent bytes of the last frame, and then a pending pong.
+ *
+ * @param[in] pParams Parameters of the WebSocket.
+ *
+ * @return 1 if nothing is left to send; 0 if the underlying transport cannot
+ * take more bytes now; -1 if it failed.
+ */
+static int32_t flushPending( WebSocketTransportParams_t * pParams );
+
+/**
+ * @brief Parse a complete frame header.
+ *
+ * @param[in] pParams Parameters of the WebSocket.
+ *
+ * @return true if the header is valid; false otherwise.
+ */
+static bool parseFrameHeader( WebSocketTransportParams_t * pParams );
+
+/**
+ * @brief Act on a completely received control frame.
+ *
+ * @param[in] pParams Parameters of the WebSocket.
+ */
+static void handleControlFrame( WebSocketTransportParams_t * pParams );
+
+/**
+ * @brief Encode bytes as base64.
+ *
+ * @param[in] pData The bytes to encode.
+ * @param[in] length Number of bytes to encode.
+ * @param[out] pEncoded Receives `4 * ceil( length / 3 )` characters and a
+ * terminating NUL.
+ */
+static void base64Encode( const uint8_t * pData,
+                          size_t length,
+                          char * pEncoded );
+
+/**
+ * @brief Compute the SHA-1 digest of a message.
+ *
+ * @param[in] pData The message.
+ * @param[in] length Length of the message.
+ * @param[out] pDigest Receives the #WEBSOCKET_SHA1_SIZE byte digest.
+ */
+static void sha1( const uint8_t * pData,
+                  size_t length,
+                  uint8_t * pDigest );
+
+/**
+ * @brief Apply one 64 byte block to a SHA-1 state.
+ *
+ * @param[in,out] pState The five state words.
+ * @param[in] pBlock The block.
+ */
+static void sha1Block( uint32_t * pState,
+                       const uint8_t * pBlock );
+
+/**
+ * @brief Check the status line and the accept header of a handshake response.
+ *
+ * @param[in] pResponse The NUL terminated response headers.
+ * @param[in] pExpectedAccept The expected value of the accept header.
+ *
+ * @return true if the server accepted the upgrade; false otherwise.
+ */
+static bool validateResponse( const char * pResponse,
+                              const char * pExpectedAccept );
+
+/*-----------------------------------------------------------*/
+
+static WebSocketTransportParams_t * getParams( const NetworkContext_t * pNetworkContext )
+{
+    WebSocketTransportParams_t * pParams = NULL;
+
+    if( ( pNetworkContext != NULL ) && ( pNetworkContext->pParams != NULL ) &&
+        ( pNetworkContext->pParams->pTxBuffer != NULL ) )
+    {
+        pParams = pNetworkContext->pParams;
+    }
+
+    return pParams;
+}
+
+/*-----------------------------------------------------------*/
+
+static void maskCopy( uint8_t * pDestination,
+                      const uint8_t * pSource,
+                      size_t length,
+                      const uint8_t * pMaskKey,
+                      uint8_t * pPhase )
+{
+    uint8_t rotatedKey[ 32 ];
+    uint64_t keyWord, dataWord;
+    size_t index = 0U;
+
+    /* Rotate the key to the current phase and repeat it, so that every block
+     * below starts at phase 0 of the repeated key. Blocks are multiples of
+     * the key size, which leaves the phase unchanged. */
+    for( index = 0U; index < sizeof( rotatedKey ); index++ )
+    {
+        rotatedKey[ index ] = pMaskKey[ ( *pPhase + index ) % WEBSOCKET_MASK_KEY_SIZE ];
+    }
+
+    index = 0U;
+
+    #if ( WEBSOCKET_TRANSPORT_USE_SIMD != 0 ) && defined( __AVX2__ )
+    {
+        __m256i key256 = _mm256_loadu_si256( ( const __m256i * ) rotatedKey );
+
+        for( ; ( index + 32U ) <= length; index += 32U )
+        {
+            _mm256_storeu_si256( ( __m256i * ) &pDestination[ index ],
+                                 _mm256_xor_si256( _mm256_loadu_si256( ( const __m256i * ) &pSource[ index ] ),
+                                                   key256 ) );
+        }
+    }
+    #endif
+
+    #if ( WEBSOCKET_TRANSPORT_USE_SIMD != 0 ) && ( defined( __SSE2__ ) || defined( _M_X64 ) )
+    {
+        __m128i key128 = _mm_loadu_si128( ( const __m128i * ) rotatedKey );
+
+        for( ; ( index + 16U ) <= length; index += 16U )
+        {
+            _mm_storeu_si128( ( __m128i * ) &pDestination[ index ],
+                              _mm_xor_si128( _mm_loadu_si128( ( const __m128i * ) &pSource[ index ] ),
+                                             key128 ) );
+        }
+    }
+    #elif ( WEBSOCKET_TRANSPORT_USE_SIMD != 0 ) && defined( __ARM_NEON )
+    {
+        uint8x16_t key128 = vld1q_u8( rotatedKey );
+
+        for( ; ( index + 16U ) <= length; index += 16U )
+        {
+            vst1q_u8( &pDestination[ index ], veorq_u8( vld1q_u8( &pSource[ index ] ), key128 ) );
+        }
+    }
+    #endif
+
+    /* Portable word-wise loop, which also handles what the vector loops
+     * left. memcpy keeps unaligned accesses well defined. */
+    ( void ) memcpy( &keyWord, rotatedKey, sizeof( keyWord ) );
+
+    for( ; ( index + sizeof( dataWord ) ) <= length; index += sizeof( dataWord ) )
+    {
+        ( void ) memcpy( &dataWord, &pSource[ index ], sizeof( dataWord ) );
+        dataWord ^= keyWord;
+        ( void ) memcpy( &pDestination[ index ], &dataWord, sizeof( dataWord ) );
+    }
+
+    for( ; index < length; index++ )
+    {
+        pDestination[ index ] = pSource[ index ] ^ rotatedKey[ index % WEBSOCKET_MASK_KEY_SIZE ];
+    }
+
+    *pPhase = ( uint8_t ) ( ( *pPhase + length ) % WEBSOCKET_MASK_KEY_SIZE );
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t writeFrameHeader( WebSocketTransportParams_t * pParams,
+                                uint8_t opcode,
+                                size_t payloadLength,
+                                uint8_t * pMaskKey )
+{
+    uint8_t * pHeader = pParams->pTxBuffer;
+    uint32_t maskWord = pParams->getRandom();
+    size_t headerSize = 2U;
+    size_t index;
+
+    pHeader[ 0 ] = ( uint8_t ) ( WEBSOCKET_FIN_BIT | opcode );
+
+    if( payloadLength < WEBSOCKET_LENGTH_16_BIT )
+    {
+        pHeader[ 1 ] = ( uint8_t ) ( WEBSOCKET_MASK_BIT | payloadLength );
+    }
+    else if( payloadLength <= 0xFFFFU )
+    {
+        pHeader[ 1 ] = ( uint8_t ) ( WEBSOCKET_MASK_BIT | WEBSOCKET_LENGTH_16_BIT );
+        pHeader[ 2 ] = ( uint8_t ) ( payloadLength >> 8 );
+        pHeader[ 3 ] = ( uint8_t ) payloadLength;
+        headerSize = 4U;
+    }
+    else
+    {
+        pHeader[ 1 ] = ( uint8_t ) ( WEBSOCKET_MASK_BIT | WEBSOCKET_LENGTH_64_BIT );
+
+        for( index = 0U; index < 8U; index++ )
+        {
+            pHeader[ 2U + index ] = ( uint8_t ) ( ( uint64_t ) payloadLength >> ( 56U - ( 8U * index ) ) );
+        }
+
+        headerSize = 10U;
+    }
+
+    pMaskKey[ 0 ] = ( uint8_t ) ( maskWord >> 24 );
+    pMaskKey[ 1 ] = ( uint8_t ) ( maskWord >> 16 );
+    pMaskKey[ 2 ] = ( uint8_t ) ( maskWord >> 8 );
+    pMaskKey[ 3 ] = ( uint8_t ) maskWord;
+    ( void ) memcpy( &pHeader[ headerSize ], pMaskKey, WEBSOCKET_MASK_KEY_SIZE );
+
+    return headerSize + WEBSOCKET_MASK_KEY_SIZE;
+}
+
+/*-----------------------------------------------------------*/
+
+static int32_t flushPending( WebSocketTransportParams_t * pParams )
+{
+    int32_t result = 1;
+    int32_t bytesSent;
+    uint8_t maskKey[ WEBSOCKET_MASK_KEY_SIZE ];
+    uint8_t phase = 0U;
+    size_t headerSize;
+
+    while( ( result == 1 ) && ( ( pParams->txPendingLength > 0U ) || ( pParams->pongPending == true ) ) )
+    {
+        if( pParams->txPendingLength == 0U )
+        {
+            /* Frames are never interleaved, so the pong goes out between
+             * them. */
+            headerSize = writeFrameHeader( pParams, WEBSOCKET_OPCODE_PONG, pParams->pongLength, maskKey );
+            maskCopy( &pParams->pTxBuffer[ headerSize ], pParams->pong, pParams->pongLength, maskKey, &phase );
+            pParams->txPendingOffset = 0U;
+            pParams->txPendingLength = headerSize + pParams->pongLength;
+            pParams->pongPending = false;
+        }
+
+        bytesSent = pParams->underlying.send( pParams->underlying.pNetworkContext,
+                                              &pParams->pTxBuffer[ pParams->txPendingOffset ],
+                                              pParams->txPendingLength );
+
+        if( bytesSent < 0 )
+        {
+            LogError( ( "Underlying transport failed to send: bytesSent=%ld.", ( long int ) bytesSent ) );
+            result = -1;
+        }
+        else if( bytesSent == 0 )
+        {
+            result = 0;
+        }
+        else
+        {
+            pParams->txPendingOffset += ( size_t ) bytesSent;
+            pParams->txPendingLength -= ( size_t ) bytesSent;
+        }
+    }
+
+    return result;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool parseFrameHeader( WebSocketTransportParams_t * pParams )
+{
+    bool valid = true;
+    const uint8_t * pHeader = pParams->rxHeader;
+    uint8_t lengthCode = pHeader[ 1 ] & WEBSOCKET_LENGTH_MASK;
+    size_t offset = 2U;
+    size_t index;
+
+    pParams->rxOpcode = pHeader[ 0 ] & WEBSOCKET_OPCODE_MASK;
+    pParams->rxMasked = ( ( pHeader[ 1 ] & WEBSOCKET_MASK_BIT ) != 0U );
+    pParams->rxMaskPhase = 0U;
+
+    if( lengthCode == WEBSOCKET_LENGTH_16_BIT )
+    {
+        pParams->rxRemaining = ( ( uint64_t ) pHeader[ 2 ] << 8 ) | pHeader[ 3 ];
+        offset = 4U;
+    }
+    else if( lengthCode == WEBSOCKET_LENGTH_64_BIT )
+    {
+        pParams->rxRemaining = 0U;
+
+        for( index = 0U; index < 8U; index++ )
+        {
+            pParams->rxRemaining = ( pParams->rxRemaining << 8 ) | pHeader[ 2U + index ];
+        }
+
+        offset = 10U;
+    }
+    else
+    {
+        pParams->rxRemaining = lengthCode;
+    }
+
+    /* Keep the masking key, if any, at the start of the header buffer. */
+    if( pParams->rxMasked == true )
+    {
+        ( void ) memmove( pParams->rxHeader, &pHeader[ offset ], WEBSOCKET_MASK_KEY_SIZE );
+    }
+
+    if( ( pParams->rxOpcode & WEBSOCKET_CONTROL_BIT ) != 0U )
+    {
+        if( ( pParams->rxRemaining > WEBSOCKET_TRANSPORT_MAX_CONTROL_SIZE ) ||
+            ( ( pParams->rxOpcode != WEBSOCKET_OPCODE_CLOSE ) &&
+              ( pParams->rxOpcode != WEBSOCKET_OPCODE_PING ) &&
+              ( pParams->rxOpcode != WEBSOCKET_OPCODE_PONG ) ) )
+        {
+            LogError( ( "Invalid control frame: opcode=0x%x.", ( unsigned int ) pParams->rxOpcode ) );
+            valid = false;
+        }
+
+        pParams->controlLength = 0U;
+    }
+    else if( ( pParams->rxOpcode != WEBSOCKET_OPCODE_BINARY ) &&
+             ( pParams->rxOpcode != WEBSOCKET_OPCODE_CONTINUATION ) )
+    {
+        /* MQTT is only carried in binary messages. */
+        LogError( ( "Unexpected data frame: opcode=0x%x.", ( unsigned int ) pParams->rxOpcode ) );
+        valid = false;
+    }
+    else
+    {
+        /* MISRA else */
+    }
+
+    return valid;
+}
+
+/*-----------------------------------------------------------*/
+
+static void handleControlFrame( WebSocketTransportParams_t * pParams )
+{
+    if( pParams->rxMasked == true )
+    {
+        maskCopy( pParams->control, pParams->control, pParams->controlLength,
+                  pParams->rxHeader, &pParams->rxMaskPhase );
+    }
+
+    if( pParams->rxOpcode == WEBSOCKET_OPCODE_PING )
+    {
+        /* Only the latest ping needs an answer. */
+        ( void ) memcpy( pParams->pong, pParams->control, pParams->controlLength );
+        pParams->pongLength = pParams->controlLength;
+        pParams->pongPending = true;
+    }
+    else if( pParams->rxOpcode == WEBSOCKET_OPCODE_CLOSE )
+    {
+        LogInfo( ( "The server closed the WebSocket." ) );
+        pParams->closed = true;
+    }
+    else
+    {
+        /* Unsolicited pongs are ignored. */
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void base64Encode( const uint8_t * pData,
+                          size_t length,
+                          char * pEncoded )
+{
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    uint32_t group;
+    size_t inIndex, outIndex = 0U;
+
+    for( inIndex = 0U; inIndex < length; inIndex += 3U )
+    {
+        group = ( uint32_t ) pData[ inIndex ] << 16;
+        group |= ( ( inIndex + 1U ) < length ) ? ( ( uint32_t ) pData[ inIndex + 1U ] << 8 ) : 0U;
+        group |= ( ( inIndex + 2U ) < length ) ? ( uint32_t ) pData[ inIndex + 2U ] : 0U;
+
+        pEncoded[ outIndex ] = alphabet[ ( group >> 18 ) & 0x3FU ];
+        pEncoded[ outIndex + 1U ] = alphabet[ ( group >> 12 ) & 0x3FU ];
+        pEncoded[ outIndex + 2U ] = ( ( inIndex + 1U ) < length ) ? alphabet[ ( group >> 6 ) & 0x3FU ] : '=';
+        pEncoded[ outIndex + 3U ] = ( ( inIndex + 2U ) < length ) ? alphabet[ group & 0x3FU ] : '=';
+        outIndex += 4U;
+    }
+
+    pEncoded[ outIndex ] = '\0';
+}
+
+/*-----------------------------------------------------------*/
+
+static void sha1Block( uint32_t * pState,
+                       const uint8_t * pBlock )
+{
+    uint32_t words[ 80 ];
+    uint32_t a = pState[ 0 ], b = pState[ 1 ], c = pState[ 2 ], d = pState[ 3 ], e = pState[ 4 ];
+    uint32_t f, k, temp;
+    size_t index;
+
+    for( index = 0U; index < 16U; index++ )
+    {
+        words[ index ] = ( ( uint32_t ) pBlock[ 4U * index ] << 24 ) |
+                         ( ( uint32_t ) pBlock[ ( 4U * index ) + 1U ] << 16 ) |
+                         ( ( uint32_t ) pBlock[ ( 4U * index ) + 2U ] << 8 ) |
+                         ( uint32_t ) pBlock[ ( 4U * index ) + 3U ];
+    }
+
+    for( index = 16U; index < 80U; index++ )
+    {
+        temp = words[ index - 3U ] ^ words[ index - 8U ] ^ words[ index - 14U ] ^ words[ index - 16U ];
+        words[ index ] = ( temp << 1 ) | ( temp >> 31 );
+    }
+
+    for( index = 0U; index < 80U; index++ )
+    {
+        if( index < 20U )
+        {
+            f = ( b & c ) | ( ~b & d );
+            k = 0x5A827999U;
+        }
+        else if( index < 40U )
+        {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1U;
+        }
+        else if( index < 60U )
+        {
+            f = ( b & c ) | ( b & d ) | ( c & d );
+            k = 0x8F1BBCDCU;
+        }
+        else
+        {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6U;
+        }
+
+        temp = ( ( a << 5 ) | ( a >> 27 ) ) + f + e + k + words[ index ];
+        e = d;
+        d = c;
+        c = ( b << 30 ) | ( b >> 2 );
+        b = a;
+        a = temp;
+    }
+
+    pState[ 0 ] += a;
+    pState[ 1 ] += b;
+    pState[ 2 ] += c;
+    pState[ 3 ] += d;
+    pState[ 4 ] += e;
+}
+
+/*-----------------------------------------------------------*/
+
+static void sha1( const uint8_t * pData,
+                  size_t length,
+                  uint8_t * pDigest )
+{
+    uint32_t state[ 5 ];
+    uint8_t block[ 64 ];
+    uint64_t bitLength = ( uint64_t ) length * 8U;
+    size_t offset = 0U, remainder, index;
+
+    state[ 0 ] = 0x67452301U;
+    state[ 1 ] = 0xEFCDAB89U;
+    state[ 2 ] = 0x98BADCFEU;
+    state[ 3 ] = 0x10325476U;
+    state[ 4 ] = 0xC3D2E1F0U;
+
+    for( offset = 0U; ( offset + sizeof( block ) ) <= length; offset += sizeof( block ) )
+    {
+        sha1Block( state, &pData[ offset ] );
+    }
+
+    /* Pad the rest with a 1 bit, zeros and the big-endian bit length. */
+    remainder = length - offset;
+    ( void ) memset( block, 0x00, sizeof( block ) );
+    ( void ) memcpy( block, &pData[ offset ], remainder );
+    block[ remainder ] = 0x80U;
+
+    if( remainder >= ( sizeof( block ) - 8U ) )
+    {
+        sha1Block( state, block );
+        ( void ) memset( block, 0x00, sizeof( block ) );
+    }
+
+    for( index = 0U; index < 8U; index++ )
+    {
+        block[ sizeof( block ) - 1U - index ] = ( uint8_t ) ( bitLength >> ( 8U * index ) );
+    }
+
+    sha1Block( state, block );
+
+    for( index = 0U; index < WEBSOCKET_SHA1_SIZE; index++ )
+    {
+        pDigest[ index ] = ( uint8_t ) ( state[ index / 4U ] >> ( 24U - ( 8U * ( index % 4U ) ) ) );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static bool validateResponse( const char * pResponse,
+                              const char * pExpectedAccept )
+{
+    static const char acceptName[] = "sec-websocket-accept:";
+    const size_t acceptNameLength = sizeof( acceptName ) - 1U;
+    const char * pLine = pResponse;
+    const char * pValue;
+    bool statusValid, acceptValid = false;
+    size_t index;
+
+    /* Any HTTP version, status 101. */
+    statusValid = ( strncmp( pResponse, "HTTP/", 5U ) == 0 ) &&
+                  ( strstr( pResponse, " 101" ) != NULL ) &&
+                  ( strstr( pResponse, " 101" ) < strstr( pResponse, "\r\n" ) );
+
+    while( ( statusValid == true ) && ( acceptValid == false ) && ( pLine != NULL ) )
+    {
+        pLine = strstr( pLine, "\r\n" );
+
+        if( pLine != NULL )
+        {
+            pLine = &pLine[ 2 ];
+
+            /* Header names are case-insensitive. */
+            for( index = 0U; ( index < acceptNameLength ) && ( pLine[ index ] != '\0' ); index++ )
+            {
+                if( ( pLine[ index ] | 0x20 ) != acceptName[ index ] )
+                {
+                    break;
+                }
+            }
+
+            if( index == acceptNameLength )
+            {
+                pValue = &pLine[ acceptNameLength ];
+
+                while( *pValue == ' ' )
+                {
+                    pValue++;
+                }
+
+                acceptValid = ( strncmp( pValue, pExpectedAccept, WEBSOCKET_ACCEPT_ENCODED_SIZE ) == 0 ) &&
+                              ( ( pValue[ WEBSOCKET_ACCEPT_ENCODED_SIZE ] == '\r' ) ||
+                                ( pValue[ WEBSOCKET_ACCEPT_ENCODED_SIZE ] == ' ' ) );
+            }
+        }
+    }
+
+    return acceptValid;
+}
+
+/*-----------------------------------------------------------*/
+
+WebSocketTransportStatus_t WebSocketTransport_Init( NetworkContext_t * pNetworkContext,
+                                                    const TransportInterface_t * pUnderlying,
+                                                    WebSocketTransportRandom_t getRandom,
+                                                    uint8_t * pTxBuffer,
+                                                    size_t txBufferSize )
+{
+    WebSocketTransportStatus_t status = WEBSOCKET_TRANSPORT_SUCCESS;
+    WebSocketTransportParams_t * pParams;
+
+    if( ( pNetworkContext == NULL ) || ( pNetworkContext->pParams == NULL ) ||
+        ( pUnderlying == NULL ) || ( pUnderlying->recv == NULL ) || ( pUnderlying->send == NULL ) ||
+        ( getRandom == NULL ) || ( pTxBuffer == NULL ) ||
+        ( txBufferSize <= WEBSOCKET_TRANSPORT_MAX_HEADER_SIZE ) )
+    {
+        LogError( ( "Invalid parameter: pNetworkContext=%p, pUnderlying=%p, pTxBuffer=%p, txBufferSize=%lu.",
+                    ( void * ) pNetworkContext,
+                    ( const void * ) pUnderlying,
+                    ( void * ) pTxBuffer,
+                    ( unsigned long ) txBufferSize ) );
+        status = WEBSOCKET_TRANSPORT_INVALID_PARAMETER;
+    }
+    else
+    {
+        pParams = pNetworkContext->pParams;
+        ( void ) memset( pParams, 0x00, sizeof( *pParams ) );
+        pParams->underlying = *pUnderlying;
+        pParams->getRandom = getRandom;
+        pParams->pTxBuffer = pTxBuffer;
+        pParams->txBufferSize = txBufferSize;
+        pParams->rxHeaderNeeded = 2U;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+WebSocketTransportStatus_t WebSocketTransport_Handshake( NetworkContext_t * pNetworkContext,
+                                                         const char * pHost,
+                                                         const char * pPath,
+                                                         WebSocketTransportGetTime_t getTime,
+                                                         uint32_t timeoutMs )
+{
+    WebSocketTransportStatus_t status = WEBSOCKET_TRANSPORT_SUCCESS;
+    WebSocketTransportParams_t * pParams = getParams( pNetworkContext );
+    uint8_t key[ WEBSOCKET_KEY_SIZE ];
+    char encodedKey[ WEBSOCKET_KEY_ENCODED_SIZE + 1U ];
+    uint8_t acceptInput[ WEBSOCKET_KEY_ENCODED_SIZE + sizeof( WEBSOCKET_GUID ) ];
+    uint8_t digest[ WEBSOCKET_SHA1_SIZE ];
+    char expectedAccept[ WEBSOCKET_ACCEPT_ENCODED_SIZE + 1U ];
+    char response[ WEBSOCKET_RESPONSE_BUFFER_SIZE ];
+    size_t requestLength = 0U, sent = 0U, received = 0U, index;
+    int32_t result = 0;
+    uint32_t word, startMs;
+    int printed;
+
+    if( ( pParams == NULL ) || ( pHost == NULL ) || ( pPath == NULL ) || ( getTime == NULL ) )
+    {
+        LogError( ( "Invalid parameter: pNetworkContext=%p, pHost=%p, pPath=%p.",
+                    ( void * ) pNetworkContext,
+                    ( const void * ) pHost,
+                    ( const void * ) pPath ) );
+        status = WEBSOCKET_TRANSPORT_INVALID_PARAMETER;
+    }
+    else
+    {
+        for( index = 0U; index < WEBSOCKET_KEY_SIZE; index += 4U )
+        {
+            word = pParams->getRandom();
+            key[ index ] = ( uint8_t ) ( word >> 24 );
+            key[ index + 1U ] = ( uint8_t ) ( word >> 16 );
+            key[ index + 2U ] = ( uint8_t ) ( word >> 8 );
+            key[ index + 3U ] = ( uint8_t ) word;
+        }
+
+        base64Encode( key, sizeof( key ), encodedKey );
+
+        /* The server proves it understood the request by returning the
+         * base64 SHA-1 digest of the key followed by a fixed GUID. */
+        ( void ) memcpy( acceptInput, encodedKey, WEBSOCKET_KEY_ENCODED_SIZE );
+        ( void ) memcpy( &acceptInput[ WEBSOCKET_KEY_ENCODED_SIZE ], WEBSOCKET_GUID, sizeof( WEBSOCKET_GUID ) - 1U );
+        sha1( acceptInput, sizeof( acceptInput ) - 1U, digest );
+        base64Encode( digest, sizeof( digest ), expectedAccept );
+
+        printed = snprintf( ( char * ) pParams->pTxBuffer, pParams->txBufferSize,
+                            "GET %s HTTP/1.1\r\n"
+                            "Host: %s\r\n"
+                            "Upgrade: websocket\r\n"
+                            "Connection: Upgrade\r\n"
+                            "Sec-WebSocket-Key: %s\r\n"
+                            "Sec-WebSocket-Protocol: mqtt\r\n"
+                            "Sec-WebSocket-Version: 13\r\n"
+                            "\r\n",
+                            pPath, pHost, encodedKey );
+
+        if( ( printed < 0 ) || ( ( size_t ) printed >= pParams->txBufferSize ) )
+        {
+            LogError( ( "The transmit buffer cannot hold the handshake request." ) );
+            status = WEBSOCKET_TRANSPORT_INVALID_PARAMETER;
+        }
+        else
+        {
+            requestLength = ( size_t ) printed;
+        }
+    }
+
+    if( status == WEBSOCKET_TRANSPORT_SUCCESS )
+    {
+        startMs = getTime();
+
+        while( ( sent < requestLength ) && ( result >= 0 ) &&
+               ( ( getTime() - startMs ) < timeoutMs ) )
+        {
+            result = pParams->underlying.send( pParams->underlying.pNetworkContext,
+                                               &pParams->pTxBuffer[ sent ], requestLength - sent );
+            sent += ( result > 0 ) ? ( size_t ) result : 0U;
+        }
+
+        /* Read a byte at a time, so that no frame following the headers is
+         * consumed. The handshake happens once per connection. */
+        while( ( sent == requestLength ) && ( result >= 0 ) &&
+               ( received < ( sizeof( response ) - 1U ) ) &&
+               ( ( received < 4U ) || ( memcmp( &response[ received - 4U ], "\r\n\r\n", 4U ) != 0 ) ) &&
+               ( ( getTime() - startMs ) < timeoutMs ) )
+        {
+            result = pParams->underlying.recv( pParams->underlying.pNetworkContext,
+                                               &response[ received ], 1U );
+            received += ( result > 0 ) ? 1U : 0U;
+        }
+
+        response[ received ] = '\0';
+
+        if( ( received < 4U ) || ( memcmp( &response[ received - 4U ], "\r\n\r\n", 4U ) != 0 ) )
+        {
+            LogError( ( "Handshake did not complete: sent=%lu, received=%lu, result=%ld.",
+                        ( unsigned long ) sent,
+                        ( unsigned long ) received,
+                        ( long int ) result ) );
+            status = WEBSOCKET_TRANSPORT_TRANSPORT_FAILURE;
+        }
+        else if( validateResponse( response, expectedAccept ) == false )
+        {
+            LogError( ( "The server rejected the WebSocket upgrade." ) );
+            status = WEBSOCKET_TRANSPORT_HANDSHAKE_FAILURE;
+        }
+        else
+        {
+            LogDebug( ( "WebSocket established to %s%s.", pHost, pPath ) );
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+WebSocketTransportStatus_t WebSocketTransport_Close( NetworkContext_t * pNetworkContext )
+{
+    WebSocketTransportStatus_t status = WEBSOCKET_TRANSPORT_SUCCESS;
+    WebSocketTransportParams_t * pParams = getParams( pNetworkContext );
+    static const uint8_t normalClosure[] = { 0x03U, 0xE8U };
+    uint8_t maskKey[ WEBSOCKET_MASK_KEY_SIZE ];
+    uint8_t phase = 0U;
+    size_t headerSize;
+    int32_t result = 0;
+    size_t attempts;
+
+    if( pParams == NULL )
+    {
+        LogError( ( "The network context is not set up." ) );
+        status = WEBSOCKET_TRANSPORT_INVALID_PARAMETER;
+    }
+    else
+    {
+        /* A bounded number of attempts, as there is no time source. */
+        for( attempts = 0U; ( attempts < 1000U ) && ( result == 0 ); attempts++ )
+        {
+            result = flushPending( pParams );
+        }
+
+        if( result == 1 )
+        {
+            headerSize = writeFrameHeader( pParams, WEBSOCKET_OPCODE_CLOSE, sizeof( normalClosure ), maskKey );
+            maskCopy( &pParams->pTxBuffer[ headerSize ], normalClosure, sizeof( normalClosure ), maskKey, &phase );
+            pParams->txPendingOffset = 0U;
+            pParams->txPendingLength = headerSize + sizeof( normalClosure );
+            result = 0;
+
+            for( attempts = 0U; ( attempts < 1000U ) && ( result == 0 ); attempts++ )
+            {
+                result = flushPending( pParams );
+            }
+        }
+
+        if( result != 1 )
+        {
+            status = WEBSOCKET_TRANSPORT_TRANSPORT_FAILURE;
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+int32_t WebSocketTransport_Recv( NetworkContext_t * pNetworkContext,
+                                 void * pBuffer,
+                                 size_t bytesToRecv )
+{
+    int32_t bytesReceived = -1;
+    WebSocketTransportParams_t * pParams = getParams( pNetworkContext );
+    uint8_t * pDestination = ( uint8_t * ) pBuffer;
+    bool progress = true;
+    int32_t result;
+    size_t chunk;
+
+    if( ( pParams == NULL ) || ( pBuffer == NULL ) )
+    {
+        LogError( ( "Invalid parameter: pParams=%p, pBuffer=%p.", ( void * ) pParams, pBuffer ) );
+    }
+    else if( ( pParams->closed == true ) || ( flushPending( pParams ) < 0 ) )
+    {
+        /* The WebSocket is closed, or a pong could not be sent. */
+    }
+    else
+    {
+        bytesReceived = 0;
+
+        /* Consume headers and control frames until payload bytes are
+         * delivered or nothing more is available. */
+        while( ( progress == true ) && ( bytesReceived == 0 ) && ( bytesToRecv > 0U ) )
+        {
+            if( ( pParams->rxRemaining > 0U ) && ( ( pParams->rxOpcode & WEBSOCKET_CONTROL_BIT ) == 0U ) )
+            {
+                /* Payload goes straight into the caller's buffer. */
+                chunk = ( pParams->rxRemaining < bytesToRecv ) ? ( size_t ) pParams->rxRemaining : bytesToRecv;
+                result = pParams->underlying.recv( pParams->underlying.pNetworkContext, pDestination, chunk );
+
+                if( result > 0 )
+                {
+                    if( pParams->rxMasked == true )
+                    {
+                        maskCopy( pDestination, pDestination, ( size_t ) result,
+                                  pParams->rxHeader, &pParams->rxMaskPhase );
+                    }
+
+                    pParams->rxRemaining -= ( uint64_t ) result;
+                }
+
+                bytesReceived = result;
+                progress = false;
+            }
+            else if( pParams->rxRemaining > 0U )
+            {
+                result = pParams->underlying.recv( pParams->underlying.pNetworkContext,
+                                                   &pParams->control[ pParams->controlLength ],
+                                                   ( size_t ) pParams->rxRemaining );
+
+                if( result > 0 )
+                {
+                    pParams->controlLength += ( uint8_t ) result;
+                    pParams->rxRemaining -= ( uint64_t ) result;
+
+                    if( pParams->rxRemaining == 0U )
+                    {
+                        handleControlFrame( pParams );
+                    }
+                }
+                else
+                {
+                    bytesReceived = result;
+                    progress = false;
+                }
+            }
+            else
+            {
+                result = pParams->underlying.recv( pParams->underlying.pNetworkContext,
+                                                   &pParams->rxHeader[ pParams->rxHeaderLength ],
+                                                   ( size_t ) pParams->rxHeaderNeeded - pParams->rxHeaderLength );
+
+                if( result > 0 )
+                {
+                    pParams->rxHeaderLength += ( uint8_t ) result;
+
+                    if( pParams->rxHeaderLength == 2U )
+                    {
+                        /* The first two bytes tell the size of the rest. */
+                        pParams->rxHeaderNeeded = 2U;
+                        pParams->rxHeaderNeeded += ( ( pParams->rxHeader[ 1 ] & WEBSOCKET_LENGTH_MASK ) == WEBSOCKET_LENGTH_16_BIT ) ? 2U : 0U;
+                        pParams->rxHeaderNeeded += ( ( pParams->rxHeader[ 1 ] & WEBSOCKET_LENGTH_MASK ) == WEBSOCKET_LENGTH_64_BIT ) ? 8U : 0U;
+                        pParams->rxHeaderNeeded += ( ( pParams->rxHeader[ 1 ] & WEBSOCKET_MASK_BIT ) != 0U ) ? WEBSOCKET_MASK_KEY_SIZE : 0U;
+                    }
+
+                    if( pParams->rxHeaderLength == pParams->rxHeaderNeeded )
+                    {
+                        pParams->rxHeaderLength = 0U;
+                        pParams->rxHeaderNeeded = 2U;
+
+                        if( parseFrameHeader( pParams ) == false )
+                        {
+                            bytesReceived = -1;
+                            progress = false;
+                        }
+                        else if( ( pParams->rxRemaining == 0U ) &&
+                                 ( ( pParams->rxOpcode & WEBSOCKET_CONTROL_BIT ) != 0U ) )
+                        {
+                            handleControlFrame( pParams );
+                        }
+                        else
+                        {
+                            /* MISRA else */
+                        }
+                    }
+                }
+                else
+                {
+                    bytesReceived = result;
+                    progress = false;
+                }
+            }
+
+            if( pParams->closed == true )
+            {
+                bytesReceived = -1;
+                progress = false;
+            }
+        }
+
+        /* Answer a ping received by this call right away. */
+        if( ( bytesReceived >= 0 ) && ( flushPending( pParams ) < 0 ) )
+        {
+            bytesReceived = -1;
+        }
+    }
+
+    return bytesReceived;
+}
+
+/*-----------------------------------------------------------*/
+
+int32_t WebSocketTransport_Send( NetworkContext_t * pNetworkContext,
+                                 const void * pBuffer,
+                                 size_t bytesToSend )
+{
+    TransportOutVector_t ioVector;
+
+    ioVector.iov_base = pBuffer;
+    ioVector.iov_len = bytesToSend;
+
+    return WebSocketTransport_Writev( pNetworkContext, &ioVector, 1U );
+}
+
+/*-----------------------------------------------------------*/
+
+int32_t WebSocketTransport_Writev( NetworkContext_t * pNetworkContext,
+                                   TransportOutVector_t * pIoVec,
+                                   size_t ioVecCount )
+{
+    int32_t bytesSent = -1;
+    WebSocketTransportParams_t * pParams = getParams( pNetworkContext );
+    uint8_t maskKey[ WEBSOCKET_MASK_KEY_SIZE ];
+    uint8_t phase = 0U;
+    size_t payloadLength = 0U, capacity, headerSize, offset, chunk, index;
+    int32_t result;
+
+    if( ( pParams == NULL ) || ( pIoVec == NULL ) )
+    {
+        LogError( ( "Invalid parameter: pParams=%p, pIoVec=%p.", ( void * ) pParams, ( void * ) pIoVec ) );
+    }
+    else if( pParams->closed == true )
+    {
+        LogError( ( "The WebSocket is closed." ) );
+    }
+    else
+    {
+        result = flushPending( pParams );
+
+        if( result == 1 )
+        {
+            /* Frame all vectors together, up to what fits in the buffer with
+             * the largest header. Payloads are bounded by int32_t. */
+            capacity = pParams->txBufferSize - WEBSOCKET_TRANSPORT_MAX_HEADER_SIZE;
+            capacity = ( capacity > ( size_t ) INT32_MAX ) ? ( size_t ) INT32_MAX : capacity;
+
+            for( index = 0U; ( index < ioVecCount ) && ( payloadLength < capacity ); index++ )
+            {
+                payloadLength += ( pIoVec[ index ].iov_len < ( capacity - payloadLength ) ) ?
+                                 pIoVec[ index ].iov_len : ( capacity - payloadLength );
+            }
+
+            bytesSent = 0;
+
+            if( payloadLength > 0U )
+            {
+                headerSize = writeFrameHeader( pParams, WEBSOCKET_OPCODE_BINARY, payloadLength, maskKey );
+                offset = headerSize;
+
+                for( index = 0U; offset < ( headerSize + payloadLength ); index++ )
+                {
+                    chunk = ( pIoVec[ index ].iov_len < ( ( headerSize + payloadLength ) - offset ) ) ?
+                            pIoVec[ index ].iov_len : ( ( headerSize + payloadLength ) - offset );
+                    maskCopy( &pParams->pTxBuffer[ offset ], ( const uint8_t * ) pIoVec[ index ].iov_base,
+                              chunk, maskKey, &phase );
+                    offset += chunk;
+                }
+
+                pParams->txPendingOffset = 0U;
+                pParams->txPendingLength = offset;
+
+                /* The frame now owns the bytes; what the underlying transport
+                 * cannot take yet is sent by the next call. */
+                bytesSent = ( flushPending( pParams ) < 0 ) ? -1 : ( int32_t ) payloadLength;
+            }
+        }
+        else
+        {
+            bytesSent = result;
+        }
+    }
+
+    return bytesSent;
+}
+
+/*-----------------------------------------------------------*/
@@ -0,0 +1,261 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file websocket_transport.h
+ * @brief Client side WebSocket framing (RFC 6455) over another transport
+ * interface implementation, for MQTT over WebSockets.
+ *
+ * The adapter implements #TransportRecv_t, #TransportSend_t and
+ * #TransportWritev_t, so a #TransportInterface_t using it is passed to
+ * #MQTT_Init unchanged. Each call to #WebSocketTransport_Writev sends its
+ * vectors as a single masked binary frame. Received frames are unframed
+ * straight into the buffer given to #WebSocketTransport_Recv, as servers do
+ * not mask their frames; pings are answered and fragmented messages are
+ * joined transparently.
+ *
+ * Every compilation unit which uses this transport must define
+ * `struct NetworkContext` with a `pParams` member pointing to a
+ * #WebSocketTransportParams_t:
+ *
+ * @code{c}
+ * struct NetworkContext
+ * {
+ *     WebSocketTransportParams_t * pParams;
+ * };
+ * @endcode
+ */
+
+#ifndef WEBSOCKET_TRANSPORT_H_
+#define WEBSOCKET_TRANSPORT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    extern "C" {
+#endif
+/* *INDENT-ON* */
+
+/* Include transport interface. */
+#include "transport_interface.h"
+
+/**
+ * @brief Set to 0 to mask payloads with the portable word-wise loop rather
+ * than with SSE2, AVX2 or NEON instructions.
+ *
+ * The vector instructions are only used when the compiler targets them, for
+ * example with `-mavx2`.
+ */
+#ifndef WEBSOCKET_TRANSPORT_USE_SIMD
+    #define WEBSOCKET_TRANSPORT_USE_SIMD    ( 1 )
+#endif
+
+/**
+ * @brief Largest frame header, used by frames with a 64-bit payload length
+ * and a masking key.
+ */
+#define WEBSOCKET_TRANSPORT_MAX_HEADER_SIZE     ( 14U )
+
+/**
+ * @brief Largest payload of a control frame.
+ */
+#define WEBSOCKET_TRANSPORT_MAX_CONTROL_SIZE    ( 125U )
+
+/**
+ * @brief Return codes of the connection management functions of the adapter.
+ */
+typedef enum WebSocketTransportStatus
+{
+    WEBSOCKET_TRANSPORT_SUCCESS = 0,       /**< @brief Function successfully completed. */
+    WEBSOCKET_TRANSPORT_INVALID_PARAMETER, /**< @brief At least one parameter was invalid. */
+    WEBSOCKET_TRANSPORT_TRANSPORT_FAILURE, /**< @brief The underlying transport failed or timed out. */
+    WEBSOCKET_TRANSPORT_HANDSHAKE_FAILURE  /**< @brief The server did not accept the WebSocket upgrade. */
+} WebSocketTransportStatus_t;
+
+/**
+ * @brief Application callback returning 32 unpredictable bits, used for the
+ * handshake key and for the masking key of each frame.
+ *
+ * @return Random bits.
+ */
+typedef uint32_t (* WebSocketTransportRandom_t )( void );
+
+/**
+ * @brief Application callback returning a time in milliseconds, used to
+ * bound the handshake.
+ *
+ * @return The time in milliseconds.
+ */
+typedef uint32_t (* WebSocketTransportGetTime_t )( void );
+
+/**
+ * @brief Parameters of a WebSocket connection, referenced by the `pParams`
+ * member of `struct NetworkContext`.
+ *
+ * @note The members of this struct are set by #WebSocketTransport_Init and
+ * must not be accessed by the application.
+ */
+typedef struct WebSocketTransportParams
+{
+    TransportInterface_t underlying;         /**< @brief The transport carrying the frames. */
+    WebSocketTransportRandom_t getRandom;    /**< @brief Source of masking keys. */
+    uint8_t * pTxBuffer;                     /**< @brief Buffer in which outgoing frames are masked. */
+    size_t txBufferSize;                     /**< @brief Size of #WebSocketTransportParams_t.pTxBuffer. */
+    size_t txPendingOffset;                  /**< @brief Offset of the unsent bytes of the last frame. */
+    size_t txPendingLength;                  /**< @brief Number of unsent bytes of the last frame. */
+    uint64_t rxRemaining;                    /**< @brief Payload bytes left in the current incoming frame. */
+    uint8_t rxHeader[ WEBSOCKET_TRANSPORT_MAX_HEADER_SIZE ]; /**< @brief Header of the incoming frame. */
+    uint8_t rxHeaderLength;                  /**< @brief Bytes received of the incoming frame header. */
+    uint8_t rxHeaderNeeded;                  /**< @brief Size of the incoming frame header, once known. */
+    uint8_t rxOpcode;                        /**< @brief Opcode of the incoming frame. */
+    uint8_t rxMaskPhase;                     /**< @brief Position in the masking key of a masked incoming frame. */
+    bool rxMasked;                           /**< @brief Whether the incoming frame is masked. */
+    uint8_t control[ WEBSOCKET_TRANSPORT_MAX_CONTROL_SIZE ]; /**< @brief Payload of an incoming control frame. */
+    uint8_t controlLength;                   /**< @brief Bytes received of the control frame payload. */
+    bool pongPending;                        /**< @brief Whether a ping awaits its pong. */
+    uint8_t pongLength;                      /**< @brief Payload length of the pending pong. */
+    uint8_t pong[ WEBSOCKET_TRANSPORT_MAX_CONTROL_SIZE ]; /**< @brief Payload of the pending pong. */
+    bool closed;                             /**< @brief Whether the server closed the WebSocket. */
+} WebSocketTransportParams_t;
+
+/**
+ * @brief Set up the adapter over a connected transport.
+ *
+ * @param[in] pNetworkContext Network context of the WebSocket.
+ * @param[in] pUnderlying The connected transport carrying the frames. It is
+ * copied.
+ * @param[in] getRandom Source of masking keys.
+ * @param[in] pTxBuffer Buffer in which outgoing frames are masked; it bounds
+ * the payload of each frame, and must hold the handshake request.
+ * @param[in] txBufferSize Size of @p pTxBuffer.
+ *
+ * @return #WEBSOCKET_TRANSPORT_SUCCESS or #WEBSOCKET_TRANSPORT_INVALID_PARAMETER.
+ */
+/* @[declare_websockettransport_init] */
+WebSocketTransportStatus_t WebSocketTransport_Init( NetworkContext_t * pNetworkContext,
+                                                    const TransportInterface_t * pUnderlying,
+                                                    WebSocketTransportRandom_t getRandom,
+                                                    uint8_t * pTxBuffer,
+                                                    size_t txBufferSize );
+/* @[declare_websockettransport_init] */
+
+/**
+ * @brief Upgrade the connection to a WebSocket with the `mqtt` subprotocol.
+ *
+ * @param[in] pNetworkContext Network context of the WebSocket.
+ * @param[in] pHost Value of the Host header.
+ * @param[in] pPath Path of the WebSocket endpoint, such as "/mqtt".
+ * @param[in] getTime Time source bounding the handshake.
+ * @param[in] timeoutMs Time to wait for the handshake to complete.
+ *
+ * @return #WEBSOCKET_TRANSPORT_SUCCESS, #WEBSOCKET_TRANSPORT_INVALID_PARAMETER,
+ * #WEBSOCKET_TRANSPORT_TRANSPORT_FAILURE or #WEBSOCKET_TRANSPORT_HANDSHAKE_FAILURE.
+ */
+/* @[declare_websockettransport_handshake] */
+WebSocketTransportStatus_t WebSocketTransport_Handshake( NetworkContext_t * pNetworkContext,
+                                                         const char * pHost,
+                                                         const char * pPath,
+                                                         WebSocketTransportGetTime_t getTime,
+                                                         uint32_t timeoutMs );
+/* @[declare_websockettransport_handshake] */
+
+/**
+ * @brief Send any pending frame bytes, followed by a close frame.
+ *
+ * The underlying transport is left open.
+ *
+ * @param[in] pNetworkContext Network context of the WebSocket.
+ *
+ * @return #WEBSOCKET_TRANSPORT_SUCCESS, #WEBSOCKET_TRANSPORT_INVALID_PARAMETER or
+ * #WEBSOCKET_TRANSPORT_TRANSPORT_FAILURE.
+ */
+/* @[declare_websockettransport_close] */
+WebSocketTransportStatus_t WebSocketTransport_Close( NetworkContext_t * pNetworkContext );
+/* @[declare_websockettransport_close] */
+
+/**
+ * @brief Receive payload bytes of binary frames.
+ *
+ * Implements #TransportRecv_t.
+ *
+ * @param[in] pNetworkContext Network context of the WebSocket.
+ * @param[out] pBuffer Buffer to receive the payload into.
+ * @param[in] bytesToRecv Size of @p pBuffer.
+ *
+ * @return The number of bytes received; 0 if no payload is available; a
+ * negative value if the connection failed or the server closed the WebSocket.
+ */
+/* @[declare_websockettransport_recv] */
+int32_t WebSocketTransport_Recv( NetworkContext_t * pNetworkContext,
+                                 void * pBuffer,
+                                 size_t bytesToRecv );
+/* @[declare_websockettransport_recv] */
+
+/**
+ * @brief Send bytes as a binary frame.
+ *
+ * Implements #TransportSend_t.
+ *
+ * @param[in] pNetworkContext Network context of the WebSocket.
+ * @param[in] pBuffer Data to send.
+ * @param[in] bytesToSend Number of bytes in @p pBuffer.
+ *
+ * @return The number of bytes framed; 0 if the previous frame is still being
+ * sent; a negative value if the connection failed.
+ */
+/* @[declare_websockettransport_send] */
+int32_t WebSocketTransport_Send( NetworkContext_t * pNetworkContext,
+                                 const void * pBuffer,
+                                 size_t bytesToSend );
+/* @[declare_websockettransport_send] */
+
+/**
+ * @brief Send a list of buffers as a single binary frame, or as many bytes of
+ * them as fit in the transmit buffer.
+ *
+ * Implements #TransportWritev_t.
+ *
+ * @param[in] pNetworkContext Network context of the WebSocket.
+ * @param[in] pIoVec The buffers to send.
+ * @param[in] ioVecCount Number of buffers in @p pIoVec.
+ *
+ * @return The number of bytes framed; 0 if the previous frame is still being
+ * sent; a negative value if the connection failed.
+ */
+/* @[declare_websockettransport_writev] */
+int32_t WebSocketTransport_Writev( NetworkContext_t * pNetworkContext,
+                                   TransportOutVector_t * pIoVec,
+                                   size_t ioVecCount );
+/* @[declare_websockettransport_writev] */
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    }
+#endif
+/* *INDENT-ON* */
+
+#endif /* ifndef WEBSOCKET_TRANSPORT_H_ */
@@ -0,0 +1,207 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file core_mqtt_publish_benchmark.c
+ * @brief Measures the cost of a QoS0 #MQTT_Publish over a transport which
+ * discards all data, so that the time is spent in the library only.
+ *
+ * The benchmark is built once for each build profile of the library, so the
+ * results of the full and the QoS0-only builds can be compared.
+ */
+
+#define _POSIX_C_SOURCE    199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+    #include <x86intrin.h>
+    #define BENCHMARK_HAS_CYCLE_COUNTER    ( 1 )
+#else
+    #define BENCHMARK_HAS_CYCLE_COUNTER    ( 0 )
+#endif
+
+#include "core_mqtt.h"
+
+/**
+ * @brief Number of publishes to time.
+ */
+#define BENCHMARK_PUBLISH_COUNT    ( 2000000UL )
+
+/**
+ * @brief Number of untimed publishes sent first to warm up the caches.
+ */
+#define BENCHMARK_WARMUP_COUNT     ( 10000UL )
+
+/**
+ * @brief Transport which replays a CONNACK and discards everything sent.
+ */
+struct NetworkContext
+{
+    const uint8_t * pRxData;
+    size_t rxLength;
+};
+
+static int32_t transportRecv( NetworkContext_t * pNetworkContext,
+                              void * pBuffer,
+                              size_t bytesToRecv )
+{
+    if( bytesToRecv > pNetworkContext->rxLength )
+    {
+        bytesToRecv = pNetworkContext->rxLength;
+    }
+
+    ( void ) memcpy( pBuffer, pNetworkContext->pRxData, bytesToRecv );
+    pNetworkContext->pRxData += bytesToRecv;
+    pNetworkContext->rxLength -= bytesToRecv;
+
+    return ( int32_t ) bytesToRecv;
+}
+
+static int32_t transportSend( NetworkContext_t * pNetworkContext,
+                              const void * pBuffer,
+                              size_t bytesToSend )
+{
+    ( void ) pNetworkContext;
+    ( void ) pBuffer;
+
+    return ( int32_t ) bytesToSend;
+}
+
+static uint32_t getTime( void )
+{
+    return 0U;
+}
+
+static void eventCallback( MQTTContext_t * pContext,
+                           MQTTPacketInfo_t * pPacketInfo,
+                           MQTTDeserializedInfo_t * pDeserializedInfo )
+{
+    ( void ) pContext;
+    ( void ) pPacketInfo;
+    ( void ) pDeserializedInfo;
+}
+
+static uint64_t getTimeNs( void )
+{
+    struct timespec now;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( ( uint64_t ) now.tv_sec * 1000000000ULL ) + ( uint64_t ) now.tv_nsec;
+}
+
+static uint64_t getCycles( void )
+{
+    #if ( BENCHMARK_HAS_CYCLE_COUNTER != 0 )
+        return ( uint64_t ) __rdtsc();
+    #else
+        return 0U;
+    #endif
+}
+
+int main( void )
+{
+    static const uint8_t connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    static uint8_t buffer[ 256 ];
+    static const char payload[] = "{\"temperature\":21.5,\"rh\":40}";
+    NetworkContext_t networkContext;
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer;
+    MQTTConnectInfo_t connectInfo = { 0 };
+    MQTTPublishInfo_t publishInfo = { 0 };
+    MQTTContext_t context;
+    MQTTStatus_t status;
+    bool sessionPresent = false;
+    uint64_t startNs, elapsedNs, startCycles, elapsedCycles;
+    unsigned long i;
+
+    networkContext.pRxData = connack;
+    networkContext.rxLength = sizeof( connack );
+    transport.pNetworkContext = &networkContext;
+    transport.recv = transportRecv;
+    transport.send = transportSend;
+    networkBuffer.pBuffer = buffer;
+    networkBuffer.size = sizeof( buffer );
+
+    connectInfo.cleanSession = true;
+    connectInfo.pClientIdentifier = "benchmark";
+    connectInfo.clientIdentifierLength = 9U;
+
+    publishInfo.qos = MQTTQoS0;
+    publishInfo.pTopicName = "devices/1234/telemetry";
+    publishInfo.topicNameLength = ( uint16_t ) strlen( publishInfo.pTopicName );
+    publishInfo.pPayload = payload;
+    publishInfo.payloadLength = sizeof( payload ) - 1U;
+
+    status = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+
+    if( status == MQTTSuccess )
+    {
+        status = MQTT_Connect( &context, &connectInfo, NULL, 0U, &sessionPresent );
+    }
+
+    for( i = 0UL; ( i < BENCHMARK_WARMUP_COUNT ) && ( status == MQTTSuccess ); i++ )
+    {
+        status = MQTT_Publish( &context, &publishInfo, 0U );
+    }
+
+    startNs = getTimeNs();
+    startCycles = getCycles();
+
+    for( i = 0UL; ( i < BENCHMARK_PUBLISH_COUNT ) && ( status == MQTTSuccess ); i++ )
+    {
+        status = MQTT_Publish( &context, &publishInfo, 0U );
+    }
+
+    elapsedCycles = getCycles() - startCycles;
+    elapsedNs = getTimeNs() - startNs;
+
+    if( status != MQTTSuccess )
+    {
+        ( void ) fprintf( stderr, "Benchmark failed with status %s.\n",
+                          MQTT_Status_strerror( status ) );
+    }
+    else
+    {
+        ( void ) printf( "%-10s sizeof(MQTTContext_t)=%lu ns/publish=%.1f",
+                         ( MQTT_QOS0_ONLY != 0 ) ? "qos0-only" : "full",
+                         ( unsigned long ) sizeof( MQTTContext_t ),
+                         ( double ) elapsedNs / ( double ) BENCHMARK_PUBLISH_COUNT );
+
+        #if ( BENCHMARK_HAS_CYCLE_COUNTER != 0 )
+            ( void ) printf( " cycles/publish=%.1f",
+                             ( double ) elapsedCycles / ( double ) BENCHMARK_PUBLISH_COUNT );
+        #else
+            ( void ) elapsedCycles;
+        #endif
+
+        ( void ) printf( "\n" );
+    }
+
+    return ( status == MQTTSuccess ) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,219 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file core_mqtt_router_benchmark.cpp
+ * @brief Measures the cost of routing a topic name with the compile-time
+ * router, and with a loop calling #MQTT_MatchTopic over the same topic
+ * filters.
+ *
+ * The loop chooses the route as the topic handlers of the library do: a
+ * matching filter without wildcards, or else the first matching filter.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include "core_mqtt_router.hpp"
+
+/**
+ * @brief Number of topic names to route in each run.
+ */
+#define BENCHMARK_ROUTE_COUNT    ( 1000000UL )
+
+static void handler( MQTTContext_t * pContext,
+                     MQTTPacketInfo_t * pPacketInfo,
+                     MQTTDeserializedInfo_t * pDeserializedInfo )
+{
+    ( void ) pContext;
+    ( void ) pPacketInfo;
+    ( void ) pDeserializedInfo;
+}
+
+/**
+ * @brief The topic filters, in the order of the routes.
+ */
+static const char * const filters[] =
+{
+    "factory/+/line/+/temperature",
+    "factory/+/line/+/pressure",
+    "factory/+/line/+/vibration",
+    "factory/+/line/+/status",
+    "factory/+/alarms/#",
+    "factory/north/line/7/temperature",
+    "factory/south/line/2/pressure",
+    "fleet/+/position",
+    "fleet/+/fuel",
+    "fleet/+/diagnostics/#",
+    "config/+/set",
+    "config/+/get",
+    "firmware/+/update/#",
+    "devices/+/shadow/update/accepted",
+    "devices/+/shadow/update/rejected",
+    "$SYS/broker/#"
+};
+
+using BenchmarkRouter = coremqtt::Router< coremqtt::Route< "factory/+/line/+/temperature", handler >,
+                                          coremqtt::Route< "factory/+/line/+/pressure", handler >,
+                                          coremqtt::Route< "factory/+/line/+/vibration", handler >,
+                                          coremqtt::Route< "factory/+/line/+/status", handler >,
+                                          coremqtt::Route< "factory/+/alarms/#", handler >,
+                                          coremqtt::Route< "factory/north/line/7/temperature", handler >,
+                                          coremqtt::Route< "factory/south/line/2/pressure", handler >,
+                                          coremqtt::Route< "fleet/+/position", handler >,
+                                          coremqtt::Route< "fleet/+/fuel", handler >,
+                                          coremqtt::Route< "fleet/+/diagnostics/#", handler >,
+                                          coremqtt::Route< "config/+/set", handler >,
+                                          coremqtt::Route< "config/+/get", handler >,
+                                          coremqtt::Route< "firmware/+/update/#", handler >,
+                                          coremqtt::Route< "devices/+/shadow/update/accepted", handler >,
+                                          coremqtt::Route< "devices/+/shadow/update/rejected", handler >,
+                                          coremqtt::Route< "$SYS/broker/#", handler > >;
+
+/**
+ * @brief The topic names routed in turn.
+ */
+static const char * const topics[] =
+{
+    "factory/north/line/7/temperature",
+    "factory/east/line/3/vibration",
+    "factory/west/alarms/overheat/line/4",
+    "fleet/truck-42/position",
+    "fleet/truck-17/diagnostics/engine/oil",
+    "config/gateway-1/get",
+    "devices/sensor-9/shadow/update/rejected",
+    "unknown/topic/name"
+};
+
+#define FILTER_COUNT    ( sizeof( filters ) / sizeof( filters[ 0 ] ) )
+#define TOPIC_COUNT     ( sizeof( topics ) / sizeof( topics[ 0 ] ) )
+
+static uint64_t getTimeNs( void )
+{
+    struct timespec now;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( ( uint64_t ) now.tv_sec * 1000000000ULL ) + ( uint64_t ) now.tv_nsec;
+}
+
+/**
+ * @brief Route a topic name with #MQTT_MatchTopic.
+ */
+static std::size_t matchTopicLoop( const char * pTopicName,
+                                   uint16_t topicNameLength,
+                                   const uint16_t * pFilterLengths,
+                                   const bool * pHasWildcard )
+{
+    std::size_t route = FILTER_COUNT;
+    std::size_t i;
+    bool isMatch;
+
+    /* Filters without wildcards first, as by the topic handlers. */
+    for( i = 0U; ( i < FILTER_COUNT ) && ( route == FILTER_COUNT ); i++ )
+    {
+        if( pHasWildcard[ i ] == false )
+        {
+            isMatch = false;
+            ( void ) MQTT_MatchTopic( pTopicName, topicNameLength, filters[ i ], pFilterLengths[ i ], &isMatch );
+            route = ( isMatch == true ) ? i : route;
+        }
+    }
+
+    for( i = 0U; ( i < FILTER_COUNT ) && ( route == FILTER_COUNT ); i++ )
+    {
+        if( pHasWildcard[ i ] == true )
+        {
+            isMatch = false;
+            ( void ) MQTT_MatchTopic( pTopicName, topicNameLength, filters[ i ], pFilterLengths[ i ], &isMatch );
+            route = ( isMatch == true ) ? i : route;
+        }
+    }
+
+    return route;
+}
+
+int main( void )
+{
+    uint16_t filterLengths[ FILTER_COUNT ];
+    bool hasWildcard[ FILTER_COUNT ];
+    uint16_t topicLengths[ TOPIC_COUNT ];
+    uint64_t startNs, loopNs, routerNs;
+    std::size_t loopChecksum = 0U, routerChecksum = 0U;
+    unsigned long i;
+    int status = EXIT_SUCCESS;
+
+    for( i = 0UL; i < FILTER_COUNT; i++ )
+    {
+        filterLengths[ i ] = ( uint16_t ) std::strlen( filters[ i ] );
+        hasWildcard[ i ] = ( std::strpbrk( filters[ i ], "+#" ) != nullptr );
+    }
+
+    for( i = 0UL; i < TOPIC_COUNT; i++ )
+    {
+        topicLengths[ i ] = ( uint16_t ) std::strlen( topics[ i ] );
+
+        if( matchTopicLoop( topics[ i ], topicLengths[ i ], filterLengths, hasWildcard ) !=
+            BenchmarkRouter::match( topics[ i ], topicLengths[ i ] ) )
+        {
+            ( void ) std::fprintf( stderr, "Routes of %s differ.\n", topics[ i ] );
+            status = EXIT_FAILURE;
+        }
+    }
+
+    startNs = getTimeNs();
+
+    for( i = 0UL; i < BENCHMARK_ROUTE_COUNT; i++ )
+    {
+        loopChecksum += matchTopicLoop( topics[ i % TOPIC_COUNT ], topicLengths[ i % TOPIC_COUNT ], filterLengths, hasWildcard );
+    }
+
+    loopNs = getTimeNs() - startNs;
+    startNs = getTimeNs();
+
+    for( i = 0UL; i < BENCHMARK_ROUTE_COUNT; i++ )
+    {
+        routerChecksum += BenchmarkRouter::match( topics[ i % TOPIC_COUNT ], topicLengths[ i % TOPIC_COUNT ] );
+    }
+
+    routerNs = getTimeNs() - startNs;
+
+    if( loopChecksum != routerChecksum )
+    {
+        status = EXIT_FAILURE;
+    }
+
+    ( void ) std::printf( "%-24s filters=%2lu ns/route=%.1f\n",
+                          "MQTT_MatchTopic loop",
+                          ( unsigned long ) FILTER_COUNT,
+                          ( double ) loopNs / ( double ) BENCHMARK_ROUTE_COUNT );
+    ( void ) std::printf( "%-24s filters=%2lu ns/route=%.1f\n",
+                          "Compile-time router",
+                          ( unsigned long ) FILTER_COUNT,
+                          ( double ) routerNs / ( double ) BENCHMARK_ROUTE_COUNT );
+
+    return status;
+}
@@ -0,0 +1,325 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file core_mqtt_server_codec_benchmark.c
+ * @brief Measures the throughput of the server-role codec: framing and
+ * deserializing the packets a client sends, and serializing the replies.
+ *
+ * Each packet is serialized once by the client serializer, then framed and
+ * deserialized in place many times, as a bridge or a local broker would for
+ * every packet it reads.
+ */
+
+#define _POSIX_C_SOURCE    199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "core_mqtt.h"
+
+/**
+ * @brief Number of times each packet is parsed.
+ */
+#define BENCHMARK_ITERATIONS    ( 2000000UL )
+
+/**
+ * @brief Number of topic filters of the SUBSCRIBE and UNSUBSCRIBE.
+ */
+#define BENCHMARK_FILTERS       ( 8U )
+
+static uint64_t getTimeNs( void )
+{
+    struct timespec now;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( ( uint64_t ) now.tv_sec * 1000000000ULL ) + ( uint64_t ) now.tv_nsec;
+}
+
+/**
+ * @brief Frame and deserialize the packet in @p pBuffer as a server, once.
+ *
+ * @param[in] pBuffer The serialized packet.
+ * @param[in] packetSize Size of the packet.
+ * @param[out] pChecksum Updated from the deserialized fields, so the work is
+ * not optimized out.
+ *
+ * @return #MQTTSuccess if the packet was deserialized.
+ */
+static MQTTStatus_t parsePacket( uint8_t * pBuffer,
+                                 size_t packetSize,
+                                 size_t * pChecksum )
+{
+    MQTTPacketInfo_t packetInfo = { 0 };
+    MQTTConnectInfo_t connectInfo;
+    MQTTPublishInfo_t willInfo;
+    MQTTSubscribeInfo_t filters[ BENCHMARK_FILTERS ];
+    MQTTStatus_t status;
+    size_t length = packetSize, count = BENCHMARK_FILTERS;
+    uint16_t packetId = 0U;
+    bool willPresent = false;
+
+    status = MQTT_ProcessIncomingServerPacketTypeAndLength( pBuffer, &length, &packetInfo );
+
+    if( status == MQTTSuccess )
+    {
+        packetInfo.pRemainingData = &pBuffer[ packetInfo.headerLength ];
+
+        switch( packetInfo.type & 0xF0U )
+        {
+            case MQTT_PACKET_TYPE_CONNECT:
+                status = MQTT_DeserializeConnect( &packetInfo, &connectInfo, &willInfo, &willPresent );
+                *pChecksum += connectInfo.clientIdentifierLength + willInfo.payloadLength;
+                break;
+
+            case ( MQTT_PACKET_TYPE_SUBSCRIBE & 0xF0U ):
+                status = MQTT_DeserializeSubscribe( &packetInfo, &packetId, filters, &count );
+                *pChecksum += count + filters[ 0 ].topicFilterLength;
+                break;
+
+            case ( MQTT_PACKET_TYPE_UNSUBSCRIBE & 0xF0U ):
+                status = MQTT_DeserializeUnsubscribe( &packetInfo, &packetId, filters, &count );
+                *pChecksum += count + filters[ 0 ].topicFilterLength;
+                break;
+
+            default:
+                status = MQTT_DeserializePingreq( &packetInfo );
+                *pChecksum += packetInfo.remainingLength + 1U;
+                break;
+        }
+    }
+
+    return status;
+}
+
+/**
+ * @brief Parse the packet in @p pBuffer many times and print the time taken
+ * per packet and the throughput.
+ *
+ * @param[in] pName Name of the packet.
+ * @param[in] pBuffer The serialized packet.
+ * @param[in] packetSize Size of the packet.
+ *
+ * @return #MQTTSuccess if every parse succeeded.
+ */
+static MQTTStatus_t runBenchmark( const char * pName,
+                                  uint8_t * pBuffer,
+                                  size_t packetSize )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    uint64_t startNs, elapsedNs;
+    size_t checksum = 0U;
+    unsigned long i;
+
+    startNs = getTimeNs();
+
+    for( i = 0UL; ( i < BENCHMARK_ITERATIONS ) && ( status == MQTTSuccess ); i++ )
+    {
+        status = parsePacket( pBuffer, packetSize, &checksum );
+    }
+
+    elapsedNs = getTimeNs() - startNs;
+
+    if( status != MQTTSuccess )
+    {
+        ( void ) fprintf( stderr, "%s failed with status %s.\n",
+                          pName, MQTT_Status_strerror( status ) );
+    }
+    else
+    {
+        ( void ) printf( "%-12s bytes=%4lu ns/packet=%6.1f packets/s=%10.0f MB/s=%7.1f (%lu)\n",
+                         pName,
+                         ( unsigned long ) packetSize,
+                         ( double ) elapsedNs / ( double ) BENCHMARK_ITERATIONS,
+                         1e9 * ( double ) BENCHMARK_ITERATIONS / ( double ) elapsedNs,
+                         1e3 * ( double ) ( packetSize * BENCHMARK_ITERATIONS ) / ( double ) elapsedNs,
+                         ( unsigned long ) ( checksum & 0xFFUL ) );
+    }
+
+    return status;
+}
+
+/**
+ * @brief Serialize a SUBACK for @p BENCHMARK_FILTERS topic filters many times
+ * and print the time taken per packet.
+ *
+ * @return #MQTTSuccess if every SUBACK was serialized.
+ */
+static MQTTStatus_t runSubackBenchmark( void )
+{
+    static uint8_t buffer[ 64 ];
+    static const uint8_t returnCodes[ BENCHMARK_FILTERS ] = { 0, 1, 2, 0, 1, 2, 0, 0x80 };
+    MQTTFixedBuffer_t networkBuffer;
+    MQTTStatus_t status;
+    size_t remainingLength = 0U, packetSize = 0U;
+    uint64_t startNs, elapsedNs;
+    unsigned long i;
+
+    networkBuffer.pBuffer = buffer;
+    networkBuffer.size = sizeof( buffer );
+
+    status = MQTT_GetSubackPacketSize( BENCHMARK_FILTERS, &remainingLength, &packetSize );
+    startNs = getTimeNs();
+
+    for( i = 0UL; ( i < BENCHMARK_ITERATIONS ) && ( status == MQTTSuccess ); i++ )
+    {
+        status = MQTT_SerializeSuback( returnCodes, BENCHMARK_FILTERS,
+                                       ( uint16_t ) ( ( i & 0xFFFFUL ) | 1UL ),
+                                       remainingLength, &networkBuffer );
+    }
+
+    elapsedNs = getTimeNs() - startNs;
+
+    if( status != MQTTSuccess )
+    {
+        ( void ) fprintf( stderr, "SUBACK failed with status %s.\n", MQTT_Status_strerror( status ) );
+    }
+    else
+    {
+        ( void ) printf( "%-12s bytes=%4lu ns/packet=%6.1f packets/s=%10.0f\n",
+                         "SUBACK out",
+                         ( unsigned long ) packetSize,
+                         ( double ) elapsedNs / ( double ) BENCHMARK_ITERATIONS,
+                         1e9 * ( double ) BENCHMARK_ITERATIONS / ( double ) elapsedNs );
+    }
+
+    return status;
+}
+
+int main( void )
+{
+    static uint8_t connectBuffer[ 256 ];
+    static uint8_t subscribeBuffer[ 512 ];
+    static uint8_t unsubscribeBuffer[ 512 ];
+    static uint8_t pingreqBuffer[ MQTT_PINGRESP_PACKET_SIZE ];
+    static char filters[ BENCHMARK_FILTERS ][ 64 ];
+    static const char willPayload[] = "{\"state\":\"offline\"}";
+    MQTTSubscribeInfo_t subscriptions[ BENCHMARK_FILTERS ];
+    MQTTConnectInfo_t connectInfo = { 0 };
+    MQTTPublishInfo_t willInfo = { 0 };
+    MQTTFixedBuffer_t networkBuffer;
+    MQTTStatus_t status;
+    size_t remainingLength = 0U, connectSize = 0U, subscribeSize = 0U, unsubscribeSize = 0U;
+    size_t pingreqSize = 0U;
+    unsigned long i;
+
+    for( i = 0UL; i < BENCHMARK_FILTERS; i++ )
+    {
+        ( void ) snprintf( filters[ i ], sizeof( filters[ i ] ),
+                           "factory/building-7/+/machine-%02lu/sensors/#", i );
+        subscriptions[ i ].qos = ( MQTTQoS_t ) ( i % 3UL );
+        subscriptions[ i ].pTopicFilter = filters[ i ];
+        subscriptions[ i ].topicFilterLength = ( uint16_t ) strlen( filters[ i ] );
+    }
+
+    connectInfo.cleanSession = true;
+    connectInfo.keepAliveSeconds = 60U;
+    connectInfo.pClientIdentifier = "bridge-benchmark-client";
+    connectInfo.clientIdentifierLength = ( uint16_t ) strlen( connectInfo.pClientIdentifier );
+    connectInfo.pUserName = "bridge";
+    connectInfo.userNameLength = 6U;
+    connectInfo.pPassword = "secret";
+    connectInfo.passwordLength = 6U;
+
+    willInfo.qos = MQTTQoS1;
+    willInfo.pTopicName = "factory/building-7/status";
+    willInfo.topicNameLength = ( uint16_t ) strlen( willInfo.pTopicName );
+    willInfo.pPayload = willPayload;
+    willInfo.payloadLength = sizeof( willPayload ) - 1U;
+
+    networkBuffer.pBuffer = connectBuffer;
+    networkBuffer.size = sizeof( connectBuffer );
+    status = MQTT_GetConnectPacketSize( &connectInfo, &willInfo, &remainingLength, &connectSize );
+
+    if( status == MQTTSuccess )
+    {
+        status = MQTT_SerializeConnect( &connectInfo, &willInfo, remainingLength, &networkBuffer );
+    }
+
+    if( status == MQTTSuccess )
+    {
+        networkBuffer.pBuffer = subscribeBuffer;
+        networkBuffer.size = sizeof( subscribeBuffer );
+        status = MQTT_GetSubscribePacketSize( subscriptions, BENCHMARK_FILTERS, &remainingLength, &subscribeSize );
+    }
+
+    if( status == MQTTSuccess )
+    {
+        status = MQTT_SerializeSubscribe( subscriptions, BENCHMARK_FILTERS, 1U, remainingLength, &networkBuffer );
+    }
+
+    if( status == MQTTSuccess )
+    {
+        networkBuffer.pBuffer = unsubscribeBuffer;
+        networkBuffer.size = sizeof( unsubscribeBuffer );
+        status = MQTT_GetUnsubscribePacketSize( subscriptions, BENCHMARK_FILTERS, &remainingLength, &unsubscribeSize );
+    }
+
+    if( status == MQTTSuccess )
+    {
+        status = MQTT_SerializeUnsubscribe( subscriptions, BENCHMARK_FILTERS, 2U, remainingLength, &networkBuffer );
+    }
+
+    if( status == MQTTSuccess )
+    {
+        networkBuffer.pBuffer = pingreqBuffer;
+        networkBuffer.size = sizeof( pingreqBuffer );
+        status = MQTT_GetPingreqPacketSize( &pingreqSize );
+    }
+
+    if( status == MQTTSuccess )
+    {
+        status = MQTT_SerializePingreq( &networkBuffer );
+    }
+
+    if( status == MQTTSuccess )
+    {
+        status = runBenchmark( "CONNECT", connectBuffer, connectSize );
+    }
+
+    if( status == MQTTSuccess )
+    {
+        status = runBenchmark( "SUBSCRIBE", subscribeBuffer, subscribeSize );
+    }
+
+    if( status == MQTTSuccess )
+    {
+        status = runBenchmark( "UNSUBSCRIBE", unsubscribeBuffer, unsubscribeSize );
+    }
+
+    if( status == MQTTSuccess )
+    {
+        status = runBenchmark( "PINGREQ", pingreqBuffer, pingreqSize );
+    }
+
+    if( status == MQTTSuccess )
+    {
+        status = runSubackBenchmark();
+    }
+
+    return ( status == MQTTSuccess ) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
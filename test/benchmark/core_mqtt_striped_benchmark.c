@@ -0,0 +1,372 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file core_mqtt_striped_benchmark.c
+ * @brief Measures the QoS0 publish throughput of a striped client as the
+ * number of stripes grows.
+ *
+ * The stand-in broker serves each loopback connection from its own session
+ * thread, which handles at most #BENCHMARK_SESSION_RATE publishes per second,
+ * the way a broker session thread caps the throughput of one connection.
+ */
+
+#define _POSIX_C_SOURCE    200809L
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "core_mqtt_striped.h"
+#include "tcp_posix_transport.h"
+
+/**
+ * @brief Each compilation unit that uses the transport must define the
+ * NetworkContext struct.
+ */
+struct NetworkContext
+{
+    TcpPosixTransportParams_t * pParams;
+};
+
+/**
+ * @brief Largest number of stripes measured.
+ */
+#define BENCHMARK_MAX_STRIPES      ( 8U )
+
+/**
+ * @brief Number of publishes sent by each run.
+ */
+#define BENCHMARK_PUBLISH_COUNT    ( 100000UL )
+
+/**
+ * @brief Number of topics the publishes are spread over.
+ */
+#define BENCHMARK_TOPIC_COUNT      ( 64U )
+
+/**
+ * @brief Publishes handled per second by one session of the stand-in broker.
+ */
+#define BENCHMARK_SESSION_RATE     ( 50000UL )
+
+/**
+ * @brief One session of the stand-in broker.
+ */
+typedef struct BrokerSession
+{
+    int socket;
+    unsigned long publishCount;
+} BrokerSession_t;
+
+static uint64_t getTimeNs( void )
+{
+    struct timespec now;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( ( uint64_t ) now.tv_sec * 1000000000ULL ) + ( uint64_t ) now.tv_nsec;
+}
+
+static uint32_t getTimeMs( void )
+{
+    return ( uint32_t ) ( getTimeNs() / 1000000ULL );
+}
+
+static void eventCallback( MQTTStripedClient_t * pClient,
+                           size_t stripeIndex,
+                           MQTTPacketInfo_t * pPacketInfo,
+                           MQTTDeserializedInfo_t * pDeserializedInfo )
+{
+    ( void ) pClient;
+    ( void ) stripeIndex;
+    ( void ) pPacketInfo;
+    ( void ) pDeserializedInfo;
+}
+
+static bool readExact( int socketDescriptor,
+                       uint8_t * pBuffer,
+                       size_t length )
+{
+    size_t received = 0U;
+    ssize_t result = 1;
+
+    while( ( received < length ) && ( result > 0 ) )
+    {
+        result = recv( socketDescriptor, &pBuffer[ received ], length - received, 0 );
+
+        if( result > 0 )
+        {
+            received += ( size_t ) result;
+        }
+    }
+
+    return received == length;
+}
+
+/**
+ * @brief Session thread of the stand-in broker. It answers the CONNECT, then
+ * paces itself to #BENCHMARK_SESSION_RATE publishes per second until the
+ * DISCONNECT.
+ */
+static void * sessionThread( void * pArgument )
+{
+    BrokerSession_t * pSession = ( BrokerSession_t * ) pArgument;
+    static const uint8_t connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    uint8_t buffer[ 256 ];
+    uint8_t type = 0U, byte = 0U;
+    size_t remainingLength, multiplier;
+    uint64_t startNs = 0U, dueNs, nowNs;
+    struct timespec pause;
+    bool success = true;
+
+    while( success && ( type != 0xE0U ) )
+    {
+        remainingLength = 0U;
+        multiplier = 1U;
+        success = readExact( pSession->socket, &type, 1U );
+
+        do
+        {
+            success = success && readExact( pSession->socket, &byte, 1U );
+            remainingLength += ( size_t ) ( byte & 0x7FU ) * multiplier;
+            multiplier *= 128U;
+        } while( success && ( ( byte & 0x80U ) != 0U ) );
+
+        success = success && ( remainingLength <= sizeof( buffer ) ) &&
+                  readExact( pSession->socket, buffer, remainingLength );
+
+        if( success && ( type == 0x10U ) )
+        {
+            success = send( pSession->socket, connack, sizeof( connack ), 0 ) == ( ssize_t ) sizeof( connack );
+            startNs = getTimeNs();
+        }
+        else if( success && ( ( type & 0xF0U ) == 0x30U ) )
+        {
+            pSession->publishCount++;
+
+            /* Pace the session in batches, so that sleeping stays cheap. */
+            if( ( pSession->publishCount % 64UL ) == 0UL )
+            {
+                dueNs = startNs + ( ( uint64_t ) pSession->publishCount * 1000000000ULL / BENCHMARK_SESSION_RATE );
+                nowNs = getTimeNs();
+
+                if( nowNs < dueNs )
+                {
+                    pause.tv_sec = ( time_t ) ( ( dueNs - nowNs ) / 1000000000ULL );
+                    pause.tv_nsec = ( long ) ( ( dueNs - nowNs ) % 1000000000ULL );
+                    ( void ) nanosleep( &pause, NULL );
+                }
+            }
+        }
+        else
+        {
+            /* Other packets are consumed. */
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Publish #BENCHMARK_PUBLISH_COUNT messages over a striped client.
+ *
+ * @return The time until every session has handled its publishes, in
+ * nanoseconds, or 0 if the run failed.
+ */
+static uint64_t runStriped( size_t stripeCount )
+{
+    static MQTTStripe_t stripes[ BENCHMARK_MAX_STRIPES ];
+    static uint8_t buffers[ BENCHMARK_MAX_STRIPES ][ 256 ];
+    static char clientIds[ BENCHMARK_MAX_STRIPES ][ 16 ];
+    static char topics[ BENCHMARK_TOPIC_COUNT ][ 32 ];
+    static const char payload[] = "{\"temperature\":21.5,\"rh\":40}";
+    TcpPosixTransportParams_t tcpParams[ BENCHMARK_MAX_STRIPES ];
+    NetworkContext_t networkContexts[ BENCHMARK_MAX_STRIPES ];
+    TransportInterface_t transports[ BENCHMARK_MAX_STRIPES ];
+    MQTTFixedBuffer_t networkBuffers[ BENCHMARK_MAX_STRIPES ];
+    MQTTConnectInfo_t connectInfos[ BENCHMARK_MAX_STRIPES ];
+    BrokerSession_t sessions[ BENCHMARK_MAX_STRIPES ];
+    pthread_t sessionThreads[ BENCHMARK_MAX_STRIPES ];
+    MQTTPublishInfo_t publishInfo = { 0 };
+    MQTTStripedClient_t client;
+    MQTTStatus_t status = MQTTSuccess;
+    struct sockaddr_in address;
+    socklen_t addressLength = sizeof( address );
+    int listenSocket = socket( AF_INET, SOCK_STREAM, 0 );
+    size_t i, threadCount = 0U;
+    unsigned long publishCount = 0UL;
+    uint64_t startNs, elapsedNs = 0U;
+
+    ( void ) memset( &address, 0x00, sizeof( address ) );
+    ( void ) memset( connectInfos, 0x00, sizeof( connectInfos ) );
+    ( void ) memset( transports, 0x00, sizeof( transports ) );
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+
+    if( ( listenSocket < 0 ) ||
+        ( bind( listenSocket, ( struct sockaddr * ) &address, sizeof( address ) ) != 0 ) ||
+        ( listen( listenSocket, ( int ) stripeCount ) != 0 ) ||
+        ( getsockname( listenSocket, ( struct sockaddr * ) &address, &addressLength ) != 0 ) )
+    {
+        status = MQTTSendFailed;
+    }
+
+    for( i = 0U; ( i < stripeCount ) && ( status == MQTTSuccess ); i++ )
+    {
+        tcpParams[ i ].socketDescriptor = -1;
+        networkContexts[ i ].pParams = &tcpParams[ i ];
+        transports[ i ].pNetworkContext = &networkContexts[ i ];
+        transports[ i ].recv = TcpPosixTransport_Recv;
+        transports[ i ].send = TcpPosixTransport_Send;
+        transports[ i ].writev = TcpPosixTransport_Writev;
+        networkBuffers[ i ].pBuffer = buffers[ i ];
+        networkBuffers[ i ].size = sizeof( buffers[ i ] );
+        ( void ) snprintf( clientIds[ i ], sizeof( clientIds[ i ] ), "striped-%u", ( unsigned int ) i );
+        connectInfos[ i ].cleanSession = true;
+        connectInfos[ i ].keepAliveSeconds = 60U;
+        connectInfos[ i ].pClientIdentifier = clientIds[ i ];
+        connectInfos[ i ].clientIdentifierLength = ( uint16_t ) strlen( clientIds[ i ] );
+        sessions[ i ].publishCount = 0UL;
+
+        if( TcpPosixTransport_Connect( &networkContexts[ i ], "127.0.0.1", ntohs( address.sin_port ), 1000U ) !=
+            TCP_POSIX_TRANSPORT_SUCCESS )
+        {
+            status = MQTTSendFailed;
+        }
+        else
+        {
+            sessions[ i ].socket = accept( listenSocket, NULL, NULL );
+
+            if( ( sessions[ i ].socket < 0 ) ||
+                ( pthread_create( &sessionThreads[ i ], NULL, sessionThread, &sessions[ i ] ) != 0 ) )
+            {
+                status = MQTTSendFailed;
+            }
+            else
+            {
+                threadCount++;
+            }
+        }
+    }
+
+    if( status == MQTTSuccess )
+    {
+        status = MQTTStriped_Init( &client, stripes, stripeCount, transports, getTimeMs, eventCallback, networkBuffers );
+    }
+
+    if( status == MQTTSuccess )
+    {
+        status = MQTTStriped_Connect( &client, connectInfos, NULL, 1000U, NULL );
+    }
+
+    for( i = 0U; i < BENCHMARK_TOPIC_COUNT; i++ )
+    {
+        ( void ) snprintf( topics[ i ], sizeof( topics[ i ] ), "devices/%04u/telemetry", ( unsigned int ) i );
+    }
+
+    publishInfo.qos = MQTTQoS0;
+    publishInfo.pPayload = payload;
+    publishInfo.payloadLength = sizeof( payload ) - 1U;
+    startNs = getTimeNs();
+
+    for( publishCount = 0UL; ( publishCount < BENCHMARK_PUBLISH_COUNT ) && ( status == MQTTSuccess ); publishCount++ )
+    {
+        publishInfo.pTopicName = topics[ publishCount % BENCHMARK_TOPIC_COUNT ];
+        publishInfo.topicNameLength = ( uint16_t ) strlen( publishInfo.pTopicName );
+        status = MQTTStriped_Publish( &client, &publishInfo, NULL, NULL );
+    }
+
+    if( status == MQTTSuccess )
+    {
+        status = MQTTStriped_Disconnect( &client );
+    }
+
+    /* The sessions return once they have handled everything before the
+     * DISCONNECT. */
+    for( i = 0U; i < stripeCount; i++ )
+    {
+        if( tcpParams[ i ].socketDescriptor >= 0 )
+        {
+            if( status != MQTTSuccess )
+            {
+                ( void ) shutdown( tcpParams[ i ].socketDescriptor, SHUT_RDWR );
+            }
+
+            if( i < threadCount )
+            {
+                ( void ) pthread_join( sessionThreads[ i ], NULL );
+                ( void ) close( sessions[ i ].socket );
+            }
+
+            ( void ) TcpPosixTransport_Disconnect( &networkContexts[ i ] );
+        }
+    }
+
+    if( status == MQTTSuccess )
+    {
+        elapsedNs = getTimeNs() - startNs;
+    }
+    else
+    {
+        ( void ) fprintf( stderr, "Run with %lu stripes failed with status %s.\n",
+                          ( unsigned long ) stripeCount,
+                          MQTT_Status_strerror( status ) );
+    }
+
+    if( listenSocket >= 0 )
+    {
+        ( void ) close( listenSocket );
+    }
+
+    return elapsedNs;
+}
+
+int main( void )
+{
+    size_t stripeCount;
+    uint64_t elapsedNs = 1U, baselineNs = 0U;
+
+    for( stripeCount = 1U; ( stripeCount <= BENCHMARK_MAX_STRIPES ) && ( elapsedNs != 0U ); stripeCount *= 2U )
+    {
+        elapsedNs = runStriped( stripeCount );
+
+        if( elapsedNs != 0U )
+        {
+            baselineNs = ( stripeCount == 1U ) ? elapsedNs : baselineNs;
+            ( void ) printf( "stripes=%lu publishes/s=%.0f speedup=%.2f\n",
+                             ( unsigned long ) stripeCount,
+                             ( double ) BENCHMARK_PUBLISH_COUNT * 1e9 / ( double ) elapsedNs,
+                             ( double ) baselineNs / ( double ) elapsedNs );
+        }
+    }
+
+    return ( elapsedNs != 0U ) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
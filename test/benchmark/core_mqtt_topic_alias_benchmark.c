@@ -0,0 +1,269 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file core_mqtt_topic_alias_benchmark.c
+ * @brief Measures the bytes sent and the cost of QoS0 publishes with long
+ * topic names, with MQTT 3.1.1 and with MQTT 5 topic aliases.
+ *
+ * The publishes cycle through a set of topics. When there are more topics than
+ * aliases, every publish replaces the least recently used alias, which is the
+ * worst case of the alias table.
+ */
+
+#define _POSIX_C_SOURCE    199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "core_mqtt.h"
+
+/**
+ * @brief Number of publishes to time in each run.
+ */
+#define BENCHMARK_PUBLISH_COUNT    ( 1000000UL )
+
+/**
+ * @brief Number of topic aliases given to the library.
+ */
+#define BENCHMARK_ALIAS_COUNT      ( 16U )
+
+/**
+ * @brief The largest number of topics published to.
+ */
+#define BENCHMARK_MAX_TOPICS       ( 32U )
+
+/**
+ * @brief Transport which replays a CONNACK and counts everything sent.
+ */
+struct NetworkContext
+{
+    const uint8_t * pRxData;
+    size_t rxLength;
+    uint64_t bytesSent;
+};
+
+static int32_t transportRecv( NetworkContext_t * pNetworkContext,
+                              void * pBuffer,
+                              size_t bytesToRecv )
+{
+    if( bytesToRecv > pNetworkContext->rxLength )
+    {
+        bytesToRecv = pNetworkContext->rxLength;
+    }
+
+    ( void ) memcpy( pBuffer, pNetworkContext->pRxData, bytesToRecv );
+    pNetworkContext->pRxData += bytesToRecv;
+    pNetworkContext->rxLength -= bytesToRecv;
+
+    return ( int32_t ) bytesToRecv;
+}
+
+static int32_t transportSend( NetworkContext_t * pNetworkContext,
+                              const void * pBuffer,
+                              size_t bytesToSend )
+{
+    ( void ) pBuffer;
+
+    pNetworkContext->bytesSent += bytesToSend;
+
+    return ( int32_t ) bytesToSend;
+}
+
+static uint32_t getTime( void )
+{
+    return 0U;
+}
+
+static void eventCallback( MQTTContext_t * pContext,
+                           MQTTPacketInfo_t * pPacketInfo,
+                           MQTTDeserializedInfo_t * pDeserializedInfo )
+{
+    ( void ) pContext;
+    ( void ) pPacketInfo;
+    ( void ) pDeserializedInfo;
+}
+
+static uint64_t getTimeNs( void )
+{
+    struct timespec now;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( ( uint64_t ) now.tv_sec * 1000000000ULL ) + ( uint64_t ) now.tv_nsec;
+}
+
+/**
+ * @brief Publish to @p topicCount topics in turn and print the bytes sent and
+ * the time taken per publish.
+ *
+ * @param[in] pName Name of the run.
+ * @param[in] protocolVersion The MQTT version to connect with.
+ * @param[in] useAliases Whether to give topic aliases to the library.
+ * @param[in] topicCount Number of topics to publish to.
+ * @param[in,out] pBaselineBytes Bytes per publish of the MQTT 3.1.1 run, to
+ * which the other runs are compared. Set by the MQTT 3.1.1 run.
+ *
+ * @return #MQTTSuccess if all publishes were sent.
+ */
+static MQTTStatus_t runBenchmark( const char * pName,
+                                  uint8_t protocolVersion,
+                                  bool useAliases,
+                                  size_t topicCount,
+                                  double * pBaselineBytes )
+{
+    static const uint8_t connack[] = { 0x20, 0x02, 0x00, 0x00 };
+
+    /* CONNACK of MQTT 5 with a Topic Alias Maximum of 16. */
+    static const uint8_t connackV5[] = { 0x20, 0x06, 0x00, 0x00, 0x03, 0x22, 0x00, 0x10 };
+    static uint8_t buffer[ 256 ];
+    static MQTTTopicAliasRecord_t topicAliases[ BENCHMARK_ALIAS_COUNT ];
+    static char topics[ BENCHMARK_MAX_TOPICS ][ 96 ];
+    static const char payload[] = "{\"temperature\":21.5}";
+    NetworkContext_t networkContext = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer;
+    MQTTConnectInfo_t connectInfo = { 0 };
+    MQTTPublishInfo_t publishInfo = { 0 };
+    MQTTContext_t context;
+    MQTTStatus_t status;
+    bool sessionPresent = false;
+    uint64_t startNs, elapsedNs, startBytes;
+    double bytesPerPublish;
+    unsigned long i;
+
+    for( i = 0UL; i < topicCount; i++ )
+    {
+        ( void ) snprintf( topics[ i ], sizeof( topics[ i ] ),
+                           "factory/building-7/floor-3/production-line-12/machine-%02lu/"
+                           "sensors/temperature/celsius", i );
+    }
+
+    if( protocolVersion == MQTT_VERSION_5 )
+    {
+        networkContext.pRxData = connackV5;
+        networkContext.rxLength = sizeof( connackV5 );
+    }
+    else
+    {
+        networkContext.pRxData = connack;
+        networkContext.rxLength = sizeof( connack );
+    }
+
+    transport.pNetworkContext = &networkContext;
+    transport.recv = transportRecv;
+    transport.send = transportSend;
+    networkBuffer.pBuffer = buffer;
+    networkBuffer.size = sizeof( buffer );
+
+    connectInfo.cleanSession = true;
+    connectInfo.pClientIdentifier = "benchmark";
+    connectInfo.clientIdentifierLength = 9U;
+
+    publishInfo.qos = MQTTQoS0;
+    publishInfo.pPayload = payload;
+    publishInfo.payloadLength = sizeof( payload ) - 1U;
+
+    status = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+
+    if( status == MQTTSuccess )
+    {
+        status = MQTT_SetProtocolVersion( &context, protocolVersion );
+    }
+
+    if( ( status == MQTTSuccess ) && ( useAliases == true ) )
+    {
+        status = MQTT_InitTopicAliases( &context, topicAliases, BENCHMARK_ALIAS_COUNT );
+    }
+
+    if( status == MQTTSuccess )
+    {
+        status = MQTT_Connect( &context, &connectInfo, NULL, 0U, &sessionPresent );
+    }
+
+    startBytes = networkContext.bytesSent;
+    startNs = getTimeNs();
+
+    for( i = 0UL; ( i < BENCHMARK_PUBLISH_COUNT ) && ( status == MQTTSuccess ); i++ )
+    {
+        publishInfo.pTopicName = topics[ i % topicCount ];
+        publishInfo.topicNameLength = ( uint16_t ) strlen( publishInfo.pTopicName );
+        status = MQTT_Publish( &context, &publishInfo, 0U );
+    }
+
+    elapsedNs = getTimeNs() - startNs;
+
+    if( status != MQTTSuccess )
+    {
+        ( void ) fprintf( stderr, "%s failed with status %s.\n",
+                          pName, MQTT_Status_strerror( status ) );
+    }
+    else
+    {
+        bytesPerPublish = ( double ) ( networkContext.bytesSent - startBytes ) /
+                          ( double ) BENCHMARK_PUBLISH_COUNT;
+
+        if( protocolVersion == MQTT_VERSION_3_1_1 )
+        {
+            *pBaselineBytes = bytesPerPublish;
+        }
+
+        ( void ) printf( "%-26s topics=%2lu bytes/publish=%6.1f saved=%5.1f%% ns/publish=%.1f\n",
+                         pName,
+                         ( unsigned long ) topicCount,
+                         bytesPerPublish,
+                         100.0 * ( 1.0 - ( bytesPerPublish / *pBaselineBytes ) ),
+                         ( double ) elapsedNs / ( double ) BENCHMARK_PUBLISH_COUNT );
+    }
+
+    return status;
+}
+
+int main( void )
+{
+    MQTTStatus_t status;
+    double baselineBytes = 1.0;
+
+    status = runBenchmark( "MQTT 3.1.1", MQTT_VERSION_3_1_1, false, 8U, &baselineBytes );
+
+    if( status == MQTTSuccess )
+    {
+        status = runBenchmark( "MQTT 5", MQTT_VERSION_5, false, 8U, &baselineBytes );
+    }
+
+    if( status == MQTTSuccess )
+    {
+        status = runBenchmark( "MQTT 5 topic aliases", MQTT_VERSION_5, true, 8U, &baselineBytes );
+    }
+
+    if( status == MQTTSuccess )
+    {
+        /* Twice as many topics as aliases: every publish evicts an alias. */
+        status = runBenchmark( "MQTT 5 topic aliases, LRU", MQTT_VERSION_5, true, BENCHMARK_MAX_TOPICS, &baselineBytes );
+    }
+
+    return ( status == MQTTSuccess ) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,472 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file shm_ring_transport_benchmark.c
+ * @brief Compares the QoS0 publish round trip time and throughput of a client
+ * talking to a stand-in broker on the same host, over the shared memory ring
+ * transport and over a loopback TCP connection.
+ *
+ * The stand-in broker runs in a thread of its own. It answers the CONNECT and
+ * either echoes each PUBLISH back to the client, for the round trip time, or
+ * only consumes it, for the throughput.
+ */
+
+#define _POSIX_C_SOURCE    200809L
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+
+#include "core_mqtt.h"
+#include "shm_ring_transport.h"
+#include "tcp_posix_transport.h"
+
+/**
+ * @brief Each compilation unit that uses a transport must define the
+ * NetworkContext struct. Both transports only reach their parameters through
+ * the `pParams` member, so one definition serves both.
+ */
+struct NetworkContext
+{
+    void * pParams;
+};
+
+/**
+ * @brief Number of round trips measured per transport.
+ */
+#define BENCHMARK_ROUND_TRIP_COUNT    ( 100000UL )
+
+/**
+ * @brief Number of publishes sent by each throughput run.
+ */
+#define BENCHMARK_PUBLISH_COUNT       ( 1000000UL )
+
+/**
+ * @brief Size of each ring of the shared memory segment.
+ */
+#define BENCHMARK_RING_SIZE           ( 65536U )
+
+/**
+ * @brief The two ends of a connection between the client and the stand-in
+ * broker, over either transport.
+ */
+typedef struct BenchmarkConnection
+{
+    const char * pName;
+    ShmRingTransportParams_t shmParams[ 2 ];
+    TcpPosixTransportParams_t tcpParams[ 2 ];
+    NetworkContext_t networkContexts[ 2 ];
+    TransportInterface_t transports[ 2 ];
+} BenchmarkConnection_t;
+
+/**
+ * @brief The stand-in broker.
+ */
+typedef struct Broker
+{
+    BenchmarkConnection_t * pConnection;
+    bool echo;
+    unsigned long publishCount;
+} Broker_t;
+
+/**
+ * @brief Number of publishes echoed back to the client.
+ */
+static unsigned long echoCount = 0UL;
+
+static uint64_t getTimeNs( void )
+{
+    struct timespec now;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( ( uint64_t ) now.tv_sec * 1000000000ULL ) + ( uint64_t ) now.tv_nsec;
+}
+
+static uint32_t getTimeMs( void )
+{
+    return ( uint32_t ) ( getTimeNs() / 1000000ULL );
+}
+
+static void eventCallback( MQTTContext_t * pContext,
+                           MQTTPacketInfo_t * pPacketInfo,
+                           MQTTDeserializedInfo_t * pDeserializedInfo )
+{
+    ( void ) pContext;
+    ( void ) pDeserializedInfo;
+
+    if( ( pPacketInfo->type & 0xF0U ) == MQTT_PACKET_TYPE_PUBLISH )
+    {
+        echoCount++;
+    }
+}
+
+static bool sendAll( const TransportInterface_t * pTransport,
+                     const uint8_t * pBuffer,
+                     size_t length )
+{
+    size_t sent = 0U;
+    int32_t result = 0;
+
+    while( ( sent < length ) && ( result >= 0 ) )
+    {
+        result = pTransport->send( pTransport->pNetworkContext, &pBuffer[ sent ], length - sent );
+        sent += ( result > 0 ) ? ( size_t ) result : 0U;
+
+        if( result == 0 )
+        {
+            result = pTransport->wait( pTransport->pNetworkContext, TRANSPORT_WAIT_WRITABLE, 1000U );
+        }
+    }
+
+    return sent == length;
+}
+
+/**
+ * @brief Thread of the stand-in broker. It handles whole packets from its
+ * buffer until the DISCONNECT, and waits on its transport when it has nothing
+ * to receive.
+ */
+static void * brokerThread( void * pArgument )
+{
+    Broker_t * pBroker = ( Broker_t * ) pArgument;
+    const TransportInterface_t * pTransport = &pBroker->pConnection->transports[ 1 ];
+    static const uint8_t connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    static const uint8_t pingresp[] = { 0xD0, 0x00 };
+    uint8_t buffer[ 4096 ];
+    size_t length = 0U, offset, packetLength, remainingLength, multiplier, index;
+    int32_t result = 0;
+    bool success = true, disconnected = false;
+
+    while( success && ( disconnected == false ) )
+    {
+        result = pTransport->recv( pTransport->pNetworkContext,
+                                            &buffer[ length ], sizeof( buffer ) - length );
+        success = ( result > 0 ) ||
+                  ( ( result == 0 ) && ( pTransport->wait( pTransport->pNetworkContext, TRANSPORT_WAIT_READABLE, 1000U ) >= 0 ) );
+        length += ( result > 0 ) ? ( size_t ) result : 0U;
+        offset = 0U;
+
+        while( success && ( disconnected == false ) && ( ( length - offset ) >= 2U ) )
+        {
+            remainingLength = 0U;
+            multiplier = 1U;
+            index = offset + 1U;
+
+            do
+            {
+                remainingLength += ( size_t ) ( buffer[ index ] & 0x7FU ) * multiplier;
+                multiplier *= 128U;
+                index++;
+            } while( ( index < length ) && ( ( buffer[ index - 1U ] & 0x80U ) != 0U ) );
+
+            packetLength = ( index - offset ) + remainingLength;
+
+            if( ( ( buffer[ index - 1U ] & 0x80U ) != 0U ) || ( ( length - offset ) < packetLength ) )
+            {
+                break;
+            }
+
+            if( buffer[ offset ] == MQTT_PACKET_TYPE_CONNECT )
+            {
+                success = sendAll( pTransport, connack, sizeof( connack ) );
+            }
+            else if( ( buffer[ offset ] & 0xF0U ) == MQTT_PACKET_TYPE_PUBLISH )
+            {
+                pBroker->publishCount++;
+                success = ( pBroker->echo == false ) ||
+                          sendAll( pTransport, &buffer[ offset ], packetLength );
+            }
+            else if( buffer[ offset ] == MQTT_PACKET_TYPE_PINGREQ )
+            {
+                success = sendAll( pTransport, pingresp, sizeof( pingresp ) );
+            }
+            else
+            {
+                disconnected = ( buffer[ offset ] == MQTT_PACKET_TYPE_DISCONNECT );
+            }
+
+            offset += packetLength;
+        }
+
+        ( void ) memmove( buffer, &buffer[ offset ], length - offset );
+        length -= offset;
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Connect both ends over the shared memory ring transport. The client
+ * writes its packets straight into the ring.
+ */
+static bool connectShm( BenchmarkConnection_t * pConnection )
+{
+    char name[ 64 ];
+    bool success;
+    size_t i;
+
+    ( void ) snprintf( name, sizeof( name ), "/coremqtt-benchmark-%ld", ( long ) getpid() );
+    pConnection->pName = "shm";
+
+    success = ( ShmRingTransport_Create( &pConnection->networkContexts[ 1 ], name, BENCHMARK_RING_SIZE ) ==
+                SHM_RING_TRANSPORT_SUCCESS );
+
+    if( success )
+    {
+        success = ( ShmRingTransport_Open( &pConnection->networkContexts[ 0 ], name ) == SHM_RING_TRANSPORT_SUCCESS );
+        ( void ) shm_unlink( name );
+    }
+
+    pConnection->transports[ 0 ].getTxBuffer = ShmRingTransport_GetTxBuffer;
+    pConnection->transports[ 0 ].commitTxBuffer = ShmRingTransport_CommitTxBuffer;
+
+    for( i = 0U; i < 2U; i++ )
+    {
+        pConnection->transports[ i ].recv = ShmRingTransport_Recv;
+        pConnection->transports[ i ].send = ShmRingTransport_Send;
+        pConnection->transports[ i ].writev = ShmRingTransport_Writev;
+        pConnection->transports[ i ].wait = ShmRingTransport_WaitEvent;
+    }
+
+    return success;
+}
+
+/**
+ * @brief Connect both ends over a loopback TCP connection, without Nagle's
+ * algorithm.
+ */
+static bool connectTcp( BenchmarkConnection_t * pConnection )
+{
+    struct sockaddr_in address;
+    socklen_t addressLength = sizeof( address );
+    int listenSocket = socket( AF_INET, SOCK_STREAM, 0 );
+    bool success;
+    size_t i;
+
+    ( void ) memset( &address, 0x00, sizeof( address ) );
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+    pConnection->pName = "tcp";
+
+    success = ( listenSocket >= 0 ) &&
+              ( bind( listenSocket, ( struct sockaddr * ) &address, sizeof( address ) ) == 0 ) &&
+              ( listen( listenSocket, 1 ) == 0 ) &&
+              ( getsockname( listenSocket, ( struct sockaddr * ) &address, &addressLength ) == 0 ) &&
+              ( TcpPosixTransport_Connect( &pConnection->networkContexts[ 0 ], "127.0.0.1",
+                                           ntohs( address.sin_port ), 1000U ) == TCP_POSIX_TRANSPORT_SUCCESS ) &&
+              ( TcpPosixTransport_Attach( &pConnection->networkContexts[ 1 ],
+                                          accept( listenSocket, NULL, NULL ) ) == TCP_POSIX_TRANSPORT_SUCCESS );
+
+    for( i = 0U; ( i < 2U ) && success; i++ )
+    {
+        success = ( TcpPosixTransport_SetNoDelay( &pConnection->networkContexts[ i ], true ) ==
+                    TCP_POSIX_TRANSPORT_SUCCESS );
+        pConnection->transports[ i ].recv = TcpPosixTransport_Recv;
+        pConnection->transports[ i ].send = TcpPosixTransport_Send;
+        pConnection->transports[ i ].writev = TcpPosixTransport_Writev;
+        pConnection->transports[ i ].wait = TcpPosixTransport_Wait;
+    }
+
+    if( listenSocket >= 0 )
+    {
+        ( void ) close( listenSocket );
+    }
+
+    return success;
+}
+
+static void disconnect( BenchmarkConnection_t * pConnection )
+{
+    size_t i;
+
+    for( i = 0U; i < 2U; i++ )
+    {
+        if( pConnection->shmParams[ i ].pSegment != NULL )
+        {
+            ( void ) ShmRingTransport_Disconnect( &pConnection->networkContexts[ i ] );
+        }
+
+        if( pConnection->tcpParams[ i ].socketDescriptor >= 0 )
+        {
+            ( void ) TcpPosixTransport_Disconnect( &pConnection->networkContexts[ i ] );
+        }
+    }
+}
+
+/**
+ * @brief Connect a client to a stand-in broker, and time its publishes.
+ *
+ * @param[in] connectTransport Connects both ends over one transport.
+ * @param[in] roundTrip Whether each publish waits for its echo.
+ * @param[in] publishCount Number of publishes.
+ *
+ * @return The time taken by the publishes, in nanoseconds, or 0 if the run
+ * failed.
+ */
+static uint64_t run( bool ( * connectTransport )( BenchmarkConnection_t * pConnection ),
+                     bool roundTrip,
+                     unsigned long publishCount )
+{
+    static BenchmarkConnection_t connection;
+    static uint8_t buffer[ 256 ];
+    static const char payload[] = "{\"temperature\":21.5,\"rh\":40}";
+    MQTTContext_t context;
+    MQTTFixedBuffer_t networkBuffer = { buffer, sizeof( buffer ) };
+    MQTTConnectInfo_t connectInfo = { 0 };
+    MQTTPublishInfo_t publishInfo = { 0 };
+    MQTTStatus_t status = MQTTSuccess;
+    Broker_t broker = { 0 };
+    pthread_t thread;
+    bool threadStarted = false, sessionPresent = false;
+    unsigned long i;
+    uint64_t startNs = 0U, elapsedNs = 0U;
+
+    ( void ) memset( &connection, 0x00, sizeof( connection ) );
+
+    for( i = 0UL; i < 2UL; i++ )
+    {
+        connection.tcpParams[ i ].socketDescriptor = -1;
+        connection.networkContexts[ i ].pParams = ( connectTransport == connectShm ) ?
+                                                  ( void * ) &connection.shmParams[ i ] :
+                                                  ( void * ) &connection.tcpParams[ i ];
+        connection.transports[ i ].pNetworkContext = &connection.networkContexts[ i ];
+    }
+
+    broker.pConnection = &connection;
+    broker.echo = roundTrip;
+    echoCount = 0UL;
+
+    if( connectTransport( &connection ) == false )
+    {
+        status = MQTTSendFailed;
+    }
+    else if( pthread_create( &thread, NULL, brokerThread, &broker ) != 0 )
+    {
+        status = MQTTSendFailed;
+    }
+    else
+    {
+        threadStarted = true;
+        status = MQTT_Init( &context, &connection.transports[ 0 ], getTimeMs, eventCallback, &networkBuffer );
+    }
+
+    if( status == MQTTSuccess )
+    {
+        connectInfo.cleanSession = true;
+        connectInfo.pClientIdentifier = "benchmark";
+        connectInfo.clientIdentifierLength = 9U;
+        status = MQTT_Connect( &context, &connectInfo, NULL, 1000U, &sessionPresent );
+    }
+
+    publishInfo.qos = MQTTQoS0;
+    publishInfo.pTopicName = "devices/0001/telemetry";
+    publishInfo.topicNameLength = ( uint16_t ) strlen( publishInfo.pTopicName );
+    publishInfo.pPayload = payload;
+    publishInfo.payloadLength = sizeof( payload ) - 1U;
+    startNs = getTimeNs();
+
+    for( i = 0UL; ( i < publishCount ) && ( status == MQTTSuccess ); i++ )
+    {
+        status = MQTT_Publish( &context, &publishInfo, 0U );
+
+        while( roundTrip && ( status == MQTTSuccess ) && ( echoCount == i ) )
+        {
+            status = ( connection.transports[ 0 ].wait( &connection.networkContexts[ 0 ],
+                                                        TRANSPORT_WAIT_READABLE, 1000U ) >= 0 ) ?
+                     MQTT_ProcessLoop( &context ) : MQTTRecvFailed;
+            status = ( status == MQTTNeedMoreBytes ) ? MQTTSuccess : status;
+        }
+    }
+
+    if( status == MQTTSuccess )
+    {
+        status = MQTT_Disconnect( &context );
+    }
+
+    /* The broker returns once it has handled everything before the
+     * DISCONNECT, or when the client end is closed after a failure. */
+    if( status != MQTTSuccess )
+    {
+        disconnect( &connection );
+    }
+
+    if( threadStarted )
+    {
+        ( void ) pthread_join( thread, NULL );
+    }
+
+    if( ( status == MQTTSuccess ) && ( broker.publishCount == publishCount ) )
+    {
+        elapsedNs = getTimeNs() - startNs;
+    }
+    else
+    {
+        ( void ) fprintf( stderr, "Run over %s failed with status %s.\n",
+                          connection.pName,
+                          MQTT_Status_strerror( status ) );
+    }
+
+    disconnect( &connection );
+
+    return elapsedNs;
+}
+
+int main( void )
+{
+    bool ( * const connectTransports[ 2 ] )( BenchmarkConnection_t * pConnection ) = { connectShm, connectTcp };
+    static const char * const names[ 2 ] = { "shm", "tcp" };
+    uint64_t roundTripNs, throughputNs;
+    size_t i;
+    int result = EXIT_SUCCESS;
+
+    for( i = 0U; ( i < 2U ) && ( result == EXIT_SUCCESS ); i++ )
+    {
+        roundTripNs = run( connectTransports[ i ], true, BENCHMARK_ROUND_TRIP_COUNT );
+        throughputNs = run( connectTransports[ i ], false, BENCHMARK_PUBLISH_COUNT );
+
+        if( ( roundTripNs == 0U ) || ( throughputNs == 0U ) )
+        {
+            result = EXIT_FAILURE;
+        }
+        else
+        {
+            ( void ) printf( "transport=%s round_trip_ns=%.0f publishes/s=%.0f\n",
+                             names[ i ],
+                             ( double ) roundTripNs / ( double ) BENCHMARK_ROUND_TRIP_COUNT,
+                             ( double ) BENCHMARK_PUBLISH_COUNT * 1e9 / ( double ) throughputNs );
+        }
+    }
+
+    return result;
+}
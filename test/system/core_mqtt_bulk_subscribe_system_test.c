@@ -0,0 +1,349 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file core_mqtt_bulk_subscribe_system_test.c
+ * @brief System tests of bulk SUBSCRIBE and UNSUBSCRIBE over the replay
+ * transport, which records the packets sent and counts the transport writes.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "unity.h"
+
+#include "core_mqtt.h"
+
+#include "replay_transport.h"
+
+/**
+ * @brief The number of topic filters of the large subscription list.
+ */
+#define FILTER_COUNT         ( 5000U )
+
+/**
+ * @brief Length of each topic filter of the large subscription list,
+ * "dev/NNNN/cmd".
+ */
+#define FILTER_LENGTH        ( 12U )
+
+/**
+ * @brief Size of the staging buffer.
+ */
+#define STAGING_SIZE         ( 1024U )
+
+/**
+ * @brief Capacity of the packet ID array.
+ */
+#define PACKET_ID_COUNT      ( 128U )
+
+/**
+ * @brief The context and its transport.
+ */
+static MQTTContext_t context;
+static NetworkContext_t networkContext;
+static uint8_t buffer[ 128 ];
+static uint8_t staging[ STAGING_SIZE ];
+static MQTTFixedBuffer_t stagingBuffer = { staging, sizeof( staging ) };
+
+/**
+ * @brief The topic filters of the large subscription list.
+ */
+static char filters[ FILTER_COUNT ][ FILTER_LENGTH + 1U ];
+static MQTTSubscribeInfo_t subscriptionList[ FILTER_COUNT ];
+
+/**
+ * @brief Packet IDs returned by the bulk functions.
+ */
+static uint16_t packetIds[ PACKET_ID_COUNT ];
+
+/**
+ * @brief The number of SUBACKs given to the event callback.
+ */
+static uint32_t subackCount;
+
+/* ============================   UNITY FIXTURES ============================ */
+
+/* Called before each test method. */
+void setUp( void )
+{
+    size_t i;
+
+    ( void ) memset( &context, 0x00, sizeof( context ) );
+    ( void ) memset( &networkContext, 0x00, sizeof( networkContext ) );
+    ( void ) memset( packetIds, 0x00, sizeof( packetIds ) );
+    subackCount = 0U;
+
+    for( i = 0U; i < FILTER_COUNT; i++ )
+    {
+        ( void ) snprintf( filters[ i ], sizeof( filters[ i ] ), "dev/%04u/cmd", ( unsigned int ) i );
+        subscriptionList[ i ].qos = MQTTQoS0;
+        subscriptionList[ i ].pTopicFilter = filters[ i ];
+        subscriptionList[ i ].topicFilterLength = FILTER_LENGTH;
+    }
+}
+
+/* Called after each test method. */
+void tearDown( void )
+{
+}
+
+/* Called at the beginning of the whole suite. */
+void suiteSetUp()
+{
+}
+
+/* Called at the end of the whole suite. */
+int suiteTearDown( int numFailures )
+{
+    return numFailures;
+}
+
+/* ========================================================================== */
+
+static void eventCallback( MQTTContext_t * pContext,
+                           MQTTPacketInfo_t * pPacketInfo,
+                           MQTTDeserializedInfo_t * pDeserializedInfo )
+{
+    ( void ) pContext;
+
+    if( pPacketInfo->type == MQTT_PACKET_TYPE_SUBACK )
+    {
+        TEST_ASSERT_EQUAL_UINT16( packetIds[ subackCount ], pDeserializedInfo->packetIdentifier );
+        subackCount++;
+    }
+}
+
+/**
+ * @brief Initialize the context for the given protocol version and connect.
+ */
+static void connect( uint8_t protocolVersion )
+{
+    MQTTFixedBuffer_t networkBuffer = { buffer, sizeof( buffer ) };
+
+    ReplayTransport_InitContext( &context, &networkContext, eventCallback, &networkBuffer, protocolVersion );
+    ReplayTransport_Connect( &context, "bulk", false );
+    networkContext.txLength = 0U;
+    networkContext.writeCount = 0U;
+}
+
+/**
+ * @brief Check that the packets sent carry the filters of the large
+ * subscription list in order, with the packet IDs returned.
+ */
+static void checkPacketsSent( uint8_t packetType,
+                              size_t packetCount,
+                              bool hasProperties )
+{
+    size_t offset = 0U, packet, filter = 0U, remainingLength, shift, start, end;
+    uint16_t length;
+
+    for( packet = 0U; packet < packetCount; packet++ )
+    {
+        start = offset;
+        TEST_ASSERT_EQUAL_HEX8( packetType, networkContext.tx[ offset ] );
+        offset++;
+
+        remainingLength = 0U;
+        shift = 0U;
+
+        do
+        {
+            remainingLength |= ( size_t ) ( networkContext.tx[ offset ] & 0x7FU ) << shift;
+            shift += 7U;
+            offset++;
+        } while( ( networkContext.tx[ offset - 1U ] & 0x80U ) != 0U );
+
+        /* Each packet fits in the staging buffer. */
+        TEST_ASSERT_LESS_OR_EQUAL( STAGING_SIZE, offset + remainingLength - start );
+        end = offset + remainingLength;
+
+        TEST_ASSERT_EQUAL_UINT16( packetIds[ packet ],
+                                  ( uint16_t ) ( ( networkContext.tx[ offset ] << 8 ) | networkContext.tx[ offset + 1U ] ) );
+        offset += 2U;
+
+        if( hasProperties == true )
+        {
+            TEST_ASSERT_EQUAL_HEX8( 0U, networkContext.tx[ offset ] );
+            offset++;
+        }
+
+        while( offset < end )
+        {
+            length = ( uint16_t ) ( ( networkContext.tx[ offset ] << 8 ) | networkContext.tx[ offset + 1U ] );
+            TEST_ASSERT_EQUAL_UINT16( FILTER_LENGTH, length );
+            TEST_ASSERT_EQUAL_MEMORY( filters[ filter ], &networkContext.tx[ offset + 2U ], FILTER_LENGTH );
+            offset += 2U + FILTER_LENGTH;
+
+            if( packetType == MQTT_PACKET_TYPE_SUBSCRIBE )
+            {
+                TEST_ASSERT_EQUAL_HEX8( MQTTQoS0, networkContext.tx[ offset ] );
+                offset++;
+            }
+
+            filter++;
+        }
+
+        TEST_ASSERT_EQUAL( end, offset );
+    }
+
+    TEST_ASSERT_EQUAL( FILTER_COUNT, filter );
+    TEST_ASSERT_EQUAL( networkContext.txLength, offset );
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Thousands of topic filters are subscribed to with one transport
+ * write per packet, each packet filling the staging buffer.
+ */
+void test_BulkSubscribe_ManyFilters( void )
+{
+    size_t packetCount = PACKET_ID_COUNT;
+    size_t i;
+
+    connect( MQTT_VERSION_3_1_1 );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_SubscribeBulk( &context, subscriptionList, FILTER_COUNT,
+                                                        &stagingBuffer, packetIds, &packetCount ) );
+
+    /* 15 bytes for each filter leave room for 67 filters in each packet. */
+    TEST_ASSERT_EQUAL( ( FILTER_COUNT + 66U ) / 67U, packetCount );
+    TEST_ASSERT_EQUAL( packetCount, networkContext.writeCount );
+    checkPacketsSent( MQTT_PACKET_TYPE_SUBSCRIBE, packetCount, false );
+
+    for( i = 1U; i < packetCount; i++ )
+    {
+        TEST_ASSERT_EQUAL_UINT16( packetIds[ i - 1U ] + 1U, packetIds[ i ] );
+    }
+}
+
+/**
+ * @brief Unsubscribing packs the filters the same way, and MQTT 5 packets have
+ * an empty property length.
+ */
+void test_BulkSubscribe_UnsubscribeV5( void )
+{
+    size_t packetCount = PACKET_ID_COUNT;
+
+    connect( MQTT_VERSION_5 );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_UnsubscribeBulk( &context, subscriptionList, FILTER_COUNT,
+                                                          &stagingBuffer, packetIds, &packetCount ) );
+
+    /* 14 bytes for each filter leave room for 72 filters in each packet. */
+    TEST_ASSERT_EQUAL( ( FILTER_COUNT + 71U ) / 72U, packetCount );
+    TEST_ASSERT_EQUAL( packetCount, networkContext.writeCount );
+    checkPacketsSent( MQTT_PACKET_TYPE_UNSUBSCRIBE, packetCount, true );
+}
+
+/**
+ * @brief The SUBACKs of the pipelined packets are received afterwards.
+ */
+void test_BulkSubscribe_Subacks( void )
+{
+    size_t packetCount = PACKET_ID_COUNT;
+    size_t i;
+
+    connect( MQTT_VERSION_3_1_1 );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_SubscribeBulk( &context, subscriptionList, 100U,
+                                                        &stagingBuffer, packetIds, &packetCount ) );
+    TEST_ASSERT_EQUAL( 2U, packetCount );
+
+    networkContext.rxLength = 0U;
+    networkContext.rxIndex = 0U;
+
+    for( i = 0U; i < packetCount; i++ )
+    {
+        networkContext.rx[ networkContext.rxLength++ ] = MQTT_PACKET_TYPE_SUBACK;
+        networkContext.rx[ networkContext.rxLength++ ] = 3U;
+        networkContext.rx[ networkContext.rxLength++ ] = ( uint8_t ) ( packetIds[ i ] >> 8 );
+        networkContext.rx[ networkContext.rxLength++ ] = ( uint8_t ) packetIds[ i ];
+        networkContext.rx[ networkContext.rxLength++ ] = 0x00U;
+    }
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_ProcessLoop( &context ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_ProcessLoop( &context ) );
+    TEST_ASSERT_EQUAL( packetCount, subackCount );
+}
+
+/**
+ * @brief Nothing is sent when the arguments are invalid or the packets would
+ * not fit.
+ */
+void test_BulkSubscribe_Errors( void )
+{
+    size_t packetCount = PACKET_ID_COUNT;
+    MQTTFixedBuffer_t smallBuffer = { staging, 8U };
+    MQTTFixedBuffer_t tinyBuffer = { staging, 20U };
+
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_SubscribeBulk( NULL, subscriptionList, FILTER_COUNT,
+                                                             &stagingBuffer, packetIds, &packetCount ) );
+
+    connect( MQTT_VERSION_3_1_1 );
+
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_SubscribeBulk( &context, subscriptionList, 0U,
+                                                             &stagingBuffer, packetIds, &packetCount ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_SubscribeBulk( &context, subscriptionList, FILTER_COUNT,
+                                                             NULL, packetIds, &packetCount ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_SubscribeBulk( &context, subscriptionList, FILTER_COUNT,
+                                                             &stagingBuffer, NULL, &packetCount ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_SubscribeBulk( &context, subscriptionList, FILTER_COUNT,
+                                                             &smallBuffer, packetIds, &packetCount ) );
+
+    /* A filter of 15 bytes does not fit in 12 bytes of payload. */
+    TEST_ASSERT_EQUAL( MQTTNoMemory, MQTT_SubscribeBulk( &context, subscriptionList, FILTER_COUNT,
+                                                         &tinyBuffer, packetIds, &packetCount ) );
+    TEST_ASSERT_EQUAL( 0U, packetCount );
+
+    /* 75 packets are needed. */
+    packetCount = 74U;
+    TEST_ASSERT_EQUAL( MQTTNoMemory, MQTT_SubscribeBulk( &context, subscriptionList, FILTER_COUNT,
+                                                         &stagingBuffer, packetIds, &packetCount ) );
+    TEST_ASSERT_EQUAL( 0U, packetCount );
+
+    /* An empty filter at the end is found before anything is sent. */
+    packetCount = PACKET_ID_COUNT;
+    subscriptionList[ FILTER_COUNT - 1U ].topicFilterLength = 0U;
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_SubscribeBulk( &context, subscriptionList, FILTER_COUNT,
+                                                             &stagingBuffer, packetIds, &packetCount ) );
+    subscriptionList[ FILTER_COUNT - 1U ].topicFilterLength = FILTER_LENGTH;
+
+    /* QoS 1 needs the state records. */
+    subscriptionList[ FILTER_COUNT - 1U ].qos = MQTTQoS1;
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_SubscribeBulk( &context, subscriptionList, FILTER_COUNT,
+                                                             &stagingBuffer, packetIds, &packetCount ) );
+    subscriptionList[ FILTER_COUNT - 1U ].qos = MQTTQoS0;
+
+    TEST_ASSERT_EQUAL( 0U, networkContext.writeCount );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Disconnect( &context ) );
+    networkContext.writeCount = 0U;
+    packetCount = PACKET_ID_COUNT;
+    TEST_ASSERT_EQUAL( MQTTStatusNotConnected, MQTT_UnsubscribeBulk( &context, subscriptionList, FILTER_COUNT,
+                                                                     &stagingBuffer, packetIds, &packetCount ) );
+    TEST_ASSERT_EQUAL( 0U, packetCount );
+    TEST_ASSERT_EQUAL( 0U, networkContext.writeCount );
+}
@@ -0,0 +1,519 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file core_mqtt_completion_system_test.c
+ * @brief System tests of completion tokens and of the acknowledgements given
+ * to the event callback, over the replay transport.
+ */
+
+#include <string.h>
+
+#include "unity.h"
+
+#include "core_mqtt.h"
+
+#include "replay_transport.h"
+
+/**
+ * @brief The number of completion tokens of the context.
+ */
+#define TOKEN_COUNT    ( 2U )
+
+/**
+ * @brief A completion received by the test callback.
+ */
+typedef struct Completion
+{
+    uint32_t count;
+    uint16_t packetId;
+    MQTTStatus_t status;
+    uint8_t ackType;
+    void * pUserData;
+} Completion_t;
+
+/**
+ * @brief The context and its transport.
+ */
+static MQTTContext_t context;
+static NetworkContext_t networkContext;
+static uint8_t buffer[ 128 ];
+static MQTTPubAckInfo_t outgoingRecords[ 4 ];
+static MQTTPubAckInfo_t incomingRecords[ 4 ];
+static MQTTCompletionToken_t tokens[ TOKEN_COUNT ];
+
+/**
+ * @brief The last completion, and the number of acknowledgements given to the
+ * event callback before it.
+ */
+static Completion_t completion;
+static uint32_t eventCount;
+static uint32_t eventCountAtCompletion;
+
+/**
+ * @brief The result and reason code of the last acknowledgement given to the
+ * event callback.
+ */
+static MQTTStatus_t eventResult;
+static uint8_t eventReasonCode;
+
+/**
+ * @brief User data of the operations.
+ */
+static int userData[ 2 ];
+
+/* ============================   UNITY FIXTURES ============================ */
+
+/* Called before each test method. */
+void setUp( void )
+{
+    ( void ) memset( &context, 0x00, sizeof( context ) );
+    ( void ) memset( &networkContext, 0x00, sizeof( networkContext ) );
+    ( void ) memset( &completion, 0x00, sizeof( completion ) );
+    eventCount = 0U;
+    eventCountAtCompletion = 0U;
+    eventResult = MQTTIllegalState;
+    eventReasonCode = 0xFFU;
+}
+
+/* Called after each test method. */
+void tearDown( void )
+{
+}
+
+/* Called at the beginning of the whole suite. */
+void suiteSetUp()
+{
+}
+
+/* Called at the end of the whole suite. */
+int suiteTearDown( int numFailures )
+{
+    return numFailures;
+}
+
+/* ========================================================================== */
+
+static void eventCallback( MQTTContext_t * pContext,
+                           MQTTPacketInfo_t * pPacketInfo,
+                           MQTTDeserializedInfo_t * pDeserializedInfo )
+{
+    ( void ) pContext;
+    ( void ) pPacketInfo;
+
+    eventCount++;
+    eventResult = pDeserializedInfo->deserializationResult;
+    eventReasonCode = pDeserializedInfo->reasonCode;
+}
+
+static void completionCallback( MQTTContext_t * pContext,
+                                uint16_t packetId,
+                                MQTTStatus_t status,
+                                MQTTPacketInfo_t * pAckPacket,
+                                void * pUserData )
+{
+    TEST_ASSERT_EQUAL_PTR( &context, pContext );
+
+    completion.count++;
+    completion.packetId = packetId;
+    completion.status = status;
+    completion.ackType = ( pAckPacket != NULL ) ? pAckPacket->type : 0U;
+    completion.pUserData = pUserData;
+    eventCountAtCompletion = eventCount;
+}
+
+/**
+ * @brief Initialize the context with state records and completion tokens, and
+ * connect with the given protocol version.
+ */
+static void initContext( uint8_t protocolVersion )
+{
+    MQTTFixedBuffer_t networkBuffer = { buffer, sizeof( buffer ) };
+
+    ReplayTransport_InitContext( &context, &networkContext, eventCallback, &networkBuffer, protocolVersion );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_InitStatefulQoS( &context, outgoingRecords, 4U, incomingRecords, 4U ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_InitCompletionTokens( &context, tokens, TOKEN_COUNT ) );
+
+    ReplayTransport_Connect( &context, "completion", false );
+}
+
+/**
+ * @brief Publish with the given QoS and a completion callback.
+ */
+static MQTTStatus_t publish( MQTTQoS_t qos,
+                             uint16_t packetId,
+                             void * pUserData )
+{
+    MQTTPublishInfo_t publishInfo = { 0 };
+
+    publishInfo.qos = qos;
+    publishInfo.pTopicName = "sensor/temperature";
+    publishInfo.topicNameLength = 18U;
+    publishInfo.pPayload = "21.5";
+    publishInfo.payloadLength = 4U;
+
+    return MQTT_PublishWithCompletion( &context, &publishInfo, packetId, completionCallback, pUserData );
+}
+
+/**
+ * @brief Subscribe to two topic filters with a completion callback.
+ */
+static MQTTStatus_t subscribe( uint16_t packetId,
+                               void * pUserData )
+{
+    MQTTSubscribeInfo_t subscriptions[ 2 ];
+
+    subscriptions[ 0 ].qos = MQTTQoS0;
+    subscriptions[ 0 ].pTopicFilter = "sensor/+";
+    subscriptions[ 0 ].topicFilterLength = 8U;
+    subscriptions[ 1 ].qos = MQTTQoS0;
+    subscriptions[ 1 ].pTopicFilter = "actuator/#";
+    subscriptions[ 1 ].topicFilterLength = 10U;
+
+    return MQTT_SubscribeWithCompletion( &context, subscriptions, 2U, packetId, completionCallback, pUserData );
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Invalid arguments.
+ */
+void test_Completion_InvalidParams( void )
+{
+    MQTTPublishInfo_t publishInfo = { 0 };
+
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_InitCompletionTokens( NULL, tokens, TOKEN_COUNT ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_InitCompletionTokens( &context, NULL, TOKEN_COUNT ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_InitCompletionTokens( &context, tokens, 0U ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_PublishWithCompletion( NULL, &publishInfo, 1U, completionCallback, NULL ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_PublishWithCompletion( &context, NULL, 1U, completionCallback, NULL ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_PublishWithCompletion( &context, &publishInfo, 1U, NULL, NULL ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_SubscribeWithCompletion( NULL, NULL, 1U, 1U, completionCallback, NULL ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_SubscribeWithCompletion( &context, NULL, 1U, 1U, NULL, NULL ) );
+
+    /* QoS1 needs a completion token table. */
+    publishInfo.qos = MQTTQoS1;
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_PublishWithCompletion( &context, &publishInfo, 1U, completionCallback, NULL ) );
+
+    initContext( MQTT_VERSION_3_1_1 );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_InitCompletionTokens( &context, tokens, TOKEN_COUNT ) );
+}
+
+/**
+ * @brief A QoS0 publish completes once sent, and a failed one does not
+ * complete.
+ */
+void test_Completion_PublishQoS0( void )
+{
+    initContext( MQTT_VERSION_3_1_1 );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, publish( MQTTQoS0, 0U, &userData[ 0 ] ) );
+    TEST_ASSERT_EQUAL( 1U, completion.count );
+    TEST_ASSERT_EQUAL( MQTTSuccess, completion.status );
+    TEST_ASSERT_EQUAL_PTR( &userData[ 0 ], completion.pUserData );
+    TEST_ASSERT_EQUAL( 0U, completion.ackType );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Disconnect( &context ) );
+    TEST_ASSERT_EQUAL( MQTTStatusNotConnected, publish( MQTTQoS0, 0U, &userData[ 0 ] ) );
+    TEST_ASSERT_EQUAL( 1U, completion.count );
+}
+
+/**
+ * @brief A QoS1 publish completes with its PUBACK, after the event callback.
+ */
+void test_Completion_PublishQoS1( void )
+{
+    const uint8_t puback[] = { MQTT_PACKET_TYPE_PUBACK, 0x02, 0x00, 0x07 };
+
+    initContext( MQTT_VERSION_3_1_1 );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, publish( MQTTQoS1, 7U, &userData[ 1 ] ) );
+    TEST_ASSERT_EQUAL( 0U, completion.count );
+
+    ReplayTransport_SetRx( &networkContext, puback, sizeof( puback ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_ReceiveLoop( &context ) );
+
+    TEST_ASSERT_EQUAL( 1U, completion.count );
+    TEST_ASSERT_EQUAL_UINT16( 7U, completion.packetId );
+    TEST_ASSERT_EQUAL( MQTTSuccess, completion.status );
+    TEST_ASSERT_EQUAL_HEX8( MQTT_PACKET_TYPE_PUBACK, completion.ackType );
+    TEST_ASSERT_EQUAL_PTR( &userData[ 1 ], completion.pUserData );
+    TEST_ASSERT_EQUAL( 1U, eventCountAtCompletion );
+
+    /* The token is free again. */
+    TEST_ASSERT_NULL( tokens[ 0 ].callback );
+}
+
+/**
+ * @brief A QoS2 publish completes with its PUBCOMP, not its PUBREC.
+ */
+void test_Completion_PublishQoS2( void )
+{
+    const uint8_t pubrec[] = { MQTT_PACKET_TYPE_PUBREC, 0x02, 0x00, 0x09 };
+    const uint8_t pubcomp[] = { MQTT_PACKET_TYPE_PUBCOMP, 0x02, 0x00, 0x09 };
+
+    initContext( MQTT_VERSION_3_1_1 );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, publish( MQTTQoS2, 9U, &userData[ 0 ] ) );
+
+    ReplayTransport_SetRx( &networkContext, pubrec, sizeof( pubrec ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_ReceiveLoop( &context ) );
+    TEST_ASSERT_EQUAL( 0U, completion.count );
+
+    ReplayTransport_SetRx( &networkContext, pubcomp, sizeof( pubcomp ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_ReceiveLoop( &context ) );
+    TEST_ASSERT_EQUAL( 1U, completion.count );
+    TEST_ASSERT_EQUAL_UINT16( 9U, completion.packetId );
+    TEST_ASSERT_EQUAL_HEX8( MQTT_PACKET_TYPE_PUBCOMP, completion.ackType );
+    TEST_ASSERT_EQUAL( 2U, eventCountAtCompletion );
+}
+
+/**
+ * @brief A subscribe completes with its SUBACK, whose return codes give the
+ * result of each topic filter.
+ */
+void test_Completion_Subscribe( void )
+{
+    const uint8_t suback[] = { MQTT_PACKET_TYPE_SUBACK, 0x04, 0x00, 0x03, 0x00, 0x80 };
+
+    initContext( MQTT_VERSION_3_1_1 );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, subscribe( 3U, &userData[ 0 ] ) );
+
+    ReplayTransport_SetRx( &networkContext, suback, sizeof( suback ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_ReceiveLoop( &context ) );
+
+    TEST_ASSERT_EQUAL( 1U, completion.count );
+    TEST_ASSERT_EQUAL_UINT16( 3U, completion.packetId );
+    TEST_ASSERT_EQUAL( MQTTServerRefused, completion.status );
+    TEST_ASSERT_EQUAL_HEX8( MQTT_PACKET_TYPE_SUBACK, completion.ackType );
+    TEST_ASSERT_EQUAL_PTR( &userData[ 0 ], completion.pUserData );
+}
+
+/**
+ * @brief Operations fail without sending when no token is free or the packet
+ * ID is already awaiting the same acknowledgement, and a failed operation
+ * frees its token.
+ */
+void test_Completion_NoToken( void )
+{
+    const uint8_t acks[] = { MQTT_PACKET_TYPE_PUBACK, 0x02, 0x00, 0x01,
+                             MQTT_PACKET_TYPE_SUBACK, 0x04, 0x00, 0x01, 0x00, 0x00 };
+    size_t writeCount;
+
+    initContext( MQTT_VERSION_3_1_1 );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, publish( MQTTQoS1, 1U, NULL ) );
+    writeCount = networkContext.writeCount;
+
+    TEST_ASSERT_EQUAL( MQTTStateCollision, publish( MQTTQoS1, 1U, NULL ) );
+
+    /* A SUBACK with the same packet ID is another acknowledgement. */
+    TEST_ASSERT_EQUAL( MQTTSuccess, subscribe( 1U, NULL ) );
+    writeCount = networkContext.writeCount;
+
+    TEST_ASSERT_EQUAL( MQTTNoMemory, subscribe( 2U, NULL ) );
+    TEST_ASSERT_EQUAL( MQTTNoMemory, publish( MQTTQoS2, 3U, NULL ) );
+    TEST_ASSERT_EQUAL( writeCount, networkContext.writeCount );
+    TEST_ASSERT_EQUAL( 0U, completion.count );
+
+    ReplayTransport_SetRx( &networkContext, acks, sizeof( acks ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_ReceiveLoop( &context ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_ReceiveLoop( &context ) );
+    TEST_ASSERT_EQUAL( 2U, completion.count );
+
+    /* The tokens of failed operations are freed. */
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Disconnect( &context ) );
+    TEST_ASSERT_EQUAL( MQTTStatusNotConnected, publish( MQTTQoS1, 4U, NULL ) );
+    TEST_ASSERT_EQUAL( MQTTStatusNotConnected, subscribe( 5U, NULL ) );
+    TEST_ASSERT_NULL( tokens[ 0 ].callback );
+    TEST_ASSERT_NULL( tokens[ 1 ].callback );
+    TEST_ASSERT_EQUAL( 2U, completion.count );
+}
+
+/**
+ * @brief A new connection abandons subscribes, and publishes too when the
+ * broker has no session.
+ */
+void test_Completion_Abandon( void )
+{
+    const uint8_t puback[] = { MQTT_PACKET_TYPE_PUBACK, 0x02, 0x00, 0x01 };
+
+    initContext( MQTT_VERSION_3_1_1 );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, publish( MQTTQoS1, 1U, &userData[ 0 ] ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, subscribe( 2U, &userData[ 1 ] ) );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Disconnect( &context ) );
+    ReplayTransport_Connect( &context, "completion", true );
+
+    TEST_ASSERT_EQUAL( 1U, completion.count );
+    TEST_ASSERT_EQUAL_UINT16( 2U, completion.packetId );
+    TEST_ASSERT_EQUAL( MQTTStatusNotConnected, completion.status );
+    TEST_ASSERT_EQUAL( 0U, completion.ackType );
+    TEST_ASSERT_EQUAL_PTR( &userData[ 1 ], completion.pUserData );
+
+    /* The publish of the kept session is still completed. */
+    ReplayTransport_SetRx( &networkContext, puback, sizeof( puback ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_ReceiveLoop( &context ) );
+    TEST_ASSERT_EQUAL( 2U, completion.count );
+    TEST_ASSERT_EQUAL( MQTTSuccess, completion.status );
+    TEST_ASSERT_EQUAL_PTR( &userData[ 0 ], completion.pUserData );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, publish( MQTTQoS1, 3U, &userData[ 1 ] ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Disconnect( &context ) );
+    ReplayTransport_Connect( &context, "completion", false );
+
+    TEST_ASSERT_EQUAL( 3U, completion.count );
+    TEST_ASSERT_EQUAL_UINT16( 3U, completion.packetId );
+    TEST_ASSERT_EQUAL( MQTTStatusNotConnected, completion.status );
+}
+
+/**
+ * @brief An MQTT 5 PUBREC refusing a QoS2 publish releases it without a
+ * PUBREL, and a refusing PUBACK is not reported as a success.
+ */
+void test_Completion_PublishAckRefusedV5( void )
+{
+    const uint8_t pubrec[] = { MQTT_PACKET_TYPE_PUBREC, 0x03, 0x00, 0x09, 0x80 };
+    const uint8_t puback[] = { MQTT_PACKET_TYPE_PUBACK, 0x03, 0x00, 0x0A, 0x87 };
+    MQTTPublishInfo_t publishInfo = { 0 };
+    size_t writeCount;
+
+    initContext( MQTT_VERSION_5 );
+
+    publishInfo.qos = MQTTQoS2;
+    publishInfo.pTopicName = "sensor/temperature";
+    publishInfo.topicNameLength = 18U;
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Publish( &context, &publishInfo, 9U ) );
+    writeCount = networkContext.writeCount;
+
+    ReplayTransport_SetRx( &networkContext, pubrec, sizeof( pubrec ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_ReceiveLoop( &context ) );
+    TEST_ASSERT_EQUAL( 1U, eventCount );
+    TEST_ASSERT_EQUAL( MQTTServerRefused, eventResult );
+    TEST_ASSERT_EQUAL_HEX8( 0x80U, eventReasonCode );
+    TEST_ASSERT_EQUAL( writeCount, networkContext.writeCount );
+
+    /* The state record is free, so the packet ID can be used again. */
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Publish( &context, &publishInfo, 9U ) );
+
+    publishInfo.qos = MQTTQoS1;
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Publish( &context, &publishInfo, 10U ) );
+
+    ReplayTransport_SetRx( &networkContext, puback, sizeof( puback ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_ReceiveLoop( &context ) );
+    TEST_ASSERT_EQUAL( 2U, eventCount );
+    TEST_ASSERT_EQUAL( MQTTServerRefused, eventResult );
+    TEST_ASSERT_EQUAL_HEX8( 0x87U, eventReasonCode );
+}
+
+/**
+ * @brief MQTT 5 publishes complete with #MQTTServerRefused when their PUBACK,
+ * PUBREC or PUBCOMP has a failure reason code, and with #MQTTSuccess otherwise.
+ */
+void test_Completion_PublishRefusedV5( void )
+{
+    const uint8_t puback[] = { MQTT_PACKET_TYPE_PUBACK, 0x03, 0x00, 0x01, 0x87 };
+    const uint8_t pubackNoSubscribers[] = { MQTT_PACKET_TYPE_PUBACK, 0x03, 0x00, 0x02, 0x10 };
+    const uint8_t pubrec[] = { MQTT_PACKET_TYPE_PUBREC, 0x03, 0x00, 0x03, 0x80 };
+    const uint8_t pubrecPubcomp[] = { MQTT_PACKET_TYPE_PUBREC, 0x02, 0x00, 0x04,
+                                      MQTT_PACKET_TYPE_PUBCOMP, 0x03, 0x00, 0x04, 0x92 };
+
+    initContext( MQTT_VERSION_5 );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, publish( MQTTQoS1, 1U, &userData[ 0 ] ) );
+    ReplayTransport_SetRx( &networkContext, puback, sizeof( puback ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_ReceiveLoop( &context ) );
+    TEST_ASSERT_EQUAL( 1U, completion.count );
+    TEST_ASSERT_EQUAL_UINT16( 1U, completion.packetId );
+    TEST_ASSERT_EQUAL( MQTTServerRefused, completion.status );
+    TEST_ASSERT_EQUAL_HEX8( MQTT_PACKET_TYPE_PUBACK, completion.ackType );
+
+    /* No matching subscribers is not a failure. */
+    TEST_ASSERT_EQUAL( MQTTSuccess, publish( MQTTQoS1, 2U, &userData[ 0 ] ) );
+    ReplayTransport_SetRx( &networkContext, pubackNoSubscribers, sizeof( pubackNoSubscribers ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_ReceiveLoop( &context ) );
+    TEST_ASSERT_EQUAL( 2U, completion.count );
+    TEST_ASSERT_EQUAL( MQTTSuccess, completion.status );
+
+    /* A refusing PUBREC completes a QoS2 publish, as no PUBCOMP follows. */
+    TEST_ASSERT_EQUAL( MQTTSuccess, publish( MQTTQoS2, 3U, &userData[ 1 ] ) );
+    ReplayTransport_SetRx( &networkContext, pubrec, sizeof( pubrec ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_ReceiveLoop( &context ) );
+    TEST_ASSERT_EQUAL( 3U, completion.count );
+    TEST_ASSERT_EQUAL_UINT16( 3U, completion.packetId );
+    TEST_ASSERT_EQUAL( MQTTServerRefused, completion.status );
+    TEST_ASSERT_EQUAL_HEX8( MQTT_PACKET_TYPE_PUBREC, completion.ackType );
+    TEST_ASSERT_EQUAL_PTR( &userData[ 1 ], completion.pUserData );
+    TEST_ASSERT_NULL( tokens[ 0 ].callback );
+
+    /* Packet identifier not found. */
+    TEST_ASSERT_EQUAL( MQTTSuccess, publish( MQTTQoS2, 4U, &userData[ 1 ] ) );
+    ReplayTransport_SetRx( &networkContext, pubrecPubcomp, sizeof( pubrecPubcomp ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_ReceiveLoop( &context ) );
+    TEST_ASSERT_EQUAL( 3U, completion.count );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_ReceiveLoop( &context ) );
+    TEST_ASSERT_EQUAL( 4U, completion.count );
+    TEST_ASSERT_EQUAL( MQTTServerRefused, completion.status );
+    TEST_ASSERT_EQUAL_HEX8( MQTT_PACKET_TYPE_PUBCOMP, completion.ackType );
+}
+
+/**
+ * @brief A DISCONNECT of an MQTT 5 server is given to the event callback and
+ * ends the connection, while one of an MQTT 3.1.1 server is invalid.
+ */
+void test_Completion_ServerDisconnect( void )
+{
+    /* Server shutting down, with a Reason String property. */
+    const uint8_t disconnect[] = { MQTT_PACKET_TYPE_DISCONNECT, 0x07, 0x8B, 0x05, 0x1F, 0x00, 0x02, 'b', 'y' };
+    const uint8_t auth[] = { MQTT_PACKET_TYPE_AUTH, 0x00 };
+    size_t writeCount;
+
+    initContext( MQTT_VERSION_5 );
+    writeCount = networkContext.writeCount;
+
+    ReplayTransport_SetRx( &networkContext, disconnect, sizeof( disconnect ) );
+    TEST_ASSERT_EQUAL( MQTTStatusNotConnected, MQTT_ReceiveLoop( &context ) );
+    TEST_ASSERT_EQUAL( 1U, eventCount );
+    TEST_ASSERT_EQUAL( MQTTSuccess, eventResult );
+    TEST_ASSERT_EQUAL_HEX8( 0x8BU, eventReasonCode );
+    TEST_ASSERT_EQUAL( MQTTStatusNotConnected, MQTT_CheckConnectStatus( &context ) );
+    TEST_ASSERT_EQUAL( writeCount, networkContext.writeCount );
+
+    /* The CONNECT has no Authentication Method. */
+    ReplayTransport_Connect( &context, "completion", false );
+    ReplayTransport_SetRx( &networkContext, auth, sizeof( auth ) );
+    TEST_ASSERT_EQUAL( MQTTBadResponse, MQTT_ReceiveLoop( &context ) );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Disconnect( &context ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_SetProtocolVersion( &context, MQTT_VERSION_3_1_1 ) );
+    ReplayTransport_Connect( &context, "completion", false );
+    eventCount = 0U;
+
+    ReplayTransport_SetRx( &networkContext, disconnect, sizeof( disconnect ) );
+    TEST_ASSERT_EQUAL( MQTTBadResponse, MQTT_ReceiveLoop( &context ) );
+    TEST_ASSERT_EQUAL( 0U, eventCount );
+}
@@ -0,0 +1,423 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file core_mqtt_coroutine_system_test.cpp
+ * @brief System tests of the C++20 coroutine layer, with a transport replaying
+ * the packets of the broker.
+ */
+
+#include <cstring>
+#include <optional>
+
+/* A small pool, so that the tests exhaust it. */
+#define MQTT_COROUTINE_FRAME_COUNT    ( 4U )
+
+#include "core_mqtt_coroutine.hpp"
+
+extern "C" {
+#include "unity.h"
+}
+
+/**
+ * @brief The number of completion tokens of the client.
+ */
+#define TOKEN_COUNT    ( 4U )
+
+/**
+ * @brief Each compilation unit that uses the transport must define the
+ * NetworkContext struct. The transport of this test replays the packets in
+ * rx.
+ */
+struct NetworkContext
+{
+    uint8_t rx[ 64 ];
+    size_t rxLength;
+    size_t rxIndex;
+};
+
+/**
+ * @brief The client and its transport.
+ */
+static std::optional< coremqtt::Client > client;
+static NetworkContext_t networkContext;
+static uint8_t buffer[ 128 ];
+static MQTTPubAckInfo_t outgoingRecords[ 4 ];
+static MQTTPubAckInfo_t incomingRecords[ 4 ];
+static MQTTCompletionToken_t tokens[ TOKEN_COUNT ];
+
+/**
+ * @brief The publish sent by the coroutines.
+ */
+static MQTTPublishInfo_t publishInfo;
+
+/**
+ * @brief Progress of the coroutines: the number of coroutines resumed, the
+ * status of the last one, and the topic of the last received publish.
+ */
+static uint32_t resumeCount;
+static MQTTStatus_t lastStatus;
+static char lastTopic[ 32 ];
+
+/* ============================   UNITY FIXTURES ============================ */
+
+extern "C" {
+
+/* Called before each test method. */
+void setUp( void )
+{
+    ( void ) std::memset( &networkContext, 0x00, sizeof( networkContext ) );
+    ( void ) std::memset( lastTopic, 0x00, sizeof( lastTopic ) );
+    ( void ) std::memset( &publishInfo, 0x00, sizeof( publishInfo ) );
+    publishInfo.pTopicName = "sensor/temperature";
+    publishInfo.topicNameLength = 18U;
+    publishInfo.pPayload = "21.5";
+    publishInfo.payloadLength = 4U;
+    resumeCount = 0U;
+    lastStatus = MQTTIllegalState;
+    client.emplace();
+}
+
+/* Called after each test method. */
+void tearDown( void )
+{
+    client.reset();
+}
+
+/* Called at the beginning of the whole suite. */
+void suiteSetUp()
+{
+}
+
+/* Called at the end of the whole suite. */
+int suiteTearDown( int numFailures )
+{
+    return numFailures;
+}
+
+}
+
+/* ========================================================================== */
+
+static uint32_t getTimeMs( void )
+{
+    return 0U;
+}
+
+static int32_t transportRecv( NetworkContext_t * pNetworkContext,
+                              void * pBuffer,
+                              size_t bytesToRecv )
+{
+    size_t available = pNetworkContext->rxLength - pNetworkContext->rxIndex;
+
+    if( bytesToRecv > available )
+    {
+        bytesToRecv = available;
+    }
+
+    ( void ) std::memcpy( pBuffer, &pNetworkContext->rx[ pNetworkContext->rxIndex ], bytesToRecv );
+    pNetworkContext->rxIndex += bytesToRecv;
+
+    return ( int32_t ) bytesToRecv;
+}
+
+static int32_t transportSend( NetworkContext_t * pNetworkContext,
+                              const void * pBuffer,
+                              size_t bytesToSend )
+{
+    ( void ) pNetworkContext;
+    ( void ) pBuffer;
+
+    return ( int32_t ) bytesToSend;
+}
+
+/**
+ * @brief Replace the packets replayed by the transport.
+ */
+static void setRx( const uint8_t * pPackets,
+                   size_t length )
+{
+    ( void ) std::memcpy( networkContext.rx, pPackets, length );
+    networkContext.rxLength = length;
+    networkContext.rxIndex = 0U;
+}
+
+/**
+ * @brief Connect with a clean session.
+ */
+static void connect( void )
+{
+    MQTTConnectInfo_t connectInfo = {};
+    bool sessionPresent = true;
+    const uint8_t connack[] = { MQTT_PACKET_TYPE_CONNACK, 0x02, 0x00, 0x00 };
+
+    setRx( connack, sizeof( connack ) );
+    connectInfo.cleanSession = true;
+    connectInfo.pClientIdentifier = "coroutine";
+    connectInfo.clientIdentifierLength = 9U;
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Connect( client->context(), &connectInfo, NULL, 0U, &sessionPresent ) );
+}
+
+/**
+ * @brief Initialize the client with state records and connect.
+ */
+static void initClient( void )
+{
+    TransportInterface_t transport = {};
+    MQTTFixedBuffer_t networkBuffer = { buffer, sizeof( buffer ) };
+
+    transport.pNetworkContext = &networkContext;
+    transport.recv = transportRecv;
+    transport.send = transportSend;
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, client->init( transport, getTimeMs, networkBuffer, tokens, TOKEN_COUNT ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_InitStatefulQoS( client->context(), outgoingRecords, 4U, incomingRecords, 4U ) );
+
+    connect();
+}
+
+/**
+ * @brief Publish with the given QoS and record the result.
+ */
+static coremqtt::Task publishTask( MQTTQoS_t qos )
+{
+    MQTTPublishInfo_t info = publishInfo;
+
+    info.qos = qos;
+    lastStatus = co_await client->publish( info );
+    resumeCount++;
+}
+
+/**
+ * @brief Subscribe to two topic filters and record the result.
+ */
+static coremqtt::Task subscribeTask( void )
+{
+    MQTTSubscribeInfo_t subscriptions[ 2 ] = {};
+
+    subscriptions[ 0 ].qos = MQTTQoS0;
+    subscriptions[ 0 ].pTopicFilter = "sensor/+";
+    subscriptions[ 0 ].topicFilterLength = 8U;
+    subscriptions[ 1 ].qos = MQTTQoS0;
+    subscriptions[ 1 ].pTopicFilter = "actuator/#";
+    subscriptions[ 1 ].topicFilterLength = 10U;
+
+    lastStatus = co_await client->subscribe( subscriptions, 2U );
+    resumeCount++;
+}
+
+/**
+ * @brief Receive publishes and record their topics, until the receive is
+ * cancelled.
+ */
+static coremqtt::Task receiveTask( void )
+{
+    const MQTTPublishInfo_t * pPublish = co_await client->receive();
+
+    while( pPublish != nullptr )
+    {
+        ( void ) std::memcpy( lastTopic, pPublish->pTopicName, pPublish->topicNameLength );
+        lastTopic[ pPublish->topicNameLength ] = '\0';
+        resumeCount++;
+        pPublish = co_await client->receive();
+    }
+
+    lastStatus = MQTTSuccess;
+}
+
+/* ========================================================================== */
+
+extern "C" {
+
+/**
+ * @brief A QoS0 publish completes without suspending the coroutine.
+ */
+void test_Coroutine_PublishQoS0( void )
+{
+    initClient();
+
+    TEST_ASSERT_TRUE( publishTask( MQTTQoS0 ).valid() );
+    TEST_ASSERT_EQUAL( 1U, resumeCount );
+    TEST_ASSERT_EQUAL( MQTTSuccess, lastStatus );
+    TEST_ASSERT_EQUAL( 0U, coremqtt::FramePool::usedCount() );
+}
+
+/**
+ * @brief QoS1 and QoS2 publishes resume their coroutines from the poll
+ * receiving the PUBACK and the PUBCOMP.
+ */
+void test_Coroutine_PublishAcknowledged( void )
+{
+    const uint8_t puback[] = { MQTT_PACKET_TYPE_PUBACK, 0x02, 0x00, 0x01 };
+    const uint8_t pubrec[] = { MQTT_PACKET_TYPE_PUBREC, 0x02, 0x00, 0x02 };
+    const uint8_t pubcomp[] = { MQTT_PACKET_TYPE_PUBCOMP, 0x02, 0x00, 0x02 };
+
+    initClient();
+
+    TEST_ASSERT_TRUE( publishTask( MQTTQoS1 ).valid() );
+    TEST_ASSERT_TRUE( publishTask( MQTTQoS2 ).valid() );
+    TEST_ASSERT_EQUAL( 0U, resumeCount );
+    TEST_ASSERT_EQUAL( 2U, coremqtt::FramePool::usedCount() );
+
+    setRx( puback, sizeof( puback ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, client->poll() );
+    TEST_ASSERT_EQUAL( 1U, resumeCount );
+    TEST_ASSERT_EQUAL( MQTTSuccess, lastStatus );
+
+    setRx( pubrec, sizeof( pubrec ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, client->poll() );
+    TEST_ASSERT_EQUAL( 1U, resumeCount );
+
+    setRx( pubcomp, sizeof( pubcomp ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, client->poll() );
+    TEST_ASSERT_EQUAL( 2U, resumeCount );
+    TEST_ASSERT_EQUAL( 0U, coremqtt::FramePool::usedCount() );
+}
+
+/**
+ * @brief A publish failing to start resumes its coroutine at once with the
+ * error.
+ */
+void test_Coroutine_PublishNotConnected( void )
+{
+    initClient();
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Disconnect( client->context() ) );
+
+    TEST_ASSERT_TRUE( publishTask( MQTTQoS1 ).valid() );
+    TEST_ASSERT_EQUAL( 1U, resumeCount );
+    TEST_ASSERT_EQUAL( MQTTStatusNotConnected, lastStatus );
+    TEST_ASSERT_EQUAL( 0U, coremqtt::FramePool::usedCount() );
+}
+
+/**
+ * @brief A subscribe resumes its coroutine with its SUBACK.
+ */
+void test_Coroutine_Subscribe( void )
+{
+    const uint8_t subacks[] = { MQTT_PACKET_TYPE_SUBACK, 0x04, 0x00, 0x01, 0x00, 0x01,
+                                MQTT_PACKET_TYPE_SUBACK, 0x04, 0x00, 0x02, 0x00, 0x80 };
+
+    initClient();
+
+    TEST_ASSERT_TRUE( subscribeTask().valid() );
+    TEST_ASSERT_TRUE( subscribeTask().valid() );
+    TEST_ASSERT_EQUAL( 0U, resumeCount );
+
+    setRx( subacks, sizeof( subacks ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, client->poll() );
+    TEST_ASSERT_EQUAL( 1U, resumeCount );
+    TEST_ASSERT_EQUAL( MQTTSuccess, lastStatus );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, client->poll() );
+    TEST_ASSERT_EQUAL( 2U, resumeCount );
+    TEST_ASSERT_EQUAL( MQTTServerRefused, lastStatus );
+}
+
+/**
+ * @brief A new connection resumes the coroutines of abandoned operations at
+ * the next poll.
+ */
+void test_Coroutine_Abandoned( void )
+{
+    initClient();
+
+    TEST_ASSERT_TRUE( subscribeTask().valid() );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Disconnect( client->context() ) );
+    connect();
+    TEST_ASSERT_EQUAL( 0U, resumeCount );
+
+    ( void ) client->poll();
+    TEST_ASSERT_EQUAL( 1U, resumeCount );
+    TEST_ASSERT_EQUAL( MQTTStatusNotConnected, lastStatus );
+}
+
+/**
+ * @brief Incoming publishes resume the receiving coroutine, are counted while
+ * there is none, and a second receiver is refused.
+ */
+void test_Coroutine_Receive( void )
+{
+    const uint8_t publishes[] = { MQTT_PACKET_TYPE_PUBLISH, 0x07, 0x00, 0x03, 'a', '/', 'b', 'x', 'y',
+                                  MQTT_PACKET_TYPE_PUBLISH, 0x07, 0x00, 0x03, 'c', '/', 'd', 'x', 'y' };
+
+    initClient();
+
+    setRx( publishes, sizeof( publishes ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, client->poll() );
+    TEST_ASSERT_EQUAL( 1U, client->droppedCount() );
+
+    TEST_ASSERT_TRUE( receiveTask().valid() );
+    TEST_ASSERT_EQUAL( 0U, resumeCount );
+
+    /* The second receiver resumes at once with nullptr. */
+    TEST_ASSERT_TRUE( receiveTask().valid() );
+    TEST_ASSERT_EQUAL( MQTTSuccess, lastStatus );
+    lastStatus = MQTTIllegalState;
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, client->poll() );
+    TEST_ASSERT_EQUAL( 1U, resumeCount );
+    TEST_ASSERT_EQUAL_STRING( "c/d", lastTopic );
+    TEST_ASSERT_EQUAL( 1U, client->droppedCount() );
+
+    client->cancelReceive();
+    TEST_ASSERT_EQUAL( MQTTSuccess, lastStatus );
+    TEST_ASSERT_EQUAL( 0U, coremqtt::FramePool::usedCount() );
+}
+
+/**
+ * @brief A coroutine does not start when the frame pool is exhausted, and the
+ * frames of finished coroutines are reused.
+ */
+void test_Coroutine_FramePoolExhausted( void )
+{
+    const uint8_t pubacks[] = { MQTT_PACKET_TYPE_PUBACK, 0x02, 0x00, 0x01,
+                                MQTT_PACKET_TYPE_PUBACK, 0x02, 0x00, 0x02,
+                                MQTT_PACKET_TYPE_PUBACK, 0x02, 0x00, 0x03,
+                                MQTT_PACKET_TYPE_PUBACK, 0x02, 0x00, 0x04 };
+    uint32_t i;
+
+    initClient();
+
+    for( i = 0U; i < MQTT_COROUTINE_FRAME_COUNT; i++ )
+    {
+        TEST_ASSERT_TRUE( publishTask( MQTTQoS1 ).valid() );
+    }
+
+    TEST_ASSERT_FALSE( publishTask( MQTTQoS1 ).valid() );
+    TEST_ASSERT_EQUAL( MQTT_COROUTINE_FRAME_COUNT, coremqtt::FramePool::usedCount() );
+
+    setRx( pubacks, sizeof( pubacks ) );
+
+    for( i = 0U; i < MQTT_COROUTINE_FRAME_COUNT; i++ )
+    {
+        TEST_ASSERT_EQUAL( MQTTSuccess, client->poll() );
+    }
+
+    TEST_ASSERT_EQUAL( MQTT_COROUTINE_FRAME_COUNT, resumeCount );
+    TEST_ASSERT_EQUAL( 0U, coremqtt::FramePool::usedCount() );
+    TEST_ASSERT_TRUE( publishTask( MQTTQoS0 ).valid() );
+}
+
+}
@@ -0,0 +1,840 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file core_mqtt_hooks_system_test.c
+ * @brief System tests of the send and state update hooks, defined as mutexes
+ * in hooks/core_mqtt_config.h, with threads publishing while another thread
+ * processes the acknowledgements of a stand-in broker.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/socket.h>
+
+#include "unity.h"
+
+#include "core_mqtt.h"
+#include "core_mqtt_state.h"
+
+/**
+ * @brief Each compilation unit that uses the transport must define the
+ * NetworkContext struct. The transport of this test is a non-blocking
+ * socket.
+ */
+struct NetworkContext
+{
+    int socket;
+};
+
+/**
+ * @brief Number of publishing threads.
+ */
+#define PUBLISHER_COUNT           ( 4U )
+
+/**
+ * @brief Number of publishes of each publishing thread.
+ */
+#define PUBLISHES_PER_THREAD      ( 500U )
+
+/**
+ * @brief Number of outgoing QoS1 and QoS2 state records, fewer than the
+ * publishes in flight so that publishers wait for acknowledgements.
+ */
+#define OUTGOING_RECORD_COUNT     ( 16U )
+
+/**
+ * @brief Largest number of bytes written by one call of the transport, so
+ * that every packet takes several calls.
+ */
+#define SEND_CHUNK_SIZE           ( 5U )
+
+/**
+ * @brief Time to wait for the threads of a test.
+ */
+#define WAIT_TIMEOUT_MS           ( 10000U )
+
+/**
+ * @brief The context under test, and the broker side.
+ */
+static MQTTContext_t context;
+static NetworkContext_t networkContext;
+static uint8_t buffer[ 256 ];
+static int brokerSocket;
+#if ( MQTT_QOS0_ONLY == 0 )
+    static MQTTPubAckInfo_t outgoingRecords[ OUTGOING_RECORD_COUNT ];
+#endif
+
+/**
+ * @brief The hooks, and the threads holding them.
+ */
+static pthread_mutex_t sendMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t stateMutex = PTHREAD_MUTEX_INITIALIZER;
+static __thread bool holdingSend;
+static __thread bool holdingState;
+static uint32_t lockOrderViolations;
+static uint32_t unguardedSends;
+
+/**
+ * @brief Blocks the transport of the next publish until released.
+ */
+static bool blockSend;
+static bool sendBlocked;
+
+/**
+ * @brief What the broker received.
+ */
+static uint32_t brokerPublishCount;
+static uint16_t brokerNextSequence[ PUBLISHER_COUNT ];
+static bool brokerOutOfOrder;
+static bool brokerBadPacket;
+static bool brokerPacketAfterDisconnect;
+static bool brokerAutoAck;
+
+/**
+ * @brief What the publishing and receiving threads saw.
+ */
+static uint32_t completedCount;
+static uint32_t publishFailures;
+static uint32_t processFailures;
+static MQTTStatus_t lastFailure;
+
+/**
+ * @brief Publishes of each publishing thread, or zero to publish until a
+ * publish fails.
+ */
+static size_t publishesPerThread;
+
+/**
+ * @brief Stops the threads.
+ */
+static bool stopThreads;
+
+/* ============================   UNITY FIXTURES ============================ */
+
+/* Called before each test method. */
+void setUp( void )
+{
+    ( void ) memset( &context, 0x00, sizeof( context ) );
+    ( void ) memset( brokerNextSequence, 0x00, sizeof( brokerNextSequence ) );
+
+    networkContext.socket = -1;
+    brokerSocket = -1;
+    lockOrderViolations = 0U;
+    unguardedSends = 0U;
+    blockSend = false;
+    sendBlocked = false;
+    brokerPublishCount = 0U;
+    brokerOutOfOrder = false;
+    brokerBadPacket = false;
+    brokerPacketAfterDisconnect = false;
+    brokerAutoAck = true;
+    completedCount = 0U;
+    publishFailures = 0U;
+    processFailures = 0U;
+    lastFailure = MQTTSuccess;
+    publishesPerThread = PUBLISHES_PER_THREAD;
+    stopThreads = false;
+}
+
+/* Called after each test method. */
+void tearDown( void )
+{
+    if( networkContext.socket >= 0 )
+    {
+        ( void ) close( networkContext.socket );
+    }
+
+    if( brokerSocket >= 0 )
+    {
+        ( void ) close( brokerSocket );
+    }
+}
+
+/* Called at the beginning of the whole suite. */
+void suiteSetUp()
+{
+}
+
+/* Called at the end of the whole suite. */
+int suiteTearDown( int numFailures )
+{
+    return numFailures;
+}
+
+/* ============================   HOOKS ===================================== */
+
+void SystemTestHooks_LockSend( const struct MQTTContext * pContext )
+{
+    ( void ) pContext;
+
+    /* The send hook is never taken again, nor while the state is held. */
+    if( ( holdingSend == true ) || ( holdingState == true ) )
+    {
+        __atomic_add_fetch( &lockOrderViolations, 1U, __ATOMIC_SEQ_CST );
+    }
+
+    ( void ) pthread_mutex_lock( &sendMutex );
+    holdingSend = true;
+}
+
+void SystemTestHooks_UnlockSend( const struct MQTTContext * pContext )
+{
+    ( void ) pContext;
+
+    holdingSend = false;
+    ( void ) pthread_mutex_unlock( &sendMutex );
+}
+
+void SystemTestHooks_LockState( const struct MQTTContext * pContext )
+{
+    ( void ) pContext;
+
+    if( holdingState == true )
+    {
+        __atomic_add_fetch( &lockOrderViolations, 1U, __ATOMIC_SEQ_CST );
+    }
+
+    ( void ) pthread_mutex_lock( &stateMutex );
+    holdingState = true;
+}
+
+void SystemTestHooks_UnlockState( const struct MQTTContext * pContext )
+{
+    ( void ) pContext;
+
+    holdingState = false;
+    ( void ) pthread_mutex_unlock( &stateMutex );
+}
+
+/* ========================================================================== */
+
+static uint32_t getTimeMs( void )
+{
+    struct timespec now;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( uint32_t ) ( ( now.tv_sec * 1000 ) + ( now.tv_nsec / 1000000 ) );
+}
+
+static int32_t socketRecv( NetworkContext_t * pNetworkContext,
+                           void * pBuffer,
+                           size_t bytesToRecv )
+{
+    ssize_t result = recv( pNetworkContext->socket, pBuffer, bytesToRecv, MSG_DONTWAIT );
+    int32_t bytesReceived = -1;
+
+    if( result > 0 )
+    {
+        bytesReceived = ( int32_t ) result;
+    }
+    else if( ( result < 0 ) && ( ( errno == EAGAIN ) || ( errno == EWOULDBLOCK ) ) )
+    {
+        bytesReceived = 0;
+    }
+    else
+    {
+        /* Closed by the peer, or failed. */
+    }
+
+    return bytesReceived;
+}
+
+/* Write a few bytes at a time, under the send hook only, yielding between
+ * writes to let other threads run in the middle of a packet. */
+static int32_t socketSend( NetworkContext_t * pNetworkContext,
+                           const void * pBuffer,
+                           size_t bytesToSend )
+{
+    ssize_t result;
+    int32_t bytesSent = -1;
+
+    if( ( holdingSend == false ) || ( holdingState == true ) )
+    {
+        __atomic_add_fetch( &unguardedSends, 1U, __ATOMIC_SEQ_CST );
+    }
+
+    if( __atomic_load_n( &blockSend, __ATOMIC_SEQ_CST ) == true )
+    {
+        __atomic_store_n( &sendBlocked, true, __ATOMIC_SEQ_CST );
+
+        while( __atomic_load_n( &blockSend, __ATOMIC_SEQ_CST ) == true )
+        {
+            ( void ) sched_yield();
+        }
+    }
+
+    result = send( pNetworkContext->socket, pBuffer,
+                   ( bytesToSend < SEND_CHUNK_SIZE ) ? bytesToSend : SEND_CHUNK_SIZE,
+                   MSG_DONTWAIT | MSG_NOSIGNAL );
+
+    if( result >= 0 )
+    {
+        bytesSent = ( int32_t ) result;
+    }
+    else if( ( errno == EAGAIN ) || ( errno == EWOULDBLOCK ) )
+    {
+        bytesSent = 0;
+    }
+    else
+    {
+        /* Failed. */
+    }
+
+    ( void ) sched_yield();
+
+    return bytesSent;
+}
+
+/* Count the completed publishes. */
+static void eventCallback( MQTTContext_t * pContext,
+                           MQTTPacketInfo_t * pPacketInfo,
+                           MQTTDeserializedInfo_t * pDeserializedInfo )
+{
+    ( void ) pContext;
+    ( void ) pDeserializedInfo;
+
+    if( ( pPacketInfo->type == MQTT_PACKET_TYPE_PUBACK ) ||
+        ( pPacketInfo->type == MQTT_PACKET_TYPE_PUBCOMP ) )
+    {
+        __atomic_add_fetch( &completedCount, 1U, __ATOMIC_SEQ_CST );
+    }
+}
+
+/* Read exactly length bytes from the broker socket, unless stopped. */
+static bool brokerRead( uint8_t * pBuffer,
+                        size_t length )
+{
+    size_t received = 0U;
+    ssize_t result;
+
+    while( ( received < length ) && ( __atomic_load_n( &stopThreads, __ATOMIC_SEQ_CST ) == false ) )
+    {
+        result = recv( brokerSocket, &pBuffer[ received ], length - received, MSG_DONTWAIT );
+
+        if( result > 0 )
+        {
+            received += ( size_t ) result;
+        }
+        else if( ( result < 0 ) && ( ( errno == EAGAIN ) || ( errno == EWOULDBLOCK ) ) )
+        {
+            ( void ) sched_yield();
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    return received == length;
+}
+
+/* Send an acknowledgement of a packet identifier. */
+static void brokerAck( uint8_t type,
+                       const uint8_t * pPacketId )
+{
+    uint8_t ack[ 4 ];
+
+    ack[ 0 ] = type;
+    ack[ 1 ] = 0x02U;
+    ack[ 2 ] = pPacketId[ 0 ];
+    ack[ 3 ] = pPacketId[ 1 ];
+
+    ( void ) send( brokerSocket, ack, sizeof( ack ), MSG_NOSIGNAL );
+}
+
+/* Parse the stream, which is only well formed if packets were not interleaved,
+ * and acknowledge every publish at once. */
+static void * brokerThread( void * pArgument )
+{
+    uint8_t header[ 2 ];
+    uint8_t packet[ 64 ];
+    static const uint8_t pingResp[ 2 ] = { 0xD0U, 0x00U };
+    bool disconnected = false;
+    size_t offset;
+    uint8_t publisher;
+    uint16_t sequence;
+
+    ( void ) pArgument;
+
+    while( brokerRead( header, sizeof( header ) ) == true )
+    {
+        /* Every packet of these tests is shorter than 128 bytes. */
+        if( ( header[ 1 ] > sizeof( packet ) ) ||
+            ( brokerRead( packet, header[ 1 ] ) == false ) )
+        {
+            brokerBadPacket = true;
+            break;
+        }
+
+        if( disconnected == true )
+        {
+            brokerPacketAfterDisconnect = true;
+        }
+
+        if( ( header[ 0 ] & 0xF0U ) == MQTT_PACKET_TYPE_PUBLISH )
+        {
+            /* The topic is "hooks", followed by the packet identifier of QoS1
+             * and QoS2, and the publisher and sequence number. */
+            offset = 7U;
+
+            if( ( packet[ 0 ] != 0U ) || ( packet[ 1 ] != 5U ) ||
+                ( memcmp( &packet[ 2 ], "hooks", 5U ) != 0 ) )
+            {
+                brokerBadPacket = true;
+            }
+            else if( ( header[ 0 ] & 0x06U ) == 0x02U )
+            {
+                if( brokerAutoAck == true )
+                {
+                    brokerAck( MQTT_PACKET_TYPE_PUBACK, &packet[ offset ] );
+                }
+
+                offset += 2U;
+            }
+            else if( ( header[ 0 ] & 0x06U ) == 0x04U )
+            {
+                brokerAck( MQTT_PACKET_TYPE_PUBREC, &packet[ offset ] );
+                offset += 2U;
+            }
+            else
+            {
+                /* QoS0. */
+            }
+
+            if( ( offset + 3U ) != header[ 1 ] )
+            {
+                brokerBadPacket = true;
+            }
+            else
+            {
+                publisher = packet[ offset ];
+                sequence = ( uint16_t ) ( ( ( uint16_t ) packet[ offset + 1U ] << 8 ) | packet[ offset + 2U ] );
+
+                if( publisher >= PUBLISHER_COUNT )
+                {
+                    brokerBadPacket = true;
+                }
+                else if( sequence != brokerNextSequence[ publisher ] )
+                {
+                    brokerOutOfOrder = true;
+                }
+                else
+                {
+                    brokerNextSequence[ publisher ]++;
+                }
+            }
+
+            __atomic_add_fetch( &brokerPublishCount, 1U, __ATOMIC_SEQ_CST );
+        }
+        else if( ( header[ 0 ] == MQTT_PACKET_TYPE_PUBREL ) && ( header[ 1 ] == 2U ) )
+        {
+            brokerAck( MQTT_PACKET_TYPE_PUBCOMP, packet );
+        }
+        else if( ( header[ 0 ] == MQTT_PACKET_TYPE_PINGREQ ) && ( header[ 1 ] == 0U ) )
+        {
+            ( void ) send( brokerSocket, pingResp, sizeof( pingResp ), MSG_NOSIGNAL );
+        }
+        else if( ( header[ 0 ] == MQTT_PACKET_TYPE_DISCONNECT ) && ( header[ 1 ] == 0U ) )
+        {
+            disconnected = true;
+        }
+        else
+        {
+            brokerBadPacket = true;
+        }
+    }
+
+    return NULL;
+}
+
+/* Publish publishesPerThread publishes of the given QoS, or alternating QoS1
+ * and QoS2 for MQTTQoS2, waiting for a free record when none is left. */
+static void * publisherThread( void * pArgument )
+{
+    size_t publisher = ( size_t ) pArgument & 0xFFU;
+    MQTTQoS_t qos = ( MQTTQoS_t ) ( ( size_t ) pArgument >> 8 );
+    MQTTPublishInfo_t publishInfo;
+    MQTTStatus_t status;
+    uint8_t payload[ 3 ];
+    uint16_t packetId = 0U;
+    size_t i;
+
+    ( void ) memset( &publishInfo, 0x00, sizeof( publishInfo ) );
+    publishInfo.pTopicName = "hooks";
+    publishInfo.topicNameLength = 5U;
+    publishInfo.pPayload = payload;
+    publishInfo.payloadLength = sizeof( payload );
+
+    for( i = 0U; ( publishesPerThread == 0U ) || ( i < publishesPerThread ); i++ )
+    {
+        payload[ 0 ] = ( uint8_t ) publisher;
+        payload[ 1 ] = ( uint8_t ) ( i >> 8 );
+        payload[ 2 ] = ( uint8_t ) i;
+        publishInfo.qos = ( ( qos == MQTTQoS2 ) && ( ( i % 2U ) == 0U ) ) ? MQTTQoS1 : qos;
+
+        if( publishInfo.qos != MQTTQoS0 )
+        {
+            packetId = MQTT_GetPacketId( &context );
+        }
+
+        do
+        {
+            status = MQTT_Publish( &context, &publishInfo, packetId );
+
+            if( status == MQTTNoMemory )
+            {
+                ( void ) sched_yield();
+            }
+        } while( status == MQTTNoMemory );
+
+        if( status != MQTTSuccess )
+        {
+            __atomic_store_n( &lastFailure, status, __ATOMIC_SEQ_CST );
+            __atomic_add_fetch( &publishFailures, 1U, __ATOMIC_SEQ_CST );
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+#if ( MQTT_QOS0_ONLY == 0 )
+
+    /* Process incoming packets until stopped. */
+    static void * receiverThread( void * pArgument )
+    {
+        MQTTStatus_t status;
+
+        ( void ) pArgument;
+
+        while( __atomic_load_n( &stopThreads, __ATOMIC_SEQ_CST ) == false )
+        {
+            status = MQTT_ProcessLoop( &context );
+
+            if( ( status != MQTTSuccess ) && ( status != MQTTNeedMoreBytes ) )
+            {
+                __atomic_store_n( &lastFailure, status, __ATOMIC_SEQ_CST );
+                __atomic_add_fetch( &processFailures, 1U, __ATOMIC_SEQ_CST );
+            }
+
+            ( void ) sched_yield();
+        }
+
+        return NULL;
+    }
+
+#endif /* if ( MQTT_QOS0_ONLY == 0 ) */
+
+/* Initialize the context over a socket pair. */
+static void initContext( void )
+{
+    TransportInterface_t transport;
+    MQTTFixedBuffer_t networkBuffer;
+    int sockets[ 2 ];
+
+    TEST_ASSERT_EQUAL( 0, socketpair( AF_UNIX, SOCK_STREAM, 0, sockets ) );
+    networkContext.socket = sockets[ 0 ];
+    brokerSocket = sockets[ 1 ];
+
+    ( void ) memset( &transport, 0x00, sizeof( transport ) );
+    transport.pNetworkContext = &networkContext;
+    transport.recv = socketRecv;
+    transport.send = socketSend;
+    networkBuffer.pBuffer = buffer;
+    networkBuffer.size = sizeof( buffer );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Init( &context, &transport, getTimeMs,
+                                               eventCallback, &networkBuffer ) );
+    #if ( MQTT_QOS0_ONLY == 0 )
+        TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_InitStatefulQoS( &context, outgoingRecords,
+                                                              OUTGOING_RECORD_COUNT, NULL, 0U ) );
+    #endif
+}
+
+/* Connect the context over a socket pair. */
+static void connectContext( uint16_t keepAliveSeconds )
+{
+    static const uint8_t connack[] = { 0x20U, 0x02U, 0x00U, 0x00U };
+    MQTTConnectInfo_t connectInfo;
+    bool sessionPresent = false;
+    uint8_t connect[ 64 ];
+
+    initContext();
+
+    ( void ) memset( &connectInfo, 0x00, sizeof( connectInfo ) );
+    connectInfo.cleanSession = true;
+    connectInfo.pClientIdentifier = "hooks";
+    connectInfo.clientIdentifierLength = 5U;
+    connectInfo.keepAliveSeconds = keepAliveSeconds;
+
+    /* The CONNACK is waiting before the CONNECT is sent. */
+    TEST_ASSERT_EQUAL( sizeof( connack ), write( brokerSocket, connack, sizeof( connack ) ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Connect( &context, &connectInfo, NULL, 1000U, &sessionPresent ) );
+    TEST_ASSERT_GREATER_THAN( 0, recv( brokerSocket, connect, sizeof( connect ), MSG_DONTWAIT ) );
+}
+
+/* Connect with a clean session, returning the status of MQTT_Connect. */
+static void * connectThread( void * pArgument )
+{
+    MQTTConnectInfo_t connectInfo;
+    bool sessionPresent = false;
+
+    ( void ) memset( &connectInfo, 0x00, sizeof( connectInfo ) );
+    connectInfo.cleanSession = true;
+    connectInfo.pClientIdentifier = "hooks";
+    connectInfo.clientIdentifierLength = 5U;
+
+    *( MQTTStatus_t * ) pArgument = MQTT_Connect( &context, &connectInfo, NULL, 1000U, &sessionPresent );
+
+    return NULL;
+}
+
+/* Wait until the value reaches count, or the timeout passes. */
+static bool waitForCount( const uint32_t * pValue,
+                          uint32_t count )
+{
+    uint32_t start = getTimeMs();
+
+    while( ( __atomic_load_n( pValue, __ATOMIC_SEQ_CST ) < count ) &&
+           ( ( getTimeMs() - start ) < WAIT_TIMEOUT_MS ) )
+    {
+        ( void ) sched_yield();
+    }
+
+    return __atomic_load_n( pValue, __ATOMIC_SEQ_CST ) >= count;
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Threads publishing QoS1 and QoS2 while another thread processes the
+ * acknowledgements: packets are not interleaved, every acknowledgement finds
+ * its state record, and every record is freed.
+ */
+void test_MQTTHooks_ConcurrentPublishesAndAcks( void )
+{
+    #if ( MQTT_QOS0_ONLY == 0 )
+        pthread_t publishers[ PUBLISHER_COUNT ];
+        pthread_t receiver;
+        pthread_t broker;
+        MQTTStateCursor_t cursor = MQTT_STATE_CURSOR_INITIALIZER;
+        size_t i;
+
+        /* Keep-alive is on, so the receiving thread also sends PINGREQs. */
+        connectContext( 1U );
+
+        TEST_ASSERT_EQUAL( 0, pthread_create( &broker, NULL, brokerThread, NULL ) );
+        TEST_ASSERT_EQUAL( 0, pthread_create( &receiver, NULL, receiverThread, NULL ) );
+
+        for( i = 0U; i < PUBLISHER_COUNT; i++ )
+        {
+            TEST_ASSERT_EQUAL( 0, pthread_create( &publishers[ i ], NULL, publisherThread,
+                                                  ( void * ) ( ( ( size_t ) MQTTQoS2 << 8 ) | i ) ) );
+        }
+
+        for( i = 0U; i < PUBLISHER_COUNT; i++ )
+        {
+            ( void ) pthread_join( publishers[ i ], NULL );
+        }
+
+        ( void ) waitForCount( &completedCount, PUBLISHER_COUNT * PUBLISHES_PER_THREAD );
+
+        __atomic_store_n( &stopThreads, true, __ATOMIC_SEQ_CST );
+        ( void ) pthread_join( receiver, NULL );
+        ( void ) pthread_join( broker, NULL );
+
+        TEST_ASSERT_EQUAL( 0U, publishFailures );
+        TEST_ASSERT_EQUAL( 0U, processFailures );
+        TEST_ASSERT_EQUAL( PUBLISHER_COUNT * PUBLISHES_PER_THREAD, brokerPublishCount );
+        TEST_ASSERT_EQUAL( PUBLISHER_COUNT * PUBLISHES_PER_THREAD, completedCount );
+        TEST_ASSERT_FALSE( brokerBadPacket );
+        TEST_ASSERT_FALSE( brokerOutOfOrder );
+        TEST_ASSERT_EQUAL( 0U, lockOrderViolations );
+        TEST_ASSERT_EQUAL( 0U, unguardedSends );
+        TEST_ASSERT_EQUAL( MQTT_PACKET_ID_INVALID, MQTT_PublishToResend( &context, &cursor ) );
+    #else /* if ( MQTT_QOS0_ONLY == 0 ) */
+        TEST_IGNORE_MESSAGE( "QoS1 and QoS2 are compiled out." );
+    #endif /* if ( MQTT_QOS0_ONLY == 0 ) */
+}
+
+/**
+ * @brief An acknowledgement is processed while another thread is blocked in
+ * the middle of writing a publish.
+ */
+void test_MQTTHooks_AckProcessedWhileSendBlocked( void )
+{
+    #if ( MQTT_QOS0_ONLY == 0 )
+        pthread_t publisher;
+        pthread_t receiver;
+        MQTTPublishInfo_t publishInfo;
+        uint8_t published[ 64 ];
+        uint8_t pubAck[ 4 ] = { MQTT_PACKET_TYPE_PUBACK, 0x02U, 0x00U, 0x01U };
+        bool ackedWhileBlocked;
+
+        connectContext( 0U );
+
+        /* The broker is played by this thread. A first publish is sent. */
+        ( void ) memset( &publishInfo, 0x00, sizeof( publishInfo ) );
+        publishInfo.qos = MQTTQoS1;
+        publishInfo.pTopicName = "hooks";
+        publishInfo.topicNameLength = 5U;
+        TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Publish( &context, &publishInfo, MQTT_GetPacketId( &context ) ) );
+        TEST_ASSERT_GREATER_THAN( 0, recv( brokerSocket, published, sizeof( published ), MSG_DONTWAIT ) );
+
+        /* A second publish is held in the transport. */
+        publishesPerThread = 1U;
+        __atomic_store_n( &blockSend, true, __ATOMIC_SEQ_CST );
+        TEST_ASSERT_EQUAL( 0, pthread_create( &publisher, NULL, publisherThread,
+                                              ( void * ) ( ( size_t ) MQTTQoS1 << 8 ) ) );
+
+        while( __atomic_load_n( &sendBlocked, __ATOMIC_SEQ_CST ) == false )
+        {
+            ( void ) sched_yield();
+        }
+
+        /* The acknowledgement of the first publish is processed meanwhile. */
+        TEST_ASSERT_EQUAL( sizeof( pubAck ), send( brokerSocket, pubAck, sizeof( pubAck ), MSG_NOSIGNAL ) );
+        TEST_ASSERT_EQUAL( 0, pthread_create( &receiver, NULL, receiverThread, NULL ) );
+
+        ackedWhileBlocked = waitForCount( &completedCount, 1U );
+
+        /* Release the publisher even if the receiver is stuck. */
+        __atomic_store_n( &blockSend, false, __ATOMIC_SEQ_CST );
+        __atomic_store_n( &stopThreads, true, __ATOMIC_SEQ_CST );
+        ( void ) pthread_join( publisher, NULL );
+        ( void ) pthread_join( receiver, NULL );
+
+        TEST_ASSERT_TRUE( ackedWhileBlocked );
+        TEST_ASSERT_EQUAL( 0U, publishFailures );
+        TEST_ASSERT_EQUAL( 0U, processFailures );
+        TEST_ASSERT_EQUAL( 0U, lockOrderViolations );
+        TEST_ASSERT_EQUAL( 0U, unguardedSends );
+    #else /* if ( MQTT_QOS0_ONLY == 0 ) */
+        TEST_IGNORE_MESSAGE( "QoS1 is compiled out." );
+    #endif /* if ( MQTT_QOS0_ONLY == 0 ) */
+}
+
+/**
+ * @brief No packet of a publishing thread follows the DISCONNECT.
+ */
+void test_MQTTHooks_DisconnectIsLastPacket( void )
+{
+    pthread_t publishers[ PUBLISHER_COUNT ];
+    pthread_t broker;
+    size_t i;
+
+    connectContext( 0U );
+    publishesPerThread = 0U;
+
+    TEST_ASSERT_EQUAL( 0, pthread_create( &broker, NULL, brokerThread, NULL ) );
+
+    for( i = 0U; i < PUBLISHER_COUNT; i++ )
+    {
+        TEST_ASSERT_EQUAL( 0, pthread_create( &publishers[ i ], NULL, publisherThread, ( void * ) i ) );
+    }
+
+    /* Disconnect while the publishers are running. */
+    ( void ) waitForCount( &brokerPublishCount, PUBLISHES_PER_THREAD );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Disconnect( &context ) );
+
+    for( i = 0U; i < PUBLISHER_COUNT; i++ )
+    {
+        ( void ) pthread_join( publishers[ i ], NULL );
+    }
+
+    /* Let the broker read what is left. */
+    ( void ) usleep( 10000 );
+    __atomic_store_n( &stopThreads, true, __ATOMIC_SEQ_CST );
+    ( void ) pthread_join( broker, NULL );
+
+    /* Publishers stop at the first publish after the disconnect. */
+    TEST_ASSERT_EQUAL( MQTTStatusNotConnected, lastFailure );
+    TEST_ASSERT_FALSE( brokerPacketAfterDisconnect );
+    TEST_ASSERT_FALSE( brokerBadPacket );
+    TEST_ASSERT_FALSE( brokerOutOfOrder );
+    TEST_ASSERT_EQUAL( 0U, lockOrderViolations );
+    TEST_ASSERT_EQUAL( 0U, unguardedSends );
+}
+
+/**
+ * @brief Of two threads connecting at once, one sends the only CONNECT and
+ * reads the CONNACK, and the other finds the context connected.
+ */
+void test_MQTTHooks_ConcurrentConnects( void )
+{
+    static const uint8_t connack[] = { 0x20U, 0x02U, 0x00U, 0x00U };
+    pthread_t connectors[ 2 ];
+    MQTTStatus_t statuses[ 2 ];
+    uint8_t received[ 128 ];
+    ssize_t length;
+    size_t offset = 0U;
+    size_t connectCount = 0U;
+    size_t i;
+
+    initContext();
+    TEST_ASSERT_EQUAL( sizeof( connack ), write( brokerSocket, connack, sizeof( connack ) ) );
+
+    for( i = 0U; i < 2U; i++ )
+    {
+        TEST_ASSERT_EQUAL( 0, pthread_create( &connectors[ i ], NULL, connectThread, &statuses[ i ] ) );
+    }
+
+    for( i = 0U; i < 2U; i++ )
+    {
+        ( void ) pthread_join( connectors[ i ], NULL );
+    }
+
+    TEST_ASSERT_TRUE( ( ( statuses[ 0 ] == MQTTSuccess ) && ( statuses[ 1 ] == MQTTStatusConnected ) ) ||
+                      ( ( statuses[ 0 ] == MQTTStatusConnected ) && ( statuses[ 1 ] == MQTTSuccess ) ) );
+    TEST_ASSERT_EQUAL( MQTTConnected, context.connectStatus );
+
+    /* The broker received one well formed CONNECT. */
+    length = recv( brokerSocket, received, sizeof( received ), MSG_DONTWAIT );
+    TEST_ASSERT_GREATER_THAN( 0, length );
+
+    while( ( offset + 2U ) <= ( size_t ) length )
+    {
+        if( received[ offset ] == MQTT_PACKET_TYPE_CONNECT )
+        {
+            connectCount++;
+        }
+
+        offset += 2U + received[ offset + 1U ];
+    }
+
+    TEST_ASSERT_EQUAL( ( size_t ) length, offset );
+    TEST_ASSERT_EQUAL( 1U, connectCount );
+    TEST_ASSERT_EQUAL( 0U, lockOrderViolations );
+    TEST_ASSERT_EQUAL( 0U, unguardedSends );
+}
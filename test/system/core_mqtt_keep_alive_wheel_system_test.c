@@ -0,0 +1,428 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file core_mqtt_keep_alive_wheel_system_test.c
+ * @brief System tests of the keep-alive wheel driving many contexts, with a
+ * simulated clock and a transport counting the PINGREQs.
+ */
+
+#include <string.h>
+
+#include "unity.h"
+
+#include "core_mqtt_keep_alive_wheel.h"
+
+/**
+ * @brief Each compilation unit that uses the transport must define the
+ * NetworkContext struct. The transport of this test counts PINGREQs.
+ */
+struct NetworkContext
+{
+    uint32_t pingCount;
+    bool failSend;
+};
+
+/**
+ * @brief Number of contexts.
+ */
+#define CONTEXT_COUNT           ( 1000U )
+
+/**
+ * @brief Keep-alive interval of the contexts.
+ */
+#define KEEP_ALIVE_SECONDS      ( 10U )
+
+/**
+ * @brief Keep-alive interval of the contexts in milliseconds.
+ */
+#define KEEP_ALIVE_MS           ( KEEP_ALIVE_SECONDS * 1000U )
+
+/**
+ * @brief Time of the simulated clock when a test starts, far from 0 so that
+ * time differences wrap.
+ */
+#define START_TIME_MS           ( 0xFFFF0000U )
+
+/**
+ * @brief The contexts, their transports and entries, and the wheel.
+ */
+static MQTTContext_t contexts[ CONTEXT_COUNT ];
+static NetworkContext_t networkContexts[ CONTEXT_COUNT ];
+static MQTTKeepAliveEntry_t entries[ CONTEXT_COUNT ];
+static MQTTKeepAliveWheel_t wheel;
+static uint8_t buffer[ 16 ];
+
+/**
+ * @brief The simulated clock.
+ */
+static uint32_t nowMs;
+
+/**
+ * @brief What the error callback saw.
+ */
+static uint32_t errorCount;
+static MQTTStatus_t lastError;
+static MQTTKeepAliveEntry_t * pLastErrorEntry;
+
+/* ============================   UNITY FIXTURES ============================ */
+
+/* Called before each test method. */
+void setUp( void )
+{
+    ( void ) memset( contexts, 0x00, sizeof( contexts ) );
+    ( void ) memset( networkContexts, 0x00, sizeof( networkContexts ) );
+    ( void ) memset( entries, 0x00, sizeof( entries ) );
+    ( void ) memset( &wheel, 0x00, sizeof( wheel ) );
+
+    nowMs = START_TIME_MS;
+    errorCount = 0U;
+    lastError = MQTTSuccess;
+    pLastErrorEntry = NULL;
+}
+
+/* Called after each test method. */
+void tearDown( void )
+{
+}
+
+/* Called at the beginning of the whole suite. */
+void suiteSetUp()
+{
+}
+
+/* Called at the end of the whole suite. */
+int suiteTearDown( int numFailures )
+{
+    return numFailures;
+}
+
+/* ========================================================================== */
+
+static uint32_t getTimeMs( void )
+{
+    return nowMs;
+}
+
+static int32_t transportRecv( NetworkContext_t * pNetworkContext,
+                              void * pBuffer,
+                              size_t bytesToRecv )
+{
+    ( void ) pNetworkContext;
+    ( void ) pBuffer;
+    ( void ) bytesToRecv;
+
+    return 0;
+}
+
+static int32_t transportSend( NetworkContext_t * pNetworkContext,
+                              const void * pBuffer,
+                              size_t bytesToSend )
+{
+    int32_t bytesSent = ( int32_t ) bytesToSend;
+
+    if( pNetworkContext->failSend == true )
+    {
+        bytesSent = -1;
+    }
+    else if( ( ( const uint8_t * ) pBuffer )[ 0 ] == MQTT_PACKET_TYPE_PINGREQ )
+    {
+        pNetworkContext->pingCount++;
+    }
+    else
+    {
+        /* MISRA else. */
+    }
+
+    return bytesSent;
+}
+
+static void eventCallback( MQTTContext_t * pContext,
+                           MQTTPacketInfo_t * pPacketInfo,
+                           MQTTDeserializedInfo_t * pDeserializedInfo )
+{
+    ( void ) pContext;
+    ( void ) pPacketInfo;
+    ( void ) pDeserializedInfo;
+}
+
+static void errorCallback( MQTTKeepAliveWheel_t * pWheel,
+                           MQTTKeepAliveEntry_t * pEntry,
+                           MQTTStatus_t status )
+{
+    TEST_ASSERT_EQUAL_PTR( &wheel, pWheel );
+
+    errorCount++;
+    lastError = status;
+    pLastErrorEntry = pEntry;
+}
+
+/* Initialize count connected contexts which just sent and received a packet,
+ * and add them to the wheel. */
+static void addContexts( size_t count )
+{
+    TransportInterface_t transport;
+    MQTTFixedBuffer_t networkBuffer;
+    size_t i;
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTTKeepAliveWheel_Init( &wheel, getTimeMs, errorCallback ) );
+
+    networkBuffer.pBuffer = buffer;
+    networkBuffer.size = sizeof( buffer );
+
+    for( i = 0U; i < count; i++ )
+    {
+        ( void ) memset( &transport, 0x00, sizeof( transport ) );
+        transport.pNetworkContext = &networkContexts[ i ];
+        transport.recv = transportRecv;
+        transport.send = transportSend;
+
+        TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Init( &contexts[ i ], &transport, getTimeMs,
+                                                   eventCallback, &networkBuffer ) );
+        contexts[ i ].connectStatus = MQTTConnected;
+        contexts[ i ].keepAliveIntervalSec = KEEP_ALIVE_SECONDS;
+        contexts[ i ].lastPacketTxTime = nowMs;
+        contexts[ i ].lastPacketRxTime = nowMs;
+
+        entries[ i ].pContext = &contexts[ i ];
+        TEST_ASSERT_EQUAL( MQTTSuccess, MQTTKeepAliveWheel_Add( &wheel, &entries[ i ] ) );
+    }
+}
+
+/* Advance the clock by steps of stepMs, processing the wheel at each step. */
+static void advance( uint32_t durationMs,
+                     uint32_t stepMs )
+{
+    uint32_t elapsedMs;
+
+    for( elapsedMs = 0U; elapsedMs < durationMs; elapsedMs += stepMs )
+    {
+        nowMs += stepMs;
+        TEST_ASSERT_EQUAL( MQTTSuccess, MQTTKeepAliveWheel_Process( &wheel ) );
+    }
+}
+
+/* Count the PINGREQs sent on the contexts from first to first + count. */
+static uint32_t countPings( size_t first,
+                            size_t count )
+{
+    uint32_t pings = 0U;
+    size_t i;
+
+    for( i = first; i < ( first + count ); i++ )
+    {
+        pings += networkContexts[ i ].pingCount;
+    }
+
+    return pings;
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Invalid parameters are rejected.
+ */
+void test_MQTTKeepAliveWheel_InvalidParams( void )
+{
+    MQTTKeepAliveEntry_t entry;
+
+    ( void ) memset( &entry, 0x00, sizeof( entry ) );
+
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTTKeepAliveWheel_Init( NULL, getTimeMs, errorCallback ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTTKeepAliveWheel_Init( &wheel, NULL, errorCallback ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTTKeepAliveWheel_Init( &wheel, getTimeMs, NULL ) );
+
+    /* The wheel is not initialized. */
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTTKeepAliveWheel_Process( &wheel ) );
+    TEST_ASSERT_EQUAL( MQTT_KEEP_ALIVE_WHEEL_NO_TIMEOUT, MQTTKeepAliveWheel_GetNextTimeout( &wheel ) );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTTKeepAliveWheel_Init( &wheel, getTimeMs, errorCallback ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTTKeepAliveWheel_Add( NULL, &entry ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTTKeepAliveWheel_Add( &wheel, NULL ) );
+
+    /* The entry has no context. */
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTTKeepAliveWheel_Add( &wheel, &entry ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTTKeepAliveWheel_Remove( NULL, &entry ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTTKeepAliveWheel_Remove( &wheel, NULL ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTTKeepAliveWheel_Remove( &wheel, &entry ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTTKeepAliveWheel_Process( NULL ) );
+    TEST_ASSERT_EQUAL( MQTT_KEEP_ALIVE_WHEEL_NO_TIMEOUT, MQTTKeepAliveWheel_GetNextTimeout( NULL ) );
+    TEST_ASSERT_EQUAL( MQTT_KEEP_ALIVE_WHEEL_NO_TIMEOUT, MQTTKeepAliveWheel_GetNextTimeout( &wheel ) );
+}
+
+/**
+ * @brief No context is examined before its deadline, and only the contexts
+ * idle for the keep-alive interval are pinged.
+ */
+void test_MQTTKeepAliveWheel_PingsOnlyIdleContexts( void )
+{
+    size_t i;
+
+    addContexts( CONTEXT_COUNT );
+
+    /* The first half sends a packet after 5 seconds. */
+    advance( 5000U, MQTT_KEEP_ALIVE_WHEEL_TICK_MS );
+
+    for( i = 0U; i < ( CONTEXT_COUNT / 2U ); i++ )
+    {
+        contexts[ i ].lastPacketTxTime = nowMs;
+    }
+
+    advance( KEEP_ALIVE_MS - 5000U - MQTT_KEEP_ALIVE_WHEEL_TICK_MS, MQTT_KEEP_ALIVE_WHEEL_TICK_MS );
+    TEST_ASSERT_EQUAL( 0U, wheel.examinedCount );
+    TEST_ASSERT_EQUAL( 0U, countPings( 0U, CONTEXT_COUNT ) );
+
+    /* At the deadline, every context is examined and the idle half pinged. */
+    advance( MQTT_KEEP_ALIVE_WHEEL_TICK_MS, MQTT_KEEP_ALIVE_WHEEL_TICK_MS );
+    TEST_ASSERT_EQUAL( CONTEXT_COUNT, wheel.examinedCount );
+    TEST_ASSERT_EQUAL( CONTEXT_COUNT / 2U, wheel.pingCount );
+    TEST_ASSERT_EQUAL( 0U, countPings( 0U, CONTEXT_COUNT / 2U ) );
+    TEST_ASSERT_EQUAL( CONTEXT_COUNT / 2U, countPings( CONTEXT_COUNT / 2U, CONTEXT_COUNT / 2U ) );
+
+    /* The PINGRESPs arrive. */
+    for( i = CONTEXT_COUNT / 2U; i < CONTEXT_COUNT; i++ )
+    {
+        TEST_ASSERT_TRUE( contexts[ i ].waitingForPingResp );
+        contexts[ i ].waitingForPingResp = false;
+        contexts[ i ].lastPacketRxTime = nowMs;
+    }
+
+    /* The first half becomes due 5 seconds later. */
+    advance( 5000U, MQTT_KEEP_ALIVE_WHEEL_TICK_MS );
+    TEST_ASSERT_EQUAL( CONTEXT_COUNT, wheel.pingCount );
+    TEST_ASSERT_EQUAL( CONTEXT_COUNT / 2U, countPings( 0U, CONTEXT_COUNT / 2U ) );
+    TEST_ASSERT_EQUAL( 0U, errorCount );
+}
+
+/**
+ * @brief Contexts are pinged every keep-alive interval over hours of
+ * simulated time, across the wraps of every level of the wheel.
+ */
+void test_MQTTKeepAliveWheel_PeriodicPingsAcrossLevels( void )
+{
+    uint32_t interval;
+    size_t i;
+
+    addContexts( 4U );
+
+    for( interval = 1U; interval <= 720U; interval++ )
+    {
+        advance( KEEP_ALIVE_MS, 500U );
+
+        for( i = 0U; i < 4U; i++ )
+        {
+            TEST_ASSERT_EQUAL( interval, networkContexts[ i ].pingCount );
+
+            /* The PINGRESP arrives. */
+            contexts[ i ].waitingForPingResp = false;
+            contexts[ i ].lastPacketRxTime = nowMs;
+        }
+    }
+
+    TEST_ASSERT_EQUAL( 0U, errorCount );
+    TEST_ASSERT_EQUAL( 4U, wheel.entryCount );
+}
+
+/**
+ * @brief A missing PINGRESP is reported once its timeout passed, and the
+ * entry is no longer scheduled.
+ */
+void test_MQTTKeepAliveWheel_PingRespTimeout( void )
+{
+    addContexts( 2U );
+
+    advance( KEEP_ALIVE_MS, MQTT_KEEP_ALIVE_WHEEL_TICK_MS );
+    TEST_ASSERT_EQUAL( 2U, wheel.pingCount );
+
+    /* Only the second context receives its PINGRESP. */
+    contexts[ 1 ].waitingForPingResp = false;
+    contexts[ 1 ].lastPacketRxTime = nowMs;
+
+    advance( MQTT_PINGRESP_TIMEOUT_MS, MQTT_KEEP_ALIVE_WHEEL_TICK_MS );
+    TEST_ASSERT_EQUAL( 0U, errorCount );
+
+    advance( MQTT_KEEP_ALIVE_WHEEL_TICK_MS, MQTT_KEEP_ALIVE_WHEEL_TICK_MS );
+    TEST_ASSERT_EQUAL( 1U, errorCount );
+    TEST_ASSERT_EQUAL( MQTTKeepAliveTimeout, lastError );
+    TEST_ASSERT_EQUAL_PTR( &entries[ 0 ], pLastErrorEntry );
+    TEST_ASSERT_EQUAL( 1U, wheel.entryCount );
+
+    /* The second context is pinged again. */
+    advance( KEEP_ALIVE_MS - MQTT_PINGRESP_TIMEOUT_MS, MQTT_KEEP_ALIVE_WHEEL_TICK_MS );
+    TEST_ASSERT_EQUAL( 2U, networkContexts[ 1 ].pingCount );
+    TEST_ASSERT_EQUAL( 1U, errorCount );
+}
+
+/**
+ * @brief A failed PINGREQ is reported, and removed entries are not examined.
+ */
+void test_MQTTKeepAliveWheel_SendFailureAndRemove( void )
+{
+    addContexts( 3U );
+
+    networkContexts[ 0 ].failSend = true;
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTTKeepAliveWheel_Remove( &wheel, &entries[ 2 ] ) );
+    TEST_ASSERT_EQUAL( 2U, wheel.entryCount );
+
+    advance( KEEP_ALIVE_MS, MQTT_KEEP_ALIVE_WHEEL_TICK_MS );
+    TEST_ASSERT_EQUAL( 1U, errorCount );
+    TEST_ASSERT_EQUAL( MQTTSendFailed, lastError );
+    TEST_ASSERT_EQUAL_PTR( &entries[ 0 ], pLastErrorEntry );
+    TEST_ASSERT_EQUAL( 2U, wheel.examinedCount );
+    TEST_ASSERT_EQUAL( 1U, networkContexts[ 1 ].pingCount );
+    TEST_ASSERT_EQUAL( 0U, networkContexts[ 2 ].pingCount );
+
+    /* A context with keep-alive disabled is not scheduled. */
+    contexts[ 2 ].keepAliveIntervalSec = 0U;
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTTKeepAliveWheel_Add( &wheel, &entries[ 2 ] ) );
+    TEST_ASSERT_EQUAL( 1U, wheel.entryCount );
+}
+
+/**
+ * @brief The next timeout is the time until the wheel has entries to handle.
+ */
+void test_MQTTKeepAliveWheel_NextTimeout( void )
+{
+    addContexts( 1U );
+
+    /* The deadline is in the second level until the first one wraps. */
+    TEST_ASSERT_EQUAL( MQTT_KEEP_ALIVE_WHEEL_SLOTS * MQTT_KEEP_ALIVE_WHEEL_TICK_MS,
+                       MQTTKeepAliveWheel_GetNextTimeout( &wheel ) );
+
+    nowMs += 50U;
+    TEST_ASSERT_EQUAL( ( MQTT_KEEP_ALIVE_WHEEL_SLOTS * MQTT_KEEP_ALIVE_WHEEL_TICK_MS ) - 50U,
+                       MQTTKeepAliveWheel_GetNextTimeout( &wheel ) );
+
+    advance( ( MQTT_KEEP_ALIVE_WHEEL_SLOTS * MQTT_KEEP_ALIVE_WHEEL_TICK_MS ) - 50U,
+             ( MQTT_KEEP_ALIVE_WHEEL_SLOTS * MQTT_KEEP_ALIVE_WHEEL_TICK_MS ) - 50U );
+    TEST_ASSERT_EQUAL( KEEP_ALIVE_MS - ( MQTT_KEEP_ALIVE_WHEEL_SLOTS * MQTT_KEEP_ALIVE_WHEEL_TICK_MS ),
+                       MQTTKeepAliveWheel_GetNextTimeout( &wheel ) );
+
+    /* A deadline reached but not yet processed. */
+    nowMs += KEEP_ALIVE_MS;
+    TEST_ASSERT_EQUAL( 0U, MQTTKeepAliveWheel_GetNextTimeout( &wheel ) );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTTKeepAliveWheel_Remove( &wheel, &entries[ 0 ] ) );
+    TEST_ASSERT_EQUAL( MQTT_KEEP_ALIVE_WHEEL_NO_TIMEOUT, MQTTKeepAliveWheel_GetNextTimeout( &wheel ) );
+}
@@ -0,0 +1,647 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file core_mqtt_publish_queue_system_test.c
+ * @brief System tests of the publish queue with several producer threads and
+ * one owner thread, over a socket pair to a stand-in broker thread.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/socket.h>
+
+#include "unity.h"
+
+#include "core_mqtt_publish_queue.h"
+
+/**
+ * @brief Each compilation unit that uses the transport must define the
+ * NetworkContext struct. The transport of this test is a non-blocking
+ * socket.
+ */
+struct NetworkContext
+{
+    int socket;
+};
+
+/**
+ * @brief Number of producer threads.
+ */
+#define PRODUCER_COUNT            ( 4U )
+
+/**
+ * @brief Number of publishes submitted by each producer.
+ */
+#define PUBLISHES_PER_PRODUCER    ( 1000U )
+
+/**
+ * @brief Number of requests sent by the owner per drain.
+ */
+#define DRAIN_BATCH               ( 64U )
+
+/**
+ * @brief Number of outgoing QoS1 and QoS2 state records.
+ */
+#define OUTGOING_RECORD_COUNT     ( 64U )
+
+/**
+ * @brief Time to wait for all publishes to complete.
+ */
+#define WAIT_TIMEOUT_MS           ( 10000U )
+
+/**
+ * @brief A request with room for its payload: the producer index and a
+ * sequence number.
+ */
+typedef struct TestRequest
+{
+    MQTTPublishRequest_t request;
+    uint8_t payload[ 4 ];
+} TestRequest_t;
+
+/**
+ * @brief The context and queue under test, and the broker side.
+ */
+static MQTTContext_t context;
+static MQTTPublishQueue_t queue;
+static NetworkContext_t networkContext;
+static uint8_t buffer[ 256 ];
+static int brokerSocket;
+static TestRequest_t requests[ PRODUCER_COUNT ][ PUBLISHES_PER_PRODUCER ];
+static MQTTQoS_t publishQoS;
+#if ( MQTT_QOS0_ONLY == 0 )
+    static MQTTPubAckInfo_t outgoingRecords[ OUTGOING_RECORD_COUNT ];
+#endif
+
+/**
+ * @brief What the broker received.
+ */
+static uint32_t brokerPublishCount;
+static uint16_t brokerNextSequence[ PRODUCER_COUNT ];
+static bool brokerOutOfOrder;
+static bool brokerBadPacket;
+
+/**
+ * @brief What the completion callback saw. It runs on the owner thread.
+ */
+static uint32_t completedCount;
+static uint32_t failedCount;
+static MQTTStatus_t lastFailure;
+static bool duplicatePacketId;
+static uint8_t packetIdSeen[ 65536U / 8U ];
+
+/**
+ * @brief Stops the owner and broker threads.
+ */
+static bool stopThreads;
+
+/* ============================   UNITY FIXTURES ============================ */
+
+/* Called before each test method. */
+void setUp( void )
+{
+    ( void ) memset( &context, 0x00, sizeof( context ) );
+    ( void ) memset( &queue, 0x00, sizeof( queue ) );
+    ( void ) memset( requests, 0x00, sizeof( requests ) );
+    ( void ) memset( brokerNextSequence, 0x00, sizeof( brokerNextSequence ) );
+    ( void ) memset( packetIdSeen, 0x00, sizeof( packetIdSeen ) );
+
+    networkContext.socket = -1;
+    brokerSocket = -1;
+    publishQoS = MQTTQoS0;
+    brokerPublishCount = 0U;
+    brokerOutOfOrder = false;
+    brokerBadPacket = false;
+    completedCount = 0U;
+    failedCount = 0U;
+    lastFailure = MQTTSuccess;
+    duplicatePacketId = false;
+    stopThreads = false;
+}
+
+/* Called after each test method. */
+void tearDown( void )
+{
+    if( networkContext.socket >= 0 )
+    {
+        ( void ) close( networkContext.socket );
+    }
+
+    if( brokerSocket >= 0 )
+    {
+        ( void ) close( brokerSocket );
+    }
+}
+
+/* Called at the beginning of the whole suite. */
+void suiteSetUp()
+{
+}
+
+/* Called at the end of the whole suite. */
+int suiteTearDown( int numFailures )
+{
+    return numFailures;
+}
+
+/* ========================================================================== */
+
+static uint32_t getTimeMs( void )
+{
+    struct timespec now;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( uint32_t ) ( ( now.tv_sec * 1000 ) + ( now.tv_nsec / 1000000 ) );
+}
+
+static int32_t socketRecv( NetworkContext_t * pNetworkContext,
+                           void * pBuffer,
+                           size_t bytesToRecv )
+{
+    ssize_t result = recv( pNetworkContext->socket, pBuffer, bytesToRecv, MSG_DONTWAIT );
+    int32_t bytesReceived = -1;
+
+    if( result > 0 )
+    {
+        bytesReceived = ( int32_t ) result;
+    }
+    else if( ( result < 0 ) && ( ( errno == EAGAIN ) || ( errno == EWOULDBLOCK ) ) )
+    {
+        bytesReceived = 0;
+    }
+    else
+    {
+        /* Closed by the peer, or failed. */
+    }
+
+    return bytesReceived;
+}
+
+static int32_t socketSend( NetworkContext_t * pNetworkContext,
+                           const void * pBuffer,
+                           size_t bytesToSend )
+{
+    ssize_t result = send( pNetworkContext->socket, pBuffer, bytesToSend, MSG_DONTWAIT | MSG_NOSIGNAL );
+    int32_t bytesSent = -1;
+
+    if( result >= 0 )
+    {
+        bytesSent = ( int32_t ) result;
+    }
+    else if( ( errno == EAGAIN ) || ( errno == EWOULDBLOCK ) )
+    {
+        bytesSent = 0;
+    }
+    else
+    {
+        /* Failed. */
+    }
+
+    return bytesSent;
+}
+
+static void eventCallback( MQTTContext_t * pContext,
+                           MQTTPacketInfo_t * pPacketInfo,
+                           MQTTDeserializedInfo_t * pDeserializedInfo )
+{
+    ( void ) pContext;
+    ( void ) pPacketInfo;
+    ( void ) pDeserializedInfo;
+}
+
+static void completeCallback( MQTTPublishQueue_t * pQueue,
+                              MQTTPublishRequest_t * pRequest,
+                              MQTTStatus_t status )
+{
+    TEST_ASSERT_EQUAL_PTR( &queue, pQueue );
+
+    if( status != MQTTSuccess )
+    {
+        failedCount++;
+        lastFailure = status;
+    }
+    else if( pRequest->publishInfo.qos != MQTTQoS0 )
+    {
+        if( ( packetIdSeen[ pRequest->packetId / 8U ] & ( 1U << ( pRequest->packetId % 8U ) ) ) != 0U )
+        {
+            duplicatePacketId = true;
+        }
+
+        packetIdSeen[ pRequest->packetId / 8U ] |= ( uint8_t ) ( 1U << ( pRequest->packetId % 8U ) );
+    }
+    else
+    {
+        /* MISRA else. */
+    }
+
+    __atomic_add_fetch( &completedCount, 1U, __ATOMIC_SEQ_CST );
+}
+
+/* Read exactly length bytes from the broker socket, unless stopped. */
+static bool brokerRead( uint8_t * pBuffer,
+                        size_t length )
+{
+    size_t received = 0U;
+    ssize_t result;
+
+    while( ( received < length ) && ( __atomic_load_n( &stopThreads, __ATOMIC_SEQ_CST ) == false ) )
+    {
+        result = recv( brokerSocket, &pBuffer[ received ], length - received, MSG_DONTWAIT );
+
+        if( result > 0 )
+        {
+            received += ( size_t ) result;
+        }
+        else if( ( result < 0 ) && ( ( errno == EAGAIN ) || ( errno == EWOULDBLOCK ) ) )
+        {
+            ( void ) sched_yield();
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    return received == length;
+}
+
+/* Receive the publishes and check that each producer's arrive in order. */
+static void * brokerThread( void * pArgument )
+{
+    uint8_t header[ 2 ];
+    uint8_t packet[ 64 ];
+    uint8_t pubAck[ 4 ] = { 0x40U, 0x02U, 0x00U, 0x00U };
+    static const uint8_t pingResp[ 2 ] = { 0xD0U, 0x00U };
+    size_t offset;
+    uint8_t producer;
+    uint16_t sequence;
+
+    ( void ) pArgument;
+
+    while( brokerRead( header, sizeof( header ) ) == true )
+    {
+        /* Every packet of these tests is shorter than 128 bytes. */
+        if( ( header[ 1 ] > sizeof( packet ) ) ||
+            ( brokerRead( packet, header[ 1 ] ) == false ) )
+        {
+            break;
+        }
+
+        if( ( header[ 0 ] & 0xF0U ) == MQTT_PACKET_TYPE_PUBLISH )
+        {
+            /* Skip the topic, and the packet identifier of QoS1. */
+            offset = 2U + ( ( ( size_t ) packet[ 0 ] << 8 ) | packet[ 1 ] );
+
+            if( ( header[ 0 ] & 0x06U ) != 0U )
+            {
+                pubAck[ 2 ] = packet[ offset ];
+                pubAck[ 3 ] = packet[ offset + 1U ];
+                offset += 2U;
+                ( void ) send( brokerSocket, pubAck, sizeof( pubAck ), MSG_NOSIGNAL );
+            }
+
+            producer = packet[ offset ];
+            sequence = ( uint16_t ) ( ( ( uint16_t ) packet[ offset + 1U ] << 8 ) | packet[ offset + 2U ] );
+
+            if( producer >= PRODUCER_COUNT )
+            {
+                brokerBadPacket = true;
+            }
+            else if( sequence != brokerNextSequence[ producer ] )
+            {
+                brokerOutOfOrder = true;
+            }
+            else
+            {
+                brokerNextSequence[ producer ]++;
+            }
+
+            __atomic_add_fetch( &brokerPublishCount, 1U, __ATOMIC_SEQ_CST );
+        }
+        else if( header[ 0 ] == MQTT_PACKET_TYPE_PINGREQ )
+        {
+            ( void ) send( brokerSocket, pingResp, sizeof( pingResp ), MSG_NOSIGNAL );
+        }
+        else if( ( header[ 0 ] & 0xF0U ) != MQTT_PACKET_TYPE_DISCONNECT )
+        {
+            brokerBadPacket = true;
+        }
+        else
+        {
+            /* MISRA else. */
+        }
+    }
+
+    return NULL;
+}
+
+/* Submit PUBLISHES_PER_PRODUCER publishes. */
+static void * producerThread( void * pArgument )
+{
+    size_t producer = ( size_t ) pArgument;
+    TestRequest_t * pRequest;
+    size_t i;
+
+    for( i = 0U; i < PUBLISHES_PER_PRODUCER; i++ )
+    {
+        pRequest = &requests[ producer ][ i ];
+        pRequest->payload[ 0 ] = ( uint8_t ) producer;
+        pRequest->payload[ 1 ] = ( uint8_t ) ( i >> 8 );
+        pRequest->payload[ 2 ] = ( uint8_t ) i;
+        pRequest->request.publishInfo.qos = publishQoS;
+        pRequest->request.publishInfo.pTopicName = "queue";
+        pRequest->request.publishInfo.topicNameLength = 5U;
+        pRequest->request.publishInfo.pPayload = pRequest->payload;
+        pRequest->request.publishInfo.payloadLength = 3U;
+
+        TEST_ASSERT_EQUAL( MQTTSuccess, MQTTPublishQueue_Enqueue( &queue, &pRequest->request ) );
+    }
+
+    return NULL;
+}
+
+/* Drain the queue and process incoming packets until stopped. */
+static void * ownerThread( void * pArgument )
+{
+    MQTTStatus_t status;
+
+    ( void ) pArgument;
+
+    while( __atomic_load_n( &stopThreads, __ATOMIC_SEQ_CST ) == false )
+    {
+        TEST_ASSERT_EQUAL( MQTTSuccess, MQTTPublishQueue_Drain( &queue, DRAIN_BATCH, NULL ) );
+
+        status = MQTT_ProcessLoop( &context );
+        TEST_ASSERT_TRUE( ( status == MQTTSuccess ) || ( status == MQTTNeedMoreBytes ) );
+
+        if( MQTTPublishQueue_IsPending( &queue ) == false )
+        {
+            ( void ) sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+/* Connect the context over a socket pair and initialize the queue. */
+static void connectContext( void )
+{
+    static const uint8_t connack[] = { 0x20U, 0x02U, 0x00U, 0x00U };
+    TransportInterface_t transport;
+    MQTTFixedBuffer_t networkBuffer;
+    MQTTConnectInfo_t connectInfo;
+    bool sessionPresent = false;
+    uint8_t connect[ 64 ];
+    int sockets[ 2 ];
+
+    TEST_ASSERT_EQUAL( 0, socketpair( AF_UNIX, SOCK_STREAM, 0, sockets ) );
+    networkContext.socket = sockets[ 0 ];
+    brokerSocket = sockets[ 1 ];
+
+    ( void ) memset( &transport, 0x00, sizeof( transport ) );
+    transport.pNetworkContext = &networkContext;
+    transport.recv = socketRecv;
+    transport.send = socketSend;
+    networkBuffer.pBuffer = buffer;
+    networkBuffer.size = sizeof( buffer );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Init( &context, &transport, getTimeMs,
+                                               eventCallback, &networkBuffer ) );
+    #if ( MQTT_QOS0_ONLY == 0 )
+        TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_InitStatefulQoS( &context, outgoingRecords,
+                                                              OUTGOING_RECORD_COUNT, NULL, 0U ) );
+    #endif
+
+    ( void ) memset( &connectInfo, 0x00, sizeof( connectInfo ) );
+    connectInfo.cleanSession = true;
+    connectInfo.pClientIdentifier = "queue";
+    connectInfo.clientIdentifierLength = 5U;
+    connectInfo.keepAliveSeconds = 60U;
+
+    /* The CONNACK is waiting before the CONNECT is sent. */
+    TEST_ASSERT_EQUAL( sizeof( connack ), write( brokerSocket, connack, sizeof( connack ) ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Connect( &context, &connectInfo, NULL, 1000U, &sessionPresent ) );
+    TEST_ASSERT_GREATER_THAN( 0, recv( brokerSocket, connect, sizeof( connect ), MSG_DONTWAIT ) );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTTPublishQueue_Init( &queue, &context, completeCallback ) );
+}
+
+/* Run the producers, the owner and the broker until every publish completed. */
+static void runProducers( void )
+{
+    pthread_t producers[ PRODUCER_COUNT ];
+    pthread_t owner;
+    pthread_t broker;
+    uint32_t start;
+    size_t i;
+
+    TEST_ASSERT_EQUAL( 0, pthread_create( &broker, NULL, brokerThread, NULL ) );
+    TEST_ASSERT_EQUAL( 0, pthread_create( &owner, NULL, ownerThread, NULL ) );
+
+    for( i = 0U; i < PRODUCER_COUNT; i++ )
+    {
+        TEST_ASSERT_EQUAL( 0, pthread_create( &producers[ i ], NULL, producerThread, ( void * ) i ) );
+    }
+
+    for( i = 0U; i < PRODUCER_COUNT; i++ )
+    {
+        ( void ) pthread_join( producers[ i ], NULL );
+    }
+
+    start = getTimeMs();
+
+    while( ( ( __atomic_load_n( &completedCount, __ATOMIC_SEQ_CST ) < ( PRODUCER_COUNT * PUBLISHES_PER_PRODUCER ) ) ||
+             ( __atomic_load_n( &brokerPublishCount, __ATOMIC_SEQ_CST ) < ( PRODUCER_COUNT * PUBLISHES_PER_PRODUCER ) ) ) &&
+           ( ( getTimeMs() - start ) < WAIT_TIMEOUT_MS ) )
+    {
+        ( void ) sched_yield();
+    }
+
+    __atomic_store_n( &stopThreads, true, __ATOMIC_SEQ_CST );
+    ( void ) pthread_join( owner, NULL );
+    ( void ) pthread_join( broker, NULL );
+}
+
+/* Run the broker until it has received count publishes. */
+static bool waitForBroker( uint32_t count )
+{
+    pthread_t broker;
+    uint32_t start = getTimeMs();
+
+    TEST_ASSERT_EQUAL( 0, pthread_create( &broker, NULL, brokerThread, NULL ) );
+
+    while( ( __atomic_load_n( &brokerPublishCount, __ATOMIC_SEQ_CST ) < count ) &&
+           ( ( getTimeMs() - start ) < WAIT_TIMEOUT_MS ) )
+    {
+        ( void ) sched_yield();
+    }
+
+    __atomic_store_n( &stopThreads, true, __ATOMIC_SEQ_CST );
+    ( void ) pthread_join( broker, NULL );
+
+    return brokerPublishCount >= count;
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Invalid parameters are rejected.
+ */
+void test_MQTTPublishQueue_InvalidParams( void )
+{
+    MQTTPublishRequest_t request;
+    size_t sentCount = 1U;
+
+    ( void ) memset( &request, 0x00, sizeof( request ) );
+
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTTPublishQueue_Init( NULL, &context, completeCallback ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTTPublishQueue_Init( &queue, NULL, completeCallback ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTTPublishQueue_Init( &queue, &context, NULL ) );
+
+    /* The queue is not initialized. */
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTTPublishQueue_Enqueue( &queue, &request ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTTPublishQueue_Drain( &queue, 0U, &sentCount ) );
+    TEST_ASSERT_EQUAL( 0U, sentCount );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTTPublishQueue_Init( &queue, &context, completeCallback ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTTPublishQueue_Enqueue( &queue, NULL ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTTPublishQueue_Enqueue( NULL, &request ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTTPublishQueue_Drain( NULL, 0U, NULL ) );
+    TEST_ASSERT_FALSE( MQTTPublishQueue_IsPending( NULL ) );
+    TEST_ASSERT_FALSE( MQTTPublishQueue_IsPending( &queue ) );
+}
+
+/**
+ * @brief Requests are sent in the order each producer enqueued them, and
+ * drains stop at the batch size.
+ */
+void test_MQTTPublishQueue_DrainInOrderAndInBatches( void )
+{
+    size_t sentCount = 0U;
+    size_t i;
+
+    connectContext();
+
+    for( i = 0U; i < 5U; i++ )
+    {
+        requests[ 0 ][ i ].payload[ 2 ] = ( uint8_t ) i;
+        requests[ 0 ][ i ].request.publishInfo.pTopicName = "queue";
+        requests[ 0 ][ i ].request.publishInfo.topicNameLength = 5U;
+        requests[ 0 ][ i ].request.publishInfo.pPayload = requests[ 0 ][ i ].payload;
+        requests[ 0 ][ i ].request.publishInfo.payloadLength = 3U;
+        TEST_ASSERT_EQUAL( MQTTSuccess, MQTTPublishQueue_Enqueue( &queue, &requests[ 0 ][ i ].request ) );
+    }
+
+    TEST_ASSERT_TRUE( MQTTPublishQueue_IsPending( &queue ) );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTTPublishQueue_Drain( &queue, 2U, &sentCount ) );
+    TEST_ASSERT_EQUAL( 2U, sentCount );
+    TEST_ASSERT_TRUE( MQTTPublishQueue_IsPending( &queue ) );
+
+    /* A request submitted meanwhile goes behind the pending ones. */
+    requests[ 0 ][ 5 ].payload[ 2 ] = 5U;
+    requests[ 0 ][ 5 ].request.publishInfo = requests[ 0 ][ 0 ].request.publishInfo;
+    requests[ 0 ][ 5 ].request.publishInfo.pPayload = requests[ 0 ][ 5 ].payload;
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTTPublishQueue_Enqueue( &queue, &requests[ 0 ][ 5 ].request ) );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTTPublishQueue_Drain( &queue, 0U, &sentCount ) );
+    TEST_ASSERT_EQUAL( 4U, sentCount );
+    TEST_ASSERT_FALSE( MQTTPublishQueue_IsPending( &queue ) );
+    TEST_ASSERT_EQUAL( 6U, completedCount );
+    TEST_ASSERT_EQUAL( 0U, failedCount );
+
+    /* The broker reads the publishes in the order they were submitted. */
+    TEST_ASSERT_TRUE( waitForBroker( 6U ) );
+    TEST_ASSERT_FALSE( brokerOutOfOrder );
+    TEST_ASSERT_FALSE( brokerBadPacket );
+}
+
+/**
+ * @brief Publishes of concurrent producers all arrive, each producer's in
+ * order, with only the owner thread writing to the socket.
+ */
+void test_MQTTPublishQueue_ConcurrentProducersQoS0( void )
+{
+    connectContext();
+    runProducers();
+
+    TEST_ASSERT_EQUAL( PRODUCER_COUNT * PUBLISHES_PER_PRODUCER, completedCount );
+    TEST_ASSERT_EQUAL( PRODUCER_COUNT * PUBLISHES_PER_PRODUCER, brokerPublishCount );
+    TEST_ASSERT_EQUAL( 0U, failedCount );
+    TEST_ASSERT_FALSE( brokerOutOfOrder );
+    TEST_ASSERT_FALSE( brokerBadPacket );
+}
+
+/**
+ * @brief QoS1 requests get packet identifiers from the owner thread, and
+ * their acknowledgements are processed between drains.
+ */
+void test_MQTTPublishQueue_ConcurrentProducersQoS1( void )
+{
+    #if ( MQTT_QOS0_ONLY == 0 )
+        publishQoS = MQTTQoS1;
+        connectContext();
+        runProducers();
+
+        TEST_ASSERT_EQUAL( PRODUCER_COUNT * PUBLISHES_PER_PRODUCER, completedCount );
+        TEST_ASSERT_EQUAL( PRODUCER_COUNT * PUBLISHES_PER_PRODUCER, brokerPublishCount );
+        TEST_ASSERT_EQUAL( 0U, failedCount );
+        TEST_ASSERT_FALSE( brokerOutOfOrder );
+        TEST_ASSERT_FALSE( brokerBadPacket );
+        TEST_ASSERT_FALSE( duplicatePacketId );
+    #else
+        TEST_IGNORE_MESSAGE( "QoS1 is compiled out." );
+    #endif
+}
+
+/**
+ * @brief Requests drained after a disconnect complete with an error.
+ */
+void test_MQTTPublishQueue_DrainAfterDisconnect( void )
+{
+    size_t sentCount = 0U;
+
+    connectContext();
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Disconnect( &context ) );
+
+    requests[ 0 ][ 0 ].request.publishInfo.pTopicName = "queue";
+    requests[ 0 ][ 0 ].request.publishInfo.topicNameLength = 5U;
+    requests[ 1 ][ 0 ].request.publishInfo = requests[ 0 ][ 0 ].request.publishInfo;
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTTPublishQueue_Enqueue( &queue, &requests[ 0 ][ 0 ].request ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTTPublishQueue_Enqueue( &queue, &requests[ 1 ][ 0 ].request ) );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTTPublishQueue_Drain( &queue, 0U, &sentCount ) );
+    TEST_ASSERT_EQUAL( 2U, sentCount );
+    TEST_ASSERT_EQUAL( 2U, failedCount );
+    TEST_ASSERT_EQUAL( MQTTStatusNotConnected, lastFailure );
+}
@@ -0,0 +1,574 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file core_mqtt_reactor_system_test.c
+ * @brief System tests of the reactor with connected contexts over socket
+ * pairs, with the test acting as the broker on the other end.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/socket.h>
+
+#include "unity.h"
+
+#include "core_mqtt_reactor.h"
+
+/**
+ * @brief Each compilation unit that uses the transport must define the
+ * NetworkContext struct. The transport of this test is a non-blocking
+ * socket.
+ */
+struct NetworkContext
+{
+    int socket;
+};
+
+/**
+ * @brief Largest number of connections of a test.
+ */
+#define CONNECTION_COUNT          ( 256U )
+
+/**
+ * @brief Largest number of workers of a test.
+ */
+#define WORKER_COUNT              ( 4U )
+
+/**
+ * @brief Publishes sent to the hot connection of the fairness test.
+ */
+#define HOT_PUBLISH_COUNT         ( 2000U )
+
+/**
+ * @brief Time to wait for the reactor to deliver packets.
+ */
+#define WAIT_TIMEOUT_MS           ( 5000U )
+
+/**
+ * @brief Time a callback of the stealing test waits for the other one.
+ */
+#define STEAL_TIMEOUT_MS          ( 2000U )
+
+/**
+ * @brief A QoS 0 PUBLISH on topic "t" with payload "x".
+ */
+static const uint8_t publishPacket[] = { 0x30U, 0x04U, 0x00U, 0x01U, 0x74U, 0x78U };
+
+/**
+ * @brief The reactor under test, and the broker side of its connections.
+ */
+static MQTTReactor_t reactor;
+static MQTTReactorWorker_t workers[ WORKER_COUNT ];
+static MQTTReactorConnection_t connections[ CONNECTION_COUNT ];
+static MQTTContext_t contexts[ CONNECTION_COUNT ];
+static NetworkContext_t networkContexts[ CONNECTION_COUNT ];
+static uint8_t buffers[ CONNECTION_COUNT ][ 64 ];
+static int brokerSockets[ CONNECTION_COUNT ];
+static size_t connectionCount;
+static bool reactorInitialized;
+
+/**
+ * @brief What the callbacks saw, updated by the workers.
+ */
+static uint32_t publishCounts[ CONNECTION_COUNT ];
+static uint32_t totalPublishCount;
+static uint32_t errorCount;
+static MQTTReactorConnection_t * pFailedConnection;
+static MQTTStatus_t failedStatus;
+
+/**
+ * @brief Set by the stealing test: whether the first publish on each
+ * connection waits for the publish on the other one.
+ */
+static bool waitForPeer;
+static bool peerTimedOut;
+
+/**
+ * @brief Publishes counted on the hot connection when the cold connection
+ * received its publish.
+ */
+static uint32_t hotCountAtCold;
+
+/* ============================   UNITY FIXTURES ============================ */
+
+/* Called before each test method. */
+void setUp( void )
+{
+    size_t i;
+
+    ( void ) memset( &reactor, 0x00, sizeof( reactor ) );
+    ( void ) memset( connections, 0x00, sizeof( connections ) );
+    ( void ) memset( contexts, 0x00, sizeof( contexts ) );
+    ( void ) memset( publishCounts, 0x00, sizeof( publishCounts ) );
+
+    for( i = 0U; i < CONNECTION_COUNT; i++ )
+    {
+        networkContexts[ i ].socket = -1;
+        brokerSockets[ i ] = -1;
+    }
+
+    connectionCount = 0U;
+    reactorInitialized = false;
+    totalPublishCount = 0U;
+    errorCount = 0U;
+    pFailedConnection = NULL;
+    failedStatus = MQTTSuccess;
+    waitForPeer = false;
+    peerTimedOut = false;
+    hotCountAtCold = HOT_PUBLISH_COUNT;
+}
+
+/* Called after each test method. */
+void tearDown( void )
+{
+    size_t i;
+
+    if( reactorInitialized == true )
+    {
+        ( void ) MQTTReactor_Stop( &reactor );
+
+        for( i = 0U; i < connectionCount; i++ )
+        {
+            if( connections[ i ].pOwner != NULL )
+            {
+                ( void ) MQTTReactor_Remove( &reactor, &connections[ i ] );
+            }
+        }
+
+        ( void ) MQTTReactor_Cleanup( &reactor );
+    }
+
+    for( i = 0U; i < CONNECTION_COUNT; i++ )
+    {
+        if( networkContexts[ i ].socket >= 0 )
+        {
+            ( void ) close( networkContexts[ i ].socket );
+        }
+
+        if( brokerSockets[ i ] >= 0 )
+        {
+            ( void ) close( brokerSockets[ i ] );
+        }
+    }
+}
+
+/* Called at the beginning of the whole suite. */
+void suiteSetUp()
+{
+}
+
+/* Called at the end of the whole suite. */
+int suiteTearDown( int numFailures )
+{
+    return numFailures;
+}
+
+/* ========================================================================== */
+
+static uint32_t getTimeMs( void )
+{
+    struct timespec now;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( uint32_t ) ( ( now.tv_sec * 1000 ) + ( now.tv_nsec / 1000000 ) );
+}
+
+static void sleepMs( uint32_t milliseconds )
+{
+    struct timespec pause;
+
+    pause.tv_sec = ( time_t ) ( milliseconds / 1000U );
+    pause.tv_nsec = ( long ) ( milliseconds % 1000U ) * 1000000L;
+    ( void ) nanosleep( &pause, NULL );
+}
+
+static int32_t socketRecv( NetworkContext_t * pNetworkContext,
+                           void * pBuffer,
+                           size_t bytesToRecv )
+{
+    ssize_t result = recv( pNetworkContext->socket, pBuffer, bytesToRecv, MSG_DONTWAIT );
+    int32_t bytesReceived = -1;
+
+    if( result > 0 )
+    {
+        bytesReceived = ( int32_t ) result;
+    }
+    else if( ( result < 0 ) && ( ( errno == EAGAIN ) || ( errno == EWOULDBLOCK ) ) )
+    {
+        bytesReceived = 0;
+    }
+    else
+    {
+        /* Closed by the peer, or failed. */
+    }
+
+    return bytesReceived;
+}
+
+static int32_t socketSend( NetworkContext_t * pNetworkContext,
+                           const void * pBuffer,
+                           size_t bytesToSend )
+{
+    ssize_t result = send( pNetworkContext->socket, pBuffer, bytesToSend, MSG_DONTWAIT | MSG_NOSIGNAL );
+    int32_t bytesSent = -1;
+
+    if( result >= 0 )
+    {
+        bytesSent = ( int32_t ) result;
+    }
+    else if( ( errno == EAGAIN ) || ( errno == EWOULDBLOCK ) )
+    {
+        bytesSent = 0;
+    }
+    else
+    {
+        /* Failed. */
+    }
+
+    return bytesSent;
+}
+
+static size_t connectionIndex( const MQTTContext_t * pContext )
+{
+    return ( size_t ) ( pContext - contexts );
+}
+
+static bool waitForCount( const uint32_t * pCount,
+                          uint32_t expected )
+{
+    uint32_t start = getTimeMs();
+
+    while( ( __atomic_load_n( pCount, __ATOMIC_SEQ_CST ) < expected ) &&
+           ( ( getTimeMs() - start ) < WAIT_TIMEOUT_MS ) )
+    {
+        sleepMs( 1U );
+    }
+
+    return __atomic_load_n( pCount, __ATOMIC_SEQ_CST ) >= expected;
+}
+
+static void eventCallback( MQTTContext_t * pContext,
+                           MQTTPacketInfo_t * pPacketInfo,
+                           MQTTDeserializedInfo_t * pDeserializedInfo )
+{
+    size_t index = connectionIndex( pContext );
+    uint32_t start = 0U;
+
+    ( void ) pDeserializedInfo;
+
+    if( ( pPacketInfo->type & 0xF0U ) == MQTT_PACKET_TYPE_PUBLISH )
+    {
+        /* In the fairness test, connection 1 is the cold one. */
+        if( ( index == 1U ) && ( __atomic_load_n( &publishCounts[ 1 ], __ATOMIC_SEQ_CST ) == 0U ) )
+        {
+            hotCountAtCold = __atomic_load_n( &publishCounts[ 0 ], __ATOMIC_SEQ_CST );
+        }
+
+        __atomic_add_fetch( &publishCounts[ index ], 1U, __ATOMIC_SEQ_CST );
+        __atomic_add_fetch( &totalPublishCount, 1U, __ATOMIC_SEQ_CST );
+
+        if( waitForPeer == true )
+        {
+            /* Connections 0 and 2 share a shard. The other one can only be
+             * processed meanwhile if the idle worker steals it. */
+            start = getTimeMs();
+
+            while( ( __atomic_load_n( &publishCounts[ 2U - index ], __ATOMIC_SEQ_CST ) == 0U ) &&
+                   ( ( getTimeMs() - start ) < STEAL_TIMEOUT_MS ) )
+            {
+                sleepMs( 1U );
+            }
+
+            if( __atomic_load_n( &publishCounts[ 2U - index ], __ATOMIC_SEQ_CST ) == 0U )
+            {
+                peerTimedOut = true;
+            }
+        }
+    }
+}
+
+static void errorCallback( MQTTReactor_t * pReactor,
+                           MQTTReactorConnection_t * pConnection,
+                           MQTTStatus_t status )
+{
+    TEST_ASSERT_EQUAL_PTR( &reactor, pReactor );
+
+    pFailedConnection = pConnection;
+    failedStatus = status;
+    __atomic_add_fetch( &errorCount, 1U, __ATOMIC_SEQ_CST );
+}
+
+/* Initialize the reactor and connect count contexts, one per socket pair. */
+static void setUpConnections( size_t workerCount,
+                              size_t count,
+                              uint16_t keepAliveSeconds )
+{
+    static const uint8_t connack[] = { 0x20U, 0x02U, 0x00U, 0x00U };
+    TransportInterface_t transport;
+    MQTTFixedBuffer_t networkBuffer;
+    MQTTConnectInfo_t connectInfo;
+    bool sessionPresent = false;
+    int sockets[ 2 ];
+    size_t i;
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTTReactor_Init( &reactor, workers, workerCount,
+                                                      getTimeMs, errorCallback ) );
+    reactorInitialized = true;
+
+    ( void ) memset( &connectInfo, 0x00, sizeof( connectInfo ) );
+    connectInfo.cleanSession = true;
+    connectInfo.pClientIdentifier = "reactor";
+    connectInfo.clientIdentifierLength = 7U;
+    connectInfo.keepAliveSeconds = keepAliveSeconds;
+
+    for( i = 0U; i < count; i++ )
+    {
+        TEST_ASSERT_EQUAL( 0, socketpair( AF_UNIX, SOCK_STREAM, 0, sockets ) );
+        networkContexts[ i ].socket = sockets[ 0 ];
+        brokerSockets[ i ] = sockets[ 1 ];
+
+        ( void ) memset( &transport, 0x00, sizeof( transport ) );
+        transport.pNetworkContext = &networkContexts[ i ];
+        transport.recv = socketRecv;
+        transport.send = socketSend;
+        networkBuffer.pBuffer = buffers[ i ];
+        networkBuffer.size = sizeof( buffers[ i ] );
+
+        TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Init( &contexts[ i ], &transport, getTimeMs,
+                                                   eventCallback, &networkBuffer ) );
+
+        /* The CONNACK is waiting before the CONNECT is sent. */
+        TEST_ASSERT_EQUAL( sizeof( connack ), write( brokerSockets[ i ], connack, sizeof( connack ) ) );
+        TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Connect( &contexts[ i ], &connectInfo, NULL,
+                                                      1000U, &sessionPresent ) );
+
+        connections[ i ].pContext = &contexts[ i ];
+        connections[ i ].socketDescriptor = sockets[ 0 ];
+        TEST_ASSERT_EQUAL( MQTTSuccess, MQTTReactor_Add( &reactor, &connections[ i ] ) );
+        connectionCount++;
+    }
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Invalid parameters are rejected.
+ */
+void test_MQTTReactor_InvalidParams( void )
+{
+    MQTTReactorConnection_t connection;
+
+    ( void ) memset( &connection, 0x00, sizeof( connection ) );
+
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTTReactor_Init( NULL, workers, 1U, getTimeMs, NULL ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTTReactor_Init( &reactor, NULL, 1U, getTimeMs, NULL ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTTReactor_Init( &reactor, workers, 0U, getTimeMs, NULL ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTTReactor_Init( &reactor, workers, 1U, NULL, NULL ) );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTTReactor_Init( &reactor, workers, 1U, getTimeMs, NULL ) );
+    reactorInitialized = true;
+
+    /* The connection has no context. */
+    connection.socketDescriptor = -1;
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTTReactor_Add( &reactor, &connection ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTTReactor_Add( NULL, &connection ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTTReactor_Remove( &reactor, &connection ) );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTTReactor_Start( &reactor ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTTReactor_Start( &reactor ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTTReactor_Cleanup( &reactor ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTTReactor_Stop( &reactor ) );
+}
+
+/**
+ * @brief Every connection of every shard receives its packets.
+ */
+void test_MQTTReactor_ManyConnections( void )
+{
+    size_t i;
+    uint32_t processed = 0U;
+
+    setUpConnections( WORKER_COUNT, CONNECTION_COUNT, 60U );
+
+    /* The connections are spread evenly. */
+    for( i = 0U; i < WORKER_COUNT; i++ )
+    {
+        TEST_ASSERT_EQUAL( CONNECTION_COUNT / WORKER_COUNT, workers[ i ].connectionCount );
+    }
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTTReactor_Start( &reactor ) );
+
+    for( i = 0U; i < CONNECTION_COUNT; i++ )
+    {
+        TEST_ASSERT_EQUAL( sizeof( publishPacket ),
+                           write( brokerSockets[ i ], publishPacket, sizeof( publishPacket ) ) );
+    }
+
+    TEST_ASSERT_TRUE( waitForCount( &totalPublishCount, CONNECTION_COUNT ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTTReactor_Stop( &reactor ) );
+
+    for( i = 0U; i < CONNECTION_COUNT; i++ )
+    {
+        TEST_ASSERT_EQUAL( 1U, publishCounts[ i ] );
+    }
+
+    for( i = 0U; i < WORKER_COUNT; i++ )
+    {
+        processed += ( uint32_t ) workers[ i ].processedCount;
+    }
+
+    TEST_ASSERT_GREATER_OR_EQUAL( CONNECTION_COUNT, processed );
+    TEST_ASSERT_EQUAL( 0U, errorCount );
+}
+
+/**
+ * @brief An idle worker steals a task queued behind a slow callback on
+ * another shard.
+ */
+void test_MQTTReactor_StealsFromBusyShard( void )
+{
+    setUpConnections( 2U, 3U, 60U );
+
+    /* The fewest connections win, and ties go to the first worker. */
+    TEST_ASSERT_EQUAL_PTR( &workers[ 0 ], connections[ 0 ].pOwner );
+    TEST_ASSERT_EQUAL_PTR( &workers[ 1 ], connections[ 1 ].pOwner );
+    TEST_ASSERT_EQUAL_PTR( &workers[ 0 ], connections[ 2 ].pOwner );
+
+    /* Both connections of the first shard are ready when it first waits. */
+    waitForPeer = true;
+    TEST_ASSERT_EQUAL( sizeof( publishPacket ),
+                       write( brokerSockets[ 0 ], publishPacket, sizeof( publishPacket ) ) );
+    TEST_ASSERT_EQUAL( sizeof( publishPacket ),
+                       write( brokerSockets[ 2 ], publishPacket, sizeof( publishPacket ) ) );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTTReactor_Start( &reactor ) );
+    TEST_ASSERT_TRUE( waitForCount( &totalPublishCount, 2U ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTTReactor_Stop( &reactor ) );
+
+    TEST_ASSERT_FALSE( peerTimedOut );
+    TEST_ASSERT_EQUAL( 1U, publishCounts[ 0 ] );
+    TEST_ASSERT_EQUAL( 1U, publishCounts[ 2 ] );
+    TEST_ASSERT_GREATER_THAN( 0U, ( uint32_t ) workers[ 1 ].stolenCount );
+}
+
+/**
+ * @brief A connection with a backlog of packets does not hold its worker
+ * until the backlog is drained.
+ */
+void test_MQTTReactor_HotConnectionDoesNotStarveShard( void )
+{
+    uint8_t backlog[ HOT_PUBLISH_COUNT * sizeof( publishPacket ) ];
+    size_t i;
+
+    setUpConnections( 1U, 2U, 60U );
+
+    for( i = 0U; i < HOT_PUBLISH_COUNT; i++ )
+    {
+        ( void ) memcpy( &backlog[ i * sizeof( publishPacket ) ], publishPacket, sizeof( publishPacket ) );
+    }
+
+    TEST_ASSERT_EQUAL( sizeof( backlog ), write( brokerSockets[ 0 ], backlog, sizeof( backlog ) ) );
+    TEST_ASSERT_EQUAL( sizeof( publishPacket ),
+                       write( brokerSockets[ 1 ], publishPacket, sizeof( publishPacket ) ) );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTTReactor_Start( &reactor ) );
+    TEST_ASSERT_TRUE( waitForCount( &totalPublishCount, HOT_PUBLISH_COUNT + 1U ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTTReactor_Stop( &reactor ) );
+
+    TEST_ASSERT_EQUAL( HOT_PUBLISH_COUNT, publishCounts[ 0 ] );
+    TEST_ASSERT_EQUAL( 1U, publishCounts[ 1 ] );
+
+    /* The cold connection was served within the first few tasks. */
+    TEST_ASSERT_LESS_THAN( 16U, hotCountAtCold );
+}
+
+/**
+ * @brief Idle connections are processed periodically, which sends PINGREQs.
+ */
+void test_MQTTReactor_KeepAlive( void )
+{
+    static const uint8_t pingResp[] = { 0xD0U, 0x00U };
+    struct pollfd pollDescriptor;
+    uint8_t packet[ 64 ];
+    ssize_t received = 0;
+
+    setUpConnections( 1U, 1U, 1U );
+
+    /* Discard the CONNECT. */
+    TEST_ASSERT_GREATER_THAN( 0, recv( brokerSockets[ 0 ], packet, sizeof( packet ), MSG_DONTWAIT ) );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTTReactor_Start( &reactor ) );
+
+    pollDescriptor.fd = brokerSockets[ 0 ];
+    pollDescriptor.events = POLLIN;
+    pollDescriptor.revents = 0;
+    TEST_ASSERT_EQUAL( 1, poll( &pollDescriptor, 1U, ( int ) WAIT_TIMEOUT_MS ) );
+
+    received = recv( brokerSockets[ 0 ], packet, sizeof( packet ), 0 );
+    TEST_ASSERT_EQUAL( 2, received );
+    TEST_ASSERT_EQUAL_HEX8( 0xC0U, packet[ 0 ] );
+
+    TEST_ASSERT_EQUAL( sizeof( pingResp ), write( brokerSockets[ 0 ], pingResp, sizeof( pingResp ) ) );
+    sleepMs( 2U * MQTT_REACTOR_TICK_MS );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTTReactor_Stop( &reactor ) );
+    TEST_ASSERT_FALSE( contexts[ 0 ].waitingForPingResp );
+    TEST_ASSERT_EQUAL( 0U, errorCount );
+}
+
+/**
+ * @brief A connection closed by the peer is reported and can be removed
+ * while the other connections keep running.
+ */
+void test_MQTTReactor_PeerClose( void )
+{
+    setUpConnections( 2U, 2U, 60U );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTTReactor_Start( &reactor ) );
+
+    ( void ) close( brokerSockets[ 0 ] );
+    brokerSockets[ 0 ] = -1;
+
+    TEST_ASSERT_TRUE( waitForCount( &errorCount, 1U ) );
+    TEST_ASSERT_EQUAL_PTR( &connections[ 0 ], pFailedConnection );
+    TEST_ASSERT_EQUAL( MQTTRecvFailed, failedStatus );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTTReactor_Remove( &reactor, &connections[ 0 ] ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTTReactor_Remove( &reactor, &connections[ 0 ] ) );
+    TEST_ASSERT_EQUAL( 1U, workers[ 0 ].connectionCount + workers[ 1 ].connectionCount );
+
+    /* The other connection is still served. */
+    TEST_ASSERT_EQUAL( sizeof( publishPacket ),
+                       write( brokerSockets[ 1 ], publishPacket, sizeof( publishPacket ) ) );
+    TEST_ASSERT_TRUE( waitForCount( &publishCounts[ 1 ], 1U ) );
+    TEST_ASSERT_EQUAL( 1U, errorCount );
+}
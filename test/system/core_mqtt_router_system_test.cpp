@@ -0,0 +1,259 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file core_mqtt_router_system_test.cpp
+ * @brief System tests of the compile-time topic router, checked against
+ * #MQTT_MatchTopic.
+ */
+
+#include <cstring>
+
+#include "core_mqtt_router.hpp"
+
+extern "C" {
+#include "unity.h"
+}
+
+/* Topic filters are validated at compile time. */
+static_assert( coremqtt::isValidTopicFilter( coremqtt::TopicFilter( "a/+/b/#" ) ) );
+static_assert( coremqtt::isValidTopicFilter( coremqtt::TopicFilter( "#" ) ) );
+static_assert( !coremqtt::isValidTopicFilter( coremqtt::TopicFilter( "" ) ) );
+static_assert( !coremqtt::isValidTopicFilter( coremqtt::TopicFilter( "a/#/b" ) ) );
+static_assert( !coremqtt::isValidTopicFilter( coremqtt::TopicFilter( "a/b+" ) ) );
+static_assert( !coremqtt::isValidTopicFilter( coremqtt::TopicFilter( "a#" ) ) );
+
+/**
+ * @brief The handler of each route records its index.
+ */
+static int handledRoute;
+
+template< int Index >
+static void handler( MQTTContext_t * pContext,
+                     MQTTPacketInfo_t * pPacketInfo,
+                     MQTTDeserializedInfo_t * pDeserializedInfo )
+{
+    ( void ) pContext;
+    ( void ) pPacketInfo;
+    ( void ) pDeserializedInfo;
+
+    handledRoute = Index;
+}
+
+/**
+ * @brief The topic filters of the router, in the order of its routes.
+ */
+static const char * const filters[] =
+{
+    "sensors/+/temperature",
+    "sensors/#",
+    "sensors/kitchen/temperature",
+    "+/+/humidity",
+    "actuators/+",
+    "actuators/door",
+    "#",
+    "+",
+    "a/b/c/d",
+    "a/+/c/#",
+    "a/b/+/d"
+};
+
+using TestRouter = coremqtt::Router< coremqtt::Route< "sensors/+/temperature", handler< 0 > >,
+                                     coremqtt::Route< "sensors/#", handler< 1 > >,
+                                     coremqtt::Route< "sensors/kitchen/temperature", handler< 2 > >,
+                                     coremqtt::Route< "+/+/humidity", handler< 3 > >,
+                                     coremqtt::Route< "actuators/+", handler< 4 > >,
+                                     coremqtt::Route< "actuators/door", handler< 5 > >,
+                                     coremqtt::Route< "#", handler< 6 > >,
+                                     coremqtt::Route< "+", handler< 7 > >,
+                                     coremqtt::Route< "a/b/c/d", handler< 8 > >,
+                                     coremqtt::Route< "a/+/c/#", handler< 9 > >,
+                                     coremqtt::Route< "a/b/+/d", handler< 10 > > >;
+
+using WildcardFreeRouter = coremqtt::Router< coremqtt::Route< "a/b", handler< 0 > >,
+                                             coremqtt::Route< "a/c", handler< 1 > > >;
+
+/**
+ * @brief Topic names of the tests.
+ */
+static const char * const topics[] =
+{
+    "sensors/kitchen/temperature",
+    "sensors/hall/temperature",
+    "sensors/hall/humidity",
+    "sensors",
+    "sensors/",
+    "home/hall/humidity",
+    "actuators/door",
+    "actuators/window",
+    "actuators/door/lock",
+    "lamp",
+    "$SYS/broker/load",
+    "$SYS",
+    "a/b/c/d",
+    "a/x/c",
+    "a/x/c/d/e",
+    "a/b/x/d",
+    "a/b/c",
+    "/",
+    "//"
+};
+
+/* ============================   UNITY FIXTURES ============================ */
+
+extern "C" {
+
+/* Called before each test method. */
+void setUp( void )
+{
+    handledRoute = -1;
+}
+
+/* Called after each test method. */
+void tearDown( void )
+{
+}
+
+/* Called at the beginning of the whole suite. */
+void suiteSetUp()
+{
+}
+
+/* Called at the end of the whole suite. */
+int suiteTearDown( int numFailures )
+{
+    return numFailures;
+}
+
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Whether a topic filter has a wildcard.
+ */
+static bool hasWildcard( const char * pFilter )
+{
+    return ( std::strchr( pFilter, '+' ) != nullptr ) || ( std::strchr( pFilter, '#' ) != nullptr );
+}
+
+/**
+ * @brief The route chosen as by the topic handlers of the library: the filter
+ * without wildcards which matches, or else the first matching filter.
+ */
+static std::size_t expectedRoute( const char * pTopicName )
+{
+    std::size_t route = TestRouter::noRoute;
+    std::size_t i;
+    bool isMatch;
+
+    for( i = 0U; i < sizeof( filters ) / sizeof( filters[ 0 ] ); i++ )
+    {
+        isMatch = false;
+        TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_MatchTopic( pTopicName,
+                                                         ( uint16_t ) std::strlen( pTopicName ),
+                                                         filters[ i ],
+                                                         ( uint16_t ) std::strlen( filters[ i ] ),
+                                                         &isMatch ) );
+
+        if( ( isMatch == true ) &&
+            ( ( route == TestRouter::noRoute ) ||
+              ( ( hasWildcard( filters[ i ] ) == false ) && ( hasWildcard( filters[ route ] ) == true ) ) ) )
+        {
+            route = i;
+        }
+    }
+
+    return route;
+}
+
+/* ========================================================================== */
+
+extern "C" {
+
+/**
+ * @brief The router chooses the route of the topic handlers of the library.
+ */
+void test_Router_MatchesLikeMatchTopic( void )
+{
+    std::size_t i;
+
+    for( i = 0U; i < sizeof( topics ) / sizeof( topics[ 0 ] ); i++ )
+    {
+        TEST_ASSERT_EQUAL_MESSAGE( expectedRoute( topics[ i ] ),
+                                   TestRouter::match( topics[ i ], std::strlen( topics[ i ] ) ),
+                                   topics[ i ] );
+    }
+}
+
+/**
+ * @brief Filters without wildcards take precedence, and topics starting with
+ * '$' only match filters not starting with a wildcard.
+ */
+void test_Router_Precedence( void )
+{
+    TEST_ASSERT_EQUAL( 2U, TestRouter::match( "sensors/kitchen/temperature", 27U ) );
+    TEST_ASSERT_EQUAL( 0U, TestRouter::match( "sensors/hall/temperature", 24U ) );
+    TEST_ASSERT_EQUAL( 1U, TestRouter::match( "sensors", 7U ) );
+    TEST_ASSERT_EQUAL( 5U, TestRouter::match( "actuators/door", 14U ) );
+    TEST_ASSERT_EQUAL( TestRouter::noRoute, TestRouter::match( "$SYS/broker/load", 16U ) );
+    TEST_ASSERT_EQUAL( TestRouter::noRoute, TestRouter::match( "", 0U ) );
+    TEST_ASSERT_EQUAL( TestRouter::noRoute, TestRouter::match( nullptr, 1U ) );
+
+    TEST_ASSERT_EQUAL( 1U, WildcardFreeRouter::match( "a/c", 3U ) );
+    TEST_ASSERT_EQUAL( WildcardFreeRouter::noRoute, WildcardFreeRouter::match( "a/cd", 4U ) );
+    TEST_ASSERT_EQUAL( WildcardFreeRouter::noRoute, WildcardFreeRouter::match( "a", 1U ) );
+}
+
+/**
+ * @brief Publishes are given to the handler of their route, other packets
+ * and unmatched publishes are not handled.
+ */
+void test_Router_Dispatch( void )
+{
+    MQTTPacketInfo_t packetInfo = {};
+    MQTTDeserializedInfo_t deserializedInfo = {};
+    MQTTPublishInfo_t publishInfo = {};
+
+    deserializedInfo.pPublishInfo = &publishInfo;
+    publishInfo.pTopicName = "home/hall/humidity";
+    publishInfo.topicNameLength = 18U;
+    packetInfo.type = MQTT_PACKET_TYPE_PUBLISH | 0x02U;
+
+    TEST_ASSERT_TRUE( TestRouter::dispatch( nullptr, &packetInfo, &deserializedInfo ) );
+    TEST_ASSERT_EQUAL( 3, handledRoute );
+
+    handledRoute = -1;
+    packetInfo.type = MQTT_PACKET_TYPE_PUBACK;
+    TEST_ASSERT_FALSE( TestRouter::dispatch( nullptr, &packetInfo, &deserializedInfo ) );
+    TEST_ASSERT_EQUAL( -1, handledRoute );
+
+    packetInfo.type = MQTT_PACKET_TYPE_PUBLISH;
+    publishInfo.pTopicName = "x/y";
+    publishInfo.topicNameLength = 3U;
+    TEST_ASSERT_FALSE( WildcardFreeRouter::dispatch( nullptr, &packetInfo, &deserializedInfo ) );
+    TEST_ASSERT_EQUAL( -1, handledRoute );
+}
+
+}
@@ -0,0 +1,542 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file core_mqtt_striped_system_test.c
+ * @brief System tests of the striped client against a stand-in broker with
+ * one session thread per loopback connection.
+ */
+
+#define _POSIX_C_SOURCE    200809L
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "unity.h"
+
+#include "core_mqtt_striped.h"
+#include "tcp_posix_transport.h"
+
+/**
+ * @brief Each compilation unit that uses the transport must define the
+ * NetworkContext struct.
+ */
+struct NetworkContext
+{
+    TcpPosixTransportParams_t * pParams;
+};
+
+/**
+ * @brief Number of stripes of the client.
+ */
+#define STRIPE_COUNT          ( 4U )
+
+/**
+ * @brief Number of topics published to.
+ */
+#define TOPIC_COUNT           ( 16U )
+
+/**
+ * @brief Number of publishes sent on each topic.
+ */
+#define PUBLISHES_PER_TOPIC   ( 50U )
+
+/**
+ * @brief Timeout for connections and for the CONNACK.
+ */
+#define CONNECT_TIMEOUT_MS    ( 1000U )
+
+/**
+ * @brief One broker session, served by its own thread.
+ */
+typedef struct BrokerSession
+{
+    int socket;
+    size_t publishCount[ TOPIC_COUNT ];  /**< Publishes received per topic. */
+    uint32_t nextSequence[ TOPIC_COUNT ]; /**< Next sequence number expected per topic. */
+    bool outOfOrder;                      /**< Whether a publish arrived out of order. */
+    bool disconnected;                    /**< Whether a DISCONNECT arrived. */
+} BrokerSession_t;
+
+/**
+ * @brief The client under test, and the broker side of its connections.
+ */
+static MQTTStripedClient_t client;
+static MQTTStripe_t stripes[ STRIPE_COUNT ];
+static TcpPosixTransportParams_t tcpParams[ STRIPE_COUNT ];
+static NetworkContext_t networkContexts[ STRIPE_COUNT ];
+static TransportInterface_t transports[ STRIPE_COUNT ];
+static uint8_t buffers[ STRIPE_COUNT ][ 256 ];
+static MQTTFixedBuffer_t networkBuffers[ STRIPE_COUNT ];
+static BrokerSession_t sessions[ STRIPE_COUNT ];
+static pthread_t sessionThreads[ STRIPE_COUNT ];
+static bool sessionThreadStarted[ STRIPE_COUNT ];
+
+/**
+ * @brief Packets given to the callback of the striped client.
+ */
+static size_t subackCount;
+static size_t subackStripe;
+static uint16_t subackPacketId;
+static size_t incomingPublishCount;
+static size_t incomingPublishStripe;
+
+/* ============================   UNITY FIXTURES ============================ */
+
+/* Called before each test method. */
+void setUp( void )
+{
+    size_t i;
+
+    ( void ) memset( &client, 0x00, sizeof( client ) );
+    ( void ) memset( sessions, 0x00, sizeof( sessions ) );
+    ( void ) memset( sessionThreadStarted, 0x00, sizeof( sessionThreadStarted ) );
+
+    for( i = 0U; i < STRIPE_COUNT; i++ )
+    {
+        tcpParams[ i ].socketDescriptor = -1;
+        networkContexts[ i ].pParams = &tcpParams[ i ];
+        transports[ i ].pNetworkContext = &networkContexts[ i ];
+        transports[ i ].recv = TcpPosixTransport_Recv;
+        transports[ i ].send = TcpPosixTransport_Send;
+        transports[ i ].writev = TcpPosixTransport_Writev;
+        networkBuffers[ i ].pBuffer = buffers[ i ];
+        networkBuffers[ i ].size = sizeof( buffers[ i ] );
+        sessions[ i ].socket = -1;
+    }
+
+    subackCount = 0U;
+    subackStripe = STRIPE_COUNT;
+    subackPacketId = 0U;
+    incomingPublishCount = 0U;
+    incomingPublishStripe = STRIPE_COUNT;
+}
+
+/* Called after each test method. */
+void tearDown( void )
+{
+    size_t i;
+
+    for( i = 0U; i < STRIPE_COUNT; i++ )
+    {
+        if( tcpParams[ i ].socketDescriptor >= 0 )
+        {
+            ( void ) TcpPosixTransport_Disconnect( &networkContexts[ i ] );
+        }
+
+        if( sessionThreadStarted[ i ] == true )
+        {
+            ( void ) pthread_join( sessionThreads[ i ], NULL );
+        }
+
+        if( sessions[ i ].socket >= 0 )
+        {
+            ( void ) close( sessions[ i ].socket );
+        }
+    }
+}
+
+/* Called at the beginning of the whole suite. */
+void suiteSetUp()
+{
+}
+
+/* Called at the end of the whole suite. */
+int suiteTearDown( int numFailures )
+{
+    return numFailures;
+}
+
+/* ========================================================================== */
+
+static uint32_t getTimeMs( void )
+{
+    struct timespec now;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( uint32_t ) ( ( now.tv_sec * 1000 ) + ( now.tv_nsec / 1000000 ) );
+}
+
+static void stripedEventCallback( MQTTStripedClient_t * pClient,
+                                  size_t stripeIndex,
+                                  MQTTPacketInfo_t * pPacketInfo,
+                                  MQTTDeserializedInfo_t * pDeserializedInfo )
+{
+    TEST_ASSERT_EQUAL_PTR( &client, pClient );
+
+    if( ( pPacketInfo->type & 0xF0U ) == MQTT_PACKET_TYPE_PUBLISH )
+    {
+        incomingPublishCount++;
+        incomingPublishStripe = stripeIndex;
+    }
+    else if( pPacketInfo->type == MQTT_PACKET_TYPE_SUBACK )
+    {
+        subackCount++;
+        subackStripe = stripeIndex;
+        subackPacketId = pDeserializedInfo->packetIdentifier;
+    }
+    else
+    {
+        /* Nothing else is expected. */
+        TEST_FAIL();
+    }
+}
+
+/**
+ * @brief Read exactly the given number of bytes from a blocking socket.
+ */
+static bool readExact( int socketDescriptor,
+                       uint8_t * pBuffer,
+                       size_t length )
+{
+    size_t received = 0U;
+    ssize_t result = 1;
+
+    while( ( received < length ) && ( result > 0 ) )
+    {
+        result = recv( socketDescriptor, &pBuffer[ received ], length - received, 0 );
+
+        if( result > 0 )
+        {
+            received += ( size_t ) result;
+        }
+    }
+
+    return received == length;
+}
+
+/**
+ * @brief Read one MQTT packet on the broker side.
+ *
+ * @return The remaining length of the packet, or -1 if the connection closed.
+ */
+static long readPacket( int socketDescriptor,
+                        uint8_t * pType,
+                        uint8_t * pBuffer,
+                        size_t size )
+{
+    uint8_t byte = 0U;
+    size_t remainingLength = 0U, multiplier = 1U;
+    bool success = readExact( socketDescriptor, pType, 1U );
+
+    do
+    {
+        success = success && readExact( socketDescriptor, &byte, 1U );
+        remainingLength += ( size_t ) ( byte & 0x7FU ) * multiplier;
+        multiplier *= 128U;
+    } while( success && ( ( byte & 0x80U ) != 0U ) );
+
+    success = success && ( remainingLength <= size ) &&
+              readExact( socketDescriptor, pBuffer, remainingLength );
+
+    return success ? ( long ) remainingLength : -1L;
+}
+
+/**
+ * @brief Session thread of the stand-in broker. Publishes are checked to
+ * arrive in order per topic; a subscription is answered with a SUBACK and a
+ * publish on the subscribed topic.
+ */
+static void * sessionThread( void * pArgument )
+{
+    BrokerSession_t * pSession = ( BrokerSession_t * ) pArgument;
+    static const uint8_t connack[] = { 0x20U, 0x02U, 0x00U, 0x00U };
+    static const uint8_t pingresp[] = { 0xD0U, 0x00U };
+    static const uint8_t commandPublish[] = { 0x30U, 0x0BU, 0x00U, 0x07U, 'c', 'o', 'm', 'm', 'a', 'n', 'd', 'g', 'o' };
+    uint8_t suback[] = { 0x90U, 0x03U, 0x00U, 0x00U, 0x00U };
+    uint8_t buffer[ 256 ];
+    uint8_t type = 0U;
+    uint16_t topicLength;
+    uint32_t sequence, topic;
+    long length = 0L;
+
+    while( ( pSession->disconnected == false ) && ( length >= 0L ) )
+    {
+        length = readPacket( pSession->socket, &type, buffer, sizeof( buffer ) );
+
+        if( length < 0L )
+        {
+            /* Connection closed. */
+        }
+        else if( type == 0x10U )
+        {
+            ( void ) send( pSession->socket, connack, sizeof( connack ), 0 );
+        }
+        else if( type == 0x30U )
+        {
+            /* Topic "striped/NN", then a 4-byte sequence number. */
+            topicLength = ( uint16_t ) ( ( buffer[ 0 ] << 8 ) | buffer[ 1 ] );
+            topic = ( uint32_t ) ( ( ( buffer[ topicLength ] - '0' ) * 10 ) + ( buffer[ topicLength + 1 ] - '0' ) );
+            ( void ) memcpy( &sequence, &buffer[ 2U + topicLength ], sizeof( sequence ) );
+
+            if( ( topic >= TOPIC_COUNT ) || ( sequence != pSession->nextSequence[ topic ] ) )
+            {
+                pSession->outOfOrder = true;
+            }
+            else
+            {
+                pSession->nextSequence[ topic ]++;
+                pSession->publishCount[ topic ]++;
+            }
+        }
+        else if( type == 0x82U )
+        {
+            suback[ 2 ] = buffer[ 0 ];
+            suback[ 3 ] = buffer[ 1 ];
+            ( void ) send( pSession->socket, suback, sizeof( suback ), 0 );
+            ( void ) send( pSession->socket, commandPublish, sizeof( commandPublish ), 0 );
+        }
+        else if( type == 0xC0U )
+        {
+            ( void ) send( pSession->socket, pingresp, sizeof( pingresp ), 0 );
+        }
+        else if( type == 0xE0U )
+        {
+            pSession->disconnected = true;
+        }
+        else
+        {
+            pSession->outOfOrder = true;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Connect every stripe to the stand-in broker and start its sessions.
+ */
+static void openConnections( void )
+{
+    struct sockaddr_in address;
+    socklen_t addressLength = sizeof( address );
+    int listenSocket = socket( AF_INET, SOCK_STREAM, 0 );
+    size_t i;
+
+    TEST_ASSERT_GREATER_OR_EQUAL( 0, listenSocket );
+
+    ( void ) memset( &address, 0x00, sizeof( address ) );
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+
+    TEST_ASSERT_EQUAL( 0, bind( listenSocket, ( struct sockaddr * ) &address, sizeof( address ) ) );
+    TEST_ASSERT_EQUAL( 0, listen( listenSocket, STRIPE_COUNT ) );
+    TEST_ASSERT_EQUAL( 0, getsockname( listenSocket, ( struct sockaddr * ) &address, &addressLength ) );
+
+    for( i = 0U; i < STRIPE_COUNT; i++ )
+    {
+        TEST_ASSERT_EQUAL( TCP_POSIX_TRANSPORT_SUCCESS,
+                           TcpPosixTransport_Connect( &networkContexts[ i ], "127.0.0.1",
+                                                      ntohs( address.sin_port ), CONNECT_TIMEOUT_MS ) );
+        sessions[ i ].socket = accept( listenSocket, NULL, NULL );
+        TEST_ASSERT_GREATER_OR_EQUAL( 0, sessions[ i ].socket );
+        TEST_ASSERT_EQUAL( 0, pthread_create( &sessionThreads[ i ], NULL, sessionThread, &sessions[ i ] ) );
+        sessionThreadStarted[ i ] = true;
+    }
+
+    ( void ) close( listenSocket );
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Invalid parameters are rejected.
+ */
+void test_MQTTStriped_Invalid_Params( void )
+{
+    MQTTPublishInfo_t publishInfo = { 0 };
+    MQTTSubscribeInfo_t subscription = { 0 };
+
+    TEST_ASSERT_EQUAL( MQTTBadParameter,
+                       MQTTStriped_Init( NULL, stripes, STRIPE_COUNT, transports, getTimeMs,
+                                         stripedEventCallback, networkBuffers ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter,
+                       MQTTStriped_Init( &client, stripes, 0U, transports, getTimeMs,
+                                         stripedEventCallback, networkBuffers ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter,
+                       MQTTStriped_Init( &client, stripes, STRIPE_COUNT, transports, getTimeMs,
+                                         NULL, networkBuffers ) );
+
+    /* A stripe which cannot be initialized fails the client. */
+    TEST_ASSERT_EQUAL( MQTTBadParameter,
+                       MQTTStriped_Init( &client, stripes, STRIPE_COUNT, transports, NULL,
+                                         stripedEventCallback, networkBuffers ) );
+    TEST_ASSERT_NULL( MQTTStriped_GetContext( &client, 0U ) );
+
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTTStriped_Connect( &client, NULL, NULL, 0U, NULL ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTTStriped_Publish( &client, &publishInfo, NULL, NULL ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTTStriped_ProcessLoop( NULL ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTTStriped_Disconnect( NULL ) );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess,
+                       MQTTStriped_Init( &client, stripes, STRIPE_COUNT, transports, getTimeMs,
+                                         stripedEventCallback, networkBuffers ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTTStriped_Publish( &client, NULL, NULL, NULL ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTTStriped_Subscribe( &client, &subscription, NULL, NULL ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTTStriped_Unsubscribe( &client, NULL, NULL, NULL ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTTStriped_Connect( &client, NULL, NULL, 0U, NULL ) );
+    TEST_ASSERT_NULL( MQTTStriped_GetContext( &client, STRIPE_COUNT ) );
+
+    /* Nothing is connected yet. */
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTTStriped_Disconnect( &client ) );
+}
+
+/**
+ * @brief Topics are routed to a fixed stripe, and spread over all stripes.
+ */
+void test_MQTTStriped_GetStripeIndex( void )
+{
+    size_t used[ STRIPE_COUNT ] = { 0 };
+    char topic[ 16 ];
+    size_t i, stripeIndex;
+
+    TEST_ASSERT_EQUAL( MQTTSuccess,
+                       MQTTStriped_Init( &client, stripes, STRIPE_COUNT, transports, getTimeMs,
+                                         stripedEventCallback, networkBuffers ) );
+    TEST_ASSERT_EQUAL_PTR( &stripes[ 2 ].context, MQTTStriped_GetContext( &client, 2U ) );
+
+    for( i = 0U; i < 64U; i++ )
+    {
+        ( void ) snprintf( topic, sizeof( topic ), "sensors/%02u", ( unsigned int ) i );
+        stripeIndex = MQTTStriped_GetStripeIndex( &client, topic, ( uint16_t ) strlen( topic ) );
+        TEST_ASSERT_LESS_THAN( STRIPE_COUNT, stripeIndex );
+        TEST_ASSERT_EQUAL( stripeIndex, MQTTStriped_GetStripeIndex( &client, topic, ( uint16_t ) strlen( topic ) ) );
+        used[ stripeIndex ]++;
+    }
+
+    for( i = 0U; i < STRIPE_COUNT; i++ )
+    {
+        TEST_ASSERT_GREATER_THAN( 0U, used[ i ] );
+    }
+}
+
+/**
+ * @brief A session over all stripes: the publishes of each topic travel in
+ * order over the stripe of the topic, and packets of any stripe reach the
+ * single callback.
+ */
+void test_MQTTStriped_Session( void )
+{
+    MQTTConnectInfo_t connectInfos[ STRIPE_COUNT ] = { 0 };
+    static const char * const clientIds[ STRIPE_COUNT ] = { "striped-0", "striped-1", "striped-2", "striped-3" };
+    MQTTPublishInfo_t publishInfo = { 0 };
+    MQTTSubscribeInfo_t subscription = { 0 };
+    bool sessionPresent[ STRIPE_COUNT ];
+    char topic[ 16 ];
+    uint32_t sequence;
+    size_t i, topicIndex, stripeIndex = 0U, expectedStripe = 0U, publishedCount;
+    uint16_t packetId = 0U;
+    uint32_t startMs;
+
+    openConnections();
+
+    TEST_ASSERT_EQUAL( MQTTSuccess,
+                       MQTTStriped_Init( &client, stripes, STRIPE_COUNT, transports, getTimeMs,
+                                         stripedEventCallback, networkBuffers ) );
+
+    for( i = 0U; i < STRIPE_COUNT; i++ )
+    {
+        connectInfos[ i ].cleanSession = true;
+        connectInfos[ i ].keepAliveSeconds = 60U;
+        connectInfos[ i ].pClientIdentifier = clientIds[ i ];
+        connectInfos[ i ].clientIdentifierLength = ( uint16_t ) strlen( clientIds[ i ] );
+    }
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTTStriped_Connect( &client, connectInfos, NULL, CONNECT_TIMEOUT_MS, sessionPresent ) );
+    TEST_ASSERT_FALSE( sessionPresent[ STRIPE_COUNT - 1U ] );
+
+    /* Interleave the topics, so that every stripe is used in turn. */
+    publishInfo.qos = MQTTQoS0;
+    publishInfo.pTopicName = topic;
+    publishInfo.topicNameLength = 10U;
+    publishInfo.pPayload = &sequence;
+    publishInfo.payloadLength = sizeof( sequence );
+
+    for( sequence = 0U; sequence < PUBLISHES_PER_TOPIC; sequence++ )
+    {
+        for( topicIndex = 0U; topicIndex < TOPIC_COUNT; topicIndex++ )
+        {
+            ( void ) snprintf( topic, sizeof( topic ), "striped/%02u", ( unsigned int ) topicIndex );
+            TEST_ASSERT_EQUAL( MQTTSuccess, MQTTStriped_Publish( &client, &publishInfo, &stripeIndex, &packetId ) );
+            TEST_ASSERT_EQUAL( MQTTStriped_GetStripeIndex( &client, topic, 10U ), stripeIndex );
+            TEST_ASSERT_EQUAL( 0U, packetId );
+        }
+    }
+
+    /* The subscription is answered on its stripe with a SUBACK and a publish,
+     * both given to the single callback. */
+    subscription.qos = MQTTQoS0;
+    subscription.pTopicFilter = "command";
+    subscription.topicFilterLength = 7U;
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTTStriped_Subscribe( &client, &subscription, &expectedStripe, &packetId ) );
+    TEST_ASSERT_NOT_EQUAL( 0U, packetId );
+
+    startMs = getTimeMs();
+
+    while( ( ( subackCount == 0U ) || ( incomingPublishCount == 0U ) ) &&
+           ( ( getTimeMs() - startMs ) < CONNECT_TIMEOUT_MS ) )
+    {
+        TEST_ASSERT_EQUAL( MQTTSuccess, MQTTStriped_ProcessLoop( &client ) );
+    }
+
+    TEST_ASSERT_EQUAL( 1U, subackCount );
+    TEST_ASSERT_EQUAL( expectedStripe, subackStripe );
+    TEST_ASSERT_EQUAL( packetId, subackPacketId );
+    TEST_ASSERT_EQUAL( 1U, incomingPublishCount );
+    TEST_ASSERT_EQUAL( expectedStripe, incomingPublishStripe );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTTStriped_Disconnect( &client ) );
+
+    for( i = 0U; i < STRIPE_COUNT; i++ )
+    {
+        TEST_ASSERT_EQUAL( 0, pthread_join( sessionThreads[ i ], NULL ) );
+        sessionThreadStarted[ i ] = false;
+        TEST_ASSERT_TRUE( sessions[ i ].disconnected );
+        TEST_ASSERT_FALSE( sessions[ i ].outOfOrder );
+    }
+
+    /* Every publish of a topic arrived on the stripe of the topic. */
+    for( topicIndex = 0U; topicIndex < TOPIC_COUNT; topicIndex++ )
+    {
+        ( void ) snprintf( topic, sizeof( topic ), "striped/%02u", ( unsigned int ) topicIndex );
+        expectedStripe = MQTTStriped_GetStripeIndex( &client, topic, 10U );
+        publishedCount = 0U;
+
+        for( i = 0U; i < STRIPE_COUNT; i++ )
+        {
+            publishedCount += sessions[ i ].publishCount[ topicIndex ];
+        }
+
+        TEST_ASSERT_EQUAL( PUBLISHES_PER_TOPIC, sessions[ expectedStripe ].publishCount[ topicIndex ] );
+        TEST_ASSERT_EQUAL( PUBLISHES_PER_TOPIC, publishedCount );
+    }
+}
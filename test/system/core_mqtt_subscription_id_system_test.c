@@ -0,0 +1,333 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file core_mqtt_subscription_id_system_test.c
+ * @brief System tests of MQTT 5 Subscription Identifiers over the replay
+ * transport.
+ */
+
+#include <string.h>
+
+#include "unity.h"
+
+#include "core_mqtt.h"
+
+#include "replay_transport.h"
+
+/**
+ * @brief The context and its transport.
+ */
+static MQTTContext_t context;
+static NetworkContext_t networkContext;
+static uint8_t buffer[ 128 ];
+static MQTTSubscriptionHandlerRecord_t subscriptionHandlers[ 4 ];
+static MQTTTopicHandlerRecord_t exactTopicHandlers[ 4 ];
+
+/**
+ * @brief The number of publishes given to the event callback, and the
+ * Subscription Identifiers of the last one.
+ */
+static uint32_t callbackCount;
+static size_t callbackSubscriptionIdCount;
+static uint32_t callbackSubscriptionIds[ MQTT_MAX_SUBSCRIPTION_IDS ];
+
+/**
+ * @brief The number of publishes given to each handler. The handler context
+ * points to one of the counters.
+ */
+static uint32_t handlerCounts[ 3 ];
+
+/* ============================   UNITY FIXTURES ============================ */
+
+/* Called before each test method. */
+void setUp( void )
+{
+    ( void ) memset( &context, 0x00, sizeof( context ) );
+    ( void ) memset( &networkContext, 0x00, sizeof( networkContext ) );
+    ( void ) memset( callbackSubscriptionIds, 0x00, sizeof( callbackSubscriptionIds ) );
+    ( void ) memset( handlerCounts, 0x00, sizeof( handlerCounts ) );
+    callbackCount = 0U;
+    callbackSubscriptionIdCount = 0U;
+}
+
+/* Called after each test method. */
+void tearDown( void )
+{
+}
+
+/* Called at the beginning of the whole suite. */
+void suiteSetUp()
+{
+}
+
+/* Called at the end of the whole suite. */
+int suiteTearDown( int numFailures )
+{
+    return numFailures;
+}
+
+/* ========================================================================== */
+
+static void eventCallback( MQTTContext_t * pContext,
+                           MQTTPacketInfo_t * pPacketInfo,
+                           MQTTDeserializedInfo_t * pDeserializedInfo )
+{
+    ( void ) pContext;
+
+    if( ( pPacketInfo->type & 0xF0U ) == MQTT_PACKET_TYPE_PUBLISH )
+    {
+        callbackCount++;
+        callbackSubscriptionIdCount = pDeserializedInfo->subscriptionIdCount;
+
+        if( pDeserializedInfo->subscriptionIdCount != 0U )
+        {
+            ( void ) memcpy( callbackSubscriptionIds,
+                             pDeserializedInfo->pSubscriptionIds,
+                             pDeserializedInfo->subscriptionIdCount * sizeof( uint32_t ) );
+        }
+        else
+        {
+            TEST_ASSERT_NULL( pDeserializedInfo->pSubscriptionIds );
+        }
+    }
+}
+
+static void countingHandler( MQTTContext_t * pContext,
+                             MQTTPacketInfo_t * pPacketInfo,
+                             MQTTDeserializedInfo_t * pDeserializedInfo,
+                             void * pHandlerContext )
+{
+    ( void ) pContext;
+
+    TEST_ASSERT_EQUAL_HEX8( MQTT_PACKET_TYPE_PUBLISH, pPacketInfo->type & 0xF0U );
+    TEST_ASSERT_EQUAL_MEMORY( "a/b", pDeserializedInfo->pPublishInfo->pTopicName, 3U );
+    ( *( uint32_t * ) pHandlerContext )++;
+}
+
+/**
+ * @brief Initialize the context for the given protocol version.
+ */
+static void initContext( uint8_t protocolVersion )
+{
+    MQTTFixedBuffer_t networkBuffer = { buffer, sizeof( buffer ) };
+
+    ReplayTransport_InitContext( &context, &networkContext, eventCallback, &networkBuffer, protocolVersion );
+}
+
+/**
+ * @brief Connect with a CONNACK of the protocol version of the context.
+ */
+static void connect( void )
+{
+    ReplayTransport_Connect( &context, "subid", false );
+    networkContext.txLength = 0U;
+}
+
+/**
+ * @brief Receive a QoS 0 publish with payload "x" to "a/b" carrying the
+ * given Subscription Identifiers, each encoded in one byte.
+ */
+static void receivePublish( const uint8_t * pSubscriptionIds,
+                            size_t subscriptionIdCount )
+{
+    size_t i, length = 0U;
+
+    networkContext.rx[ length++ ] = MQTT_PACKET_TYPE_PUBLISH;
+    networkContext.rx[ length++ ] = ( uint8_t ) ( 7U + ( 2U * subscriptionIdCount ) );
+    networkContext.rx[ length++ ] = 0x00;
+    networkContext.rx[ length++ ] = 0x03;
+    networkContext.rx[ length++ ] = 'a';
+    networkContext.rx[ length++ ] = '/';
+    networkContext.rx[ length++ ] = 'b';
+    networkContext.rx[ length++ ] = ( uint8_t ) ( 2U * subscriptionIdCount );
+
+    for( i = 0U; i < subscriptionIdCount; i++ )
+    {
+        networkContext.rx[ length++ ] = 0x0B;
+        networkContext.rx[ length++ ] = pSubscriptionIds[ i ];
+    }
+
+    networkContext.rx[ length++ ] = 'x';
+    networkContext.rxLength = length;
+    networkContext.rxIndex = 0U;
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_ProcessLoop( &context ) );
+    TEST_ASSERT_EQUAL( networkContext.rxLength, networkContext.rxIndex );
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Invalid parameters of the subscription handler functions.
+ */
+void test_SubscriptionId_InvalidParams( void )
+{
+    MQTTSubscribeInfo_t subscription = { MQTTQoS0, "a/b", 3U };
+
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_InitSubscriptionHandlers( &context, subscriptionHandlers, 4U ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_RegisterSubscriptionHandler( &context, 1U, countingHandler, NULL ) );
+
+    initContext( MQTT_VERSION_3_1_1 );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_InitSubscriptionHandlers( NULL, subscriptionHandlers, 4U ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_InitSubscriptionHandlers( &context, NULL, 4U ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_InitSubscriptionHandlers( &context, subscriptionHandlers, 0U ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_InitSubscriptionHandlers( &context, subscriptionHandlers, MQTT_SUBSCRIPTION_ID_MAX + 1U ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_InitSubscriptionHandlers( &context, subscriptionHandlers, 4U ) );
+
+    /* Subscription Identifiers run from 1 to the size of the table. */
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_RegisterSubscriptionHandler( NULL, 1U, countingHandler, NULL ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_RegisterSubscriptionHandler( &context, 0U, countingHandler, NULL ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_RegisterSubscriptionHandler( &context, 5U, countingHandler, NULL ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_RegisterSubscriptionHandler( &context, 4U, countingHandler, NULL ) );
+
+    /* Subscription Identifiers need MQTT 5. */
+    connect();
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_SubscribeWithId( &context, &subscription, 1U, 1U, 1U ) );
+    TEST_ASSERT_EQUAL( 0U, networkContext.txLength );
+}
+
+/**
+ * @brief The Subscription Identifier is sent as the only property of the
+ * SUBSCRIBE.
+ */
+void test_SubscriptionId_Subscribe( void )
+{
+    MQTTSubscribeInfo_t subscription = { MQTTQoS0, "a/b", 3U };
+
+    /* Subscription Identifier 300 is encoded in two bytes. */
+    const uint8_t subscribeWithId[] = { 0x82, 0x0C, 0x00, 0x07, 0x03, 0x0B, 0xAC, 0x02,
+                                        0x00, 0x03, 'a', '/', 'b', 0x00 };
+    const uint8_t subscribeV5[] = { 0x82, 0x09, 0x00, 0x08, 0x00,
+                                    0x00, 0x03, 'a', '/', 'b', 0x00 };
+    const uint8_t subscribe[] = { 0x82, 0x08, 0x00, 0x09,
+                                  0x00, 0x03, 'a', '/', 'b', 0x00 };
+
+    initContext( MQTT_VERSION_5 );
+    connect();
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_SubscribeWithId( &context, &subscription, 1U, 7U, 300U ) );
+    TEST_ASSERT_EQUAL( sizeof( subscribeWithId ), networkContext.txLength );
+    TEST_ASSERT_EQUAL_MEMORY( subscribeWithId, networkContext.tx, sizeof( subscribeWithId ) );
+
+    /* Without an identifier the property length is empty. */
+    networkContext.txLength = 0U;
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Subscribe( &context, &subscription, 1U, 8U ) );
+    TEST_ASSERT_EQUAL( sizeof( subscribeV5 ), networkContext.txLength );
+    TEST_ASSERT_EQUAL_MEMORY( subscribeV5, networkContext.tx, sizeof( subscribeV5 ) );
+
+    networkContext.txLength = 0U;
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_SubscribeWithId( &context, &subscription, 1U, 7U, MQTT_SUBSCRIPTION_ID_MAX + 1U ) );
+    TEST_ASSERT_EQUAL( 0U, networkContext.txLength );
+
+    /* MQTT 3.1.1 subscriptions are unchanged. */
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Disconnect( &context ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_SetProtocolVersion( &context, MQTT_VERSION_3_1_1 ) );
+    connect();
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_SubscribeWithId( &context, &subscription, 1U, 9U, 0U ) );
+    TEST_ASSERT_EQUAL( sizeof( subscribe ), networkContext.txLength );
+    TEST_ASSERT_EQUAL_MEMORY( subscribe, networkContext.tx, sizeof( subscribe ) );
+}
+
+/**
+ * @brief Incoming publishes are given to the handler of each of their
+ * Subscription Identifiers, and fall back to the topic handlers and the
+ * event callback.
+ */
+void test_SubscriptionId_Dispatch( void )
+{
+    const uint8_t one[] = { 1U };
+    const uint8_t oneAndTwo[] = { 1U, 2U };
+    const uint8_t three[] = { 3U };
+    const uint8_t outsideTable[] = { 100U };
+
+    initContext( MQTT_VERSION_5 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_InitSubscriptionHandlers( &context, subscriptionHandlers, 4U ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_RegisterSubscriptionHandler( &context, 1U, countingHandler, &handlerCounts[ 0 ] ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_RegisterSubscriptionHandler( &context, 2U, countingHandler, &handlerCounts[ 1 ] ) );
+    connect();
+
+    receivePublish( one, 1U );
+    TEST_ASSERT_EQUAL( 1U, handlerCounts[ 0 ] );
+    TEST_ASSERT_EQUAL( 0U, handlerCounts[ 1 ] );
+    TEST_ASSERT_EQUAL( 0U, callbackCount );
+
+    /* A publish matching two subscriptions reaches both handlers. */
+    receivePublish( oneAndTwo, 2U );
+    TEST_ASSERT_EQUAL( 2U, handlerCounts[ 0 ] );
+    TEST_ASSERT_EQUAL( 1U, handlerCounts[ 1 ] );
+    TEST_ASSERT_EQUAL( 0U, callbackCount );
+
+    /* Identifiers without a handler go to the event callback, which is given
+     * the identifiers. */
+    receivePublish( three, 1U );
+    receivePublish( outsideTable, 1U );
+    TEST_ASSERT_EQUAL( 2U, callbackCount );
+    TEST_ASSERT_EQUAL( 1U, callbackSubscriptionIdCount );
+    TEST_ASSERT_EQUAL_UINT32( 100U, callbackSubscriptionIds[ 0 ] );
+
+    receivePublish( NULL, 0U );
+    TEST_ASSERT_EQUAL( 3U, callbackCount );
+    TEST_ASSERT_EQUAL( 0U, callbackSubscriptionIdCount );
+
+    /* Without a subscription handler, the topic handlers are tried. */
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_InitTopicHandlers( &context, exactTopicHandlers, 4U, NULL, 0U ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_RegisterTopicHandler( &context, "a/b", 3U, countingHandler, &handlerCounts[ 2 ] ) );
+    receivePublish( three, 1U );
+    TEST_ASSERT_EQUAL( 1U, handlerCounts[ 2 ] );
+    receivePublish( one, 1U );
+    TEST_ASSERT_EQUAL( 3U, handlerCounts[ 0 ] );
+    TEST_ASSERT_EQUAL( 1U, handlerCounts[ 2 ] );
+
+    /* A removed handler no longer receives publishes. */
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_RegisterSubscriptionHandler( &context, 1U, NULL, NULL ) );
+    receivePublish( one, 1U );
+    TEST_ASSERT_EQUAL( 3U, handlerCounts[ 0 ] );
+    TEST_ASSERT_EQUAL( 2U, handlerCounts[ 2 ] );
+    TEST_ASSERT_EQUAL( 3U, callbackCount );
+}
+
+/**
+ * @brief Subscription Identifiers beyond MQTT_MAX_SUBSCRIPTION_IDS are dropped.
+ */
+void test_SubscriptionId_TooManyIds( void )
+{
+    uint8_t ids[ MQTT_MAX_SUBSCRIPTION_IDS + 1U ];
+    size_t i;
+
+    for( i = 0U; i < sizeof( ids ); i++ )
+    {
+        ids[ i ] = ( uint8_t ) ( 10U + i );
+    }
+
+    initContext( MQTT_VERSION_5 );
+    connect();
+
+    receivePublish( ids, sizeof( ids ) );
+    TEST_ASSERT_EQUAL( 1U, callbackCount );
+    TEST_ASSERT_EQUAL( MQTT_MAX_SUBSCRIPTION_IDS, callbackSubscriptionIdCount );
+    TEST_ASSERT_EQUAL_UINT32( 10U, callbackSubscriptionIds[ 0 ] );
+    TEST_ASSERT_EQUAL_UINT32( 10U + MQTT_MAX_SUBSCRIPTION_IDS - 1U,
+                              callbackSubscriptionIds[ MQTT_MAX_SUBSCRIPTION_IDS - 1U ] );
+}
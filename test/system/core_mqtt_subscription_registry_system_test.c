@@ -0,0 +1,614 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file core_mqtt_subscription_registry_system_test.c
+ * @brief System tests of the subscription registry over the replay transport.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "unity.h"
+
+#include "core_mqtt.h"
+
+#include "replay_transport.h"
+
+/**
+ * @brief The number of topic filters subscribed to.
+ */
+#define FILTER_COUNT     ( 100U )
+
+/**
+ * @brief Length of each topic filter, "dev/NNNN/cmd".
+ */
+#define FILTER_LENGTH    ( 12U )
+
+/**
+ * @brief Size of the staging buffer of the registry. 15 bytes for each topic
+ * filter leave room for 16 topic filters in each SUBSCRIBE.
+ */
+#define STAGING_SIZE     ( 256U )
+
+/**
+ * @brief The number of transport writes of a CONNECT, one for each of its
+ * vectors.
+ */
+#define CONNECT_WRITES   ( 3U )
+
+/**
+ * @brief The context and its transport.
+ */
+static MQTTContext_t context;
+static NetworkContext_t networkContext;
+static uint8_t buffer[ 256 ];
+static uint8_t staging[ STAGING_SIZE ];
+static MQTTSubscriptionRecord_t records[ FILTER_COUNT + 1U ];
+
+/**
+ * @brief The topic filters subscribed to.
+ */
+static char filters[ FILTER_COUNT ][ FILTER_LENGTH + 1U ];
+static MQTTSubscribeInfo_t subscriptionList[ FILTER_COUNT ];
+
+/**
+ * @brief The offsets in the transport and the packet IDs of the SUBSCRIBEs
+ * sent, in order.
+ */
+static size_t packetOffsets[ 16 ];
+static uint16_t packetIds[ 16 ];
+static size_t packetCount;
+
+/**
+ * @brief The number of SUBACKs given to the event callback, and the number of
+ * topic filters whose return code the callback found through the registry.
+ */
+static uint32_t subackCount;
+static uint32_t subackFilterCount;
+
+/* ============================   UNITY FIXTURES ============================ */
+
+/* Called before each test method. */
+void setUp( void )
+{
+    size_t i;
+
+    ( void ) memset( &context, 0x00, sizeof( context ) );
+    ( void ) memset( &networkContext, 0x00, sizeof( networkContext ) );
+    ( void ) memset( packetOffsets, 0x00, sizeof( packetOffsets ) );
+    ( void ) memset( packetIds, 0x00, sizeof( packetIds ) );
+    packetCount = 0U;
+    subackCount = 0U;
+    subackFilterCount = 0U;
+
+    for( i = 0U; i < FILTER_COUNT; i++ )
+    {
+        ( void ) snprintf( filters[ i ], sizeof( filters[ i ] ), "dev/%04u/cmd", ( unsigned int ) i );
+        subscriptionList[ i ].qos = MQTTQoS0;
+        subscriptionList[ i ].pTopicFilter = filters[ i ];
+        subscriptionList[ i ].topicFilterLength = FILTER_LENGTH;
+    }
+}
+
+/* Called after each test method. */
+void tearDown( void )
+{
+}
+
+/* Called at the beginning of the whole suite. */
+void suiteSetUp()
+{
+}
+
+/* Called at the end of the whole suite. */
+int suiteTearDown( int numFailures )
+{
+    return numFailures;
+}
+
+/* ========================================================================== */
+
+static void eventCallback( MQTTContext_t * pContext,
+                           MQTTPacketInfo_t * pPacketInfo,
+                           MQTTDeserializedInfo_t * pDeserializedInfo )
+{
+    uint8_t * pCodes = NULL;
+    size_t codeCount = 0U;
+    size_t i;
+
+    if( pPacketInfo->type == MQTT_PACKET_TYPE_SUBACK )
+    {
+        subackCount++;
+
+        if( pContext->protocolVersion == MQTT_VERSION_5 )
+        {
+            TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_GetSubAckReasonCodesV5( pPacketInfo, &pCodes, &codeCount ) );
+        }
+        else
+        {
+            TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_GetSubAckStatusCodes( pPacketInfo, &pCodes, &codeCount ) );
+        }
+
+        /* The records awaiting the SUBACK give the code of each topic filter. */
+        for( i = 0U; i < pContext->subscriptionRecordMaxCount; i++ )
+        {
+            if( ( records[ i ].topicFilterLength != 0U ) &&
+                ( records[ i ].packetId == pDeserializedInfo->packetIdentifier ) )
+            {
+                TEST_ASSERT_LESS_THAN( codeCount, records[ i ].subAckIndex );
+                subackFilterCount++;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Initialize the context with a registry, for the given protocol
+ * version.
+ */
+static void initContext( uint8_t protocolVersion )
+{
+    MQTTFixedBuffer_t networkBuffer = { buffer, sizeof( buffer ) };
+    MQTTFixedBuffer_t stagingBuffer = { staging, sizeof( staging ) };
+
+    ReplayTransport_InitContext( &context, &networkContext, eventCallback, &networkBuffer, protocolVersion );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_InitSubscriptionRegistry( &context, records, FILTER_COUNT + 1U, &stagingBuffer ) );
+}
+
+/**
+ * @brief Find the SUBSCRIBEs sent since the transport record was cleared, and
+ * their packet IDs.
+ */
+static void findSubscribes( void )
+{
+    size_t i, index;
+
+    packetCount = ReplayTransport_FindSentPackets( &networkContext, MQTT_PACKET_TYPE_SUBSCRIBE, packetOffsets, 16U );
+
+    for( i = 0U; i < packetCount; i++ )
+    {
+        index = packetOffsets[ i ] + 1U;
+
+        while( ( networkContext.tx[ index ] & 0x80U ) != 0U )
+        {
+            index++;
+        }
+
+        packetIds[ i ] = ( uint16_t ) ( ( networkContext.tx[ index + 1U ] << 8 ) | networkContext.tx[ index + 2U ] );
+    }
+}
+
+/**
+ * @brief Connect with the broker replying the given session present flag.
+ */
+static void connect( bool sessionPresent )
+{
+    networkContext.txLength = 0U;
+    networkContext.writeCount = 0U;
+    ReplayTransport_Connect( &context, "registry", sessionPresent );
+    findSubscribes();
+}
+
+/**
+ * @brief Receive a SUBACK for each SUBACK packet ID, with the given code for
+ * every topic filter but the refused one.
+ *
+ * @param[in] filterCounts The number of topic filters of each SUBSCRIBE.
+ * @param[in] refusedFilter Index of the refused topic filter in the first
+ * SUBSCRIBE, or a larger value for none.
+ */
+static void receiveSubAcks( const size_t * filterCounts,
+                            size_t refusedFilter )
+{
+    size_t i, j;
+
+    findSubscribes();
+    networkContext.rxLength = 0U;
+    networkContext.rxIndex = 0U;
+
+    for( i = 0U; i < packetCount; i++ )
+    {
+        networkContext.rx[ networkContext.rxLength++ ] = MQTT_PACKET_TYPE_SUBACK;
+        networkContext.rx[ networkContext.rxLength++ ] = ( uint8_t ) ( 2U + filterCounts[ i ] +
+                                                                       ( ( context.protocolVersion == MQTT_VERSION_5 ) ? 4U : 0U ) );
+        networkContext.rx[ networkContext.rxLength++ ] = ( uint8_t ) ( packetIds[ i ] >> 8 );
+        networkContext.rx[ networkContext.rxLength++ ] = ( uint8_t ) packetIds[ i ];
+
+        /* An empty Reason String property. */
+        if( context.protocolVersion == MQTT_VERSION_5 )
+        {
+            networkContext.rx[ networkContext.rxLength++ ] = 3U;
+            networkContext.rx[ networkContext.rxLength++ ] = 0x1FU;
+            networkContext.rx[ networkContext.rxLength++ ] = 0U;
+            networkContext.rx[ networkContext.rxLength++ ] = 0U;
+        }
+
+        for( j = 0U; j < filterCounts[ i ]; j++ )
+        {
+            networkContext.rx[ networkContext.rxLength++ ] = ( ( i == 0U ) && ( j == refusedFilter ) ) ? 0x80U : 0x00U;
+        }
+    }
+
+    for( i = 0U; i < packetCount; i++ )
+    {
+        TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_ReceiveLoop( &context ) );
+    }
+
+    TEST_ASSERT_EQUAL( packetCount, subackCount );
+}
+
+/**
+ * @brief Whether a topic filter was sent since the last connect.
+ */
+static bool filterSent( const char * pTopicFilter )
+{
+    size_t i;
+    bool found = false;
+
+    for( i = 0U; ( found == false ) && ( ( i + FILTER_LENGTH ) <= networkContext.txLength ); i++ )
+    {
+        found = ( memcmp( &networkContext.tx[ i ], pTopicFilter, FILTER_LENGTH ) == 0 );
+    }
+
+    return found;
+}
+
+/**
+ * @brief The QoS requested for a topic filter sent since the last connect.
+ */
+static uint8_t sentQos( const char * pTopicFilter )
+{
+    size_t i;
+
+    for( i = 0U; ( i + FILTER_LENGTH ) < networkContext.txLength; i++ )
+    {
+        if( memcmp( &networkContext.tx[ i ], pTopicFilter, FILTER_LENGTH ) == 0 )
+        {
+            break;
+        }
+    }
+
+    TEST_ASSERT_LESS_THAN( networkContext.txLength, i + FILTER_LENGTH );
+
+    return networkContext.tx[ i + FILTER_LENGTH ];
+}
+
+/**
+ * @brief Subscribe to the first topic filter with the given QoS.
+ */
+static void subscribeFirst( MQTTQoS_t qos )
+{
+    networkContext.txLength = 0U;
+    subackCount = 0U;
+    subscriptionList[ 0 ].qos = qos;
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Subscribe( &context, subscriptionList, 1U, MQTT_GetPacketId( &context ) ) );
+}
+
+/**
+ * @brief Count the active records of the registry.
+ */
+static size_t countActiveRecords( void )
+{
+    size_t i, count = 0U;
+
+    for( i = 0U; i < FILTER_COUNT + 1U; i++ )
+    {
+        if( records[ i ].active == true )
+        {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/**
+ * @brief Subscribe to all the topic filters in SUBSCRIBEs of 16 topic filters,
+ * and receive their SUBACKs.
+ *
+ * @param[in] refusedFilter Index of a topic filter refused by the broker, or
+ * FILTER_COUNT for none.
+ */
+static void subscribeAll( size_t refusedFilter )
+{
+    size_t filterCounts[ 16 ];
+    size_t first, i = 0U;
+    uint16_t packetId;
+
+    for( first = 0U; first < FILTER_COUNT; first += 16U )
+    {
+        filterCounts[ i ] = ( ( FILTER_COUNT - first ) < 16U ) ? ( FILTER_COUNT - first ) : 16U;
+        packetId = MQTT_GetPacketId( &context );
+        TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Subscribe( &context, &subscriptionList[ first ], filterCounts[ i ], packetId ) );
+        i++;
+    }
+
+    findSubscribes();
+    TEST_ASSERT_EQUAL( i, packetCount );
+    receiveSubAcks( filterCounts, refusedFilter );
+    subackCount = 0U;
+    subackFilterCount = 0U;
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Invalid arguments to MQTT_InitSubscriptionRegistry.
+ */
+void test_SubscriptionRegistry_InvalidParams( void )
+{
+    MQTTFixedBuffer_t stagingBuffer = { staging, sizeof( staging ) };
+    MQTTFixedBuffer_t smallBuffer = { staging, MQTT_SUBSCRIPTION_REGISTRY_MAX_FILTER_LENGTH + 10U };
+
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_InitSubscriptionRegistry( NULL, records, 1U, &stagingBuffer ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_InitSubscriptionRegistry( &context, NULL, 1U, &stagingBuffer ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_InitSubscriptionRegistry( &context, records, 0U, &stagingBuffer ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_InitSubscriptionRegistry( &context, records, 1U, NULL ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_InitSubscriptionRegistry( &context, records, 1U, &smallBuffer ) );
+
+    initContext( MQTT_VERSION_3_1_1 );
+    connect( false );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_InitSubscriptionRegistry( &context, records, 1U, &stagingBuffer ) );
+}
+
+/**
+ * @brief Subscriptions are recorded once granted, and removed when refused or
+ * unsubscribed from.
+ */
+void test_SubscriptionRegistry_RecordFromSubAck( void )
+{
+    size_t filterCounts[ 1 ] = { 3U };
+
+    initContext( MQTT_VERSION_3_1_1 );
+    connect( false );
+
+    /* Nothing to subscribe to again yet. */
+    TEST_ASSERT_EQUAL( CONNECT_WRITES, networkContext.writeCount );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Subscribe( &context, subscriptionList, 3U, MQTT_GetPacketId( &context ) ) );
+    TEST_ASSERT_EQUAL( 0U, countActiveRecords() );
+
+    receiveSubAcks( filterCounts, 1U );
+    TEST_ASSERT_EQUAL( 3U, subackFilterCount );
+    TEST_ASSERT_EQUAL( 2U, countActiveRecords() );
+    TEST_ASSERT_EQUAL_MEMORY( filters[ 0 ], records[ 0 ].topicFilter, FILTER_LENGTH );
+    TEST_ASSERT_EQUAL_MEMORY( filters[ 2 ], records[ 2 ].topicFilter, FILTER_LENGTH );
+    TEST_ASSERT_EQUAL( 0U, records[ 1 ].topicFilterLength );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Unsubscribe( &context, subscriptionList, 1U, MQTT_GetPacketId( &context ) ) );
+    TEST_ASSERT_EQUAL( 1U, countActiveRecords() );
+    TEST_ASSERT_EQUAL( 0U, records[ 0 ].topicFilterLength );
+}
+
+/**
+ * @brief After a clean-session CONNACK, the registry is subscribed to again
+ * with SUBSCRIBEs filling the staging buffer, and the results of the topic
+ * filters are found with MQTT_GetSubAckStatusCodes.
+ */
+void test_SubscriptionRegistry_ResubscribeOnCleanSession( void )
+{
+    size_t filterCounts[ 7 ] = { 16U, 16U, 16U, 16U, 16U, 16U, 3U };
+    size_t i;
+
+    initContext( MQTT_VERSION_3_1_1 );
+    connect( false );
+
+    /* Topic filter 5 is refused and not recorded. */
+    subscribeAll( 5U );
+    TEST_ASSERT_EQUAL( FILTER_COUNT - 1U, countActiveRecords() );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Disconnect( &context ) );
+    connect( false );
+
+    /* The CONNECT, then 99 topic filters in 7 packets of a write each. */
+    TEST_ASSERT_EQUAL( CONNECT_WRITES + 7U, networkContext.writeCount );
+    TEST_ASSERT_EQUAL( 7U, packetCount );
+
+    for( i = 0U; i < FILTER_COUNT; i++ )
+    {
+        if( i != 5U )
+        {
+            TEST_ASSERT_TRUE( filterSent( filters[ i ] ) );
+        }
+    }
+
+    TEST_ASSERT_FALSE( filterSent( filters[ 5 ] ) );
+
+    /* The first topic filter is refused this time. */
+    receiveSubAcks( filterCounts, 0U );
+    TEST_ASSERT_EQUAL( FILTER_COUNT - 1U, subackFilterCount );
+
+    /* A refused SUBSCRIBE leaves an existing subscription as it was. */
+    TEST_ASSERT_EQUAL( FILTER_COUNT - 1U, countActiveRecords() );
+
+    for( i = 0U; i < FILTER_COUNT + 1U; i++ )
+    {
+        TEST_ASSERT_EQUAL( MQTT_PACKET_ID_INVALID, records[ i ].packetId );
+    }
+}
+
+/**
+ * @brief Nothing is sent when the broker has kept the session, and
+ * subscriptions without a SUBACK are forgotten with the session.
+ */
+void test_SubscriptionRegistry_SessionPresentAndPending( void )
+{
+    initContext( MQTT_VERSION_3_1_1 );
+    connect( false );
+    subscribeAll( FILTER_COUNT );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Disconnect( &context ) );
+    connect( true );
+    TEST_ASSERT_EQUAL( CONNECT_WRITES, networkContext.writeCount );
+
+    /* Subscribe again to topic filter 0, and to a new topic filter which is
+     * never acknowledged. */
+    ( void ) memcpy( filters[ 1 ], "new/filter/0", FILTER_LENGTH );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Subscribe( &context, subscriptionList, 2U, MQTT_GetPacketId( &context ) ) );
+    TEST_ASSERT_EQUAL( FILTER_COUNT, countActiveRecords() );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Disconnect( &context ) );
+    connect( false );
+
+    TEST_ASSERT_EQUAL( CONNECT_WRITES + 7U, networkContext.writeCount );
+    TEST_ASSERT_TRUE( filterSent( "dev/0000/cmd" ) );
+    TEST_ASSERT_FALSE( filterSent( "new/filter/0" ) );
+}
+
+/**
+ * @brief A SUBSCRIBE to a recorded topic filter changes its QoS only once a
+ * SUBACK grants it.
+ */
+void test_SubscriptionRegistry_QoSOnSubAck( void )
+{
+    size_t filterCounts[ 1 ] = { 1U };
+    MQTTPubAckInfo_t outgoingRecords[ 1 ];
+    MQTTPubAckInfo_t incomingRecords[ 1 ];
+
+    initContext( MQTT_VERSION_3_1_1 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_InitStatefulQoS( &context, outgoingRecords, 1U, incomingRecords, 1U ) );
+    connect( false );
+
+    subscribeFirst( MQTTQoS0 );
+    receiveSubAcks( filterCounts, FILTER_COUNT );
+    TEST_ASSERT_EQUAL( MQTTQoS0, records[ 0 ].qos );
+
+    /* Refused. */
+    subscribeFirst( MQTTQoS1 );
+    TEST_ASSERT_EQUAL( MQTTQoS0, records[ 0 ].qos );
+    receiveSubAcks( filterCounts, 0U );
+    TEST_ASSERT_EQUAL( MQTTQoS0, records[ 0 ].qos );
+    TEST_ASSERT_TRUE( records[ 0 ].active );
+
+    /* Never acknowledged. */
+    subscribeFirst( MQTTQoS2 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Disconnect( &context ) );
+    connect( false );
+    TEST_ASSERT_EQUAL( 1U, packetCount );
+    TEST_ASSERT_EQUAL( MQTTQoS0, sentQos( filters[ 0 ] ) );
+    receiveSubAcks( filterCounts, FILTER_COUNT );
+
+    /* Granted. */
+    subscribeFirst( MQTTQoS1 );
+    receiveSubAcks( filterCounts, FILTER_COUNT );
+    TEST_ASSERT_EQUAL( MQTTQoS1, records[ 0 ].qos );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Disconnect( &context ) );
+    connect( false );
+    TEST_ASSERT_EQUAL( MQTTQoS1, sentQos( filters[ 0 ] ) );
+}
+
+/**
+ * @brief The registry is subscribed to again with MQTT 5 packets, and reads
+ * the return codes of MQTT 5 SUBACKs after their properties.
+ */
+void test_SubscriptionRegistry_V5( void )
+{
+    size_t filterCounts[ 7 ] = { 16U, 16U, 16U, 16U, 16U, 16U, 3U };
+    size_t offset;
+
+    initContext( MQTT_VERSION_5 );
+    connect( false );
+    subscribeAll( 0U );
+    TEST_ASSERT_EQUAL( FILTER_COUNT - 1U, countActiveRecords() );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Disconnect( &context ) );
+    connect( false );
+    TEST_ASSERT_EQUAL( 7U, packetCount );
+
+    /* The first SUBSCRIBE has 16 topic filters of 15 bytes, the packet ID and
+     * an empty property length. */
+    offset = packetOffsets[ 0 ];
+
+    TEST_ASSERT_EQUAL_HEX8( 0xF3U, networkContext.tx[ offset + 1U ] );
+    TEST_ASSERT_EQUAL_HEX8( 0x01U, networkContext.tx[ offset + 2U ] );
+    TEST_ASSERT_EQUAL_HEX8( 0x00U, networkContext.tx[ offset + 5U ] );
+    TEST_ASSERT_EQUAL_MEMORY( "dev/0001/cmd", &networkContext.tx[ offset + 8U ], FILTER_LENGTH );
+
+    receiveSubAcks( filterCounts, FILTER_COUNT );
+    TEST_ASSERT_EQUAL( FILTER_COUNT - 1U, countActiveRecords() );
+}
+
+/**
+ * @brief The Subscription Identifier of a subscription is kept in the registry
+ * and sent again, with the topic filters of the same identifier grouped into a
+ * SUBSCRIBE.
+ */
+void test_SubscriptionRegistry_SubscriptionIdV5( void )
+{
+    size_t filterCounts[ 4 ] = { 1U, 1U, 1U, 1U };
+    size_t resubscribeCounts[ 3 ] = { 2U, 1U, 1U };
+    size_t offset;
+
+    initContext( MQTT_VERSION_5 );
+    connect( false );
+
+    /* Topic filters 0 and 2 with identifier 5, 1 with identifier 300 and 3
+     * without one. */
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_SubscribeWithId( &context, &subscriptionList[ 0 ], 1U, MQTT_GetPacketId( &context ), 5U ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_SubscribeWithId( &context, &subscriptionList[ 1 ], 1U, MQTT_GetPacketId( &context ), 300U ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_SubscribeWithId( &context, &subscriptionList[ 2 ], 1U, MQTT_GetPacketId( &context ), 5U ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Subscribe( &context, &subscriptionList[ 3 ], 1U, MQTT_GetPacketId( &context ) ) );
+    receiveSubAcks( filterCounts, FILTER_COUNT );
+    TEST_ASSERT_EQUAL( 4U, countActiveRecords() );
+    TEST_ASSERT_EQUAL( 5U, records[ 0 ].subscriptionId );
+    TEST_ASSERT_EQUAL( 300U, records[ 1 ].subscriptionId );
+    TEST_ASSERT_EQUAL( 0U, records[ 3 ].subscriptionId );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Disconnect( &context ) );
+    subackCount = 0U;
+    connect( false );
+    TEST_ASSERT_EQUAL( 3U, packetCount );
+
+    /* The first SUBSCRIBE has identifier 5 and topic filters 0 and 2. */
+    offset = packetOffsets[ 0 ];
+
+    TEST_ASSERT_EQUAL_HEX8( 35U, networkContext.tx[ offset + 1U ] );
+    TEST_ASSERT_EQUAL_HEX8( 2U, networkContext.tx[ offset + 4U ] );
+    TEST_ASSERT_EQUAL_HEX8( 0x0BU, networkContext.tx[ offset + 5U ] );
+    TEST_ASSERT_EQUAL_HEX8( 5U, networkContext.tx[ offset + 6U ] );
+    TEST_ASSERT_EQUAL_MEMORY( "dev/0000/cmd", &networkContext.tx[ offset + 9U ], FILTER_LENGTH );
+    TEST_ASSERT_EQUAL_MEMORY( "dev/0002/cmd", &networkContext.tx[ offset + 24U ], FILTER_LENGTH );
+
+    /* The second has identifier 300 and topic filter 1. */
+    offset = packetOffsets[ 1 ];
+    TEST_ASSERT_EQUAL_HEX8( 21U, networkContext.tx[ offset + 1U ] );
+    TEST_ASSERT_EQUAL_HEX8( 3U, networkContext.tx[ offset + 4U ] );
+    TEST_ASSERT_EQUAL_HEX8( 0x0BU, networkContext.tx[ offset + 5U ] );
+    TEST_ASSERT_EQUAL_HEX8( 0xACU, networkContext.tx[ offset + 6U ] );
+    TEST_ASSERT_EQUAL_HEX8( 0x02U, networkContext.tx[ offset + 7U ] );
+    TEST_ASSERT_EQUAL_MEMORY( "dev/0001/cmd", &networkContext.tx[ offset + 10U ], FILTER_LENGTH );
+
+    /* The last has no properties and topic filter 3. */
+    offset = packetOffsets[ 2 ];
+    TEST_ASSERT_EQUAL_HEX8( 18U, networkContext.tx[ offset + 1U ] );
+    TEST_ASSERT_EQUAL_HEX8( 0U, networkContext.tx[ offset + 4U ] );
+    TEST_ASSERT_EQUAL_MEMORY( "dev/0003/cmd", &networkContext.tx[ offset + 7U ], FILTER_LENGTH );
+    TEST_ASSERT_EQUAL( networkContext.txLength, offset + 2U + networkContext.tx[ offset + 1U ] );
+
+    receiveSubAcks( resubscribeCounts, FILTER_COUNT );
+    TEST_ASSERT_EQUAL( 4U, countActiveRecords() );
+    TEST_ASSERT_EQUAL( 5U, records[ 2 ].subscriptionId );
+    TEST_ASSERT_EQUAL( 300U, records[ 1 ].subscriptionId );
+}
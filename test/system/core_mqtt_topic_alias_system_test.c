@@ -0,0 +1,433 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file core_mqtt_topic_alias_system_test.c
+ * @brief System tests of MQTT 5 connections and topic aliases over the replay
+ * transport.
+ */
+
+#include <string.h>
+
+#include "unity.h"
+
+#include "core_mqtt.h"
+
+#include "replay_transport.h"
+
+/**
+ * @brief The context and its transport.
+ */
+static MQTTContext_t context;
+static NetworkContext_t networkContext;
+static uint8_t buffer[ 128 ];
+static MQTTTopicAliasRecord_t topicAliases[ 4 ];
+
+/**
+ * @brief The last publish given to the event callback.
+ */
+static MQTTPublishInfo_t receivedPublish;
+static uint32_t receivedPublishCount;
+
+/* ============================   UNITY FIXTURES ============================ */
+
+/* Called before each test method. */
+void setUp( void )
+{
+    ( void ) memset( &context, 0x00, sizeof( context ) );
+    ( void ) memset( &networkContext, 0x00, sizeof( networkContext ) );
+    ( void ) memset( &receivedPublish, 0x00, sizeof( receivedPublish ) );
+    receivedPublishCount = 0U;
+}
+
+/* Called after each test method. */
+void tearDown( void )
+{
+}
+
+/* Called at the beginning of the whole suite. */
+void suiteSetUp()
+{
+}
+
+/* Called at the end of the whole suite. */
+int suiteTearDown( int numFailures )
+{
+    return numFailures;
+}
+
+/* ========================================================================== */
+
+static void eventCallback( MQTTContext_t * pContext,
+                           MQTTPacketInfo_t * pPacketInfo,
+                           MQTTDeserializedInfo_t * pDeserializedInfo )
+{
+    ( void ) pContext;
+
+    if( ( pPacketInfo->type & 0xF0U ) == MQTT_PACKET_TYPE_PUBLISH )
+    {
+        receivedPublish = *pDeserializedInfo->pPublishInfo;
+        receivedPublishCount++;
+    }
+}
+
+static bool storePacket( MQTTContext_t * pContext,
+                         uint16_t packetId,
+                         MQTTVec_t * pMqttVec )
+{
+    ( void ) pContext;
+    ( void ) packetId;
+    ( void ) pMqttVec;
+
+    return true;
+}
+
+static bool retrievePacket( MQTTContext_t * pContext,
+                            uint16_t packetId,
+                            uint8_t ** pSerializedMqttVec,
+                            size_t * pSerializedMqttVecLen )
+{
+    ( void ) pContext;
+    ( void ) packetId;
+    ( void ) pSerializedMqttVec;
+    ( void ) pSerializedMqttVecLen;
+
+    return false;
+}
+
+static void clearPacket( MQTTContext_t * pContext,
+                         uint16_t packetId )
+{
+    ( void ) pContext;
+    ( void ) packetId;
+}
+
+/**
+ * @brief Initialize the context for MQTT 5 with topic aliases.
+ */
+static void initContextV5( void )
+{
+    MQTTFixedBuffer_t networkBuffer = { buffer, sizeof( buffer ) };
+
+    ReplayTransport_InitContext( &context, &networkContext, eventCallback, &networkBuffer, MQTT_VERSION_5 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_InitTopicAliases( &context, topicAliases, 4U ) );
+}
+
+/**
+ * @brief Connect with a CONNACK carrying a Topic Alias Maximum.
+ */
+static void connectV5( uint16_t topicAliasMaximum )
+{
+    MQTTConnectInfo_t connectInfo = { 0 };
+    bool sessionPresent = true;
+    const uint8_t connack[] = { 0x20, 0x06, 0x00, 0x00, 0x03, 0x22,
+                                ( uint8_t ) ( topicAliasMaximum >> 8 ),
+                                ( uint8_t ) topicAliasMaximum };
+
+    ReplayTransport_SetRx( &networkContext, connack, sizeof( connack ) );
+
+    connectInfo.cleanSession = true;
+    connectInfo.pClientIdentifier = "alias";
+    connectInfo.clientIdentifierLength = 5U;
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Connect( &context, &connectInfo, NULL, 0U, &sessionPresent ) );
+    TEST_ASSERT_FALSE( sessionPresent );
+}
+
+/**
+ * @brief Publish "x" to a topic and return the topic alias sent, checking
+ * that the topic name was sent only when the alias was not known.
+ */
+static uint16_t publishAndGetAlias( const char * pTopicName,
+                                    bool expectTopicName )
+{
+    MQTTPublishInfo_t publishInfo = { 0 };
+    uint16_t topicNameLength = ( uint16_t ) strlen( pTopicName );
+    uint16_t sentTopicLength;
+    const uint8_t * pProperties;
+    uint16_t topicAlias = 0U;
+
+    publishInfo.qos = MQTTQoS0;
+    publishInfo.pTopicName = pTopicName;
+    publishInfo.topicNameLength = topicNameLength;
+    publishInfo.pPayload = "x";
+    publishInfo.payloadLength = 1U;
+
+    networkContext.txLength = 0U;
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Publish( &context, &publishInfo, 0U ) );
+
+    /* The remaining length fits in one byte in these tests. */
+    TEST_ASSERT_EQUAL_HEX8( MQTT_PACKET_TYPE_PUBLISH, networkContext.tx[ 0 ] );
+    TEST_ASSERT_EQUAL( networkContext.txLength - 2U, networkContext.tx[ 1 ] );
+
+    sentTopicLength = ( uint16_t ) ( ( networkContext.tx[ 2 ] << 8 ) | networkContext.tx[ 3 ] );
+    TEST_ASSERT_EQUAL( expectTopicName ? topicNameLength : 0U, sentTopicLength );
+    TEST_ASSERT_EQUAL_MEMORY( pTopicName, &networkContext.tx[ 4 ], sentTopicLength );
+
+    pProperties = &networkContext.tx[ 4U + sentTopicLength ];
+
+    if( pProperties[ 0 ] != 0U )
+    {
+        TEST_ASSERT_EQUAL_HEX8( 3U, pProperties[ 0 ] );
+        TEST_ASSERT_EQUAL_HEX8( 0x23U, pProperties[ 1 ] );
+        topicAlias = ( uint16_t ) ( ( pProperties[ 2 ] << 8 ) | pProperties[ 3 ] );
+        TEST_ASSERT_EQUAL_PTR( &networkContext.tx[ networkContext.txLength - 1U ], &pProperties[ 4 ] );
+    }
+    else
+    {
+        TEST_ASSERT_EQUAL_PTR( &networkContext.tx[ networkContext.txLength - 1U ], &pProperties[ 1 ] );
+    }
+
+    TEST_ASSERT_EQUAL_HEX8( 'x', networkContext.tx[ networkContext.txLength - 1U ] );
+
+    return topicAlias;
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Invalid parameters of the protocol version and topic alias functions.
+ */
+void test_TopicAlias_InvalidParams( void )
+{
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { buffer, sizeof( buffer ) };
+
+    transport.pNetworkContext = &networkContext;
+    transport.recv = ReplayTransport_Recv;
+    transport.send = ReplayTransport_Send;
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Init( &context, &transport, ReplayTransport_GetTimeMs, eventCallback, &networkBuffer ) );
+    TEST_ASSERT_EQUAL( MQTT_VERSION_3_1_1, context.protocolVersion );
+
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_SetProtocolVersion( NULL, MQTT_VERSION_5 ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_SetProtocolVersion( &context, 3U ) );
+
+    /* Topic aliases need MQTT 5. */
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_InitTopicAliases( &context, topicAliases, 4U ) );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_SetProtocolVersion( &context, MQTT_VERSION_5 ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_InitTopicAliases( NULL, topicAliases, 4U ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_InitTopicAliases( &context, NULL, 4U ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_InitTopicAliases( &context, topicAliases, 0U ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_InitTopicAliases( &context, topicAliases, UINT16_MAX + 1UL ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_InitTopicAliases( &context, topicAliases, 4U ) );
+
+    /* Neither can change while connected. */
+    connectV5( 4U );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_SetProtocolVersion( &context, MQTT_VERSION_3_1_1 ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_InitTopicAliases( &context, topicAliases, 4U ) );
+}
+
+/**
+ * @brief The CONNECT of MQTT 5 and the properties of the CONNACK.
+ */
+void test_TopicAlias_ConnectV5( void )
+{
+    MQTTConnectInfo_t connectInfo = { 0 };
+    MQTTPublishInfo_t willInfo = { 0 };
+    bool sessionPresent = true;
+
+    /* Server Keep Alive of 5 seconds. */
+    const uint8_t connack[] = { 0x20, 0x06, 0x00, 0x00, 0x03, 0x13, 0x00, 0x05 };
+
+    /* CONNECT of MQTT 5 with a will message, both without properties. */
+    const uint8_t connect[] = { 0x10, 0x1A,
+                                0x00, 0x04, 'M', 'Q', 'T', 'T', 0x05, 0x06, 0x00, 0x3C, 0x00,
+                                0x00, 0x05, 'a', 'l', 'i', 'a', 's',
+                                0x00,
+                                0x00, 0x01, 'w',
+                                0x00, 0x02, 'b', 'y' };
+
+    initContextV5();
+
+    ReplayTransport_SetRx( &networkContext, connack, sizeof( connack ) );
+
+    connectInfo.cleanSession = true;
+    connectInfo.keepAliveSeconds = 60U;
+    connectInfo.pClientIdentifier = "alias";
+    connectInfo.clientIdentifierLength = 5U;
+    willInfo.pTopicName = "w";
+    willInfo.topicNameLength = 1U;
+    willInfo.pPayload = "by";
+    willInfo.payloadLength = 2U;
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Connect( &context, &connectInfo, &willInfo, 0U, &sessionPresent ) );
+
+    TEST_ASSERT_EQUAL( sizeof( connect ), networkContext.txLength );
+    TEST_ASSERT_EQUAL_MEMORY( connect, networkContext.tx, sizeof( connect ) );
+
+    /* The broker overrides the keep-alive interval and allows no aliases. */
+    TEST_ASSERT_EQUAL_UINT16( 5U, context.keepAliveIntervalSec );
+    TEST_ASSERT_EQUAL_UINT16( 0U, context.topicAliasCount );
+    TEST_ASSERT_EQUAL_UINT16( 0U, publishAndGetAlias( "a/b", true ) );
+    TEST_ASSERT_EQUAL_UINT16( 0U, publishAndGetAlias( "a/b", true ) );
+}
+
+/**
+ * @brief A repeated topic is sent as an empty topic name and its alias.
+ */
+void test_TopicAlias_RepeatTopicUsesAlias( void )
+{
+    /* Topic "a/b" with alias 1 and payload "x", then only the alias. */
+    const uint8_t first[] = { 0x30, 0x0A, 0x00, 0x03, 'a', '/', 'b', 0x03, 0x23, 0x00, 0x01, 'x' };
+    const uint8_t repeat[] = { 0x30, 0x07, 0x00, 0x00, 0x03, 0x23, 0x00, 0x01, 'x' };
+
+    initContextV5();
+    connectV5( 10U );
+
+    /* The smaller of the records and the maximum of the broker is used. */
+    TEST_ASSERT_EQUAL_UINT16( 4U, context.topicAliasCount );
+
+    TEST_ASSERT_EQUAL_UINT16( 1U, publishAndGetAlias( "a/b", true ) );
+    TEST_ASSERT_EQUAL_MEMORY( first, networkContext.tx, sizeof( first ) );
+
+    TEST_ASSERT_EQUAL_UINT16( 1U, publishAndGetAlias( "a/b", false ) );
+    TEST_ASSERT_EQUAL( sizeof( repeat ), networkContext.txLength );
+    TEST_ASSERT_EQUAL_MEMORY( repeat, networkContext.tx, sizeof( repeat ) );
+
+    /* A topic sharing a prefix gets an alias of its own. */
+    TEST_ASSERT_EQUAL_UINT16( 2U, publishAndGetAlias( "a/bc", true ) );
+    TEST_ASSERT_EQUAL_UINT16( 1U, publishAndGetAlias( "a/b", false ) );
+    TEST_ASSERT_EQUAL_UINT16( 2U, publishAndGetAlias( "a/bc", false ) );
+}
+
+/**
+ * @brief The least recently used alias is replaced when all are assigned.
+ */
+void test_TopicAlias_LruEviction( void )
+{
+    initContextV5();
+    connectV5( 2U );
+
+    TEST_ASSERT_EQUAL_UINT16( 1U, publishAndGetAlias( "t/a", true ) );
+    TEST_ASSERT_EQUAL_UINT16( 2U, publishAndGetAlias( "t/b", true ) );
+    TEST_ASSERT_EQUAL_UINT16( 1U, publishAndGetAlias( "t/a", false ) );
+
+    /* "t/b" is the least recently used. */
+    TEST_ASSERT_EQUAL_UINT16( 2U, publishAndGetAlias( "t/c", true ) );
+    TEST_ASSERT_EQUAL_UINT16( 1U, publishAndGetAlias( "t/a", false ) );
+    TEST_ASSERT_EQUAL_UINT16( 2U, publishAndGetAlias( "t/c", false ) );
+
+    /* Now "t/a" is. */
+    TEST_ASSERT_EQUAL_UINT16( 1U, publishAndGetAlias( "t/b", true ) );
+    TEST_ASSERT_EQUAL_UINT16( 2U, publishAndGetAlias( "t/a", true ) );
+}
+
+/**
+ * @brief Aliases are forgotten on a new connection, including one assigned by
+ * a publish which failed to send.
+ */
+void test_TopicAlias_ReconnectAfterSendFailure( void )
+{
+    MQTTPublishInfo_t publishInfo = { 0 };
+
+    initContextV5();
+    connectV5( 4U );
+
+    TEST_ASSERT_EQUAL_UINT16( 1U, publishAndGetAlias( "t/a", true ) );
+
+    publishInfo.qos = MQTTQoS0;
+    publishInfo.pTopicName = "t/b";
+    publishInfo.topicNameLength = 3U;
+    networkContext.failSend = true;
+    TEST_ASSERT_EQUAL( MQTTSendFailed, MQTT_Publish( &context, &publishInfo, 0U ) );
+    networkContext.failSend = false;
+
+    TEST_ASSERT_EQUAL( MQTTStatusDisconnectPending, MQTT_Publish( &context, &publishInfo, 0U ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Disconnect( &context ) );
+    connectV5( 4U );
+
+    TEST_ASSERT_EQUAL_UINT16( 1U, publishAndGetAlias( "t/b", true ) );
+    TEST_ASSERT_EQUAL_UINT16( 2U, publishAndGetAlias( "t/a", true ) );
+    TEST_ASSERT_EQUAL_UINT16( 1U, publishAndGetAlias( "t/b", false ) );
+}
+
+/**
+ * @brief Topics too long for the records, and QoS1 publishes stored for
+ * retransmission, are sent without an alias.
+ */
+void test_TopicAlias_NotUsed( void )
+{
+    static char longTopic[ MQTT_TOPIC_ALIAS_MAX_TOPIC_LENGTH + 2U ];
+    static MQTTPubAckInfo_t outgoingRecords[ 2 ];
+    static MQTTPubAckInfo_t incomingRecords[ 2 ];
+    MQTTPublishInfo_t publishInfo = { 0 };
+
+    ( void ) memset( longTopic, 'l', sizeof( longTopic ) - 1U );
+
+    initContextV5();
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_InitStatefulQoS( &context, outgoingRecords, 2U, incomingRecords, 2U ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_InitRetransmits( &context, storePacket, retrievePacket, clearPacket ) );
+    connectV5( 4U );
+
+    publishInfo.qos = MQTTQoS0;
+    publishInfo.pTopicName = longTopic;
+    publishInfo.topicNameLength = ( uint16_t ) strlen( longTopic );
+    networkContext.txLength = 0U;
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Publish( &context, &publishInfo, 0U ) );
+
+    /* Fixed header of 3 bytes, topic, empty properties. */
+    TEST_ASSERT_EQUAL( 3U + 2U + publishInfo.topicNameLength + 1U, networkContext.txLength );
+    TEST_ASSERT_EQUAL_HEX8( 0U, networkContext.tx[ networkContext.txLength - 1U ] );
+
+    /* QoS1 with a store function: topic name, packet ID, empty properties. */
+    publishInfo.qos = MQTTQoS1;
+    publishInfo.pTopicName = "t/a";
+    publishInfo.topicNameLength = 3U;
+    networkContext.txLength = 0U;
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Publish( &context, &publishInfo, 1U ) );
+    TEST_ASSERT_EQUAL( 2U + 2U + 3U + 2U + 1U, networkContext.txLength );
+    TEST_ASSERT_EQUAL_HEX8( 0U, networkContext.tx[ networkContext.txLength - 1U ] );
+}
+
+/**
+ * @brief Incoming MQTT 5 publishes are given to the application without
+ * their properties.
+ */
+void test_TopicAlias_IncomingPublish( void )
+{
+    /* Topic "in", a Payload Format Indicator property and payload "hey". */
+    const uint8_t publish[] = { 0x30, 0x0A, 0x00, 0x02, 'i', 'n', 0x02, 0x01, 0x01, 'h', 'e', 'y' };
+
+    /* The same with a Topic Alias, which the client does not accept. */
+    const uint8_t publishWithAlias[] = { 0x30, 0x0B, 0x00, 0x02, 'i', 'n', 0x03, 0x23, 0x00, 0x01, 'h', 'e', 'y' };
+
+    initContextV5();
+    connectV5( 4U );
+
+    ReplayTransport_SetRx( &networkContext, publish, sizeof( publish ) );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_ProcessLoop( &context ) );
+    TEST_ASSERT_EQUAL( 1U, receivedPublishCount );
+    TEST_ASSERT_EQUAL_UINT16( 2U, receivedPublish.topicNameLength );
+    TEST_ASSERT_EQUAL_MEMORY( "in", receivedPublish.pTopicName, 2U );
+    TEST_ASSERT_EQUAL( 3U, receivedPublish.payloadLength );
+    TEST_ASSERT_EQUAL_MEMORY( "hey", receivedPublish.pPayload, 3U );
+
+    ReplayTransport_SetRx( &networkContext, publishWithAlias, sizeof( publishWithAlias ) );
+
+    TEST_ASSERT_EQUAL( MQTTBadResponse, MQTT_ProcessLoop( &context ) );
+    TEST_ASSERT_EQUAL( 1U, receivedPublishCount );
+}
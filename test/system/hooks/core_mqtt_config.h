@@ -0,0 +1,51 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file core_mqtt_config.h
+ * @brief Configuration of the MQTT library for the hooks system test, which
+ * defines the send and state update hooks as mutexes.
+ */
+#ifndef CORE_MQTT_CONFIG_H_
+#define CORE_MQTT_CONFIG_H_
+
+/**
+ * @cond DOXYGEN_IGNORE
+ * Forward declaration of the context given to the hooks.
+ */
+struct MQTTContext;
+/** @endcond */
+
+/* Hook functions defined by the test. */
+void SystemTestHooks_LockSend( const struct MQTTContext * pContext );
+void SystemTestHooks_UnlockSend( const struct MQTTContext * pContext );
+void SystemTestHooks_LockState( const struct MQTTContext * pContext );
+void SystemTestHooks_UnlockState( const struct MQTTContext * pContext );
+
+#define MQTT_PRE_SEND_HOOK( pContext )             SystemTestHooks_LockSend( pContext )
+#define MQTT_POST_SEND_HOOK( pContext )            SystemTestHooks_UnlockSend( pContext )
+#define MQTT_PRE_STATE_UPDATE_HOOK( pContext )     SystemTestHooks_LockState( pContext )
+#define MQTT_POST_STATE_UPDATE_HOOK( pContext )    SystemTestHooks_UnlockState( pContext )
+
+#endif /* ifndef CORE_MQTT_CONFIG_H_ */
@@ -0,0 +1,179 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file replay_transport.c
+ * @brief Implementation of the replay transport of the system tests.
+ */
+
+#include <string.h>
+
+#include "unity.h"
+
+#include "replay_transport.h"
+
+/*-----------------------------------------------------------*/
+
+uint32_t ReplayTransport_GetTimeMs( void )
+{
+    return 0U;
+}
+
+/*-----------------------------------------------------------*/
+
+int32_t ReplayTransport_Recv( NetworkContext_t * pNetworkContext,
+                              void * pBuffer,
+                              size_t bytesToRecv )
+{
+    size_t available = pNetworkContext->rxLength - pNetworkContext->rxIndex;
+
+    if( bytesToRecv > available )
+    {
+        bytesToRecv = available;
+    }
+
+    ( void ) memcpy( pBuffer, &pNetworkContext->rx[ pNetworkContext->rxIndex ], bytesToRecv );
+    pNetworkContext->rxIndex += bytesToRecv;
+
+    return ( int32_t ) bytesToRecv;
+}
+
+/*-----------------------------------------------------------*/
+
+int32_t ReplayTransport_Send( NetworkContext_t * pNetworkContext,
+                              const void * pBuffer,
+                              size_t bytesToSend )
+{
+    int32_t bytesSent = -1;
+
+    pNetworkContext->writeCount++;
+
+    if( pNetworkContext->failSend == false )
+    {
+        TEST_ASSERT_LESS_OR_EQUAL( sizeof( pNetworkContext->tx ), pNetworkContext->txLength + bytesToSend );
+        ( void ) memcpy( &pNetworkContext->tx[ pNetworkContext->txLength ], pBuffer, bytesToSend );
+        pNetworkContext->txLength += bytesToSend;
+        bytesSent = ( int32_t ) bytesToSend;
+    }
+
+    return bytesSent;
+}
+
+/*-----------------------------------------------------------*/
+
+void ReplayTransport_InitContext( MQTTContext_t * pContext,
+                                  NetworkContext_t * pNetworkContext,
+                                  MQTTEventCallback_t eventCallback,
+                                  const MQTTFixedBuffer_t * pNetworkBuffer,
+                                  uint8_t protocolVersion )
+{
+    TransportInterface_t transport = { 0 };
+
+    transport.pNetworkContext = pNetworkContext;
+    transport.recv = ReplayTransport_Recv;
+    transport.send = ReplayTransport_Send;
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Init( pContext, &transport, ReplayTransport_GetTimeMs, eventCallback, pNetworkBuffer ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_SetProtocolVersion( pContext, protocolVersion ) );
+}
+
+/*-----------------------------------------------------------*/
+
+void ReplayTransport_SetRx( NetworkContext_t * pNetworkContext,
+                            const uint8_t * pPackets,
+                            size_t length )
+{
+    TEST_ASSERT_LESS_OR_EQUAL( sizeof( pNetworkContext->rx ), length );
+    ( void ) memcpy( pNetworkContext->rx, pPackets, length );
+    pNetworkContext->rxLength = length;
+    pNetworkContext->rxIndex = 0U;
+}
+
+/*-----------------------------------------------------------*/
+
+void ReplayTransport_Connect( MQTTContext_t * pContext,
+                              const char * pClientIdentifier,
+                              bool sessionPresent )
+{
+    MQTTConnectInfo_t connectInfo = { 0 };
+    bool sessionPresentResult = !sessionPresent;
+    uint8_t connack[] = { MQTT_PACKET_TYPE_CONNACK, 0x02U, 0x00U, 0x00U, 0x00U };
+
+    connack[ 2 ] = ( sessionPresent == true ) ? 1U : 0U;
+
+    /* An MQTT 5 CONNACK has an empty property length. */
+    if( pContext->protocolVersion == MQTT_VERSION_5 )
+    {
+        connack[ 1 ] = 0x03U;
+        ReplayTransport_SetRx( pContext->transportInterface.pNetworkContext, connack, sizeof( connack ) );
+    }
+    else
+    {
+        ReplayTransport_SetRx( pContext->transportInterface.pNetworkContext, connack, sizeof( connack ) - 1U );
+    }
+
+    connectInfo.cleanSession = !sessionPresent;
+    connectInfo.pClientIdentifier = pClientIdentifier;
+    connectInfo.clientIdentifierLength = ( uint16_t ) strlen( pClientIdentifier );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Connect( pContext, &connectInfo, NULL, 0U, &sessionPresentResult ) );
+    TEST_ASSERT_EQUAL( sessionPresent, sessionPresentResult );
+}
+
+/*-----------------------------------------------------------*/
+
+size_t ReplayTransport_FindSentPackets( const NetworkContext_t * pNetworkContext,
+                                        uint8_t packetType,
+                                        size_t * pOffsets,
+                                        size_t maxCount )
+{
+    size_t offset = 0U, index, remainingLength, shift, count = 0U;
+
+    while( offset < pNetworkContext->txLength )
+    {
+        index = offset + 1U;
+        remainingLength = 0U;
+        shift = 0U;
+
+        do
+        {
+            TEST_ASSERT_LESS_THAN( pNetworkContext->txLength, index );
+            remainingLength |= ( size_t ) ( pNetworkContext->tx[ index ] & 0x7FU ) << shift;
+            shift += 7U;
+            index++;
+        } while( ( pNetworkContext->tx[ index - 1U ] & 0x80U ) != 0U );
+
+        if( ( ( pNetworkContext->tx[ offset ] & 0xF0U ) == ( packetType & 0xF0U ) ) && ( count < maxCount ) )
+        {
+            pOffsets[ count ] = offset;
+            count++;
+        }
+
+        offset = index + remainingLength;
+    }
+
+    TEST_ASSERT_EQUAL( pNetworkContext->txLength, offset );
+
+    return count;
+}
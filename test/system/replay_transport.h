@@ -0,0 +1,125 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file replay_transport.h
+ * @brief A transport for system tests which replays the packets of a broker
+ * from memory and records the packets sent, with helpers to set up and
+ * connect a context over it.
+ */
+#ifndef REPLAY_TRANSPORT_H_
+#define REPLAY_TRANSPORT_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core_mqtt.h"
+
+/**
+ * @brief Size of the packets of the broker which can be replayed at once.
+ */
+#define REPLAY_TRANSPORT_RX_SIZE    ( 512U )
+
+/**
+ * @brief Size of the record of the packets sent.
+ */
+#define REPLAY_TRANSPORT_TX_SIZE    ( 96U * 1024U )
+
+/**
+ * @brief The transport replays the packets in rx and records the packets sent
+ * in tx.
+ */
+struct NetworkContext
+{
+    uint8_t rx[ REPLAY_TRANSPORT_RX_SIZE ];
+    size_t rxLength;
+    size_t rxIndex;
+    uint8_t tx[ REPLAY_TRANSPORT_TX_SIZE ];
+    size_t txLength;
+    size_t writeCount; /**< @brief The number of writes, including failed ones. */
+    bool failSend;     /**< @brief Whether writes fail. */
+};
+
+/**
+ * @brief The time of the tests, which never advances.
+ */
+uint32_t ReplayTransport_GetTimeMs( void );
+
+/**
+ * @brief Read the packets replayed by the transport.
+ */
+int32_t ReplayTransport_Recv( NetworkContext_t * pNetworkContext,
+                              void * pBuffer,
+                              size_t bytesToRecv );
+
+/**
+ * @brief Record the bytes sent, or fail if NetworkContext.failSend is set.
+ */
+int32_t ReplayTransport_Send( NetworkContext_t * pNetworkContext,
+                              const void * pBuffer,
+                              size_t bytesToSend );
+
+/**
+ * @brief Initialize a context over the transport for the given protocol
+ * version.
+ */
+void ReplayTransport_InitContext( MQTTContext_t * pContext,
+                                  NetworkContext_t * pNetworkContext,
+                                  MQTTEventCallback_t eventCallback,
+                                  const MQTTFixedBuffer_t * pNetworkBuffer,
+                                  uint8_t protocolVersion );
+
+/**
+ * @brief Replace the packets replayed by the transport.
+ */
+void ReplayTransport_SetRx( NetworkContext_t * pNetworkContext,
+                            const uint8_t * pPackets,
+                            size_t length );
+
+/**
+ * @brief Connect a context with a CONNACK of its protocol version, without
+ * properties, carrying the given session present flag. A clean session is
+ * requested unless the session is expected to be present.
+ */
+void ReplayTransport_Connect( MQTTContext_t * pContext,
+                              const char * pClientIdentifier,
+                              bool sessionPresent );
+
+/**
+ * @brief Find the packets of a type recorded in tx.
+ *
+ * @param[in] pNetworkContext The transport.
+ * @param[in] packetType The type of the packets, whose flags are ignored.
+ * @param[out] pOffsets The offsets of the packets found in tx.
+ * @param[in] maxCount The capacity of @p pOffsets.
+ *
+ * @return The number of packets found, at most @p maxCount.
+ */
+size_t ReplayTransport_FindSentPackets( const NetworkContext_t * pNetworkContext,
+                                        uint8_t packetType,
+                                        size_t * pOffsets,
+                                        size_t maxCount );
+
+#endif /* ifndef REPLAY_TRANSPORT_H_ */
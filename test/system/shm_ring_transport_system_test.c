@@ -0,0 +1,521 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file shm_ring_transport_system_test.c
+ * @brief System tests of the shared memory ring transport, with both sides in
+ * one process.
+ */
+
+/* MAP_ANONYMOUS is not part of POSIX. */
+#define _DEFAULT_SOURCE
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+
+#include "unity.h"
+
+#include "core_mqtt.h"
+#include "shm_ring_transport.h"
+
+/**
+ * @brief Each compilation unit that uses the transport must define the
+ * NetworkContext struct.
+ */
+struct NetworkContext
+{
+    ShmRingTransportParams_t * pParams;
+};
+
+/**
+ * @brief Size of each ring of the tests, small so that the tests wrap around
+ * it.
+ */
+#define RING_SIZE            ( 64U )
+
+/**
+ * @brief Time to wait for the peer.
+ */
+#define WAIT_TIMEOUT_MS      ( 1000U )
+
+/**
+ * @brief Number of publishes of the MQTT test.
+ */
+#define PUBLISH_COUNT        ( 1000U )
+
+/**
+ * @brief One side of the segment of the tests.
+ */
+typedef struct TestSide
+{
+    ShmRingTransportParams_t params;
+    NetworkContext_t networkContext;
+    size_t bytesReceived;
+} TestSide_t;
+
+static void * pSegment = NULL;
+static size_t segmentSize = 0U;
+static TestSide_t client;
+static TestSide_t server;
+
+/* ============================   UNITY FIXTURES ============================ */
+
+/* Called before each test method. */
+void setUp( void )
+{
+    segmentSize = ShmRingTransport_SegmentSize( RING_SIZE );
+    TEST_ASSERT_NOT_EQUAL( 0U, segmentSize );
+
+    /* A shared anonymous mapping is page aligned, as it would be between
+     * processes. */
+    pSegment = mmap( NULL, segmentSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0 );
+    TEST_ASSERT_TRUE( pSegment != MAP_FAILED );
+    TEST_ASSERT_EQUAL( SHM_RING_TRANSPORT_SUCCESS, ShmRingTransport_InitSegment( pSegment, segmentSize, RING_SIZE ) );
+
+    ( void ) memset( &client, 0x00, sizeof( client ) );
+    ( void ) memset( &server, 0x00, sizeof( server ) );
+    client.networkContext.pParams = &client.params;
+    server.networkContext.pParams = &server.params;
+
+    TEST_ASSERT_EQUAL( SHM_RING_TRANSPORT_SUCCESS,
+                       ShmRingTransport_Attach( &client.networkContext, pSegment, segmentSize, SHM_RING_TRANSPORT_CLIENT ) );
+    TEST_ASSERT_EQUAL( SHM_RING_TRANSPORT_SUCCESS,
+                       ShmRingTransport_Attach( &server.networkContext, pSegment, segmentSize, SHM_RING_TRANSPORT_SERVER ) );
+}
+
+/* Called after each test method. */
+void tearDown( void )
+{
+    if( client.params.pSegment != NULL )
+    {
+        ( void ) ShmRingTransport_Disconnect( &client.networkContext );
+    }
+
+    if( server.params.pSegment != NULL )
+    {
+        ( void ) ShmRingTransport_Disconnect( &server.networkContext );
+    }
+
+    ( void ) munmap( pSegment, segmentSize );
+}
+
+/* Called at the beginning of the whole suite. */
+void suiteSetUp()
+{
+}
+
+/* Called at the end of the whole suite. */
+int suiteTearDown( int numFailures )
+{
+    return numFailures;
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Server of the MQTT test, which answers the CONNECT and then counts
+ * the bytes received until the client closes its side.
+ */
+static void * mqttServerThread( void * pArgument )
+{
+    TestSide_t * pSide = ( TestSide_t * ) pArgument;
+    static const uint8_t connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    uint8_t buffer[ RING_SIZE ];
+    int32_t result = 0;
+    bool connected = false;
+
+    while( result >= 0 )
+    {
+        if( ShmRingTransport_Wait( &pSide->networkContext, WAIT_TIMEOUT_MS ) != SHM_RING_TRANSPORT_SUCCESS )
+        {
+            break;
+        }
+
+        result = ShmRingTransport_Recv( &pSide->networkContext, buffer, sizeof( buffer ) );
+
+        /* The CONNECT of the test fits in one ring. */
+        if( ( result > 0 ) && ( connected == false ) )
+        {
+            connected = true;
+            result = ( ShmRingTransport_Send( &pSide->networkContext, connack, sizeof( connack ) ) ==
+                       ( int32_t ) sizeof( connack ) ) ? 0 : -1;
+        }
+        else if( result > 0 )
+        {
+            pSide->bytesReceived += ( size_t ) result;
+        }
+        else
+        {
+            /* Empty else MISRA 15.7 */
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Send a byte after a delay, to wake a side sleeping in
+ * #ShmRingTransport_Wait.
+ */
+static void * delayedSendThread( void * pArgument )
+{
+    TestSide_t * pSide = ( TestSide_t * ) pArgument;
+    struct timespec delay = { 0, 50000000L };
+
+    ( void ) nanosleep( &delay, NULL );
+    ( void ) ShmRingTransport_Send( &pSide->networkContext, "w", 1U );
+
+    return NULL;
+}
+
+/**
+ * @brief Receive a byte after a delay, to wake a side sleeping in
+ * #ShmRingTransport_WaitEvent for space to send.
+ */
+static void * delayedRecvThread( void * pArgument )
+{
+    TestSide_t * pSide = ( TestSide_t * ) pArgument;
+    struct timespec delay = { 0, 50000000L };
+    uint8_t byte;
+
+    ( void ) nanosleep( &delay, NULL );
+    ( void ) ShmRingTransport_Recv( &pSide->networkContext, &byte, 1U );
+
+    return NULL;
+}
+
+static uint32_t getTimeMs( void )
+{
+    struct timespec now;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( uint32_t ) ( ( now.tv_sec * 1000 ) + ( now.tv_nsec / 1000000 ) );
+}
+
+static void eventCallback( MQTTContext_t * pContext,
+                           MQTTPacketInfo_t * pPacketInfo,
+                           MQTTDeserializedInfo_t * pDeserializedInfo )
+{
+    ( void ) pContext;
+    ( void ) pPacketInfo;
+    ( void ) pDeserializedInfo;
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Invalid parameters are rejected.
+ */
+void test_ShmRingTransport_Invalid_Params( void )
+{
+    ShmRingTransportParams_t params = { 0 };
+    NetworkContext_t networkContext = { &params };
+    uint8_t byte = 0U;
+
+    /* Rings must be a power of 2 of at least 64 bytes. */
+    TEST_ASSERT_EQUAL( 0U, ShmRingTransport_SegmentSize( 32U ) );
+    TEST_ASSERT_EQUAL( 0U, ShmRingTransport_SegmentSize( 96U ) );
+
+    TEST_ASSERT_EQUAL( SHM_RING_TRANSPORT_INVALID_PARAMETER, ShmRingTransport_InitSegment( NULL, segmentSize, RING_SIZE ) );
+    TEST_ASSERT_EQUAL( SHM_RING_TRANSPORT_INVALID_PARAMETER,
+                       ShmRingTransport_InitSegment( &( ( uint8_t * ) pSegment )[ 8 ], segmentSize - 8U, RING_SIZE ) );
+    TEST_ASSERT_EQUAL( SHM_RING_TRANSPORT_INVALID_PARAMETER,
+                       ShmRingTransport_InitSegment( pSegment, segmentSize, 2U * RING_SIZE ) );
+
+    TEST_ASSERT_EQUAL( SHM_RING_TRANSPORT_INVALID_PARAMETER,
+                       ShmRingTransport_Attach( NULL, pSegment, segmentSize, SHM_RING_TRANSPORT_CLIENT ) );
+    TEST_ASSERT_EQUAL( SHM_RING_TRANSPORT_INVALID_PARAMETER,
+                       ShmRingTransport_Attach( &networkContext, pSegment, segmentSize, ( ShmRingTransportSide_t ) 2 ) );
+
+    /* Memory which was not laid out, or is cut short, is not a segment. */
+    TEST_ASSERT_EQUAL( SHM_RING_TRANSPORT_INVALID_SEGMENT,
+                       ShmRingTransport_Attach( &networkContext, pSegment, segmentSize - 1U, SHM_RING_TRANSPORT_CLIENT ) );
+    ( void ) memset( pSegment, 0x00, 4U );
+    TEST_ASSERT_EQUAL( SHM_RING_TRANSPORT_INVALID_SEGMENT,
+                       ShmRingTransport_Attach( &networkContext, pSegment, segmentSize, SHM_RING_TRANSPORT_CLIENT ) );
+
+    TEST_ASSERT_EQUAL( SHM_RING_TRANSPORT_INVALID_PARAMETER, ShmRingTransport_Create( &networkContext, NULL, RING_SIZE ) );
+    TEST_ASSERT_EQUAL( SHM_RING_TRANSPORT_INVALID_PARAMETER, ShmRingTransport_Create( &networkContext, "/coremqtt", 100U ) );
+    TEST_ASSERT_EQUAL( SHM_RING_TRANSPORT_INVALID_PARAMETER, ShmRingTransport_Open( NULL, "/coremqtt" ) );
+
+    /* A context which is not attached cannot be used. */
+    TEST_ASSERT_EQUAL( SHM_RING_TRANSPORT_INVALID_PARAMETER, ShmRingTransport_Disconnect( &networkContext ) );
+    TEST_ASSERT_EQUAL( SHM_RING_TRANSPORT_INVALID_PARAMETER, ShmRingTransport_Wait( &networkContext, 0U ) );
+    TEST_ASSERT_LESS_THAN( 0, ShmRingTransport_Recv( &networkContext, &byte, 1U ) );
+    TEST_ASSERT_LESS_THAN( 0, ShmRingTransport_Send( &networkContext, &byte, 1U ) );
+    TEST_ASSERT_NULL( ShmRingTransport_GetTxBuffer( &networkContext, 1U ) );
+    TEST_ASSERT_LESS_THAN( 0, ShmRingTransport_CommitTxBuffer( &networkContext, &byte, 1U ) );
+}
+
+/**
+ * @brief Data is exchanged in both directions, a receive without data returns
+ * 0, and a send into a full ring sends what fits.
+ */
+void test_ShmRingTransport_Send_Recv( void )
+{
+    uint8_t sent[ RING_SIZE + 16U ];
+    uint8_t received[ sizeof( sent ) ];
+    size_t i;
+
+    for( i = 0U; i < sizeof( sent ); i++ )
+    {
+        sent[ i ] = ( uint8_t ) ( i * 7U );
+    }
+
+    TEST_ASSERT_EQUAL( 0, ShmRingTransport_Recv( &server.networkContext, received, sizeof( received ) ) );
+
+    TEST_ASSERT_EQUAL( 5, ShmRingTransport_Send( &client.networkContext, "hello", 5U ) );
+    TEST_ASSERT_EQUAL( 3, ShmRingTransport_Send( &server.networkContext, "abc", 3U ) );
+
+    /* Data is consumed across calls. */
+    TEST_ASSERT_EQUAL( 2, ShmRingTransport_Recv( &server.networkContext, received, 2U ) );
+    TEST_ASSERT_EQUAL( 3, ShmRingTransport_Recv( &server.networkContext, &received[ 2 ], sizeof( received ) ) );
+    TEST_ASSERT_EQUAL_MEMORY( "hello", received, 5U );
+    TEST_ASSERT_EQUAL( 3, ShmRingTransport_Recv( &client.networkContext, received, sizeof( received ) ) );
+    TEST_ASSERT_EQUAL_MEMORY( "abc", received, 3U );
+
+    /* Only the ring size fits, and the data wraps around the end of the
+     * ring. */
+    TEST_ASSERT_EQUAL( RING_SIZE, ShmRingTransport_Send( &client.networkContext, sent, sizeof( sent ) ) );
+    TEST_ASSERT_EQUAL( 0, ShmRingTransport_Send( &client.networkContext, sent, sizeof( sent ) ) );
+    TEST_ASSERT_EQUAL( RING_SIZE, ShmRingTransport_Recv( &server.networkContext, received, sizeof( received ) ) );
+    TEST_ASSERT_EQUAL_MEMORY( sent, received, RING_SIZE );
+}
+
+/**
+ * @brief A list of buffers is sent at once, across the end of the ring.
+ */
+void test_ShmRingTransport_Writev( void )
+{
+    TransportOutVector_t vectors[ 3 ];
+    uint8_t received[ RING_SIZE ];
+    uint32_t round;
+
+    vectors[ 0 ].iov_base = "header";
+    vectors[ 0 ].iov_len = 6U;
+    vectors[ 1 ].iov_base = "-";
+    vectors[ 1 ].iov_len = 1U;
+    vectors[ 2 ].iov_base = "payload";
+    vectors[ 2 ].iov_len = 7U;
+
+    /* Enough rounds for the vectors to straddle the end of the ring. */
+    for( round = 0U; round < 20U; round++ )
+    {
+        TEST_ASSERT_EQUAL( 14, ShmRingTransport_Writev( &client.networkContext, vectors, 3U ) );
+        TEST_ASSERT_EQUAL( 14, ShmRingTransport_Recv( &server.networkContext, received, sizeof( received ) ) );
+        TEST_ASSERT_EQUAL_MEMORY( "header-payload", received, 14U );
+    }
+}
+
+/**
+ * @brief A packet is written straight into the ring, but only where it does
+ * not wrap around the end of the ring.
+ */
+void test_ShmRingTransport_TxBuffer( void )
+{
+    uint8_t received[ RING_SIZE ];
+    uint8_t * pTxBuffer;
+
+    pTxBuffer = ( uint8_t * ) ShmRingTransport_GetTxBuffer( &client.networkContext, 48U );
+    TEST_ASSERT_NOT_NULL( pTxBuffer );
+    ( void ) memset( pTxBuffer, 'a', 48U );
+
+    /* Nothing is visible before the commit, and only another buffer cannot be
+     * committed. */
+    TEST_ASSERT_EQUAL( 0, ShmRingTransport_Recv( &server.networkContext, received, sizeof( received ) ) );
+    TEST_ASSERT_LESS_THAN( 0, ShmRingTransport_CommitTxBuffer( &client.networkContext, received, 48U ) );
+    TEST_ASSERT_EQUAL( 48, ShmRingTransport_CommitTxBuffer( &client.networkContext, pTxBuffer, 48U ) );
+    TEST_ASSERT_EQUAL( 48, ShmRingTransport_Recv( &server.networkContext, received, sizeof( received ) ) );
+    TEST_ASSERT_EACH_EQUAL_UINT8( 'a', received, 48U );
+
+    /* 16 bytes are left before the end of the ring. */
+    TEST_ASSERT_NULL( ShmRingTransport_GetTxBuffer( &client.networkContext, 17U ) );
+    pTxBuffer = ( uint8_t * ) ShmRingTransport_GetTxBuffer( &client.networkContext, 16U );
+    TEST_ASSERT_NOT_NULL( pTxBuffer );
+
+    /* Committing no bytes gives the buffer back. */
+    TEST_ASSERT_EQUAL( 0, ShmRingTransport_CommitTxBuffer( &client.networkContext, pTxBuffer, 0U ) );
+    TEST_ASSERT_EQUAL( 0, ShmRingTransport_Recv( &server.networkContext, received, sizeof( received ) ) );
+}
+
+/**
+ * @brief A wait without data times out, and a wait is woken by the peer.
+ */
+void test_ShmRingTransport_Wait( void )
+{
+    pthread_t senderThread;
+    uint32_t startTimeMs;
+    uint8_t byte = 0U;
+
+    TEST_ASSERT_EQUAL( SHM_RING_TRANSPORT_TIMEOUT, ShmRingTransport_Wait( &server.networkContext, 0U ) );
+
+    startTimeMs = getTimeMs();
+    TEST_ASSERT_EQUAL( SHM_RING_TRANSPORT_TIMEOUT, ShmRingTransport_Wait( &server.networkContext, 20U ) );
+    TEST_ASSERT_GREATER_OR_EQUAL( 20U, getTimeMs() - startTimeMs );
+
+    TEST_ASSERT_EQUAL( 0, pthread_create( &senderThread, NULL, delayedSendThread, &client ) );
+    TEST_ASSERT_EQUAL( SHM_RING_TRANSPORT_SUCCESS, ShmRingTransport_Wait( &server.networkContext, WAIT_TIMEOUT_MS ) );
+    TEST_ASSERT_EQUAL( 0, pthread_join( senderThread, NULL ) );
+    TEST_ASSERT_EQUAL( 1, ShmRingTransport_Recv( &server.networkContext, &byte, 1U ) );
+    TEST_ASSERT_EQUAL( 'w', byte );
+}
+
+/**
+ * @brief A side with a full ring waits for space, and is woken when the peer
+ * receives.
+ */
+void test_ShmRingTransport_WaitEvent( void )
+{
+    uint8_t buffer[ RING_SIZE ] = { 0 };
+    pthread_t receiverThread;
+
+    TEST_ASSERT_LESS_THAN( 0, ShmRingTransport_WaitEvent( NULL, TRANSPORT_WAIT_READABLE, 0U ) );
+    TEST_ASSERT_EQUAL( 0, ShmRingTransport_WaitEvent( &server.networkContext, TRANSPORT_WAIT_READABLE, 0U ) );
+    TEST_ASSERT_EQUAL( 1, ShmRingTransport_WaitEvent( &client.networkContext, TRANSPORT_WAIT_WRITABLE, 0U ) );
+
+    TEST_ASSERT_EQUAL( RING_SIZE, ShmRingTransport_Send( &client.networkContext, buffer, sizeof( buffer ) ) );
+    TEST_ASSERT_EQUAL( 1, ShmRingTransport_WaitEvent( &server.networkContext, TRANSPORT_WAIT_READABLE, 0U ) );
+    TEST_ASSERT_EQUAL( 0, ShmRingTransport_WaitEvent( &client.networkContext, TRANSPORT_WAIT_WRITABLE, 20U ) );
+
+    TEST_ASSERT_EQUAL( 0, pthread_create( &receiverThread, NULL, delayedRecvThread, &server ) );
+    TEST_ASSERT_EQUAL( 1, ShmRingTransport_WaitEvent( &client.networkContext, TRANSPORT_WAIT_WRITABLE, WAIT_TIMEOUT_MS ) );
+    TEST_ASSERT_EQUAL( 0, pthread_join( receiverThread, NULL ) );
+    TEST_ASSERT_EQUAL( 1, ShmRingTransport_Send( &client.networkContext, "w", 1U ) );
+}
+
+/**
+ * @brief A side closed by the peer is reported ready, and then as an error
+ * once its data is received.
+ */
+void test_ShmRingTransport_Recv_PeerClosed( void )
+{
+    uint8_t buffer[ 8 ];
+
+    TEST_ASSERT_EQUAL( 1, ShmRingTransport_Send( &client.networkContext, "x", 1U ) );
+    TEST_ASSERT_EQUAL( SHM_RING_TRANSPORT_SUCCESS, ShmRingTransport_Disconnect( &client.networkContext ) );
+    TEST_ASSERT_NULL( client.params.pSegment );
+
+    TEST_ASSERT_EQUAL( SHM_RING_TRANSPORT_SUCCESS, ShmRingTransport_Wait( &server.networkContext, 0U ) );
+    TEST_ASSERT_EQUAL( 1, ShmRingTransport_Recv( &server.networkContext, buffer, sizeof( buffer ) ) );
+    TEST_ASSERT_LESS_THAN( 0, ShmRingTransport_Recv( &server.networkContext, buffer, sizeof( buffer ) ) );
+    TEST_ASSERT_LESS_THAN( 0, ShmRingTransport_Send( &server.networkContext, "y", 1U ) );
+    TEST_ASSERT_NULL( ShmRingTransport_GetTxBuffer( &server.networkContext, 1U ) );
+}
+
+/**
+ * @brief A named segment is created by the server side and opened by the
+ * client side.
+ */
+void test_ShmRingTransport_Create_Open( void )
+{
+    ShmRingTransportParams_t createdParams = { 0 }, openedParams = { 0 };
+    NetworkContext_t created = { &createdParams }, opened = { &openedParams };
+    char name[ 64 ];
+    uint8_t buffer[ 8 ];
+
+    ( void ) snprintf( name, sizeof( name ), "/coremqtt-shm-test-%ld", ( long ) getpid() );
+
+    TEST_ASSERT_EQUAL( SHM_RING_TRANSPORT_SYSTEM_ERROR, ShmRingTransport_Open( &opened, name ) );
+    TEST_ASSERT_EQUAL( SHM_RING_TRANSPORT_SUCCESS, ShmRingTransport_Create( &created, name, RING_SIZE ) );
+
+    /* The name is taken until it is removed. */
+    TEST_ASSERT_EQUAL( SHM_RING_TRANSPORT_SYSTEM_ERROR, ShmRingTransport_Create( &opened, name, RING_SIZE ) );
+    TEST_ASSERT_EQUAL( SHM_RING_TRANSPORT_SUCCESS, ShmRingTransport_Open( &opened, name ) );
+    TEST_ASSERT_EQUAL( 0, shm_unlink( name ) );
+
+    TEST_ASSERT_EQUAL( SHM_RING_TRANSPORT_SERVER, createdParams.side );
+    TEST_ASSERT_EQUAL( SHM_RING_TRANSPORT_CLIENT, openedParams.side );
+    TEST_ASSERT_EQUAL( RING_SIZE, openedParams.ringSize );
+
+    /* The two mappings share the rings. */
+    TEST_ASSERT_EQUAL( 4, ShmRingTransport_Send( &opened, "ping", 4U ) );
+    TEST_ASSERT_EQUAL( 4, ShmRingTransport_Recv( &created, buffer, sizeof( buffer ) ) );
+    TEST_ASSERT_EQUAL_MEMORY( "ping", buffer, 4U );
+
+    TEST_ASSERT_EQUAL( SHM_RING_TRANSPORT_SUCCESS, ShmRingTransport_Disconnect( &opened ) );
+    TEST_ASSERT_EQUAL( SHM_RING_TRANSPORT_SUCCESS, ShmRingTransport_Disconnect( &created ) );
+}
+
+/**
+ * @brief The MQTT library runs over the transport, writing its packets
+ * straight into the ring where they fit.
+ */
+void test_ShmRingTransport_MQTT_Publish( void )
+{
+    MQTTContext_t context;
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer;
+    MQTTConnectInfo_t connectInfo = { 0 };
+    MQTTPublishInfo_t publishInfo = { 0 };
+    uint8_t buffer[ 128 ];
+    bool sessionPresent = false;
+    size_t remainingLength = 0U, packetSize = 0U;
+    pthread_t serverThread;
+    uint32_t i;
+
+    TEST_ASSERT_EQUAL( 0, pthread_create( &serverThread, NULL, mqttServerThread, &server ) );
+
+    transport.pNetworkContext = &client.networkContext;
+    transport.recv = ShmRingTransport_Recv;
+    transport.send = ShmRingTransport_Send;
+    transport.writev = ShmRingTransport_Writev;
+    transport.getTxBuffer = ShmRingTransport_GetTxBuffer;
+    transport.commitTxBuffer = ShmRingTransport_CommitTxBuffer;
+    transport.wait = ShmRingTransport_WaitEvent;
+    networkBuffer.pBuffer = buffer;
+    networkBuffer.size = sizeof( buffer );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Init( &context, &transport, getTimeMs, eventCallback, &networkBuffer ) );
+
+    connectInfo.cleanSession = true;
+    connectInfo.pClientIdentifier = "shm";
+    connectInfo.clientIdentifierLength = 3U;
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Connect( &context, &connectInfo, NULL, WAIT_TIMEOUT_MS, &sessionPresent ) );
+
+    publishInfo.qos = MQTTQoS0;
+    publishInfo.pTopicName = "shm/publish";
+    publishInfo.topicNameLength = ( uint16_t ) strlen( publishInfo.pTopicName );
+    publishInfo.pPayload = "payload";
+    publishInfo.payloadLength = 7U;
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_GetPublishPacketSize( &publishInfo, &remainingLength, &packetSize ) );
+
+    /* Far more publishes than fit in the ring, which the server drains. */
+    for( i = 0U; i < PUBLISH_COUNT; i++ )
+    {
+        TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Publish( &context, &publishInfo, 0U ) );
+    }
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Disconnect( &context ) );
+    TEST_ASSERT_EQUAL( SHM_RING_TRANSPORT_SUCCESS, ShmRingTransport_Disconnect( &client.networkContext ) );
+    TEST_ASSERT_EQUAL( 0, pthread_join( serverThread, NULL ) );
+
+    TEST_ASSERT_EQUAL( ( PUBLISH_COUNT * packetSize ) + 2U, server.bytesReceived );
+}
@@ -0,0 +1,542 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file tcp_posix_transport_system_test.c
+ * @brief System tests of the POSIX TCP transport over loopback connections.
+ */
+
+#define _POSIX_C_SOURCE    200809L
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "unity.h"
+
+#include "core_mqtt.h"
+#include "tcp_posix_transport.h"
+
+/**
+ * @brief Each compilation unit that uses the transport must define the
+ * NetworkContext struct.
+ */
+struct NetworkContext
+{
+    TcpPosixTransportParams_t * pParams;
+};
+
+/**
+ * @brief Number of publishes sent by each throughput run.
+ */
+#define THROUGHPUT_PUBLISH_COUNT    ( 20000U )
+
+/**
+ * @brief Size of the payload of each publish of a throughput run.
+ */
+#define THROUGHPUT_PAYLOAD_SIZE     ( 64U )
+
+/**
+ * @brief Timeout for establishing loopback connections.
+ */
+#define CONNECT_TIMEOUT_MS          ( 1000U )
+
+/**
+ * @brief A loopback connection: the transport under test on the client side
+ * and a plain blocking socket on the server side.
+ */
+typedef struct LoopbackConnection
+{
+    TcpPosixTransportParams_t params;
+    NetworkContext_t networkContext;
+    int serverSocket;
+} LoopbackConnection_t;
+
+/**
+ * @brief Server side of a throughput run, which answers the CONNECT and then
+ * counts every byte received until the client disconnects.
+ */
+typedef struct DrainServer
+{
+    int serverSocket;
+    size_t bytesReceived;
+} DrainServer_t;
+
+/**
+ * @brief The connection used by the test, closed by tearDown.
+ */
+static LoopbackConnection_t connection;
+
+/**
+ * @brief Number of calls made into the transport by coreMQTT.
+ */
+static size_t transportCallCount;
+
+/* ============================   UNITY FIXTURES ============================ */
+
+/* Called before each test method. */
+void setUp( void )
+{
+    ( void ) memset( &connection, 0x00, sizeof( connection ) );
+    connection.params.socketDescriptor = -1;
+    connection.networkContext.pParams = &connection.params;
+    connection.serverSocket = -1;
+    transportCallCount = 0U;
+}
+
+/* Called after each test method. */
+void tearDown( void )
+{
+    if( connection.params.socketDescriptor >= 0 )
+    {
+        ( void ) TcpPosixTransport_Disconnect( &connection.networkContext );
+    }
+
+    if( connection.serverSocket >= 0 )
+    {
+        ( void ) close( connection.serverSocket );
+    }
+}
+
+/* Called at the beginning of the whole suite. */
+void suiteSetUp()
+{
+}
+
+/* Called at the end of the whole suite. */
+int suiteTearDown( int numFailures )
+{
+    return numFailures;
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Create a listening socket on an ephemeral loopback port.
+ */
+static int listenOnLoopback( uint16_t * pPort )
+{
+    struct sockaddr_in address;
+    socklen_t addressLength = sizeof( address );
+    int listenSocket = socket( AF_INET, SOCK_STREAM, 0 );
+
+    TEST_ASSERT_GREATER_OR_EQUAL( 0, listenSocket );
+
+    ( void ) memset( &address, 0x00, sizeof( address ) );
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+    address.sin_port = 0;
+
+    TEST_ASSERT_EQUAL( 0, bind( listenSocket, ( struct sockaddr * ) &address, sizeof( address ) ) );
+    TEST_ASSERT_EQUAL( 0, listen( listenSocket, 1 ) );
+    TEST_ASSERT_EQUAL( 0, getsockname( listenSocket, ( struct sockaddr * ) &address, &addressLength ) );
+
+    *pPort = ntohs( address.sin_port );
+
+    return listenSocket;
+}
+
+/**
+ * @brief Connect the transport under test to a new loopback server.
+ */
+static void openConnection( LoopbackConnection_t * pConnection )
+{
+    TcpPosixTransportStatus_t status;
+    uint16_t port = 0U;
+    int listenSocket = listenOnLoopback( &port );
+
+    status = TcpPosixTransport_Connect( &pConnection->networkContext, "127.0.0.1", port, CONNECT_TIMEOUT_MS );
+    TEST_ASSERT_EQUAL( TCP_POSIX_TRANSPORT_SUCCESS, status );
+
+    pConnection->serverSocket = accept( listenSocket, NULL, NULL );
+    TEST_ASSERT_GREATER_OR_EQUAL( 0, pConnection->serverSocket );
+
+    ( void ) close( listenSocket );
+}
+
+/**
+ * @brief Read exactly the given number of bytes from a blocking socket.
+ */
+static bool readExact( int socketDescriptor,
+                       uint8_t * pBuffer,
+                       size_t length )
+{
+    size_t received = 0U;
+    ssize_t result = 1;
+
+    while( ( received < length ) && ( result > 0 ) )
+    {
+        result = recv( socketDescriptor, &pBuffer[ received ], length - received, 0 );
+
+        if( result > 0 )
+        {
+            received += ( size_t ) result;
+        }
+    }
+
+    return received == length;
+}
+
+/**
+ * @brief Server thread of a throughput run.
+ */
+static void * drainServerThread( void * pArgument )
+{
+    DrainServer_t * pServer = ( DrainServer_t * ) pArgument;
+    static const uint8_t connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    uint8_t buffer[ 4096 ];
+    size_t remainingLength = 0U, multiplier = 1U;
+    ssize_t result;
+    bool success;
+
+    /* Read the fixed header and the variable length remaining length of the
+     * CONNECT, then the rest of the packet. */
+    success = readExact( pServer->serverSocket, buffer, 1U );
+
+    do
+    {
+        success = success && readExact( pServer->serverSocket, buffer, 1U );
+        remainingLength += ( size_t ) ( buffer[ 0 ] & 0x7FU ) * multiplier;
+        multiplier *= 128U;
+    } while( success && ( ( buffer[ 0 ] & 0x80U ) != 0U ) );
+
+    success = success && ( remainingLength <= sizeof( buffer ) ) &&
+              readExact( pServer->serverSocket, buffer, remainingLength );
+
+    if( success && ( send( pServer->serverSocket, connack, sizeof( connack ), 0 ) == ( ssize_t ) sizeof( connack ) ) )
+    {
+        do
+        {
+            result = recv( pServer->serverSocket, buffer, sizeof( buffer ), 0 );
+
+            if( result > 0 )
+            {
+                pServer->bytesReceived += ( size_t ) result;
+            }
+        } while( result > 0 );
+    }
+
+    return NULL;
+}
+
+static uint32_t getTimeMs( void )
+{
+    struct timespec now;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( uint32_t ) ( ( now.tv_sec * 1000 ) + ( now.tv_nsec / 1000000 ) );
+}
+
+static void eventCallback( MQTTContext_t * pContext,
+                           MQTTPacketInfo_t * pPacketInfo,
+                           MQTTDeserializedInfo_t * pDeserializedInfo )
+{
+    ( void ) pContext;
+    ( void ) pPacketInfo;
+    ( void ) pDeserializedInfo;
+}
+
+static int32_t countingSend( NetworkContext_t * pNetworkContext,
+                             const void * pBuffer,
+                             size_t bytesToSend )
+{
+    transportCallCount++;
+
+    return TcpPosixTransport_Send( pNetworkContext, pBuffer, bytesToSend );
+}
+
+static int32_t countingWritev( NetworkContext_t * pNetworkContext,
+                               TransportOutVector_t * pIoVec,
+                               size_t ioVecCount )
+{
+    transportCallCount++;
+
+    return TcpPosixTransport_Writev( pNetworkContext, pIoVec, ioVecCount );
+}
+
+/**
+ * @brief Send QoS0 publishes with coreMQTT over a loopback connection and
+ * return the number of transport calls made for them.
+ */
+static size_t runThroughput( bool useWritev )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t context;
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer;
+    MQTTConnectInfo_t connectInfo = { 0 };
+    MQTTPublishInfo_t publishInfo = { 0 };
+    DrainServer_t server = { 0 };
+    pthread_t serverThread;
+    uint8_t buffer[ 128 ];
+    uint8_t payload[ THROUGHPUT_PAYLOAD_SIZE ];
+    bool sessionPresent = false;
+    size_t remainingLength = 0U, packetSize = 0U, callCount;
+    uint32_t startMs, elapsedMs;
+    uint32_t i;
+
+    openConnection( &connection );
+    server.serverSocket = connection.serverSocket;
+    TEST_ASSERT_EQUAL( 0, pthread_create( &serverThread, NULL, drainServerThread, &server ) );
+
+    transport.pNetworkContext = &connection.networkContext;
+    transport.recv = TcpPosixTransport_Recv;
+    transport.send = countingSend;
+    transport.writev = ( useWritev == true ) ? countingWritev : NULL;
+    networkBuffer.pBuffer = buffer;
+    networkBuffer.size = sizeof( buffer );
+
+    mqttStatus = MQTT_Init( &context, &transport, getTimeMs, eventCallback, &networkBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    connectInfo.cleanSession = true;
+    connectInfo.pClientIdentifier = "loopback";
+    connectInfo.clientIdentifierLength = 8U;
+    mqttStatus = MQTT_Connect( &context, &connectInfo, NULL, CONNECT_TIMEOUT_MS, &sessionPresent );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    ( void ) memset( payload, 'p', sizeof( payload ) );
+    publishInfo.qos = MQTTQoS0;
+    publishInfo.pTopicName = "loopback/throughput";
+    publishInfo.topicNameLength = ( uint16_t ) strlen( publishInfo.pTopicName );
+    publishInfo.pPayload = payload;
+    publishInfo.payloadLength = sizeof( payload );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_GetPublishPacketSize( &publishInfo, &remainingLength, &packetSize ) );
+
+    transportCallCount = 0U;
+    startMs = getTimeMs();
+
+    for( i = 0U; ( i < THROUGHPUT_PUBLISH_COUNT ) && ( mqttStatus == MQTTSuccess ); i++ )
+    {
+        mqttStatus = MQTT_Publish( &context, &publishInfo, 0U );
+    }
+
+    elapsedMs = getTimeMs() - startMs;
+    callCount = transportCallCount;
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Disconnect( &context ) );
+    TEST_ASSERT_EQUAL( TCP_POSIX_TRANSPORT_SUCCESS, TcpPosixTransport_Disconnect( &connection.networkContext ) );
+    TEST_ASSERT_EQUAL( 0, pthread_join( serverThread, NULL ) );
+
+    /* Every publish and the DISCONNECT arrived intact. */
+    TEST_ASSERT_EQUAL( ( THROUGHPUT_PUBLISH_COUNT * packetSize ) + 2U, server.bytesReceived );
+
+    ( void ) printf( "%-6s path: %u publishes of %lu bytes in %lu ms, %.2f transport calls per publish\n",
+                     ( useWritev == true ) ? "writev" : "send",
+                     ( unsigned int ) THROUGHPUT_PUBLISH_COUNT,
+                     ( unsigned long ) packetSize,
+                     ( unsigned long ) elapsedMs,
+                     ( double ) callCount / ( double ) THROUGHPUT_PUBLISH_COUNT );
+
+    ( void ) close( connection.serverSocket );
+    connection.serverSocket = -1;
+
+    return callCount;
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Invalid parameters are rejected.
+ */
+void test_TcpPosixTransport_Invalid_Params( void )
+{
+    uint8_t byte = 0U;
+    TransportOutVector_t ioVector = { &byte, 1U };
+
+    TEST_ASSERT_EQUAL( TCP_POSIX_TRANSPORT_INVALID_PARAMETER,
+                       TcpPosixTransport_Connect( NULL, "127.0.0.1", 1883U, CONNECT_TIMEOUT_MS ) );
+    TEST_ASSERT_EQUAL( TCP_POSIX_TRANSPORT_INVALID_PARAMETER,
+                       TcpPosixTransport_Connect( &connection.networkContext, NULL, 1883U, CONNECT_TIMEOUT_MS ) );
+    TEST_ASSERT_EQUAL( TCP_POSIX_TRANSPORT_INVALID_PARAMETER,
+                       TcpPosixTransport_Attach( &connection.networkContext, -1 ) );
+    TEST_ASSERT_EQUAL( TCP_POSIX_TRANSPORT_INVALID_PARAMETER,
+                       TcpPosixTransport_Disconnect( &connection.networkContext ) );
+    TEST_ASSERT_EQUAL( TCP_POSIX_TRANSPORT_INVALID_PARAMETER,
+                       TcpPosixTransport_SetCork( &connection.networkContext, true ) );
+    TEST_ASSERT_EQUAL( TCP_POSIX_TRANSPORT_INVALID_PARAMETER,
+                       TcpPosixTransport_SetNoDelay( NULL, true ) );
+
+    /* Transfers on a context which is not connected fail. */
+    TEST_ASSERT_LESS_THAN( 0, TcpPosixTransport_Recv( &connection.networkContext, &byte, 1U ) );
+    TEST_ASSERT_LESS_THAN( 0, TcpPosixTransport_Send( &connection.networkContext, &byte, 1U ) );
+    TEST_ASSERT_LESS_THAN( 0, TcpPosixTransport_Writev( &connection.networkContext, &ioVector, 1U ) );
+    TEST_ASSERT_LESS_THAN( 0, TcpPosixTransport_Wait( &connection.networkContext, TRANSPORT_WAIT_READABLE, 0U ) );
+}
+
+/**
+ * @brief Connecting to a port nobody listens on fails.
+ */
+void test_TcpPosixTransport_Connect_Refused( void )
+{
+    uint16_t port = 0U;
+    int listenSocket = listenOnLoopback( &port );
+
+    /* Free the port again, so that the connection is refused. */
+    ( void ) close( listenSocket );
+
+    TEST_ASSERT_EQUAL( TCP_POSIX_TRANSPORT_CONNECT_FAILURE,
+                       TcpPosixTransport_Connect( &connection.networkContext, "127.0.0.1", port, CONNECT_TIMEOUT_MS ) );
+    TEST_ASSERT_EQUAL( -1, connection.params.socketDescriptor );
+}
+
+/**
+ * @brief Data is exchanged in both directions, and a receive without data
+ * returns 0 rather than blocking.
+ */
+void test_TcpPosixTransport_Send_Recv( void )
+{
+    uint8_t buffer[ 8 ];
+    const struct timespec pollInterval = { 0, 1000000L };
+
+    openConnection( &connection );
+
+    TEST_ASSERT_EQUAL( 0, TcpPosixTransport_Recv( &connection.networkContext, buffer, sizeof( buffer ) ) );
+    TEST_ASSERT_EQUAL( 0, TcpPosixTransport_Wait( &connection.networkContext, TRANSPORT_WAIT_READABLE, 10U ) );
+    TEST_ASSERT_EQUAL( 1, TcpPosixTransport_Wait( &connection.networkContext, TRANSPORT_WAIT_WRITABLE, 0U ) );
+
+    TEST_ASSERT_EQUAL( 5, TcpPosixTransport_Send( &connection.networkContext, "hello", 5U ) );
+    TEST_ASSERT_TRUE( readExact( connection.serverSocket, buffer, 5U ) );
+    TEST_ASSERT_EQUAL_MEMORY( "hello", buffer, 5U );
+
+    TEST_ASSERT_EQUAL( 3, send( connection.serverSocket, "abc", 3U, 0 ) );
+    TEST_ASSERT_EQUAL( 1, TcpPosixTransport_Wait( &connection.networkContext, TRANSPORT_WAIT_READABLE, CONNECT_TIMEOUT_MS ) );
+
+    /* Loopback delivery is immediate, but poll briefly to be safe. */
+    while( TcpPosixTransport_Recv( &connection.networkContext, buffer, sizeof( buffer ) ) == 0 )
+    {
+        ( void ) nanosleep( &pollInterval, NULL );
+    }
+
+    TEST_ASSERT_EQUAL_MEMORY( "abc", buffer, 3U );
+}
+
+/**
+ * @brief A connection closed by the peer is reported as an error, not as
+ * "no data".
+ */
+void test_TcpPosixTransport_Recv_PeerClosed( void )
+{
+    uint8_t byte;
+    int32_t result;
+
+    openConnection( &connection );
+
+    ( void ) close( connection.serverSocket );
+    connection.serverSocket = -1;
+
+    do
+    {
+        result = TcpPosixTransport_Recv( &connection.networkContext, &byte, 1U );
+    } while( result == 0 );
+
+    TEST_ASSERT_LESS_THAN( 0, result );
+}
+
+/**
+ * @brief A send into a full socket buffer returns 0, so coreMQTT waits for the
+ * socket to become writable and retries it.
+ */
+void test_TcpPosixTransport_Send_BufferFull( void )
+{
+    static uint8_t chunk[ 4096 ];
+    int32_t result;
+    size_t attempts = 0U;
+
+    openConnection( &connection );
+
+    /* The server never reads, so the buffers eventually fill. */
+    do
+    {
+        result = TcpPosixTransport_Send( &connection.networkContext, chunk, sizeof( chunk ) );
+        attempts++;
+    } while( ( result > 0 ) && ( attempts < 100000U ) );
+
+    TEST_ASSERT_EQUAL( 0, result );
+    TEST_ASSERT_EQUAL( 0, TcpPosixTransport_Wait( &connection.networkContext, TRANSPORT_WAIT_WRITABLE, 10U ) );
+}
+
+/**
+ * @brief At most TCP_POSIX_TRANSPORT_MAX_IOVECS vectors are written per call,
+ * in a single system call.
+ */
+void test_TcpPosixTransport_Writev_MaxVectors( void )
+{
+    uint8_t data[ TCP_POSIX_TRANSPORT_MAX_IOVECS + 4U ];
+    TransportOutVector_t ioVectors[ TCP_POSIX_TRANSPORT_MAX_IOVECS + 4U ];
+    uint8_t received[ TCP_POSIX_TRANSPORT_MAX_IOVECS ];
+    size_t i;
+
+    openConnection( &connection );
+
+    for( i = 0U; i < sizeof( data ); i++ )
+    {
+        data[ i ] = ( uint8_t ) i;
+        ioVectors[ i ].iov_base = &data[ i ];
+        ioVectors[ i ].iov_len = 1U;
+    }
+
+    TEST_ASSERT_EQUAL( TCP_POSIX_TRANSPORT_MAX_IOVECS,
+                       TcpPosixTransport_Writev( &connection.networkContext, ioVectors, sizeof( data ) ) );
+    TEST_ASSERT_TRUE( readExact( connection.serverSocket, received, sizeof( received ) ) );
+    TEST_ASSERT_EQUAL_MEMORY( data, received, sizeof( received ) );
+}
+
+/**
+ * @brief Nagle's algorithm and corking can be toggled on a connection.
+ */
+void test_TcpPosixTransport_SocketOptions( void )
+{
+    openConnection( &connection );
+
+    TEST_ASSERT_EQUAL( TCP_POSIX_TRANSPORT_SUCCESS, TcpPosixTransport_SetNoDelay( &connection.networkContext, false ) );
+    TEST_ASSERT_EQUAL( TCP_POSIX_TRANSPORT_SUCCESS, TcpPosixTransport_SetNoDelay( &connection.networkContext, true ) );
+    TEST_ASSERT_EQUAL( TCP_POSIX_TRANSPORT_SUCCESS, TcpPosixTransport_SetCork( &connection.networkContext, true ) );
+    TEST_ASSERT_EQUAL( 4, TcpPosixTransport_Send( &connection.networkContext, "cork", 4U ) );
+    TEST_ASSERT_EQUAL( TCP_POSIX_TRANSPORT_SUCCESS, TcpPosixTransport_SetCork( &connection.networkContext, false ) );
+}
+
+/**
+ * @brief Publishing through writev takes one transport call per publish, where
+ * the plain send path takes one call per part of the packet.
+ */
+void test_TcpPosixTransport_Throughput_Writev_vs_Send( void )
+{
+    size_t writevCalls, sendCalls;
+
+    writevCalls = runThroughput( true );
+    sendCalls = runThroughput( false );
+
+    /* Header, topic and payload are sent separately without writev. */
+    TEST_ASSERT_GREATER_OR_EQUAL( 3U * THROUGHPUT_PUBLISH_COUNT, sendCalls );
+    TEST_ASSERT_LESS_THAN( sendCalls, writevCalls );
+}
@@ -0,0 +1,465 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file uring_transport_system_test.c
+ * @brief System tests of the io_uring transport over local socket pairs.
+ */
+
+#define _POSIX_C_SOURCE    200809L
+
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/socket.h>
+
+#include "unity.h"
+
+#include "core_mqtt.h"
+#include "uring_transport.h"
+
+/**
+ * @brief Each compilation unit that uses the transport must define the
+ * NetworkContext struct.
+ */
+struct NetworkContext
+{
+    UringTransportParams_t * pParams;
+};
+
+/**
+ * @brief Number of connections served by the ring of the tests.
+ */
+#define CONNECTION_COUNT     ( 64U )
+
+/**
+ * @brief Number of receive buffers of the ring of the tests.
+ */
+#define RX_BUFFER_COUNT      ( 64U )
+
+/**
+ * @brief Size of each receive buffer of the ring of the tests.
+ */
+#define RX_BUFFER_SIZE       ( 256U )
+
+/**
+ * @brief Size of each transmit buffer of the ring of the tests.
+ */
+#define TX_BUFFER_SIZE       ( 1024U )
+
+/**
+ * @brief Time to wait for completions.
+ */
+#define PROCESS_TIMEOUT_MS   ( 1000U )
+
+/**
+ * @brief A connection of the tests: the transport on one end of a socket
+ * pair, and a plain blocking socket on the other.
+ */
+typedef struct TestConnection
+{
+    UringTransportParams_t params;
+    NetworkContext_t networkContext;
+    int peerSocket;
+    size_t readyCount;
+    size_t peerBytesReceived;
+} TestConnection_t;
+
+static uint8_t rxBuffers[ RX_BUFFER_COUNT * RX_BUFFER_SIZE ];
+static uint8_t txBuffers[ CONNECTION_COUNT * TX_BUFFER_SIZE ];
+static UringTransportRing_t ring;
+static UringTransportRingConfig_t ringConfig;
+static TestConnection_t connections[ CONNECTION_COUNT ];
+
+/* ============================   UNITY FIXTURES ============================ */
+
+/* Called before each test method. */
+void setUp( void )
+{
+    size_t i;
+
+    ringConfig.entries = 2U * CONNECTION_COUNT;
+    ringConfig.pRxBuffers = rxBuffers;
+    ringConfig.rxBufferSize = RX_BUFFER_SIZE;
+    ringConfig.rxBufferCount = RX_BUFFER_COUNT;
+    ringConfig.pTxBuffers = txBuffers;
+    ringConfig.txBufferSize = TX_BUFFER_SIZE;
+    ringConfig.txBufferCount = CONNECTION_COUNT;
+
+    TEST_ASSERT_EQUAL( URING_TRANSPORT_SUCCESS, UringTransport_InitRing( &ring, &ringConfig ) );
+
+    ( void ) memset( connections, 0x00, sizeof( connections ) );
+
+    for( i = 0U; i < CONNECTION_COUNT; i++ )
+    {
+        connections[ i ].params.socketDescriptor = -1;
+        connections[ i ].params.pAppContext = &connections[ i ];
+        connections[ i ].networkContext.pParams = &connections[ i ].params;
+        connections[ i ].peerSocket = -1;
+    }
+}
+
+/* Called after each test method. */
+void tearDown( void )
+{
+    size_t i;
+
+    for( i = 0U; i < CONNECTION_COUNT; i++ )
+    {
+        if( connections[ i ].params.socketDescriptor >= 0 )
+        {
+            ( void ) UringTransport_Disconnect( &connections[ i ].networkContext );
+        }
+
+        if( connections[ i ].peerSocket >= 0 )
+        {
+            ( void ) close( connections[ i ].peerSocket );
+        }
+    }
+
+    ( void ) UringTransport_CleanupRing( &ring );
+}
+
+/* Called at the beginning of the whole suite. */
+void suiteSetUp()
+{
+}
+
+/* Called at the end of the whole suite. */
+int suiteTearDown( int numFailures )
+{
+    return numFailures;
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Create a socket pair and attach one end of it to the ring.
+ */
+static void openConnection( TestConnection_t * pConnection,
+                            uint32_t txSlot )
+{
+    int sockets[ 2 ];
+
+    TEST_ASSERT_EQUAL( 0, socketpair( AF_UNIX, SOCK_STREAM, 0, sockets ) );
+    TEST_ASSERT_EQUAL( URING_TRANSPORT_SUCCESS,
+                       UringTransport_Attach( &pConnection->networkContext, &ring, sockets[ 0 ], txSlot ) );
+    pConnection->peerSocket = sockets[ 1 ];
+}
+
+/**
+ * @brief Read exactly the given number of bytes from a blocking socket.
+ */
+static bool readExact( int socketDescriptor,
+                       uint8_t * pBuffer,
+                       size_t length )
+{
+    size_t received = 0U;
+    ssize_t result = 1;
+
+    while( ( received < length ) && ( result > 0 ) )
+    {
+        result = recv( socketDescriptor, &pBuffer[ received ], length - received, 0 );
+
+        if( result > 0 )
+        {
+            received += ( size_t ) result;
+        }
+    }
+
+    return received == length;
+}
+
+/**
+ * @brief Count how often each connection is reported ready.
+ */
+static void countReady( UringTransportParams_t * pParams )
+{
+    TestConnection_t * pConnection = ( TestConnection_t * ) pParams->pAppContext;
+
+    pConnection->readyCount++;
+}
+
+/**
+ * @brief Server of the MQTT test, which answers the CONNECT and then counts
+ * the bytes received until the client disconnects.
+ */
+static void * mqttServerThread( void * pArgument )
+{
+    TestConnection_t * pConnection = ( TestConnection_t * ) pArgument;
+    static const uint8_t connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    uint8_t buffer[ 2048 ];
+    ssize_t result;
+
+    /* The CONNECT of the test fits in one read. */
+    result = recv( pConnection->peerSocket, buffer, sizeof( buffer ), 0 );
+
+    if( ( result > 0 ) && ( send( pConnection->peerSocket, connack, sizeof( connack ), 0 ) == ( ssize_t ) sizeof( connack ) ) )
+    {
+        do
+        {
+            result = recv( pConnection->peerSocket, buffer, sizeof( buffer ), 0 );
+
+            if( result > 0 )
+            {
+                pConnection->peerBytesReceived += ( size_t ) result;
+            }
+        } while( result > 0 );
+    }
+
+    return NULL;
+}
+
+static uint32_t getTimeMs( void )
+{
+    struct timespec now;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( uint32_t ) ( ( now.tv_sec * 1000 ) + ( now.tv_nsec / 1000000 ) );
+}
+
+static void eventCallback( MQTTContext_t * pContext,
+                           MQTTPacketInfo_t * pPacketInfo,
+                           MQTTDeserializedInfo_t * pDeserializedInfo )
+{
+    ( void ) pContext;
+    ( void ) pPacketInfo;
+    ( void ) pDeserializedInfo;
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Invalid parameters are rejected.
+ */
+void test_UringTransport_Invalid_Params( void )
+{
+    UringTransportRing_t otherRing;
+    UringTransportRingConfig_t config = ringConfig;
+    uint8_t byte = 0U;
+
+    TEST_ASSERT_EQUAL( URING_TRANSPORT_INVALID_PARAMETER, UringTransport_InitRing( NULL, &config ) );
+    TEST_ASSERT_EQUAL( URING_TRANSPORT_INVALID_PARAMETER, UringTransport_InitRing( &otherRing, NULL ) );
+
+    /* The number of receive buffers must be a power of 2. */
+    config.rxBufferCount = 3U;
+    TEST_ASSERT_EQUAL( URING_TRANSPORT_INVALID_PARAMETER, UringTransport_InitRing( &otherRing, &config ) );
+    config.rxBufferCount = 2U * URING_TRANSPORT_MAX_RX_BUFFERS;
+    TEST_ASSERT_EQUAL( URING_TRANSPORT_INVALID_PARAMETER, UringTransport_InitRing( &otherRing, &config ) );
+    config = ringConfig;
+    config.pTxBuffers = NULL;
+    TEST_ASSERT_EQUAL( URING_TRANSPORT_INVALID_PARAMETER, UringTransport_InitRing( &otherRing, &config ) );
+
+    TEST_ASSERT_EQUAL( URING_TRANSPORT_INVALID_PARAMETER,
+                       UringTransport_Attach( &connections[ 0 ].networkContext, &ring, 0, CONNECTION_COUNT ) );
+    TEST_ASSERT_EQUAL( URING_TRANSPORT_INVALID_PARAMETER,
+                       UringTransport_Attach( &connections[ 0 ].networkContext, NULL, 0, 0U ) );
+    TEST_ASSERT_EQUAL( URING_TRANSPORT_INVALID_PARAMETER,
+                       UringTransport_Disconnect( &connections[ 0 ].networkContext ) );
+    TEST_ASSERT_EQUAL( URING_TRANSPORT_INVALID_PARAMETER, UringTransport_Process( &ring, 0U, NULL ) );
+
+    /* Transfers on a context which is not attached fail. */
+    TEST_ASSERT_LESS_THAN( 0, UringTransport_Recv( &connections[ 0 ].networkContext, &byte, 1U ) );
+    TEST_ASSERT_LESS_THAN( 0, UringTransport_Send( &connections[ 0 ].networkContext, &byte, 1U ) );
+}
+
+/**
+ * @brief Data is exchanged in both directions, and a receive without data
+ * returns 0.
+ */
+void test_UringTransport_Send_Recv( void )
+{
+    TestConnection_t * pConnection = &connections[ 0 ];
+    uint8_t buffer[ 8 ];
+
+    openConnection( pConnection, 0U );
+
+    TEST_ASSERT_EQUAL( 0, UringTransport_Recv( &pConnection->networkContext, buffer, sizeof( buffer ) ) );
+
+    /* Staged data is written by the next submission. */
+    TEST_ASSERT_EQUAL( 5, UringTransport_Send( &pConnection->networkContext, "hello", 5U ) );
+    TEST_ASSERT_EQUAL( URING_TRANSPORT_SUCCESS, UringTransport_Process( &ring, 0U, countReady ) );
+    TEST_ASSERT_TRUE( readExact( pConnection->peerSocket, buffer, 5U ) );
+    TEST_ASSERT_EQUAL_MEMORY( "hello", buffer, 5U );
+
+    TEST_ASSERT_EQUAL( 3, send( pConnection->peerSocket, "abc", 3U, 0 ) );
+
+    while( pConnection->readyCount == 0U )
+    {
+        TEST_ASSERT_EQUAL( URING_TRANSPORT_SUCCESS, UringTransport_Process( &ring, PROCESS_TIMEOUT_MS, countReady ) );
+    }
+
+    /* Data is consumed across calls. */
+    TEST_ASSERT_EQUAL( 2, UringTransport_Recv( &pConnection->networkContext, buffer, 2U ) );
+    TEST_ASSERT_EQUAL( 1, UringTransport_Recv( &pConnection->networkContext, &buffer[ 2 ], 1U ) );
+    TEST_ASSERT_EQUAL_MEMORY( "abc", buffer, 3U );
+}
+
+/**
+ * @brief A connection closed by the peer is reported ready, and then as an
+ * error once its data is consumed.
+ */
+void test_UringTransport_Recv_PeerClosed( void )
+{
+    TestConnection_t * pConnection = &connections[ 0 ];
+    uint8_t buffer[ 8 ];
+
+    openConnection( pConnection, 0U );
+
+    TEST_ASSERT_EQUAL( 1, send( pConnection->peerSocket, "x", 1U, 0 ) );
+    ( void ) close( pConnection->peerSocket );
+    pConnection->peerSocket = -1;
+
+    while( pConnection->params.closed == false )
+    {
+        TEST_ASSERT_EQUAL( URING_TRANSPORT_SUCCESS, UringTransport_Process( &ring, PROCESS_TIMEOUT_MS, countReady ) );
+    }
+
+    TEST_ASSERT_GREATER_THAN( 0U, pConnection->readyCount );
+    TEST_ASSERT_EQUAL( 1, UringTransport_Recv( &pConnection->networkContext, buffer, sizeof( buffer ) ) );
+    TEST_ASSERT_LESS_THAN( 0, UringTransport_Recv( &pConnection->networkContext, buffer, sizeof( buffer ) ) );
+    TEST_ASSERT_LESS_THAN( 0, UringTransport_Send( &pConnection->networkContext, "y", 1U ) );
+}
+
+/**
+ * @brief A single call serves every connection with data.
+ */
+void test_UringTransport_Process_ManyConnections( void )
+{
+    uint8_t byte;
+    size_t i;
+
+    for( i = 0U; i < CONNECTION_COUNT; i++ )
+    {
+        openConnection( &connections[ i ], ( uint32_t ) i );
+        TEST_ASSERT_EQUAL( 1, send( connections[ i ].peerSocket, "m", 1U, 0 ) );
+        TEST_ASSERT_EQUAL( 1, UringTransport_Send( &connections[ i ].networkContext, "n", 1U ) );
+    }
+
+    /* One submission arms every receive and writes every staged byte, and the
+     * receives complete at once as their data is already there. */
+    TEST_ASSERT_EQUAL( URING_TRANSPORT_SUCCESS, UringTransport_Process( &ring, PROCESS_TIMEOUT_MS, countReady ) );
+
+    for( i = 0U; i < CONNECTION_COUNT; i++ )
+    {
+        TEST_ASSERT_EQUAL( 1U, connections[ i ].readyCount );
+        TEST_ASSERT_EQUAL( 1, UringTransport_Recv( &connections[ i ].networkContext, &byte, 1U ) );
+        TEST_ASSERT_EQUAL( 'm', byte );
+        TEST_ASSERT_TRUE( readExact( connections[ i ].peerSocket, &byte, 1U ) );
+        TEST_ASSERT_EQUAL( 'n', byte );
+    }
+}
+
+/**
+ * @brief Receives stopped by running out of buffers resume as buffers are
+ * consumed.
+ */
+void test_UringTransport_Recv_BuffersExhausted( void )
+{
+    static uint8_t sent[ 4U * RX_BUFFER_COUNT * RX_BUFFER_SIZE ];
+    static uint8_t received[ sizeof( sent ) ];
+    TestConnection_t * pConnection = &connections[ 0 ];
+    size_t offset = 0U, i;
+    int32_t result = 0;
+
+    openConnection( pConnection, 0U );
+
+    for( i = 0U; i < sizeof( sent ); i++ )
+    {
+        sent[ i ] = ( uint8_t ) ( i * 7U );
+    }
+
+    /* Four times the pool size must pass through the connection. */
+    TEST_ASSERT_EQUAL( sizeof( sent ), ( size_t ) send( pConnection->peerSocket, sent, sizeof( sent ), 0 ) );
+
+    while( ( offset < sizeof( sent ) ) && ( result >= 0 ) )
+    {
+        TEST_ASSERT_EQUAL( URING_TRANSPORT_SUCCESS, UringTransport_Process( &ring, PROCESS_TIMEOUT_MS, countReady ) );
+        result = UringTransport_Recv( &pConnection->networkContext, &received[ offset ], sizeof( received ) - offset );
+        offset += ( result > 0 ) ? ( size_t ) result : 0U;
+    }
+
+    TEST_ASSERT_EQUAL( sizeof( sent ), offset );
+    TEST_ASSERT_EQUAL_MEMORY( sent, received, offset );
+}
+
+/**
+ * @brief The MQTT library runs over the transport, including calls which wait
+ * for a response without a reactor.
+ */
+void test_UringTransport_MQTT_Publish( void )
+{
+    TestConnection_t * pConnection = &connections[ 0 ];
+    MQTTContext_t context;
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer;
+    MQTTConnectInfo_t connectInfo = { 0 };
+    MQTTPublishInfo_t publishInfo = { 0 };
+    uint8_t buffer[ 128 ];
+    bool sessionPresent = false;
+    size_t remainingLength = 0U, packetSize = 0U;
+    pthread_t serverThread;
+    uint32_t i;
+
+    openConnection( pConnection, 0U );
+    TEST_ASSERT_EQUAL( 0, pthread_create( &serverThread, NULL, mqttServerThread, pConnection ) );
+
+    transport.pNetworkContext = &pConnection->networkContext;
+    transport.recv = UringTransport_Recv;
+    transport.send = UringTransport_Send;
+    transport.writev = UringTransport_Writev;
+    networkBuffer.pBuffer = buffer;
+    networkBuffer.size = sizeof( buffer );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Init( &context, &transport, getTimeMs, eventCallback, &networkBuffer ) );
+
+    connectInfo.cleanSession = true;
+    connectInfo.pClientIdentifier = "uring";
+    connectInfo.clientIdentifierLength = 5U;
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Connect( &context, &connectInfo, NULL, PROCESS_TIMEOUT_MS, &sessionPresent ) );
+
+    publishInfo.qos = MQTTQoS0;
+    publishInfo.pTopicName = "uring/publish";
+    publishInfo.topicNameLength = ( uint16_t ) strlen( publishInfo.pTopicName );
+    publishInfo.pPayload = "payload";
+    publishInfo.payloadLength = 7U;
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_GetPublishPacketSize( &publishInfo, &remainingLength, &packetSize ) );
+
+    /* More publishes than fit in the transmit buffer, which is drained by
+     * the transport itself when full. */
+    for( i = 0U; i < 1000U; i++ )
+    {
+        TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Publish( &context, &publishInfo, 0U ) );
+    }
+
+    /* The DISCONNECT is staged, and written before the connection closes. */
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Disconnect( &context ) );
+    TEST_ASSERT_EQUAL( URING_TRANSPORT_SUCCESS, UringTransport_Disconnect( &pConnection->networkContext ) );
+    TEST_ASSERT_EQUAL( 0, pthread_join( serverThread, NULL ) );
+
+    TEST_ASSERT_EQUAL( ( 1000U * packetSize ) + 2U, pConnection->peerBytesReceived );
+}
@@ -0,0 +1,730 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file websocket_transport_system_test.c
+ * @brief System tests of the WebSocket adapter over the POSIX TCP transport,
+ * against a stand-in server on a loopback connection.
+ */
+
+#define _POSIX_C_SOURCE    200809L
+
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "unity.h"
+
+#include "core_mqtt.h"
+#include "tcp_posix_transport.h"
+#include "websocket_transport.h"
+
+/**
+ * @brief Each compilation unit that uses a transport must define the
+ * NetworkContext struct. Both transports used here only keep a pointer to
+ * their parameters in it.
+ */
+struct NetworkContext
+{
+    void * pParams;
+};
+
+/**
+ * @brief Timeout for establishing connections.
+ */
+#define CONNECT_TIMEOUT_MS          ( 1000U )
+
+/**
+ * @brief Size of the transmit buffer of the adapter.
+ */
+#define TX_BUFFER_SIZE              ( 1024U )
+
+/**
+ * @brief Number of publishes sent over the WebSocket.
+ */
+#define PUBLISH_COUNT               ( 100U )
+
+/**
+ * @brief Handshake response of the stand-in server. The accept value is the
+ * one of the key produced by #getRandom, "the sample nonce" in base64.
+ */
+#define HANDSHAKE_RESPONSE                                  \
+    "HTTP/1.1 101 Switching Protocols\r\n"                  \
+    "Upgrade: websocket\r\n"                                \
+    "Connection: Upgrade\r\n"                               \
+    "sec-websocket-accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n" \
+    "Sec-WebSocket-Protocol: mqtt\r\n"                      \
+    "\r\n"
+
+/**
+ * @brief A WebSocket of the tests: the adapter over the TCP transport on the
+ * client side, and a plain blocking socket on the server side.
+ */
+typedef struct WebSocketConnection
+{
+    TcpPosixTransportParams_t tcpParams;
+    NetworkContext_t tcpContext;
+    WebSocketTransportParams_t webSocketParams;
+    NetworkContext_t webSocketContext;
+    uint8_t txBuffer[ TX_BUFFER_SIZE ];
+    int serverSocket;
+} WebSocketConnection_t;
+
+/**
+ * @brief Data sent by a server thread.
+ */
+typedef struct ServerSend
+{
+    int serverSocket;
+    const uint8_t * pData;
+    size_t length;
+} ServerSend_t;
+
+/**
+ * @brief The connection used by the test, closed by tearDown.
+ */
+static WebSocketConnection_t connection;
+
+/**
+ * @brief Number of words returned by #getRandom.
+ */
+static size_t randomCount;
+
+/**
+ * @brief State of the pseudo-random sequence of #getRandom.
+ */
+static uint32_t randomState;
+
+/* ============================   UNITY FIXTURES ============================ */
+
+/* Called before each test method. */
+void setUp( void )
+{
+    ( void ) memset( &connection, 0x00, sizeof( connection ) );
+    connection.tcpParams.socketDescriptor = -1;
+    connection.tcpContext.pParams = &connection.tcpParams;
+    connection.webSocketContext.pParams = &connection.webSocketParams;
+    connection.serverSocket = -1;
+    randomCount = 0U;
+    randomState = 0x12345678U;
+}
+
+/* Called after each test method. */
+void tearDown( void )
+{
+    if( connection.tcpParams.socketDescriptor >= 0 )
+    {
+        ( void ) TcpPosixTransport_Disconnect( &connection.tcpContext );
+    }
+
+    if( connection.serverSocket >= 0 )
+    {
+        ( void ) close( connection.serverSocket );
+    }
+}
+
+/* Called at the beginning of the whole suite. */
+void suiteSetUp()
+{
+}
+
+/* Called at the end of the whole suite. */
+int suiteTearDown( int numFailures )
+{
+    return numFailures;
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Return "the sample nonce" first, so that the handshake key is the
+ * one of the example of RFC 6455, and then a pseudo-random sequence.
+ */
+static uint32_t getRandom( void )
+{
+    static const uint32_t nonce[] = { 0x74686520U, 0x73616D70U, 0x6C65206EU, 0x6F6E6365U };
+    uint32_t value;
+
+    if( randomCount < 4U )
+    {
+        value = nonce[ randomCount ];
+    }
+    else
+    {
+        randomState ^= randomState << 13;
+        randomState ^= randomState >> 17;
+        randomState ^= randomState << 5;
+        value = randomState;
+    }
+
+    randomCount++;
+
+    return value;
+}
+
+static uint32_t getTimeMs( void )
+{
+    struct timespec now;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( uint32_t ) ( ( now.tv_sec * 1000 ) + ( now.tv_nsec / 1000000 ) );
+}
+
+static void eventCallback( MQTTContext_t * pContext,
+                           MQTTPacketInfo_t * pPacketInfo,
+                           MQTTDeserializedInfo_t * pDeserializedInfo )
+{
+    ( void ) pContext;
+    ( void ) pPacketInfo;
+    ( void ) pDeserializedInfo;
+}
+
+/**
+ * @brief Read exactly the given number of bytes from a blocking socket.
+ */
+static bool readExact( int socketDescriptor,
+                       uint8_t * pBuffer,
+                       size_t length )
+{
+    size_t received = 0U;
+    ssize_t result = 1;
+
+    while( ( received < length ) && ( result > 0 ) )
+    {
+        result = recv( socketDescriptor, &pBuffer[ received ], length - received, 0 );
+
+        if( result > 0 )
+        {
+            received += ( size_t ) result;
+        }
+    }
+
+    return received == length;
+}
+
+/**
+ * @brief Write all the given bytes to a blocking socket.
+ */
+static void writeAll( int socketDescriptor,
+                      const void * pData,
+                      size_t length )
+{
+    TEST_ASSERT_EQUAL( ( ssize_t ) length, send( socketDescriptor, pData, length, 0 ) );
+}
+
+/**
+ * @brief Server thread writing a large buffer, which would not fit in the
+ * socket buffers while the client is not reading.
+ */
+static void * serverSendThread( void * pArgument )
+{
+    const ServerSend_t * pSend = ( const ServerSend_t * ) pArgument;
+
+    ( void ) send( pSend->serverSocket, pSend->pData, pSend->length, 0 );
+
+    return NULL;
+}
+
+/**
+ * @brief Connect the TCP transport to a new loopback server, and set up the
+ * adapter over it.
+ */
+static void openConnection( WebSocketConnection_t * pConnection )
+{
+    struct sockaddr_in address;
+    socklen_t addressLength = sizeof( address );
+    TransportInterface_t tcpTransport = { 0 };
+    int listenSocket = socket( AF_INET, SOCK_STREAM, 0 );
+
+    TEST_ASSERT_GREATER_OR_EQUAL( 0, listenSocket );
+
+    ( void ) memset( &address, 0x00, sizeof( address ) );
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+
+    TEST_ASSERT_EQUAL( 0, bind( listenSocket, ( struct sockaddr * ) &address, sizeof( address ) ) );
+    TEST_ASSERT_EQUAL( 0, listen( listenSocket, 1 ) );
+    TEST_ASSERT_EQUAL( 0, getsockname( listenSocket, ( struct sockaddr * ) &address, &addressLength ) );
+
+    TEST_ASSERT_EQUAL( TCP_POSIX_TRANSPORT_SUCCESS,
+                       TcpPosixTransport_Connect( &pConnection->tcpContext, "127.0.0.1",
+                                                  ntohs( address.sin_port ), CONNECT_TIMEOUT_MS ) );
+
+    pConnection->serverSocket = accept( listenSocket, NULL, NULL );
+    TEST_ASSERT_GREATER_OR_EQUAL( 0, pConnection->serverSocket );
+    ( void ) close( listenSocket );
+
+    tcpTransport.pNetworkContext = &pConnection->tcpContext;
+    tcpTransport.recv = TcpPosixTransport_Recv;
+    tcpTransport.send = TcpPosixTransport_Send;
+    tcpTransport.writev = TcpPosixTransport_Writev;
+
+    TEST_ASSERT_EQUAL( WEBSOCKET_TRANSPORT_SUCCESS,
+                       WebSocketTransport_Init( &pConnection->webSocketContext, &tcpTransport, getRandom,
+                                                pConnection->txBuffer, sizeof( pConnection->txBuffer ) ) );
+}
+
+/**
+ * @brief Read the handshake request on the server side, up to the blank line
+ * ending it.
+ */
+static void readRequest( int serverSocket,
+                         char * pRequest,
+                         size_t size )
+{
+    size_t length = 0U;
+
+    while( ( length < 4U ) || ( memcmp( &pRequest[ length - 4U ], "\r\n\r\n", 4U ) != 0 ) )
+    {
+        TEST_ASSERT_LESS_THAN( size - 1U, length );
+        TEST_ASSERT_TRUE( readExact( serverSocket, ( uint8_t * ) &pRequest[ length ], 1U ) );
+        length++;
+    }
+
+    pRequest[ length ] = '\0';
+}
+
+/**
+ * @brief Answer the handshake, let the client complete it and check the
+ * request on the server side.
+ */
+static void establish( WebSocketConnection_t * pConnection )
+{
+    char request[ 512 ];
+
+    /* The key is known in advance, so the response is written first. */
+    writeAll( pConnection->serverSocket, HANDSHAKE_RESPONSE, sizeof( HANDSHAKE_RESPONSE ) - 1U );
+
+    TEST_ASSERT_EQUAL( WEBSOCKET_TRANSPORT_SUCCESS,
+                       WebSocketTransport_Handshake( &pConnection->webSocketContext, "localhost", "/mqtt",
+                                                     getTimeMs, CONNECT_TIMEOUT_MS ) );
+
+    readRequest( pConnection->serverSocket, request, sizeof( request ) );
+    TEST_ASSERT_EQUAL( 0, strncmp( request, "GET /mqtt HTTP/1.1\r\n", 20U ) );
+    TEST_ASSERT_NOT_NULL( strstr( request, "\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n" ) );
+    TEST_ASSERT_NOT_NULL( strstr( request, "\r\nSec-WebSocket-Protocol: mqtt\r\n" ) );
+    TEST_ASSERT_NOT_NULL( strstr( request, "\r\nSec-WebSocket-Version: 13\r\n" ) );
+}
+
+/**
+ * @brief Read a frame sent by the client on the server side, and unmask its
+ * payload with a plain byte loop.
+ *
+ * @return The payload length.
+ */
+static size_t readFrame( int serverSocket,
+                         uint8_t * pOpcode,
+                         uint8_t * pPayload,
+                         size_t size )
+{
+    uint8_t header[ 8 ];
+    uint8_t maskKey[ 4 ];
+    size_t length, index;
+
+    TEST_ASSERT_TRUE( readExact( serverSocket, header, 2U ) );
+
+    /* Client frames are final and masked. */
+    TEST_ASSERT_EQUAL_HEX8( 0x80U, header[ 0 ] & 0xF0U );
+    TEST_ASSERT_EQUAL_HEX8( 0x80U, header[ 1 ] & 0x80U );
+    *pOpcode = header[ 0 ] & 0x0FU;
+    length = header[ 1 ] & 0x7FU;
+
+    if( length == 126U )
+    {
+        TEST_ASSERT_TRUE( readExact( serverSocket, header, 2U ) );
+        length = ( ( size_t ) header[ 0 ] << 8 ) | header[ 1 ];
+        TEST_ASSERT_GREATER_OR_EQUAL( 126U, length );
+    }
+    else if( length == 127U )
+    {
+        TEST_ASSERT_TRUE( readExact( serverSocket, header, 8U ) );
+        length = 0U;
+
+        for( index = 0U; index < 8U; index++ )
+        {
+            length = ( length << 8 ) | header[ index ];
+        }
+
+        TEST_ASSERT_GREATER_THAN( 0xFFFFU, length );
+    }
+
+    TEST_ASSERT_LESS_OR_EQUAL( size, length );
+    TEST_ASSERT_TRUE( readExact( serverSocket, maskKey, sizeof( maskKey ) ) );
+    TEST_ASSERT_TRUE( readExact( serverSocket, pPayload, length ) );
+
+    for( index = 0U; index < length; index++ )
+    {
+        pPayload[ index ] ^= maskKey[ index % 4U ];
+    }
+
+    return length;
+}
+
+/**
+ * @brief Receive exactly the given number of payload bytes from the adapter.
+ */
+static void recvExact( uint8_t * pBuffer,
+                       size_t length )
+{
+    size_t received = 0U;
+    int32_t result = 0;
+    uint32_t startMs = getTimeMs();
+
+    while( ( received < length ) && ( result >= 0 ) && ( ( getTimeMs() - startMs ) < CONNECT_TIMEOUT_MS ) )
+    {
+        result = WebSocketTransport_Recv( &connection.webSocketContext, &pBuffer[ received ], length - received );
+
+        if( result > 0 )
+        {
+            received += ( size_t ) result;
+        }
+    }
+
+    TEST_ASSERT_EQUAL( length, received );
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Invalid parameters are rejected.
+ */
+void test_WebSocketTransport_Invalid_Params( void )
+{
+    TransportInterface_t tcpTransport = { 0 };
+    uint8_t byte = 0U;
+
+    tcpTransport.pNetworkContext = &connection.tcpContext;
+    tcpTransport.recv = TcpPosixTransport_Recv;
+    tcpTransport.send = TcpPosixTransport_Send;
+
+    TEST_ASSERT_EQUAL( WEBSOCKET_TRANSPORT_INVALID_PARAMETER,
+                       WebSocketTransport_Init( NULL, &tcpTransport, getRandom, connection.txBuffer, TX_BUFFER_SIZE ) );
+    TEST_ASSERT_EQUAL( WEBSOCKET_TRANSPORT_INVALID_PARAMETER,
+                       WebSocketTransport_Init( &connection.webSocketContext, NULL, getRandom, connection.txBuffer, TX_BUFFER_SIZE ) );
+    TEST_ASSERT_EQUAL( WEBSOCKET_TRANSPORT_INVALID_PARAMETER,
+                       WebSocketTransport_Init( &connection.webSocketContext, &tcpTransport, NULL, connection.txBuffer, TX_BUFFER_SIZE ) );
+    TEST_ASSERT_EQUAL( WEBSOCKET_TRANSPORT_INVALID_PARAMETER,
+                       WebSocketTransport_Init( &connection.webSocketContext, &tcpTransport, getRandom, connection.txBuffer,
+                                                WEBSOCKET_TRANSPORT_MAX_HEADER_SIZE ) );
+
+    /* The adapter is not set up. */
+    TEST_ASSERT_EQUAL( WEBSOCKET_TRANSPORT_INVALID_PARAMETER,
+                       WebSocketTransport_Handshake( &connection.webSocketContext, "localhost", "/mqtt", getTimeMs, 0U ) );
+    TEST_ASSERT_EQUAL( WEBSOCKET_TRANSPORT_INVALID_PARAMETER, WebSocketTransport_Close( &connection.webSocketContext ) );
+    TEST_ASSERT_LESS_THAN( 0, WebSocketTransport_Recv( &connection.webSocketContext, &byte, 1U ) );
+    TEST_ASSERT_LESS_THAN( 0, WebSocketTransport_Send( &connection.webSocketContext, &byte, 1U ) );
+
+    TEST_ASSERT_EQUAL( WEBSOCKET_TRANSPORT_SUCCESS,
+                       WebSocketTransport_Init( &connection.webSocketContext, &tcpTransport, getRandom,
+                                                connection.txBuffer, TX_BUFFER_SIZE ) );
+    TEST_ASSERT_EQUAL( WEBSOCKET_TRANSPORT_INVALID_PARAMETER,
+                       WebSocketTransport_Handshake( &connection.webSocketContext, NULL, "/mqtt", getTimeMs, 0U ) );
+    TEST_ASSERT_EQUAL( WEBSOCKET_TRANSPORT_INVALID_PARAMETER,
+                       WebSocketTransport_Handshake( &connection.webSocketContext, "localhost", "/mqtt", NULL, 0U ) );
+    TEST_ASSERT_LESS_THAN( 0, WebSocketTransport_Writev( &connection.webSocketContext, NULL, 1U ) );
+}
+
+/**
+ * @brief The handshake fails when the server answers with the wrong accept
+ * value, or refuses the upgrade.
+ */
+void test_WebSocketTransport_Handshake_Rejected( void )
+{
+    static const char wrongAccept[] =
+        "HTTP/1.1 101 Switching Protocols\r\n"
+        "Sec-WebSocket-Accept: dGhlIHNhbXBsZSBub25jZQ==AAAA\r\n"
+        "\r\n";
+    static const char refused[] =
+        "HTTP/1.1 400 Bad Request\r\n"
+        "Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n"
+        "\r\n";
+
+    openConnection( &connection );
+    writeAll( connection.serverSocket, wrongAccept, sizeof( wrongAccept ) - 1U );
+    TEST_ASSERT_EQUAL( WEBSOCKET_TRANSPORT_HANDSHAKE_FAILURE,
+                       WebSocketTransport_Handshake( &connection.webSocketContext, "localhost", "/mqtt",
+                                                     getTimeMs, CONNECT_TIMEOUT_MS ) );
+
+    randomCount = 0U;
+    writeAll( connection.serverSocket, refused, sizeof( refused ) - 1U );
+    TEST_ASSERT_EQUAL( WEBSOCKET_TRANSPORT_HANDSHAKE_FAILURE,
+                       WebSocketTransport_Handshake( &connection.webSocketContext, "localhost", "/mqtt",
+                                                     getTimeMs, CONNECT_TIMEOUT_MS ) );
+
+    /* A server which never answers times out. */
+    randomCount = 0U;
+    TEST_ASSERT_EQUAL( WEBSOCKET_TRANSPORT_TRANSPORT_FAILURE,
+                       WebSocketTransport_Handshake( &connection.webSocketContext, "localhost", "/mqtt",
+                                                     getTimeMs, 50U ) );
+}
+
+/**
+ * @brief Every vector batch goes out as one frame, masked correctly whatever
+ * the lengths of the vectors and the position of the masking key at their
+ * boundaries; payloads larger than the buffer are split across calls.
+ */
+void test_WebSocketTransport_Writev_Masking( void )
+{
+    static uint8_t data[ TX_BUFFER_SIZE ];
+    static uint8_t received[ TX_BUFFER_SIZE ];
+    TransportOutVector_t ioVectors[ 3 ];
+    size_t firstLength, totalLength, length;
+    uint8_t opcode = 0U;
+    int32_t result;
+
+    openConnection( &connection );
+    establish( &connection );
+
+    for( length = 0U; length < sizeof( data ); length++ )
+    {
+        data[ length ] = ( uint8_t ) ( ( length * 7U ) + 3U );
+    }
+
+    /* Cover every vector loop and tail, and every key phase at the vector
+     * boundaries, including the 16-bit length form. */
+    for( totalLength = 1U; totalLength < 300U; totalLength += 13U )
+    {
+        for( firstLength = 0U; firstLength < 5U; firstLength++ )
+        {
+            ioVectors[ 0 ].iov_base = data;
+            ioVectors[ 0 ].iov_len = firstLength;
+            ioVectors[ 1 ].iov_base = &data[ firstLength ];
+            ioVectors[ 1 ].iov_len = totalLength / 2U;
+            ioVectors[ 2 ].iov_base = &data[ firstLength + ( totalLength / 2U ) ];
+            ioVectors[ 2 ].iov_len = totalLength - ( totalLength / 2U );
+
+            result = WebSocketTransport_Writev( &connection.webSocketContext, ioVectors, 3U );
+            TEST_ASSERT_EQUAL( ( int32_t ) ( firstLength + totalLength ), result );
+
+            length = readFrame( connection.serverSocket, &opcode, received, sizeof( received ) );
+            TEST_ASSERT_EQUAL_HEX8( 0x2U, opcode );
+            TEST_ASSERT_EQUAL( firstLength + totalLength, length );
+            TEST_ASSERT_EQUAL_MEMORY( data, received, length );
+        }
+    }
+
+    /* A send larger than the buffer is framed partially, and coreMQTT sends
+     * the rest with the next call. */
+    result = WebSocketTransport_Send( &connection.webSocketContext, data, sizeof( data ) );
+    TEST_ASSERT_EQUAL( ( int32_t ) ( TX_BUFFER_SIZE - WEBSOCKET_TRANSPORT_MAX_HEADER_SIZE ), result );
+    length = readFrame( connection.serverSocket, &opcode, received, sizeof( received ) );
+    TEST_ASSERT_EQUAL( ( size_t ) result, length );
+    TEST_ASSERT_EQUAL_MEMORY( data, received, length );
+}
+
+/**
+ * @brief Frames with 16-bit and 64-bit lengths, masked or not, are unframed
+ * into the caller's buffer; pings are answered and fragments joined.
+ */
+void test_WebSocketTransport_Recv_Frames( void )
+{
+    static uint8_t frames[ 80000 ];
+    static uint8_t payload[ 70000 ];
+    static uint8_t received[ 70000 ];
+    static const uint8_t maskKey[ 4 ] = { 0x11U, 0x22U, 0x33U, 0x44U };
+    ServerSend_t serverSend;
+    pthread_t serverThread;
+    size_t length = 0U, index;
+    uint8_t opcode = 0U;
+
+    openConnection( &connection );
+    establish( &connection );
+
+    for( index = 0U; index < sizeof( payload ); index++ )
+    {
+        payload[ index ] = ( uint8_t ) ( index ^ ( index >> 8 ) );
+    }
+
+    /* A first fragment with a 64-bit length. */
+    frames[ length++ ] = 0x02U;
+    frames[ length++ ] = 127U;
+    frames[ length++ ] = 0U;
+    frames[ length++ ] = 0U;
+    frames[ length++ ] = 0U;
+    frames[ length++ ] = 0U;
+    frames[ length++ ] = 0U;
+    frames[ length++ ] = ( uint8_t ) ( 69000U >> 16 );
+    frames[ length++ ] = ( uint8_t ) ( 69000U >> 8 );
+    frames[ length++ ] = ( uint8_t ) 69000U;
+    ( void ) memcpy( &frames[ length ], payload, 69000U );
+    length += 69000U;
+
+    /* A masked ping in the middle of the message. */
+    frames[ length++ ] = 0x89U;
+    frames[ length++ ] = 0x80U | 4U;
+    ( void ) memcpy( &frames[ length ], maskKey, sizeof( maskKey ) );
+    length += sizeof( maskKey );
+
+    for( index = 0U; index < 4U; index++ )
+    {
+        frames[ length++ ] = ( uint8_t ) ( "ping"[ index ] ^ maskKey[ index ] );
+    }
+
+    /* The final fragment, masked, with a 16-bit length. */
+    frames[ length++ ] = 0x80U;
+    frames[ length++ ] = 0x80U | 126U;
+    frames[ length++ ] = ( uint8_t ) ( 1000U >> 8 );
+    frames[ length++ ] = ( uint8_t ) 1000U;
+    ( void ) memcpy( &frames[ length ], maskKey, sizeof( maskKey ) );
+    length += sizeof( maskKey );
+
+    for( index = 0U; index < 1000U; index++ )
+    {
+        frames[ length++ ] = payload[ 69000U + index ] ^ maskKey[ index % 4U ];
+    }
+
+    serverSend.serverSocket = connection.serverSocket;
+    serverSend.pData = frames;
+    serverSend.length = length;
+    TEST_ASSERT_EQUAL( 0, pthread_create( &serverThread, NULL, serverSendThread, &serverSend ) );
+
+    recvExact( received, sizeof( received ) );
+    TEST_ASSERT_EQUAL( 0, pthread_join( serverThread, NULL ) );
+    TEST_ASSERT_EQUAL_MEMORY( payload, received, sizeof( received ) );
+
+    /* The ping was answered with its payload. */
+    length = readFrame( connection.serverSocket, &opcode, received, sizeof( received ) );
+    TEST_ASSERT_EQUAL_HEX8( 0xAU, opcode );
+    TEST_ASSERT_EQUAL( 4U, length );
+    TEST_ASSERT_EQUAL_MEMORY( "ping", received, 4U );
+
+    /* Nothing more to receive. */
+    TEST_ASSERT_EQUAL( 0, WebSocketTransport_Recv( &connection.webSocketContext, received, 1U ) );
+}
+
+/**
+ * @brief A close frame from the server is reported as a failed connection,
+ * and a close from the client is sent as a close frame.
+ */
+void test_WebSocketTransport_Close( void )
+{
+    static const uint8_t closeFrame[] = { 0x88U, 0x02U, 0x03U, 0xE8U };
+    uint8_t received[ 8 ];
+    uint8_t opcode = 0U;
+    int32_t result;
+
+    openConnection( &connection );
+    establish( &connection );
+
+    writeAll( connection.serverSocket, closeFrame, sizeof( closeFrame ) );
+
+    do
+    {
+        result = WebSocketTransport_Recv( &connection.webSocketContext, received, sizeof( received ) );
+    } while( result == 0 );
+
+    TEST_ASSERT_LESS_THAN( 0, result );
+    TEST_ASSERT_LESS_THAN( 0, WebSocketTransport_Send( &connection.webSocketContext, "x", 1U ) );
+
+    TEST_ASSERT_EQUAL( WEBSOCKET_TRANSPORT_SUCCESS, WebSocketTransport_Close( &connection.webSocketContext ) );
+    TEST_ASSERT_EQUAL( 2U, readFrame( connection.serverSocket, &opcode, received, sizeof( received ) ) );
+    TEST_ASSERT_EQUAL_HEX8( 0x8U, opcode );
+    TEST_ASSERT_EQUAL_HEX8( 0x03U, received[ 0 ] );
+    TEST_ASSERT_EQUAL_HEX8( 0xE8U, received[ 1 ] );
+}
+
+/**
+ * @brief coreMQTT runs over the adapter unchanged: the CONNACK arrives
+ * fragmented around a ping, and every packet goes out as one frame.
+ */
+void test_WebSocketTransport_MQTT_Session( void )
+{
+    static const uint8_t connackFrames[] =
+    {
+        0x02U, 0x02U, 0x20U, 0x02U, /* First fragment. */
+        0x89U, 0x00U,               /* Empty ping. */
+        0x80U, 0x02U, 0x00U, 0x00U  /* Final fragment. */
+    };
+    MQTTContext_t context;
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer;
+    MQTTConnectInfo_t connectInfo = { 0 };
+    MQTTPublishInfo_t publishInfo = { 0 };
+    uint8_t buffer[ 128 ];
+    uint8_t received[ 128 ];
+    bool sessionPresent = false;
+    size_t remainingLength = 0U, packetSize = 0U, length;
+    uint8_t opcode = 0U;
+    uint32_t i;
+
+    openConnection( &connection );
+    establish( &connection );
+    writeAll( connection.serverSocket, connackFrames, sizeof( connackFrames ) );
+
+    transport.pNetworkContext = &connection.webSocketContext;
+    transport.recv = WebSocketTransport_Recv;
+    transport.send = WebSocketTransport_Send;
+    transport.writev = WebSocketTransport_Writev;
+    networkBuffer.pBuffer = buffer;
+    networkBuffer.size = sizeof( buffer );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Init( &context, &transport, getTimeMs, eventCallback, &networkBuffer ) );
+
+    connectInfo.cleanSession = true;
+    connectInfo.pClientIdentifier = "websocket";
+    connectInfo.clientIdentifierLength = 9U;
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Connect( &context, &connectInfo, NULL, CONNECT_TIMEOUT_MS, &sessionPresent ) );
+
+    publishInfo.qos = MQTTQoS0;
+    publishInfo.pTopicName = "websocket/publish";
+    publishInfo.topicNameLength = ( uint16_t ) strlen( publishInfo.pTopicName );
+    publishInfo.pPayload = "payload";
+    publishInfo.payloadLength = 7U;
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_GetPublishPacketSize( &publishInfo, &remainingLength, &packetSize ) );
+
+    for( i = 0U; i < PUBLISH_COUNT; i++ )
+    {
+        TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Publish( &context, &publishInfo, 0U ) );
+    }
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Disconnect( &context ) );
+
+    /* The CONNECT, then the pong sent while waiting for the CONNACK. */
+    length = readFrame( connection.serverSocket, &opcode, received, sizeof( received ) );
+    TEST_ASSERT_EQUAL_HEX8( 0x2U, opcode );
+    TEST_ASSERT_EQUAL_HEX8( 0x10U, received[ 0 ] );
+    TEST_ASSERT_EQUAL( 2U + received[ 1 ], length );
+
+    TEST_ASSERT_EQUAL( 0U, readFrame( connection.serverSocket, &opcode, received, sizeof( received ) ) );
+    TEST_ASSERT_EQUAL_HEX8( 0xAU, opcode );
+
+    /* One frame per publish, each holding the complete packet. */
+    for( i = 0U; i < PUBLISH_COUNT; i++ )
+    {
+        length = readFrame( connection.serverSocket, &opcode, received, sizeof( received ) );
+        TEST_ASSERT_EQUAL_HEX8( 0x2U, opcode );
+        TEST_ASSERT_EQUAL( packetSize, length );
+        TEST_ASSERT_EQUAL_HEX8( 0x30U, received[ 0 ] );
+        TEST_ASSERT_EQUAL_MEMORY( "payload", &received[ packetSize - 7U ], 7U );
+    }
+
+    TEST_ASSERT_EQUAL( 2U, readFrame( connection.serverSocket, &opcode, received, sizeof( received ) ) );
+    TEST_ASSERT_EQUAL_HEX8( 0xE0U, received[ 0 ] );
+}
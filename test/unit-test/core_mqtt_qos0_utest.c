@@ -0,0 +1,332 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file core_mqtt_qos0_utest.c
+ * @brief Unit tests for functions in core_mqtt.h when the library is built with
+ * MQTT_QOS0_ONLY enabled.
+ *
+ * The serializer is not mocked, so the tests check the bytes exchanged with
+ * the transport.
+ */
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "unity.h"
+
+/* Include paths for public enums, structures, and macros. */
+#include "core_mqtt.h"
+
+#if ( MQTT_QOS0_ONLY == 0 )
+    #error "These tests must be built with MQTT_QOS0_ONLY enabled."
+#endif
+
+/**
+ * @brief Size of the buffers used by the test transport and the network buffer.
+ */
+#define TEST_BUFFER_SIZE    ( 64U )
+
+/**
+ * @brief Transport which replays received bytes and records sent bytes.
+ */
+struct NetworkContext
+{
+    const uint8_t * pRxData;
+    size_t rxLength;
+    size_t rxIndex;
+    uint8_t txData[ TEST_BUFFER_SIZE ];
+    size_t txLength;
+};
+
+/**
+ * @brief The network context used by every test.
+ */
+static NetworkContext_t networkContext;
+
+/**
+ * @brief The network buffer used by every test.
+ */
+static uint8_t networkBuffer[ TEST_BUFFER_SIZE ];
+
+/**
+ * @brief Number of times the event callback was invoked.
+ */
+static size_t eventCallbackCount;
+
+/**
+ * @brief Type of the last packet given to the event callback.
+ */
+static uint8_t lastEventPacketType;
+
+/* ============================   UNITY FIXTURES ============================ */
+
+/* Called before each test method. */
+void setUp( void )
+{
+    ( void ) memset( &networkContext, 0x00, sizeof( networkContext ) );
+    eventCallbackCount = 0U;
+    lastEventPacketType = 0U;
+}
+
+/* Called after each test method. */
+void tearDown( void )
+{
+}
+
+/* Called at the beginning of the whole suite. */
+void suiteSetUp()
+{
+}
+
+/* Called at the end of the whole suite. */
+int suiteTearDown( int numFailures )
+{
+    return numFailures;
+}
+
+/* ========================================================================== */
+
+static int32_t transportRecv( NetworkContext_t * pNetworkContext,
+                              void * pBuffer,
+                              size_t bytesToRecv )
+{
+    size_t bytesLeft = pNetworkContext->rxLength - pNetworkContext->rxIndex;
+
+    if( bytesToRecv > bytesLeft )
+    {
+        bytesToRecv = bytesLeft;
+    }
+
+    ( void ) memcpy( pBuffer, &pNetworkContext->pRxData[ pNetworkContext->rxIndex ], bytesToRecv );
+    pNetworkContext->rxIndex += bytesToRecv;
+
+    return ( int32_t ) bytesToRecv;
+}
+
+static int32_t transportSend( NetworkContext_t * pNetworkContext,
+                              const void * pBuffer,
+                              size_t bytesToSend )
+{
+    TEST_ASSERT_LESS_OR_EQUAL( TEST_BUFFER_SIZE - pNetworkContext->txLength, bytesToSend );
+
+    ( void ) memcpy( &pNetworkContext->txData[ pNetworkContext->txLength ], pBuffer, bytesToSend );
+    pNetworkContext->txLength += bytesToSend;
+
+    return ( int32_t ) bytesToSend;
+}
+
+static uint32_t getTime( void )
+{
+    return 0U;
+}
+
+static void eventCallback( MQTTContext_t * pContext,
+                           MQTTPacketInfo_t * pPacketInfo,
+                           MQTTDeserializedInfo_t * pDeserializedInfo )
+{
+    ( void ) pContext;
+    ( void ) pDeserializedInfo;
+
+    eventCallbackCount++;
+    lastEventPacketType = pPacketInfo->type;
+}
+
+/**
+ * @brief Initialize a context whose transport replays the given bytes.
+ */
+static void setupContext( MQTTContext_t * pContext,
+                          const uint8_t * pRxData,
+                          size_t rxLength )
+{
+    MQTTStatus_t mqttStatus;
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t fixedBuffer;
+
+    networkContext.pRxData = pRxData;
+    networkContext.rxLength = rxLength;
+
+    transport.pNetworkContext = &networkContext;
+    transport.recv = transportRecv;
+    transport.send = transportSend;
+
+    fixedBuffer.pBuffer = networkBuffer;
+    fixedBuffer.size = sizeof( networkBuffer );
+
+    mqttStatus = MQTT_Init( pContext, &transport, getTime, eventCallback, &fixedBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief A QoS0 publish is serialized and sent as in the full build.
+ */
+void test_MQTT_Publish_QoS0( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t context;
+    MQTTPublishInfo_t publishInfo = { 0 };
+    const uint8_t expectedPacket[] = { 0x30, 0x07, 0x00, 0x03, 'a', '/', 'b', 'h', 'i' };
+
+    setupContext( &context, NULL, 0U );
+    context.connectStatus = MQTTConnected;
+
+    publishInfo.qos = MQTTQoS0;
+    publishInfo.pTopicName = "a/b";
+    publishInfo.topicNameLength = 3U;
+    publishInfo.pPayload = "hi";
+    publishInfo.payloadLength = 2U;
+
+    mqttStatus = MQTT_Publish( &context, &publishInfo, 0U );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL( sizeof( expectedPacket ), networkContext.txLength );
+    TEST_ASSERT_EQUAL_MEMORY( expectedPacket, networkContext.txData, sizeof( expectedPacket ) );
+}
+
+/**
+ * @brief Publishes and subscriptions with QoS > 0 are rejected before anything
+ * is sent.
+ */
+void test_MQTT_Publish_Subscribe_QoS1_Rejected( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t context;
+    MQTTPublishInfo_t publishInfo = { 0 };
+    MQTTSubscribeInfo_t subscribeInfo = { 0 };
+
+    setupContext( &context, NULL, 0U );
+    context.connectStatus = MQTTConnected;
+
+    publishInfo.qos = MQTTQoS1;
+    publishInfo.pTopicName = "a/b";
+    publishInfo.topicNameLength = 3U;
+    mqttStatus = MQTT_Publish( &context, &publishInfo, 1U );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    publishInfo.qos = MQTTQoS2;
+    mqttStatus = MQTT_Publish( &context, &publishInfo, 1U );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    subscribeInfo.qos = MQTTQoS1;
+    subscribeInfo.pTopicFilter = "a/#";
+    subscribeInfo.topicFilterLength = 3U;
+    mqttStatus = MQTT_Subscribe( &context, &subscribeInfo, 1U, 1U );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    TEST_ASSERT_EQUAL( 0U, networkContext.txLength );
+
+    subscribeInfo.qos = MQTTQoS0;
+    mqttStatus = MQTT_Subscribe( &context, &subscribeInfo, 1U, 1U );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_NOT_EQUAL( 0U, networkContext.txLength );
+}
+
+/**
+ * @brief An incoming QoS0 publish is given to the application and not
+ * acknowledged.
+ */
+void test_MQTT_ProcessLoop_IncomingQoS0Publish( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t context;
+    const uint8_t incomingPacket[] = { 0x30, 0x07, 0x00, 0x03, 'a', '/', 'b', 'h', 'i' };
+
+    setupContext( &context, incomingPacket, sizeof( incomingPacket ) );
+    context.connectStatus = MQTTConnected;
+
+    mqttStatus = MQTT_ProcessLoop( &context );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL( 1U, eventCallbackCount );
+    TEST_ASSERT_EQUAL_HEX8( MQTT_PACKET_TYPE_PUBLISH, lastEventPacketType );
+    TEST_ASSERT_EQUAL( 0U, networkContext.txLength );
+    TEST_ASSERT_EQUAL( 0U, context.index );
+}
+
+/**
+ * @brief An incoming QoS1 publish is dropped, as it cannot be acknowledged, and
+ * reported as a protocol violation rather than a transport failure.
+ */
+void test_MQTT_ProcessLoop_IncomingQoS1Publish( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t context;
+    const uint8_t incomingPacket[] = { 0x32, 0x09, 0x00, 0x03, 'a', '/', 'b', 0x00, 0x01, 'h', 'i' };
+
+    setupContext( &context, incomingPacket, sizeof( incomingPacket ) );
+    context.connectStatus = MQTTConnected;
+
+    mqttStatus = MQTT_ProcessLoop( &context );
+    TEST_ASSERT_EQUAL( MQTTBadResponse, mqttStatus );
+    TEST_ASSERT_EQUAL( 0U, eventCallbackCount );
+    TEST_ASSERT_EQUAL( 0U, networkContext.txLength );
+}
+
+/**
+ * @brief Publish acks are unexpected, as no QoS1 or QoS2 publish is ever sent.
+ */
+void test_MQTT_ProcessLoop_IncomingPublishAck( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t context;
+    const uint8_t incomingPacket[] = { 0x40, 0x02, 0x00, 0x01 };
+
+    setupContext( &context, incomingPacket, sizeof( incomingPacket ) );
+    context.connectStatus = MQTTConnected;
+
+    mqttStatus = MQTT_ProcessLoop( &context );
+    TEST_ASSERT_EQUAL( MQTTBadResponse, mqttStatus );
+    TEST_ASSERT_EQUAL( 0U, eventCallbackCount );
+}
+
+/**
+ * @brief Resuming a session does not resend anything, as there is no state to
+ * resume.
+ */
+void test_MQTT_Connect_SessionPresent( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t context;
+    MQTTConnectInfo_t connectInfo = { 0 };
+    bool sessionPresent = false;
+    const uint8_t connack[] = { 0x20, 0x02, 0x01, 0x00 };
+    size_t connectLength;
+
+    setupContext( &context, connack, sizeof( connack ) );
+
+    connectInfo.cleanSession = false;
+    connectInfo.pClientIdentifier = "qos0";
+    connectInfo.clientIdentifierLength = 4U;
+    connectInfo.keepAliveSeconds = 60U;
+
+    mqttStatus = MQTT_Connect( &context, &connectInfo, NULL, 0U, &sessionPresent );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_TRUE( sessionPresent );
+    TEST_ASSERT_EQUAL( MQTTConnected, context.connectStatus );
+
+    /* Only the CONNECT packet was sent. */
+    TEST_ASSERT_EQUAL_HEX8( MQTT_PACKET_TYPE_CONNECT, networkContext.txData[ 0 ] );
+    connectLength = 2U + networkContext.txData[ 1 ];
+    TEST_ASSERT_EQUAL( connectLength, networkContext.txLength );
+}
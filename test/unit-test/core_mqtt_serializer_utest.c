@@ -2378,7 +2378,9 @@ void test_MQTT_ProcessIncomingPacketTypeAndLength_InvalidData( void )
     memset( &packetInfo, 0, sizeof( MQTTPacketInfo_t ) );
     memset( pBuffer, 0, 100 );
 
-    pBuffer[ 0 ] = 0xF0;
+    /* The reserved packet type 0. AUTH, the packet type 0xF0, is valid in
+     * MQTT 5. */
+    pBuffer[ 0 ] = 0x00;
 
     status = MQTT_ProcessIncomingPacketTypeAndLength( pBuffer, &index, &packetInfo );
 
@@ -2387,6 +2389,27 @@ void test_MQTT_ProcessIncomingPacketTypeAndLength_InvalidData( void )
 
 /* ========================================================================== */
 
+void test_MQTT_ProcessIncomingPacketTypeAndLength_DisconnectAuth( void )
+{
+    MQTTPacketInfo_t packetInfo;
+    uint8_t pBuffer[ 2 ] = { MQTT_PACKET_TYPE_DISCONNECT, 0x00 };
+    size_t index = sizeof( pBuffer );
+    MQTTStatus_t status;
+
+    memset( &packetInfo, 0, sizeof( MQTTPacketInfo_t ) );
+
+    status = MQTT_ProcessIncomingPacketTypeAndLength( pBuffer, &index, &packetInfo );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL_HEX8( MQTT_PACKET_TYPE_DISCONNECT, packetInfo.type );
+
+    pBuffer[ 0 ] = MQTT_PACKET_TYPE_AUTH;
+    status = MQTT_ProcessIncomingPacketTypeAndLength( pBuffer, &index, &packetInfo );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL_HEX8( MQTT_PACKET_TYPE_AUTH, packetInfo.type );
+}
+
+/* ========================================================================== */
+
 void test_MQTT_ProcessIncomingPacketTypeAndLength_ValidDataOneByte( void )
 {
     MQTTPacketInfo_t packetInfo;
@@ -2919,3 +2942,1047 @@ void test_MQTT_UpdateDuplicatePublishFlag_Happy_Path()
 }
 
 /* ========================================================================== */
+
+/* ========================  Testing MQTT 5 functions ======================= */
+
+/**
+ * @brief Test the packet sizes of MQTT 5, which include the property lengths.
+ */
+void test_MQTT_GetPacketSizeV5( void )
+{
+    MQTTConnectInfo_t connectInfo;
+    MQTTPublishInfo_t willInfo;
+    MQTTPublishInfo_t publishInfo;
+    MQTTSubscribeInfo_t subscriptionList;
+    size_t remainingLength = 0, packetSize = 0;
+    size_t remainingLengthV5 = 0, packetSizeV5 = 0;
+    MQTTStatus_t status;
+
+    memset( &connectInfo, 0x0, sizeof( connectInfo ) );
+    connectInfo.pClientIdentifier = CLIENT_IDENTIFIER;
+    connectInfo.clientIdentifierLength = CLIENT_IDENTIFIER_LENGTH;
+    memset( &willInfo, 0x0, sizeof( willInfo ) );
+    willInfo.pTopicName = TEST_TOPIC_NAME;
+    willInfo.topicNameLength = TEST_TOPIC_NAME_LENGTH;
+
+    /* The CONNECT has a property length, and so has the will message. */
+    status = MQTT_GetConnectPacketSize( &connectInfo, &willInfo, &remainingLength, &packetSize );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    status = MQTT_GetConnectPacketSizeV5( &connectInfo, &willInfo, &remainingLengthV5, &packetSizeV5 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( remainingLength + 2U, remainingLengthV5 );
+    TEST_ASSERT_EQUAL( packetSize + 2U, packetSizeV5 );
+    status = MQTT_GetConnectPacketSizeV5( NULL, NULL, &remainingLengthV5, &packetSizeV5 );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+
+    memset( &subscriptionList, 0x0, sizeof( subscriptionList ) );
+    subscriptionList.pTopicFilter = TEST_TOPIC_NAME;
+    subscriptionList.topicFilterLength = TEST_TOPIC_NAME_LENGTH;
+
+    status = MQTT_GetSubscribePacketSize( &subscriptionList, 1, &remainingLength, &packetSize );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    status = MQTT_GetSubscribePacketSizeV5( &subscriptionList, 1, 0U, &remainingLengthV5, &packetSizeV5 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( remainingLength + 1U, remainingLengthV5 );
+
+    /* A Subscription Identifier adds its identifier byte and its Variable
+     * Byte Integer encoding. */
+    status = MQTT_GetSubscribePacketSizeV5( &subscriptionList, 1, 127U, &remainingLengthV5, &packetSizeV5 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( remainingLength + 3U, remainingLengthV5 );
+    status = MQTT_GetSubscribePacketSizeV5( &subscriptionList, 1, MQTT_SUBSCRIPTION_ID_MAX, &remainingLengthV5, &packetSizeV5 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( remainingLength + 6U, remainingLengthV5 );
+    status = MQTT_GetSubscribePacketSizeV5( &subscriptionList, 1, MQTT_SUBSCRIPTION_ID_MAX + 1U, &remainingLengthV5, &packetSizeV5 );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+
+    status = MQTT_GetUnsubscribePacketSize( &subscriptionList, 1, &remainingLength, &packetSize );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    status = MQTT_GetUnsubscribePacketSizeV5( &subscriptionList, 1, &remainingLengthV5, &packetSizeV5 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( remainingLength + 1U, remainingLengthV5 );
+
+    memset( &publishInfo, 0x0, sizeof( publishInfo ) );
+    publishInfo.pTopicName = TEST_TOPIC_NAME;
+    publishInfo.topicNameLength = TEST_TOPIC_NAME_LENGTH;
+
+    /* Without a topic alias, only the property length is added. */
+    status = MQTT_GetPublishPacketSize( &publishInfo, &remainingLength, &packetSize );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    status = MQTT_GetPublishPacketSizeV5( &publishInfo, 0U, &remainingLengthV5, &packetSizeV5 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( remainingLength + 1U, remainingLengthV5 );
+
+    /* The Topic Alias property takes 3 bytes. */
+    status = MQTT_GetPublishPacketSizeV5( &publishInfo, 1U, &remainingLengthV5, &packetSizeV5 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( remainingLength + 4U, remainingLengthV5 );
+
+    /* The topic name may only be empty with a topic alias. */
+    publishInfo.pTopicName = NULL;
+    publishInfo.topicNameLength = 0U;
+    status = MQTT_GetPublishPacketSizeV5( &publishInfo, 0U, &remainingLengthV5, &packetSizeV5 );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+    status = MQTT_GetPublishPacketSizeV5( &publishInfo, 1U, &remainingLengthV5, &packetSizeV5 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( remainingLength + 4U - TEST_TOPIC_NAME_LENGTH, remainingLengthV5 );
+
+    publishInfo.topicNameLength = TEST_TOPIC_NAME_LENGTH;
+    status = MQTT_GetPublishPacketSizeV5( &publishInfo, 1U, &remainingLengthV5, &packetSizeV5 );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+    status = MQTT_GetPublishPacketSizeV5( NULL, 1U, &remainingLengthV5, &packetSizeV5 );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+
+}
+
+/**
+ * @brief Test the serialization of the MQTT 5 header fields.
+ */
+void test_MQTT_SerializeHeadersV5( void )
+{
+    uint8_t buffer[ 32 ];
+    uint8_t * pIndex;
+    MQTTConnectInfo_t connectInfo;
+
+    /* Publish properties with and without a topic alias. */
+    pIndex = MQTT_SerializePublishPropertiesV5( 0x1234U, buffer );
+    TEST_ASSERT_EQUAL_PTR( &buffer[ 4 ], pIndex );
+    TEST_ASSERT_EQUAL_HEX8( 3U, buffer[ 0 ] );
+    TEST_ASSERT_EQUAL_HEX8( 0x23U, buffer[ 1 ] );
+    TEST_ASSERT_EQUAL_HEX8( 0x12U, buffer[ 2 ] );
+    TEST_ASSERT_EQUAL_HEX8( 0x34U, buffer[ 3 ] );
+
+    pIndex = MQTT_SerializePublishPropertiesV5( 0U, buffer );
+    TEST_ASSERT_EQUAL_PTR( &buffer[ 1 ], pIndex );
+    TEST_ASSERT_EQUAL_HEX8( 0U, buffer[ 0 ] );
+
+    /* The protocol level is 5 and an empty property length follows the
+     * keep-alive interval. */
+    memset( &connectInfo, 0x0, sizeof( connectInfo ) );
+    connectInfo.keepAliveSeconds = 60U;
+    memset( buffer, 0xFF, sizeof( buffer ) );
+    pIndex = MQTT_SerializeConnectFixedHeaderV5( buffer, &connectInfo, NULL, 20U );
+    TEST_ASSERT_EQUAL_PTR( &buffer[ 13 ], pIndex );
+    TEST_ASSERT_EQUAL_HEX8( MQTT_VERSION_5, buffer[ 8 ] );
+    TEST_ASSERT_EQUAL_HEX8( 60U, buffer[ 11 ] );
+    TEST_ASSERT_EQUAL_HEX8( 0U, buffer[ 12 ] );
+
+    pIndex = MQTT_SerializeSubscribeHeaderV5( 10U, buffer, 1U, 0U );
+    TEST_ASSERT_EQUAL_PTR( &buffer[ 5 ], pIndex );
+    TEST_ASSERT_EQUAL_HEX8( 0U, buffer[ 4 ] );
+
+    /* A Subscription Identifier of 200 is encoded in two bytes. */
+    pIndex = MQTT_SerializeSubscribeHeaderV5( 10U, buffer, 1U, 200U );
+    TEST_ASSERT_EQUAL_PTR( &buffer[ 8 ], pIndex );
+    TEST_ASSERT_EQUAL_HEX8( 3U, buffer[ 4 ] );
+    TEST_ASSERT_EQUAL_HEX8( 0x0BU, buffer[ 5 ] );
+    TEST_ASSERT_EQUAL_HEX8( 0xC8U, buffer[ 6 ] );
+    TEST_ASSERT_EQUAL_HEX8( 0x01U, buffer[ 7 ] );
+
+    /* The largest identifier fills the header. */
+    pIndex = MQTT_SerializeSubscribeHeaderV5( 268435455U, buffer, 1U, MQTT_SUBSCRIPTION_ID_MAX );
+    TEST_ASSERT_EQUAL_PTR( &buffer[ MQTT_SUBSCRIBE_HEADER_MAX_SIZE_V5 ], pIndex );
+
+    pIndex = MQTT_SerializeUnsubscribeHeaderV5( 10U, buffer, 1U );
+    TEST_ASSERT_EQUAL_PTR( &buffer[ 5 ], pIndex );
+    TEST_ASSERT_EQUAL_HEX8( 0U, buffer[ 4 ] );
+}
+
+/**
+ * @brief Test the deserialization of MQTT 5 CONNACK packets.
+ */
+void test_MQTT_DeserializeAckV5_Connack( void )
+{
+    MQTTPacketInfo_t packetInfo;
+    MQTTConnackProperties_t properties;
+    bool sessionPresent = false;
+    MQTTStatus_t status;
+
+    /* Topic Alias Maximum of 10, a User Property and a Server Keep Alive of
+     * 30 seconds. */
+    uint8_t connack[] = { 0x00, 0x00, 13U,
+                          0x22, 0x00, 0x0A,
+                          0x26, 0x00, 0x01, 'k', 0x00, 0x01, 'v',
+                          0x13, 0x00, 0x1E };
+
+    memset( &packetInfo, 0x0, sizeof( packetInfo ) );
+    memset( &properties, 0x0, sizeof( properties ) );
+    packetInfo.type = MQTT_PACKET_TYPE_CONNACK;
+    packetInfo.pRemainingData = connack;
+    packetInfo.remainingLength = sizeof( connack );
+
+    status = MQTT_DeserializeAckV5( &packetInfo, NULL, &sessionPresent, &properties );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_FALSE( sessionPresent );
+    TEST_ASSERT_EQUAL_UINT16( 10U, properties.topicAliasMaximum );
+    TEST_ASSERT_TRUE( properties.serverKeepAlivePresent );
+    TEST_ASSERT_EQUAL_UINT16( 30U, properties.serverKeepAlive );
+
+    /* The properties are optional output. */
+    status = MQTT_DeserializeAckV5( &packetInfo, NULL, &sessionPresent, NULL );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+
+    /* Session present. */
+    connack[ 0 ] = 0x01;
+    status = MQTT_DeserializeAckV5( &packetInfo, NULL, &sessionPresent, NULL );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_TRUE( sessionPresent );
+
+    /* Session present with a failure is a protocol error. */
+    connack[ 1 ] = 0x87;
+    status = MQTT_DeserializeAckV5( &packetInfo, NULL, &sessionPresent, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadResponse, status );
+
+    /* Not authorized. */
+    connack[ 0 ] = 0x00;
+    status = MQTT_DeserializeAckV5( &packetInfo, NULL, &sessionPresent, NULL );
+    TEST_ASSERT_EQUAL( MQTTServerRefused, status );
+
+    /* Reason codes below 0x80 other than success are not valid in a CONNACK. */
+    connack[ 1 ] = 0x01;
+    status = MQTT_DeserializeAckV5( &packetInfo, NULL, &sessionPresent, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadResponse, status );
+    connack[ 1 ] = 0x00;
+
+    /* Reserved bits. */
+    connack[ 0 ] = 0x02;
+    status = MQTT_DeserializeAckV5( &packetInfo, NULL, &sessionPresent, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadResponse, status );
+    connack[ 0 ] = 0x00;
+
+    /* Unknown property. */
+    connack[ 3 ] = 0x7F;
+    status = MQTT_DeserializeAckV5( &packetInfo, NULL, &sessionPresent, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadResponse, status );
+    connack[ 3 ] = 0x22;
+
+    /* Property length beyond the packet, and data after the properties. */
+    packetInfo.remainingLength = sizeof( connack ) - 1U;
+    status = MQTT_DeserializeAckV5( &packetInfo, NULL, &sessionPresent, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadResponse, status );
+    packetInfo.remainingLength = sizeof( connack );
+    connack[ 2 ] = 10U;
+    status = MQTT_DeserializeAckV5( &packetInfo, NULL, &sessionPresent, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadResponse, status );
+
+    /* A property cut by the property length. */
+    connack[ 2 ] = 12U;
+    packetInfo.remainingLength = sizeof( connack ) - 1U;
+    status = MQTT_DeserializeAckV5( &packetInfo, NULL, &sessionPresent, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadResponse, status );
+
+    /* The property length is a variable byte integer. */
+    connack[ 2 ] = 0x80;
+    packetInfo.remainingLength = 3U;
+    status = MQTT_DeserializeAckV5( &packetInfo, NULL, &sessionPresent, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadResponse, status );
+
+    /* Too short for the property length. */
+    packetInfo.remainingLength = 2U;
+    status = MQTT_DeserializeAckV5( &packetInfo, NULL, &sessionPresent, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadResponse, status );
+
+    /* Invalid parameters. */
+    status = MQTT_DeserializeAckV5( NULL, NULL, &sessionPresent, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+    status = MQTT_DeserializeAckV5( &packetInfo, NULL, NULL, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+}
+
+/**
+ * @brief Test the deserialization of MQTT 5 publish acks.
+ */
+void test_MQTT_DeserializeAckV5_PublishAcks( void )
+{
+    MQTTPacketInfo_t packetInfo;
+    uint16_t packetId = 0U;
+    MQTTStatus_t status;
+    uint8_t puback[] = { 0x00, 0x01, 0x10, 0x03, 0x1F, 0x00, 0x00 };
+
+    memset( &packetInfo, 0x0, sizeof( packetInfo ) );
+    packetInfo.type = MQTT_PACKET_TYPE_PUBACK;
+    packetInfo.pRemainingData = puback;
+
+    /* The reason code and properties may be omitted. */
+    packetInfo.remainingLength = 2U;
+    status = MQTT_DeserializeAckV5( &packetInfo, &packetId, NULL, NULL );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL_UINT16( 1U, packetId );
+
+    /* The No matching subscribers reason code completes the publish. */
+    packetInfo.remainingLength = 3U;
+    status = MQTT_DeserializeAckV5( &packetInfo, &packetId, NULL, NULL );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+
+    /* A Reason String property. */
+    packetInfo.remainingLength = sizeof( puback );
+    status = MQTT_DeserializeAckV5( &packetInfo, &packetId, NULL, NULL );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+
+    /* Not authorized. */
+    puback[ 2 ] = 0x87;
+    status = MQTT_DeserializeAckV5( &packetInfo, &packetId, NULL, NULL );
+    TEST_ASSERT_EQUAL( MQTTServerRefused, status );
+    TEST_ASSERT_EQUAL_UINT16( 1U, packetId );
+
+    /* Unspecified error. */
+    puback[ 2 ] = 0x80;
+    packetInfo.type = MQTT_PACKET_TYPE_PUBREC;
+    status = MQTT_DeserializeAckV5( &packetInfo, &packetId, NULL, NULL );
+    TEST_ASSERT_EQUAL( MQTTServerRefused, status );
+
+    packetInfo.type = MQTT_PACKET_TYPE_PUBCOMP;
+    status = MQTT_DeserializeAckV5( &packetInfo, &packetId, NULL, NULL );
+    TEST_ASSERT_EQUAL( MQTTServerRefused, status );
+
+    /* A PUBREL is answered whatever its reason code. */
+    packetInfo.type = MQTT_PACKET_TYPE_PUBREL;
+    status = MQTT_DeserializeAckV5( &packetInfo, &packetId, NULL, NULL );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+
+    /* Data after the properties. */
+    puback[ 3 ] = 0x00;
+    status = MQTT_DeserializeAckV5( &packetInfo, &packetId, NULL, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadResponse, status );
+
+    /* A packet identifier of zero. */
+    puback[ 1 ] = 0x00;
+    packetInfo.remainingLength = 2U;
+    status = MQTT_DeserializeAckV5( &packetInfo, &packetId, NULL, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadResponse, status );
+
+    packetInfo.remainingLength = 1U;
+    status = MQTT_DeserializeAckV5( &packetInfo, &packetId, NULL, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadResponse, status );
+
+    status = MQTT_DeserializeAckV5( &packetInfo, NULL, NULL, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+
+    /* PINGRESP is the same as in MQTT 3.1.1. */
+    packetInfo.type = MQTT_PACKET_TYPE_PINGRESP;
+    packetInfo.remainingLength = 0U;
+    status = MQTT_DeserializeAckV5( &packetInfo, NULL, NULL, NULL );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+
+    packetInfo.type = MQTT_PACKET_TYPE_PUBLISH;
+    status = MQTT_DeserializeAckV5( &packetInfo, &packetId, NULL, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadResponse, status );
+}
+
+/**
+ * @brief Test the deserialization of MQTT 5 DISCONNECT and AUTH packets.
+ */
+void test_MQTT_DeserializeAckV5_Disconnect( void )
+{
+    MQTTPacketInfo_t packetInfo;
+    uint16_t packetId = 0U;
+    MQTTStatus_t status;
+    uint8_t reasonCode = 0xFFU;
+    /* Server shutting down, with a Reason String property. */
+    uint8_t disconnect[] = { 0x8B, 0x05, 0x1F, 0x00, 0x02, 'b', 'y', 0x00 };
+
+    memset( &packetInfo, 0x0, sizeof( packetInfo ) );
+    packetInfo.type = MQTT_PACKET_TYPE_DISCONNECT;
+    packetInfo.pRemainingData = disconnect;
+    packetInfo.remainingLength = sizeof( disconnect ) - 1U;
+
+    status = MQTT_DeserializeAckV5( &packetInfo, NULL, NULL, NULL );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    status = MQTT_GetReasonCodeV5( &packetInfo, &reasonCode );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL_HEX8( 0x8BU, reasonCode );
+
+    /* Data after the properties. */
+    packetInfo.remainingLength = sizeof( disconnect );
+    status = MQTT_DeserializeAckV5( &packetInfo, NULL, NULL, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadResponse, status );
+
+    /* Properties longer than the packet. */
+    packetInfo.remainingLength = 4U;
+    status = MQTT_DeserializeAckV5( &packetInfo, NULL, NULL, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadResponse, status );
+
+    /* A reason code without properties. */
+    packetInfo.type = MQTT_PACKET_TYPE_AUTH;
+    packetInfo.remainingLength = 1U;
+    status = MQTT_DeserializeAckV5( &packetInfo, NULL, NULL, NULL );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+
+    /* No reason code is a normal disconnection. */
+    packetInfo.type = MQTT_PACKET_TYPE_DISCONNECT;
+    packetInfo.pRemainingData = NULL;
+    packetInfo.remainingLength = 0U;
+    status = MQTT_DeserializeAckV5( &packetInfo, NULL, NULL, NULL );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    status = MQTT_GetReasonCodeV5( &packetInfo, &reasonCode );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL_HEX8( 0x00U, reasonCode );
+
+    /* Reserved flags. */
+    packetInfo.type = MQTT_PACKET_TYPE_DISCONNECT | 0x01U;
+    status = MQTT_DeserializeAckV5( &packetInfo, &packetId, NULL, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadResponse, status );
+}
+
+/**
+ * @brief Test getting the reason code of MQTT 5 publish acks.
+ */
+void test_MQTT_GetReasonCodeV5( void )
+{
+    MQTTPacketInfo_t packetInfo;
+    uint8_t reasonCode = 0xFFU;
+    MQTTStatus_t status;
+    uint8_t pubrec[] = { 0x00, 0x01, 0x80, 0x00 };
+
+    memset( &packetInfo, 0x0, sizeof( packetInfo ) );
+    packetInfo.type = MQTT_PACKET_TYPE_PUBREC;
+    packetInfo.pRemainingData = pubrec;
+    packetInfo.remainingLength = sizeof( pubrec );
+
+    status = MQTT_GetReasonCodeV5( &packetInfo, &reasonCode );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL_HEX8( 0x80U, reasonCode );
+
+    packetInfo.type = MQTT_PACKET_TYPE_PUBACK;
+    pubrec[ 2 ] = 0x87;
+    packetInfo.remainingLength = 3U;
+    status = MQTT_GetReasonCodeV5( &packetInfo, &reasonCode );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL_HEX8( 0x87U, reasonCode );
+
+    /* An omitted reason code is a success. */
+    packetInfo.remainingLength = 2U;
+    status = MQTT_GetReasonCodeV5( &packetInfo, &reasonCode );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL_HEX8( 0x00U, reasonCode );
+
+    packetInfo.type = MQTT_PACKET_TYPE_SUBACK;
+    status = MQTT_GetReasonCodeV5( &packetInfo, &reasonCode );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+
+    packetInfo.type = MQTT_PACKET_TYPE_PUBCOMP;
+    packetInfo.pRemainingData = NULL;
+    packetInfo.remainingLength = 3U;
+    status = MQTT_GetReasonCodeV5( &packetInfo, &reasonCode );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+
+    status = MQTT_GetReasonCodeV5( NULL, &reasonCode );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+
+    status = MQTT_GetReasonCodeV5( &packetInfo, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+}
+
+/**
+ * @brief Test the deserialization of MQTT 5 SUBACK and UNSUBACK packets.
+ */
+void test_MQTT_DeserializeAckV5_SubscriptionAcks( void )
+{
+    MQTTPacketInfo_t packetInfo;
+    uint16_t packetId = 0U;
+    MQTTStatus_t status;
+    uint8_t suback[] = { 0x00, 0x02, 0x00, 0x00, 0x01, 0x02 };
+
+    memset( &packetInfo, 0x0, sizeof( packetInfo ) );
+    packetInfo.type = MQTT_PACKET_TYPE_SUBACK;
+    packetInfo.pRemainingData = suback;
+    packetInfo.remainingLength = sizeof( suback );
+
+    status = MQTT_DeserializeAckV5( &packetInfo, &packetId, NULL, NULL );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL_UINT16( 2U, packetId );
+
+    /* Not authorized. */
+    suback[ 4 ] = 0x87;
+    status = MQTT_DeserializeAckV5( &packetInfo, &packetId, NULL, NULL );
+    TEST_ASSERT_EQUAL( MQTTServerRefused, status );
+
+    /* A reason code of UNSUBACK in a SUBACK. */
+    suback[ 4 ] = 0x11;
+    status = MQTT_DeserializeAckV5( &packetInfo, &packetId, NULL, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadResponse, status );
+
+    /* No subscription existed is a success for UNSUBACK. */
+    packetInfo.type = MQTT_PACKET_TYPE_UNSUBACK;
+    suback[ 3 ] = 0x11;
+    packetInfo.remainingLength = 4U;
+    status = MQTT_DeserializeAckV5( &packetInfo, &packetId, NULL, NULL );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+
+    suback[ 3 ] = 0x01;
+    status = MQTT_DeserializeAckV5( &packetInfo, &packetId, NULL, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadResponse, status );
+
+    /* No reason codes after the properties. */
+    suback[ 2 ] = 0x01;
+    status = MQTT_DeserializeAckV5( &packetInfo, &packetId, NULL, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadResponse, status );
+
+    packetInfo.remainingLength = 3U;
+    status = MQTT_DeserializeAckV5( &packetInfo, &packetId, NULL, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadResponse, status );
+
+    suback[ 1 ] = 0x00;
+    packetInfo.remainingLength = 4U;
+    status = MQTT_DeserializeAckV5( &packetInfo, &packetId, NULL, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadResponse, status );
+}
+
+/**
+ * @brief Test getting the reason codes of MQTT 5 SUBACK and UNSUBACK packets.
+ */
+void test_MQTT_GetSubAckReasonCodesV5( void )
+{
+    MQTTPacketInfo_t packetInfo;
+    uint8_t * pReasonCodes = NULL;
+    size_t reasonCodeCount = 0U;
+    MQTTStatus_t status;
+    /* A Reason String property before two reason codes. */
+    uint8_t suback[] = { 0x00, 0x02, 0x04, 0x1F, 0x00, 0x01, 'x', 0x01, 0x87 };
+
+    memset( &packetInfo, 0x0, sizeof( packetInfo ) );
+    packetInfo.type = MQTT_PACKET_TYPE_SUBACK;
+    packetInfo.pRemainingData = suback;
+    packetInfo.remainingLength = sizeof( suback );
+
+    status = MQTT_GetSubAckReasonCodesV5( &packetInfo, &pReasonCodes, &reasonCodeCount );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL_PTR( &suback[ 7 ], pReasonCodes );
+    TEST_ASSERT_EQUAL( 2U, reasonCodeCount );
+
+    packetInfo.type = MQTT_PACKET_TYPE_UNSUBACK;
+    status = MQTT_GetSubAckReasonCodesV5( &packetInfo, &pReasonCodes, &reasonCodeCount );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+
+    /* The properties are longer than the packet. */
+    packetInfo.remainingLength = 5U;
+    status = MQTT_GetSubAckReasonCodesV5( &packetInfo, &pReasonCodes, &reasonCodeCount );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+
+    /* A truncated property length. */
+    suback[ 2 ] = 0x80;
+    packetInfo.remainingLength = 3U;
+    status = MQTT_GetSubAckReasonCodesV5( &packetInfo, &pReasonCodes, &reasonCodeCount );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+
+    packetInfo.remainingLength = 2U;
+    status = MQTT_GetSubAckReasonCodesV5( &packetInfo, &pReasonCodes, &reasonCodeCount );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+
+    packetInfo.type = MQTT_PACKET_TYPE_PUBACK;
+    packetInfo.remainingLength = sizeof( suback );
+    status = MQTT_GetSubAckReasonCodesV5( &packetInfo, &pReasonCodes, &reasonCodeCount );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+
+    status = MQTT_GetSubAckReasonCodesV5( NULL, &pReasonCodes, &reasonCodeCount );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+    status = MQTT_GetSubAckReasonCodesV5( &packetInfo, NULL, &reasonCodeCount );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+    status = MQTT_GetSubAckReasonCodesV5( &packetInfo, &pReasonCodes, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+}
+
+/**
+ * @brief Test the deserialization of MQTT 5 PUBLISH packets.
+ */
+void test_MQTT_DeserializePublishV5( void )
+{
+    MQTTPacketInfo_t packetInfo;
+    MQTTPublishInfo_t publishInfo;
+    uint16_t packetId = 0U;
+    MQTTStatus_t status;
+
+    /* Topic "a/b", packet ID 5, a Message Expiry Interval and payload "hi". */
+    uint8_t publish[] = { 0x00, 0x03, 'a', '/', 'b', 0x00, 0x05,
+                          0x05, 0x02, 0x00, 0x00, 0x00, 0x3C,
+                          'h', 'i' };
+
+    memset( &packetInfo, 0x0, sizeof( packetInfo ) );
+    packetInfo.type = MQTT_PACKET_TYPE_PUBLISH | 0x02U;
+    packetInfo.pRemainingData = publish;
+    packetInfo.remainingLength = sizeof( publish );
+
+    status = MQTT_DeserializePublishV5( &packetInfo, &packetId, &publishInfo, NULL, NULL );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( MQTTQoS1, publishInfo.qos );
+    TEST_ASSERT_EQUAL_UINT16( 5U, packetId );
+    TEST_ASSERT_EQUAL_UINT16( 3U, publishInfo.topicNameLength );
+    TEST_ASSERT_EQUAL( 2U, publishInfo.payloadLength );
+    TEST_ASSERT_EQUAL_MEMORY( "hi", publishInfo.pPayload, 2U );
+
+    /* No payload after the properties. */
+    packetInfo.remainingLength = sizeof( publish ) - 2U;
+    status = MQTT_DeserializePublishV5( &packetInfo, &packetId, &publishInfo, NULL, NULL );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( 0U, publishInfo.payloadLength );
+    TEST_ASSERT_NULL( publishInfo.pPayload );
+
+    /* No property length. */
+    packetInfo.remainingLength = 7U;
+    status = MQTT_DeserializePublishV5( &packetInfo, &packetId, &publishInfo, NULL, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadResponse, status );
+
+    /* Topic aliases from the broker are not accepted. */
+    publish[ 7 ] = 0x03;
+    publish[ 8 ] = 0x23;
+    publish[ 9 ] = 0x00;
+    publish[ 10 ] = 0x01;
+    packetInfo.remainingLength = 11U;
+    status = MQTT_DeserializePublishV5( &packetInfo, &packetId, &publishInfo, NULL, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadResponse, status );
+
+    status = MQTT_DeserializePublishV5( NULL, &packetId, &publishInfo, NULL, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+}
+
+/**
+ * @brief Test the Subscription Identifiers of MQTT 5 PUBLISH packets.
+ */
+void test_MQTT_DeserializePublishV5_SubscriptionIds( void )
+{
+    MQTTPacketInfo_t packetInfo;
+    MQTTPublishInfo_t publishInfo;
+    uint16_t packetId = 0U;
+    uint32_t subscriptionIds[ 2 ];
+    size_t subscriptionIdCount;
+    MQTTStatus_t status;
+
+    /* QoS 0 topic "a/b" with Subscription Identifiers 1, 200 and 3, and
+     * payload "hi". */
+    uint8_t publish[] = { 0x00, 0x03, 'a', '/', 'b',
+                          0x07, 0x0B, 0x01, 0x0B, 0xC8, 0x01, 0x0B, 0x03,
+                          'h', 'i' };
+
+    memset( &packetInfo, 0x0, sizeof( packetInfo ) );
+    packetInfo.type = MQTT_PACKET_TYPE_PUBLISH;
+    packetInfo.pRemainingData = publish;
+    packetInfo.remainingLength = sizeof( publish );
+
+    /* Identifiers beyond the capacity are dropped. */
+    subscriptionIdCount = 2U;
+    status = MQTT_DeserializePublishV5( &packetInfo, &packetId, &publishInfo,
+                                        subscriptionIds, &subscriptionIdCount );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( 2U, subscriptionIdCount );
+    TEST_ASSERT_EQUAL_UINT32( 1U, subscriptionIds[ 0 ] );
+    TEST_ASSERT_EQUAL_UINT32( 200U, subscriptionIds[ 1 ] );
+    TEST_ASSERT_EQUAL( 2U, publishInfo.payloadLength );
+    TEST_ASSERT_EQUAL_MEMORY( "hi", publishInfo.pPayload, 2U );
+
+    /* Only the count is returned without an array. */
+    subscriptionIdCount = 2U;
+    status = MQTT_DeserializePublishV5( &packetInfo, &packetId, &publishInfo,
+                                        NULL, &subscriptionIdCount );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( 0U, subscriptionIdCount );
+
+    status = MQTT_DeserializePublishV5( &packetInfo, &packetId, &publishInfo,
+                                        subscriptionIds, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+
+    /* A Subscription Identifier of 0 is a protocol error. */
+    publish[ 7 ] = 0x00;
+    subscriptionIdCount = 2U;
+    status = MQTT_DeserializePublishV5( &packetInfo, &packetId, &publishInfo,
+                                        subscriptionIds, &subscriptionIdCount );
+    TEST_ASSERT_EQUAL( MQTTBadResponse, status );
+}
+
+/* ======================  Testing the server-role codec ===================== */
+
+/**
+ * @brief Frame a serialized client packet as a server would, and point the
+ * packet info at its remaining data.
+ */
+static MQTTStatus_t processServerPacket( uint8_t * pBuffer,
+                                         size_t length,
+                                         MQTTPacketInfo_t * pPacketInfo )
+{
+    MQTTStatus_t status;
+
+    memset( pPacketInfo, 0x0, sizeof( *pPacketInfo ) );
+    status = MQTT_ProcessIncomingServerPacketTypeAndLength( pBuffer, &length, pPacketInfo );
+
+    if( status == MQTTSuccess )
+    {
+        TEST_ASSERT_EQUAL( length, pPacketInfo->headerLength + pPacketInfo->remainingLength );
+        pPacketInfo->pRemainingData = &pBuffer[ pPacketInfo->headerLength ];
+    }
+
+    return status;
+}
+
+/**
+ * @brief Test the framing of the packets a server receives.
+ */
+void test_MQTT_ProcessIncomingServerPacketTypeAndLength( void )
+{
+    MQTTPacketInfo_t packetInfo;
+    size_t index = 2U;
+    uint8_t buffer[ 5 ] = { MQTT_PACKET_TYPE_PINGREQ, 0x00 };
+
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_ProcessIncomingServerPacketTypeAndLength( NULL, &index, &packetInfo ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_ProcessIncomingServerPacketTypeAndLength( buffer, NULL, &packetInfo ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_ProcessIncomingServerPacketTypeAndLength( buffer, &index, NULL ) );
+
+    index = 0U;
+    TEST_ASSERT_EQUAL( MQTTNoDataAvailable, MQTT_ProcessIncomingServerPacketTypeAndLength( buffer, &index, &packetInfo ) );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, processServerPacket( buffer, 2U, &packetInfo ) );
+    TEST_ASSERT_EQUAL( MQTT_PACKET_TYPE_PINGREQ, packetInfo.type );
+
+    /* Packets only a server sends are rejected. */
+    buffer[ 0 ] = MQTT_PACKET_TYPE_CONNACK;
+    TEST_ASSERT_EQUAL( MQTTBadResponse, processServerPacket( buffer, 2U, &packetInfo ) );
+    buffer[ 0 ] = MQTT_PACKET_TYPE_PINGRESP;
+    TEST_ASSERT_EQUAL( MQTTBadResponse, processServerPacket( buffer, 2U, &packetInfo ) );
+
+    /* The reserved flags of SUBSCRIBE, UNSUBSCRIBE and PUBREL are checked. */
+    buffer[ 0 ] = MQTT_PACKET_TYPE_SUBSCRIBE & 0xF0U;
+    TEST_ASSERT_EQUAL( MQTTBadResponse, processServerPacket( buffer, 2U, &packetInfo ) );
+    buffer[ 0 ] = MQTT_PACKET_TYPE_UNSUBSCRIBE | 0x01U;
+    TEST_ASSERT_EQUAL( MQTTBadResponse, processServerPacket( buffer, 2U, &packetInfo ) );
+    buffer[ 0 ] = MQTT_PACKET_TYPE_PUBREL & 0xF0U;
+    TEST_ASSERT_EQUAL( MQTTBadResponse, processServerPacket( buffer, 2U, &packetInfo ) );
+
+    /* So are the reserved flags of the packets whose flags are all zero. */
+    buffer[ 0 ] = MQTT_PACKET_TYPE_CONNECT | 0x01U;
+    TEST_ASSERT_EQUAL( MQTTBadResponse, processServerPacket( buffer, 2U, &packetInfo ) );
+    buffer[ 0 ] = MQTT_PACKET_TYPE_PINGREQ | 0x02U;
+    TEST_ASSERT_EQUAL( MQTTBadResponse, processServerPacket( buffer, 2U, &packetInfo ) );
+    buffer[ 0 ] = MQTT_PACKET_TYPE_PUBACK | 0x08U;
+    TEST_ASSERT_EQUAL( MQTTBadResponse, processServerPacket( buffer, 2U, &packetInfo ) );
+
+    /* A remaining length which is not complete yet. */
+    buffer[ 0 ] = MQTT_PACKET_TYPE_PUBLISH;
+    buffer[ 1 ] = 0x80U;
+    TEST_ASSERT_EQUAL( MQTTNeedMoreBytes, processServerPacket( buffer, 2U, &packetInfo ) );
+}
+
+/**
+ * @brief Test that a CONNECT serialized by the client is deserialized by the
+ * server, pointing into the packet, and that malformed ones are rejected.
+ */
+void test_MQTT_DeserializeConnect( void )
+{
+    MQTTConnectInfo_t connectInfo, receivedInfo;
+    MQTTPublishInfo_t willInfo, receivedWill;
+    MQTTFixedBuffer_t networkBuffer;
+    MQTTPacketInfo_t packetInfo;
+    size_t remainingLength = 0U, packetSize = 0U;
+    bool willPresent = false;
+
+    memset( &connectInfo, 0x0, sizeof( connectInfo ) );
+    memset( &willInfo, 0x0, sizeof( willInfo ) );
+    setupConnectInfo( &connectInfo );
+    setupPublishInfo( &willInfo );
+    connectInfo.keepAliveSeconds = 60U;
+    willInfo.qos = MQTTQoS1;
+    willInfo.retain = true;
+    setupNetworkBuffer( &networkBuffer );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_GetConnectPacketSize( &connectInfo, &willInfo, &remainingLength, &packetSize ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_SerializeConnect( &connectInfo, &willInfo, remainingLength, &networkBuffer ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, processServerPacket( mqttBuffer, packetSize, &packetInfo ) );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_DeserializeConnect( &packetInfo, &receivedInfo, &receivedWill, &willPresent ) );
+    TEST_ASSERT_TRUE( receivedInfo.cleanSession );
+    TEST_ASSERT_EQUAL_UINT16( 60U, receivedInfo.keepAliveSeconds );
+    TEST_ASSERT_EQUAL_UINT16( MQTT_CLIENT_IDENTIFIER_LEN, receivedInfo.clientIdentifierLength );
+    TEST_ASSERT_EQUAL_MEMORY( MQTT_CLIENT_IDENTIFIER, receivedInfo.pClientIdentifier, MQTT_CLIENT_IDENTIFIER_LEN );
+    TEST_ASSERT_EQUAL_UINT16( MQTT_TEST_USERNAME_LEN, receivedInfo.userNameLength );
+    TEST_ASSERT_EQUAL_MEMORY( MQTT_TEST_USERNAME, receivedInfo.pUserName, MQTT_TEST_USERNAME_LEN );
+    TEST_ASSERT_EQUAL_UINT16( MQTT_TEST_PASSWORD_LEN, receivedInfo.passwordLength );
+    TEST_ASSERT_EQUAL_MEMORY( MQTT_TEST_PASSWORD, receivedInfo.pPassword, MQTT_TEST_PASSWORD_LEN );
+    TEST_ASSERT_TRUE( willPresent );
+    TEST_ASSERT_EQUAL( MQTTQoS1, receivedWill.qos );
+    TEST_ASSERT_TRUE( receivedWill.retain );
+    TEST_ASSERT_EQUAL_UINT16( TEST_TOPIC_NAME_LENGTH, receivedWill.topicNameLength );
+    TEST_ASSERT_EQUAL_MEMORY( TEST_TOPIC_NAME, receivedWill.pTopicName, TEST_TOPIC_NAME_LENGTH );
+    TEST_ASSERT_EQUAL( MQTT_SAMPLE_PAYLOAD_LEN, receivedWill.payloadLength );
+    TEST_ASSERT_EQUAL_MEMORY( MQTT_SAMPLE_PAYLOAD, receivedWill.pPayload, MQTT_SAMPLE_PAYLOAD_LEN );
+
+    /* Nothing is copied. */
+    TEST_ASSERT_TRUE( ( ( const uint8_t * ) receivedInfo.pClientIdentifier > mqttBuffer ) &&
+                      ( ( const uint8_t * ) receivedInfo.pPassword < &mqttBuffer[ packetSize ] ) );
+
+    /* A CONNECT with only a client identifier. */
+    connectInfo.pUserName = NULL;
+    connectInfo.userNameLength = 0U;
+    connectInfo.pPassword = NULL;
+    connectInfo.passwordLength = 0U;
+    connectInfo.cleanSession = false;
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_GetConnectPacketSize( &connectInfo, NULL, &remainingLength, &packetSize ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_SerializeConnect( &connectInfo, NULL, remainingLength, &networkBuffer ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, processServerPacket( mqttBuffer, packetSize, &packetInfo ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_DeserializeConnect( &packetInfo, &receivedInfo, &receivedWill, &willPresent ) );
+    TEST_ASSERT_FALSE( receivedInfo.cleanSession );
+    TEST_ASSERT_FALSE( willPresent );
+    TEST_ASSERT_NULL( receivedInfo.pUserName );
+    TEST_ASSERT_NULL( receivedInfo.pPassword );
+
+    /* Trailing bytes, and a payload cut short. */
+    packetInfo.remainingLength++;
+    TEST_ASSERT_EQUAL( MQTTBadResponse, MQTT_DeserializeConnect( &packetInfo, &receivedInfo, &receivedWill, &willPresent ) );
+    packetInfo.remainingLength -= 2U;
+    TEST_ASSERT_EQUAL( MQTTBadResponse, MQTT_DeserializeConnect( &packetInfo, &receivedInfo, &receivedWill, &willPresent ) );
+    packetInfo.remainingLength = 9U;
+    TEST_ASSERT_EQUAL( MQTTBadResponse, MQTT_DeserializeConnect( &packetInfo, &receivedInfo, &receivedWill, &willPresent ) );
+    packetInfo.remainingLength = remainingLength;
+
+    /* Malformed flags: reserved bit, will QoS without a will, password
+     * without a user name. */
+    packetInfo.pRemainingData[ 7 ] = 0x01U;
+    TEST_ASSERT_EQUAL( MQTTBadResponse, MQTT_DeserializeConnect( &packetInfo, &receivedInfo, &receivedWill, &willPresent ) );
+    packetInfo.pRemainingData[ 7 ] = 0x08U;
+    TEST_ASSERT_EQUAL( MQTTBadResponse, MQTT_DeserializeConnect( &packetInfo, &receivedInfo, &receivedWill, &willPresent ) );
+    packetInfo.pRemainingData[ 7 ] = 0x1CU;
+    TEST_ASSERT_EQUAL( MQTTBadResponse, MQTT_DeserializeConnect( &packetInfo, &receivedInfo, &receivedWill, &willPresent ) );
+    packetInfo.pRemainingData[ 7 ] = 0x40U;
+    TEST_ASSERT_EQUAL( MQTTBadResponse, MQTT_DeserializeConnect( &packetInfo, &receivedInfo, &receivedWill, &willPresent ) );
+    packetInfo.pRemainingData[ 7 ] = 0x00U;
+
+    /* Another protocol level or name. */
+    packetInfo.pRemainingData[ 6 ] = MQTT_VERSION_5;
+    TEST_ASSERT_EQUAL( MQTTBadResponse, MQTT_DeserializeConnect( &packetInfo, &receivedInfo, &receivedWill, &willPresent ) );
+    packetInfo.pRemainingData[ 6 ] = MQTT_VERSION_3_1_1;
+    packetInfo.pRemainingData[ 5 ] = 'X';
+    TEST_ASSERT_EQUAL( MQTTBadResponse, MQTT_DeserializeConnect( &packetInfo, &receivedInfo, &receivedWill, &willPresent ) );
+
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_DeserializeConnect( NULL, &receivedInfo, &receivedWill, &willPresent ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_DeserializeConnect( &packetInfo, NULL, &receivedWill, &willPresent ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_DeserializeConnect( &packetInfo, &receivedInfo, NULL, &willPresent ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_DeserializeConnect( &packetInfo, &receivedInfo, &receivedWill, NULL ) );
+    packetInfo.type = MQTT_PACKET_TYPE_PUBLISH;
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_DeserializeConnect( &packetInfo, &receivedInfo, &receivedWill, &willPresent ) );
+    packetInfo.type = MQTT_PACKET_TYPE_CONNECT;
+    packetInfo.pRemainingData = NULL;
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_DeserializeConnect( &packetInfo, &receivedInfo, &receivedWill, &willPresent ) );
+}
+
+/**
+ * @brief Test that a SUBSCRIBE serialized by the client is deserialized by the
+ * server, and that malformed ones are rejected.
+ */
+void test_MQTT_DeserializeSubscribe( void )
+{
+    MQTTSubscribeInfo_t subscriptions[ 2 ], received[ 2 ];
+    MQTTFixedBuffer_t networkBuffer;
+    MQTTPacketInfo_t packetInfo;
+    size_t remainingLength = 0U, packetSize = 0U, count = 2U;
+    uint16_t packetId = 0U;
+
+    subscriptions[ 0 ].qos = MQTTQoS2;
+    subscriptions[ 0 ].pTopicFilter = "a/+/c";
+    subscriptions[ 0 ].topicFilterLength = 5U;
+    subscriptions[ 1 ].qos = MQTTQoS0;
+    subscriptions[ 1 ].pTopicFilter = TEST_TOPIC_NAME;
+    subscriptions[ 1 ].topicFilterLength = TEST_TOPIC_NAME_LENGTH;
+    setupNetworkBuffer( &networkBuffer );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_GetSubscribePacketSize( subscriptions, 2U, &remainingLength, &packetSize ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_SerializeSubscribe( subscriptions, 2U, 7U, remainingLength, &networkBuffer ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, processServerPacket( mqttBuffer, packetSize, &packetInfo ) );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_DeserializeSubscribe( &packetInfo, &packetId, received, &count ) );
+    TEST_ASSERT_EQUAL_UINT16( 7U, packetId );
+    TEST_ASSERT_EQUAL( 2U, count );
+    TEST_ASSERT_EQUAL( MQTTQoS2, received[ 0 ].qos );
+    TEST_ASSERT_EQUAL_UINT16( 5U, received[ 0 ].topicFilterLength );
+    TEST_ASSERT_EQUAL_MEMORY( "a/+/c", received[ 0 ].pTopicFilter, 5U );
+    TEST_ASSERT_EQUAL( MQTTQoS0, received[ 1 ].qos );
+    TEST_ASSERT_EQUAL_UINT16( TEST_TOPIC_NAME_LENGTH, received[ 1 ].topicFilterLength );
+    TEST_ASSERT_EQUAL_MEMORY( TEST_TOPIC_NAME, received[ 1 ].pTopicFilter, TEST_TOPIC_NAME_LENGTH );
+
+    /* More topic filters than the list holds. */
+    count = 1U;
+    TEST_ASSERT_EQUAL( MQTTNoMemory, MQTT_DeserializeSubscribe( &packetInfo, &packetId, received, &count ) );
+
+    /* The QoS of the last topic filter is missing. */
+    count = 2U;
+    packetInfo.remainingLength--;
+    TEST_ASSERT_EQUAL( MQTTBadResponse, MQTT_DeserializeSubscribe( &packetInfo, &packetId, received, &count ) );
+
+    /* A topic filter longer than the packet. */
+    packetInfo.remainingLength -= 2U;
+    TEST_ASSERT_EQUAL( MQTTBadResponse, MQTT_DeserializeSubscribe( &packetInfo, &packetId, received, &count ) );
+    packetInfo.remainingLength = remainingLength;
+
+    /* Reserved bits of the requested QoS. */
+    packetInfo.pRemainingData[ remainingLength - 1U ] = 0x04U;
+    TEST_ASSERT_EQUAL( MQTTBadResponse, MQTT_DeserializeSubscribe( &packetInfo, &packetId, received, &count ) );
+    packetInfo.pRemainingData[ remainingLength - 1U ] = 0x00U;
+
+    /* An empty topic filter, no topic filter, and a packet identifier of 0. */
+    packetInfo.pRemainingData[ 3 ] = 0x00U;
+    TEST_ASSERT_EQUAL( MQTTBadResponse, MQTT_DeserializeSubscribe( &packetInfo, &packetId, received, &count ) );
+    packetInfo.remainingLength = 2U;
+    TEST_ASSERT_EQUAL( MQTTBadResponse, MQTT_DeserializeSubscribe( &packetInfo, &packetId, received, &count ) );
+    packetInfo.remainingLength = remainingLength;
+    packetInfo.pRemainingData[ 0 ] = 0x00U;
+    packetInfo.pRemainingData[ 1 ] = 0x00U;
+    TEST_ASSERT_EQUAL( MQTTBadResponse, MQTT_DeserializeSubscribe( &packetInfo, &packetId, received, &count ) );
+
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_DeserializeSubscribe( NULL, &packetId, received, &count ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_DeserializeSubscribe( &packetInfo, NULL, received, &count ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_DeserializeSubscribe( &packetInfo, &packetId, NULL, &count ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_DeserializeSubscribe( &packetInfo, &packetId, received, NULL ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_DeserializeUnsubscribe( &packetInfo, &packetId, received, &count ) );
+    packetInfo.pRemainingData = NULL;
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_DeserializeSubscribe( &packetInfo, &packetId, received, &count ) );
+}
+
+/**
+ * @brief Test that an UNSUBSCRIBE serialized by the client is deserialized by
+ * the server.
+ */
+void test_MQTT_DeserializeUnsubscribe( void )
+{
+    MQTTSubscribeInfo_t subscriptions[ 2 ], received[ 2 ];
+    MQTTFixedBuffer_t networkBuffer;
+    MQTTPacketInfo_t packetInfo;
+    size_t remainingLength = 0U, packetSize = 0U, count = 2U;
+    uint16_t packetId = 0U;
+
+    subscriptions[ 0 ].qos = MQTTQoS1;
+    subscriptions[ 0 ].pTopicFilter = "a/#";
+    subscriptions[ 0 ].topicFilterLength = 3U;
+    subscriptions[ 1 ].qos = MQTTQoS1;
+    subscriptions[ 1 ].pTopicFilter = TEST_TOPIC_NAME;
+    subscriptions[ 1 ].topicFilterLength = TEST_TOPIC_NAME_LENGTH;
+    setupNetworkBuffer( &networkBuffer );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_GetUnsubscribePacketSize( subscriptions, 2U, &remainingLength, &packetSize ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_SerializeUnsubscribe( subscriptions, 2U, 9U, remainingLength, &networkBuffer ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, processServerPacket( mqttBuffer, packetSize, &packetInfo ) );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_DeserializeUnsubscribe( &packetInfo, &packetId, received, &count ) );
+    TEST_ASSERT_EQUAL_UINT16( 9U, packetId );
+    TEST_ASSERT_EQUAL( 2U, count );
+    TEST_ASSERT_EQUAL( MQTTQoS0, received[ 0 ].qos );
+    TEST_ASSERT_EQUAL_MEMORY( "a/#", received[ 0 ].pTopicFilter, 3U );
+    TEST_ASSERT_EQUAL_UINT16( TEST_TOPIC_NAME_LENGTH, received[ 1 ].topicFilterLength );
+    TEST_ASSERT_EQUAL_MEMORY( TEST_TOPIC_NAME, received[ 1 ].pTopicFilter, TEST_TOPIC_NAME_LENGTH );
+
+    /* A truncated topic filter. */
+    packetInfo.remainingLength--;
+    TEST_ASSERT_EQUAL( MQTTBadResponse, MQTT_DeserializeUnsubscribe( &packetInfo, &packetId, received, &count ) );
+
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_DeserializeUnsubscribe( NULL, &packetId, received, &count ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_DeserializeSubscribe( &packetInfo, &packetId, received, &count ) );
+    packetInfo.pRemainingData = NULL;
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_DeserializeUnsubscribe( &packetInfo, &packetId, received, &count ) );
+}
+
+/**
+ * @brief Test the deserialization of PINGREQ and DISCONNECT.
+ */
+void test_MQTT_DeserializePingreq_Disconnect( void )
+{
+    MQTTPacketInfo_t packetInfo;
+    uint8_t buffer[ 2 ] = { MQTT_PACKET_TYPE_PINGREQ, 0x00 };
+    MQTTFixedBuffer_t fixedBuffer = { buffer, sizeof( buffer ) };
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, processServerPacket( buffer, sizeof( buffer ), &packetInfo ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_DeserializePingreq( &packetInfo ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_DeserializeDisconnect( &packetInfo ) );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_SerializeDisconnect( &fixedBuffer ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, processServerPacket( buffer, sizeof( buffer ), &packetInfo ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_DeserializeDisconnect( &packetInfo ) );
+
+    packetInfo.remainingLength = 1U;
+    TEST_ASSERT_EQUAL( MQTTBadResponse, MQTT_DeserializeDisconnect( &packetInfo ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_DeserializePingreq( NULL ) );
+}
+
+/**
+ * @brief Test that the CONNACK, SUBACK and UNSUBACK serialized by the server
+ * are deserialized by the client.
+ */
+void test_MQTT_SerializeServerAcks( void )
+{
+    MQTTFixedBuffer_t networkBuffer;
+    MQTTPacketInfo_t packetInfo;
+    size_t remainingLength = 0U, packetSize = 0U, index;
+    uint16_t packetId = 0U;
+    bool sessionPresent = false;
+    const uint8_t returnCodes[ 3 ] = { 0x00U, 0x02U, 0x80U };
+    uint8_t badReturnCode = 0x03U;
+
+    setupNetworkBuffer( &networkBuffer );
+
+    /* CONNACK. */
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_SerializeConnack( &networkBuffer, true, 0U ) );
+    packetInfo.type = mqttBuffer[ 0 ];
+    packetInfo.remainingLength = mqttBuffer[ 1 ];
+    packetInfo.pRemainingData = &mqttBuffer[ 2 ];
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_DeserializeAck( &packetInfo, NULL, &sessionPresent ) );
+    TEST_ASSERT_TRUE( sessionPresent );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_SerializeConnack( &networkBuffer, false, 5U ) );
+    TEST_ASSERT_EQUAL( MQTTServerRefused, MQTT_DeserializeAck( &packetInfo, NULL, &sessionPresent ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_SerializeConnack( &networkBuffer, true, 5U ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_SerializeConnack( &networkBuffer, false, 6U ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_SerializeConnack( NULL, false, 0U ) );
+    networkBuffer.size = MQTT_CONNACK_PACKET_SIZE - 1U;
+    TEST_ASSERT_EQUAL( MQTTNoMemory, MQTT_SerializeConnack( &networkBuffer, false, 0U ) );
+
+    /* SUBACK. */
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_GetSubackPacketSize( 3U, &remainingLength, &packetSize ) );
+    TEST_ASSERT_EQUAL( 5U, remainingLength );
+    TEST_ASSERT_EQUAL( 7U, packetSize );
+    networkBuffer.size = packetSize - 1U;
+    TEST_ASSERT_EQUAL( MQTTNoMemory, MQTT_SerializeSuback( returnCodes, 3U, 7U, remainingLength, &networkBuffer ) );
+    networkBuffer.size = packetSize;
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_SerializeSuback( returnCodes, 3U, 7U, remainingLength, &networkBuffer ) );
+    packetInfo.type = mqttBuffer[ 0 ];
+    packetInfo.remainingLength = mqttBuffer[ 1 ];
+    packetInfo.pRemainingData = &mqttBuffer[ 2 ];
+    TEST_ASSERT_EQUAL( MQTTServerRefused, MQTT_DeserializeAck( &packetInfo, &packetId, NULL ) );
+    TEST_ASSERT_EQUAL_UINT16( 7U, packetId );
+    TEST_ASSERT_EQUAL_MEMORY( returnCodes, &mqttBuffer[ 4 ], 3U );
+
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_SerializeSuback( &badReturnCode, 1U, 7U, 3U, &networkBuffer ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_SerializeSuback( returnCodes, 3U, 0U, remainingLength, &networkBuffer ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_SerializeSuback( returnCodes, 2U, 7U, remainingLength, &networkBuffer ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_SerializeSuback( NULL, 3U, 7U, remainingLength, &networkBuffer ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_GetSubackPacketSize( 0U, &remainingLength, &packetSize ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_GetSubackPacketSize( 1U, NULL, &packetSize ) );
+
+    /* A SUBACK whose remaining length takes two bytes. */
+    for( index = 0U; index < 200U; index++ )
+    {
+        encodedStringBuffer[ index ] = ( uint8_t ) ( index % 3U );
+    }
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_GetSubackPacketSize( 200U, &remainingLength, &packetSize ) );
+    TEST_ASSERT_EQUAL( 205U, packetSize );
+    setupNetworkBuffer( &networkBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_SerializeSuback( encodedStringBuffer, 200U, 1U, remainingLength, &networkBuffer ) );
+    TEST_ASSERT_EQUAL_HEX8( 0xCAU, mqttBuffer[ 1 ] );
+    TEST_ASSERT_EQUAL_HEX8( 0x01U, mqttBuffer[ 2 ] );
+
+    /* UNSUBACK. */
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_SerializeUnsuback( &networkBuffer, 9U ) );
+    packetInfo.type = mqttBuffer[ 0 ];
+    packetInfo.remainingLength = mqttBuffer[ 1 ];
+    packetInfo.pRemainingData = &mqttBuffer[ 2 ];
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_DeserializeAck( &packetInfo, &packetId, NULL ) );
+    TEST_ASSERT_EQUAL( MQTT_PACKET_TYPE_UNSUBACK, packetInfo.type );
+    TEST_ASSERT_EQUAL_UINT16( 9U, packetId );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_SerializeUnsuback( &networkBuffer, 0U ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_SerializeUnsuback( NULL, 9U ) );
+    networkBuffer.size = MQTT_UNSUBACK_PACKET_SIZE - 1U;
+    TEST_ASSERT_EQUAL( MQTTNoMemory, MQTT_SerializeUnsuback( &networkBuffer, 9U ) );
+
+    /* PINGRESP. */
+    networkBuffer.size = MQTT_PINGRESP_PACKET_SIZE;
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_SerializePingresp( &networkBuffer ) );
+    packetInfo.type = mqttBuffer[ 0 ];
+    packetInfo.remainingLength = mqttBuffer[ 1 ];
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_DeserializeAck( &packetInfo, NULL, NULL ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_SerializePingresp( NULL ) );
+    networkBuffer.size = MQTT_PINGRESP_PACKET_SIZE - 1U;
+    TEST_ASSERT_EQUAL( MQTTNoMemory, MQTT_SerializePingresp( &networkBuffer ) );
+}
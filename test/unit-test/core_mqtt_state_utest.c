@@ -163,7 +163,7 @@ void test_MQTT_ReserveState( void )
     const uint16_t PACKET_ID2 = 2;
     const uint16_t PACKET_ID3 = 3;
     const size_t index = MQTT_STATE_ARRAY_MAX_COUNT / 2;
-    TransportInterface_t transport;
+    TransportInterface_t transport = { 0 };
     MQTTFixedBuffer_t networkBuffer = { 0 };
 
     transport.recv = transportRecvSuccess;
@@ -370,7 +370,7 @@ void test_MQTT_ReserveState_compactRecords( void )
     const uint16_t PACKET_ID = 1;
     const uint16_t PACKET_ID2 = 2;
 
-    TransportInterface_t transport;
+    TransportInterface_t transport = { 0 };
     MQTTFixedBuffer_t networkBuffer = { 0 };
 
     transport.recv = transportRecvSuccess;
@@ -546,7 +546,7 @@ void test_MQTT_UpdateStatePublish( void )
     MQTTPublishState_t state;
     MQTTStatus_t status;
 
-    TransportInterface_t transport;
+    TransportInterface_t transport = { 0 };
     MQTTFixedBuffer_t networkBuffer = { 0 };
 
     transport.recv = transportRecvSuccess;
@@ -756,7 +756,7 @@ void test_MQTT_UpdateStateAck( void )
     MQTTStatus_t status;
 
     const uint16_t PACKET_ID = 1;
-    TransportInterface_t transport;
+    TransportInterface_t transport = { 0 };
     MQTTFixedBuffer_t networkBuffer = { 0 };
 
     transport.recv = transportRecvSuccess;
@@ -953,7 +953,7 @@ void test_MQTT_AckToResend( void )
     MQTTPubAckInfo_t incomingRecords[ MQTT_STATE_ARRAY_MAX_COUNT ] = { 0 };
     MQTTPubAckInfo_t outgoingRecords[ MQTT_STATE_ARRAY_MAX_COUNT ] = { 0 };
     MQTTStatus_t status;
-    TransportInterface_t transport;
+    TransportInterface_t transport = { 0 };
     MQTTFixedBuffer_t networkBuffer = { 0 };
 
     transport.recv = transportRecvSuccess;
@@ -946,6 +946,121 @@ static int32_t transportWritevPartialByte( NetworkContext_t * pNetworkContext,
     return bytesToWrite;
 }
 
+/**
+ * @brief Memory lent by #transportGetTxBuffer, and the record of its use.
+ */
+static uint8_t txBufferMemory[ MQTT_TEST_BUFFER_LENGTH ];
+static bool txBufferAvailable = true;
+static int32_t txBufferCommitResult = 0;
+static size_t txBufferGetCount = 0U;
+static size_t txBufferCommitCount = 0U;
+static size_t txBufferCommittedBytes = 0U;
+
+/**
+ * @brief Mocked transport function lending #txBufferMemory.
+ */
+static void * transportGetTxBuffer( NetworkContext_t * pNetworkContext,
+                                    size_t bytesToWrite )
+{
+    void * pBuffer = NULL;
+
+    TEST_ASSERT_EQUAL_PTR( MQTT_SAMPLE_NETWORK_CONTEXT, pNetworkContext );
+
+    txBufferGetCount++;
+
+    if( ( txBufferAvailable == true ) && ( bytesToWrite <= sizeof( txBufferMemory ) ) )
+    {
+        pBuffer = txBufferMemory;
+    }
+
+    return pBuffer;
+}
+
+/**
+ * @brief Mocked transport function committing #txBufferMemory. It returns
+ * #txBufferCommitResult when it is not zero.
+ */
+static int32_t transportCommitTxBuffer( NetworkContext_t * pNetworkContext,
+                                        void * pBuffer,
+                                        size_t bytesToSend )
+{
+    TEST_ASSERT_EQUAL_PTR( MQTT_SAMPLE_NETWORK_CONTEXT, pNetworkContext );
+    TEST_ASSERT_EQUAL_PTR( txBufferMemory, pBuffer );
+
+    txBufferCommitCount++;
+    txBufferCommittedBytes = bytesToSend;
+
+    return ( txBufferCommitResult != 0 ) ? txBufferCommitResult : ( int32_t ) bytesToSend;
+}
+
+/**
+ * @brief Record of the calls of #transportWait, and the value it returns.
+ */
+static size_t waitCount = 0U;
+static TransportWaitEvent_t waitEvent = TRANSPORT_WAIT_READABLE;
+static uint32_t waitTimeoutMs = 0U;
+static int32_t waitResult = 1;
+
+/**
+ * @brief Number of calls of #transportSendNoBytesOnce.
+ */
+static size_t sendNoBytesOnceCount = 0U;
+
+/**
+ * @brief Mocked transport wait, which returns #waitResult at once.
+ */
+static int32_t transportWait( NetworkContext_t * pNetworkContext,
+                              TransportWaitEvent_t event,
+                              uint32_t timeoutMs )
+{
+    TEST_ASSERT_EQUAL_PTR( MQTT_SAMPLE_NETWORK_CONTEXT, pNetworkContext );
+
+    waitCount++;
+    waitEvent = event;
+    waitTimeoutMs = timeoutMs;
+
+    return waitResult;
+}
+
+/**
+ * @brief Mocked transport send which sends nothing on its first call, and
+ * everything afterwards.
+ */
+static int32_t transportSendNoBytesOnce( NetworkContext_t * pNetworkContext,
+                                         const void * pBuffer,
+                                         size_t bytesToWrite )
+{
+    ( void ) pNetworkContext;
+    ( void ) pBuffer;
+
+    sendNoBytesOnceCount++;
+
+    return ( sendNoBytesOnceCount == 1U ) ? 0 : ( int32_t ) bytesToWrite;
+}
+
+/**
+ * @brief Mocked transport writev which sends nothing on its first call, and
+ * everything afterwards.
+ */
+static int32_t transportWritevNoBytesOnce( NetworkContext_t * pNetworkContext,
+                                           TransportOutVector_t * pIoVectorIterator,
+                                           size_t vectorsToBeSent )
+{
+    int32_t bytesToWrite = 0;
+    size_t i;
+
+    ( void ) pNetworkContext;
+
+    for( i = 0; i < vectorsToBeSent; ++i )
+    {
+        bytesToWrite += pIoVectorIterator[ i ].iov_len;
+    }
+
+    sendNoBytesOnceCount++;
+
+    return ( sendNoBytesOnceCount == 1U ) ? 0 : bytesToWrite;
+}
+
 /**
  * @brief Mocked successful transport read.
  *
@@ -1036,6 +1151,46 @@ static void setupTransportInterface( TransportInterface_t * pTransport )
     pTransport->writev = transportWritevSuccess;
 }
 
+/**
+ * @brief Initialize pTransport to lend TX buffers, and to fail any send or
+ * writev call.
+ *
+ * @param[in] pTransport Pointer to transport interface.
+ */
+static void setupTxBufferTransportInterface( TransportInterface_t * pTransport )
+{
+    setupTransportInterface( pTransport );
+    pTransport->send = transportSendFailure;
+    pTransport->writev = transportWritevFail;
+    pTransport->getTxBuffer = transportGetTxBuffer;
+    pTransport->commitTxBuffer = transportCommitTxBuffer;
+
+    memset( txBufferMemory, 0x0, sizeof( txBufferMemory ) );
+    txBufferAvailable = true;
+    txBufferCommitResult = 0;
+    txBufferGetCount = 0U;
+    txBufferCommitCount = 0U;
+    txBufferCommittedBytes = 0U;
+}
+
+/**
+ * @brief Initialize pTransport with #transportWait, and reset the record of
+ * its calls.
+ *
+ * @param[in] pTransport Pointer to transport interface.
+ */
+static void setupWaitTransportInterface( TransportInterface_t * pTransport )
+{
+    setupTransportInterface( pTransport );
+    pTransport->wait = transportWait;
+
+    waitCount = 0U;
+    waitEvent = TRANSPORT_WAIT_READABLE;
+    waitTimeoutMs = 0U;
+    waitResult = 1;
+    sendNoBytesOnceCount = 0U;
+}
+
 /**
  * @brief Initialize pSubscribeInfo using test-defined macros.
  *
@@ -1342,6 +1497,17 @@ void test_MQTT_Init_Invalid_Params( void )
     transport.send = NULL;
     mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
     TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    /* The TX buffer functions of the transport must be set together. */
+    transport.send = transportSendSuccess;
+    transport.getTxBuffer = transportGetTxBuffer;
+    mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    transport.getTxBuffer = NULL;
+    transport.commitTxBuffer = transportCommitTxBuffer;
+    mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
 }
 
 /* ========================================================================== */
@@ -2981,6 +3147,37 @@ void test_MQTT_Publish( void )
     TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
 }
 
+/**
+ * @brief Test that MQTT_Publish rejects a topic name which is not valid.
+ */
+void test_MQTT_Publish_InvalidTopicName( void )
+{
+    MQTTContext_t mqttContext = { 0 };
+    MQTTPublishInfo_t publishInfo = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTStatus_t status;
+
+    setupTransportInterface( &transport );
+    setupNetworkBuffer( &networkBuffer );
+
+    memset( &mqttContext, 0x0, sizeof( mqttContext ) );
+    memset( &publishInfo, 0x0, sizeof( publishInfo ) );
+    MQTT_Init( &mqttContext, &transport, getTime, eventCallback, &networkBuffer );
+
+    /* Topic names cannot contain wildcard characters. */
+    publishInfo.pTopicName = "sport/+/player";
+    publishInfo.topicNameLength = ( uint16_t ) strlen( publishInfo.pTopicName );
+    status = MQTT_Publish( &mqttContext, &publishInfo, 0 );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+
+    /* Topic names cannot contain the NUL character. */
+    publishInfo.pTopicName = "sport\0player";
+    publishInfo.topicNameLength = 12;
+    status = MQTT_Publish( &mqttContext, &publishInfo, 0 );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+}
+
 /**
  * @brief Test that MQTT_Publish works as intended.
  */
@@ -3150,12 +3347,13 @@ void test_MQTT_Publish_Storing_Publish_Success( void )
 
     MQTT_ReserveState_ExpectAnyArgsAndReturn( MQTTSuccess );
 
-    MQTT_UpdateDuplicatePublishFlag_ExpectAnyArgsAndReturn( MQTTSuccess );
-    MQTT_UpdateDuplicatePublishFlag_ExpectAnyArgsAndReturn( MQTTSuccess );
-
+    /* The state is advanced before the packet is stored and sent. */
     MQTT_UpdateStatePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
     MQTT_UpdateStatePublish_ReturnThruPtr_pNewState( &expectedState );
 
+    MQTT_UpdateDuplicatePublishFlag_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateDuplicatePublishFlag_ExpectAnyArgsAndReturn( MQTTSuccess );
+
     mqttContext.transportInterface.send = transportSendSuccess;
     status = MQTT_Publish( &mqttContext, &publishInfo, 1 );
     TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
@@ -3248,6 +3446,7 @@ void test_MQTT_Publish_Storing_Publish_Failed( void )
     MQTT_SerializePublishHeaderWithoutTopic_ExpectAnyArgsAndReturn( MQTTSuccess );
 
     MQTT_ReserveState_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStatePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
 
     MQTT_UpdateDuplicatePublishFlag_ExpectAnyArgsAndReturn( MQTTSuccess );
 
@@ -3293,6 +3492,7 @@ void test_MQTT_Publish_Storing_Publish_Failed_Due_To_Dup_Flag_Not_Set( void )
     MQTT_SerializePublishHeaderWithoutTopic_ExpectAnyArgsAndReturn( MQTTSuccess );
 
     MQTT_ReserveState_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStatePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
 
     MQTT_UpdateDuplicatePublishFlag_ExpectAnyArgsAndReturn( MQTTBadParameter );
 
@@ -4219,133 +4419,1513 @@ void test_MQTT_ProcessLoop_IncomingBufferNotInitQoS0( void )
     TEST_ASSERT_EQUAL( true, isEventCallbackInvoked );
 }
 
-void test_MQTT_ProcessLoop_HandleKeepAlive( void )
-{
-    MQTTContext_t context = { 0 };
-    TransportInterface_t transport = { 0 };
-    MQTTFixedBuffer_t networkBuffer = { 0 };
-    MQTTStatus_t mqttStatus;
+/* ========================================================================== */
 
-    setupTransportInterface( &transport );
-    transport.recv = transportRecvNoData;
-    setupNetworkBuffer( &networkBuffer );
+/**
+ * @brief Number of times #topicHandler has been invoked.
+ */
+static uint32_t topicHandlerInvokeCount = 0U;
 
-    mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+/**
+ * @brief The handler context #topicHandler was last invoked with.
+ */
+static void * pLastTopicHandlerContext = NULL;
 
-    /* Set this value such that the library will be forced to send keep alive. */
-    context.waitingForPingResp = true;
-    /* Update the time so that there is timeout. */
-    globalEntryTime = MQTT_PINGRESP_TIMEOUT_MS;
-    mqttStatus = MQTT_ProcessLoop( &context );
+/**
+ * @brief Topic handler registered with MQTT_RegisterTopicHandler in the tests.
+ */
+static void topicHandler( MQTTContext_t * pContext,
+                          MQTTPacketInfo_t * pPacketInfo,
+                          MQTTDeserializedInfo_t * pDeserializedInfo,
+                          void * pHandlerContext )
+{
+    ( void ) pContext;
+    ( void ) pPacketInfo;
+    ( void ) pDeserializedInfo;
 
-    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    topicHandlerInvokeCount++;
+    pLastTopicHandlerContext = pHandlerContext;
 }
 
-void test_MQTT_ProcessLoop_HandleKeepAlive1( void )
+/**
+ * @brief Receive a QoS 0 PUBLISH on the given topic with MQTT_ProcessLoop.
+ */
+static void processIncomingPublishOnTopic( MQTTContext_t * pContext,
+                                           const char * pTopicName )
 {
-    MQTTContext_t context = { 0 };
-    TransportInterface_t transport = { 0 };
-    MQTTFixedBuffer_t networkBuffer = { 0 };
     MQTTStatus_t mqttStatus;
-    size_t pingreqSize = MQTT_PACKET_PINGREQ_SIZE;
-
-    setupTransportInterface( &transport );
-    transport.recv = transportRecvNoData;
-    setupNetworkBuffer( &networkBuffer );
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    MQTTPublishInfo_t publishInfo = { 0 };
 
-    mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+    isEventCallbackInvoked = false;
+    topicHandlerInvokeCount = 0U;
+    pLastTopicHandlerContext = NULL;
 
-    context.connectStatus = MQTTConnected;
+    incomingPacket.type = MQTT_PACKET_TYPE_PUBLISH;
+    incomingPacket.remainingLength = MQTT_SAMPLE_REMAINING_LENGTH;
+    incomingPacket.headerLength = MQTT_SAMPLE_REMAINING_LENGTH;
 
-    /* Verify MQTTSuccess is returned. */
-    MQTT_GetPingreqPacketSize_ExpectAnyArgsAndReturn( MQTTSuccess );
-    MQTT_GetPingreqPacketSize_ReturnThruPtr_pPacketSize( &pingreqSize );
-    MQTT_SerializePingreq_ExpectAnyArgsAndReturn( MQTTSuccess );
+    publishInfo.qos = MQTTQoS0;
+    publishInfo.pTopicName = pTopicName;
+    publishInfo.topicNameLength = ( uint16_t ) strlen( pTopicName );
 
-    /* Set this value such that the library will be forced to send keep alive. */
-    context.waitingForPingResp = false;
-    context.keepAliveIntervalSec = 1;
-    /* Update the time so that there is timeout. */
-    globalEntryTime = MQTT_PINGRESP_TIMEOUT_MS;
-    mqttStatus = MQTT_ProcessLoop( &context );
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_DeserializePublish_ReturnThruPtr_pPublishInfo( &publishInfo );
+    MQTT_UpdateStatePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
 
+    mqttStatus = MQTT_ProcessLoop( pContext );
     TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
 }
 
-void test_MQTT_ProcessLoop_HandleKeepAlive2( void )
+/**
+ * @brief Test that MQTT_InitTopicHandlers validates its parameters.
+ */
+void test_MQTT_InitTopicHandlers_Invalid_Params( void )
 {
-    MQTTContext_t context = { 0 };
-    TransportInterface_t transport = { 0 };
-    MQTTFixedBuffer_t networkBuffer = { 0 };
     MQTTStatus_t mqttStatus;
+    MQTTContext_t context = { 0 };
+    MQTTTopicHandlerRecord_t exactHandlers[ 4 ];
+    MQTTTopicHandlerRecord_t wildcardHandlers[ 2 ];
 
-    setupTransportInterface( &transport );
-    transport.recv = transportRecvNoData;
-    setupNetworkBuffer( &networkBuffer );
+    mqttStatus = MQTT_InitTopicHandlers( NULL, exactHandlers, 4, wildcardHandlers, 2 );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
 
-    mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+    mqttStatus = MQTT_InitTopicHandlers( &context, NULL, 4, wildcardHandlers, 2 );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
 
-    /* Set this value such that the library will be forced to send keep alive. */
-    context.waitingForPingResp = false;
-    context.keepAliveIntervalSec = 1;
+    mqttStatus = MQTT_InitTopicHandlers( &context, exactHandlers, 0, wildcardHandlers, 2 );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
 
-    /* Update the time so that timeout does not occur and the ping is not sent. */
-    globalEntryTime = 0;
+    mqttStatus = MQTT_InitTopicHandlers( &context, exactHandlers, 4, NULL, 2 );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
 
-    mqttStatus = MQTT_ProcessLoop( &context );
+    mqttStatus = MQTT_InitTopicHandlers( &context, exactHandlers, 4, wildcardHandlers, 0 );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
 
-    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    /* The context has not been initialized with MQTT_Init. */
+    mqttStatus = MQTT_InitTopicHandlers( &context, exactHandlers, 4, wildcardHandlers, 2 );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
 }
 
-void test_MQTT_ProcessLoop_RecvFailed( void )
+/**
+ * @brief Test that MQTT_InitTopicHandlers clears the provided records.
+ */
+void test_MQTT_InitTopicHandlers_Happy_Path( void )
 {
-    MQTTContext_t context = { 0 };
-    TransportInterface_t transport = { 0 };
-    MQTTFixedBuffer_t networkBuffer = { 0 };
     MQTTStatus_t mqttStatus;
+    MQTTContext_t context = { 0 };
+    MQTTTopicHandlerRecord_t exactHandlers[ 4 ];
+    MQTTTopicHandlerRecord_t wildcardHandlers[ 2 ];
 
-    setupTransportInterface( &transport );
-    transport.recv = transportRecvFailure;
-    setupNetworkBuffer( &networkBuffer );
-
-    mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
-    context.connectStatus = MQTTConnected;
-
-    mqttStatus = MQTT_ProcessLoop( &context );
+    setUPContext( &context );
+    memset( exactHandlers, 0xA5, sizeof( exactHandlers ) );
+    memset( wildcardHandlers, 0xA5, sizeof( wildcardHandlers ) );
 
-    TEST_ASSERT_EQUAL( MQTTRecvFailed, mqttStatus );
+    mqttStatus = MQTT_InitTopicHandlers( &context, exactHandlers, 4, wildcardHandlers, 2 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL_PTR( exactHandlers, context.pExactTopicHandlers );
+    TEST_ASSERT_EQUAL( 4, context.exactTopicHandlerMaxCount );
+    TEST_ASSERT_EQUAL_PTR( wildcardHandlers, context.pWildcardTopicHandlers );
+    TEST_ASSERT_EQUAL( 2, context.wildcardTopicHandlerMaxCount );
+    TEST_ASSERT_EQUAL( 0, context.wildcardTopicHandlerCount );
+    TEST_ASSERT_NULL( exactHandlers[ 3 ].pTopicFilter );
+    TEST_ASSERT_NULL( wildcardHandlers[ 1 ].pTopicFilter );
+
+    /* Only one kind of table is required. */
+    mqttStatus = MQTT_InitTopicHandlers( &context, NULL, 0, wildcardHandlers, 2 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_NULL( context.pExactTopicHandlers );
 }
 
-void test_MQTT_ProcessLoop_RecvFailed_disconnected( void )
+/**
+ * @brief Test that MQTT_RegisterTopicHandler validates its parameters.
+ */
+void test_MQTT_RegisterTopicHandler_Invalid_Params( void )
 {
-    MQTTContext_t context = { 0 };
-    TransportInterface_t transport = { 0 };
-    MQTTFixedBuffer_t networkBuffer = { 0 };
     MQTTStatus_t mqttStatus;
+    MQTTContext_t context = { 0 };
+    MQTTTopicHandlerRecord_t exactHandlers[ 4 ];
+    MQTTTopicHandlerRecord_t wildcardHandlers[ 2 ];
 
-    setupTransportInterface( &transport );
-    transport.recv = transportRecvFailure;
-    setupNetworkBuffer( &networkBuffer );
+    setUPContext( &context );
 
-    mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+    mqttStatus = MQTT_RegisterTopicHandler( NULL, "a/b", 3, topicHandler, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
 
-    mqttStatus = MQTT_ProcessLoop( &context );
+    mqttStatus = MQTT_RegisterTopicHandler( &context, NULL, 3, topicHandler, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
 
-    TEST_ASSERT_EQUAL( MQTTRecvFailed, mqttStatus );
+    mqttStatus = MQTT_RegisterTopicHandler( &context, "a/b", 0, topicHandler, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_RegisterTopicHandler( &context, "a/b", 3, NULL, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    /* Handler tables have not been initialized. */
+    mqttStatus = MQTT_RegisterTopicHandler( &context, "a/b", 3, topicHandler, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_RegisterTopicHandler( &context, "a/#", 3, topicHandler, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    /* Exact filters need the exact-match table. */
+    mqttStatus = MQTT_InitTopicHandlers( &context, NULL, 0, wildcardHandlers, 2 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    mqttStatus = MQTT_RegisterTopicHandler( &context, "a/b", 3, topicHandler, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    /* Wildcard filters need the wildcard list. */
+    mqttStatus = MQTT_InitTopicHandlers( &context, exactHandlers, 4, NULL, 0 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    mqttStatus = MQTT_RegisterTopicHandler( &context, "a/+", 3, topicHandler, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
 }
 
-void test_MQTT_ReceiveLoop_KeepAliveACK( void )
+/**
+ * @brief Test that MQTT_RegisterTopicHandler rejects malformed topic filters,
+ * which could never match or would match unpredictably.
+ */
+void test_MQTT_RegisterTopicHandler_Invalid_Filter( void )
 {
-    MQTTContext_t context = { 0 };
-    TransportInterface_t transport = { 0 };
-    MQTTFixedBuffer_t networkBuffer = { 0 };
-    MQTTPacketInfo_t incomingPacket = { 0 };
     MQTTStatus_t mqttStatus;
+    MQTTContext_t context = { 0 };
+    MQTTTopicHandlerRecord_t exactHandlers[ 2 ];
+    MQTTTopicHandlerRecord_t wildcardHandlers[ 2 ];
 
-    setupTransportInterface( &transport );
-    setupNetworkBuffer( &networkBuffer );
+    setUPContext( &context );
 
-    mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+    mqttStatus = MQTT_InitTopicHandlers( &context, exactHandlers, 2, wildcardHandlers, 2 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    /* A multi-level wildcard which is not the last level. */
+    mqttStatus = MQTT_RegisterTopicHandler( &context, "a/#/b", 5, topicHandler, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    /* Wildcards which do not occupy an entire level. */
+    mqttStatus = MQTT_RegisterTopicHandler( &context, "a+", 2, topicHandler, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+    mqttStatus = MQTT_RegisterTopicHandler( &context, "a/b#", 4, topicHandler, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    /* A NUL character. */
+    mqttStatus = MQTT_RegisterTopicHandler( &context, "a\0b", 3, topicHandler, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    TEST_ASSERT_EQUAL( 0, context.wildcardTopicHandlerCount );
+    TEST_ASSERT_NULL( exactHandlers[ 0 ].handler );
+    TEST_ASSERT_NULL( exactHandlers[ 1 ].handler );
+
+    mqttStatus = MQTT_RegisterTopicHandler( &context, "a/+/#", 5, topicHandler, NULL );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+}
+
+/**
+ * @brief Test that MQTT_RegisterTopicHandler reports full handler tables and
+ * replaces the handler of a registered topic filter.
+ */
+void test_MQTT_RegisterTopicHandler_NoMemory_And_Replace( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t context = { 0 };
+    MQTTTopicHandlerRecord_t exactHandlers[ 2 ];
+    MQTTTopicHandlerRecord_t wildcardHandlers[ 1 ];
+    int handlerContext = 0;
+
+    setUPContext( &context );
+
+    mqttStatus = MQTT_InitTopicHandlers( &context, exactHandlers, 2, wildcardHandlers, 1 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    mqttStatus = MQTT_RegisterTopicHandler( &context, "a", 1, topicHandler, NULL );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    mqttStatus = MQTT_RegisterTopicHandler( &context, "b", 1, topicHandler, NULL );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    mqttStatus = MQTT_RegisterTopicHandler( &context, "c", 1, topicHandler, NULL );
+    TEST_ASSERT_EQUAL( MQTTNoMemory, mqttStatus );
+
+    mqttStatus = MQTT_RegisterTopicHandler( &context, "a/#", 3, topicHandler, NULL );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    mqttStatus = MQTT_RegisterTopicHandler( &context, "b/#", 3, topicHandler, NULL );
+    TEST_ASSERT_EQUAL( MQTTNoMemory, mqttStatus );
+
+    /* Registering a filter again replaces its handler context even when the
+     * tables are full. */
+    mqttStatus = MQTT_RegisterTopicHandler( &context, "b", 1, topicHandler, &handlerContext );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    mqttStatus = MQTT_RegisterTopicHandler( &context, "a/#", 3, topicHandler, &handlerContext );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL( 1, context.wildcardTopicHandlerCount );
+    TEST_ASSERT_EQUAL_PTR( &handlerContext, wildcardHandlers[ 0 ].pHandlerContext );
+
+    processIncomingPublishOnTopic( &context, "b" );
+    TEST_ASSERT_EQUAL( 1, topicHandlerInvokeCount );
+    TEST_ASSERT_EQUAL_PTR( &handlerContext, pLastTopicHandlerContext );
+}
+
+/**
+ * @brief Test that MQTT_UnregisterTopicHandler keeps the remaining handlers
+ * reachable.
+ */
+void test_MQTT_UnregisterTopicHandler( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t context = { 0 };
+    MQTTTopicHandlerRecord_t exactHandlers[ 3 ];
+    MQTTTopicHandlerRecord_t wildcardHandlers[ 3 ];
+    const char * exactFilters[] = { "a", "b", "c" };
+    const char * wildcardFilters[] = { "x/+", "x/#", "#" };
+    int handlerContexts[ 3 ];
+    size_t i;
+
+    setUPContext( &context );
+
+    mqttStatus = MQTT_UnregisterTopicHandler( NULL, "a", 1 );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+    mqttStatus = MQTT_UnregisterTopicHandler( &context, NULL, 1 );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+    mqttStatus = MQTT_UnregisterTopicHandler( &context, "a", 0 );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+    mqttStatus = MQTT_UnregisterTopicHandler( &context, "a", 1 );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_InitTopicHandlers( &context, exactHandlers, 3, wildcardHandlers, 3 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    /* A full table forces the filters into each other's probe sequences. */
+    for( i = 0; i < 3; i++ )
+    {
+        mqttStatus = MQTT_RegisterTopicHandler( &context, exactFilters[ i ], 1,
+                                                topicHandler, &handlerContexts[ i ] );
+        TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+        mqttStatus = MQTT_RegisterTopicHandler( &context, wildcardFilters[ i ],
+                                                ( uint16_t ) strlen( wildcardFilters[ i ] ),
+                                                topicHandler, &handlerContexts[ i ] );
+        TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    }
+
+    mqttStatus = MQTT_UnregisterTopicHandler( &context, "d", 1 );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    /* Removing each filter in turn must leave the others reachable. */
+    for( i = 0; i < 3; i++ )
+    {
+        mqttStatus = MQTT_UnregisterTopicHandler( &context, exactFilters[ i ], 1 );
+        TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+        mqttStatus = MQTT_UnregisterTopicHandler( &context, exactFilters[ i ], 1 );
+        TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+    }
+
+    for( i = 0; i < 3; i++ )
+    {
+        TEST_ASSERT_NULL( exactHandlers[ i ].pTopicFilter );
+    }
+
+    /* Removing a wildcard filter keeps the registration order of the others. */
+    mqttStatus = MQTT_UnregisterTopicHandler( &context, "x/+", 3 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL( 2, context.wildcardTopicHandlerCount );
+    TEST_ASSERT_EQUAL_PTR( &handlerContexts[ 1 ], wildcardHandlers[ 0 ].pHandlerContext );
+    TEST_ASSERT_EQUAL_PTR( &handlerContexts[ 2 ], wildcardHandlers[ 1 ].pHandlerContext );
+    TEST_ASSERT_NULL( wildcardHandlers[ 2 ].pTopicFilter );
+}
+
+/**
+ * @brief Test that an incoming publish is given to the handler of the exact
+ * topic filter before any wildcard handler.
+ */
+void test_MQTT_ProcessLoop_TopicHandler_ExactMatch( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t context = { 0 };
+    MQTTTopicHandlerRecord_t exactHandlers[ 4 ];
+    MQTTTopicHandlerRecord_t wildcardHandlers[ 2 ];
+    int exactContext = 0, wildcardContext = 0;
+
+    setUPContext( &context );
+
+    mqttStatus = MQTT_InitTopicHandlers( &context, exactHandlers, 4, wildcardHandlers, 2 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    mqttStatus = MQTT_RegisterTopicHandler( &context, "sensors/#", 9, topicHandler, &wildcardContext );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    mqttStatus = MQTT_RegisterTopicHandler( &context, "sensors/kitchen", 15, topicHandler, &exactContext );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    processIncomingPublishOnTopic( &context, "sensors/kitchen" );
+
+    TEST_ASSERT_EQUAL( 1, topicHandlerInvokeCount );
+    TEST_ASSERT_EQUAL_PTR( &exactContext, pLastTopicHandlerContext );
+    TEST_ASSERT_FALSE( isEventCallbackInvoked );
+}
+
+/**
+ * @brief Test that wildcard topic handlers are tried in registration order.
+ */
+void test_MQTT_ProcessLoop_TopicHandler_WildcardMatch( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t context = { 0 };
+    MQTTTopicHandlerRecord_t exactHandlers[ 4 ];
+    MQTTTopicHandlerRecord_t wildcardHandlers[ 3 ];
+    int handlerContexts[ 3 ];
+
+    setUPContext( &context );
+
+    mqttStatus = MQTT_InitTopicHandlers( &context, exactHandlers, 4, wildcardHandlers, 3 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    mqttStatus = MQTT_RegisterTopicHandler( &context, "lights/+", 8, topicHandler, &handlerContexts[ 0 ] );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    mqttStatus = MQTT_RegisterTopicHandler( &context, "sensors/+/temp", 14, topicHandler, &handlerContexts[ 1 ] );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    mqttStatus = MQTT_RegisterTopicHandler( &context, "sensors/#", 9, topicHandler, &handlerContexts[ 2 ] );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    processIncomingPublishOnTopic( &context, "sensors/kitchen/temp" );
+    TEST_ASSERT_EQUAL( 1, topicHandlerInvokeCount );
+    TEST_ASSERT_EQUAL_PTR( &handlerContexts[ 1 ], pLastTopicHandlerContext );
+    TEST_ASSERT_FALSE( isEventCallbackInvoked );
+
+    /* The "#" wildcard also matches the parent level. */
+    processIncomingPublishOnTopic( &context, "sensors" );
+    TEST_ASSERT_EQUAL( 1, topicHandlerInvokeCount );
+    TEST_ASSERT_EQUAL_PTR( &handlerContexts[ 2 ], pLastTopicHandlerContext );
+    TEST_ASSERT_FALSE( isEventCallbackInvoked );
+}
+
+/**
+ * @brief Test that single-level wildcards are matched across the levels of a
+ * topic name, with its level separators found once for all topic filters, and
+ * without them when it has too many levels or is not a valid topic name.
+ */
+void test_MQTT_ProcessLoop_TopicHandler_WildcardLevels( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t context = { 0 };
+    MQTTTopicHandlerRecord_t exactHandlers[ 2 ];
+    MQTTTopicHandlerRecord_t wildcardHandlers[ 4 ];
+    int handlerContexts[ 4 ];
+
+    setUPContext( &context );
+
+    mqttStatus = MQTT_InitTopicHandlers( &context, exactHandlers, 2, wildcardHandlers, 4 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    mqttStatus = MQTT_RegisterTopicHandler( &context, "a/+/c/+/x", 9, topicHandler, &handlerContexts[ 0 ] );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    mqttStatus = MQTT_RegisterTopicHandler( &context, "a/+/c/+/e", 9, topicHandler, &handlerContexts[ 1 ] );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    mqttStatus = MQTT_RegisterTopicHandler( &context, "+/+/+/+/+/+/+/+/+/+/+/+/+/+/+/+/+/+", 35, topicHandler, &handlerContexts[ 2 ] );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    mqttStatus = MQTT_RegisterTopicHandler( &context, "a/+", 3, topicHandler, &handlerContexts[ 3 ] );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    /* The first filter is rejected at its last level, the second matches. */
+    processIncomingPublishOnTopic( &context, "a/long-level-name/c/another-long-level/e" );
+    TEST_ASSERT_EQUAL( 1, topicHandlerInvokeCount );
+    TEST_ASSERT_EQUAL_PTR( &handlerContexts[ 1 ], pLastTopicHandlerContext );
+
+    /* Empty levels. */
+    processIncomingPublishOnTopic( &context, "a//c//e" );
+    TEST_ASSERT_EQUAL_PTR( &handlerContexts[ 1 ], pLastTopicHandlerContext );
+
+    /* 18 levels, more than the separators recorded for matching. */
+    processIncomingPublishOnTopic( &context, "l0/l1/l2/l3/l4/l5/l6/l7/l8/l9/la/lb/lc/ld/le/lf/lg/lh" );
+    TEST_ASSERT_EQUAL_PTR( &handlerContexts[ 2 ], pLastTopicHandlerContext );
+    processIncomingPublishOnTopic( &context, "l0/l1/l2/l3/l4/l5/l6/l7/l8/l9/la/lb/lc/ld/le/lf/lg" );
+    TEST_ASSERT_EQUAL( 0, topicHandlerInvokeCount );
+    TEST_ASSERT_TRUE( isEventCallbackInvoked );
+
+    /* A topic name with a wildcard character is still matched as before. */
+    processIncomingPublishOnTopic( &context, "a/+" );
+    TEST_ASSERT_EQUAL_PTR( &handlerContexts[ 3 ], pLastTopicHandlerContext );
+}
+
+/**
+ * @brief Test that publishes which match no registered topic filter are given
+ * to the application callback.
+ */
+void test_MQTT_ProcessLoop_TopicHandler_NoMatch( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t context = { 0 };
+    MQTTTopicHandlerRecord_t exactHandlers[ 4 ];
+    MQTTTopicHandlerRecord_t wildcardHandlers[ 2 ];
+
+    setUPContext( &context );
+
+    mqttStatus = MQTT_InitTopicHandlers( &context, exactHandlers, 4, wildcardHandlers, 2 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    mqttStatus = MQTT_RegisterTopicHandler( &context, "sensors/kitchen", 15, topicHandler, NULL );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    mqttStatus = MQTT_RegisterTopicHandler( &context, "sensors/+/temp", 14, topicHandler, NULL );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    mqttStatus = MQTT_RegisterTopicHandler( &context, "+/temp", 6, topicHandler, NULL );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    processIncomingPublishOnTopic( &context, "sensors/kitchen/humidity" );
+    TEST_ASSERT_EQUAL( 0, topicHandlerInvokeCount );
+    TEST_ASSERT_TRUE( isEventCallbackInvoked );
+
+    /* Topics starting with '$' are not matched by leading wildcards. */
+    processIncomingPublishOnTopic( &context, "$SYS/temp" );
+    TEST_ASSERT_EQUAL( 0, topicHandlerInvokeCount );
+    TEST_ASSERT_TRUE( isEventCallbackInvoked );
+}
+
+/**
+ * @brief Initialize a context which has no network buffer of its own and
+ * borrows its buffers from the given pool.
+ */
+static void setupPooledContext( MQTTContext_t * pContext,
+                                TransportInterface_t * pTransport,
+                                MQTTBufferPool_t * pBufferPool )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTFixedBuffer_t noBuffer = { NULL, 0 };
+
+    mqttStatus = MQTT_Init( pContext, pTransport, getTime, eventCallback, &noBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    mqttStatus = MQTT_SetBufferPool( pContext, pBufferPool );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+}
+
+/**
+ * @brief Test that MQTT_InitBufferPool validates its parameters.
+ */
+void test_MQTT_InitBufferPool_Invalid_Params( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTBufferPool_t bufferPool;
+    uint8_t poolMemory[ 2 * MQTT_TEST_BUFFER_LENGTH ];
+
+    mqttStatus = MQTT_InitBufferPool( NULL, poolMemory, MQTT_TEST_BUFFER_LENGTH, 2 );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_InitBufferPool( &bufferPool, NULL, MQTT_TEST_BUFFER_LENGTH, 2 );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    /* Each free buffer must be able to hold the link to the next one. */
+    mqttStatus = MQTT_InitBufferPool( &bufferPool, poolMemory, sizeof( uint8_t * ) - 1U, 2 );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_InitBufferPool( &bufferPool, poolMemory, MQTT_TEST_BUFFER_LENGTH, 0 );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+}
+
+/**
+ * @brief Test that MQTT_InitBufferPool lends its buffers in order.
+ */
+void test_MQTT_InitBufferPool_Happy_Path( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTBufferPool_t bufferPool;
+    uint8_t poolMemory[ 3 * MQTT_TEST_BUFFER_LENGTH ];
+    uint8_t * pNextBuffer = NULL;
+
+    mqttStatus = MQTT_InitBufferPool( &bufferPool, poolMemory, MQTT_TEST_BUFFER_LENGTH, 3 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL( 3, bufferPool.bufferCount );
+    TEST_ASSERT_EQUAL( 3, bufferPool.freeCount );
+    TEST_ASSERT_EQUAL( MQTT_TEST_BUFFER_LENGTH, bufferPool.bufferSize );
+    TEST_ASSERT_EQUAL_PTR( poolMemory, bufferPool.pFreeList );
+
+    memcpy( &pNextBuffer, &poolMemory[ 0 ], sizeof( pNextBuffer ) );
+    TEST_ASSERT_EQUAL_PTR( &poolMemory[ MQTT_TEST_BUFFER_LENGTH ], pNextBuffer );
+    memcpy( &pNextBuffer, &poolMemory[ 2 * MQTT_TEST_BUFFER_LENGTH ], sizeof( pNextBuffer ) );
+    TEST_ASSERT_NULL( pNextBuffer );
+}
+
+/**
+ * @brief Test that MQTT_SetBufferPool validates its parameters.
+ */
+void test_MQTT_SetBufferPool_Invalid_Params( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t context = { 0 };
+    MQTTBufferPool_t bufferPool = { 0 };
+
+    mqttStatus = MQTT_SetBufferPool( NULL, &bufferPool );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    /* The pool cannot be changed in the middle of a packet. */
+    context.index = 1;
+    mqttStatus = MQTT_SetBufferPool( &context, &bufferPool );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    context.index = 0;
+    mqttStatus = MQTT_SetBufferPool( &context, &bufferPool );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    /* Detaching the pool is allowed. */
+    mqttStatus = MQTT_SetBufferPool( &context, NULL );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_NULL( context.pBufferPool );
+}
+
+/**
+ * @brief Test that a context holds a pool buffer only while processing
+ * received data.
+ */
+void test_MQTT_ProcessLoop_BufferPool_BorrowAndReturn( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t context = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTBufferPool_t bufferPool;
+    uint8_t poolMemory[ 2 * MQTT_TEST_BUFFER_LENGTH ];
+
+    setupTransportInterface( &transport );
+    mqttStatus = MQTT_InitBufferPool( &bufferPool, poolMemory, MQTT_TEST_BUFFER_LENGTH, 2 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    setupPooledContext( &context, &transport, &bufferPool );
+
+    /* The packet fills the buffer, so nothing is left after processing it. */
+    processIncomingPublishOnTopic( &context, "sensors/kitchen" );
+    TEST_ASSERT_TRUE( isEventCallbackInvoked );
+    TEST_ASSERT_EQUAL( 2, bufferPool.freeCount );
+    TEST_ASSERT_FALSE( context.networkBufferBorrowed );
+    TEST_ASSERT_NULL( context.networkBuffer.pBuffer );
+
+    /* Polling an idle connection returns the buffer immediately. */
+    transport.recv = transportRecvNoData;
+    context.transportInterface = transport;
+    mqttStatus = MQTT_ProcessLoop( &context );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL( 2, bufferPool.freeCount );
+    TEST_ASSERT_FALSE( context.networkBufferBorrowed );
+}
+
+/**
+ * @brief Test that a context keeps its pool buffer while a packet is partially
+ * received, and returns it once the packet has been processed.
+ */
+void test_MQTT_ProcessLoop_BufferPool_PartialPacket( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t context = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTBufferPool_t bufferPool;
+    uint8_t poolMemory[ 2 * MQTT_TEST_BUFFER_LENGTH ];
+    MQTTPacketInfo_t incomingPacket = { 0 };
+
+    setupTransportInterface( &transport );
+    transport.recv = transportRecvOneByte;
+    mqttStatus = MQTT_InitBufferPool( &bufferPool, poolMemory, MQTT_TEST_BUFFER_LENGTH, 2 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    setupPooledContext( &context, &transport, &bufferPool );
+
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTNeedMoreBytes );
+    mqttStatus = MQTT_ProcessLoop( &context );
+    TEST_ASSERT_EQUAL( MQTTNeedMoreBytes, mqttStatus );
+    TEST_ASSERT_EQUAL( 1, bufferPool.freeCount );
+    TEST_ASSERT_TRUE( context.networkBufferBorrowed );
+    TEST_ASSERT_EQUAL_PTR( poolMemory, context.networkBuffer.pBuffer );
+    TEST_ASSERT_EQUAL( MQTT_TEST_BUFFER_LENGTH, context.networkBuffer.size );
+
+    /* The second byte completes a PINGRESP. */
+    incomingPacket.type = MQTT_PACKET_TYPE_PINGRESP;
+    incomingPacket.remainingLength = 0;
+    incomingPacket.headerLength = 2;
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    mqttStatus = MQTT_ProcessLoop( &context );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL( 0, context.index );
+    TEST_ASSERT_EQUAL( 2, bufferPool.freeCount );
+    TEST_ASSERT_FALSE( context.networkBufferBorrowed );
+    TEST_ASSERT_EQUAL_PTR( poolMemory, bufferPool.pFreeList );
+}
+
+/**
+ * @brief Test the behavior of MQTT_ProcessLoop when the buffer pool is exhausted.
+ */
+void test_MQTT_ProcessLoop_BufferPool_Exhausted( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t busyContext = { 0 };
+    MQTTContext_t pooledContext = { 0 };
+    MQTTContext_t fallbackContext = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTBufferPool_t bufferPool;
+    uint8_t poolMemory[ MQTT_TEST_BUFFER_LENGTH ];
+
+    setupTransportInterface( &transport );
+    mqttStatus = MQTT_InitBufferPool( &bufferPool, poolMemory, MQTT_TEST_BUFFER_LENGTH, 1 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    /* The only buffer is held by a context with a partially received packet. */
+    transport.recv = transportRecvOneByte;
+    setupPooledContext( &busyContext, &transport, &bufferPool );
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTNeedMoreBytes );
+    mqttStatus = MQTT_ProcessLoop( &busyContext );
+    TEST_ASSERT_EQUAL( MQTTNeedMoreBytes, mqttStatus );
+    TEST_ASSERT_EQUAL( 0, bufferPool.freeCount );
+
+    /* A context without a buffer of its own leaves the data in the transport. */
+    transport.recv = transportRecvFailure;
+    setupPooledContext( &pooledContext, &transport, &bufferPool );
+    mqttStatus = MQTT_ProcessLoop( &pooledContext );
+    TEST_ASSERT_EQUAL( MQTTNoMemory, mqttStatus );
+    TEST_ASSERT_EQUAL( MQTTNotConnected, pooledContext.connectStatus );
+
+    mqttStatus = MQTT_ReceiveLoop( &pooledContext );
+    TEST_ASSERT_EQUAL( MQTTNoMemory, mqttStatus );
+
+    /* A context with a buffer of its own falls back to it. */
+    transport.recv = transportRecvSuccess;
+    setupNetworkBuffer( &networkBuffer );
+    mqttStatus = MQTT_Init( &fallbackContext, &transport, getTime, eventCallback, &networkBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    mqttStatus = MQTT_SetBufferPool( &fallbackContext, &bufferPool );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    processIncomingPublishOnTopic( &fallbackContext, "sensors/kitchen" );
+    TEST_ASSERT_TRUE( isEventCallbackInvoked );
+    TEST_ASSERT_FALSE( fallbackContext.networkBufferBorrowed );
+    TEST_ASSERT_EQUAL_PTR( mqttBuffer, fallbackContext.networkBuffer.pBuffer );
+}
+
+/**
+ * @brief Test that MQTT_Connect does not send CONNECT when no buffer is
+ * available to receive the CONNACK.
+ */
+void test_MQTT_Connect_BufferPool_Exhausted( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t context = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTConnectInfo_t connectInfo = { 0 };
+    MQTTBufferPool_t bufferPool = { 0 };
+    bool sessionPresent = false;
+
+    setupTransportInterface( &transport );
+    transport.send = transportSendFailure;
+    transport.writev = transportWritevFail;
+
+    /* The pool has no free buffers. */
+    setupPooledContext( &context, &transport, &bufferPool );
+
+    MQTT_GetConnectPacketSize_IgnoreAndReturn( MQTTSuccess );
+
+    mqttStatus = MQTT_Connect( &context, &connectInfo, NULL, 0U, &sessionPresent );
+    TEST_ASSERT_EQUAL( MQTTNoMemory, mqttStatus );
+    TEST_ASSERT_EQUAL( MQTTNotConnected, context.connectStatus );
+}
+
+/**
+ * @brief Buffer claimed by #eventCallbackClaimBuffer, and the status of its
+ * claims.
+ */
+static uint8_t * pClaimedBuffer = NULL;
+static MQTTStatus_t claimStatus = MQTTIllegalState;
+static MQTTStatus_t secondClaimStatus = MQTTIllegalState;
+
+/**
+ * @brief Event callback which claims the network buffer of incoming publishes,
+ * and tries to claim it a second time.
+ */
+static void eventCallbackClaimBuffer( MQTTContext_t * pContext,
+                                      MQTTPacketInfo_t * pPacketInfo,
+                                      MQTTDeserializedInfo_t * pDeserializedInfo )
+{
+    uint8_t * pSecondBuffer = NULL;
+
+    ( void ) pPacketInfo;
+    ( void ) pDeserializedInfo;
+
+    isEventCallbackInvoked = true;
+    pClaimedBuffer = NULL;
+    claimStatus = MQTT_ClaimNetworkBuffer( pContext, &pClaimedBuffer );
+    secondClaimStatus = MQTT_ClaimNetworkBuffer( pContext, &pSecondBuffer );
+    TEST_ASSERT_NULL( pSecondBuffer );
+}
+
+/**
+ * @brief Test that MQTT_ClaimNetworkBuffer and MQTT_ReleaseNetworkBuffer
+ * validate their parameters.
+ */
+void test_MQTT_ClaimNetworkBuffer_Invalid_Params( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t context = { 0 };
+    MQTTBufferPool_t bufferPool = { 0 };
+    uint8_t * pBuffer = NULL;
+
+    mqttStatus = MQTT_ClaimNetworkBuffer( NULL, &pBuffer );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_ClaimNetworkBuffer( &context, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    /* Outside the callback of an incoming publish. */
+    mqttStatus = MQTT_ClaimNetworkBuffer( &context, &pBuffer );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+    TEST_ASSERT_NULL( pBuffer );
+
+    mqttStatus = MQTT_ReleaseNetworkBuffer( NULL, mqttBuffer );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_ReleaseNetworkBuffer( &bufferPool, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+}
+
+/**
+ * @brief Test that a claimed network buffer is replaced by another buffer of
+ * the pool, and returns to the pool when released.
+ */
+void test_MQTT_ClaimNetworkBuffer_Happy_Path( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t context = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTBufferPool_t bufferPool;
+    uint8_t poolMemory[ 2 * MQTT_TEST_BUFFER_LENGTH ];
+
+    setupTransportInterface( &transport );
+    mqttStatus = MQTT_InitBufferPool( &bufferPool, poolMemory, MQTT_TEST_BUFFER_LENGTH, 2 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    setupPooledContext( &context, &transport, &bufferPool );
+    context.appCallback = eventCallbackClaimBuffer;
+
+    processIncomingPublishOnTopic( &context, "sensors/kitchen" );
+    TEST_ASSERT_TRUE( isEventCallbackInvoked );
+    TEST_ASSERT_EQUAL( MQTTSuccess, claimStatus );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, secondClaimStatus );
+    TEST_ASSERT_EQUAL_PTR( poolMemory, pClaimedBuffer );
+
+    /* The replacement buffer held no data, and went back to the pool. */
+    TEST_ASSERT_EQUAL( 1, bufferPool.freeCount );
+    TEST_ASSERT_FALSE( context.networkBufferBorrowed );
+    TEST_ASSERT_NULL( context.pReplacementBuffer );
+    TEST_ASSERT_NULL( context.pClaimableBuffer );
+
+    mqttStatus = MQTT_ReleaseNetworkBuffer( &bufferPool, pClaimedBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL( 2, bufferPool.freeCount );
+    TEST_ASSERT_EQUAL_PTR( poolMemory, bufferPool.pFreeList );
+}
+
+/**
+ * @brief Test that the data received after a claimed publish continues in the
+ * replacement buffer, and the claimed buffer is left as it was.
+ */
+void test_MQTT_ClaimNetworkBuffer_RemainingData( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t context = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTBufferPool_t bufferPool;
+    uint8_t poolMemory[ 2 * MQTT_TEST_BUFFER_LENGTH ];
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    MQTTPublishInfo_t publishInfo = { 0 };
+    size_t i;
+
+    setupTransportInterface( &transport );
+    mqttStatus = MQTT_InitBufferPool( &bufferPool, poolMemory, MQTT_TEST_BUFFER_LENGTH, 2 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    setupPooledContext( &context, &transport, &bufferPool );
+    context.appCallback = eventCallbackClaimBuffer;
+
+    /* The first buffer holds a 12 byte publish followed by other data; its
+     * first bytes are the link of the free list. */
+    for( i = sizeof( uint8_t * ); i < MQTT_TEST_BUFFER_LENGTH; i++ )
+    {
+        poolMemory[ i ] = ( uint8_t ) i;
+    }
+
+    incomingPacket.type = MQTT_PACKET_TYPE_PUBLISH;
+    incomingPacket.remainingLength = 10;
+    incomingPacket.headerLength = 2;
+    publishInfo.qos = MQTTQoS0;
+    publishInfo.pTopicName = "sensors/kitchen";
+    publishInfo.topicNameLength = 15;
+
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_DeserializePublish_ReturnThruPtr_pPublishInfo( &publishInfo );
+    MQTT_UpdateStatePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+
+    mqttStatus = MQTT_ProcessLoop( &context );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL( MQTTSuccess, claimStatus );
+    TEST_ASSERT_EQUAL_PTR( poolMemory, pClaimedBuffer );
+
+    /* The context keeps the replacement buffer for the remaining data. */
+    TEST_ASSERT_EQUAL( MQTT_TEST_BUFFER_LENGTH - 12, context.index );
+    TEST_ASSERT_TRUE( context.networkBufferBorrowed );
+    TEST_ASSERT_EQUAL_PTR( &poolMemory[ MQTT_TEST_BUFFER_LENGTH ], context.networkBuffer.pBuffer );
+    TEST_ASSERT_EQUAL( 0, bufferPool.freeCount );
+
+    for( i = 0; i < context.index; i++ )
+    {
+        TEST_ASSERT_EQUAL_UINT8( ( uint8_t ) ( i + 12U ), context.networkBuffer.pBuffer[ i ] );
+    }
+
+    for( i = 12; i < MQTT_TEST_BUFFER_LENGTH; i++ )
+    {
+        TEST_ASSERT_EQUAL_UINT8( ( uint8_t ) i, pClaimedBuffer[ i ] );
+    }
+}
+
+/**
+ * @brief Test that a network buffer cannot be claimed when the pool has no
+ * buffer to replace it, or when it is not a buffer of the pool.
+ */
+void test_MQTT_ClaimNetworkBuffer_Unavailable( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t context = { 0 };
+    MQTTContext_t fallbackContext = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTBufferPool_t bufferPool;
+    uint8_t poolMemory[ MQTT_TEST_BUFFER_LENGTH ];
+
+    setupTransportInterface( &transport );
+    mqttStatus = MQTT_InitBufferPool( &bufferPool, poolMemory, MQTT_TEST_BUFFER_LENGTH, 1 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    /* The only buffer of the pool holds the publish. */
+    setupPooledContext( &context, &transport, &bufferPool );
+    context.appCallback = eventCallbackClaimBuffer;
+
+    processIncomingPublishOnTopic( &context, "sensors/kitchen" );
+    TEST_ASSERT_EQUAL( MQTTNoMemory, claimStatus );
+    TEST_ASSERT_NULL( pClaimedBuffer );
+    TEST_ASSERT_EQUAL( 1, bufferPool.freeCount );
+    TEST_ASSERT_FALSE( context.networkBufferBorrowed );
+
+    /* The buffer of the context itself cannot be claimed. */
+    setupNetworkBuffer( &networkBuffer );
+    mqttStatus = MQTT_Init( &fallbackContext, &transport, getTime, eventCallbackClaimBuffer, &networkBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    processIncomingPublishOnTopic( &fallbackContext, "sensors/kitchen" );
+    TEST_ASSERT_TRUE( isEventCallbackInvoked );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, claimStatus );
+    TEST_ASSERT_NULL( pClaimedBuffer );
+}
+
+/**
+ * @brief Test that a publish is gathered into a buffer of the transport, and
+ * sent with a single commit.
+ */
+void test_MQTT_Publish_TxBuffer( void )
+{
+    MQTTContext_t mqttContext = { 0 };
+    MQTTPublishInfo_t publishInfo = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTStatus_t status;
+
+    setupTxBufferTransportInterface( &transport );
+    setupNetworkBuffer( &networkBuffer );
+
+    status = MQTT_Init( &mqttContext, &transport, getTime, eventCallback, &networkBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    mqttContext.connectStatus = MQTTConnected;
+
+    publishInfo.pTopicName = MQTT_SAMPLE_TOPIC_FILTER;
+    publishInfo.topicNameLength = MQTT_SAMPLE_TOPIC_FILTER_LENGTH;
+    publishInfo.pPayload = "Test";
+    publishInfo.payloadLength = 4;
+
+    MQTT_GetPublishPacketSize_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_SerializePublishHeaderWithoutTopic_ExpectAnyArgsAndReturn( MQTTSuccess );
+
+    status = MQTT_Publish( &mqttContext, &publishInfo, 0 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+
+    /* The mocked serializer writes an empty header. */
+    TEST_ASSERT_EQUAL( 1U, txBufferGetCount );
+    TEST_ASSERT_EQUAL( 1U, txBufferCommitCount );
+    TEST_ASSERT_EQUAL( MQTT_SAMPLE_TOPIC_FILTER_LENGTH + 4U, txBufferCommittedBytes );
+    TEST_ASSERT_EQUAL_MEMORY( MQTT_SAMPLE_TOPIC_FILTER, txBufferMemory, MQTT_SAMPLE_TOPIC_FILTER_LENGTH );
+    TEST_ASSERT_EQUAL_MEMORY( "Test", &txBufferMemory[ MQTT_SAMPLE_TOPIC_FILTER_LENGTH ], 4U );
+    TEST_ASSERT_EQUAL( MQTTConnected, mqttContext.connectStatus );
+}
+
+/**
+ * @brief Test that a publish is sent with writev when the transport has no
+ * buffer for it, and fails when the commit of the buffer fails.
+ */
+void test_MQTT_Publish_TxBuffer_Unavailable_And_Commit_Failure( void )
+{
+    MQTTContext_t mqttContext = { 0 };
+    MQTTPublishInfo_t publishInfo = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTStatus_t status;
+
+    setupTxBufferTransportInterface( &transport );
+    setupNetworkBuffer( &networkBuffer );
+    transport.writev = transportWritevSuccess;
+
+    status = MQTT_Init( &mqttContext, &transport, getTime, eventCallback, &networkBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    mqttContext.connectStatus = MQTTConnected;
+
+    publishInfo.pTopicName = MQTT_SAMPLE_TOPIC_FILTER;
+    publishInfo.topicNameLength = MQTT_SAMPLE_TOPIC_FILTER_LENGTH;
+    publishInfo.pPayload = "Test";
+    publishInfo.payloadLength = 4;
+
+    /* No buffer is available. */
+    txBufferAvailable = false;
+    MQTT_GetPublishPacketSize_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_SerializePublishHeaderWithoutTopic_ExpectAnyArgsAndReturn( MQTTSuccess );
+
+    status = MQTT_Publish( &mqttContext, &publishInfo, 0 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( 1U, txBufferGetCount );
+    TEST_ASSERT_EQUAL( 0U, txBufferCommitCount );
+
+    /* A commit sending part of the buffer is a network error. */
+    txBufferAvailable = true;
+    txBufferCommitResult = 1;
+    MQTT_GetPublishPacketSize_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_SerializePublishHeaderWithoutTopic_ExpectAnyArgsAndReturn( MQTTSuccess );
+
+    status = MQTT_Publish( &mqttContext, &publishInfo, 0 );
+    TEST_ASSERT_EQUAL( MQTTSendFailed, status );
+    TEST_ASSERT_EQUAL( 1U, txBufferCommitCount );
+    TEST_ASSERT_EQUAL( MQTTDisconnectPending, mqttContext.connectStatus );
+}
+
+/**
+ * @brief Test that a PUBACK is serialized straight into a buffer of the
+ * transport, which is given back unsent if serializing fails.
+ */
+void test_MQTT_ProcessLoop_TxBuffer_Ack( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t context = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    MQTTPublishState_t publishState = MQTTPubAckSend;
+    MQTTPublishState_t ackState = MQTTPublishDone;
+    MQTTPubAckInfo_t incomingPublishRecords[ 10 ];
+
+    setupTxBufferTransportInterface( &transport );
+    setupNetworkBuffer( &networkBuffer );
+
+    incomingPacket.type = MQTT_PACKET_TYPE_PUBLISH;
+    incomingPacket.remainingLength = MQTT_SAMPLE_REMAINING_LENGTH;
+
+    mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    mqttStatus = MQTT_InitStatefulQoS( &context, NULL, 0, incomingPublishRecords, 10 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    context.connectStatus = MQTTConnected;
+    context.lastPacketTxTime = UINT32_MAX;
+
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStatePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStatePublish_ReturnThruPtr_pNewState( &publishState );
+    MQTT_SerializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStateAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStateAck_ReturnThruPtr_pNewState( &ackState );
+
+    mqttStatus = MQTT_ProcessLoop( &context );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL( 1U, txBufferCommitCount );
+    TEST_ASSERT_EQUAL( MQTT_PUBLISH_ACK_PACKET_SIZE, txBufferCommittedBytes );
+    TEST_ASSERT_NOT_EQUAL( UINT32_MAX, context.lastPacketTxTime );
+
+    /* The buffer is committed empty when the ack cannot be serialized. */
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStatePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStatePublish_ReturnThruPtr_pNewState( &publishState );
+    MQTT_SerializeAck_ExpectAnyArgsAndReturn( MQTTBadParameter );
+
+    mqttStatus = MQTT_ProcessLoop( &context );
+    TEST_ASSERT_NOT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL( 2U, txBufferCommitCount );
+    TEST_ASSERT_EQUAL( 0U, txBufferCommittedBytes );
+}
+
+/**
+ * @brief Test that a packet serialized into a buffer of the library, such as
+ * PINGREQ, is copied into a buffer of the transport.
+ */
+void test_MQTT_Ping_TxBuffer( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t context = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    size_t pingreqSize = MQTT_PACKET_PINGREQ_SIZE;
+
+    setupTxBufferTransportInterface( &transport );
+    setupNetworkBuffer( &networkBuffer );
+
+    mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    context.connectStatus = MQTTConnected;
+
+    MQTT_GetPingreqPacketSize_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetPingreqPacketSize_ReturnThruPtr_pPacketSize( &pingreqSize );
+    MQTT_SerializePingreq_ExpectAnyArgsAndReturn( MQTTSuccess );
+
+    mqttStatus = MQTT_Ping( &context );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL( 1U, txBufferCommitCount );
+    TEST_ASSERT_EQUAL( MQTT_PACKET_PINGREQ_SIZE, txBufferCommittedBytes );
+    TEST_ASSERT_TRUE( context.waitingForPingResp );
+}
+
+/**
+ * @brief Test that a send which sends nothing waits for the transport to be
+ * writable before it is retried.
+ */
+void test_MQTT_Ping_Wait_Writable( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t context = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    size_t pingreqSize = MQTT_PACKET_PINGREQ_SIZE;
+
+    setupWaitTransportInterface( &transport );
+    setupNetworkBuffer( &networkBuffer );
+    transport.send = transportSendNoBytesOnce;
+
+    mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    context.connectStatus = MQTTConnected;
+
+    MQTT_GetPingreqPacketSize_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetPingreqPacketSize_ReturnThruPtr_pPacketSize( &pingreqSize );
+    MQTT_SerializePingreq_ExpectAnyArgsAndReturn( MQTTSuccess );
+
+    mqttStatus = MQTT_Ping( &context );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL( 2U, sendNoBytesOnceCount );
+    TEST_ASSERT_EQUAL( 1U, waitCount );
+    TEST_ASSERT_EQUAL( TRANSPORT_WAIT_WRITABLE, waitEvent );
+    TEST_ASSERT_GREATER_THAN( 0U, waitTimeoutMs );
+    TEST_ASSERT_LESS_OR_EQUAL( MQTT_SEND_TIMEOUT_MS, waitTimeoutMs );
+}
+
+/**
+ * @brief Test that a failed wait of a vectored send is only logged, and the
+ * send is retried.
+ */
+void test_MQTT_Publish_Wait_Failure( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t context = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTPublishInfo_t publishInfo = { 0 };
+
+    setupWaitTransportInterface( &transport );
+    setupNetworkBuffer( &networkBuffer );
+    transport.writev = transportWritevNoBytesOnce;
+    waitResult = -1;
+
+    mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    context.connectStatus = MQTTConnected;
+    publishInfo.pTopicName = MQTT_SAMPLE_TOPIC_FILTER;
+    publishInfo.topicNameLength = MQTT_SAMPLE_TOPIC_FILTER_LENGTH;
+    publishInfo.pPayload = "Test";
+    publishInfo.payloadLength = 4;
+
+    MQTT_GetPublishPacketSize_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_SerializePublishHeaderWithoutTopic_ExpectAnyArgsAndReturn( MQTTSuccess );
+
+    mqttStatus = MQTT_Publish( &context, &publishInfo, 0 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL( 2U, sendNoBytesOnceCount );
+    TEST_ASSERT_EQUAL( 1U, waitCount );
+    TEST_ASSERT_EQUAL( TRANSPORT_WAIT_WRITABLE, waitEvent );
+    TEST_ASSERT_EQUAL( MQTTConnected, context.connectStatus );
+}
+
+/**
+ * @brief Test that receiving the rest of a packet, and the CONNACK itself,
+ * wait for the transport to be readable while no data arrives.
+ */
+void test_MQTT_Connect_Wait_Readable( void )
+{
+    MQTTContext_t mqttContext = { 0 };
+    MQTTConnectInfo_t connectInfo = { 0 };
+    bool sessionPresent;
+    MQTTStatus_t status;
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
+
+    setupWaitTransportInterface( &transport );
+    setupNetworkBuffer( &networkBuffer );
+    transport.recv = transportRecvNoData;
+
+    MQTT_Init( &mqttContext, &transport, getTime, eventCallback, &networkBuffer );
+
+    MQTT_SerializeConnect_IgnoreAndReturn( MQTTSuccess );
+    MQTT_GetConnectPacketSize_IgnoreAndReturn( MQTTSuccess );
+    MQTT_SerializeConnectFixedHeader_Stub( MQTT_SerializeConnectFixedHeader_cb );
+    incomingPacket.type = MQTT_PACKET_TYPE_CONNACK;
+    incomingPacket.remainingLength = 2;
+
+    /* The rest of the CONNACK never arrives. */
+    MQTT_GetIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    status = MQTT_Connect( &mqttContext, &connectInfo, NULL, 0U, &sessionPresent );
+    TEST_ASSERT_EQUAL_INT( MQTTRecvFailed, status );
+    TEST_ASSERT_GREATER_THAN( 0U, waitCount );
+    TEST_ASSERT_EQUAL( TRANSPORT_WAIT_READABLE, waitEvent );
+    TEST_ASSERT_LESS_OR_EQUAL( MQTT_RECV_POLLING_TIMEOUT_MS, waitTimeoutMs );
+
+    /* The CONNACK itself never arrives. */
+    waitCount = 0U;
+    MQTT_GetIncomingPacketTypeAndLength_IgnoreAndReturn( MQTTNoDataAvailable );
+    status = MQTT_Connect( &mqttContext, &connectInfo, NULL, 10U, &sessionPresent );
+    TEST_ASSERT_NOT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_GREATER_THAN( 0U, waitCount );
+    TEST_ASSERT_EQUAL( TRANSPORT_WAIT_READABLE, waitEvent );
+    TEST_ASSERT_LESS_OR_EQUAL( 10U, waitTimeoutMs );
+}
+
+/**
+ * @brief Stub of MQTT_ReserveState which stores the record in the outgoing
+ * records of the context, like the state engine does.
+ */
+static MQTTStatus_t reserveStateStoreRecord( const MQTTContext_t * pContext,
+                                             uint16_t packetId,
+                                             MQTTQoS_t qos,
+                                             int numcallbacks )
+{
+    ( void ) numcallbacks;
+
+    TEST_ASSERT_NOT_NULL( pContext->outgoingPublishRecords );
+    pContext->outgoingPublishRecords[ 0 ].packetId = packetId;
+    pContext->outgoingPublishRecords[ 0 ].qos = qos;
+    pContext->outgoingPublishRecords[ 0 ].publishState = MQTTPublishSend;
+
+    return MQTTSuccess;
+}
+
+/**
+ * @brief Initialize a connected context which claims its state records from
+ * the given slab.
+ */
+static void setupSlabContext( MQTTContext_t * pContext,
+                              TransportInterface_t * pTransport,
+                              MQTTFixedBuffer_t * pNetworkBuffer,
+                              MQTTRecordSlab_t * pRecordSlab )
+{
+    MQTTStatus_t mqttStatus;
+
+    setupTransportInterface( pTransport );
+    setupNetworkBuffer( pNetworkBuffer );
+
+    mqttStatus = MQTT_Init( pContext, pTransport, getTime, eventCallback, pNetworkBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    mqttStatus = MQTT_SetRecordSlab( pContext, pRecordSlab );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    pContext->connectStatus = MQTTConnected;
+}
+
+/**
+ * @brief Test that MQTT_InitRecordSlab validates its parameters and marks all
+ * chunks as free.
+ */
+void test_MQTT_InitRecordSlab( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTRecordSlab_t recordSlab;
+    MQTTPubAckInfo_t records[ 40 ];
+    uint32_t freeChunks[ MQTT_RECORD_SLAB_BITMAP_WORDS( 40 ) ];
+
+    TEST_ASSERT_EQUAL( 2, MQTT_RECORD_SLAB_BITMAP_WORDS( 40 ) );
+    TEST_ASSERT_EQUAL( 1, MQTT_RECORD_SLAB_BITMAP_WORDS( 32 ) );
+
+    mqttStatus = MQTT_InitRecordSlab( NULL, records, 1, freeChunks, 40 );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_InitRecordSlab( &recordSlab, NULL, 1, freeChunks, 40 );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_InitRecordSlab( &recordSlab, records, 1, NULL, 40 );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_InitRecordSlab( &recordSlab, records, 0, freeChunks, 40 );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_InitRecordSlab( &recordSlab, records, 1, freeChunks, 0 );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_InitRecordSlab( &recordSlab, records, 1, freeChunks, 40 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL_HEX32( 0xFFFFFFFFU, freeChunks[ 0 ] );
+    TEST_ASSERT_EQUAL_HEX32( 0x000000FFU, freeChunks[ 1 ] );
+    TEST_ASSERT_EQUAL( 1, recordSlab.recordsPerChunk );
+    TEST_ASSERT_EQUAL( 40, recordSlab.chunkCount );
+}
+
+/**
+ * @brief Test that MQTT_SetRecordSlab validates its parameters.
+ */
+void test_MQTT_SetRecordSlab_Invalid_Params( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t context = { 0 };
+    MQTTRecordSlab_t recordSlab = { 0 };
+    MQTTPubAckInfo_t outgoingRecords[ 2 ];
+
+    mqttStatus = MQTT_SetRecordSlab( NULL, &recordSlab );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    /* A context cannot use both its own records and a slab. */
+    context.outgoingPublishRecords = outgoingRecords;
+    context.outgoingPublishRecordMaxCount = 2;
+    mqttStatus = MQTT_SetRecordSlab( &context, &recordSlab );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    context.outgoingPublishRecords = NULL;
+    context.outgoingPublishRecordMaxCount = 0;
+    mqttStatus = MQTT_SetRecordSlab( &context, &recordSlab );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL_PTR( &recordSlab, context.pRecordSlab );
+}
+
+/**
+ * @brief Test that a QoS1 publish claims a chunk of the slab, and that the
+ * chunk is given back once the publish is complete.
+ */
+void test_MQTT_Publish_RecordSlab_ClaimAndRelease( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t context = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTPublishInfo_t publishInfo = { 0 };
+    MQTTPublishState_t expectedState = MQTTPubAckPending;
+    MQTTRecordSlab_t recordSlab;
+    MQTTPubAckInfo_t records[ 3 * 4 ];
+    uint32_t freeChunks[ MQTT_RECORD_SLAB_BITMAP_WORDS( 3 ) ];
+
+    mqttStatus = MQTT_InitRecordSlab( &recordSlab, records, 4, freeChunks, 3 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    setupSlabContext( &context, &transport, &networkBuffer, &recordSlab );
+
+    publishInfo.qos = MQTTQoS1;
+
+    MQTT_GetPublishPacketSize_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_SerializePublishHeaderWithoutTopic_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ReserveState_Stub( reserveStateStoreRecord );
+    MQTT_UpdateStatePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStatePublish_ReturnThruPtr_pNewState( &expectedState );
+
+    mqttStatus = MQTT_Publish( &context, &publishInfo, 1 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL_PTR( &records[ 0 ], context.outgoingPublishRecords );
+    TEST_ASSERT_EQUAL( 4, context.outgoingPublishRecordMaxCount );
+    TEST_ASSERT_NULL( context.incomingPublishRecords );
+    TEST_ASSERT_EQUAL_HEX32( 0x6U, freeChunks[ 0 ] );
+
+    /* The PUBACK completes the publish, and the chunk is released at the end
+     * of the next iteration of the process loop. */
+    records[ 0 ].packetId = MQTT_PACKET_ID_INVALID;
+    context.transportInterface.recv = transportRecvNoData;
+    mqttStatus = MQTT_ProcessLoop( &context );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_NULL( context.outgoingPublishRecords );
+    TEST_ASSERT_EQUAL( 0, context.outgoingPublishRecordMaxCount );
+    TEST_ASSERT_EQUAL_HEX32( 0x7U, freeChunks[ 0 ] );
+}
+
+/**
+ * @brief Test that QoS1 publishes fail with MQTTNoMemory when the slab has no
+ * free chunk, in both directions.
+ */
+void test_MQTT_RecordSlab_Exhausted( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t context = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTPublishInfo_t publishInfo = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    MQTTRecordSlab_t recordSlab;
+    MQTTPubAckInfo_t records[ 4 ];
+    uint32_t freeChunks[ MQTT_RECORD_SLAB_BITMAP_WORDS( 1 ) ];
+
+    mqttStatus = MQTT_InitRecordSlab( &recordSlab, records, 4, freeChunks, 1 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    setupSlabContext( &context, &transport, &networkBuffer, &recordSlab );
+
+    /* Another context holds the only chunk. */
+    freeChunks[ 0 ] = 0U;
+
+    publishInfo.qos = MQTTQoS1;
+    MQTT_GetPublishPacketSize_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_SerializePublishHeaderWithoutTopic_ExpectAnyArgsAndReturn( MQTTSuccess );
+    mqttStatus = MQTT_Publish( &context, &publishInfo, 1 );
+    TEST_ASSERT_EQUAL( MQTTNoMemory, mqttStatus );
+
+    /* An incoming QoS1 publish cannot be recorded either. */
+    publishInfo.qos = MQTTQoS1;
+    publishInfo.pTopicName = "sensors/kitchen";
+    publishInfo.topicNameLength = 15;
+    incomingPacket.type = MQTT_PACKET_TYPE_PUBLISH;
+    incomingPacket.remainingLength = MQTT_SAMPLE_REMAINING_LENGTH;
+    incomingPacket.headerLength = MQTT_SAMPLE_REMAINING_LENGTH;
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_DeserializePublish_ReturnThruPtr_pPublishInfo( &publishInfo );
+    mqttStatus = MQTT_ProcessLoop( &context );
+    TEST_ASSERT_EQUAL( MQTTNoMemory, mqttStatus );
+    TEST_ASSERT_NULL( context.incomingPublishRecords );
+}
+
+
+void test_MQTT_ProcessLoop_HandleKeepAlive( void )
+{
+    MQTTContext_t context = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTStatus_t mqttStatus;
+
+    setupTransportInterface( &transport );
+    transport.recv = transportRecvNoData;
+    setupNetworkBuffer( &networkBuffer );
+
+    mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+
+    /* Set this value such that the library will be forced to send keep alive. */
+    context.waitingForPingResp = true;
+    /* Update the time so that there is timeout. */
+    globalEntryTime = MQTT_PINGRESP_TIMEOUT_MS;
+    mqttStatus = MQTT_ProcessLoop( &context );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+}
+
+void test_MQTT_ProcessLoop_HandleKeepAlive1( void )
+{
+    MQTTContext_t context = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTStatus_t mqttStatus;
+    size_t pingreqSize = MQTT_PACKET_PINGREQ_SIZE;
+
+    setupTransportInterface( &transport );
+    transport.recv = transportRecvNoData;
+    setupNetworkBuffer( &networkBuffer );
+
+    mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+
+    context.connectStatus = MQTTConnected;
+
+    /* Verify MQTTSuccess is returned. */
+    MQTT_GetPingreqPacketSize_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetPingreqPacketSize_ReturnThruPtr_pPacketSize( &pingreqSize );
+    MQTT_SerializePingreq_ExpectAnyArgsAndReturn( MQTTSuccess );
+
+    /* Set this value such that the library will be forced to send keep alive. */
+    context.waitingForPingResp = false;
+    context.keepAliveIntervalSec = 1;
+    /* Update the time so that there is timeout. */
+    globalEntryTime = MQTT_PINGRESP_TIMEOUT_MS;
+    mqttStatus = MQTT_ProcessLoop( &context );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+}
+
+void test_MQTT_ProcessLoop_HandleKeepAlive2( void )
+{
+    MQTTContext_t context = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTStatus_t mqttStatus;
+
+    setupTransportInterface( &transport );
+    transport.recv = transportRecvNoData;
+    setupNetworkBuffer( &networkBuffer );
+
+    mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+
+    /* Set this value such that the library will be forced to send keep alive. */
+    context.waitingForPingResp = false;
+    context.keepAliveIntervalSec = 1;
+
+    /* Update the time so that timeout does not occur and the ping is not sent. */
+    globalEntryTime = 0;
+
+    mqttStatus = MQTT_ProcessLoop( &context );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+}
+
+void test_MQTT_ProcessLoop_RecvFailed( void )
+{
+    MQTTContext_t context = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTStatus_t mqttStatus;
+
+    setupTransportInterface( &transport );
+    transport.recv = transportRecvFailure;
+    setupNetworkBuffer( &networkBuffer );
+
+    mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+    context.connectStatus = MQTTConnected;
+
+    mqttStatus = MQTT_ProcessLoop( &context );
+
+    TEST_ASSERT_EQUAL( MQTTRecvFailed, mqttStatus );
+}
+
+void test_MQTT_ProcessLoop_RecvFailed_disconnected( void )
+{
+    MQTTContext_t context = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTStatus_t mqttStatus;
+
+    setupTransportInterface( &transport );
+    transport.recv = transportRecvFailure;
+    setupNetworkBuffer( &networkBuffer );
+
+    mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+
+    mqttStatus = MQTT_ProcessLoop( &context );
+
+    TEST_ASSERT_EQUAL( MQTTRecvFailed, mqttStatus );
+}
+
+void test_MQTT_ReceiveLoop_KeepAliveACK( void )
+{
+    MQTTContext_t context = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    MQTTStatus_t mqttStatus;
+
+    setupTransportInterface( &transport );
+    setupNetworkBuffer( &networkBuffer );
+
+    mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
     TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
 
     context.networkBuffer.size = MQTT_TEST_BUFFER_LENGTH;
@@ -5661,6 +7241,31 @@ void test_MQTT_Subscribe_invalid_params( void )
     TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
 }
 
+/**
+ * @brief This test case verifies that MQTT_Subscribe and MQTT_Unsubscribe
+ * reject topic filters which are not valid.
+ */
+void test_MQTT_Subscribe_Unsubscribe_invalid_topic_filter( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t context = { 0 };
+    MQTTSubscribeInfo_t subscribeInfo[ 2 ];
+
+    memset( subscribeInfo, 0x0, sizeof( subscribeInfo ) );
+
+    /* The second filter has a wildcard which does not occupy a whole level. */
+    subscribeInfo[ 0 ].pTopicFilter = MQTT_SAMPLE_TOPIC_FILTER;
+    subscribeInfo[ 0 ].topicFilterLength = MQTT_SAMPLE_TOPIC_FILTER_LENGTH;
+    subscribeInfo[ 1 ].pTopicFilter = "sport/tennis#";
+    subscribeInfo[ 1 ].topicFilterLength = ( uint16_t ) strlen( subscribeInfo[ 1 ].pTopicFilter );
+
+    mqttStatus = MQTT_Subscribe( &context, subscribeInfo, 2, MQTT_FIRST_VALID_PACKET_ID );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_Unsubscribe( &context, subscribeInfo, 2, MQTT_FIRST_VALID_PACKET_ID );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+}
+
 static uint8_t * MQTT_SerializeSubscribedHeader_cb( size_t remainingLength,
                                                     uint8_t * pIndex,
                                                     uint16_t packetId,
@@ -7123,6 +8728,202 @@ void test_MQTT_MatchTopic_Wildcard_MultiLevel_No_Match_Cases( void )
     TEST_ASSERT_EQUAL( false, matchResult );
 }
 
+/**
+ * @brief Verifies that MQTT_MatchTopic API returns the same results for long
+ * topics, whose identical characters are compared a word at a time.
+ */
+void test_MQTT_MatchTopic_LongTopics( void )
+{
+    const char * pTopicName = NULL;
+    const char * pTopicFilter = NULL;
+    bool matchResult = false;
+
+    /* Identical levels are longer than a word on both sides of a wildcard. */
+    pTopicName = "building/floor-one/conference-room/sensor/temperature";
+    pTopicFilter = "building/floor-one/+/sensor/temperature";
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_MatchTopic( pTopicName,
+                                                     strlen( pTopicName ),
+                                                     pTopicFilter,
+                                                     strlen( pTopicFilter ),
+                                                     &matchResult ) );
+    TEST_ASSERT_EQUAL( true, matchResult );
+
+    /* The only difference is in the last character of the topic name. */
+    pTopicName = "building/floor-one/conference-room/sensor/temperaturX";
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_MatchTopic( pTopicName,
+                                                     strlen( pTopicName ),
+                                                     pTopicFilter,
+                                                     strlen( pTopicFilter ),
+                                                     &matchResult ) );
+    TEST_ASSERT_EQUAL( false, matchResult );
+
+    /* A long wildcard level is skipped to its level separator. */
+    pTopicName = "building/floor-one/a-particularly-long-room-name/sensor";
+    pTopicFilter = "building/+/+/sensor";
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_MatchTopic( pTopicName,
+                                                     strlen( pTopicName ),
+                                                     pTopicFilter,
+                                                     strlen( pTopicFilter ),
+                                                     &matchResult ) );
+    TEST_ASSERT_EQUAL( true, matchResult );
+
+    /* The topic name ends at the parent level of a multi-level wildcard. */
+    pTopicName = "building/floor-one/conference-room";
+    pTopicFilter = "building/floor-one/conference-room/#";
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_MatchTopic( pTopicName,
+                                                     strlen( pTopicName ),
+                                                     pTopicFilter,
+                                                     strlen( pTopicFilter ),
+                                                     &matchResult ) );
+    TEST_ASSERT_EQUAL( true, matchResult );
+
+    /* The topic filter is a prefix of the topic name. */
+    pTopicName = "building/floor-one/conference-room/sensor";
+    pTopicFilter = "building/floor-one/conference-room";
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_MatchTopic( pTopicName,
+                                                     strlen( pTopicName ),
+                                                     pTopicFilter,
+                                                     strlen( pTopicFilter ),
+                                                     &matchResult ) );
+    TEST_ASSERT_EQUAL( false, matchResult );
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Verifies that MQTT_ValidateTopic API rejects invalid parameters.
+ */
+void test_MQTT_ValidateTopic_InvalidInput( void )
+{
+    uint16_t levelOffsets[ 2 ];
+
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_ValidateTopic( NULL, 1, false, NULL, NULL ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_ValidateTopic( "a", 0, false, NULL, NULL ) );
+
+    /* The capacity of the offsets array is required. */
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_ValidateTopic( "a/b", 3, false, levelOffsets, NULL ) );
+}
+
+/**
+ * @brief Verifies the wildcard rules MQTT_ValidateTopic API applies to topic
+ * names and topic filters.
+ */
+void test_MQTT_ValidateTopic_Wildcards( void )
+{
+    size_t index;
+    const char * pValidFilters[] =
+    {
+        "#",              "+",              "/",       "+/+",
+        "sport/#",        "sport/+/player", "+/tennis/#",
+        "/finance",       "sport//player",  "a-long-topic-level/with/many/levels/+"
+    };
+    const char * pInvalidFilters[] =
+    {
+        "sport/tennis#",  "sport/tennis/#/ranking", "sport+",
+        "sport/+tennis",  "#/",                     "a-long-topic-level/with/many/levels/+x"
+    };
+
+    for( index = 0; index < ( sizeof( pValidFilters ) / sizeof( pValidFilters[ 0 ] ) ); index++ )
+    {
+        TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_ValidateTopic( pValidFilters[ index ],
+                                                            ( uint16_t ) strlen( pValidFilters[ index ] ),
+                                                            true,
+                                                            NULL,
+                                                            NULL ) );
+    }
+
+    for( index = 0; index < ( sizeof( pInvalidFilters ) / sizeof( pInvalidFilters[ 0 ] ) ); index++ )
+    {
+        TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_ValidateTopic( pInvalidFilters[ index ],
+                                                                 ( uint16_t ) strlen( pInvalidFilters[ index ] ),
+                                                                 true,
+                                                                 NULL,
+                                                                 NULL ) );
+    }
+
+    /* Topic names cannot contain wildcards, even where a filter could. */
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_ValidateTopic( "sport/tennis/player1", 20, false, NULL, NULL ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_ValidateTopic( "sport/tennis/#", 14, false, NULL, NULL ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_ValidateTopic( "+", 1, false, NULL, NULL ) );
+}
+
+/**
+ * @brief Verifies that MQTT_ValidateTopic API only accepts well-formed UTF-8
+ * without the NUL character.
+ */
+void test_MQTT_ValidateTopic_Utf8( void )
+{
+    /* U+00E9, U+20AC and U+1F600, each after enough ASCII to fill a word. */
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_ValidateTopic( "caf\xC3\xA9/\xE2\x82\xAC/\xF0\x9F\x98\x80", 14, false, NULL, NULL ) );
+
+    /* The largest code point U+10FFFF and the last one before the surrogates. */
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_ValidateTopic( "\xF4\x8F\xBF\xBF", 4, false, NULL, NULL ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_ValidateTopic( "\xED\x9F\xBF", 3, false, NULL, NULL ) );
+
+    /* NUL character. */
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_ValidateTopic( "sport\0tennis", 12, false, NULL, NULL ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_ValidateTopic( "a\0", 2, false, NULL, NULL ) );
+
+    /* Unexpected continuation byte and overlong encodings of '/'. */
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_ValidateTopic( "\x80", 1, false, NULL, NULL ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_ValidateTopic( "\xC0\xAF", 2, false, NULL, NULL ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_ValidateTopic( "\xE0\x80\xAF", 3, false, NULL, NULL ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_ValidateTopic( "\xF0\x80\x80\xAF", 4, false, NULL, NULL ) );
+
+    /* Surrogate U+D800 and code point U+110000. */
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_ValidateTopic( "\xED\xA0\x80", 3, false, NULL, NULL ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_ValidateTopic( "\xF4\x90\x80\x80", 4, false, NULL, NULL ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_ValidateTopic( "\xF5\x80\x80\x80", 4, false, NULL, NULL ) );
+
+    /* Truncated sequence and invalid continuation byte. */
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_ValidateTopic( "ab\xE2\x82", 4, false, NULL, NULL ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_ValidateTopic( "\xE2\x82/", 3, false, NULL, NULL ) );
+}
+
+/**
+ * @brief Verifies that MQTT_ValidateTopic API reports the offsets of the level
+ * separators.
+ */
+void test_MQTT_ValidateTopic_LevelOffsets( void )
+{
+    const char * pTopicFilter = "building/floor-one/+/sensor/#";
+    uint16_t levelOffsets[ 4 ] = { 0 };
+    size_t levelCount = 4;
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_ValidateTopic( pTopicFilter,
+                                                        ( uint16_t ) strlen( pTopicFilter ),
+                                                        true,
+                                                        levelOffsets,
+                                                        &levelCount ) );
+    TEST_ASSERT_EQUAL( 4, levelCount );
+    TEST_ASSERT_EQUAL( 8, levelOffsets[ 0 ] );
+    TEST_ASSERT_EQUAL( 18, levelOffsets[ 1 ] );
+    TEST_ASSERT_EQUAL( 20, levelOffsets[ 2 ] );
+    TEST_ASSERT_EQUAL( 27, levelOffsets[ 3 ] );
+
+    /* The separators can be counted without storing their offsets. */
+    levelCount = 0;
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_ValidateTopic( pTopicFilter,
+                                                        ( uint16_t ) strlen( pTopicFilter ),
+                                                        true,
+                                                        NULL,
+                                                        &levelCount ) );
+    TEST_ASSERT_EQUAL( 4, levelCount );
+
+    /* The offsets array is too small, but the count is still reported. */
+    memset( levelOffsets, 0x0, sizeof( levelOffsets ) );
+    levelCount = 2;
+    TEST_ASSERT_EQUAL( MQTTNoMemory, MQTT_ValidateTopic( pTopicFilter,
+                                                         ( uint16_t ) strlen( pTopicFilter ),
+                                                         true,
+                                                         levelOffsets,
+                                                         &levelCount ) );
+    TEST_ASSERT_EQUAL( 4, levelCount );
+    TEST_ASSERT_EQUAL( 8, levelOffsets[ 0 ] );
+    TEST_ASSERT_EQUAL( 18, levelOffsets[ 1 ] );
+    TEST_ASSERT_EQUAL( 0, levelOffsets[ 2 ] );
+}
+
 /* ========================================================================== */
 
 /**